@@ -76,6 +76,7 @@
 #include "Graphics/GraphicsState.h"
 #include "Graphics/FullScreenPass.h"
 #include "Graphics/TextureHelper.h"
+#include "Graphics/TextureCache.h"
 #include "Graphics/Light.h"
 #include "Graphics/LightProbe.h"
 #include "Graphics/FboHelper.h"
@@ -86,6 +87,7 @@
 #include "Graphics/Program/ProgramVars.h"
 #include "Graphics/Program/ProgramVersion.h"
 #include "Graphics/Program/Program.h"
+#include "Graphics/Program/ShaderCache.h"
 #include "Graphics/Program/GraphicsProgram.h"
 #include "Graphics/Program/ComputeProgram.h"
 #include "Graphics/Program/ParameterBlock.h"
@@ -134,12 +136,14 @@
 #include "Utils/Profiler.h"
 #include "Utils/StringUtils.h"
 #include "Utils/BinaryFileStream.h"
+#include "Utils/BinaryMemoryStream.h"
+#include "Utils/MemoryMappedFile.h"
 #include "Utils/Video/VideoEncoder.h"
 #include "Utils/Video/VideoEncoderUI.h"
 #include "Utils/Video/VideoDecoder.h"
 #include "Utils/Platform/OS.h"
 #include "Utils/Platform/ProgressBar.h"
-#include "Utils/ThreadPool.h"
+#include "Utils/TaskScheduler.h"
 #include "Utils/PatternGenerators/DxSamplePattern.h"
 #include "Utils/PatternGenerators/HaltonSamplePattern.h"
 
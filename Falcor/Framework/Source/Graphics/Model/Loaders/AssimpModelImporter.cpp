@@ -42,6 +42,8 @@
 #include "API/VertexLayout.h"
 #include "Data/VertexAttrib.h"
 #include "Utils/StringUtils.h"
+#include "Utils/TaskScheduler.h"
+#include "Utils/CpuTimer.h"
 #include "API/Device.h"
 
 namespace Falcor
@@ -304,10 +306,12 @@ namespace Falcor
                 }
                 else
                 {
-                    // create a new texture
-                    std::string fullpath = folder + '/' + s;
-                    fullpath = replaceSubstring(fullpath, "\\", "/");
-                    pTex = createTextureFromFile(fullpath, true, isSrgbRequired(aiType, useSrgb, pMaterial->getShadingModel()));
+                    // create a new texture from the image parse() decoded
+                    const auto& data = mpFileData->textures.find(s);
+                    if (data != mpFileData->textures.end())
+                    {
+                        pTex = createTextureFromFileData(data->second, true, isSrgbRequired(aiType, useSrgb, pMaterial->getShadingModel()));
+                    }
                     if (pTex)
                     {
                         mTextureCache[s] = pTex;
@@ -502,52 +506,164 @@ namespace Falcor
         return parseAiSceneNode(pRoot, pScene, aiToFalcorMeshId);
     }
 
-    bool AssimpModelImporter::initModel(const std::string& filename)
+    /** A model file ASSIMP has parsed, with missing tangent space generated and textures decoded
+    */
+    class AssimpModelImporter::FileData : public ModelFileData
     {
-        std::string fullpath;
-        if (findFileInDataDirectories(filename, fullpath) == false)
+    public:
+        FileData(const std::string& filename, Model::LoadFlags flags) : flags(flags) { mFilename = filename; }
+
+        bool load(const std::string& fullpath);
+        void generateTangents();
+        void decodeTextures();
+
+        Model::LoadFlags flags;
+        Assimp::Importer importer;                                      ///< Owns pScene
+        const aiScene* pScene = nullptr;
+        std::string modelFolder;
+        std::unordered_set<const aiMesh*> generatedTangents;            ///< Meshes given bitangents by generateTangents()
+        std::unordered_map<std::string, TextureFileData> textures;      ///< Keyed by the path in the material
+
+    protected:
+        bool createModel(Model& model) override
         {
-            logError(std::string("Can't find model file ") + filename, true);
-            return false;
+            AssimpModelImporter loader(model, flags);
+            return loader.createModel(*this);
         }
+    };
 
+    bool AssimpModelImporter::FileData::load(const std::string& fullpath)
+    {
         uint32_t assimpFlags = aiProcessPreset_TargetRealtime_MaxQuality |
             aiProcess_OptimizeGraph |
             aiProcess_FlipUVs |
             0;
 
-        if(is_set(mFlags, Model::LoadFlags::FindDegeneratePrimitives) == false) assimpFlags &= ~aiProcess_FindDegenerates;
-        if(is_set(mFlags, Model::LoadFlags::DontMergeMeshes))                   assimpFlags &= ~aiProcess_OptimizeMeshes; // Avoid merging original meshes
-        if(is_set(mFlags, Model::LoadFlags::RemoveInstancing))                  assimpFlags |= aiProcess_PreTransformVertices;
+        if(is_set(flags, Model::LoadFlags::FindDegeneratePrimitives) == false) assimpFlags &= ~aiProcess_FindDegenerates;
+        if(is_set(flags, Model::LoadFlags::DontMergeMeshes))                   assimpFlags &= ~aiProcess_OptimizeMeshes; // Avoid merging original meshes
+        if(is_set(flags, Model::LoadFlags::RemoveInstancing))                  assimpFlags |= aiProcess_PreTransformVertices;
 
         // Never use Assimp's tangent gen code
         assimpFlags &= ~(aiProcess_CalcTangentSpace);
 
-        Assimp::Importer importer;
-        const aiScene* pScene = importer.ReadFile(fullpath, assimpFlags);
+        CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+        pScene = importer.ReadFile(fullpath, assimpFlags);
+        mTimes.parseMs = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
 
         if((pScene == nullptr) || (verifyScene(pScene) == false))
         {
             std::string str("Can't open model file '");
-            str = str + std::string(filename) + "'\n" + importer.GetErrorString();
+            str = str + mFilename + "'\n" + importer.GetErrorString();
             logError(str, true);
             return false;
         }
 
         // Extract the folder name
         auto last = fullpath.find_last_of("/\\");
-        std::string modelFolder = fullpath.substr(0, last);
+        modelFolder = fullpath.substr(0, last);
+        return true;
+    }
+
+    void AssimpModelImporter::FileData::generateTangents()
+    {
+        if (is_set(flags, Model::LoadFlags::DontGenerateTangentSpace)) return;
+
+        std::vector<const aiMesh*> meshes;
+        for (uint32_t i = 0; i < pScene->mNumMeshes; i++)
+        {
+            if (pScene->mMeshes[i]->HasTangentsAndBitangents() == false) meshes.push_back(pScene->mMeshes[i]);
+        }
+
+        std::vector<float> times(meshes.size());
+        TaskScheduler::getGlobal()->parallelFor(0, uint32_t(meshes.size()), [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+                genTangentSpace(meshes[i]);
+                times[i] = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+            }
+        }, 1);
+
+        for (float t : times) mTimes.tangentMs += t;
+        generatedTangents.insert(meshes.begin(), meshes.end());
+    }
+
+    void AssimpModelImporter::FileData::decodeTextures()
+    {
+        // The same textures loadTextures() will ask for, each decoded once. Whether a texture is sRGB picks its TextureCache entry.
+        bool useSrgb = !is_set(flags, Model::LoadFlags::AssumeLinearSpaceTextures);
+        uint32_t shadingModel = is_set(flags, Model::LoadFlags::UseSpecGlossMaterials) ? ShadingModelSpecGloss : ShadingModelMetalRough;
+        std::vector<std::string> paths;
+        std::vector<bool> srgb;
+        for (uint32_t m = 0; m < pScene->mNumMaterials; m++)
+        {
+            const aiMaterial* pAiMaterial = pScene->mMaterials[m];
+            for (int i = 0; i < AI_TEXTURE_TYPE_MAX; ++i)
+            {
+                if (pAiMaterial->GetTextureCount((aiTextureType)i) != 1) continue;
+
+                aiString path;
+                pAiMaterial->GetTexture((aiTextureType)i, 0, &path);
+                std::string s(path.data);
+                if (s.empty() || textures.count(s)) continue;
+                textures[s].filename = replaceSubstring(modelFolder + '/' + s, "\\", "/");
+                paths.push_back(s);
+                srgb.push_back(isSrgbRequired((aiTextureType)i, useSrgb, shadingModel));
+            }
+        }
+
+        std::vector<float> times(paths.size());
+        TaskScheduler::getGlobal()->parallelFor(0, uint32_t(paths.size()), [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+                TextureFileData& data = textures.at(paths[i]);
+                loadTextureFileData(std::string(data.filename), srgb[i], data);
+                times[i] = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+            }
+        }, 1);
+
+        for (float t : times) mTimes.decodeMs += t;
+        mTimes.textureCount = uint32_t(paths.size());
+    }
+
+    ModelFileData::UniquePtr AssimpModelImporter::parse(const std::string& filename, Model::LoadFlags flags)
+    {
+        std::string fullpath;
+        if (findFileInDataDirectories(filename, fullpath) == false)
+        {
+            logError(std::string("Can't find model file ") + filename, true);
+            return nullptr;
+        }
+
+        std::unique_ptr<FileData> pData(new FileData(filename, flags));
+        if (pData->load(fullpath) == false)
+        {
+            return nullptr;
+        }
+
+        pData->generateTangents();
+        pData->decodeTextures();
+        return std::move(pData);
+    }
+
+    bool AssimpModelImporter::createModel(const FileData& data)
+    {
+        mpFileData = &data;
+        const std::string& filename = data.getFilename();
 
         // Order of initialization matters, materials, bones and animations need to loaded before mesh initialization
         bool isObjFile = hasSuffix(filename, ".obj", false);
         bool useSrgbTextures = !is_set(mFlags, Model::LoadFlags::AssumeLinearSpaceTextures);
-        if(createAllMaterials(pScene, modelFolder, isObjFile, useSrgbTextures) == false)
+        if(createAllMaterials(data.pScene, data.modelFolder, isObjFile, useSrgbTextures) == false)
         {
             logError(std::string("Can't create materials for model ") + filename, true);
             return false;
         }
 
-        if (createDrawList(pScene) == false)
+        if (createDrawList(data.pScene) == false)
         {
             logError(std::string("Can't create draw lists for model ") + filename, true);
             return false;
@@ -556,12 +672,6 @@ namespace Falcor
         return true;
     }
 
-    bool AssimpModelImporter::import(Model& model, const std::string& filename, Model::LoadFlags flags)
-    {
-        AssimpModelImporter loader(model, flags);
-        return loader.initModel(filename);
-    }
-
     bool AssimpModelImporter::isUsedNode(const aiNode* pNode) const
     {
         return (mBoneNameToIdMap.count(pNode->mName.C_Str()) > 0) || (mAdditionalUsedNodes.count(pNode) > 0);
@@ -770,11 +880,7 @@ namespace Falcor
         auto pIB = createIndexBuffer(pAiMesh);
         BoundingBox boundingBox = createMeshBbox(pAiMesh);
 
-        const bool generateTangentSpace = (pAiMesh->HasTangentsAndBitangents() == false) && (is_set(mFlags, Model::LoadFlags::DontGenerateTangentSpace) == false);
-        if (generateTangentSpace)
-        {
-            genTangentSpace(pAiMesh);
-        }
+        const bool generateTangentSpace = (mpFileData->generatedTangents.count(pAiMesh) != 0);   // Already done by parse()
 
         VertexLayout::SharedPtr pLayout = createVertexLayout(pAiMesh);
         if (pLayout == nullptr)
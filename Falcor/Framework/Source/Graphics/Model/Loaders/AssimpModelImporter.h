@@ -57,23 +57,24 @@ namespace Falcor
     class AssimpModelImporter : public ModelImporter
     {
     public:
-        /** Load a model using ASSIMP
-            \param[out] model Model object to load into
+        /** Parse a model file using ASSIMP, generate missing tangent space and decode the model's textures, without touching the device.
+            Typically, the user should use Model::parseFile() or Model::createFromFile() instead.
             \param[in] filename Model's filename. Can include a full path or a relative path from a data directory
             \param[in] flags Flags controlling model creation
-            \return Whether import succeeded
+            \return The parsed model, or nullptr if it couldn't be loaded
         */
-        static bool import(Model& model, const std::string& filename, Model::LoadFlags flags);
+        static ModelFileData::UniquePtr parse(const std::string& filename, Model::LoadFlags flags);
 
     private:
 
         using IdToMesh = std::unordered_map<uint32_t, Mesh::SharedPtr>;
+        class FileData;
 
         AssimpModelImporter(Model& model, Model::LoadFlags flags);
         AssimpModelImporter(const AssimpModelImporter&) = delete;
         void operator=(const AssimpModelImporter&) = delete;
 
-        bool initModel(const std::string& filename);
+        bool createModel(const FileData& data);
         bool createDrawList(const aiScene* pScene);
         bool parseAiSceneNode(const aiNode* pCurrent, const aiScene* pScene, IdToMesh& aiToFalcorMesh);
         bool createAllMaterials(const aiScene* pScene, const std::string& modelFolder, bool isObjFile, bool useSrgb);
@@ -106,5 +107,6 @@ namespace Falcor
         std::vector<Bone> mBones;
         Model::LoadFlags mFlags;
         std::map<const std::string, Texture::SharedPtr> mTextureCache;
+        const FileData* mpFileData = nullptr;       ///< The parsed file createModel() is working on
     };
 }
@@ -184,10 +184,29 @@ namespace Falcor
         }
 
         if(prepareSubmeshes() == false) return;
+        if(prepareTextures()  == false) return;
         if(writeHeader()      == false) return;
         if(writeTextures()    == false) return;
         if(writeMeshes()      == false) return;
         if(writeInstances()   == false) return;
+        if(writeToc()         == false) return;
+    }
+
+    void BinaryModelExporter::alignStream()
+    {
+        static const uint8_t zeros[16] = {};
+        mStream.write(zeros, (16 - mStream.getWritePosition() % 16) % 16);
+    }
+
+    void BinaryModelExporter::beginSection()
+    {
+        alignStream();
+        mToc.push_back({ mStream.getWritePosition(), 0 });
+    }
+
+    void BinaryModelExporter::endSection()
+    {
+        mToc.back().size = mStream.getWritePosition() - mToc.back().offset;
     }
 
     bool BinaryModelExporter::prepareSubmeshes()
@@ -217,38 +236,56 @@ namespace Falcor
         return true;
     }
 
+    bool BinaryModelExporter::prepareTextures()
+    {
+        // The header holds the texture count, so collect the unique textures before writing anything
+        mTextureHash[nullptr] = -1;
+        for (uint32_t meshID = 0; meshID < mpModel->getMeshCount(); meshID++)
+        {
+            const auto& pMaterial = mpModel->getMesh(meshID)->getMaterial();
+            addMaterialTexture(pMaterial->getBaseColorTexture());
+            addMaterialTexture(pMaterial->getSpecularTexture());
+            addMaterialTexture(pMaterial->getEmissiveTexture());
+            addMaterialTexture(pMaterial->getNormalMap());
+            addMaterialTexture(pMaterial->getOcclusionMap());
+            addMaterialTexture(pMaterial->getLightMap());
+            addMaterialTexture(pMaterial->getHeightMap());
+        }
+        return true;
+    }
+
     bool BinaryModelExporter::writeHeader()
     {
         mStream.write("BinScene", 8);
-        mStream << (int32_t)8 << (int32_t)mpModel->getTextureCount() << (int32_t)mMeshes.size() << (int32_t)mInstanceCount;
+        mStream << (int32_t)9 << (int32_t)mTextures.size() << (int32_t)mMeshes.size() << (int32_t)mInstanceCount;
+        mStream << (int32_t)0 << (int32_t)0;    // Padding
+
+        // Reserve the table of contents. writeToc() fills it once the sections are written.
+        mTocOffset = mStream.getWritePosition();
+        std::vector<TocEntry> toc(mTextures.size() + mMeshes.size() + 1, TocEntry{ 0, 0 });
+        mStream.write(toc.data(), toc.size() * sizeof(TocEntry));
         return true;
     }
 
-    bool BinaryModelExporter::writeTextures()
+    bool BinaryModelExporter::writeToc()
     {
-        mTextureHash[nullptr] = -1;
+        assert(mToc.size() == mTextures.size() + mMeshes.size() + 1);
+        mStream.setWritePosition(mTocOffset);
+        mStream.write(mToc.data(), mToc.size() * sizeof(TocEntry));
+        return true;
+    }
 
-        uint32_t texID = 0;
-        for (uint32_t meshID = 0; meshID < mpModel->getMeshCount(); meshID++)
+    bool BinaryModelExporter::writeTextures()
+    {
+        for(const Texture* pTexture : mTextures)
         {
-            bool succeeded = true;
-
-            // Write all material textures
-            const auto& pMaterial = mpModel->getMesh(meshID)->getMaterial();
-            succeeded &= writeMaterialTexture(texID, pMaterial->getBaseColorTexture());
-            succeeded &= writeMaterialTexture(texID, pMaterial->getSpecularTexture());
-            succeeded &= writeMaterialTexture(texID, pMaterial->getEmissiveTexture());
-            succeeded &= writeMaterialTexture(texID, pMaterial->getNormalMap());
-            succeeded &= writeMaterialTexture(texID, pMaterial->getOcclusionMap());
-            succeeded &= writeMaterialTexture(texID, pMaterial->getLightMap());
-            succeeded &= writeMaterialTexture(texID, pMaterial->getHeightMap());
-
-            if (succeeded == false)
+            beginSection();
+            if(exportBinaryImage(pTexture) == false)
             {
                 return false;
             }
+            endSection();
         }
-
         return true;
     }
 
@@ -293,18 +330,11 @@ namespace Falcor
             vbInfo[i].pData = (size_t)vbInfo[i].pBuffer->map(Buffer::MapType::Read);
         }
 
-        // Write the vertex buffer
-        for (uint32_t i = 0; i < pMesh->getVertexCount(); ++i)
-        {
-            for (auto& a : vbInfo)
-            { 			
-                mStream.write((void*)a.pData, a.stride);
-                a.pData += a.stride;
-            }
-        }
-
+        // Write each vertex buffer as an aligned array, so the loader can upload it straight from the file
         for (auto& a : vbInfo)
         {
+            alignStream();
+            mStream.write((void*)a.pData, size_t(a.stride) * pMesh->getVertexCount());
             a.pBuffer->unmap();
         }
 
@@ -314,6 +344,7 @@ namespace Falcor
     bool BinaryModelExporter::writeSubmesh(const Mesh::SharedPtr& pMesh)
     {
         const auto pMaterial = pMesh->getMaterial();
+        alignStream();
 
         glm::vec3 ambient(0,0,0);
         glm::vec4 diffuse = pMaterial->getBaseColor();
@@ -367,6 +398,7 @@ namespace Falcor
                 if(meshID == submeshes[0])
                 {
                     // All submeshes share the same VB and same layout. We use the first submesh for that.
+                    beginSection();
                     if(writeCommonMeshData(pMesh, (uint32_t)submeshes.size()) == false)
                     {
                         return false;
@@ -379,6 +411,7 @@ namespace Falcor
                 }
                 inst += mpModel->getMeshInstanceCount(meshID);
             }
+            endSection();
         }
 
         return true;
@@ -388,6 +421,7 @@ namespace Falcor
     {
         int32_t meshIdx = 0;
         int32_t enabled = 1;
+        beginSection();
         for(const auto& mesh : mMeshes)
         {
             const uint32_t meshID = mesh.second[0];
@@ -402,22 +436,18 @@ namespace Falcor
 
             meshIdx++;
         }
+        endSection();
         return true;
     }
 
-    bool BinaryModelExporter::writeMaterialTexture(uint32_t& texID, const Texture::SharedPtr& pTexture)
+    void BinaryModelExporter::addMaterialTexture(const Texture::SharedPtr& pTexture)
     {
-        if (pTexture != nullptr)
+        // If not added yet
+        if (pTexture != nullptr && mTextureHash.find(pTexture.get()) == mTextureHash.end())
         {
-            // If not exported yet
-            if (mTextureHash.find(pTexture.get()) == mTextureHash.end())
-            {
-                mTextureHash[pTexture.get()] = texID++;
-                return exportBinaryImage(pTexture.get());
-            }
+            mTextureHash[pTexture.get()] = (int32_t)mTextures.size();
+            mTextures.push_back(pTexture.get());
         }
-
-        return true;
     }
 
     bool BinaryModelExporter::exportBinaryImage(const Texture* pTexture)
@@ -449,6 +479,7 @@ namespace Falcor
         // Version, width, height, bytes-per-pixel, channel count, FormatID, DataSize
         mStream << (int32_t)2 << (int32_t)width << (int32_t)height << bpp << (int32_t)0 << formatID << (int32_t)data.size();
 
+        alignStream();
         mStream.write(data.data(), data.size());
         return true;
     }
@@ -55,22 +55,38 @@ namespace Falcor
         const std::string& mFilename;
 
         bool writeHeader();
+        bool writeToc();
         bool writeTextures();
         bool writeMeshes();
         bool writeCommonMeshData(const Mesh::SharedPtr& pMesh, uint32_t submeshCount);
         bool writeSubmesh(const Mesh::SharedPtr& pMesh);
         bool writeInstances();
 
-        bool writeMaterialTexture(uint32_t& texID, const Texture::SharedPtr& pTexture);
-        
+        void addMaterialTexture(const Texture::SharedPtr& pTexture);
+
         bool exportBinaryImage(const Texture* pTexture);
 
         void error(const std::string& Msg);
         void warning(const std::string& Msg);
 
+        void alignStream();
+        void beginSection();
+        void endSection();
+
         bool prepareSubmeshes();
+        bool prepareTextures();
         std::map<const Vao*, std::vector<uint32_t>> mMeshes; // Maps to meshID in model
         std::map<const Texture*, int32_t> mTextureHash;
+        std::vector<const Texture*> mTextures; // In file order
+
+        // Table of contents: offset and size of each texture, mesh and the instance array, in that order
+        struct TocEntry
+        {
+            uint64_t offset;
+            uint64_t size;
+        };
+        std::vector<TocEntry> mToc;
+        uint64_t mTocOffset = 0;
         uint32_t mInstanceCount = 0; // Not the same as Model::Instance count. Model keeps the total instance count, while the binary format has a concept of meshes and submeshes, and the instance count there is the mesh instance count.
     };
 }
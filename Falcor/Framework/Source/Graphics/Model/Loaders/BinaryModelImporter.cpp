@@ -39,6 +39,9 @@
 #include "API/Texture.h"
 #include "Graphics/Material/Material.h"
 #include "API/Device.h"
+#include "Utils/TaskScheduler.h"
+#include "Utils/CpuTimer.h"
+#include <algorithm>
 #include <numeric>
 #include <cstring>
 
@@ -49,7 +52,8 @@ namespace Falcor
         uint32_t width  = 0;
         uint32_t height = 0;
         ResourceFormat format = ResourceFormat::Unknown;
-        std::vector<uint8_t> data;
+        const uint8_t* pData = nullptr;     ///< Points into the mapped file, or into storage
+        std::vector<uint8_t> storage;       ///< Only for images that had to be converted
         std::string name;
     };
 
@@ -82,7 +86,8 @@ namespace Falcor
 
     template<typename posType>
     void generateSubmeshTangentData(
-        const std::vector<uint32_t>& indices,
+        const uint32_t* indices,
+        uint32_t indexCount,
         uint32_t vertexCount,
         const posType* vertexPosData,
         const glm::vec3* vertexNormalData,
@@ -93,7 +98,7 @@ namespace Falcor
         std::memset(bitangentData, 0, vertexCount * sizeof(vec3));
 
         // calculate the tangent and bitangent for every face
-        size_t primCount = indices.size() / 3;
+        size_t primCount = indexCount / 3;
         for(size_t primID = 0; primID < primCount; primID++)
         {
             struct Data
@@ -352,17 +357,15 @@ namespace Falcor
         }
     }
 
-    std::string readString(BinaryFileStream& stream)
+    std::string readString(BinaryMemoryStream& stream)
     {
-        int32_t length;
+        int32_t length = 0;
         stream >> length;
-        std::vector<char> charVec(length + 1);
-        stream.read(&charVec[0], length);
-        charVec[length] = 0;
-        return std::string(charVec.data());
+        const char* pChars = (const char*)stream.getSpan(std::max(length, 0));
+        return pChars ? std::string(pChars, length) : std::string();
     }
 
-    bool loadBinaryTextureData(BinaryFileStream& stream, const std::string& modelName, TextureData& data)
+    bool loadBinaryTextureData(BinaryMemoryStream& stream, const std::string& modelName, uint32_t fileVersion, TextureData& data)
     {
         // ImageHeader.
         char tag[9];
@@ -442,76 +445,215 @@ namespace Falcor
             formatId = format.getID();
         data.format = getTextureFormat(FW::ImageFormat::ID(formatId));
 
-        // Image data.
+        // Image data. Version 9 aligns it, so it can be used in place.
         const int32_t texelCount = data.width * data.height;
         if(dataSize == -1)
         {
             dataSize = bpp * texelCount;
         }
-        size_t storageSize = dataSize;
-        if(bpp == 3)
-            storageSize = 4 * texelCount;
+        if(fileVersion >= 9)
+        {
+            stream.align(16);
+        }
 
-        data.data.resize(storageSize);
-        stream.read(data.data.data(), dataSize);
+        // The top level is all that's uploaded
+        uint32_t rowCount = (data.height + getFormatHeightCompressionRatio(data.format) - 1) / getFormatHeightCompressionRatio(data.format);
+        uint32_t blocksPerRow = (data.width + getFormatWidthCompressionRatio(data.format) - 1) / getFormatWidthCompressionRatio(data.format);
+        size_t levelSize = size_t(rowCount) * blocksPerRow * ((bpp == 3) ? 3 : getFormatBytesPerBlock(data.format));
+        const uint8_t* pSrc = stream.getSpan(dataSize);
+        if(pSrc == nullptr || size_t(dataSize) < levelSize)
+        {
+            std::string msg = "Error when loading model " + modelName + ".\nBinary image data is truncated.";
+            logError(msg);
+            return false;
+        }
 
         // Convert 3-channel 8-bits RGB formats to 4-channel RGBX by adding padding
         if(bpp == 3)
         {
-            for(int32_t i=texelCount-1;i>=0;--i)
+            data.storage.resize(4 * texelCount);
+            for(int32_t i = 0; i < texelCount; i++)
             {
-                data.data[i * 4 + 0] = data.data[i * 3 + 0];
-                data.data[i * 4 + 1] = data.data[i * 3 + 1];
-                data.data[i * 4 + 2] = data.data[i * 3 + 2];
-                data.data[i * 4 + 3] = 0xff;
+                data.storage[i * 4 + 0] = pSrc[i * 3 + 0];
+                data.storage[i * 4 + 1] = pSrc[i * 3 + 1];
+                data.storage[i * 4 + 2] = pSrc[i * 3 + 2];
+                data.storage[i * 4 + 3] = 0xff;
             }
+            data.pData = data.storage.data();
+        }
+        else
+        {
+            data.pData = pSrc;
         }
 
         return true;
     }
 
-    bool importTextures(std::vector<TextureData>& textures, uint32_t textureCount, BinaryFileStream& stream, const std::string& modelName)
+    bool importTexture(BinaryMemoryStream& stream, const std::string& modelName, uint32_t fileVersion, TextureData& data)
     {
-        textures.assign(textureCount, TextureData());
+        data.name = readString(stream);
+        return loadBinaryTextureData(stream, modelName, fileVersion, data);
+    }
+
+    /** A binary model file parsed in place. Payloads point into the mapped file where its layout allows, so the file is kept
+        mapped until the model is created.
+    */
+    class BinaryModelImporter::FileData : public ModelFileData
+    {
+    public:
+        FileData(const std::string& filename, const std::string& fullpath, Model::LoadFlags flags) : fullpath(fullpath), flags(flags) { mFilename = filename; }
+
+        struct BufferData
+        {
+            const uint8_t* pData = nullptr;         ///< Points into the mapped file, or into storage
+            std::vector<uint8_t> storage;           ///< Only for attributes that had to be de-interleaved
+            bool shouldSkip = false;
+            uint32_t elementSize = 0;
+        };
+
+        struct SubmeshData
+        {
+            glm::vec4 diffuse;
+            glm::vec3 specular;
+            float glossiness = 0;
+            bool hasDisplacement = false;
+            float displacementCoeff = 0;
+            float displacementBias = 0;
+            std::vector<int32_t> texIDs;            ///< One per texture slot, -1 if the slot is empty
+            const uint32_t* pIndices = nullptr;     ///< Points into the mapped file, or into indexStorage if it wasn't aligned
+            uint32_t indexCount = 0;
+            std::vector<uint32_t> indexStorage;
+            std::vector<glm::vec3> bitangents;      ///< Only if the mesh needs tangent space generated
+            BoundingBox box;
+        };
+
+        struct MeshData
+        {
+            VertexLayout::SharedPtr pLayout;
+            uint32_t vertexCount = 0;
+            std::vector<BufferData> buffers;        ///< One per attribute in the file
+            bool genTangents = false;               ///< If set, the last buffer in pLayout holds bitangents generated per submesh
+            uint32_t textureSet = 0;                ///< Index into textureSets
+            uint32_t positionBuffer = kInvalidOffset;
+            uint32_t normalBuffer = kInvalidOffset;
+            uint32_t texCoordBuffer = kInvalidOffset;
+            std::vector<SubmeshData> submeshes;
+        };
+
+        struct InstanceData
+        {
+            uint32_t meshIdx;
+            glm::mat4 transformation;
+        };
 
-        bool success = true;
-        for(uint32_t i = 0; i < textureCount; i++)
+        std::string fullpath;
+        Model::LoadFlags flags;
+        uint32_t version = 0;
+        MemoryMappedFile::SharedPtr pFile;
+        std::vector<std::vector<TextureData>> textureSets;     ///< Versions 6 and up share one set between all meshes, older versions have one per mesh
+        std::vector<MeshData> meshes;
+        std::vector<InstanceData> instances;                   ///< Enabled instances. Older versions have one instance per submesh instead.
+
+        /** Bytes of payload held in storage rather than pointing into the file
+        */
+        uint64_t getCopiedBytes() const
         {
-            textures[i].name = readString(stream);
-            if(loadBinaryTextureData(stream, modelName, textures[i]) == false)
+            uint64_t bytes = 0;
+            for (const auto& set : textureSets)
             {
-                success = false;
-                break;
+                for (const TextureData& texture : set) bytes += texture.storage.size();
             }
+            for (const MeshData& mesh : meshes)
+            {
+                for (const BufferData& buffer : mesh.buffers) bytes += buffer.storage.size();
+                for (const SubmeshData& submesh : mesh.submeshes) bytes += submesh.indexStorage.size() * sizeof(uint32_t);
+            }
+            return bytes;
         }
 
-        // Flush upload heap after every material so we don't accumulate a ton of memory usage when loading a model with a lot of textures
-        gpDevice->flushAndSync();
-        return success;
-    }
+    protected:
+        friend class BinaryModelImporter;
 
-    BinaryModelImporter::BinaryModelImporter(const std::string& fullpath) : mModelName(fullpath), mStream(fullpath.c_str(), BinaryFileStream::Mode::Read)
+        bool createModel(Model& model) override
+        {
+            BinaryModelImporter loader(fullpath);
+            return loader.createModel(model, *this);
+        }
+    };
+
+    BinaryModelImporter::BinaryModelImporter(const std::string& fullpath) : mModelName(fullpath)
     {
     }
 
-    bool BinaryModelImporter::import(Model& model, const std::string& filename, Model::LoadFlags flags)
+    ModelFileData::UniquePtr BinaryModelImporter::parse(const std::string& filename, Model::LoadFlags flags)
     {
         std::string fullpath;
         if(findFileInDataDirectories(filename, fullpath) == false)
         {
             logError(std::string("Can't find model file ") + filename);
-            return false;
+            return nullptr;
         }
 
+        std::unique_ptr<FileData> pData(new FileData(filename, fullpath, flags));
+        pData->pFile = MemoryMappedFile::create(fullpath);
         BinaryModelImporter loader(fullpath);
-        return loader.importModel(model, flags);
+        if(pData->pFile == nullptr || loader.parseModel(*pData) == false)
+        {
+            return nullptr;
+        }
+        return std::move(pData);
+    }
+
+    BinaryModelImporter::Benchmark BinaryModelImporter::benchmark(const std::string& filename, uint32_t iterations)
+    {
+        Benchmark result;
+        std::string fullpath;
+        if(findFileInDataDirectories(filename, fullpath) == false)
+        {
+            logError(std::string("Can't find model file ") + filename);
+            return result;
+        }
+
+        // Parse the file once, the way <mapped> selects, and return how long it took
+        auto run = [&](bool mapped, bool measureMemory) -> float
+        {
+            uint64_t residentBefore = getProcessWorkingSet();
+            uint64_t peakBefore = getProcessPeakWorkingSet();
+            CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+
+            FileData data(filename, fullpath, Model::LoadFlags::None);
+            data.pFile = mapped ? MemoryMappedFile::create(fullpath) : MemoryMappedFile::createFromStream(fullpath);
+            BinaryModelImporter loader(fullpath);
+            bool success = data.pFile && loader.parseModel(data);
+            float ms = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+
+            if(success && measureMemory)
+            {
+                uint64_t resident = getProcessWorkingSet() - std::min(residentBefore, getProcessWorkingSet());
+                uint64_t peak = getProcessPeakWorkingSet() - peakBefore;
+                (mapped ? result.mappedResidentBytes : result.streamResidentBytes) = resident;
+                (mapped ? result.mappedPeakBytes : result.streamPeakBytes) = peak;
+                result.version = data.version;
+                result.fileBytes = data.pFile->getSize();
+                if(mapped) result.copiedBytes = data.getCopiedBytes();
+            }
+            return success ? ms : 0.f;
+        };
+
+        iterations = std::max(iterations, 1u);
+        for(uint32_t i = 0; i < iterations; i++)
+        {
+            result.mappedMs += run(true, i == 0) / float(iterations);
+            result.streamMs += run(false, i == 0) / float(iterations);
+        }
+        return result;
     }
 
     static bool checkVersion(const std::string& formatID, uint32_t version, const std::string& modelName)
     {
         if(std::string(formatID) == "BinScene")
         {
-            if(version < 6 || version > 8)
+            if(version < 6 || version > 9)
             {
                 std::string Msg = "Error when loading model " + modelName + ".\nUnsupported binary scene version " + std::to_string(version);
                 logError(Msg);
@@ -554,305 +696,593 @@ namespace Falcor
         }
     }
     
-    bool BinaryModelImporter::importModel(Model& model, Model::LoadFlags flags)
+    bool BinaryModelImporter::parseModel(FileData& data)
     {
+        CpuTimer::TimePoint parseStart = CpuTimer::getCurrentTimePoint();
+        BinaryMemoryStream stream(data.pFile->getData(), data.pFile->getSize());
+
         // Format ID and version.
         char formatID[9];
-        mStream.read(formatID, 8);
+        stream.read(formatID, 8);
         formatID[8] = '\0';
 
         uint32_t version;
-        mStream >> version;
+        stream >> version;
 
         // Check if the version matches
         if(checkVersion(formatID, version, mModelName) == false)
         {
             return false;
         }
-
-        int numTextureSlots;
-        int numAttributesType = AttribType_AORadius + 1;
+        data.version = version;
+        mHeader.version = version;
+        mHeader.numAttribTypes = AttribType_AORadius + 1;
 
         switch(version)
         {
-        case 1:     numTextureSlots = 0; break;
-        case 2:     numTextureSlots = TextureType_Alpha + 1; break;
-        case 3:     numTextureSlots = TextureType_Displacement + 1; break;
-        case 4:     numTextureSlots = TextureType_Environment + 1; break;
-        case 5:     numTextureSlots = TextureType_Specular + 1; break;
-        case 6:     numTextureSlots = TextureType_Specular + 1; break;
-        case 7:     numTextureSlots = TextureType_Glossiness + 1; break;
-        case 8:     numTextureSlots = TextureType_Glossiness + 1; numAttributesType = AttribType_Max; break;
+        case 1:     mHeader.numTextureSlots = 0; break;
+        case 2:     mHeader.numTextureSlots = TextureType_Alpha + 1; break;
+        case 3:     mHeader.numTextureSlots = TextureType_Displacement + 1; break;
+        case 4:     mHeader.numTextureSlots = TextureType_Environment + 1; break;
+        case 5:     mHeader.numTextureSlots = TextureType_Specular + 1; break;
+        case 6:     mHeader.numTextureSlots = TextureType_Specular + 1; break;
+        case 7:     mHeader.numTextureSlots = TextureType_Glossiness + 1; break;
+        case 8:
+        case 9:     mHeader.numTextureSlots = TextureType_Glossiness + 1; mHeader.numAttribTypes = AttribType_Max; break;
         default:
             should_not_get_here();
             return false;
         }
 
-
         // File header
-        int32_t numTextures = 0;
-        int32_t numMeshes = 0;
-        int32_t numInstances = 0;
-        int32_t numAttribs_v5 = 0;
-        int32_t numVertices_v5 = 0;
-        int32_t numSubmeshes_v5 = 0;
-
         if(version >= 6)
         {
-            mStream >> numTextures >> numMeshes >> numInstances;
+            stream >> mHeader.numTextures >> mHeader.numMeshes >> mHeader.numInstances;
         }
         else
         {
-            numMeshes = 1;
-            numInstances = 1;
-            mStream >> numAttribs_v5 >> numVertices_v5 >> numSubmeshes_v5;
+            mHeader.numMeshes = 1;
+            mHeader.numInstances = 1;
+            stream >> mHeader.numAttribs_v5 >> mHeader.numVertices_v5 >> mHeader.numSubmeshes_v5;
             if(version >= 2)
             {
-                mStream >> numTextures;
+                stream >> mHeader.numTextures;
             }
         }
 
-        if(numTextures < 0 || numMeshes < 0 || numInstances < 0)
+        if(stream.isFail() || mHeader.numTextures < 0 || mHeader.numMeshes < 0 || mHeader.numInstances < 0)
         {
             std::string msg = "Error when loading model " + mModelName + ".\nFile is corrupted.";
             logError(msg);
             return false;
         }
 
-        // create objects
-        bool shouldGenerateTangents = is_set(flags, Model::LoadFlags::DontGenerateTangentSpace) == false;
-
-        std::vector<TextureData> texData;
-
-        if(version >= 6)
+        data.meshes.resize(mHeader.numMeshes);
+        if(version >= 9)
         {
-            importTextures(texData, numTextures, mStream, mModelName);
+            // Sections are found through the table of contents, and parsed in parallel
+            if(parseSections(stream, data) == false)
+            {
+                return false;
+            }
         }
-
-        // This file format has a concept of sub-meshes, which Falcor model doesn't have - Falcor creates a new mesh for each sub-mesh
-        // When creating instances of meshes, it means we need to translate the original mesh index to all it's submeshes Falcor IDs. This is what the next 2 variables are for.
-        std::vector<std::vector<uint32_t>> meshToSubmeshesID(numMeshes);
-
-        // This importer loads mesh/submesh data before instance data, so the meshes are cached here.
-        std::vector<Mesh::SharedPtr> falcorMeshCache;
-        
-        struct TexSignature
+        else
         {
-            const uint8_t* pData;
-            ResourceFormat format;
-            bool operator<(const TexSignature& other) const 
-            { 
-                if(pData < other.pData) return true;
-                if(pData == other.pData) return format < other.format;
+            if(version >= 6 && parseTextureSet(stream, data) == false)
+            {
                 return false;
             }
-            bool operator==(const TexSignature& other) const { return pData == other.pData || format == other.format; }
-        };
-        std::map<TexSignature, Texture::SharedPtr> textures;
-        bool loadTexAsSrgb = !is_set(flags, Model::LoadFlags::AssumeLinearSpaceTextures);
-
-        // Load the meshes
-        for(int meshIdx = 0; meshIdx < numMeshes; meshIdx++)
-        {
-            // Mesh header
-            int32_t numAttribs = 0;
-            int32_t numVertices = 0;
-            int32_t numSubmeshes = 0;
 
-            if(version >= 6)
+            for(int32_t meshIdx = 0; meshIdx < mHeader.numMeshes; meshIdx++)
             {
-                mStream >> numAttribs >> numVertices >> numSubmeshes;
+                if(parseMesh(stream, data, meshIdx) == false)
+                {
+                    return false;
+                }
             }
-            else
+
+            if(version >= 6 && parseInstances(stream, data) == false)
             {
-                numAttribs = numAttribs_v5;
-                numVertices = numVertices_v5;
-                numSubmeshes = numSubmeshes_v5;
+                return false;
             }
+        }
 
-            if(numAttribs < 0 || numVertices < 0 || numSubmeshes < 0)
+        // Version 9 decodes textures in parallel, so their summed time can exceed the wall clock time
+        data.mTimes.parseMs = std::max(0.f, CpuTimer::calcDuration(parseStart, CpuTimer::getCurrentTimePoint()) - data.mTimes.decodeMs);
+        generateTangents(data);
+        return true;
+    }
+
+    bool BinaryModelImporter::parseTextureSet(BinaryMemoryStream& stream, FileData& data)
+    {
+        CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+        data.textureSets.emplace_back(mHeader.numTextures);
+        for(TextureData& texture : data.textureSets.back())
+        {
+            if(importTexture(stream, mModelName, mHeader.version, texture) == false)
             {
-                std::string Msg = "Error when loading model " + mModelName + ".\nCorrupted data.!";
-                logError(Msg);
                 return false;
             }
+        }
+        data.mTimes.decodeMs += CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+        data.mTimes.textureCount += mHeader.numTextures;
+        return true;
+    }
+
+    bool BinaryModelImporter::parseSections(BinaryMemoryStream& stream, FileData& data)
+    {
+        struct TocEntry
+        {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        // Table of contents: textures, then meshes, then the instance array
+        int32_t padding[2];
+        stream >> padding;
+        uint32_t sectionCount = mHeader.numTextures + mHeader.numMeshes + 1;
+        const uint8_t* pToc = stream.getSpan(sectionCount * sizeof(TocEntry));
+        std::vector<TocEntry> toc(sectionCount);
+        if(pToc)
+        {
+            std::memcpy(toc.data(), pToc, toc.size() * sizeof(TocEntry));
+        }
 
-            Vao::BufferVec pVBs;
-            VertexLayout::SharedPtr pLayout = VertexLayout::create();
-            
-            struct BufferData
+        bool valid = (pToc != nullptr);
+        for(const TocEntry& entry : toc)
+        {
+            valid = valid && (entry.offset % 16 == 0) && (entry.offset <= data.pFile->getSize()) && (entry.size <= data.pFile->getSize() - entry.offset);
+        }
+        if(valid == false)
+        {
+            std::string msg = "Error when loading model " + mModelName + ".\nCorrupt table of contents.";
+            logError(msg);
+            return false;
+        }
+
+        // Each section has its own stream, so textures and meshes don't depend on each other
+        auto getSectionStream = [&](uint32_t section)
+        {
+            return BinaryMemoryStream(data.pFile->getData(), size_t(toc[section].offset + toc[section].size), size_t(toc[section].offset));
+        };
+
+        std::vector<uint8_t> success(sectionCount, 0);
+        std::vector<float> times(mHeader.numTextures);
+        data.textureSets.emplace_back(mHeader.numTextures);
+        TaskScheduler::getGlobal()->parallelFor(0, sectionCount - 1, [&](uint32_t begin, uint32_t end)
+        {
+            for(uint32_t section = begin; section < end; section++)
             {
-                std::vector<uint8_t> vec;
-                bool shouldSkip = false;
-                uint32_t elementSize = 0;
-            };
+                BinaryMemoryStream sectionStream = getSectionStream(section);
+                if(section < uint32_t(mHeader.numTextures))
+                {
+                    CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+                    success[section] = importTexture(sectionStream, mModelName, mHeader.version, data.textureSets[0][section]);
+                    times[section] = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+                }
+                else
+                {
+                    success[section] = parseMesh(sectionStream, data, section - mHeader.numTextures);
+                }
+            }
+        }, 1);
+
+        for(float t : times) data.mTimes.decodeMs += t;
+        data.mTimes.textureCount += mHeader.numTextures;
 
-            std::vector<BufferData> buffers;
-            pVBs.resize(numAttribs);
-            buffers.resize(numAttribs);
+        BinaryMemoryStream instanceStream = getSectionStream(sectionCount - 1);
+        success.back() = parseInstances(instanceStream, data);
+        return std::find(success.begin(), success.end(), 0) == success.end();
+    }
+
+    bool BinaryModelImporter::parseMesh(BinaryMemoryStream& stream, FileData& data, uint32_t meshIdx)
+    {
+        const uint32_t version = mHeader.version;
+        FileData::MeshData& mesh = data.meshes[meshIdx];
 
-            const uint32_t kInvalidBufferIndex = (uint32_t)-1;
-            uint32_t positionBufferIndex = kInvalidBufferIndex;
-            uint32_t normalBufferIndex = kInvalidBufferIndex;
-            uint32_t bitangentBufferIndex = kInvalidBufferIndex;
-            uint32_t texCoordBufferIndex = kInvalidBufferIndex;
+        // Mesh header
+        int32_t numAttribs = 0;
+        int32_t numVertices = 0;
+        int32_t numSubmeshes = 0;
+
+        if(version >= 6)
+        {
+            stream >> numAttribs >> numVertices >> numSubmeshes;
+        }
+        else
+        {
+            numAttribs = mHeader.numAttribs_v5;
+            numVertices = mHeader.numVertices_v5;
+            numSubmeshes = mHeader.numSubmeshes_v5;
+        }
+
+        if(stream.isFail() || numAttribs < 0 || numVertices < 0 || numSubmeshes < 0)
+        {
+            std::string Msg = "Error when loading model " + mModelName + ".\nCorrupted data.!";
+            logError(Msg);
+            return false;
+        }
+
+        mesh.vertexCount = numVertices;
+        mesh.pLayout = VertexLayout::create();
+        VertexLayout::SharedPtr& pLayout = mesh.pLayout;
+        std::vector<FileData::BufferData>& buffers = mesh.buffers;
+        buffers.resize(numAttribs);
+        uint32_t bitangentBufferIndex = kInvalidOffset;
+        uint32_t vertexSize = 0;
+
+        for(int i = 0; i < numAttribs; i++)
+        {
+            VertexBufferLayout::SharedPtr pBufferLayout = VertexBufferLayout::create();
+            pLayout->addBufferLayout(i, pBufferLayout);
+            int32_t type, format, length;
+            stream >> type >> format >> length;
 
-            for(int i = 0; i < numAttribs; i++)
+            if(type < 0 || type >= mHeader.numAttribTypes || format < 0 || format >= AttribFormat::AttribFormat_Max || length < 1 || length > 4)
             {
-                VertexBufferLayout::SharedPtr pBufferLayout = VertexBufferLayout::create();
-                pLayout->addBufferLayout(i, pBufferLayout);
-                int32_t type, format, length;
-                mStream >> type >> format >> length;
+                std::string msg = "Error when loading model " + mModelName + ".\nCorrupted data.!";
+                logError(msg);
+                return false;
+            }
+            else
+            {
+                const std::string falcorName = getSemanticName(AttribType(type));
+                ResourceFormat falcorFormat = getFalcorFormat(AttribFormat(format), length);
+                uint32_t shaderLocation = getShaderLocation(AttribType(type));
 
-                if(type < 0 || type >= numAttributesType || format < 0 || format >= AttribFormat::AttribFormat_Max || length < 1 || length > 4)
+                switch (shaderLocation)
                 {
-                    std::string msg = "Error when loading model " + mModelName + ".\nCorrupted data.!";
-                    logError(msg);
-                    return false;
+                case VERTEX_POSITION_LOC:
+                    mesh.positionBuffer = i;
+                    assert(falcorFormat == ResourceFormat::RGB32Float || falcorFormat == ResourceFormat::RGBA32Float);
+                    break;
+                case VERTEX_NORMAL_LOC:
+                    mesh.normalBuffer = i;
+                    assert(falcorFormat == ResourceFormat::RGB32Float);
+                    break;
+                case VERTEX_BITANGENT_LOC:
+                    bitangentBufferIndex = i;
+                    assert(falcorFormat == ResourceFormat::RGB32Float);
+                    break;
+                case VERTEX_TEXCOORD_LOC:
+                    mesh.texCoordBuffer = i;
+                    break;
+                }
+
+                buffers[i].elementSize = getFormatBytesPerBlock(falcorFormat);
+                vertexSize += buffers[i].elementSize;
+                if(shaderLocation != kUnusedShaderElement)
+                {
+                    pBufferLayout->addElement(falcorName, 0, falcorFormat, 1, shaderLocation);
                 }
                 else
                 {
-                    const std::string falcorName = getSemanticName(AttribType(type));
-                    ResourceFormat falcorFormat = getFalcorFormat(AttribFormat(format), length);
-                    uint32_t shaderLocation = getShaderLocation(AttribType(type));
+                    buffers[i].shouldSkip = true;
+                }
+            }
+        }
 
-                    switch (shaderLocation)
-                    {
-                    case VERTEX_POSITION_LOC:
-                        positionBufferIndex = i;
-                        assert(falcorFormat == ResourceFormat::RGB32Float || falcorFormat == ResourceFormat::RGBA32Float);
-                        break;
-                    case VERTEX_NORMAL_LOC:
-                        normalBufferIndex = i;
-                        assert(falcorFormat == ResourceFormat::RGB32Float);
-                        break;
-                    case VERTEX_BITANGENT_LOC:
-                        bitangentBufferIndex = i;
-                        assert(falcorFormat == ResourceFormat::RGB32Float);
-                        break;
-                    case VERTEX_TEXCOORD_LOC:
-                        texCoordBufferIndex = i;
-                        break;
-                    }
+        if(mesh.positionBuffer == kInvalidOffset)
+        {
+            std::string msg = "Error when loading model " + mModelName + ".\nMesh " + std::to_string(meshIdx) + " has no positions.";
+            logError(msg);
+            return false;
+        }
 
-                    buffers[i].elementSize = getFormatBytesPerBlock(falcorFormat);
-                    if(shaderLocation != kUnusedShaderElement)
+        // Check if we need to generate tangents  
+        bool shouldGenerateTangents = is_set(data.flags, Model::LoadFlags::DontGenerateTangentSpace) == false;
+        if(shouldGenerateTangents && (bitangentBufferIndex == kInvalidOffset))
+        {
+            if(mesh.normalBuffer == kInvalidOffset)
+            {
+                logWarning("Can't generate tangent space for mesh " + std::to_string(meshIdx) + " when loading model " + mModelName + ".\nMesh doesn't contain normals coordinates\n");
+                mesh.genTangents = false;
+            }
+            else
+            {
+                // Add a layout for the buffer createModel() will fill with the generated bitangents
+                mesh.genTangents = true;
+                auto pBitangentLayout = VertexBufferLayout::create();
+                pLayout->addBufferLayout(numAttribs, pBitangentLayout);
+                pBitangentLayout->addElement(VERTEX_BITANGENT_NAME, 0, ResourceFormat::RGB32Float, 1, VERTEX_BITANGENT_LOC);
+            }
+        }
+
+        // Read the vertices
+        if(version >= 9)
+        {
+            // One aligned array per attribute, used in place
+            for(FileData::BufferData& buffer : buffers)
+            {
+                stream.align(16);
+                buffer.pData = stream.getSpan(size_t(buffer.elementSize) * numVertices);
+            }
+        }
+        else
+        {
+            // Attributes are interleaved. De-interleave them into one buffer each, unless there's only one.
+            const uint8_t* pVertices = stream.getSpan(size_t(vertexSize) * numVertices);
+            uint32_t attribOffset = 0;
+            for(FileData::BufferData& buffer : buffers)
+            {
+                if(pVertices && buffer.shouldSkip == false)
+                {
+                    if(buffer.elementSize == vertexSize && (uintptr_t(pVertices) % sizeof(float)) == 0)
                     {
-                        pBufferLayout->addElement(falcorName, 0, falcorFormat, 1, shaderLocation);
-                        buffers[i].vec.resize(buffers[i].elementSize * numVertices);
+                        buffer.pData = pVertices;
                     }
                     else
                     {
-                        buffers[i].shouldSkip = true;
+                        buffer.storage.resize(size_t(buffer.elementSize) * numVertices);
+                        for(int32_t v = 0; v < numVertices; v++)
+                        {
+                            std::memcpy(buffer.storage.data() + size_t(v) * buffer.elementSize, pVertices + size_t(v) * vertexSize + attribOffset, buffer.elementSize);
+                        }
+                        buffer.pData = buffer.storage.data();
                     }
                 }
+                attribOffset += buffer.elementSize;
+            }
+        }
+
+        if(stream.isFail())
+        {
+            std::string msg = "Error when loading model " + mModelName + ".\nVertex data is truncated.";
+            logError(msg);
+            return false;
+        }
+
+        if(version <= 5 && parseTextureSet(stream, data) == false)
+        {
+            return false;
+        }
+        mesh.textureSet = uint32_t(data.textureSets.size() - 1);
+
+        // Array of Submesh.
+        mesh.submeshes.resize(numSubmeshes);
+        for(int submeshIdx = 0; submeshIdx < numSubmeshes; submeshIdx++)
+        {
+            FileData::SubmeshData& submesh = mesh.submeshes[submeshIdx];
+            if(version >= 9)
+            {
+                stream.align(16);
             }
 
-            
-            // Check if we need to generate tangents  
-            bool genTangentForMesh = false;
-            if(shouldGenerateTangents && (bitangentBufferIndex == kInvalidBufferIndex))
+            glm::vec3 ambient;
+            stream >> ambient >> submesh.diffuse >> submesh.specular >> submesh.glossiness;
+            submesh.diffuse.w = 1 - submesh.diffuse.w;
+
+            if(version >= 3)
             {
-                if(normalBufferIndex == kInvalidBufferIndex)
+                submesh.hasDisplacement = true;
+                stream >> submesh.displacementCoeff >> submesh.displacementBias;
+            }
+
+            submesh.texIDs.resize(mHeader.numTextureSlots);
+            for(int i = 0; i < mHeader.numTextureSlots; i++)
+            {
+                int32_t texID;
+                stream >> texID;
+                if(texID < -1 || texID >= mHeader.numTextures)
                 {
-                    logWarning("Can't generate tangent space for mesh " + std::to_string(meshIdx) + " when loading model " + mModelName + ".\nMesh doesn't contain normals coordinates\n");
-                    genTangentForMesh = false;
+                    std::string msg = "Error when loading model " + mModelName + ".\nCorrupt binary mesh data!";
+                    logError(msg);
+                    return false;
                 }
-                else
+                submesh.texIDs[i] = texID;
+            }
+
+            int32_t numTriangles = 0;
+            stream >> numTriangles;
+            if(numTriangles < 0)
+            {
+                std::string Msg = "Error when loading model " + mModelName + ".\nMesh has negative number of triangles!";
+                logError(Msg);
+                return false;
+            }
+
+            // Indices are used in place if they are aligned, which version 9 guarantees
+            submesh.indexCount = numTriangles * 3;
+            size_t ibSize = size_t(submesh.indexCount) * sizeof(uint32_t);
+            const uint8_t* pIndices = stream.getSpan(ibSize);
+            if(pIndices == nullptr)
+            {
+                std::string Msg = "Error when loading model " + mModelName + ".\nIndex data is truncated.";
+                logError(Msg);
+                return false;
+            }
+            if(uintptr_t(pIndices) % sizeof(uint32_t) == 0)
+            {
+                submesh.pIndices = (const uint32_t*)pIndices;
+            }
+            else
+            {
+                submesh.indexStorage.resize(submesh.indexCount);
+                std::memcpy(submesh.indexStorage.data(), pIndices, ibSize);
+                submesh.pIndices = submesh.indexStorage.data();
+            }
+
+            // Calculate the bounding-box
+            glm::vec3 max, min;
+            const FileData::BufferData& positions = buffers[mesh.positionBuffer];
+            for(uint32_t i = 0; i < submesh.indexCount; i++)
+            {
+                uint32_t vertexID = submesh.pIndices[i];
+                if(vertexID >= uint32_t(numVertices))
                 {
-                    // Set the offsets
-                    genTangentForMesh = true;
-                    bitangentBufferIndex = (uint32_t)pVBs.size();
-                    pVBs.resize(bitangentBufferIndex + 1);
-                    buffers.resize(bitangentBufferIndex + 1);
-                   
-                    auto pBitangentLayout = VertexBufferLayout::create();
-                    pLayout->addBufferLayout(bitangentBufferIndex, pBitangentLayout);
-                    pBitangentLayout->addElement(VERTEX_BITANGENT_NAME, 0, ResourceFormat::RGB32Float, 1, VERTEX_BITANGENT_LOC);
-                    buffers[bitangentBufferIndex].vec.resize(sizeof(glm::vec3) * numVertices);
+                    std::string Msg = "Error when loading model " + mModelName + ".\nIndex out of range.";
+                    logError(Msg);
+                    return false;
                 }
+                const float* pPosition = (const float*)(positions.pData + positions.elementSize * vertexID);
+
+                glm::vec3 xyz(pPosition[0], pPosition[1], pPosition[2]);
+                min = glm::min(min, xyz);
+                max = glm::max(max, xyz);
             }
-            
+            submesh.box = BoundingBox::fromMinMax(min, max);
+        }
+        return true;
+    }
 
-            // Read the data, one vertex at a time
-            for(int32_t i = 0; i < numVertices; i++)
+    bool BinaryModelImporter::parseInstances(BinaryMemoryStream& stream, FileData& data)
+    {
+        for(int32_t instanceID = 0; instanceID < mHeader.numInstances; instanceID++)
+        {
+            int32_t meshIdx = 0;
+            int32_t enabled = 1;
+            glm::mat4 transformation;
+
+            stream >> meshIdx >> enabled >> transformation;
+            //m_Stream >> inst.name >> inst.metadata;
+            readString(stream);   // Name
+            readString(stream);   // Meta-data
+
+            if(stream.isFail() || meshIdx < -1 || meshIdx >= mHeader.numMeshes)
+            {
+                std::string msg = "Error when loading model " + mModelName + ".\nCorrupt instance data.";
+                logError(msg);
+                return false;
+            }
+
+            if(enabled && meshIdx >= 0)
+            {
+                data.instances.push_back({ uint32_t(meshIdx), transformation });
+            }
+        }
+        return true;
+    }
+
+    void BinaryModelImporter::generateTangents(FileData& data)
+    {
+        // Submeshes that need tangent space. They are independent, so they can be done in parallel.
+        struct TangentJob
+        {
+            const FileData::MeshData* pMesh;
+            FileData::SubmeshData* pSubmesh;
+        };
+        std::vector<TangentJob> tangentJobs;
+        for(FileData::MeshData& mesh : data.meshes)
+        {
+            if(mesh.genTangents == false) continue;
+            for(FileData::SubmeshData& submesh : mesh.submeshes)
             {
-                for (int32_t attributes = 0; attributes < numAttribs; ++attributes)
+                tangentJobs.push_back({ &mesh, &submesh });
+            }
+        }
+
+        std::vector<float> times(tangentJobs.size());
+        TaskScheduler::getGlobal()->parallelFor(0, uint32_t(tangentJobs.size()), [&](uint32_t begin, uint32_t end)
+        {
+            for(uint32_t j = begin; j < end; j++)
+            {
+                CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+                const FileData::MeshData& mesh = *tangentJobs[j].pMesh;
+                FileData::SubmeshData& submesh = *tangentJobs[j].pSubmesh;
+
+                uint32_t texCrdCount = 0;
+                const glm::vec2* texCrd = nullptr;
+                if(mesh.texCoordBuffer != kInvalidOffset)
                 {
-                    if (buffers[attributes].shouldSkip)
-                    {
-                        mStream.skip(buffers[attributes].elementSize);
-                    }
-                    else
-                    {
-                        uint32_t stride = pLayout->getBufferLayout(attributes)->getStride();
-                        uint8_t* pDest = buffers[attributes].vec.data() + stride * i;
-                        mStream.read(pDest, stride);
-                    }
+                    texCrdCount = mesh.pLayout->getBufferLayout(mesh.texCoordBuffer)->getStride() / sizeof(glm::vec2);
+                    texCrd = (const glm::vec2*)mesh.buffers[mesh.texCoordBuffer].pData;
                 }
+
+                ResourceFormat posFormat = mesh.pLayout->getBufferLayout(mesh.positionBuffer)->getElementFormat(0);
+                const uint8_t* pPositions = mesh.buffers[mesh.positionBuffer].pData;
+                const glm::vec3* normals = (const glm::vec3*)mesh.buffers[mesh.normalBuffer].pData;
+                submesh.bitangents.resize(mesh.vertexCount);
+
+                if (posFormat == ResourceFormat::RGB32Float)
+                {
+                    generateSubmeshTangentData<glm::vec3>(submesh.pIndices, submesh.indexCount, mesh.vertexCount, (const glm::vec3*)pPositions, normals, texCrd, texCrdCount, submesh.bitangents.data());
+                }
+                else if (posFormat == ResourceFormat::RGBA32Float)
+                {
+                    generateSubmeshTangentData<glm::vec4>(submesh.pIndices, submesh.indexCount, mesh.vertexCount, (const glm::vec4*)pPositions, normals, texCrd, texCrdCount, submesh.bitangents.data());
+                }
+                times[j] = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
             }
+        }, 1);
 
-            Buffer::BindFlags vbBindFlags = Buffer::BindFlags::Vertex;
-            if (is_set(flags, Model::LoadFlags::BuffersAsShaderResource))
-            {
-                vbBindFlags |= Buffer::BindFlags::ShaderResource;
+        for(float t : times) data.mTimes.tangentMs += t;
+    }
+
+    bool BinaryModelImporter::createModel(Model& model, const FileData& data)
+    {
+        const Model::LoadFlags flags = data.flags;
+
+        // This file format has a concept of sub-meshes, which Falcor model doesn't have - Falcor creates a new mesh for each sub-mesh
+        // When creating instances of meshes, it means we need to translate the original mesh index to all it's submeshes Falcor IDs. This is what the next 2 variables are for.
+        std::vector<std::vector<uint32_t>> meshToSubmeshesID(data.meshes.size());
+
+        // This importer creates mesh/submesh data before instance data, so the meshes are cached here.
+        std::vector<Mesh::SharedPtr> falcorMeshCache;
+        
+        struct TexSignature
+        {
+            const uint8_t* pData;
+            ResourceFormat format;
+            bool operator<(const TexSignature& other) const 
+            { 
+                if(pData < other.pData) return true;
+                if(pData == other.pData) return format < other.format;
+                return false;
             }
+            bool operator==(const TexSignature& other) const { return pData == other.pData || format == other.format; }
+        };
+        std::map<TexSignature, Texture::SharedPtr> textures;
+        bool loadTexAsSrgb = !is_set(flags, Model::LoadFlags::AssumeLinearSpaceTextures);
+
+        Buffer::BindFlags vbBindFlags = Buffer::BindFlags::Vertex;
+        Buffer::BindFlags ibBindFlags = Buffer::BindFlags::Index;
+        if (is_set(flags, Model::LoadFlags::BuffersAsShaderResource))
+        {
+            vbBindFlags |= Buffer::BindFlags::ShaderResource;
+            ibBindFlags |= Buffer::BindFlags::ShaderResource;
+        }
 
-            for (int32_t i = 0; i < numAttribs; ++i)
+        for(size_t meshIdx = 0; meshIdx < data.meshes.size(); meshIdx++)
+        {
+            const FileData::MeshData& mesh = data.meshes[meshIdx];
+            const std::vector<TextureData>& texData = data.textureSets[mesh.textureSet];
+
+            Vao::BufferVec pVBs(mesh.pLayout->getBufferCount());
+            for (size_t i = 0; i < mesh.buffers.size(); ++i)
             {
-                if(buffers[i].shouldSkip == false)
+                if(mesh.buffers[i].shouldSkip == false)
                 {
-                    pVBs[i] = Buffer::create(buffers[i].vec.size(), vbBindFlags, Buffer::CpuAccess::None, buffers[i].vec.data());
+                    pVBs[i] = Buffer::create(size_t(mesh.buffers[i].elementSize) * mesh.vertexCount, vbBindFlags, Buffer::CpuAccess::None, mesh.buffers[i].pData);
                 }
             }
 
-            if(version <= 5)
+            if(data.version <= 5)
             {
-                importTextures(texData, numTextures, mStream, mModelName);
                 textures.clear();
             }
+            bool createdTextures = false;
 
-            // Array of Submesh.
             // Falcor doesn't have a concept of submeshes, just create a new mesh for each submesh
-            for(int submesh = 0; submesh < numSubmeshes; submesh++)
+            for(const FileData::SubmeshData& submesh : mesh.submeshes)
             {
                 // create the material
                 Material::SharedPtr pMaterial = Material::create("");
-
-                glm::vec3 ambient;
-                glm::vec4 diffuse;
-                glm::vec3 specular;
-                float glossiness;
-
-                mStream >> ambient >> diffuse >> specular >> glossiness;
-                diffuse.w = 1 - diffuse.w;
-                pMaterial->setBaseColor(diffuse);
-                pMaterial->setSpecularParams(vec4(specular, glossiness));
-
-                if(version >= 3)
+                pMaterial->setBaseColor(submesh.diffuse);
+                pMaterial->setSpecularParams(vec4(submesh.specular, submesh.glossiness));
+                if(submesh.hasDisplacement)
                 {
-                    float displacementCoeff;
-                    float displacementBias;
-                    mStream >> displacementCoeff >> displacementBias;
-                    pMaterial->setHeightScaleOffset(displacementCoeff, displacementBias);
+                    pMaterial->setHeightScaleOffset(submesh.displacementCoeff, submesh.displacementBias);
                 }
 
-                for(int i = 0; i < numTextureSlots; i++)
+                for(size_t i = 0; i < submesh.texIDs.size(); i++)
                 {
-                    int32_t texID;
-                    mStream >> texID;
-                    if(texID < -1 || texID >= numTextures)
-                    {
-                        std::string msg = "Error when loading model " + mModelName + ".\nCorrupt binary mesh data!";
-                        logError(msg);
-                        return false;
-                    }
-                    else if(texID != -1)
+                    int32_t texID = submesh.texIDs[i];
+                    if(texID != -1)
                     {
                         // Load the texture
                         TexSignature texSig;
                         texSig.format = getFormatFromMapType(loadTexAsSrgb, texData[texID].format, TextureType(i));
-                        texSig.pData = texData[texID].data.data();
+                        texSig.pData = texData[texID].pData;
                         // Check if we already created a matching texture
                         auto existingTex = textures.find(texSig);
                         if(existingTex != textures.end())
@@ -864,6 +1294,7 @@ namespace Falcor
                             auto pTexture = Texture::create2D(texData[texID].width, texData[texID].height, texSig.format, 1, Texture::kMaxPossible, texSig.pData);
                             pTexture->setSourceFilename(texData[texID].name);
                             textures[texSig] = pTexture;
+                            createdTextures = true;
                             setTexture(pMaterial.get(), pTexture, TextureType(i), mModelName);
                         }
                     }
@@ -872,75 +1303,19 @@ namespace Falcor
                 // Create material and check if it already exists
                 pMaterial = checkForExistingMaterial(pMaterial);
 
-                int32_t numTriangles;
-                mStream >> numTriangles;
-                if(numTriangles < 0)
-                {
-                    std::string Msg = "Error when loading model " + mModelName + ".\nMesh has negative number of triangles!";
-                    logError(Msg);
-                    return false;
-                }
-
                 // create the index buffer
-                uint32_t numIndices = numTriangles * 3;
-                std::vector<uint32_t> indices(numIndices);
-                uint32_t ibSize = 3 * numTriangles * sizeof(uint32_t);
-                mStream.read(&indices[0], ibSize);
-
+                uint32_t ibSize = uint32_t(submesh.indexCount * sizeof(uint32_t));
+                auto pIB = Buffer::create(ibSize, ibBindFlags, Buffer::CpuAccess::None, submesh.pIndices);
 
-                Buffer::BindFlags ibBindFlags = Buffer::BindFlags::Index;
-                if (is_set(flags, Model::LoadFlags::BuffersAsShaderResource))
+                if(mesh.genTangents)
                 {
-                    ibBindFlags |= Buffer::BindFlags::ShaderResource;
+                    pVBs.back() = Buffer::create(submesh.bitangents.size() * sizeof(glm::vec3), Buffer::BindFlags::Vertex, Buffer::CpuAccess::None, submesh.bitangents.data());
                 }
-                auto pIB = Buffer::create(ibSize, ibBindFlags, Buffer::CpuAccess::None, indices.data());
-
-                // Generate tangent space data if needed
-                if(genTangentForMesh)
-                {
-                    uint32_t texCrdCount = 0;
-                    glm::vec2* texCrd = nullptr;
-                    if(texCoordBufferIndex != kInvalidBufferIndex)
-                    {
-                        texCrdCount = pLayout->getBufferLayout(texCoordBufferIndex)->getStride() / sizeof(glm::vec2);
-                        texCrd = (glm::vec2*)buffers[texCoordBufferIndex].vec.data();
-                    }
-
-                    ResourceFormat posFormat = pLayout->getBufferLayout(positionBufferIndex)->getElementFormat(0);
-
-                    if (posFormat == ResourceFormat::RGB32Float)
-                    {
-                        generateSubmeshTangentData<glm::vec3>(indices, numVertices, (glm::vec3*)buffers[positionBufferIndex].vec.data(), (glm::vec3*)buffers[normalBufferIndex].vec.data(), texCrd, texCrdCount, (glm::vec3*)buffers[bitangentBufferIndex].vec.data());
-                    }
-                    else if (posFormat == ResourceFormat::RGBA32Float)
-                    {
-                        generateSubmeshTangentData<glm::vec4>(indices, numVertices, (glm::vec4*)buffers[positionBufferIndex].vec.data(), (glm::vec3*)buffers[normalBufferIndex].vec.data(), texCrd, texCrdCount, (glm::vec3*)buffers[bitangentBufferIndex].vec.data());
-                    }
-
-                    pVBs[bitangentBufferIndex] = Buffer::create(buffers[bitangentBufferIndex].vec.size(), Buffer::BindFlags::Vertex, Buffer::CpuAccess::None, buffers[bitangentBufferIndex].vec.data());
-                }
-                
-
-                // Calculate the bounding-box
-                glm::vec3 max, min;
-                for(uint32_t i = 0; i < numIndices; i++)
-                {
-                    uint32_t vertexID = indices[i];
-                    uint8_t* pVertex = (pLayout->getBufferLayout(positionBufferIndex)->getStride() * vertexID) + buffers[positionBufferIndex].vec.data();
-
-                    float* pPosition = (float*)pVertex;
-
-                    glm::vec3 xyz(pPosition[0], pPosition[1], pPosition[2]);
-                    min = glm::min(min, xyz);
-                    max = glm::max(max, xyz);
-                }
-
-                BoundingBox box = BoundingBox::fromMinMax(min, max);
 
                 // create the mesh
-                auto pMesh = Mesh::create(pVBs, numVertices, pIB, numIndices, pLayout, Vao::Topology::TriangleList, pMaterial, box, false);
+                auto pMesh = Mesh::create(pVBs, mesh.vertexCount, pIB, submesh.indexCount, mesh.pLayout, Vao::Topology::TriangleList, pMaterial, submesh.box, false);
 
-                if (version >= 6)
+                if (data.version >= 6)
                 {
                     falcorMeshCache.push_back(pMesh);
                     meshToSubmeshesID[meshIdx].push_back((uint32_t)(falcorMeshCache.size() - 1));
@@ -950,28 +1325,19 @@ namespace Falcor
                     model.addMeshInstance(pMesh, glm::mat4());
                 }
             }
+
+            // Flush upload heap after every mesh that created textures so we don't accumulate a ton of memory usage when loading a model with a lot of textures
+            if(createdTextures)
+            {
+                gpDevice->flushAndSync();
+            }
         }
 
-        if(version >= 6)
+        for(const FileData::InstanceData& instance : data.instances)
         {
-            for(int32_t instanceID = 0; instanceID < numInstances; instanceID++)
+            for(uint32_t i : meshToSubmeshesID[instance.meshIdx])
             {
-                int32_t meshIdx = 0;
-                int32_t enabled = 1;
-                glm::mat4 transformation;
-
-                mStream >> meshIdx >> enabled >> transformation;
-                //m_Stream >> inst.name >> inst.metadata;
-                readString(mStream);   // Name
-                readString(mStream);   // Meta-data
-
-                if(enabled)
-                {
-                    for(uint32_t i : meshToSubmeshesID[meshIdx])
-                    {
-                        model.addMeshInstance(falcorMeshCache[i], transformation);
-                    }
-                }
+                model.addMeshInstance(falcorMeshCache[i], instance.transformation);
             }
         }
         
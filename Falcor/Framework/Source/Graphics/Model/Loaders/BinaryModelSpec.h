@@ -30,7 +30,7 @@
 //------------------------------------------------------------------------
 /*
 
-Binary scene file format v8
+Binary scene file format v9
 ---------------------------
 
 - The basic units of data are 32-bit little-endian ints and floats.
@@ -38,8 +38,23 @@ Binary scene file format v8
 - Each individual field is marked with the version number where it was introduced.
 - Legacy structs are postfixed with the highest version number for which they are still valid.
 - Each line describes: <ofs_dwords> <size_dwords> <Type> <version> <name> (<comments>)
+- From v9, the vertex, index and image payloads start at file offsets that are multiples of 16 bytes, so they can be used in
+  place from a memory mapped file. "align16" marks zero padding up to the next such offset.
 
 File
+0       2       string8 v9  formatID            ("BinScene")
+2       1       int     v9  formatVersion       (9)
+3       1       int     v9  numTextures
+4       1       int     v9  numMeshes
+5       1       int     v9  numInstances
+6       2       int     v9  padding
+8       n*4     array   v9  TocEntry            (numTextures + numMeshes + 1)
+?       n*?     array   v9  align16 Texture     (numTextures)
+?       n*?     array   v9  align16 Mesh        (numMeshes)
+?       n*?     array   v9  align16 Instance    (numInstances)
+?
+
+File_v8
 0       2       string8 v6  formatID            ("BinScene")
 2       1       int     v6  formatVersion       (6)
 3       1       int     v6  numTextures
@@ -63,10 +78,15 @@ File_v5
 ?       n*?     array   v1  Submesh             (numSubmeshes)
 ?
 
+TocEntry
+0       2       int64   v9  offset              (bytes from the start of the file, a multiple of 16)
+2       2       int64   v9  size                (bytes)
+4
+
 Texture
 0       1       int     v2  idLength
 1       ?       string  v2  idString
-?       ?       struct  v2  BinaryImage         (see ImageBinaryIO.hpp)
+?       ?       struct  v2  BinaryImage         (see ImageBinaryIO.hpp. From v9, the image data is preceded by align16)
 ?
 
 Mesh
@@ -74,6 +94,15 @@ Mesh
 1       1       int     v6  numVertices
 2       1       int     v6  numSubmeshes
 3       n*3     array   v6  AttribSpec          (numAttribs)
+?       n*?     array   v9  align16 Attrib      (numAttribs. Replaces the Vertex array.)
+?       n*?     array   v9  align16 Submesh     (numSubmeshes)
+?
+
+Mesh_v8
+0       1       int     v6  numAttribs
+1       1       int     v6  numVertices
+2       1       int     v6  numSubmeshes
+3       n*3     array   v6  AttribSpec          (numAttribs)
 ?       n*?     array   v6  Vertex              (numVertices)
 ?       n*?     array   v6  Submesh             (numSubmeshes)
 ?
@@ -84,6 +113,10 @@ AttribSpec
 2       1       int     v1  length
 3
 
+Attrib
+0       ?       bytes   v9  attribute data      (numVertices elements of the attribute's AttribSpec)
+?
+
 Vertex
 0       ?       bytes   v1  vertex data         (dictated by the AttribSpecs)
 ?
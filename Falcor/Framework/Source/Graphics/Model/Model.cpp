@@ -88,23 +88,31 @@ namespace Falcor
 
     Model::SharedPtr Model::createFromFile(const char* filename, LoadFlags flags)
     {
-        SharedPtr pModel = SharedPtr(new Model());
-        bool res;
+        ModelFileData::UniquePtr pData = parseFile(filename, flags);
+        return pData ? createFromFileData(*pData) : nullptr;
+    }
+
+    ModelFileData::UniquePtr Model::parseFile(const char* filename, LoadFlags flags)
+    {
         if(hasSuffix(filename, ".bin", false))
         {
-            res = BinaryModelImporter::import(*pModel, filename, flags);
+            return BinaryModelImporter::parse(filename, flags);
         }
         else
         {
-            res = AssimpModelImporter::import(*pModel, filename, flags);
+            return AssimpModelImporter::parse(filename, flags);
         }
+    }
 
-        if(res)
+    Model::SharedPtr Model::createFromFileData(ModelFileData& data)
+    {
+        SharedPtr pModel = SharedPtr(new Model());
+        if(data.createModel(*pModel))
         {
             pModel->calculateModelProperties();
-            pModel->setFilename(filename);
+            pModel->setFilename(data.getFilename());
 
-            std::string name = getFilenameFromPath(filename);
+            std::string name = getFilenameFromPath(data.getFilename());
             size_t extPos = name.find_last_of('.');
             name = (extPos == std::string::npos) ? name : name.substr(0, extPos);
             pModel->setName(name);
@@ -44,6 +44,45 @@ namespace Falcor
     class BinaryModelExporter;
     class Buffer;
     class Camera;
+    class Model;
+
+    /** A model file that has been read and prepared on the CPU, but whose API resources haven't been created yet.
+        See Model::parseFile().
+    */
+    class ModelFileData
+    {
+    public:
+        using UniquePtr = std::unique_ptr<ModelFileData>;
+        virtual ~ModelFileData() = default;
+
+        /** CPU time spent on each stage of parseFile(), in ms. Stages may have run on several threads at once.
+        */
+        struct ParseTimes
+        {
+            float parseMs = 0;              ///< Reading and parsing the file
+            float tangentMs = 0;            ///< Generating missing tangent space
+            float decodeMs = 0;             ///< Decoding textures
+            uint32_t textureCount = 0;      ///< Textures decoded
+        };
+
+        /** Get the file the data was read from
+        */
+        const std::string& getFilename() const { return mFilename; }
+
+        /** Get the time spent preparing the data
+        */
+        const ParseTimes& getParseTimes() const { return mTimes; }
+
+    protected:
+        friend class Model;
+
+        /** Create the model's buffers, textures and materials, and add its meshes. Called by Model::createFromFileData().
+        */
+        virtual bool createModel(Model& model) = 0;
+
+        std::string mFilename;
+        ParseTimes mTimes;
+    };
 
     /** Class representing a complete model object, including meshes, animations and materials
     */
@@ -73,6 +112,17 @@ namespace Falcor
         */
         static SharedPtr createFromFile(const char* filename, LoadFlags flags = LoadFlags::None);
 
+        /** Do the CPU side of loading a model file (parsing, tangent generation and texture decoding) without touching the device.
+            This is safe to call from any thread, so several models can be prepared in parallel.
+            \return The prepared data, to pass to createFromFileData(), or nullptr if the file couldn't be loaded
+        */
+        static ModelFileData::UniquePtr parseFile(const char* filename, LoadFlags flags = LoadFlags::None);
+
+        /** Create a model from the result of parseFile(). Creates the model's API resources, so it must be called from the thread that owns the device.
+            createFromFile() is parseFile() followed by createFromFileData().
+        */
+        static SharedPtr createFromFileData(ModelFileData& data);
+
         static SharedPtr create();
 
         static const char* kSupportedFileFormatsStr;
@@ -38,6 +38,9 @@
 #include "API/RenderContext.h"
 #include "Utils/StringUtils.h"
 #include "ShaderLibrary.h"
+#include "ShaderCache.h"
+#include <atomic>
+#include <cstring>
 
 namespace Falcor
 {
@@ -417,16 +420,67 @@ namespace Falcor
 #endif
     }
 
-    Program::VersionData Program::preprocessAndCreateProgramVersion(std::string& log) const
+    // Pick the code-generation target for the current graphics API and shader model
+    static SlangCompileTarget getSlangTarget(const std::string& shaderModel)
     {
-        mFileTimeMap.clear();
+#ifdef FALCOR_VK
+        return SLANG_SPIRV;
+#elif defined FALCOR_D3D12
+        // If the profile string starts with a `4_` or a `5_`, use DXBC. Otherwise, use DXIL
+        if (hasPrefix(shaderModel, "4_") || hasPrefix(shaderModel, "5_")) return SLANG_DXBC;
+        else                                                            return SLANG_DXIL;
+#else
+#error unknown shader compilation target
+#endif
+    }
 
-        // Run all of the shaders through Slang, so that we can get final code,
-        // reflection data, etc.
-        //
-        // Note that we provide all the shaders at once, so that automatically
-        // generated bindings can be made consistent across the stages.
+    // The source language of the target, for a first pass that stops before the downstream compiler
+    static SlangCompileTarget getSlangSourceTarget()
+    {
+#ifdef FALCOR_VK
+        return SLANG_GLSL;
+#else
+        return SLANG_HLSL;
+#endif
+    }
 
+    // Compiled code that was read from the shader cache, handed to Shader::create() like the blobs Slang returns
+    class CachedCodeBlob : public ISlangBlob
+    {
+    public:
+        CachedCodeBlob(std::vector<uint8_t>&& code) : mCode(std::move(code)) {}
+
+        SLANG_NO_THROW SlangResult SLANG_MCALL QueryInterface(SlangUUID const& uuid, void** outObject) override
+        {
+            // ISlangBlob shares its layout and IID with ID3DBlob, which D3D12 Shader::init() queries for
+            static const SlangUUID kUnknownId = { 0x00000000, 0x0000, 0x0000, { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 } };
+            static const SlangUUID kBlobId = { 0x8BA5FB08, 0x5195, 0x40E2, { 0xAC, 0x58, 0x0D, 0x98, 0x9C, 0x3A, 0x01, 0x02 } };
+            if (std::memcmp(&uuid, &kUnknownId, sizeof(SlangUUID)) == 0 || std::memcmp(&uuid, &kBlobId, sizeof(SlangUUID)) == 0)
+            {
+                AddRef();
+                *outObject = static_cast<ISlangBlob*>(this);
+                return SLANG_OK;
+            }
+            *outObject = nullptr;
+            return SLANG_E_NO_INTERFACE;
+        }
+        SLANG_NO_THROW uint32_t SLANG_MCALL AddRef() override { return ++mRefCount; }
+        SLANG_NO_THROW uint32_t SLANG_MCALL Release() override
+        {
+            uint32_t count = --mRefCount;
+            if (count == 0) delete this;
+            return count;
+        }
+        SLANG_NO_THROW void const* SLANG_MCALL getBufferPointer() override { return mCode.data(); }
+        SLANG_NO_THROW size_t SLANG_MCALL getBufferSize() override { return mCode.size(); }
+
+    private:
+        std::vector<uint8_t> mCode;
+        std::atomic<uint32_t> mRefCount{ 0 };
+    };
+
+    SlangCompileRequest* Program::createSlangCompileRequest(SlangCompileTarget slangTarget) const
+    {
         SlangSession* slangSession = getSlangSession();
 
         // Start building a request for compilation
@@ -452,17 +506,11 @@ namespace Falcor
             spAddPreprocessorDefine(slangRequest, shaderDefine.first.c_str(), shaderDefine.second.c_str());
         }
 
-        SlangCompileTarget slangTarget = SLANG_TARGET_UNKNOWN;
-        const char* preprocessorDefine;
-        // Pick the right target based on the current graphics API
+        // The graphics API define doesn't depend on the target, which is source code for the shader cache's first pass
 #ifdef FALCOR_VK
-        slangTarget = SLANG_SPIRV;
-        preprocessorDefine = "FALCOR_VK";
+        const char* preprocessorDefine = "FALCOR_VK";
 #elif defined FALCOR_D3D12
-        preprocessorDefine = "FALCOR_D3D";
-        // If the profile string starts with a `4_` or a `5_`, use DXBC. Otherwise, use DXIL
-        if (hasPrefix(mDesc.mShaderModel, "4_") || hasPrefix(mDesc.mShaderModel, "5_")) slangTarget = SLANG_DXBC;
-        else                                                                            slangTarget = SLANG_DXIL;
+        const char* preprocessorDefine = "FALCOR_D3D";
 #else
 #error unknown shader compilation target
 #endif
@@ -532,29 +580,135 @@ namespace Falcor
                 getSlangStage(ShaderType(i)));
         }
 
+        return slangRequest;
+    }
+
+    bool Program::compileShaderCode(SlangCompileTarget slangTarget, ShaderCache::Code& code, std::string& log) const
+    {
+        SlangCompileRequest* slangRequest = createSlangCompileRequest(slangTarget);
         int anySlangErrors = spCompile(slangRequest);
         log += spGetDiagnosticOutput(slangRequest);
-        if(anySlangErrors)
+        if (anySlangErrors)
         {
             spDestroyCompileRequest(slangRequest);
-            return VersionData();
+            return false;
         }
 
         // Extract the generated code for each stage
         int entryPointCounter = 0;
-        Shader::Blob shaderBlob[kShaderCount];
-
+        code.assign(kShaderCount, {});
         for (uint32_t i = 0; i < kShaderCount; i++)
         {
-            auto& entryPoint = mDesc.mEntryPoints[i];
             // Skip unused entry points
-            if(entryPoint.index < 0)
-                continue;
+            if (mDesc.mEntryPoints[i].index < 0) continue;
 
             int entryPointIndex = entryPointCounter++;
             int targetIndex = 0; // We always compile for a single target
 
-            spGetEntryPointCodeBlob(slangRequest, entryPointIndex, targetIndex, shaderBlob[i].writeRef());
+            Shader::Blob blob;
+            spGetEntryPointCodeBlob(slangRequest, entryPointIndex, targetIndex, blob.writeRef());
+            if (blob)
+            {
+                const uint8_t* pCode = static_cast<const uint8_t*>(blob->getBufferPointer());
+                code[i].assign(pCode, pCode + blob->getBufferSize());
+            }
+        }
+
+        spDestroyCompileRequest(slangRequest);
+        return true;
+    }
+
+    ShaderCache::Key Program::getShaderCacheKey(SlangCompileRequest* pPreprocessed, SlangCompileTarget slangTarget) const
+    {
+        ShaderCache::KeyBuilder builder;
+        builder.add("Falcor shader cache key 1");
+        builder.add(uint64_t(slangTarget)).add(mDesc.mShaderModel).add(uint64_t(mDesc.getCompilerFlags()));
+        for (const auto& define : mDefineList)
+        {
+            builder.add(define.first).add(define.second);
+        }
+
+        // Each entry point as the downstream compiler will see it:  preprocessed, with every include expanded
+        int entryPointCounter = 0;
+        for (uint32_t i = 0; i < kShaderCount; i++)
+        {
+            if (mDesc.mEntryPoints[i].index < 0) continue;
+            const char* pSource = spGetEntryPointSource(pPreprocessed, entryPointCounter++);
+            builder.add(uint64_t(i)).add(mDesc.mEntryPoints[i].name).add(pSource ? std::string(pSource) : std::string());
+        }
+
+        // And the files it came from, in case anything in them reaches the compiler without passing through the source above
+        int depFileCount = spGetDependencyFileCount(pPreprocessed);
+        for (int ii = 0; ii < depFileCount; ++ii)
+        {
+            builder.addFile(spGetDependencyFilePath(pPreprocessed, ii));
+        }
+        return builder.getKey();
+    }
+
+    Program::VersionData Program::preprocessAndCreateProgramVersion(std::string& log) const
+    {
+        mFileTimeMap.clear();
+
+        // Run all of the shaders through Slang, so that we can get final code,
+        // reflection data, etc.
+        //
+        // Note that we provide all the shaders at once, so that automatically
+        // generated bindings can be made consistent across the stages.
+        //
+        // With the shader cache on, this first pass only goes as far as HLSL (or GLSL) source:  it provides the reflection data, the
+        // dependency list and the cache key without running the downstream compiler (fxc/dxc), which is where the time goes.
+        // The code itself comes from the cache, or from a second, full compile on a miss.
+        const ShaderCache::SharedPtr& pCache = ShaderCache::getDefault();
+        bool dumpIR = is_set(mDesc.getCompilerFlags(), Shader::CompilerFlags::DumpIntermediates);
+        bool useCache = pCache->isEnabled() && !dumpIR;
+        SlangCompileTarget slangTarget = getSlangTarget(mDesc.mShaderModel);
+
+        SlangCompileRequest* slangRequest = createSlangCompileRequest(useCache ? getSlangSourceTarget() : slangTarget);
+        int anySlangErrors = spCompile(slangRequest);
+        log += spGetDiagnosticOutput(slangRequest);
+        if(anySlangErrors)
+        {
+            spDestroyCompileRequest(slangRequest);
+            return VersionData();
+        }
+
+        // Extract the generated code for each stage
+        Shader::Blob shaderBlob[kShaderCount];
+        if (useCache)
+        {
+            ShaderCache::Key key = getShaderCacheKey(slangRequest, slangTarget);
+            ShaderCache::Code code;
+            ShaderCache::Lookup lookup;
+            auto compile = [&](ShaderCache::Code& compiled) { return compileShaderCode(slangTarget, compiled, log); };
+            if (!pCache->getOrCompile(key, compile, code, &lookup))
+            {
+                spDestroyCompileRequest(slangRequest);
+                return VersionData();
+            }
+            for (uint32_t i = 0; i < kShaderCount && i < code.size(); i++)
+            {
+                if (!code[i].empty()) shaderBlob[i] = new CachedCodeBlob(std::move(code[i]));
+            }
+
+            if (lookup.hit) logInfo("Shader cache hit for " + getProgramDescString() + " (" + std::to_string(lookup.lookupMs) + " ms)");
+            else            logInfo("Shader cache miss for " + getProgramDescString() + " (compiled in " + std::to_string(lookup.compileMs) + " ms)");
+        }
+        else
+        {
+            int entryPointCounter = 0;
+            for (uint32_t i = 0; i < kShaderCount; i++)
+            {
+                auto& entryPoint = mDesc.mEntryPoints[i];
+                // Skip unused entry points
+                if(entryPoint.index < 0)
+                    continue;
+
+                int entryPointIndex = entryPointCounter++;
+                int targetIndex = 0; // We always compile for a single target
+
+                spGetEntryPointCodeBlob(slangRequest, entryPointIndex, targetIndex, shaderBlob[i].writeRef());
+            }
         }
 
         VersionData programVersion;
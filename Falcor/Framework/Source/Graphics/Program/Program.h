@@ -30,6 +30,7 @@
 #include <map>
 #include <vector>
 #include "Graphics/Program//ProgramVersion.h"
+#include "Graphics/Program/ShaderCache.h"
 
 namespace Falcor
 {
@@ -300,6 +301,15 @@ namespace Falcor
 
         bool link() const;
         VersionData preprocessAndCreateProgramVersion(std::string& log) const;
+
+        // A Slang request for this program's sources, entry points and defines, compiled to <slangTarget>
+        SlangCompileRequest* createSlangCompileRequest(SlangCompileTarget slangTarget) const;
+
+        // Compile every stage to <slangTarget> (a shader cache miss)
+        bool compileShaderCode(SlangCompileTarget slangTarget, ShaderCache::Code& code, std::string& log) const;
+
+        // Hash a request that stopped at source code, with everything that decides the compiled code
+        ShaderCache::Key getShaderCacheKey(SlangCompileRequest* pPreprocessed, SlangCompileTarget slangTarget) const;
         virtual ProgramVersion::SharedPtr createProgramVersion(std::string& log, const Shader::Blob shaderBlob[kShaderCount], const ProgramReflectors& reflectors) const;
 
         // The description used to create this program
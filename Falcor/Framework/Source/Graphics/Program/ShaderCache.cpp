@@ -0,0 +1,442 @@
+/***************************************************************************
+# Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+#include "Framework.h"
+#include "ShaderCache.h"
+#include "Utils/Platform/OS.h"
+#include "Utils/CpuTimer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+
+namespace Falcor
+{
+    namespace
+    {
+        const uint32_t kEntryMagic = 0x45435346;     // "FSCE"
+        const uint32_t kEntryVersion = 1;            // Bump when the layout below changes
+        const uint32_t kMaxStages = 64;
+
+        // An entry is this header, then each stage's size (uint64_t) and code
+        struct EntryHeader
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t keyHi;
+            uint64_t keyLo;
+            uint64_t payloadHash;   ///< Low half of the hash of everything after the header
+            uint32_t stageCount;
+            uint32_t reserved;
+        };
+
+        uint64_t rotl64(uint64_t x, int r)
+        {
+            return (x << r) | (x >> (64 - r));
+        }
+
+        uint64_t fmix64(uint64_t k)
+        {
+            k ^= k >> 33;
+            k *= 0xFF51AFD7ED558CCDull;
+            k ^= k >> 33;
+            k *= 0xC4CEB9FE1A85EC53ull;
+            k ^= k >> 33;
+            return k;
+        }
+
+        // MurmurHash3 x64 128 (Austin Appleby, public domain)
+        ShaderCache::Key hash128(const uint8_t* pData, size_t size, uint64_t seed)
+        {
+            const uint64_t c1 = 0x87C37B91114253D5ull;
+            const uint64_t c2 = 0x4CF5AD432745937Full;
+            uint64_t h1 = seed, h2 = seed;
+
+            size_t blocks = size / 16;
+            for (size_t i = 0; i < blocks; i++)
+            {
+                uint64_t k1, k2;
+                std::memcpy(&k1, pData + i * 16, 8);
+                std::memcpy(&k2, pData + i * 16 + 8, 8);
+                k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+                h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52DCE729;
+                k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+                h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495AB5;
+            }
+
+            const uint8_t* pTail = pData + blocks * 16;
+            size_t rest = size & 15;
+            uint64_t k1 = 0, k2 = 0;
+            for (size_t i = rest; i > 8; i--) k2 ^= uint64_t(pTail[i - 1]) << ((i - 9) * 8);
+            if (rest > 8) { k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2; }
+            for (size_t i = std::min<size_t>(rest, 8); i > 0; i--) k1 ^= uint64_t(pTail[i - 1]) << ((i - 1) * 8);
+            if (rest > 0) { k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1; }
+
+            h1 ^= uint64_t(size);
+            h2 ^= uint64_t(size);
+            h1 += h2;
+            h2 += h1;
+            h1 = fmix64(h1);
+            h2 = fmix64(h2);
+            h1 += h2;
+            h2 += h1;
+
+            ShaderCache::Key key;
+            key.hi = h1;
+            key.lo = h2;
+            return key;
+        }
+
+        std::string toHex(uint64_t value)
+        {
+            static const char kDigits[] = "0123456789abcdef";
+            std::string str(16, '0');
+            for (int i = 15; i >= 0; i--, value >>= 4) str[i] = kDigits[value & 15];
+            return str;
+        }
+
+        // Unique across processes (a random seed per process) and across threads and calls (a counter)
+        std::string getUniqueSuffix()
+        {
+            static const uint64_t sProcessSeed = (uint64_t(std::random_device()()) << 32) ^ uint64_t(std::random_device()()) ^
+                uint64_t(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+            static std::atomic<uint64_t> sCounter(0);
+            return toHex(sProcessSeed) + "-" + toHex(sCounter++);
+        }
+
+        std::vector<uint8_t> serializeEntry(const ShaderCache::Key& key, const ShaderCache::Code& code)
+        {
+            std::vector<uint8_t> data(sizeof(EntryHeader));
+            for (const auto& stage : code)
+            {
+                uint64_t size = stage.size();
+                const uint8_t* pSize = reinterpret_cast<const uint8_t*>(&size);
+                data.insert(data.end(), pSize, pSize + sizeof(size));
+                data.insert(data.end(), stage.begin(), stage.end());
+            }
+
+            EntryHeader header = {};
+            header.magic = kEntryMagic;
+            header.version = kEntryVersion;
+            header.keyHi = key.hi;
+            header.keyLo = key.lo;
+            header.payloadHash = hash128(data.data() + sizeof(EntryHeader), data.size() - sizeof(EntryHeader), 0).lo;
+            header.stageCount = uint32_t(code.size());
+            std::memcpy(data.data(), &header, sizeof(header));
+            return data;
+        }
+
+        bool parseEntry(const std::vector<uint8_t>& data, const ShaderCache::Key& key, ShaderCache::Code& code)
+        {
+            if (data.size() < sizeof(EntryHeader)) return false;
+            EntryHeader header;
+            std::memcpy(&header, data.data(), sizeof(header));
+            if (header.magic != kEntryMagic || header.version != kEntryVersion) return false;
+            if (header.keyHi != key.hi || header.keyLo != key.lo || header.stageCount > kMaxStages) return false;
+            if (hash128(data.data() + sizeof(EntryHeader), data.size() - sizeof(EntryHeader), 0).lo != header.payloadHash) return false;
+
+            code.assign(header.stageCount, {});
+            size_t offset = sizeof(EntryHeader);
+            for (auto& stage : code)
+            {
+                uint64_t size;
+                if (data.size() - offset < sizeof(size)) return false;
+                std::memcpy(&size, data.data() + offset, sizeof(size));
+                offset += sizeof(size);
+                if (data.size() - offset < size) return false;
+                stage.assign(data.begin() + offset, data.begin() + offset + size_t(size));
+                offset += size_t(size);
+            }
+            return offset == data.size();
+        }
+
+        // What the self-test's stub compiler produces for a key:  stages of different sizes, one empty, all derived
+        //     from the key so that a mixed-up entry shows up as wrong bytes
+        ShaderCache::Code getStubCode(const ShaderCache::Key& key)
+        {
+            ShaderCache::Code code(3);
+            code[0].resize(256);
+            code[2].resize(1000 + size_t(key.lo % 64));
+            for (size_t i = 0; i < code[0].size(); i++) code[0][i] = uint8_t((key.lo >> (i % 8 * 8)) + i);
+            for (size_t i = 0; i < code[2].size(); i++) code[2][i] = uint8_t((key.hi >> (i % 8 * 8)) ^ i);
+            return code;
+        }
+    }
+
+    std::string ShaderCache::Key::toString() const
+    {
+        return toHex(hi) + toHex(lo);
+    }
+
+    ShaderCache::KeyBuilder& ShaderCache::KeyBuilder::add(const void* pData, size_t size)
+    {
+        uint64_t length = size;
+        const uint8_t* pLength = reinterpret_cast<const uint8_t*>(&length);
+        mData.insert(mData.end(), pLength, pLength + sizeof(length));
+        mData.insert(mData.end(), static_cast<const uint8_t*>(pData), static_cast<const uint8_t*>(pData) + size);
+        return *this;
+    }
+
+    bool ShaderCache::KeyBuilder::addFile(const std::string& path)
+    {
+        add(path);
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+        {
+            add(uint64_t(-1));
+            return false;
+        }
+        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        add(content);
+        return true;
+    }
+
+    ShaderCache::Key ShaderCache::KeyBuilder::getKey() const
+    {
+        return hash128(mData.data(), mData.size(), 0x5348414445524341ull);
+    }
+
+    ShaderCache::SharedPtr ShaderCache::create(const std::string& directory)
+    {
+        return SharedPtr(new ShaderCache(directory));
+    }
+
+    const ShaderCache::SharedPtr& ShaderCache::getDefault()
+    {
+        static SharedPtr sCache = create(getExecutableDirectory() + "/ShaderCache");
+        return sCache;
+    }
+
+    std::string ShaderCache::getEntryPath(const Key& key) const
+    {
+        return mDirectory + "/" + key.toString() + ".bin";
+    }
+
+    bool ShaderCache::load(const Key& key, Code& code)
+    {
+        std::string path = getEntryPath(key);
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) return false;
+
+        std::streamoff size = file.tellg();
+        std::vector<uint8_t> data(size_t(std::max<std::streamoff>(size, 0)));
+        file.seekg(0);
+        bool valid = (size > 0) && file.read(reinterpret_cast<char*>(data.data()), size).good();
+        file.close();
+        valid = valid && parseEntry(data, key, code);
+
+        if (!valid)
+        {
+            // Left by a process that died mid-write before the rename existed, damaged, or from another format version:
+            //     drop it so that the recompiled code can take its place
+            logWarning("ShaderCache: discarding corrupt entry " + path);
+            std::error_code error;
+            fs::remove(path, error);
+            std::lock_guard<std::mutex> lock(mStatsMutex);
+            mStats.corruptEntries++;
+        }
+        return valid;
+    }
+
+    bool ShaderCache::store(const Key& key, const Code& code)
+    {
+        std::vector<uint8_t> data = serializeEntry(key, code);
+        std::error_code error;
+        fs::create_directories(mDirectory, error);
+
+        // Write a temporary no other writer uses, then move it into place in one step
+        std::string path = getEntryPath(key);
+        std::string tempPath = path + "." + getUniqueSuffix() + ".tmp";
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        file.close();
+        bool stored = !file.fail();
+
+        if (stored)
+        {
+            fs::rename(tempPath, path, error);
+            // Windows can't replace a file another process has open for reading, but then that file is a finished entry
+            //     for the same key, so it's as good as ours
+            stored = !error || fs::exists(path);
+        }
+        if (error || !stored) fs::remove(tempPath, error);
+
+        if (!stored)
+        {
+            std::lock_guard<std::mutex> lock(mStatsMutex);
+            mStats.writeFailures++;
+        }
+        return stored;
+    }
+
+    bool ShaderCache::getOrCompile(const Key& key, const CompileFunc& compile, Code& code, Lookup* pLookup)
+    {
+        Lookup lookup;
+        bool enabled = mEnabled;
+        if (enabled)
+        {
+            CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+            lookup.hit = load(key, code);
+            lookup.lookupMs = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+        }
+
+        bool success = lookup.hit;
+        if (!lookup.hit)
+        {
+            code.clear();
+            CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+            success = compile(code);
+            lookup.compileMs = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+            if (success && enabled) store(key, code);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mStatsMutex);
+            if (enabled) (lookup.hit ? mStats.hits : mStats.misses)++;
+            mStats.lookupMs += lookup.lookupMs;
+            mStats.compileMs += lookup.compileMs;
+        }
+        if (pLookup) *pLookup = lookup;
+        return success;
+    }
+
+    ShaderCache::Stats ShaderCache::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mStatsMutex);
+        return mStats;
+    }
+
+    ShaderCache::SelfTest ShaderCache::runSelfTest()
+    {
+        SelfTest result;
+        CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+        auto check = [&result](bool condition, const char* failure)
+        {
+            result.checks++;
+            if (!condition && result.message.empty()) result.message = failure;
+        };
+
+        std::error_code error;
+        fs::path tempDirectory = fs::temp_directory_path(error);
+        std::string directory = (tempDirectory / ("FalcorShaderCacheTest-" + getUniqueSuffix())).string();
+
+        std::atomic<uint32_t> compiles(0);
+        auto stub = [&compiles](const Key& key) -> CompileFunc
+        {
+            return [&compiles, key](Code& code) { compiles++; code = getStubCode(key); return true; };
+        };
+
+        // Keys
+        Key keyA = KeyBuilder().add("shader A").add(uint64_t(1)).getKey();
+        Key keyB = KeyBuilder().add("shader A").add(uint64_t(2)).getKey();   // Same source, another define
+        check(keyA != keyB, "Different inputs gave the same key");
+        check(KeyBuilder().add("ab").add("c").getKey() != KeyBuilder().add("a").add("bc").getKey(), "Key inputs aren't delimited");
+        check(KeyBuilder().add("shader A").add(uint64_t(1)).getKey() == keyA, "Same inputs gave different keys");
+
+        // Miss, then hit
+        SharedPtr pCache = create(directory);
+        Code code;
+        Lookup lookup;
+        check(pCache->getOrCompile(keyA, stub(keyA), code, &lookup) && !lookup.hit && compiles == 1, "First lookup wasn't a miss");
+        check(code == getStubCode(keyA), "Miss returned the wrong code");
+        check(pCache->getOrCompile(keyA, stub(keyA), code, &lookup) && lookup.hit && compiles == 1, "Second lookup wasn't a hit");
+        check(code == getStubCode(keyA), "Hit returned the wrong code");
+
+        // Another cache over the same directory stands in for another process
+        SharedPtr pOther = create(directory);
+        check(pOther->getOrCompile(keyA, stub(keyA), code, &lookup) && lookup.hit, "Entry wasn't shared between caches");
+        check(pOther->getOrCompile(keyB, stub(keyB), code, &lookup) && !lookup.hit && code == getStubCode(keyB), "Changed input hit the old entry");
+
+        // Flip a byte of the code:  the checksum must catch it, and the entry must be rebuilt
+        {
+            std::fstream file(pCache->getEntryPath(keyA), std::ios::in | std::ios::out | std::ios::binary);
+            std::streamoff offset = sizeof(EntryHeader) + sizeof(uint64_t) + 100;
+            char byte = 0;
+            file.seekg(offset);
+            file.get(byte);
+            file.seekp(offset);
+            file.put(char(~byte));
+            check(file.good(), "Couldn't modify an entry");
+        }
+        uint32_t compilesBefore = compiles;
+        check(pCache->getOrCompile(keyA, stub(keyA), code, &lookup) && !lookup.hit && compiles == compilesBefore + 1, "Corrupt entry wasn't recompiled");
+        check(code == getStubCode(keyA), "Corrupt entry returned its code");
+        check(pCache->getStats().corruptEntries == 1, "Corrupt entry wasn't counted");
+        check(pCache->load(keyA, code) && code == getStubCode(keyA), "Corrupt entry wasn't rewritten");
+
+        // A failed compile stores nothing
+        Key keyC = KeyBuilder().add("broken shader").getKey();
+        check(!pCache->getOrCompile(keyC, [](Code&) { return false; }, code), "Failed compile reported success");
+        check(!pCache->load(keyC, code), "Failed compile was stored");
+
+        // Disabled, every lookup compiles
+        compilesBefore = compiles;
+        pCache->setEnabled(false);
+        check(pCache->getOrCompile(keyA, stub(keyA), code, &lookup) && !lookup.hit && compiles == compilesBefore + 1, "Disabled cache didn't compile");
+        pCache->setEnabled(true);
+
+        // Writers racing on one key, each with its own cache as if in its own process
+        Key keyD = KeyBuilder().add("shared shader").getKey();
+        const uint32_t kThreads = 8;
+        std::vector<uint8_t> threadPassed(kThreads, 0);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < kThreads; t++)
+        {
+            threads.emplace_back([&, t]()
+            {
+                SharedPtr pThreadCache = create(directory);
+                Code threadCode;
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    if (!pThreadCache->getOrCompile(keyD, stub(keyD), threadCode) || threadCode != getStubCode(keyD)) return;
+                }
+                threadPassed[t] = 1;
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        check(std::count(threadPassed.begin(), threadPassed.end(), uint8_t(1)) == kThreads, "Concurrent lookups returned the wrong code");
+        check(pCache->load(keyD, code) && code == getStubCode(keyD), "Concurrent writers left a bad entry");
+
+        uint32_t tempFiles = 0;
+        for (const auto& entry : fs::directory_iterator(directory, error))
+        {
+            if (entry.path().extension() == ".tmp") tempFiles++;
+        }
+        check(tempFiles == 0, "Temporary files were left behind");
+
+        fs::remove_all(directory, error);
+        result.stubCompiles = compiles;
+        result.passed = result.message.empty();
+        result.ms = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+        return result;
+    }
+}
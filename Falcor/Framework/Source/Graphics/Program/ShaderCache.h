@@ -0,0 +1,184 @@
+/***************************************************************************
+# Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+#pragma once
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Falcor
+{
+    /** A persistent cache of compiled shader code on disk, shared by every process that uses the same directory.
+        Program looks each version up in getDefault() before running the downstream compiler.
+
+        Entries are content addressed. Their Key hashes everything the compiler sees (see Program.cpp): the preprocessed
+        source of each entry point, the content of every file it includes, the defines, the target, the shader model and
+        the compiler flags. An entry can't go stale, so there is nothing to invalidate. Editing a shader only produces a
+        new key, and old entries stay until the directory is cleared.
+
+        Each entry is one file, <key>.bin, holding each stage's code and a checksum. Writers fill a uniquely named
+        temporary file and rename it into place, so readers in other processes never see a partial entry. Two processes
+        that miss on the same key both compile it, and either file is correct. Unreadable or corrupt entries count as
+        misses, and are deleted and written again.
+
+        The cache only moves bytes. It doesn't know about Slang, so it can be checked against a stub compiler (runSelfTest()).
+    */
+    class ShaderCache
+    {
+    public:
+        using SharedPtr = std::shared_ptr<ShaderCache>;
+        using SharedConstPtr = std::shared_ptr<const ShaderCache>;
+
+        /** A 128-bit content hash
+        */
+        struct Key
+        {
+            uint64_t hi = 0;
+            uint64_t lo = 0;
+
+            /** Get the key as 32 hex digits, its entry's file name
+            */
+            std::string toString() const;
+            bool operator==(const Key& other) const { return hi == other.hi && lo == other.lo; }
+            bool operator!=(const Key& other) const { return !(*this == other); }
+        };
+
+        /** Accumulates the inputs of a compile into a Key. Each addition is length-prefixed, so ("ab", "c") and ("a", "bc") differ.
+        */
+        class KeyBuilder
+        {
+        public:
+            KeyBuilder& add(const void* pData, size_t size);
+            KeyBuilder& add(const std::string& str) { return add(str.data(), str.size()); }
+            KeyBuilder& add(uint64_t value) { return add(&value, sizeof(value)); }
+
+            /** Add a file's path and content
+                \return false if the file can't be read (the key still differs from one where it could)
+            */
+            bool addFile(const std::string& path);
+
+            Key getKey() const;
+
+        private:
+            std::vector<uint8_t> mData;
+        };
+
+        /** Compiled code of each stage, indexed by ShaderType. Unused stages are empty.
+        */
+        using Code = std::vector<std::vector<uint8_t>>;
+
+        /** Fills in the code for a key on a miss. Returns false if compilation failed, in which case nothing is stored.
+        */
+        using CompileFunc = std::function<bool(Code& code)>;
+
+        /** Outcome of one getOrCompile()
+        */
+        struct Lookup
+        {
+            bool hit = false;
+            double lookupMs = 0;        ///< Reading and checking the entry
+            double compileMs = 0;       ///< In the compile function, on a miss
+        };
+
+        /** Totals over the cache's lifetime
+        */
+        struct Stats
+        {
+            uint32_t hits = 0;
+            uint32_t misses = 0;
+            uint32_t corruptEntries = 0;    ///< Found, but unreadable or failing their checksum (also counted as misses)
+            uint32_t writeFailures = 0;
+            double lookupMs = 0;
+            double compileMs = 0;
+        };
+
+        /** Result of runSelfTest()
+        */
+        struct SelfTest
+        {
+            bool passed = false;
+            std::string message;        ///< The first failed check, if any
+            uint32_t checks = 0;
+            uint32_t stubCompiles = 0;
+            double ms = 0;
+        };
+
+        /** Create a cache over a directory, which is created when the first entry is stored
+        */
+        static SharedPtr create(const std::string& directory);
+
+        /** Get the cache Program uses: <executable directory>/ShaderCache
+        */
+        static const SharedPtr& getDefault();
+
+        /** Get the code for <key> from disk, or call <compile> and store what it produces
+            \param[in] key The content hash of the compile's inputs
+            \param[in] compile Called on a miss, or for every lookup while the cache is disabled
+            \param[out] code The code of each stage
+            \param[out] pLookup Optional. Whether it was a hit, and the time taken.
+            \return false if the code wasn't cached and <compile> failed
+        */
+        bool getOrCompile(const Key& key, const CompileFunc& compile, Code& code, Lookup* pLookup = nullptr);
+
+        /** Read an entry
+            \return false if there is none, or it's corrupt (and then deleted)
+        */
+        bool load(const Key& key, Code& code);
+
+        /** Write an entry, replacing any existing one
+            \return false if it couldn't be written
+        */
+        bool store(const Key& key, const Code& code);
+
+        /** Get the totals so far
+        */
+        Stats getStats() const;
+
+        /** Enable or disable the cache. While disabled, getOrCompile() always compiles and nothing is read or written.
+        */
+        void setEnabled(bool enabled) { mEnabled = enabled; }
+        bool isEnabled() const { return mEnabled; }
+
+        const std::string& getDirectory() const { return mDirectory; }
+
+        /** Check hits, misses, corrupt entries, failed compiles, and concurrent writers against a stub compiler. Uses a
+            temporary directory that is deleted afterwards.
+        */
+        static SelfTest runSelfTest();
+
+    private:
+        ShaderCache(const std::string& directory) : mDirectory(directory) {}
+        std::string getEntryPath(const Key& key) const;
+
+        std::string mDirectory;
+        bool mEnabled = true;
+        mutable std::mutex mStatsMutex;
+        Stats mStats;
+    };
+}
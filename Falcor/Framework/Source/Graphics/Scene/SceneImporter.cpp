@@ -34,8 +34,11 @@
 #include <fstream>
 #include <algorithm>
 #include "Graphics/TextureHelper.h"
+#include "Graphics/TextureCache.h"
 #include "API/Device.h"
 #include "Data/HostDeviceSharedMacros.h"
+#include "Utils/TaskScheduler.h"
+#include "Utils/CpuTimer.h"
 
 #define SCENE_IMPORTER
 #include "SceneExportImportCommon.h"
@@ -175,7 +178,7 @@ namespace Falcor
         return true;
     }
 
-    bool SceneImporter::createModel(const rapidjson::Value& jsonModel)
+    bool SceneImporter::prepareModel(const rapidjson::Value& jsonModel, ModelEntry& entry)
     {
         // Model must have at least a filename
         if (jsonModel.HasMember(SceneKeys::kFilename) == false)
@@ -218,11 +221,21 @@ namespace Falcor
             }
         }
 
-        // Load the model
-        auto pModel = Model::createFromFile(file.c_str(), modelFlags);
+        entry.pJson = &jsonModel;
+        entry.file = file;
+        entry.flags = modelFlags;
+        return true;
+    }
+
+    bool SceneImporter::createModel(ModelEntry& entry)
+    {
+        const rapidjson::Value& jsonModel = *entry.pJson;
+
+        // Create the model's resources from the data parseModels() prepared
+        auto pModel = entry.pData ? Model::createFromFileData(*entry.pData) : nullptr;
         if (pModel == nullptr)
         {
-            return error("Could not load model: " + file);
+            return error("Could not load model: " + entry.file);
         }
 
         bool instanceAdded = false;
@@ -296,15 +309,51 @@ namespace Falcor
             return error("models section should be an array of objects.");
         }
 
-        // Loop over the array
+        // Validate the entries and find the files
+        std::vector<ModelEntry> entries(jsonVal.Size());
         for (uint32_t i = 0; i < jsonVal.Size(); i++)
         {
-            if (createModel(jsonVal[i]) == false)
+            if (prepareModel(jsonVal[i], entries[i]) == false)
             {
                 return false;
             }
         }
-        return true;
+
+        // Parse the files, generate tangent space and decode textures. None of it touches the device, so the models are prepared in parallel.
+        CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+        TaskScheduler::getGlobal()->parallelFor(0, uint32_t(entries.size()), [&entries](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                entries[i].pData = Model::parseFile(entries[i].file.c_str(), entries[i].flags);
+            }
+        }, 1);
+        CpuTimer::TimePoint parsed = CpuTimer::getCurrentTimePoint();
+
+        // Create the API resources on this thread, in the order the models appear in the file
+        bool success = true;
+        for (ModelEntry& entry : entries)
+        {
+            if (createModel(entry) == false)
+            {
+                success = false;
+                break;
+            }
+        }
+
+        mLoadTimes.modelCount += uint32_t(entries.size());
+        mLoadTimes.cpuPhaseMs += CpuTimer::calcDuration(start, parsed);
+        mLoadTimes.createPhaseMs += CpuTimer::calcDuration(parsed, CpuTimer::getCurrentTimePoint());
+        for (const ModelEntry& entry : entries)
+        {
+            if (entry.pData == nullptr) continue;
+            const ModelFileData::ParseTimes& times = entry.pData->getParseTimes();
+            mLoadTimes.parseMs += times.parseMs;
+            mLoadTimes.tangentMs += times.tangentMs;
+            mLoadTimes.decodeMs += times.decodeMs;
+            mLoadTimes.textureCount += times.textureCount;
+        }
+        return success;
     }
 
     bool SceneImporter::createDirLight(const rapidjson::Value& jsonLight)
@@ -984,6 +1033,8 @@ namespace Falcor
 
     bool SceneImporter::load(const std::string& filename, Model::LoadFlags modelLoadFlags, Scene::LoadFlags sceneLoadFlags)
     {
+        CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+        TextureCache::Stats cacheStart = TextureCache::getStats();
         std::string fullpath;
         mFilename = filename;
         mModelLoadFlags = modelLoadFlags;
@@ -1024,6 +1075,22 @@ namespace Falcor
                 mScene.createAreaLights();
             }
 
+            if (mLoadTimes.modelCount > 0)
+            {
+                const LoadTimes& t = mLoadTimes;
+                logInfo("Loaded scene " + mFilename + " in " + std::to_string(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint())) + " ms. " +
+                    std::to_string(t.modelCount) + " models: preparing " + std::to_string(t.cpuPhaseMs) + " ms on " + std::to_string(TaskScheduler::getGlobal()->getWorkerCount() + 1) +
+                    " threads (CPU time: parsing " + std::to_string(t.parseMs) + " ms, tangent space " + std::to_string(t.tangentMs) + " ms, decoding " +
+                    std::to_string(t.textureCount) + " textures " + std::to_string(t.decodeMs) + " ms), creating resources " + std::to_string(t.createPhaseMs) + " ms");
+                if (TextureCache::isEnabled())
+                {
+                    TextureCache::Stats c = TextureCache::getStats();
+                    logInfo("Texture cache: " + std::to_string(c.hits - cacheStart.hits) + " hits (" + std::to_string(c.rehashed - cacheStart.rehashed) + " rehashed), " +
+                        std::to_string(c.misses - cacheStart.misses) + " misses (" + std::to_string(c.invalidated - cacheStart.invalidated) + " invalidated), " +
+                        std::to_string(c.uncached - cacheStart.uncached) + " uncached. Hits took " + std::to_string(c.hitMs - cacheStart.hitMs) + " ms, misses " +
+                        std::to_string(c.missMs - cacheStart.missMs) + " ms of CPU time");
+                }
+            }
             return true;
         }
         else
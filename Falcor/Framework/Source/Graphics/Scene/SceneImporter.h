@@ -65,7 +65,18 @@ namespace Falcor
 
         bool loadIncludeFile(const std::string& Include);
 
-        bool createModel(const rapidjson::Value& jsonModel);
+        /** A models section entry, validated by prepareModel() and parsed on a worker thread before createModel() creates its resources
+        */
+        struct ModelEntry
+        {
+            const rapidjson::Value* pJson = nullptr;
+            std::string file;
+            Model::LoadFlags flags = Model::LoadFlags::None;
+            ModelFileData::UniquePtr pData;
+        };
+
+        bool prepareModel(const rapidjson::Value& jsonModel, ModelEntry& entry);
+        bool createModel(ModelEntry& entry);
         bool createModelInstances(const rapidjson::Value& jsonVal, const Model::SharedPtr& pModel);
         bool createPointLight(const rapidjson::Value& jsonLight);
         bool createDirLight(const rapidjson::Value& jsonLight);
@@ -86,6 +97,19 @@ namespace Falcor
         Model::LoadFlags mModelLoadFlags;
         Scene::LoadFlags mSceneLoadFlags;
 
+        /** Where the time loading the models went, reported by load()
+        */
+        struct LoadTimes
+        {
+            uint32_t modelCount = 0;
+            uint32_t textureCount = 0;
+            float cpuPhaseMs = 0;           ///< Wall clock, parsing all models in parallel
+            float createPhaseMs = 0;        ///< Wall clock, creating their API resources
+            float parseMs = 0;              ///< CPU time summed over models, see ModelFileData::ParseTimes
+            float tangentMs = 0;
+            float decodeMs = 0;
+        } mLoadTimes;
+
         using ObjectMap = std::map<std::string, IMovableObject::SharedPtr>;
         bool isNameDuplicate(const std::string& name, const ObjectMap& objectMap, const std::string& objectType) const;
         IMovableObject::SharedPtr getMovableObject(const std::string& type, const std::string& name) const;
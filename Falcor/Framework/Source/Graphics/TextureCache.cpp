@@ -0,0 +1,620 @@
+/***************************************************************************
+# Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+#include "Framework.h"
+#include "TextureCache.h"
+#include "Utils/BcEncoder.h"
+#include "Utils/BinaryFileStream.h"
+#include "Utils/CpuTimer.h"
+#include "Utils/StringUtils.h"
+#include "Utils/TaskScheduler.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+namespace Falcor
+{
+    using namespace DdsHelper;
+
+    namespace
+    {
+        const uint32_t kDdsMagicNumber = 0x20534444;
+        const uint32_t kEntryMagic = 0x43585446;       // "FTXC", in DdsHeader::reserved[0]
+        const uint32_t kEntryVersion = 1;               // Bump when the encoders or filters change, to rebuild every entry
+        const float kKaiserRadius = 2.f;                // In texels of the level being made
+        const float kKaiserAlpha = 4.f;
+
+        std::mutex sMutex;
+        TextureCache::Settings sSettings;
+        TextureCache::Stats sStats;
+
+        // Where entries record their source, in DdsHeader::reserved
+        enum EntryField
+        {
+            Magic,
+            Options,
+            TimeLo,
+            TimeHi,
+            SizeLo,
+            SizeHi,
+            HashLo,
+            HashHi,
+        };
+
+        struct SourceInfo
+        {
+            uint64_t time = 0;
+            uint64_t size = 0;
+            uint64_t hash = 0;
+        };
+
+        uint64_t hash64(const uint8_t* pData, size_t size, uint64_t seed)
+        {
+            const uint64_t k0 = 0x9e3779b97f4a7c15ull;
+            const uint64_t k1 = 0xbf58476d1ce4e5b9ull;
+            uint64_t h = seed ^ (size * k0);
+            size_t words = size / 8;
+            for (size_t i = 0; i < words; i++)
+            {
+                uint64_t w;
+                std::memcpy(&w, pData + i * 8, 8);
+                h ^= w * k1;
+                h = ((h << 27) | (h >> 37)) * k0;
+            }
+            for (size_t i = words * 8; i < size; i++)
+            {
+                h = (h ^ pData[i]) * k1;
+            }
+
+            // Final mix, as in MurmurHash3
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return h;
+        }
+
+        bool readFileContent(const std::string& fullpath, std::vector<uint8_t>& content)
+        {
+            BinaryFileStream stream(fullpath, BinaryFileStream::Mode::Read);
+            if (stream.isGood() == false) return false;
+            content.resize(stream.getRemainingStreamSize());
+            stream.read(content.data(), content.size());
+            return stream.isFail() == false;
+        }
+
+        uint32_t getOptions(const TextureCache::Settings& settings, bool srgb)
+        {
+            return (kEntryVersion << 16) | (uint32_t(settings.compression) << 8) | (uint32_t(settings.mipFilter) << 4) | (srgb ? 1 : 0);
+        }
+
+        std::string getEntryFilename(const TextureCache::Settings& settings, const std::string& fullpath, uint32_t options)
+        {
+            std::string key = replaceSubstring(fullpath, "\\", "/");
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+            uint64_t hash = hash64((const uint8_t*)key.data(), key.size(), options);
+            char name[32];
+            snprintf(name, sizeof(name), "%016llx.dds", (unsigned long long)hash);
+            return settings.directory + '/' + name;
+        }
+
+        uint64_t getEntryField64(const DdsHeader& header, EntryField lo)
+        {
+            return uint64_t(header.reserved[lo]) | (uint64_t(header.reserved[lo + 1]) << 32);
+        }
+
+        void setEntryField64(DdsHeader& header, EntryField lo, uint64_t value)
+        {
+            header.reserved[lo] = uint32_t(value);
+            header.reserved[lo + 1] = uint32_t(value >> 32);
+        }
+
+        // Read an entry's headers, and its payload if pData isn't null
+        bool readEntry(const std::string& filename, DdsHeader& header, DdsHeaderDX10& dx10Header, std::vector<uint8_t>* pData)
+        {
+            BinaryFileStream stream(filename, BinaryFileStream::Mode::Read);
+            uint32_t magic = 0;
+            stream >> magic >> header >> dx10Header;
+            if (stream.isFail() || magic != kDdsMagicNumber || header.reserved[Magic] != kEntryMagic) return false;
+
+            if (pData)
+            {
+                pData->resize(stream.getRemainingStreamSize());
+                stream.read(pData->data(), pData->size());
+            }
+            return stream.isFail() == false;
+        }
+
+        // Write to a temporary file first, so that readers never see a partial entry
+        bool writeEntry(const std::string& filename, const DdsData& dds)
+        {
+            std::string tempFilename = filename + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+            {
+                BinaryFileStream stream(tempFilename, BinaryFileStream::Mode::Write);
+                stream << kDdsMagicNumber << dds.header << dds.dx10Header;
+                stream.write(dds.data.data(), dds.data.size());
+                if (stream.isFail())
+                {
+                    stream.remove();
+                    return false;
+                }
+            }
+            std::remove(filename.c_str());
+            if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+            {
+                std::remove(tempFilename.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        // Rewrite just the header, to record a new source modification time
+        void updateEntryHeader(const std::string& filename, const DdsHeader& header)
+        {
+            BinaryFileStream stream(filename, BinaryFileStream::Mode::ReadWrite);
+            stream.skip(sizeof(kDdsMagicNumber));
+            stream << header;
+        }
+
+        /************************************************************************/
+        /* Mip chain                                                            */
+        /************************************************************************/
+        struct LinearImage
+        {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            std::vector<vec4> texels;       ///< In [0, 1], linear
+        };
+
+        // The source texels and weights of each texel of a level, along one axis
+        struct FilterTaps
+        {
+            std::vector<uint32_t> offsets;      ///< Destination texel i uses taps [offsets[i], offsets[i + 1])
+            std::vector<uint32_t> sources;
+            std::vector<float> weights;
+        };
+
+        float besselI0(float x)
+        {
+            float sum = 1.f, term = 1.f;
+            for (uint32_t k = 1; k < 20; k++)
+            {
+                term *= (x / (2.f * k)) * (x / (2.f * k));
+                sum += term;
+            }
+            return sum;
+        }
+
+        float kaiserWeight(float x)
+        {
+            float t = x / kKaiserRadius;
+            if (std::abs(t) >= 1.f) return 0.f;
+            float sinc = (std::abs(x) < 1e-5f) ? 1.f : std::sin(float(M_PI) * x) / (float(M_PI) * x);
+            return sinc * besselI0(kKaiserAlpha * std::sqrt(1.f - t * t)) / besselI0(kKaiserAlpha);
+        }
+
+        FilterTaps computeTaps(uint32_t srcSize, uint32_t dstSize, TextureCache::MipFilter filter)
+        {
+            FilterTaps taps;
+            float scale = float(srcSize) / float(dstSize);
+            for (uint32_t i = 0; i < dstSize; i++)
+            {
+                taps.offsets.push_back(uint32_t(taps.sources.size()));
+                float sum = 0.f;
+                if (filter == TextureCache::MipFilter::Box || srcSize == dstSize)
+                {
+                    // Weight each source texel by how much of it the destination texel covers
+                    float lo = i * scale, hi = (i + 1) * scale;
+                    for (uint32_t j = uint32_t(lo); float(j) < hi && j < srcSize; j++)
+                    {
+                        float w = std::min(float(j + 1), hi) - std::max(float(j), lo);
+                        if (w <= 0.f) continue;
+                        taps.sources.push_back(j);
+                        taps.weights.push_back(w);
+                        sum += w;
+                    }
+                }
+                else
+                {
+                    // Kaiser-windowed sinc, stretched to the destination's texel size. Clamps at the edges.
+                    float center = (i + 0.5f) * scale;
+                    int32_t first = int32_t(std::floor(center - kKaiserRadius * scale));
+                    int32_t last = int32_t(std::ceil(center + kKaiserRadius * scale));
+                    for (int32_t j = first; j <= last; j++)
+                    {
+                        float w = kaiserWeight((j + 0.5f - center) / scale);
+                        if (w == 0.f) continue;
+                        taps.sources.push_back(uint32_t(glm::clamp(j, 0, int32_t(srcSize) - 1)));
+                        taps.weights.push_back(w);
+                        sum += w;
+                    }
+                }
+                for (size_t t = taps.offsets.back(); t < taps.weights.size(); t++) taps.weights[t] /= sum;
+            }
+            taps.offsets.push_back(uint32_t(taps.sources.size()));
+            return taps;
+        }
+
+        // Filter one level down to the next, a separable pass along x then y. Each texel's 4 channels are filtered together with SSE.
+        void downsample(const LinearImage& src, LinearImage& dst, TextureCache::MipFilter filter)
+        {
+            dst.width = std::max(1u, src.width / 2);
+            dst.height = std::max(1u, src.height / 2);
+            dst.texels.resize(size_t(dst.width) * dst.height);
+            FilterTaps tapsX = computeTaps(src.width, dst.width, filter);
+            FilterTaps tapsY = computeTaps(src.height, dst.height, filter);
+
+            std::vector<vec4> rows(size_t(dst.width) * src.height);
+            TaskScheduler::getGlobal()->parallelFor(0, src.height, [&](uint32_t begin, uint32_t end)
+            {
+                for (uint32_t y = begin; y < end; y++)
+                {
+                    const vec4* pSrc = src.texels.data() + size_t(y) * src.width;
+                    vec4* pDst = rows.data() + size_t(y) * dst.width;
+                    for (uint32_t x = 0; x < dst.width; x++)
+                    {
+                        __m128 sum = _mm_setzero_ps();
+                        for (uint32_t t = tapsX.offsets[x]; t < tapsX.offsets[x + 1]; t++)
+                        {
+                            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&pSrc[tapsX.sources[t]].x), _mm_set1_ps(tapsX.weights[t])));
+                        }
+                        _mm_storeu_ps(&pDst[x].x, sum);
+                    }
+                }
+            });
+
+            TaskScheduler::getGlobal()->parallelFor(0, dst.height, [&](uint32_t begin, uint32_t end)
+            {
+                const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+                for (uint32_t y = begin; y < end; y++)
+                {
+                    vec4* pDst = dst.texels.data() + size_t(y) * dst.width;
+                    for (uint32_t x = 0; x < dst.width; x++)
+                    {
+                        __m128 sum = _mm_setzero_ps();
+                        for (uint32_t t = tapsY.offsets[y]; t < tapsY.offsets[y + 1]; t++)
+                        {
+                            const vec4& texel = rows[size_t(tapsY.sources[t]) * dst.width + x];
+                            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&texel.x), _mm_set1_ps(tapsY.weights[t])));
+                        }
+                        // The Kaiser filter's negative lobes can overshoot
+                        _mm_storeu_ps(&pDst[x].x, _mm_min_ps(_mm_max_ps(sum, zero), one));
+                    }
+                }
+            });
+        }
+
+        float srgbToLinear(float c)
+        {
+            return (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        // 8-bit sRGB to linear, and the linear values halfway between consecutive 8-bit sRGB values for the way back
+        struct SrgbTables
+        {
+            float toLinear[256];
+            float thresholds[255];
+            SrgbTables()
+            {
+                for (uint32_t i = 0; i < 256; i++) toLinear[i] = srgbToLinear(i / 255.f);
+                for (uint32_t i = 0; i < 255; i++) thresholds[i] = srgbToLinear((i + 0.5f) / 255.f);
+            }
+        };
+        const SrgbTables kSrgb;
+
+        uint8_t linearToUnorm8(float c, bool srgb)
+        {
+            if (srgb) return uint8_t(std::upper_bound(kSrgb.thresholds, kSrgb.thresholds + 255, c) - kSrgb.thresholds);
+            return uint8_t(glm::clamp(c * 255.f + 0.5f, 0.f, 255.f));
+        }
+
+        // Get a bitmap's texels as linear RGBA. Returns the number of channels, or 0 if the cache doesn't handle the format.
+        uint32_t toLinearImage(const Bitmap& bitmap, bool srgb, LinearImage& image)
+        {
+            uint32_t channels;
+            switch (bitmap.getFormat())
+            {
+            case ResourceFormat::BGRA8Unorm:
+            case ResourceFormat::BGRX8Unorm:
+                channels = 4;
+                break;
+            case ResourceFormat::RG8Unorm:
+                channels = 2;
+                break;
+            case ResourceFormat::R8Unorm:
+                channels = 1;
+                break;
+            default:
+                return 0;
+            }
+
+            // There are no sRGB formats with fewer than 4 channels
+            srgb = srgb && (channels == 4);
+            bool hasAlpha = (bitmap.getFormat() == ResourceFormat::BGRA8Unorm);
+            image.width = bitmap.getWidth();
+            image.height = bitmap.getHeight();
+            image.texels.resize(size_t(image.width) * image.height);
+            const uint8_t* pSrc = bitmap.getData();
+            for (size_t i = 0; i < image.texels.size(); i++, pSrc += channels)
+            {
+                vec4& t = image.texels[i];
+                switch (channels)
+                {
+                case 4:
+                    t.r = srgb ? kSrgb.toLinear[pSrc[2]] : pSrc[2] / 255.f;
+                    t.g = srgb ? kSrgb.toLinear[pSrc[1]] : pSrc[1] / 255.f;
+                    t.b = srgb ? kSrgb.toLinear[pSrc[0]] : pSrc[0] / 255.f;
+                    t.a = hasAlpha ? pSrc[3] / 255.f : 1.f;
+                    break;
+                case 2:
+                    t = vec4(pSrc[0] / 255.f, pSrc[1] / 255.f, 0.f, 1.f);
+                    break;
+                default:
+                    t = vec4(pSrc[0] / 255.f, 0.f, 0.f, 1.f);
+                }
+            }
+            return channels;
+        }
+
+        // Build the entry for a decoded image: filter the mip chain, then store or encode each level
+        bool buildEntry(const Bitmap& bitmap, const TextureCache::Settings& settings, bool srgb, DdsData& dds)
+        {
+            LinearImage level;
+            uint32_t channels = toLinearImage(bitmap, srgb, level);
+            if (channels == 0) return false;
+            srgb = srgb && (channels == 4);
+
+            bool opaque = true;
+            for (const vec4& t : level.texels) opaque = opaque && (t.a == 1.f);
+
+            bool compress = (settings.compression != TextureCache::Compression::None) && (level.width % 4 == 0) && (level.height % 4 == 0);
+            BcEncoder::Format bcFormat;
+            DXFormat dxFormat;
+            if (channels == 4)
+            {
+                bcFormat = (settings.compression == TextureCache::Compression::BC7) ? BcEncoder::Format::BC7 : (opaque ? BcEncoder::Format::BC1 : BcEncoder::Format::BC3);
+                dxFormat = compress ? ((bcFormat == BcEncoder::Format::BC7) ? FORMAT_BC7_UNORM : (opaque ? FORMAT_BC1_UNORM : FORMAT_BC3_UNORM)) : FORMAT_R8G8B8A8_UNORM;
+            }
+            else if (channels == 2)
+            {
+                bcFormat = BcEncoder::Format::BC5;
+                dxFormat = compress ? FORMAT_BC5_UNORM : FORMAT_R8G8_UNORM;
+            }
+            else
+            {
+                bcFormat = BcEncoder::Format::BC4;
+                dxFormat = compress ? FORMAT_BC4_UNORM : FORMAT_R8_UNORM;
+            }
+
+            uint32_t mipCount = 0;
+            std::vector<uint8_t> texels;
+            dds.data.clear();
+            while (true)
+            {
+                texels.resize(level.texels.size() * 4);
+                for (size_t i = 0; i < level.texels.size(); i++)
+                {
+                    for (uint32_t c = 0; c < 4; c++) texels[i * 4 + c] = linearToUnorm8(level.texels[i][c], srgb && c < 3);
+                }
+
+                if (compress)
+                {
+                    BcEncoder::encodeImage(bcFormat, texels.data(), level.width, level.height, dds.data);
+                }
+                else
+                {
+                    for (size_t i = 0; i < level.texels.size(); i++) dds.data.insert(dds.data.end(), &texels[i * 4], &texels[i * 4] + channels);
+                }
+                mipCount++;
+
+                if (level.width == 1 && level.height == 1) break;
+                LinearImage next;
+                downsample(level, next, settings.mipFilter);
+                level = std::move(next);
+            }
+
+            std::memset(&dds.header, 0, sizeof(dds.header));
+            dds.header.headerSize = sizeof(DdsHeader);
+            dds.header.flags = DdsHeader::kCapsMask | DdsHeader::kHeightMask | DdsHeader::kWidthMask | DdsHeader::kPixelFormatMask | DdsHeader::kMipCountMask;
+            dds.header.width = bitmap.getWidth();
+            dds.header.height = bitmap.getHeight();
+            dds.header.depth = 1;
+            dds.header.mipCount = mipCount;
+            dds.header.pixelFormat.structSize = sizeof(DdsHeader::PixelFormat);
+            dds.header.pixelFormat.flags = DdsHeader::PixelFormat::kFourCCFlag;
+            dds.header.pixelFormat.fourCC = 0x30315844;  // "DX10"
+            dds.header.caps[0] = DdsHeader::kCapsTextureMask | DdsHeader::kCapsComplexMask | DdsHeader::kCapsMipMapMask;
+
+            dds.hasDX10Header = true;
+            dds.dx10Header.dxgiFormat = dxFormat;
+            dds.dx10Header.resourceDimension = RESOURCE_DIMENSION_TEXTURE2D;
+            dds.dx10Header.miscFlag = 0;
+            dds.dx10Header.arraySize = 1;
+            dds.dx10Header.miscFlags2 = 0;
+            return true;
+        }
+    }
+
+    void TextureCache::setSettings(const Settings& settings)
+    {
+        if (settings.directory.size() && isDirectoryExists(settings.directory) == false && createDirectory(settings.directory) == false)
+        {
+            logWarning("TextureCache::setSettings() - can't create directory " + settings.directory + ". The texture cache is disabled.");
+            std::lock_guard<std::mutex> lock(sMutex);
+            sSettings = Settings();
+            return;
+        }
+        std::lock_guard<std::mutex> lock(sMutex);
+        sSettings = settings;
+    }
+
+    TextureCache::Settings TextureCache::getSettings()
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        return sSettings;
+    }
+
+    bool TextureCache::isEnabled()
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        return sSettings.directory.size() > 0;
+    }
+
+    TextureCache::Stats TextureCache::getStats()
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        return sStats;
+    }
+
+    void TextureCache::resetStats()
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        sStats = Stats();
+    }
+
+    bool TextureCache::load(const std::string& filename, bool loadAsSrgb, TextureFileData& data)
+    {
+        CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+        data = TextureFileData();
+        data.filename = filename;
+
+        std::string fullpath;
+        if (findFileInDataDirectories(filename, fullpath) == false)
+        {
+            logError("TextureCache::load() - can't find texture file " + filename);
+            return false;
+        }
+
+        Settings settings = getSettings();
+        if (settings.directory.empty())
+        {
+            data.pBitmap = Bitmap::createFromFile(fullpath, true);
+            return data.pBitmap != nullptr;
+        }
+
+        uint32_t options = getOptions(settings, loadAsSrgb);
+        std::string entryFilename = getEntryFilename(settings, fullpath, options);
+
+        SourceInfo source;
+        source.time = uint64_t(getFileModifiedTime(fullpath));
+        std::vector<uint8_t> content;
+        bool hashed = false;
+        auto hashSource = [&]()
+        {
+            if (hashed) return;
+            hashed = true;
+            if (readFileContent(fullpath, content) == false) content.clear();
+            source.size = content.size();
+            source.hash = hash64(content.data(), content.size(), 0);
+        };
+        {
+            BinaryFileStream stream(fullpath, BinaryFileStream::Mode::Read);
+            source.size = stream.getRemainingStreamSize();
+        }
+
+        // Look for an entry made from this version of the source
+        bool invalidated = false;
+        if (doesFileExist(entryFilename))
+        {
+            DdsData& dds = data.dds;
+            if (readEntry(entryFilename, dds.header, dds.dx10Header, nullptr) && dds.header.reserved[Options] == options)
+            {
+                bool valid = (getEntryField64(dds.header, SizeLo) == source.size);
+                bool rehashed = false;
+                if (valid && getEntryField64(dds.header, TimeLo) != source.time)
+                {
+                    hashSource();
+                    valid = (getEntryField64(dds.header, HashLo) == source.hash);
+                    rehashed = valid;
+                }
+
+                if (valid && readEntry(entryFilename, dds.header, dds.dx10Header, &dds.data))
+                {
+                    if (rehashed)
+                    {
+                        setEntryField64(dds.header, TimeLo, source.time);
+                        updateEntryHeader(entryFilename, dds.header);
+                    }
+
+                    dds.hasDX10Header = true;
+                    data.isDds = true;
+                    data.isCached = true;
+
+                    std::lock_guard<std::mutex> lock(sMutex);
+                    sStats.hits++;
+                    sStats.rehashed += rehashed ? 1 : 0;
+                    sStats.hitMs += CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+                    sStats.sourceBytes += uint64_t(dds.header.width) * dds.header.height * 4;
+                    sStats.cachedBytes += dds.data.size();
+                    return true;
+                }
+            }
+            invalidated = true;
+        }
+
+        // Miss. Decode the source and build its entry.
+        data.dds = DdsData();
+        data.pBitmap = Bitmap::createFromFile(fullpath, true);
+        if (data.pBitmap == nullptr) return false;
+
+        DdsData dds;
+        if (buildEntry(*data.pBitmap, settings, loadAsSrgb, dds) == false)
+        {
+            std::lock_guard<std::mutex> lock(sMutex);
+            sStats.uncached++;
+            return true;
+        }
+
+        hashSource();
+        dds.header.reserved[Magic] = kEntryMagic;
+        dds.header.reserved[Options] = options;
+        setEntryField64(dds.header, TimeLo, source.time);
+        setEntryField64(dds.header, SizeLo, source.size);
+        setEntryField64(dds.header, HashLo, source.hash);
+        if (writeEntry(entryFilename, dds) == false)
+        {
+            logWarning("TextureCache::load() - can't write " + entryFilename);
+        }
+
+        uint64_t sourceBytes = uint64_t(data.pBitmap->getWidth()) * data.pBitmap->getHeight() * 4;
+        data.pBitmap = nullptr;
+        data.dds = std::move(dds);
+        data.isDds = true;
+        data.isCached = true;
+
+        std::lock_guard<std::mutex> lock(sMutex);
+        sStats.misses++;
+        sStats.invalidated += invalidated ? 1 : 0;
+        sStats.missMs += CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+        sStats.sourceBytes += sourceBytes;
+        sStats.cachedBytes += data.dds.data.size();
+        return true;
+    }
+}
@@ -0,0 +1,121 @@
+/***************************************************************************
+# Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+#pragma once
+#include <string>
+#include "Graphics/TextureHelper.h"
+
+namespace Falcor
+{
+    /** An on-disk cache of textures that have been decoded, mip-mapped and block compressed on the CPU.
+        On a miss, the source image is decoded, its full mip chain is filtered in linear space (converting from and back to sRGB
+        for sRGB textures), each level is encoded with BcEncoder and the result is written as a DDS file. On the next launch
+        that DDS file is loaded instead, through the same path createTextureFromDDSFile() uses.
+
+        Entries are named after a hash of the source path and the settings that affect their content. Each entry records the
+        source's modification time, size and a hash of its content in the DDS header's reserved fields. An entry is used as is
+        while the modification time and size match. If only the time changed, the content hash is checked and, if it still
+        matches, the entry is kept. Otherwise it's rebuilt.
+
+        The cache is disabled until a directory is set. It handles 8-bit images with 1, 2 or 4 channels; other images (HDR
+        formats, DDS files) are loaded as before. Block compression needs the top level to be a multiple of 4 texels in each
+        dimension, so other sizes are cached uncompressed, with their mip chain.
+
+        loadTextureFileData() (and so createTextureFromFile()) goes through the cache when it's enabled. All functions are thread safe.
+
+        Usage:
+            TextureCache::Settings settings;
+            settings.directory = "TextureCache";
+            TextureCache::setSettings(settings);
+            ...
+            TextureCache::Stats stats = TextureCache::getStats();
+    */
+    class TextureCache
+    {
+    public:
+        enum class Compression
+        {
+            None,       ///< Keep 8-bit texels
+            BC,         ///< BC1 for opaque color, BC3 for color with alpha, BC4 for one channel and BC5 for two
+            BC7,        ///< BC7 for color, with or without alpha. Slower to encode, higher quality. BC4 and BC5 as above.
+        };
+
+        enum class MipFilter
+        {
+            Box,        ///< Average of the texels each mip texel covers
+            Kaiser,     ///< Kaiser-windowed sinc. Sharper than the box filter.
+        };
+
+        struct Settings
+        {
+            std::string directory;                      ///< Where entries are stored. The cache is disabled while this is empty.
+            Compression compression = Compression::BC;
+            MipFilter mipFilter = MipFilter::Kaiser;
+        };
+
+        struct Stats
+        {
+            uint32_t hits = 0;              ///< Loaded from the cache
+            uint32_t misses = 0;            ///< Built and written to the cache, including invalidated entries
+            uint32_t invalidated = 0;       ///< Misses where an entry existed, but the source had changed
+            uint32_t rehashed = 0;          ///< Hits where the source's time changed, but its content didn't
+            uint32_t uncached = 0;          ///< Images the cache doesn't handle, loaded as before
+            float hitMs = 0;                ///< Time spent loading hits, summed over threads
+            float missMs = 0;               ///< Time spent decoding, filtering and encoding misses, summed over threads
+            uint64_t sourceBytes = 0;       ///< Decoded size of the top level of every image built or loaded
+            uint64_t cachedBytes = 0;       ///< Size of their cached mip chains
+        };
+
+        /** Set where and how textures are cached. Entries built with other settings are kept; they are used again when the settings are switched back.
+        */
+        static void setSettings(const Settings& settings);
+
+        /** Get the current settings
+        */
+        static Settings getSettings();
+
+        /** Check if a directory has been set
+        */
+        static bool isEnabled();
+
+        /** Get the statistics since the last resetStats()
+        */
+        static Stats getStats();
+
+        /** Reset the statistics
+        */
+        static void resetStats();
+
+        /** Load an image through the cache, building its entry on a miss.
+            \param[in] filename Filename of the image. Can also include a full path or relative path from a data directory
+            \param[in] loadAsSrgb Whether the texture will be created with an sRGB format. Mips of sRGB images are filtered in linear space.
+            \param[out] data On success, the cached DDS with its full mip chain (data.isCached is set), or the decoded image if the cache doesn't handle it
+            \return Whether the image could be loaded
+        */
+        static bool load(const std::string& filename, bool loadAsSrgb, TextureFileData& data);
+    };
+}
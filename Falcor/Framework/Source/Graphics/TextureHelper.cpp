@@ -27,6 +27,7 @@
 ***************************************************************************/
 #include "Framework.h"
 #include "TextureHelper.h"
+#include "TextureCache.h"
 #include "API/Texture.h"
 #include "Utils/Bitmap.h"
 #include "Utils/DDSHeader.h"
@@ -540,14 +541,14 @@ namespace Falcor
         }
     }
 
-    void loadDDSDataFromFile(const std::string filename, DdsData& ddsData)
+    bool loadDDSDataFromFile(const std::string filename, DdsData& ddsData)
     {
         std::string fullpath;
         if (findFileInDataDirectories(filename, fullpath) == false)
         {
             msgBox("Error when loading DDS file. Can't find texture file " + filename);
             //could not find file
-            return;
+            return false;
         }
 
         BinaryFileStream stream(fullpath, BinaryFileStream::Mode::Read);
@@ -559,7 +560,7 @@ namespace Falcor
         {
             //not valid dds file apparently
             logError(std::string("The dds file ") + filename + std::string(" is not a valid dds file"));
-            return;
+            return false;
         }
 
         stream >> ddsData.header;
@@ -577,6 +578,7 @@ namespace Falcor
         uint32_t dataSize = stream.getRemainingStreamSize();
         ddsData.data.resize(dataSize);
         stream.read(ddsData.data.data(), dataSize);
+        return true;
     }
 
     static ResourceFormat convertBgrxFormatToBgra(DdsData& ddsData, ResourceFormat format)
@@ -663,11 +665,8 @@ namespace Falcor
         return nullptr;
     }
 
-    Texture::SharedPtr createTextureFromDDSFile(const std::string filename, bool generateMips, bool loadAsSrgb, Texture::BindFlags bindFlags)
+    Texture::SharedPtr createTextureFromDdsData(DdsData& ddsData, const std::string& filename, bool generateMips, bool loadAsSrgb, Texture::BindFlags bindFlags)
     {
-        DdsData ddsData;
-        loadDDSDataFromFile(filename, ddsData);
-
         ResourceFormat format = getDdsResourceFormat(ddsData);
         assert(format != ResourceFormat::Unknown);
 
@@ -697,40 +696,87 @@ namespace Falcor
         return nullptr;
     }
 
-    Texture::SharedPtr createTextureFromFile(const std::string& filename, bool generateMipLevels, bool loadAsSrgb, Texture::BindFlags bindFlags)
+    Texture::SharedPtr createTextureFromDDSFile(const std::string filename, bool generateMips, bool loadAsSrgb, Texture::BindFlags bindFlags)
     {
-#define no_srgb()   \
-    if(loadAsSrgb)  \
-    {               \
-        logWarning("createTexture2DFromFile() warning. " + std::to_string(pBitmap->getBytesPerPixel()) + " channel images doesn't have a matching sRGB format. Loading in linear space.");  \
+        DdsData ddsData;
+        if (loadDDSDataFromFile(filename, ddsData) == false) return nullptr;
+        return createTextureFromDdsData(ddsData, filename, generateMips, loadAsSrgb, bindFlags);
     }
 
-        Texture::SharedPtr pTex;
+    bool loadTextureFileData(const std::string& filename, bool loadAsSrgb, TextureFileData& data)
+    {
+        if (hasSuffix(filename, ".dds") == false && TextureCache::isEnabled())
+        {
+            return TextureCache::load(filename, loadAsSrgb, data);
+        }
+
+        data = TextureFileData();
+        data.filename = filename;
         if (hasSuffix(filename, ".dds"))
         {
-            pTex = createTextureFromDDSFile(filename, generateMipLevels, loadAsSrgb, bindFlags);
+            data.isDds = true;
+            return loadDDSDataFromFile(filename, data.dds);
         }
-        else
+        data.pBitmap = Bitmap::createFromFile(filename, kTopDown);
+        return data.pBitmap != nullptr;
+    }
+
+    Texture::SharedPtr createTextureFromFileData(const TextureFileData& data, bool generateMipLevels, bool loadAsSrgb, Texture::BindFlags bindFlags)
+    {
+        Texture::SharedPtr pTex;
+        if (data.isDds)
         {
-            Bitmap::UniqueConstPtr pBitmap = Bitmap::createFromFile(filename, kTopDown);
-            if(pBitmap)
+            // Creating the texture may flip the payload in place, and the data can be shared by several importers
+            DdsData ddsData = data.dds;
+            if (data.isCached)
             {
-                ResourceFormat texFormat = pBitmap->getFormat();
-                if(loadAsSrgb)
-                {
-                    texFormat = linearToSrgbFormat(texFormat);
-                }
-
-                pTex = Texture::create2D(pBitmap->getWidth(), pBitmap->getHeight(), texFormat, 1, generateMipLevels ? Texture::kMaxPossible : 1, pBitmap->getData(), bindFlags);
+                // Cached entries carry their full mip chain, so use as much of it as was asked for instead of generating mips
+                if (generateMipLevels == false) ddsData.header.mipCount = 1;
+                generateMipLevels = false;
+            }
+            pTex = createTextureFromDdsData(ddsData, data.filename, generateMipLevels, loadAsSrgb, bindFlags);
+        }
+        else if (data.pBitmap)
+        {
+            const Bitmap* pBitmap = data.pBitmap.get();
+            ResourceFormat texFormat = pBitmap->getFormat();
+            if(loadAsSrgb)
+            {
+                texFormat = linearToSrgbFormat(texFormat);
             }
+
+            pTex = Texture::create2D(pBitmap->getWidth(), pBitmap->getHeight(), texFormat, 1, generateMipLevels ? Texture::kMaxPossible : 1, pBitmap->getData(), bindFlags);
         }
 
         if (pTex != nullptr)
         {
-            pTex->setSourceFilename(stripDataDirectories(filename));
+            pTex->setSourceFilename(stripDataDirectories(data.filename));
         }
 
         return pTex;
     }
+
+    Texture::SharedPtr createTextureFromFile(const std::string& filename, bool generateMipLevels, bool loadAsSrgb, Texture::BindFlags bindFlags)
+    {
+#define no_srgb()   \
+    if(loadAsSrgb)  \
+    {               \
+        logWarning("createTexture2DFromFile() warning. " + std::to_string(pBitmap->getBytesPerPixel()) + " channel images doesn't have a matching sRGB format. Loading in linear space.");  \
+    }
+
+        if (hasSuffix(filename, ".dds"))
+        {
+            // Skips the copy createTextureFromFileData() makes of the payload
+            Texture::SharedPtr pTex = createTextureFromDDSFile(filename, generateMipLevels, loadAsSrgb, bindFlags);
+            if (pTex != nullptr)
+            {
+                pTex->setSourceFilename(stripDataDirectories(filename));
+            }
+            return pTex;
+        }
+
+        TextureFileData data;
+        return loadTextureFileData(filename, loadAsSrgb, data) ? createTextureFromFileData(data, generateMipLevels, loadAsSrgb, bindFlags) : nullptr;
+    }
 #undef no_srgb
 }
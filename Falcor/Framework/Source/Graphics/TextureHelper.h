@@ -28,6 +28,8 @@
 #pragma once
 #include <string>
 #include "API/Texture.h"
+#include "Utils/Bitmap.h"
+#include "Utils/DDSHeader.h"
 namespace Falcor
 {
     /*!
@@ -43,5 +45,31 @@ namespace Falcor
     */
     Texture::SharedPtr createTextureFromFile(const std::string& filename, bool generateMipLevels, bool loadAsSrgb, Texture::BindFlags bindFlags = Texture::BindFlags::ShaderResource);
 
+    /** An image file read and decoded on the CPU, but not yet uploaded. See loadTextureFileData().
+    */
+    struct TextureFileData
+    {
+        std::string filename;
+        bool isDds = false;
+        bool isCached = false;              ///< The DDS came from the TextureCache, with its full mip chain
+        Bitmap::UniqueConstPtr pBitmap;     ///< The decoded image, unless isDds
+        DdsHelper::DdsData dds;             ///< The file's header and payload, if isDds
+    };
+
+    /** Read and decode an image file without touching the device. This is the expensive part of createTextureFromFile(),
+        and it is safe to call from any thread, so many files can be decoded in parallel.
+        Goes through the TextureCache when it's enabled, in which case data holds the cached DDS instead of the decoded image.
+        \param[in] filename Filename of the image. Can also include a full path or relative path from a data directory
+        \param[in] loadAsSrgb Whether the texture will be created with an sRGB format. Selects the cache entry, since mips of sRGB images are filtered in linear space.
+        \param[out] data The decoded image
+        \return Whether the file could be read
+    */
+    bool loadTextureFileData(const std::string& filename, bool loadAsSrgb, TextureFileData& data);
+
+    /** Create a texture from data returned by loadTextureFileData(). Must be called from the thread that owns the device.
+        The data is left unchanged, so it can be used for several textures. Other parameters are as for createTextureFromFile().
+    */
+    Texture::SharedPtr createTextureFromFileData(const TextureFileData& data, bool generateMipLevels, bool loadAsSrgb, Texture::BindFlags bindFlags = Texture::BindFlags::ShaderResource);
+
     /*! @} */
 }
\ No newline at end of file
@@ -0,0 +1,433 @@
+/***************************************************************************
+# Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+#include "Framework.h"
+#include "BcEncoder.h"
+#include "Utils/TaskScheduler.h"
+#include <cstring>
+
+namespace Falcor
+{
+    namespace BcEncoder
+    {
+        namespace
+        {
+            // Writes bit fields least-significant bit first, as BC7 blocks are laid out
+            class BitWriter
+            {
+            public:
+                BitWriter(uint8_t* pBlock, uint32_t size) : mpBlock(pBlock) { std::memset(pBlock, 0, size); }
+                void write(uint32_t value, uint32_t bits)
+                {
+                    for (uint32_t i = 0; i < bits; i++, mPos++)
+                    {
+                        if ((value >> i) & 1) mpBlock[mPos >> 3] |= uint8_t(1 << (mPos & 7));
+                    }
+                }
+            private:
+                uint8_t* mpBlock;
+                uint32_t mPos = 0;
+            };
+
+            // The principal axis of a set of colors, by power iteration on their covariance
+            template<typename VecType, typename MatType>
+            VecType principalAxis(const VecType* colors, uint32_t count, const VecType& mean, const VecType& initial)
+            {
+                MatType cov(0.f);
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    VecType d = colors[i] - mean;
+                    cov += glm::outerProduct(d, d);
+                }
+
+                VecType axis = initial;
+                for (uint32_t iteration = 0; iteration < 8; iteration++)
+                {
+                    VecType next = cov * axis;
+                    float len = glm::length(next);
+                    if (len < 1e-6f) break;
+                    axis = next / len;
+                }
+                float len = glm::length(axis);
+                return (len > 1e-6f) ? axis / len : VecType(0.f);
+            }
+
+            // Endpoints along the principal axis, covering the colors' projections and inset slightly, as range fitting does
+            template<typename VecType, typename MatType>
+            void fitEndpoints(const VecType* colors, uint32_t count, VecType& e0, VecType& e1)
+            {
+                VecType mean(0.f), lo(255.f), hi(0.f);
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    mean += colors[i];
+                    lo = glm::min(lo, colors[i]);
+                    hi = glm::max(hi, colors[i]);
+                }
+                mean /= float(count);
+
+                VecType axis = principalAxis<VecType, MatType>(colors, count, mean, hi - lo);
+                float tMin = 0.f, tMax = 0.f;
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    float t = glm::dot(colors[i] - mean, axis);
+                    tMin = glm::min(tMin, t);
+                    tMax = glm::max(tMax, t);
+                }
+                float inset = (tMax - tMin) / 16.f;
+                e0 = glm::clamp(mean + axis * (tMax - inset), VecType(0.f), VecType(255.f));
+                e1 = glm::clamp(mean + axis * (tMin + inset), VecType(0.f), VecType(255.f));
+            }
+
+            // Least-squares endpoints for fixed indices, where texel i is (1 - w[i]) * e0 + w[i] * e1. Returns false if the system is singular.
+            template<typename VecType>
+            bool solveEndpoints(const VecType* colors, const float* weights, uint32_t count, VecType& e0, VecType& e1)
+            {
+                float aa = 0.f, ab = 0.f, bb = 0.f;
+                VecType ax(0.f), bx(0.f);
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    float b = weights[i];
+                    float a = 1.f - b;
+                    aa += a * a;
+                    ab += a * b;
+                    bb += b * b;
+                    ax += a * colors[i];
+                    bx += b * colors[i];
+                }
+                float det = aa * bb - ab * ab;
+                if (std::abs(det) < 1e-6f) return false;
+                e0 = glm::clamp((ax * bb - bx * ab) / det, VecType(0.f), VecType(255.f));
+                e1 = glm::clamp((bx * aa - ax * ab) / det, VecType(0.f), VecType(255.f));
+                return true;
+            }
+
+            /************************************************************************/
+            /* BC1                                                                  */
+            /************************************************************************/
+            uint16_t packRgb565(const vec3& c)
+            {
+                uint32_t r = uint32_t(glm::clamp(c.r * (31.f / 255.f) + 0.5f, 0.f, 31.f));
+                uint32_t g = uint32_t(glm::clamp(c.g * (63.f / 255.f) + 0.5f, 0.f, 63.f));
+                uint32_t b = uint32_t(glm::clamp(c.b * (31.f / 255.f) + 0.5f, 0.f, 31.f));
+                return uint16_t((r << 11) | (g << 5) | b);
+            }
+
+            vec3 unpackRgb565(uint16_t c)
+            {
+                uint32_t r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+                return vec3(float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)), float((b << 3) | (b >> 2)));
+            }
+
+            struct Bc1Candidate
+            {
+                uint16_t c0 = 0;
+                uint16_t c1 = 0;
+                uint32_t indices = 0;
+                float error = FLT_MAX;
+                float weights[16];       ///< Position of each texel's palette entry between c0 and c1
+            };
+
+            // Pick the nearest of the 4-color palette for each texel. BC1's 4-color mode needs c0 > c1, so the endpoints are swapped if needed.
+            void evaluateBc1(const vec3 colors[16], uint16_t c0, uint16_t c1, Bc1Candidate& result)
+            {
+                if (c0 < c1) std::swap(c0, c1);
+                static const float kWeights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+                vec3 e0 = unpackRgb565(c0), e1 = unpackRgb565(c1);
+                vec3 palette[4] = { e0, e1, (2.f * e0 + e1) / 3.f, (e0 + 2.f * e1) / 3.f };
+                uint32_t paletteSize = (c0 == c1) ? 1 : 4;   // Equal endpoints select the 3-color mode, where only entry 0 is safe to use
+
+                Bc1Candidate candidate;
+                candidate.c0 = c0;
+                candidate.c1 = c1;
+                candidate.error = 0.f;
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    uint32_t best = 0;
+                    float bestError = FLT_MAX;
+                    for (uint32_t p = 0; p < paletteSize; p++)
+                    {
+                        vec3 d = colors[i] - palette[p];
+                        float e = glm::dot(d, d);
+                        if (e < bestError)
+                        {
+                            bestError = e;
+                            best = p;
+                        }
+                    }
+                    candidate.indices |= best << (2 * i);
+                    candidate.weights[i] = kWeights[best];
+                    candidate.error += bestError;
+                }
+
+                if (candidate.error < result.error) result = candidate;
+            }
+
+            void encodeBc1Color(const uint8_t texels[16][4], uint8_t* pBlock)
+            {
+                vec3 colors[16];
+                for (uint32_t i = 0; i < 16; i++) colors[i] = vec3(texels[i][0], texels[i][1], texels[i][2]);
+
+                vec3 e0, e1;
+                fitEndpoints<vec3, mat3>(colors, 16, e0, e1);
+                Bc1Candidate best;
+                evaluateBc1(colors, packRgb565(e0), packRgb565(e1), best);
+
+                // Refine the endpoints for the chosen indices
+                for (uint32_t iteration = 0; iteration < 2; iteration++)
+                {
+                    if (solveEndpoints(colors, best.weights, 16, e0, e1) == false) break;
+                    evaluateBc1(colors, packRgb565(e0), packRgb565(e1), best);
+                }
+
+                pBlock[0] = uint8_t(best.c0);
+                pBlock[1] = uint8_t(best.c0 >> 8);
+                pBlock[2] = uint8_t(best.c1);
+                pBlock[3] = uint8_t(best.c1 >> 8);
+                for (uint32_t i = 0; i < 4; i++) pBlock[4 + i] = uint8_t(best.indices >> (8 * i));
+            }
+
+            /************************************************************************/
+            /* BC4 (and the alpha block of BC3)                                     */
+            /************************************************************************/
+            void encodeBc4Channel(const uint8_t texels[16][4], uint32_t channel, uint8_t* pBlock)
+            {
+                uint32_t lo = 255, hi = 0;
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    lo = std::min(lo, uint32_t(texels[i][channel]));
+                    hi = std::max(hi, uint32_t(texels[i][channel]));
+                }
+
+                // With a0 > a1 the palette is a0, a1 and 6 values in between
+                uint32_t palette[8] = { hi, lo };
+                for (uint32_t p = 2; p < 8; p++) palette[p] = ((8 - p) * hi + (p - 1) * lo + 3) / 7;
+
+                uint64_t indices = 0;
+                if (hi != lo)
+                {
+                    for (uint32_t i = 0; i < 16; i++)
+                    {
+                        uint32_t best = 0, bestError = UINT32_MAX;
+                        for (uint32_t p = 0; p < 8; p++)
+                        {
+                            uint32_t e = uint32_t(std::abs(int32_t(texels[i][channel]) - int32_t(palette[p])));
+                            if (e < bestError)
+                            {
+                                bestError = e;
+                                best = p;
+                            }
+                        }
+                        indices |= uint64_t(best) << (3 * i);
+                    }
+                }
+
+                pBlock[0] = uint8_t(hi);
+                pBlock[1] = uint8_t(lo);
+                for (uint32_t i = 0; i < 6; i++) pBlock[2 + i] = uint8_t(indices >> (8 * i));
+            }
+
+            /************************************************************************/
+            /* BC7, mode 6                                                          */
+            /************************************************************************/
+            const uint32_t kBc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+            struct Bc7Endpoint
+            {
+                uint32_t q[4];          ///< 7-bit RGBA
+                uint32_t p;             ///< Shared least significant bit
+                uint32_t value(uint32_t c) const { return (q[c] << 1) | p; }
+            };
+
+            // Quantize an endpoint to 7 bits per channel plus a shared bit, choosing the shared bit that fits best
+            Bc7Endpoint quantizeBc7(const vec4& e)
+            {
+                Bc7Endpoint best;
+                float bestError = FLT_MAX;
+                for (uint32_t p = 0; p < 2; p++)
+                {
+                    Bc7Endpoint candidate;
+                    candidate.p = p;
+                    float error = 0.f;
+                    for (uint32_t c = 0; c < 4; c++)
+                    {
+                        candidate.q[c] = uint32_t(glm::clamp((e[c] - float(p)) * 0.5f + 0.5f, 0.f, 127.f));
+                        float d = float(candidate.value(c)) - e[c];
+                        error += d * d;
+                    }
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best = candidate;
+                    }
+                }
+                return best;
+            }
+
+            struct Bc7Candidate
+            {
+                Bc7Endpoint e0;
+                Bc7Endpoint e1;
+                uint32_t indices[16];
+                float weights[16];
+                float error = FLT_MAX;
+            };
+
+            void evaluateBc7(const vec4 colors[16], const vec4& e0, const vec4& e1, Bc7Candidate& result)
+            {
+                Bc7Candidate candidate;
+                candidate.e0 = quantizeBc7(e0);
+                candidate.e1 = quantizeBc7(e1);
+
+                vec4 palette[16];
+                for (uint32_t p = 0; p < 16; p++)
+                {
+                    for (uint32_t c = 0; c < 4; c++)
+                    {
+                        palette[p][c] = float(((64 - kBc7Weights[p]) * candidate.e0.value(c) + kBc7Weights[p] * candidate.e1.value(c) + 32) >> 6);
+                    }
+                }
+
+                candidate.error = 0.f;
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    uint32_t best = 0;
+                    float bestError = FLT_MAX;
+                    for (uint32_t p = 0; p < 16; p++)
+                    {
+                        vec4 d = colors[i] - palette[p];
+                        float e = glm::dot(d, d);
+                        if (e < bestError)
+                        {
+                            bestError = e;
+                            best = p;
+                        }
+                    }
+                    candidate.indices[i] = best;
+                    candidate.weights[i] = float(kBc7Weights[best]) / 64.f;
+                    candidate.error += bestError;
+                }
+
+                if (candidate.error < result.error) result = candidate;
+            }
+
+            void encodeBc7Mode6(const uint8_t texels[16][4], uint8_t* pBlock)
+            {
+                vec4 colors[16];
+                for (uint32_t i = 0; i < 16; i++) colors[i] = vec4(texels[i][0], texels[i][1], texels[i][2], texels[i][3]);
+
+                vec4 e0, e1;
+                fitEndpoints<vec4, mat4>(colors, 16, e0, e1);
+                Bc7Candidate best;
+                evaluateBc7(colors, e0, e1, best);
+
+                for (uint32_t iteration = 0; iteration < 2; iteration++)
+                {
+                    if (solveEndpoints(colors, best.weights, 16, e0, e1) == false) break;
+                    evaluateBc7(colors, e0, e1, best);
+                }
+
+                // The first texel's index is stored without its top bit, so it must be below 8
+                if (best.indices[0] >= 8)
+                {
+                    std::swap(best.e0, best.e1);
+                    for (uint32_t i = 0; i < 16; i++) best.indices[i] = 15 - best.indices[i];
+                }
+
+                BitWriter writer(pBlock, 16);
+                writer.write(1 << 6, 7);                // Mode 6
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    writer.write(best.e0.q[c], 7);
+                    writer.write(best.e1.q[c], 7);
+                }
+                writer.write(best.e0.p, 1);
+                writer.write(best.e1.p, 1);
+                writer.write(best.indices[0], 3);
+                for (uint32_t i = 1; i < 16; i++) writer.write(best.indices[i], 4);
+            }
+        }
+
+        uint32_t getBlockSize(Format format)
+        {
+            return (format == Format::BC1 || format == Format::BC4) ? 8 : 16;
+        }
+
+        void encodeBlock(Format format, const uint8_t texels[16][4], uint8_t* pBlock)
+        {
+            switch (format)
+            {
+            case Format::BC1:
+                encodeBc1Color(texels, pBlock);
+                break;
+            case Format::BC3:
+                encodeBc4Channel(texels, 3, pBlock);
+                encodeBc1Color(texels, pBlock + 8);
+                break;
+            case Format::BC4:
+                encodeBc4Channel(texels, 0, pBlock);
+                break;
+            case Format::BC5:
+                encodeBc4Channel(texels, 0, pBlock);
+                encodeBc4Channel(texels, 1, pBlock + 8);
+                break;
+            case Format::BC7:
+                encodeBc7Mode6(texels, pBlock);
+                break;
+            default:
+                should_not_get_here();
+            }
+        }
+
+        void encodeImage(Format format, const uint8_t* pTexels, uint32_t width, uint32_t height, std::vector<uint8_t>& output)
+        {
+            uint32_t blocksX = (width + 3) / 4;
+            uint32_t blocksY = (height + 3) / 4;
+            uint32_t blockSize = getBlockSize(format);
+            size_t offset = output.size();
+            output.resize(offset + size_t(blocksX) * blocksY * blockSize);
+            uint8_t* pOutput = output.data() + offset;
+
+            TaskScheduler::getGlobal()->parallelFor(0, blocksY, [=](uint32_t begin, uint32_t end)
+            {
+                uint8_t texels[16][4];
+                for (uint32_t by = begin; by < end; by++)
+                {
+                    for (uint32_t bx = 0; bx < blocksX; bx++)
+                    {
+                        for (uint32_t i = 0; i < 16; i++)
+                        {
+                            uint32_t x = std::min(bx * 4 + (i & 3), width - 1);
+                            uint32_t y = std::min(by * 4 + (i >> 2), height - 1);
+                            std::memcpy(texels[i], pTexels + (size_t(y) * width + x) * 4, 4);
+                        }
+                        encodeBlock(format, texels, pOutput + (size_t(by) * blocksX + bx) * blockSize);
+                    }
+                }
+            });
+        }
+    }
+}
@@ -0,0 +1,67 @@
+/***************************************************************************
+# Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace Falcor
+{
+    /** CPU encoders for the BCn block-compressed texture formats.
+        Images are given as 8-bit RGBA texels, top row first. Blocks that cross the right or bottom edge repeat the edge texels.
+        BC1 and BC4 blocks are 8 bytes, the others 16 bytes.
+    */
+    namespace BcEncoder
+    {
+        enum class Format
+        {
+            BC1,        ///< RGB, 4 bits per texel. Alpha is ignored.
+            BC3,        ///< RGBA, 8 bits per texel. BC1 color plus an 8-level alpha block.
+            BC4,        ///< The red channel only, 4 bits per texel
+            BC5,        ///< Red and green, 8 bits per texel. Two BC4 blocks.
+            BC7,        ///< RGBA, 8 bits per texel. Always encoded in mode 6 (one subset, 7-bit endpoints with a shared bit, 16 levels).
+        };
+
+        /** Get the size of one compressed block in bytes
+        */
+        uint32_t getBlockSize(Format format);
+
+        /** Encode a single 4x4 block.
+            \param[in] format The format to encode to
+            \param[in] texels 16 RGBA texels, row by row
+            \param[out] pBlock Receives getBlockSize(format) bytes
+        */
+        void encodeBlock(Format format, const uint8_t texels[16][4], uint8_t* pBlock);
+
+        /** Encode an image. Rows of blocks are encoded in parallel on the global TaskScheduler.
+            \param[in] format The format to encode to
+            \param[in] pTexels width * height RGBA texels
+            \param[out] output The blocks are appended to it, row by row
+        */
+        void encodeImage(Format format, const uint8_t* pTexels, uint32_t width, uint32_t height, std::vector<uint8_t>& output);
+    }
+}
@@ -93,6 +93,22 @@ namespace Falcor
             mStream.ignore(count);
         }
 
+        /** Get the write position of an output stream.
+            \return Offset in bytes from the start of the file
+        */
+        uint64_t getWritePosition()
+        {
+            return uint64_t(mStream.tellp());
+        }
+
+        /** Move the write position of an output stream, to fill in data written earlier.
+            \param[in] position Offset in bytes from the start of the file
+        */
+        void setWritePosition(uint64_t position)
+        {
+            mStream.seekp(std::streamoff(position));
+        }
+
         /** Deletes the managed file.
         */
         void remove()
@@ -0,0 +1,133 @@
+/***************************************************************************
+# Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+#pragma once
+#include <cstring>
+#include <cstdint>
+
+namespace Falcor
+{
+    /** Reads binary data from memory, with the same interface as BinaryFileStream.
+        Unlike a file stream, it can hand out pointers into the data instead of copying it (see getSpan()), which is how
+        payloads of a MemoryMappedFile are used in place. Reads past the end set the fail state and return zeros; all
+        later reads fail, so a parser can check isFail() once at the end.
+    */
+    class BinaryMemoryStream
+    {
+    public:
+        /** Constructor
+            \param[in] pBase Start of the data. Offsets and alignment are relative to it.
+            \param[in] end Offset of the end of the readable range
+            \param[in] offset Offset of the first byte to read. Allows reading a section of the data.
+        */
+        BinaryMemoryStream(const uint8_t* pBase, size_t end, size_t offset = 0) : mpBase(pBase), mEnd(end), mOffset(offset)
+        {
+            mFail = offset > end;
+        }
+
+        /** Reads data from the stream
+            \param[out] pData Pointer to a buffer to copy data into
+            \param[in] count Number of bytes to read
+        */
+        BinaryMemoryStream& read(void* pData, size_t count)
+        {
+            const uint8_t* pSrc = getSpan(count);
+            if (pSrc)
+            {
+                std::memcpy(pData, pSrc, count);
+            }
+            else
+            {
+                std::memset(pData, 0, count);
+            }
+            return *this;
+        }
+
+        /** Get a pointer to the next bytes of the stream and skip them
+            \param[in] count Number of bytes
+            \return Pointer to the data, or nullptr if there are fewer than count bytes left
+        */
+        const uint8_t* getSpan(size_t count)
+        {
+            if (mFail || count > mEnd - mOffset)
+            {
+                mFail = true;
+                return nullptr;
+            }
+            const uint8_t* pData = mpBase + mOffset;
+            mOffset += count;
+            return pData;
+        }
+
+        /** Skip data in the stream
+            \param[in] count Bytes to skip
+        */
+        void skip(size_t count)
+        {
+            getSpan(count);
+        }
+
+        /** Skip to the next offset that is a multiple of alignment
+            \param[in] alignment Alignment in bytes
+        */
+        void align(size_t alignment)
+        {
+            skip((alignment - mOffset % alignment) % alignment);
+        }
+
+        /** Get the offset of the next byte to read
+        */
+        size_t getOffset() const { return mOffset; }
+
+        /** Calculates amount of remaining data in the stream
+            \return Number of bytes remaining in the stream
+        */
+        size_t getRemainingStreamSize() const { return mFail ? 0 : mEnd - mOffset; }
+
+        /** Checks for stream errors
+            \return Returns true if a read went past the end of the stream
+        */
+        bool isFail() const { return mFail; }
+
+        /** Checks for validity of the stream
+            \return Returns true if no errors have been encountered
+        */
+        bool isGood() const { return mFail == false; }
+
+        /** Extracts a value from the data stream
+            \param[in] val Value to read from the stream
+        */
+        template<typename T>
+        BinaryMemoryStream& operator>>(T& val) { return read(&val, sizeof(T)); }
+
+    private:
+        const uint8_t* mpBase;
+        size_t mEnd;
+        size_t mOffset;
+        bool mFail;
+    };
+}
@@ -25,29 +25,45 @@
 # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ***************************************************************************/
-#include <thread>
+#include "Framework.h"
+#include "MemoryMappedFile.h"
+#include "Utils/BinaryFileStream.h"
 
-template<uint32_t threadCount>
-class ThreadPool
+namespace Falcor
 {
-public:
-    ~ThreadPool()
+    MemoryMappedFile::~MemoryMappedFile()
     {
-        for (auto& t : mThreads)
+        unmapFile(mMapping);
+    }
+
+    MemoryMappedFile::SharedPtr MemoryMappedFile::create(const std::string& filename)
+    {
+        SharedPtr pFile = SharedPtr(new MemoryMappedFile());
+        if (mapFile(filename, pFile->mMapping) == false)
         {
-            if (t.joinable()) t.join();
+            logError("MemoryMappedFile::create() - can't map " + filename);
+            return nullptr;
         }
+        return pFile;
     }
 
-    std::thread& getAvailable()
+    MemoryMappedFile::SharedPtr MemoryMappedFile::createFromStream(const std::string& filename)
     {
-        std::thread& t = mThreads[mCurrent];
-        if (t.joinable()) t.join();
-        mCurrent = (mCurrent + 1) % arraysize(mThreads);
-        return t;
-    }
+        BinaryFileStream stream(filename, BinaryFileStream::Mode::Read);
+        if (stream.isGood() == false)
+        {
+            logError("MemoryMappedFile::createFromStream() - can't open " + filename);
+            return nullptr;
+        }
 
-private:
-    std::thread mThreads[threadCount];
-    uint32_t mCurrent = 0;
-};
\ No newline at end of file
+        SharedPtr pFile = SharedPtr(new MemoryMappedFile());
+        pFile->mBuffer.resize(stream.getRemainingStreamSize());
+        stream.read(pFile->mBuffer.data(), pFile->mBuffer.size());
+        if (stream.isFail())
+        {
+            logError("MemoryMappedFile::createFromStream() - can't read " + filename);
+            return nullptr;
+        }
+        return pFile;
+    }
+}
@@ -0,0 +1,77 @@
+/***************************************************************************
+# Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "Utils/Platform/OS.h"
+
+namespace Falcor
+{
+    /** A whole file in memory for reading, mapped with mapFile() so that only the pages that are used are read from disk.
+        Use it with BinaryMemoryStream to parse the file and point into its payloads instead of copying them.
+        The data is valid for as long as the object lives.
+    */
+    class MemoryMappedFile
+    {
+    public:
+        using SharedPtr = std::shared_ptr<MemoryMappedFile>;
+        using SharedConstPtr = std::shared_ptr<const MemoryMappedFile>;
+        ~MemoryMappedFile();
+
+        /** Map a file
+            \param[in] filename Full path of the file
+            \return A new object, or nullptr if the file can't be opened
+        */
+        static SharedPtr create(const std::string& filename);
+
+        /** Read a whole file into memory through a BinaryFileStream instead of mapping it. Has the same interface, which is
+            useful to compare the two.
+            \param[in] filename Full path of the file
+            \return A new object, or nullptr if the file can't be read
+        */
+        static SharedPtr createFromStream(const std::string& filename);
+
+        /** Get the file's content
+        */
+        const uint8_t* getData() const { return mMapping.pData ? mMapping.pData : mBuffer.data(); }
+
+        /** Get the file's size in bytes
+        */
+        size_t getSize() const { return mMapping.pData ? mMapping.size : mBuffer.size(); }
+
+        /** Check if the file is mapped, rather than read into memory
+        */
+        bool isMapped() const { return mMapping.pData != nullptr; }
+
+    private:
+        MemoryMappedFile() = default;
+        FileMapping mMapping;
+        std::vector<uint8_t> mBuffer;
+    };
+}
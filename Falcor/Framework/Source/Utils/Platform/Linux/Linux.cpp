@@ -33,6 +33,9 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
 #include <sys/ptrace.h>
 #include <gtk/gtk.h>
 #include <fstream>
@@ -477,6 +480,63 @@ namespace Falcor
         return s.st_mtime;
     }
 
+    uint64_t getProcessWorkingSet()
+    {
+        // The second field of statm is the resident set size, in pages
+        std::ifstream statm("/proc/self/statm");
+        uint64_t size = 0, resident = 0;
+        statm >> size >> resident;
+        return resident * uint64_t(sysconf(_SC_PAGESIZE));
+    }
+
+    uint64_t getProcessPeakWorkingSet()
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return uint64_t(usage.ru_maxrss) * 1024;
+    }
+
+    bool mapFile(const std::string& filename, FileMapping& mapping)
+    {
+        mapping = FileMapping();
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat s;
+        if (fstat(fd, &s) != 0)
+        {
+            close(fd);
+            return false;
+        }
+
+        // Empty files can't be mapped. Otherwise, the mapping keeps the file open.
+        if (s.st_size > 0)
+        {
+            void* pData = mmap(nullptr, size_t(s.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (pData == MAP_FAILED)
+            {
+                close(fd);
+                return false;
+            }
+            mapping.pData = (const uint8_t*)pData;
+            mapping.size = size_t(s.st_size);
+        }
+        close(fd);
+        return true;
+    }
+
+    void unmapFile(FileMapping& mapping)
+    {
+        if (mapping.pData)
+        {
+            munmap((void*)mapping.pData, mapping.size);
+        }
+        mapping = FileMapping();
+    }
+
     uint32_t bitScanReverse(uint32_t a)
     {
         // __builtin_clz counts 0's from the MSB, convert to index from the LSB
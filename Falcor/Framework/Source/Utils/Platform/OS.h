@@ -286,6 +286,34 @@ namespace Falcor
     */
     uint64_t  getProcessUsedVirtualMemory();
 
+    /** Get the physical memory (working set) this process is using.
+    */
+    uint64_t getProcessWorkingSet();
+
+    /** Get the largest working set this process has had since it started.
+    */
+    uint64_t getProcessPeakWorkingSet();
+
+    /** A read-only view of a whole file, see mapFile()
+    */
+    struct FileMapping
+    {
+        const uint8_t* pData = nullptr;     ///< Null for an empty file
+        size_t size = 0;
+        void* pHandle = nullptr;            ///< Platform specific
+    };
+
+    /** Map a file into memory for reading. Pages are read from disk when they are first accessed.
+        \param[in] filename The file to map
+        \param[out] mapping The mapped file
+        \return Whether the file could be mapped
+    */
+    bool mapFile(const std::string& filename, FileMapping& mapping);
+
+    /** Release a mapping created by mapFile()
+    */
+    void unmapFile(FileMapping& mapping);
+
     /** Returns index of most significant set bit, or 0 if no bits were set.
     */
     uint32_t bitScanReverse(uint32_t a);
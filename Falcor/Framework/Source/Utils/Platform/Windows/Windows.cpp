@@ -36,7 +36,6 @@
 #include <sys/types.h>
 #include "API/Window.h"
 #include "psapi.h"
-#include "Utils/ThreadPool.h"
 #include <future>
 #include <shellscalingapi.h>
 
@@ -514,6 +513,75 @@ namespace Falcor
         return virtualMemUsedByMe;
     }
 
+    uint64_t getProcessWorkingSet()
+    {
+        PROCESS_MEMORY_COUNTERS pmc;
+        GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+        return pmc.WorkingSetSize;
+    }
+
+    uint64_t getProcessPeakWorkingSet()
+    {
+        PROCESS_MEMORY_COUNTERS pmc;
+        GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+        return pmc.PeakWorkingSetSize;
+    }
+
+    bool mapFile(const std::string& filename, FileMapping& mapping)
+    {
+        mapping = FileMapping();
+        HANDLE hFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (hFile == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(hFile, &size) == FALSE)
+        {
+            CloseHandle(hFile);
+            return false;
+        }
+
+        if (size.QuadPart == 0)
+        {
+            // Empty files can't be mapped
+            CloseHandle(hFile);
+            return true;
+        }
+
+        // The mapping keeps the file open
+        HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(hFile);
+        if (hMapping == nullptr)
+        {
+            return false;
+        }
+
+        mapping.pData = (const uint8_t*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+        if (mapping.pData == nullptr)
+        {
+            CloseHandle(hMapping);
+            return false;
+        }
+        mapping.size = size_t(size.QuadPart);
+        mapping.pHandle = hMapping;
+        return true;
+    }
+
+    void unmapFile(FileMapping& mapping)
+    {
+        if (mapping.pData)
+        {
+            UnmapViewOfFile(mapping.pData);
+        }
+        if (mapping.pHandle)
+        {
+            CloseHandle((HANDLE)mapping.pHandle);
+        }
+        mapping = FileMapping();
+    }
+
     uint32_t bitScanReverse(uint32_t a)
     {
         unsigned long index;
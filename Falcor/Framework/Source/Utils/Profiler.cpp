@@ -34,6 +34,7 @@
 #include <fstream>
 #include <sstream>
 #include <cstdio>
+#include <algorithm>
 
 namespace Falcor
 {
@@ -43,6 +44,9 @@ namespace Falcor
     uint32_t Profiler::sCurrentLevel = 0;
     uint32_t Profiler::sGpuTimerIndex = 0;
     std::vector<Profiler::EventData*> Profiler::sProfilerVector;
+    std::vector<Profiler::EventData*> Profiler::sPrevFrameEvents;
+    uint64_t Profiler::sFrameIndex = 0;
+    CpuTimer::TimePoint Profiler::sEpoch = CpuTimer::getCurrentTimePoint();
 
     std::hash<std::string> HashedString::hashFunc;
 
@@ -92,6 +96,7 @@ namespace Falcor
         pData->showInMsg = showInMsg;
         pData->level = sCurrentLevel;
         pData->cpuStart = CpuTimer::getCurrentTimePoint();
+        if (pData->callCount++ == 0) pData->cpuFirstStart = pData->cpuStart;
         EventData::FrameData& frame = pData->frameData[sGpuTimerIndex];
         if (frame.currentTimer >= frame.pTimers.size())
         {
@@ -181,35 +186,106 @@ namespace Falcor
         return results;
     }
 
+    const Profiler::Sample* Profiler::EventData::findSample(uint64_t frame) const
+    {
+        for (uint32_t i = 1; i <= (uint32_t)history.size(); i++)
+        {
+            const Sample& sample = history[(historyNext + kHistorySize - i) % kHistorySize];
+            if (sample.frame == frame) return &sample;
+            if (sample.frame < frame) break;
+        }
+        return nullptr;
+    }
+
     void Profiler::endFrame()
     {
+        // The GPU results of the frame before are in now.  Complete its samples before the timers get reused.
+        for (EventData* pData : sPrevFrameEvents)
+        {
+            Sample* pSample = const_cast<Sample*>(pData->findSample(sFrameIndex - 1));
+            if (pSample) pSample->gpuMs = (float)getGpuTime(pData);
+            pData->frameData[1 - sGpuTimerIndex].currentTimer = 0;
+        }
+        sPrevFrameEvents.clear();
+
         for (EventData* pData : sProfilerVector)
         {
+            // Events started more than once per frame appear more than once in the list.  Record them the first time.
+            if (pData->callCount > 0)
+            {
+                Sample sample;
+                sample.frame = sFrameIndex;
+                sample.cpuStart = std::chrono::duration<double, std::milli>(pData->cpuFirstStart - sEpoch).count();   // Double:  long runs outgrow a float's ms
+                sample.cpuMs = pData->cpuTotal;
+                if (pData->history.size() < kHistorySize) pData->history.push_back(sample);
+                else pData->history[pData->historyNext] = sample;
+                pData->historyNext = (pData->historyNext + 1) % kHistorySize;
+                sPrevFrameEvents.push_back(pData);
+            }
+            pData->callCount = 0;
             pData->showInMsg = false;
             pData->cpuTotal = 0;
             pData->frameData[1 - sGpuTimerIndex].currentTimer = 0;
         }
         sProfilerVector.clear();
         sGpuTimerIndex = 1 - sGpuTimerIndex;
+        sFrameIndex++;
     }
 
-#if _PROFILING_LOG == 1
-    void Profiler::flushLog() {
-        for (EventData* pData : sProfilerVector)
+    Profiler::Stats Profiler::calcStats(const std::vector<float>& values)
+    {
+        Stats stats;
+        stats.count = (uint32_t)values.size();
+        if (values.empty()) return stats;
+
+        double sum = 0;
+        stats.min = stats.max = values[0];
+        for (float v : values)
         {
-            std::ostringstream logOss, fileOss;
-            logOss << "dumping " << "profile_" << pData->name << "_" << pData->filesWritten;
-            logInfo(logOss.str());
-            fileOss << "profile_" << pData->name << "_" << pData->filesWritten++;
-            std::ofstream out(fileOss.str().c_str());
-            for (int i = 0; i < pData->stepNr; ++i)
-            {
-                out << pData->cpuMs[i] << " " << pData->gpuMs[i] << "\n";
-            }
-            pData->stepNr = 0;
+            sum += v;
+            stats.min = std::min(stats.min, v);
+            stats.max = std::max(stats.max, v);
         }
+        stats.avg = (float)(sum / values.size());
+
+        std::vector<float> sorted = values;
+        size_t p95 = std::min(sorted.size() - 1, (size_t)std::ceil(0.95 * sorted.size()) - 1);
+        std::nth_element(sorted.begin(), sorted.begin() + p95, sorted.end());
+        stats.p95 = sorted[p95];
+        return stats;
+    }
+
+    bool Profiler::getEventStats(const HashedString& name, EventStats& stats)
+    {
+        const EventData* pData = isEventRegistered(name);
+        if (pData == nullptr) return false;
+
+        std::vector<float> cpu, gpu;
+        cpu.reserve(pData->history.size());
+        gpu.reserve(pData->history.size());
+        for (const Sample& sample : pData->history)
+        {
+            cpu.push_back(sample.cpuMs);
+            if (sample.gpuMs >= 0) gpu.push_back(sample.gpuMs);
+        }
+        stats.cpu = calcStats(cpu);
+        stats.gpu = calcStats(gpu);
+        return true;
+    }
+
+    bool Profiler::getFrameEvents(uint64_t frame, std::vector<const EventData*>& events)
+    {
+        events.clear();
+        if (frame + 2 > sFrameIndex) return false;
+
+        for (const auto& entry : sProfilerEvents)
+        {
+            const Sample* pSample = entry.second->findSample(frame);
+            if (pSample && pSample->gpuMs >= 0) events.push_back(entry.second);
+        }
+        std::sort(events.begin(), events.end(), [frame](const EventData* a, const EventData* b) { return a->findSample(frame)->cpuStart < b->findSample(frame)->cpuStart; });
+        return true;
     }
-#endif
 
     void Profiler::clearEvents()
     {
@@ -219,6 +295,7 @@ namespace Falcor
         }
         sProfilerEvents.clear();
         sProfilerVector.clear();
+        sPrevFrameEvents.clear();
         sCurrentLevel = 0;
         sGpuTimerIndex = 0;
     }
@@ -67,6 +67,37 @@ namespace Falcor
         static void flushLog();
 #endif
 
+        /** Number of frames of history kept per event
+        */
+        static const uint32_t kHistorySize = 1024;
+
+        /** An event's times in one frame
+        */
+        struct Sample
+        {
+            uint64_t frame = 0;     ///< Frame index, see getFrameIndex()
+            double cpuStart = 0;    ///< When the event first started in the frame, in ms since the profiler was initialized
+            float cpuMs = 0;        ///< Total CPU time in the frame
+            float gpuMs = -1;       ///< Total GPU time in the frame. Negative until the GPU results arrive, at the end of the next frame.
+        };
+
+        /** Statistics over an event's history, see getEventStats()
+        */
+        struct Stats
+        {
+            uint32_t count = 0;     ///< Number of frames the statistics cover
+            float min = 0;
+            float avg = 0;
+            float p95 = 0;          ///< 95th percentile
+            float max = 0;
+        };
+
+        struct EventStats
+        {
+            Stats cpu;
+            Stats gpu;
+        };
+
         struct EventData
         {
             virtual ~EventData() {}
@@ -83,6 +114,16 @@ namespace Falcor
             CpuTimer::TimePoint cpuEnd;
             float cpuTotal = 0;
             uint32_t level;
+            uint32_t callCount = 0;                 ///< Calls to startEvent() in the current frame
+            CpuTimer::TimePoint cpuFirstStart;      ///< Start of the first of them
+
+            // Ring buffer of the last kHistorySize frames the event ran in
+            std::vector<Sample> history;
+            uint32_t historyNext = 0;
+
+            /** Get the sample of the given frame, or nullptr if it is not in the history
+            */
+            const Sample* findSample(uint64_t frame) const;
 #if _PROFILING_LOG == 1
             int stepNr = 0;
             int filesWritten = 0;
@@ -143,6 +184,30 @@ namespace Falcor
         */
         static EventData* isEventRegistered(const HashedString& name);
 
+        /** Get statistics over the CPU and GPU times of an event's last kHistorySize frames (or fewer, if it has run less).
+            GPU statistics only cover frames whose GPU results have arrived.
+            \param[in] name The event name.
+            \param[out] stats The statistics.
+            \return false if the event is not known.
+        */
+        static bool getEventStats(const HashedString& name, EventStats& stats);
+
+        /** Get statistics over a set of times.
+        */
+        static Stats calcStats(const std::vector<float>& values);
+
+        /** Get the number of frames ended so far. The current frame has this index.
+        */
+        static uint64_t getFrameIndex() { return sFrameIndex; }
+
+        /** Get the events that ran in a frame, in the order they started. A frame's samples are complete (have their GPU
+            times) once the frame after it has ended, i.e. for frames up to getFrameIndex() - 2.
+            \param[in] frame The frame index.
+            \param[out] events The events with a complete sample for that frame (see EventData::findSample()).
+            \return false if the frame's samples are not complete yet.
+        */
+        static bool getFrameEvents(uint64_t frame, std::vector<const EventData*>& events);
+
         /** Clears all the events. 
             Useful if you want to start profiling a different technique with different events.
         */
@@ -154,6 +219,9 @@ namespace Falcor
 
         static std::map<size_t, EventData*> sProfilerEvents;
         static std::vector<EventData*> sProfilerVector;
+        static std::vector<EventData*> sPrevFrameEvents;   ///< Events that ran in the last frame ended, each once
+        static uint64_t sFrameIndex;
+        static CpuTimer::TimePoint sEpoch;
         static uint32_t sCurrentLevel;
         static uint32_t sGpuTimerIndex;
     };
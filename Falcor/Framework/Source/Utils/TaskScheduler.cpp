@@ -0,0 +1,416 @@
+/***************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+#include "Framework.h"
+#include "TaskScheduler.h"
+#include "Utils/Platform/OS.h"
+#include "Utils/CpuTimer.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace Falcor
+{
+    namespace
+    {
+        // Times an idle thread looks for work, yielding in between, before it goes to sleep
+        const uint32_t kSpinCount = 1000;
+
+        // How long TaskGroup::wait() sleeps before looking for work to help with again, once there was none for kSpinCount tries
+        const std::chrono::microseconds kWaitPollInterval(500);
+
+        // The scheduler whose worker the current thread is, if any
+        struct WorkerId
+        {
+            const TaskScheduler* pScheduler = nullptr;
+            uint32_t index = 0;
+        };
+        thread_local WorkerId tWorker;
+    }
+
+    void TaskScheduler::TaskGroup::run(const Task& task)
+    {
+        assert(mComplete == false);
+        mPending++;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mUnmetDependencies > 0)
+            {
+                mDeferred.push_back(task);
+                return;
+            }
+        }
+        mpScheduler->submit({ task, shared_from_this() });
+    }
+
+    void TaskScheduler::TaskGroup::seal()
+    {
+        if (mSealed.exchange(true) == false) taskFinished();
+    }
+
+    void TaskScheduler::TaskGroup::wait()
+    {
+        seal();
+        uint32_t spins = 0;
+        while (mComplete == false)
+        {
+            if (mpScheduler->tryRunJob())
+            {
+                spins = 0;
+            }
+            else if (++spins < kSpinCount)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                // Everything left is running on other threads. Sleep, but wake up now and then in case they spawn more work.
+                std::unique_lock<std::mutex> lock(mMutex);
+                mCompleteCond.wait_for(lock, kWaitPollInterval, [this] { return mComplete.load(); });
+                spins = 0;
+            }
+        }
+    }
+
+    void TaskScheduler::TaskGroup::taskFinished()
+    {
+        if (mPending.fetch_sub(1) == 1) complete();
+    }
+
+    void TaskScheduler::TaskGroup::complete()
+    {
+        std::vector<SharedPtr> dependents;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mComplete = true;
+            dependents.swap(mDependents);
+        }
+        mCompleteCond.notify_all();
+        for (auto& pDependent : dependents) pDependent->dependencyCompleted();
+    }
+
+    void TaskScheduler::TaskGroup::dependencyCompleted()
+    {
+        std::vector<Task> deferred;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (--mUnmetDependencies > 0) return;
+            deferred.swap(mDeferred);
+        }
+        for (auto& task : deferred) mpScheduler->submit({ std::move(task), shared_from_this() });
+    }
+
+    TaskScheduler::SharedPtr TaskScheduler::create(uint32_t workerCount, const AffinityFunc& affinity)
+    {
+        if (workerCount == kDefaultWorkerCount)
+        {
+            workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        }
+        return SharedPtr(new TaskScheduler(workerCount, affinity));
+    }
+
+    const TaskScheduler::SharedPtr& TaskScheduler::getGlobal()
+    {
+        // At least one worker, so that run() tasks make progress without anyone waiting
+        static SharedPtr spGlobal = create(std::max(2u, std::thread::hardware_concurrency()) - 1);
+        return spGlobal;
+    }
+
+    uint32_t TaskScheduler::pinToProcessors(uint32_t workerIndex)
+    {
+        uint32_t processors = std::min(32u, std::thread::hardware_concurrency());
+        if (processors < 2) return 0;
+        return 1u << ((workerIndex + 1) % processors);
+    }
+
+    TaskScheduler::TaskScheduler(uint32_t workerCount, const AffinityFunc& affinity)
+    {
+        for (uint32_t i = 0; i < workerCount; i++)
+        {
+            mQueues.emplace_back(new WorkerQueue);
+        }
+        for (uint32_t i = 0; i < workerCount; i++)
+        {
+            mThreads.emplace_back(&TaskScheduler::workerLoop, this, i);
+            uint32_t mask = affinity ? affinity(i) : 0;
+            if (mask) setThreadAffinity(mThreads.back().native_handle(), mask);
+        }
+    }
+
+    TaskScheduler::~TaskScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mShutdown = true;
+        }
+        mWakeCond.notify_all();
+        for (auto& t : mThreads)
+        {
+            if (t.joinable()) t.join();
+        }
+
+        // Without workers, nobody may have run these yet
+        while (tryRunJob()) {}
+    }
+
+    void TaskScheduler::run(const Task& task)
+    {
+        submit({ task, nullptr });
+    }
+
+    TaskScheduler::TaskGroup::SharedPtr TaskScheduler::createGroup(const std::vector<TaskGroup::SharedPtr>& dependencies)
+    {
+        TaskGroup::SharedPtr pGroup(new TaskGroup(this));
+        for (const auto& pDependency : dependencies)
+        {
+            if (pDependency == nullptr) continue;
+            std::lock_guard<std::mutex> lock(pDependency->mMutex);
+            if (pDependency->mComplete) continue;
+            {
+                std::lock_guard<std::mutex> groupLock(pGroup->mMutex);
+                pGroup->mUnmetDependencies++;
+            }
+            pDependency->mDependents.push_back(pGroup);
+        }
+
+        // Drop the reference that kept the tasks back while we were registering
+        pGroup->dependencyCompleted();
+        return pGroup;
+    }
+
+    void TaskScheduler::parallelFor(uint32_t begin, uint32_t end, const RangeFunc& func, uint32_t grainSize)
+    {
+        if (begin >= end) return;
+        if (grainSize == 0)
+        {
+            grainSize = std::max(1u, (end - begin) / ((getWorkerCount() + 1) * 8));
+        }
+
+        TaskGroup::SharedPtr pGroup = createGroup();
+        runRange(func, pGroup, begin, end, grainSize);
+        pGroup->wait();
+    }
+
+    void TaskScheduler::runRange(const RangeFunc& func, const TaskGroup::SharedPtr& pGroup, uint32_t begin, uint32_t end, uint32_t grainSize)
+    {
+        while (begin < end)
+        {
+            // Lazy binary splitting: only offer up half of what's left if whatever we offered before has been taken
+            if (end - begin > grainSize && isLocalQueueEmpty())
+            {
+                uint32_t middle = begin + (end - begin) / 2;
+                pGroup->run([this, &func, pGroup, middle, end, grainSize] { runRange(func, pGroup, middle, end, grainSize); });
+                end = middle;
+                continue;
+            }
+
+            uint32_t chunkEnd = std::min(end, begin + grainSize);
+            func(begin, chunkEnd);
+            begin = chunkEnd;
+        }
+    }
+
+    uint32_t TaskScheduler::getWorkerIndex() const
+    {
+        return (tWorker.pScheduler == this) ? tWorker.index : kNotAWorker;
+    }
+
+    void TaskScheduler::submit(Job&& job)
+    {
+        uint32_t worker = getWorkerIndex();
+        WorkerQueue& queue = (worker == kNotAWorker) ? mInjectionQueue : *mQueues[worker];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(std::move(job));
+            mQueuedJobs++;
+        }
+
+        // A sleeping worker either sees mQueuedJobs > 0 before it waits, or is counted in mSleepingWorkers here
+        if (mSleepingWorkers > 0)
+        {
+            { std::lock_guard<std::mutex> lock(mSleepMutex); }
+            mWakeCond.notify_one();
+        }
+    }
+
+    bool TaskScheduler::isLocalQueueEmpty()
+    {
+        uint32_t worker = getWorkerIndex();
+        WorkerQueue& queue = (worker == kNotAWorker) ? mInjectionQueue : *mQueues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        return queue.jobs.empty();
+    }
+
+    bool TaskScheduler::popJob(Job& job)
+    {
+        if (mQueuedJobs == 0) return false;
+
+        // Our own deque first, newest job first
+        uint32_t worker = getWorkerIndex();
+        if (worker != kNotAWorker)
+        {
+            WorkerQueue& queue = *mQueues[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs.empty() == false)
+            {
+                job = std::move(queue.jobs.back());
+                queue.jobs.pop_back();
+                mQueuedJobs--;
+                return true;
+            }
+        }
+
+        // Then the oldest job from the injection queue, or from one of the other workers
+        uint32_t queueCount = uint32_t(mQueues.size()) + 1;
+        uint32_t first = (worker == kNotAWorker) ? 0 : worker + 1;
+        for (uint32_t i = 0; i < queueCount; i++)
+        {
+            uint32_t victim = (first + i) % queueCount;
+            if (victim == worker) continue;
+            WorkerQueue& queue = (victim == mQueues.size()) ? mInjectionQueue : *mQueues[victim];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs.empty() == false)
+            {
+                job = std::move(queue.jobs.front());
+                queue.jobs.pop_front();
+                mQueuedJobs--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool TaskScheduler::tryRunJob()
+    {
+        Job job;
+        if (popJob(job) == false) return false;
+        job.task();
+        if (job.pGroup) job.pGroup->taskFinished();
+        return true;
+    }
+
+    void TaskScheduler::workerLoop(uint32_t workerIndex)
+    {
+        tWorker.pScheduler = this;
+        tWorker.index = workerIndex;
+
+        uint32_t spins = 0;
+        while (true)
+        {
+            if (tryRunJob())
+            {
+                spins = 0;
+                continue;
+            }
+            if (mShutdown && mQueuedJobs == 0) break;
+            if (++spins < kSpinCount)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mSleepMutex);
+            mSleepingWorkers++;
+            mWakeCond.wait(lock, [this] { return mQueuedJobs > 0 || mShutdown; });
+            mSleepingWorkers--;
+            spins = 0;
+        }
+
+        tWorker = WorkerId();
+    }
+
+    TaskScheduler::Benchmark TaskScheduler::benchmark(uint32_t workerCount, uint32_t maxThreads)
+    {
+        Benchmark result;
+        const uint32_t kTasks = 100000;
+        auto elapsedMs = [](CpuTimer::TimePoint start) { return CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()); };
+
+        // Spawn cost on a single thread, without any contention
+        {
+            SharedPtr pScheduler = create(0);
+            TaskGroup::SharedPtr pGroup = pScheduler->createGroup();
+            CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+            for (uint32_t i = 0; i < kTasks; i++) pGroup->run([] {});
+            pGroup->wait();
+            result.spawnNs = elapsedMs(start) * 1e6f / float(kTasks);
+        }
+
+        SharedPtr pScheduler = create(workerCount);
+        result.threadCount = pScheduler->getWorkerCount() + 1;
+
+        // One task spawns them all, the other threads steal them
+        {
+            TaskGroup::SharedPtr pGroup = pScheduler->createGroup();
+            CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+            pGroup->run([pGroup] { for (uint32_t i = 0; i < kTasks; i++) pGroup->run([] {}); });
+            pGroup->wait();
+            result.stealNs = elapsedMs(start) * 1e6f / float(kTasks);
+        }
+
+        // Fork and join of an empty loop
+        {
+            const uint32_t kRuns = 1000;
+            uint32_t count = result.threadCount * 64;
+            CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+            for (uint32_t run = 0; run < kRuns; run++) pScheduler->parallelFor(0, count, [](uint32_t, uint32_t) {}, 1);
+            result.parallelForUs = elapsedMs(start) * 1e3f / float(kRuns);
+        }
+        pScheduler = nullptr;
+
+        // Scaling of a compute-bound loop whose items vary in cost by 7x, so threads must steal to stay balanced
+        const uint32_t kItems = 1 << 14;
+        auto work = [](uint32_t begin, uint32_t end)
+        {
+            volatile float sink = 0;
+            for (uint32_t i = begin; i < end; i++)
+            {
+                float x = float(i);
+                uint32_t iterations = 256 + (i * 7919u) % 1536u;
+                for (uint32_t j = 0; j < iterations; j++) x = x * 0.999f + 1.f;
+                sink = sink + x;
+            }
+        };
+
+        if (maxThreads == 0) maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t threads = 1; ; threads = std::min(threads * 2, maxThreads))
+        {
+            SharedPtr pScaling = create(threads - 1);
+            Benchmark::ScalingPoint point;
+            point.threadCount = threads;
+            point.ms = FLT_MAX;
+            for (uint32_t run = 0; run < 3; run++)
+            {
+                CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+                pScaling->parallelFor(0, kItems, work);
+                point.ms = std::min(point.ms, elapsedMs(start));
+            }
+            point.speedup = result.scaling.empty() ? 1.f : result.scaling[0].ms / point.ms;
+            result.scaling.push_back(point);
+            if (threads == maxThreads) break;
+        }
+        return result;
+    }
+}
@@ -0,0 +1,235 @@
+/***************************************************************************
+# Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#  * Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its
+#    contributors may be used to endorse or promote products derived
+#    from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+# EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+# OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***************************************************************************/
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Falcor
+{
+    /** A work-stealing task scheduler.
+        Every worker thread owns a deque of tasks. A worker pushes the tasks it spawns to the back of its own deque and pops
+        from the back (newest first, while their data is still in cache); idle workers steal from the front of the other
+        deques (oldest first, which for recursively split work are the largest pieces). Tasks submitted from threads that
+        aren't workers go to a shared injection queue. Workers with nothing to do spin briefly, then sleep until new work
+        arrives.
+
+        A thread waiting on a TaskGroup, or on parallelFor(), runs queued tasks while it waits, so the calling thread is never
+        idle and a scheduler with no workers at all still makes progress (everything then runs on the waiting thread).
+
+        Usage:
+            TaskScheduler::SharedPtr pScheduler = TaskScheduler::getGlobal();   // One worker per hardware thread, less the caller
+
+            // Fire and forget
+            pScheduler->run([=] { saveImage(filename, data); });
+
+            // Loop over [0, count). The body gets [begin, end) sub-ranges; pass a grain size, or 0 to pick one.
+            pScheduler->parallelFor(0, count, [&](uint32_t begin, uint32_t end) { for (uint32_t i = begin; i < end; i++) work(i); });
+
+            // Groups, with dependencies. B's tasks only start once every task of A has finished.
+            TaskScheduler::TaskGroup::SharedPtr pA = pScheduler->createGroup();
+            TaskScheduler::TaskGroup::SharedPtr pB = pScheduler->createGroup({ pA });
+            pA->run(buildBvh);
+            pB->run(traceRays);
+            pA->seal();     // No more tasks for A
+            pB->wait();     // Seals B, then helps run tasks until B is done
+    */
+    class TaskScheduler : public std::enable_shared_from_this<TaskScheduler>
+    {
+    public:
+        using SharedPtr = std::shared_ptr<TaskScheduler>;
+        using Task = std::function<void()>;
+
+        /** Body of parallelFor(), called with [begin, end) sub-ranges of the loop
+        */
+        using RangeFunc = std::function<void(uint32_t begin, uint32_t end)>;
+
+        /** Returns the affinity mask of a worker thread, see setThreadAffinity(). Return 0 to leave the worker unpinned.
+        */
+        using AffinityFunc = std::function<uint32_t(uint32_t workerIndex)>;
+
+        /** Pass to create() for one worker per hardware thread, less one for the thread that waits on the work
+        */
+        static const uint32_t kDefaultWorkerCount = uint32_t(-1);
+
+        /** Returned by getWorkerIndex() on threads that aren't this scheduler's workers
+        */
+        static const uint32_t kNotAWorker = uint32_t(-1);
+
+        /** A set of tasks that can be waited on, and that other groups can depend on.
+            A group completes once it is sealed (seal() or wait()) and every task added to it has finished. The tasks of a group
+            created with dependencies are held back until all of the dependencies have completed.
+        */
+        class TaskGroup : public std::enable_shared_from_this<TaskGroup>
+        {
+        public:
+            using SharedPtr = std::shared_ptr<TaskGroup>;
+
+            /** Add a task. It runs as soon as the group's dependencies have completed. Tasks may add more tasks to their own
+                group, as long as the group hasn't completed yet.
+            */
+            void run(const Task& task);
+
+            /** Mark the group as having all its tasks, letting it complete once they finish
+            */
+            void seal();
+
+            /** Seal the group, then run queued tasks (of any group) until the group has completed.
+                The group's dependencies must be sealed by someone, or this never returns.
+            */
+            void wait();
+
+            /** Whether the group has completed
+            */
+            bool isComplete() const { return mComplete.load(); }
+
+        private:
+            friend class TaskScheduler;
+            TaskGroup(TaskScheduler* pScheduler) : mpScheduler(pScheduler) {}
+
+            void taskFinished();
+            void dependencyCompleted();
+            void complete();
+
+            TaskScheduler* mpScheduler;
+            std::atomic<uint32_t> mPending{ 1 };        ///< Unfinished tasks, plus one until the group is sealed
+            std::atomic<bool> mSealed{ false };
+            std::atomic<bool> mComplete{ false };
+
+            std::mutex mMutex;                          ///< Guards everything below
+            std::condition_variable mCompleteCond;      ///< Signaled on completion
+            uint32_t mUnmetDependencies = 1;            ///< Plus one until createGroup() has registered us with every dependency
+            std::vector<Task> mDeferred;                ///< Tasks waiting on the dependencies
+            std::vector<SharedPtr> mDependents;
+        };
+
+        /** Scheduling overhead and scaling, as measured by benchmark()
+        */
+        struct Benchmark
+        {
+            struct ScalingPoint
+            {
+                uint32_t threadCount = 0;   ///< Workers plus the calling thread
+                float ms = 0;               ///< Time to run the workload, best of several runs
+                float speedup = 0;          ///< Over a single thread
+            };
+
+            uint32_t threadCount = 0;       ///< Of the scheduler measured for the overhead numbers
+            float spawnNs = 0;              ///< Spawning and running an empty task, per task
+            float stealNs = 0;              ///< Same, but with the tasks spawned by one thread and stolen by the others
+            float parallelForUs = 0;        ///< An empty parallelFor() over threadCount * 64 items, start to finish
+            std::vector<ScalingPoint> scaling;  ///< For 1, 2, 4, ... threads, up to the hardware thread count
+        };
+
+        /** Create a scheduler.
+            \param[in] workerCount Number of worker threads, not counting threads that wait on work. Can be 0.
+            \param[in] affinity Optional function returning the affinity mask of each worker. Masks are 32 bits wide (see setThreadAffinity()), so workers can only be pinned to the first 32 logical processors.
+        */
+        static SharedPtr create(uint32_t workerCount = kDefaultWorkerCount, const AffinityFunc& affinity = nullptr);
+
+        /** The scheduler shared by the framework, with kDefaultWorkerCount workers (at least one)
+        */
+        static const SharedPtr& getGlobal();
+
+        /** Pins worker i to logical processor i + 1, leaving processor 0 to the thread that waits on the work. Pass to create().
+        */
+        static uint32_t pinToProcessors(uint32_t workerIndex);
+
+        /** Runs every task still queued, then joins the workers
+        */
+        ~TaskScheduler();
+
+        /** Run a task asynchronously, without a way to wait on it
+        */
+        void run(const Task& task);
+
+        /** Create a task group whose tasks start once all of <dependencies> have completed
+        */
+        TaskGroup::SharedPtr createGroup(const std::vector<TaskGroup::SharedPtr>& dependencies = {});
+
+        /** Call func over sub-ranges covering [begin, end), in parallel, and wait for all of them.
+            The range is split lazily: a thread working on a range hands off half of what remains only while its own deque is
+            empty, i.e. when other threads have stolen everything it had to offer. Uniform loops therefore end up split about
+            once per thread, while imbalanced ones keep splitting down to the grain size.
+            \param[in] grainSize Smallest sub-range handed to func. 0 picks one that allows about 8 sub-ranges per thread.
+        */
+        void parallelFor(uint32_t begin, uint32_t end, const RangeFunc& func, uint32_t grainSize = 0);
+
+        /** Number of worker threads
+        */
+        uint32_t getWorkerCount() const { return uint32_t(mThreads.size()); }
+
+        /** Index of the calling thread among this scheduler's workers, or kNotAWorker
+        */
+        uint32_t getWorkerIndex() const;
+
+        /** Measure scheduling overhead on a scheduler with <workerCount> workers, and the speedup of a compute-bound
+            parallelFor() on 1, 2, 4, ... threads, up to <maxThreads> (0 for the hardware thread count).
+            Creates its own schedulers; takes a few seconds on many-core machines.
+        */
+        static Benchmark benchmark(uint32_t workerCount = kDefaultWorkerCount, uint32_t maxThreads = 0);
+
+    private:
+        TaskScheduler(uint32_t workerCount, const AffinityFunc& affinity);
+
+        struct Job
+        {
+            Task task;
+            TaskGroup::SharedPtr pGroup;                ///< Null for run()
+        };
+
+        // Padded so two workers' queues never share a cache line
+        struct alignas(64) WorkerQueue
+        {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+        };
+
+        void submit(Job&& job);
+        bool tryRunJob();           // Pops and runs one job. Returns false if there was none.
+        bool popJob(Job& job);
+        bool isLocalQueueEmpty();
+        void workerLoop(uint32_t workerIndex);
+        void runRange(const RangeFunc& func, const TaskGroup::SharedPtr& pGroup, uint32_t begin, uint32_t end, uint32_t grainSize);
+
+        std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+        WorkerQueue mInjectionQueue;                    ///< Tasks submitted by threads that aren't workers
+        std::vector<std::thread> mThreads;
+
+        std::atomic<uint32_t> mQueuedJobs{ 0 };
+        std::atomic<uint32_t> mSleepingWorkers{ 0 };
+        std::atomic<bool> mShutdown{ false };
+        std::mutex mSleepMutex;
+        std::condition_variable mWakeCond;
+    };
+}
@@ -0,0 +1,270 @@
+#include "BatchRenderer.h"
+#include <fstream>
+#include <sstream>
+
+namespace {
+	bool isAbsolutePath(const std::string& path)
+	{
+		return !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'));
+	}
+
+	// Filenames are at most 255 characters on the file systems we write to
+	const uint32_t kMaxFrameNumberWidth = 255;
+
+	// Expand an output pattern into <filename>:  "%%" is a '%', and "%u" or "%d", optionally zero-padded to a width (e.g. "%04d"),
+	//     is <frame>.  Returns false if the pattern has any other '%' sequence or more than one frame number, and sets
+	//     <frameNumbers> to how many it has.
+	bool expandOutputPattern(const std::string& pattern, uint32_t frame, std::string& filename, uint32_t& frameNumbers)
+	{
+		filename.clear();
+		frameNumbers = 0;
+		for (size_t i = 0; i < pattern.size(); i++)
+		{
+			if (pattern[i] != '%')
+			{
+				filename += pattern[i];
+				continue;
+			}
+			if (++i < pattern.size() && pattern[i] == '%')
+			{
+				filename += '%';
+				continue;
+			}
+
+			uint32_t width = 0;
+			if (i < pattern.size() && pattern[i] == '0')
+			{
+				for (i++; i < pattern.size() && pattern[i] >= '0' && pattern[i] <= '9'; i++)
+				{
+					width = width * 10 + uint32_t(pattern[i] - '0');
+					if (width > kMaxFrameNumberWidth) return false;
+				}
+			}
+			if (i >= pattern.size() || (pattern[i] != 'u' && pattern[i] != 'd') || ++frameNumbers > 1) return false;
+
+			std::string number = std::to_string(frame);
+			if (number.size() < width) filename.append(width - number.size(), '0');
+			filename += number;
+		}
+		return true;
+	}
+};
+
+bool BatchRenderer::parseJob(const std::string& filename, Job& job)
+{
+	std::ifstream file(filename);
+	if (!file)
+	{
+		logError("BatchRenderer::parseJob() - can't open " + filename);
+		return false;
+	}
+
+	std::string jobDir = getDirectoryFromFile(filename);
+	auto resolvePath = [&](const std::string& path) { return (isAbsolutePath(path) || jobDir.empty()) ? path : jobDir + "/" + path; };
+
+	// Paths may contain spaces, so they take the rest of the line, trimmed
+	auto readPath = [&](std::istringstream& values, std::string& path)
+	{
+		std::getline(values >> std::ws, path);
+		path = path.substr(0, path.find_last_not_of(" \t\r") + 1);
+		if (path.empty()) return false;
+		path = resolvePath(path);
+		return true;
+	};
+
+	job = Job();
+	std::string line;
+	for (uint32_t lineNumber = 1; std::getline(file, line); lineNumber++)
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream values(line);
+		std::string key;
+		if (!(values >> key)) continue;   // Blank or comment
+
+		bool ok = true;
+		int32_t flag = 0;
+		if (key == "scene")                  ok = readPath(values, job.scene);
+		else if (key == "resolution")        ok = (values >> job.resolution.x >> job.resolution.y) && job.resolution.x > 0 && job.resolution.y > 0;
+		else if (key == "spatialIterations") ok = (values >> job.spatialIterations) && job.spatialIterations >= 0;
+		else if (key == "filterSize")        ok = (values >> job.filterSize) && job.filterSize >= 0.f;
+		else if (key == "lightSamples")      ok = (values >> job.lightSamples) && job.lightSamples > 0;
+		else if (key == "restirgi")          { ok = bool(values >> flag); job.restirGI = (flag != 0); }
+		else if (key == "frames")            ok = (values >> job.firstFrame >> job.lastFrame) && job.firstFrame <= job.lastFrame;
+		else if (key == "fps")               ok = (values >> job.fps) && job.fps > 0.f;
+		else if (key == "output")            ok = readPath(values, job.output);
+		else if (key == "threads")           ok = bool(values >> job.threads);
+		else if (key == "samples")           ok = (values >> job.samples) && job.samples > 0;
+		else if (key == "targetError")       ok = (values >> job.targetError) && job.targetError >= 0.f;
+		else
+		{
+			logError("BatchRenderer::parseJob() - " + filename + "(" + std::to_string(lineNumber) + "): unknown setting '" + key + "'");
+			return false;
+		}
+
+		std::string extra;
+		if (!ok || (values >> extra))
+		{
+			logError("BatchRenderer::parseJob() - " + filename + "(" + std::to_string(lineNumber) + "): bad value for '" + key + "'");
+			return false;
+		}
+	}
+
+	if (job.scene.empty())
+	{
+		logError("BatchRenderer::parseJob() - " + filename + " names no scene");
+		return false;
+	}
+	return true;
+}
+
+BatchRenderer::SharedPtr BatchRenderer::create(const Job& job)
+{
+	if (!AsyncImageWriter::isSupportedFile(job.output))
+	{
+		logError("BatchRenderer::create() - output " + job.output + " is neither an .exr nor a .pfm file");
+		return nullptr;
+	}
+	std::string firstFilename;
+	uint32_t frameNumbers = 0;
+	if (!expandOutputPattern(job.output, job.firstFrame, firstFilename, frameNumbers))
+	{
+		logError("BatchRenderer::create() - output " + job.output + " may only have one frame number (%u or %d, zero-padded as in %04d) and %% for a '%'");
+		return nullptr;
+	}
+	if (job.firstFrame != job.lastFrame && frameNumbers == 0)
+	{
+		logError("BatchRenderer::create() - output " + job.output + " has no frame number, so every frame would overwrite the last");
+		return nullptr;
+	}
+
+	SharedPtr pBatch = SharedPtr(new BatchRenderer(job));
+	pBatch->mpScene = CpuScene::load(job.scene);
+	if (!pBatch->mpScene) return nullptr;
+
+	// The same configuration Pathtracer.cpp sets up for the GPU passes
+	TiledDispatch::SharedPtr pDispatch = TiledDispatch::create(job.threads);
+	pBatch->mpRenderer = CpuReSTIRRenderer::create(pBatch->mpScene, pDispatch);
+	CpuReSTIRRenderer::Settings& settings = pBatch->mpRenderer->getSettings();
+	settings.lightSamples = job.lightSamples;
+	settings.spatialIterations = job.spatialIterations;
+	settings.doSpatialReuse = (job.spatialIterations > 0);
+	pBatch->mpRenderer->resize(job.resolution);
+	pBatch->mpRenderer->getEmissiveLights()->update(pBatch->mpScene);   // The snapshot has no environment map
+	if (job.restirGI) pBatch->mpGI = CpuReSTIRGI::create(pBatch->mpRenderer);
+
+	pBatch->mDenoiseIterations = (job.filterSize >= 10.f) ? uint32_t(glm::floor(glm::log2(job.filterSize / 5.f))) : 0u;
+	pBatch->mpDenoiser = CpuAtrousFilter::create(pDispatch);
+	pBatch->mpDenoiser->getSettings().iterations = pBatch->mDenoiseIterations;
+	pBatch->mpWriter = AsyncImageWriter::create();
+	if (job.samples > 1)
+	{
+		// Every render covers every pixel, so the sampler only tracks convergence
+		pBatch->mpSampler = CpuAdaptiveSampler::create(pDispatch);
+		CpuAdaptiveSampler::Settings& samplerSettings = pBatch->mpSampler->getSettings();
+		samplerSettings.adaptive = false;
+		samplerSettings.errorThreshold = job.targetError;
+		samplerSettings.minSamples = std::min(16u, job.samples);
+		pBatch->mpSampler->resize(job.resolution);
+	}
+
+	// A camera matching the snapshot's active one (without jitter, as in CpuReSTIRPass::getCameraPath())
+	const CpuScene::CameraSetup& setup = pBatch->mpScene->getCamera();
+	pBatch->mpCamera = Camera::create();
+	pBatch->mpCamera->setAspectRatio(float(job.resolution.x) / float(job.resolution.y));
+	pBatch->mpCamera->setFocalLength(setup.focalLength);
+	pBatch->mpCamera->setFrameHeight(setup.frameHeight);
+	pBatch->mpCamera->setDepthRange(setup.nearZ, setup.farZ);
+	pBatch->mpCamera->setPosition(setup.position);
+	pBatch->mpCamera->setTarget(setup.target);
+	pBatch->mpCamera->setUpVector(setup.up);
+	if (!setup.path.empty())
+	{
+		pBatch->mpPath = ObjectPath::create();
+		for (const CpuScene::CameraKey& key : setup.path) pBatch->mpPath->addKeyFrame(key.time, key.position, key.target, key.up);
+		pBatch->mpPath->attachObject(pBatch->mpCamera);
+	}
+	return pBatch;
+}
+
+const CameraData& BatchRenderer::getCamera(uint32_t frame)
+{
+	if (mpPath) mpPath->animate(double(frame) / double(mJob.fps));
+	return mpCamera->getData();
+}
+
+std::string BatchRenderer::getOutputFilename(uint32_t frame) const
+{
+	// create() checked the pattern
+	std::string filename;
+	uint32_t frameNumbers = 0;
+	expandOutputPattern(mJob.output, frame, filename, frameNumbers);
+	return filename;
+}
+
+bool BatchRenderer::render()
+{
+	const uvec2& dim = mJob.resolution;
+	std::string outputDir = getDirectoryFromFile(getOutputFilename(mJob.firstFrame));
+	if (!outputDir.empty() && !isDirectoryExists(outputDir)) createDirectory(outputDir);
+
+	logInfo("BatchRenderer: rendering frames " + std::to_string(mJob.firstFrame) + "-" + std::to_string(mJob.lastFrame) + " of " + mJob.scene +
+		" at " + std::to_string(dim.x) + "x" + std::to_string(dim.y) + (mpGI ? " with ReSTIR GI, " : ", ") + std::to_string(mDenoiseIterations) +
+		" denoising iterations, " + std::to_string(mpRenderer->getDispatch()->getThreadCount()) + " threads" +
+		(mpSampler ? ", up to " + std::to_string(mJob.samples) + " samples per frame" : ""));
+
+	mStats = Stats();
+	float renderTime = 0.f, denoiseTime = 0.f;
+	uint64_t samples = 0;
+	uint32_t failed = 0;
+	CpuTimer::TimePoint jobStart = CpuTimer::getCurrentTimePoint();
+	for (uint32_t frame = mJob.firstFrame; frame <= mJob.lastFrame; frame++)
+	{
+		CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+		const CameraData& camera = getCamera(frame);
+		std::vector<vec4> image;
+		if (mpSampler) mpSampler->reset();
+		do
+		{
+			mpRenderer->renderFrame(camera);
+			image = mpRenderer->getBuffer(CpuReSTIRRenderer::BufferId::ShadedOutput);
+			if (mpGI)
+			{
+				// What ShadeWithGIReservoirsPass adds to "ShadedOutput"
+				mpGI->renderFrame();
+				const std::vector<vec4>& indirect = mpGI->getIndirect();
+				for (size_t i = 0; i < image.size(); i++) image[i] += vec4(vec3(indirect[i]), 0.f);
+			}
+			samples++;
+			if (!mpSampler) break;
+
+			// One sample in every pixel
+			for (vec4& color : image) color.a = 1.f;
+			mpSampler->accumulate(image);
+		} while (mpSampler->getFrameCount() < mJob.samples && !(mJob.targetError > 0.f && mpSampler->isConverged()));
+		if (mpSampler) image = mpSampler->getAccumulated();
+		CpuTimer::TimePoint rendered = CpuTimer::getCurrentTimePoint();
+		renderTime += CpuTimer::calcDuration(start, rendered);
+
+		if (mDenoiseIterations > 0)
+		{
+			mpDenoiser->filter(dim, image, mpRenderer->getBuffer(CpuReSTIRRenderer::BufferId::WorldPosition),
+				mpRenderer->getBuffer(CpuReSTIRRenderer::BufferId::WorldNormal), image);
+		}
+		denoiseTime += CpuTimer::calcDuration(rendered, CpuTimer::getCurrentTimePoint());
+
+		std::string filename = getOutputFilename(frame);
+		if (!mpWriter->write(filename, dim.x, dim.y, std::move(image))) failed++;
+		mStats.frames++;
+	}
+	mpWriter->flush();
+
+	mStats.totalMs = CpuTimer::calcDuration(jobStart, CpuTimer::getCurrentTimePoint());
+	mStats.renderMsPerFrame = renderTime / float(mStats.frames);
+	mStats.samplesPerFrame = float(samples) / float(mStats.frames);
+	mStats.denoiseMsPerFrame = denoiseTime / float(mStats.frames);
+	mStats.writeMsPerFrame = mpWriter->getWriteTime() / float(std::max(1u, mpWriter->getWrittenCount()));
+	logInfo("BatchRenderer: " + std::to_string(mStats.frames) + " frames in " + std::to_string(mStats.totalMs) + " ms (render " +
+		std::to_string(mStats.renderMsPerFrame) + " ms for " + std::to_string(mStats.samplesPerFrame) + " samples, denoise " + std::to_string(mStats.denoiseMsPerFrame) + " ms, write " +
+		std::to_string(mStats.writeMsPerFrame) + " ms per frame)" + (failed ? ", " + std::to_string(failed) + " not written" : ""));
+	return failed == 0;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Falcor.h"
+#include "CpuReSTIRRenderer.h"
+#include "CpuReSTIRGI.h"
+#include "CpuAtrousFilter.h"
+#include "CpuAdaptiveSampler.h"
+#include "../../SharedUtils/AsyncImageWriter.h"
+
+/** Renders a range of frames along a scene's camera path straight to disk, without a window, swapchain or GUI.
+
+    Everything runs on the CPU renderer (CpuReSTIRRenderer, plus CpuReSTIRGI and CpuAtrousFilter as configured), so the
+    same job renders on machines without a GPU.  Since loading an .fscene needs a D3D12 device, the scene comes from a
+    CpuScene snapshot (see CpuScene::save(), or CpuReSTIRPass's "Save CPU scene" button).  Each frame's denoised HDR
+    result, before tone mapping, is handed to an AsyncImageWriter, so writing frame N overlaps rendering frame N + 1.
+
+    A job file has one "key value(s)" setting per line; '#' starts a comment.  Paths take the rest of the line (so they may
+    contain spaces), and relative paths are relative to the job file.
+
+         scene              arcade.cpuscene     # CpuScene snapshot (required)
+         resolution         1920 1080
+         spatialIterations  1                   # As Pathtracer.cpp's spatial_iterations
+         filterSize         80                  # A-trous iterations = floor(log2(filterSize / 5)), as in Pathtracer.cpp
+         lightSamples       32                  # M, initial light candidates per pixel
+         restirgi           0                   # 1:  add ReSTIR GI's indirect lighting
+         frames             0 119               # First and last frame, inclusive
+         fps                30                  # Frame f is the camera path at time f / fps
+         output             frames/out_%04d.exr # .exr or .pfm;  %u or %d (zero-padded as %04d) is the frame number, %% a '%'
+         threads            0                   # Worker threads (0:  one per hardware thread)
+         samples            1                   # Most renders averaged per frame
+         targetError        0.01                # Stop averaging a frame once every pixel's relative error is below this (0:  never)
+
+    With samples > 1, each frame averages renders of the still camera in a CpuAdaptiveSampler until it is converged (see
+    targetError) or has <samples> of them, then denoises the average.  Temporal reuse correlates the renders, so the error
+    estimate is optimistic;  keep targetError on the low side.
+
+Usage:
+     BatchRenderer::Job job;
+     if (BatchRenderer::parseJob("turntable.job", job))
+     {
+          BatchRenderer::SharedPtr pBatch = BatchRenderer::create(job);
+          bool ok = pBatch && pBatch->render();
+     }
+*/
+
+class BatchRenderer : public std::enable_shared_from_this<BatchRenderer>
+{
+public:
+	using SharedPtr = std::shared_ptr<BatchRenderer>;
+	using SharedConstPtr = std::shared_ptr<const BatchRenderer>;
+	virtual ~BatchRenderer() = default;
+
+	// What to render, as read from a job file by parseJob()
+	struct Job
+	{
+		std::string scene;                     ///< CpuScene snapshot
+		uvec2       resolution = uvec2(1280, 720);
+		int32_t     spatialIterations = 1;
+		float       filterSize = 80.f;         ///< RenderingPipeline::getFilterSize()'s default
+		int32_t     lightSamples = 32;
+		bool        restirGI = false;
+		uint32_t    firstFrame = 0;
+		uint32_t    lastFrame = 0;
+		float       fps = 30.f;
+		std::string output = "frame_%04d.exr";
+		uint32_t    threads = 0;
+		uint32_t    samples = 1;
+		float       targetError = 0.f;
+	};
+
+	// Time spent on the frames of a job, as recorded by render()
+	struct Stats
+	{
+		uint32_t frames = 0;                   ///< Frames rendered
+		float    renderMsPerFrame = 0.f;       ///< Direct (and indirect) lighting
+		float    samplesPerFrame = 0.f;        ///< Renders averaged per frame
+		float    denoiseMsPerFrame = 0.f;      ///< A-trous filtering
+		float    writeMsPerFrame = 0.f;        ///< Saving to disk, on the writer thread
+		float    totalMs = 0.f;                ///< Wall clock, first frame to last file written
+	};
+
+	// Read a job file.  Returns false (after logging why) if it can't be read, has unknown keys or bad values, or names no scene.
+	static bool parseJob(const std::string& filename, Job& job);
+
+	// Load the job's scene and set up the renderers.  Returns nullptr if the scene can't be loaded or the job is invalid.
+	static SharedPtr create(const Job& job);
+
+	// Render and write every frame of the job.  Returns false if any frame couldn't be written.
+	bool render();
+
+	// Accessors
+	const Job& getJob() const                      { return mJob; }
+	const Stats& getStats() const                  { return mStats; }
+
+protected:
+	BatchRenderer(const Job& job) : mJob(job) {}
+
+	// The camera at frame <frame>, following the snapshot's camera path (or standing still if it has none)
+	const CameraData& getCamera(uint32_t frame);
+
+	// The output filename of frame <frame>
+	std::string getOutputFilename(uint32_t frame) const;
+
+	Job                           mJob;
+	Stats                         mStats;
+	uint32_t                      mDenoiseIterations = 0;
+
+	CpuScene::SharedPtr           mpScene;
+	CpuReSTIRRenderer::SharedPtr  mpRenderer;
+	CpuReSTIRGI::SharedPtr        mpGI;              ///< Only with Job::restirGI
+	CpuAtrousFilter::SharedPtr    mpDenoiser;
+	AsyncImageWriter::SharedPtr   mpWriter;
+	CpuAdaptiveSampler::SharedPtr mpSampler;         ///< Only with Job::samples > 1
+
+	Camera::SharedPtr             mpCamera;
+	ObjectPath::SharedPtr         mpPath;            ///< Null for a still camera
+};
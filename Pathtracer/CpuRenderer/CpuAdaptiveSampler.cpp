@@ -0,0 +1,74 @@
+#include "CpuAdaptiveSampler.h"
+#include "../Shaders/AdaptiveSampling.h"
+#include <atomic>
+
+CpuAdaptiveSampler::SharedPtr CpuAdaptiveSampler::create(const TiledDispatch::SharedPtr& pDispatch)
+{
+	return SharedPtr(new CpuAdaptiveSampler(pDispatch ? pDispatch : TiledDispatch::create()));
+}
+
+void CpuAdaptiveSampler::resize(const uvec2& size)
+{
+	mScreenSize = size;
+	reset();
+}
+
+void CpuAdaptiveSampler::reset()
+{
+	size_t pixels = size_t(mScreenSize.x) * mScreenSize.y;
+	mAccumulated.assign(pixels, vec4(0.f));
+	mStatistics.assign(pixels, vec4(0.f));
+	mSampleCounts.assign(pixels, 1u);
+	mConvergedCount = 0;
+	mSampleTotal = 0;
+	mFrameCount = 0;
+}
+
+void CpuAdaptiveSampler::accumulate(const std::vector<vec4>& frame)
+{
+	if (frame.size() != mAccumulated.size())
+	{
+		logWarning("CpuAdaptiveSampler::accumulate() - frame has " + std::to_string(frame.size()) + " texels, expected " + std::to_string(mAccumulated.size()));
+		return;
+	}
+
+	// What accumulation.ps.hlsl does for each pixel without reprojection
+	const Settings settings = mSettings;
+	std::atomic<uint32_t> converged(0);
+	std::atomic<uint64_t> samples(0);
+	mpDispatch->execute(mScreenSize, [&](const uvec2& tileStart, const uvec2& tileEnd)
+	{
+		uint32_t tileConverged = 0;
+		uint64_t tileSamples = 0;
+		for (uint32_t y = tileStart.y; y < tileEnd.y; y++)
+		{
+			for (uint32_t x = tileStart.x; x < tileEnd.x; x++)
+			{
+				size_t i = size_t(y) * mScreenSize.x + x;
+				vec4 color = vec4(vec3(frame[i]), 1.f);
+				float n = settings.adaptive ? frame[i].w : 1.f;
+				vec4& state = mStatistics[i];
+				if (n > 0.f)
+				{
+					mAccumulated[i] = (state.x * mAccumulated[i] + n * color) / (state.x + n);
+					adaptiveAddObservation(state.x, state.y, state.z, state.w, adaptiveLuminance(color.r, color.g, color.b), n);
+					tileSamples += uint64_t(n);
+				}
+
+				float relativeError = adaptiveRelativeError(state.x, state.y, state.z, state.w);
+				float count = settings.adaptive ? adaptiveSampleCount(relativeError, state.x, settings.errorThreshold, float(settings.minSamples), float(settings.maxSamples)) :
+					(relativeError <= settings.errorThreshold && state.x >= float(settings.minSamples)) ? 0.f : 1.f;
+				if (count == 0.f) tileConverged++;
+
+				// Without adaptive sampling every pixel keeps taking one sample;  converged ones are only counted
+				mSampleCounts[i] = settings.adaptive ? uint32_t(count) : 1u;
+			}
+		}
+		converged += tileConverged;
+		samples += tileSamples;
+	});
+
+	mConvergedCount = converged;
+	mSampleTotal += samples;
+	mFrameCount++;
+}
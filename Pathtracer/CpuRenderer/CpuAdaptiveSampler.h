@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Falcor.h"
+#include "../../SharedUtils/TiledDispatch.h"
+
+/** Progressive accumulation with a per-pixel sample budget, as SimpleAccumulationPass does it with adaptive sampling on
+    (accumulation.ps.hlsl without reprojection).  Each pixel keeps the running statistics of Shaders/AdaptiveSampling.h;
+    after each frame it is given the number of samples to take next:  0 once its relative standard error is below the
+    threshold, otherwise enough to get there, up to Settings::maxSamples.
+
+    A frame gives, per pixel, the mean of the samples it took in rgb and their count in alpha (0:  it took none and keeps
+    its history), as fullGI.hlsl writes it.  Renderers that can't sample single pixels (e.g. CpuReSTIRRenderer::renderFrame())
+    give every pixel one sample and use isConverged() to stop early.
+
+Usage:
+     CpuAdaptiveSampler::SharedPtr pSampler = CpuAdaptiveSampler::create();
+     pSampler->resize(screenSize);
+     pSampler->getSettings().errorThreshold = 0.01f;
+
+     while (!pSampler->isConverged())
+     {
+          // Take pSampler->getSampleCounts()[i] samples in pixel i
+          pSampler->accumulate(frame);
+     }
+     const std::vector<vec4>& image = pSampler->getAccumulated();
+*/
+class CpuAdaptiveSampler : public std::enable_shared_from_this<CpuAdaptiveSampler>
+{
+public:
+	using SharedPtr = std::shared_ptr<CpuAdaptiveSampler>;
+	using SharedConstPtr = std::shared_ptr<const CpuAdaptiveSampler>;
+	virtual ~CpuAdaptiveSampler() = default;
+
+	// Budget controls, matching SimpleAccumulationPass' GUI
+	struct Settings
+	{
+		bool     adaptive = true;          ///< Budget samples by relative error (otherwise every pixel takes one per frame)
+		float    errorThreshold = 0.02f;   ///< Relative standard error below which a pixel is converged
+		uint32_t minSamples = 16;          ///< Samples each pixel takes before it may converge
+		uint32_t maxSamples = 4;           ///< Most samples a pixel takes in one frame
+	};
+
+	// Create a sampler.  If no dispatcher is given, one is created using all cores.
+	static SharedPtr create(const TiledDispatch::SharedPtr& pDispatch = nullptr);
+
+	// (Re)allocate the per-pixel state for size.x * size.y pixels, and clear it
+	void resize(const uvec2& size);
+
+	// Throw away all accumulated samples, e.g. when the camera moves
+	void reset();
+
+	// Add a frame of size.x * size.y texels:  rgb is the mean of the samples a pixel took, alpha how many it took.  Then
+	//     updates the sample counts for the next frame.
+	void accumulate(const std::vector<vec4>& frame);
+
+	// Accessors
+	Settings& getSettings()                                 { return mSettings; }
+	const uvec2& getScreenSize() const                      { return mScreenSize; }
+	const std::vector<vec4>& getAccumulated() const         { return mAccumulated; }    ///< Mean of each pixel's samples (alpha 1)
+	const std::vector<vec4>& getStatistics() const          { return mStatistics; }     ///< See AdaptiveSampling.h
+	const std::vector<uint32_t>& getSampleCounts() const    { return mSampleCounts; }   ///< Samples each pixel should take next frame
+	uint32_t getConvergedCount() const                      { return mConvergedCount; } ///< Pixels budgeted no more samples
+	bool isConverged() const                                { return mConvergedCount == mSampleCounts.size(); }
+	uint64_t getSampleTotal() const                         { return mSampleTotal; }    ///< Samples accumulated since the last reset
+	uint32_t getFrameCount() const                          { return mFrameCount; }     ///< Frames accumulated since the last reset
+
+protected:
+	CpuAdaptiveSampler(const TiledDispatch::SharedPtr& pDispatch) : mpDispatch(pDispatch) {}
+
+	TiledDispatch::SharedPtr      mpDispatch;
+	Settings                      mSettings;
+
+	uvec2                         mScreenSize = uvec2(0, 0);
+	std::vector<vec4>             mAccumulated;
+	std::vector<vec4>             mStatistics;
+	std::vector<uint32_t>         mSampleCounts;
+	uint32_t                      mConvergedCount = 0;
+	uint64_t                      mSampleTotal = 0;
+	uint32_t                      mFrameCount = 0;
+};
@@ -0,0 +1,273 @@
+#include "CpuAtrousFilter.h"
+#include "../Shaders/AtrousFilter.h"
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+
+namespace {
+	// Denormals flush to zero (on input and output) while one of these is alive, as they do on the GPU
+	class FlushDenormals
+	{
+	public:
+		FlushDenormals() : mSaved(_mm_getcsr()) { _mm_setcsr(mSaved | 0x8040u); }   // FTZ | DAZ
+		~FlushDenormals() { _mm_setcsr(mSaved); }
+	private:
+		unsigned int mSaved;
+	};
+
+	// SSE versions of the AtrousFilter.h functions, one lane per pixel, with the same operations in the same order
+	inline __m128 atrousExp4(__m128 x)
+	{
+		__m128 t = _mm_mul_ps(x, _mm_set1_ps(1.44269504f));
+		__m128 valid = _mm_cmpge_ps(t, _mm_set1_ps(-125.f));
+
+		// floor(t + 0.5):  truncate, then step down where that rounded up
+		__m128 v = _mm_add_ps(t, _mm_set1_ps(0.5f));
+		__m128 i = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+		i = _mm_sub_ps(i, _mm_and_ps(_mm_cmpgt_ps(i, v), _mm_set1_ps(1.f)));
+		__m128 f = _mm_sub_ps(t, i);
+
+		__m128 p = _mm_add_ps(_mm_set1_ps(0.00133988748f), _mm_mul_ps(f, _mm_set1_ps(0.000153533620f)));
+		p = _mm_add_ps(_mm_set1_ps(0.00961843785f), _mm_mul_ps(f, p));
+		p = _mm_add_ps(_mm_set1_ps(0.0555033237f), _mm_mul_ps(f, p));
+		p = _mm_add_ps(_mm_set1_ps(0.240226462f), _mm_mul_ps(f, p));
+		p = _mm_add_ps(_mm_set1_ps(0.693147182f), _mm_mul_ps(f, p));
+		p = _mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(f, p));
+
+		__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(i), _mm_set1_epi32(127)), 23));
+		return _mm_and_ps(_mm_mul_ps(p, scale), valid);
+	}
+
+	inline __m128 atrousRcp4(__m128 x)
+	{
+		const __m128 two = _mm_set1_ps(2.f);
+		__m128 y = _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(0x7EF311C3), _mm_castps_si128(x)));
+		y = _mm_mul_ps(y, _mm_sub_ps(two, _mm_mul_ps(x, y)));
+		y = _mm_mul_ps(y, _mm_sub_ps(two, _mm_mul_ps(x, y)));
+		y = _mm_mul_ps(y, _mm_sub_ps(two, _mm_mul_ps(x, y)));
+		return y;
+	}
+
+	inline __m128 atrousDist2x4(__m128 x, __m128 y, __m128 z)
+	{
+		__m128 d = _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y));
+		return _mm_add_ps(d, _mm_mul_ps(z, z));
+	}
+
+	inline __m128 negate(__m128 x)
+	{
+		return _mm_xor_ps(x, _mm_set1_ps(-0.f));
+	}
+
+	// Four horizontally adjacent texels from row <row> of a plane, starting at column x and clamped to [0, width)
+	inline __m128 loadRow4(const float* row, int x, int width)
+	{
+		if (x >= 0 && x + 3 < width) return _mm_loadu_ps(row + x);
+		return _mm_setr_ps(row[std::min(std::max(x, 0), width - 1)], row[std::min(std::max(x + 1, 0), width - 1)],
+		                   row[std::min(std::max(x + 2, 0), width - 1)], row[std::min(std::max(x + 3, 0), width - 1)]);
+	}
+
+	inline uint32_t orderedBits(float value)
+	{
+		// Map float bits onto a line, so that the distance between two values is their ULP difference
+		uint32_t bits = atrousAsUint(value);
+		return (bits & 0x80000000u) ? 0x80000000u - (bits & 0x7FFFFFFFu) : 0x80000000u + bits;
+	}
+};
+
+CpuAtrousFilter::SharedPtr CpuAtrousFilter::create(const TiledDispatch::SharedPtr& pDispatch)
+{
+	return SharedPtr(new CpuAtrousFilter(pDispatch ? pDispatch : TiledDispatch::create(0, uvec2(ATROUS_TILE_SIZE, ATROUS_TILE_SIZE))));
+}
+
+CpuAtrousFilter::CpuAtrousFilter(const TiledDispatch::SharedPtr& pDispatch) :
+	mpDispatch(pDispatch)
+{
+}
+
+void CpuAtrousFilter::loadPlanes(const uvec2& dim, const std::vector<vec4>& color, const std::vector<vec4>& position, const std::vector<vec4>& normal)
+{
+	mWidth = int(dim.x);
+	mHeight = int(dim.y);
+	size_t count = size_t(dim.x) * dim.y;
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		mColor[0][c].resize(count);
+		mColor[1][c].resize(count);
+		mPosition[c].resize(count);
+		mNormal[c].resize(count);
+	}
+
+	// The shader's PackGBuffer:  positions as they are, normals through the packed format
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t packed = atrousPackNormal(normal[i].x, normal[i].y, normal[i].z);
+		mNormal[0][i] = atrousUnpackNormalX(packed);
+		mNormal[1][i] = atrousUnpackNormalY(packed);
+		mNormal[2][i] = atrousUnpackNormalZ(packed);
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			mColor[0][c][i] = color[i][c];
+			mPosition[c][i] = position[i][c];
+		}
+	}
+
+	mInvPhi2[0] = atrousInvPhi2(mSettings.colorPhi);
+	mInvPhi2[1] = atrousInvPhi2(mSettings.normalPhi);
+	mInvPhi2[2] = atrousInvPhi2(mSettings.positionPhi);
+}
+
+void CpuAtrousFilter::filter(const uvec2& dim, const std::vector<vec4>& color, const std::vector<vec4>& position, const std::vector<vec4>& normal,
+                             std::vector<vec4>& output)
+{
+	size_t count = size_t(dim.x) * dim.y;
+	if (count == 0 || color.size() < count || position.size() < count || normal.size() < count) return;
+	loadPlanes(dim, color, position, normal);
+
+	// Ping-pong between the plane sets, one dispatch per iteration (the shader fuses the first two, with the same result)
+	uint32_t src = 0;
+	for (uint32_t iter = 0; iter < std::max(1u, mSettings.iterations); iter++)
+	{
+		int step = 1 << iter;
+		mpDispatch->execute(dim, [&](const uvec2& tileStart, const uvec2& tileEnd)
+		{
+			FlushDenormals ftz;
+			for (int y = int(tileStart.y); y < int(tileEnd.y); y++)
+			{
+				int x = int(tileStart.x);
+				if (mSettings.useSimd)
+				{
+					for (; x + 4 <= int(tileEnd.x); x += 4) filterQuad(x, y, step, src, 1 - src);
+				}
+				for (; x < int(tileEnd.x); x++) filterPixel(x, y, step, src, 1 - src);
+			}
+		});
+		src = 1 - src;
+	}
+
+	output.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		output[i] = vec4(mColor[src][0][i], mColor[src][1][i], mColor[src][2][i], 1.f);
+	}
+}
+
+void CpuAtrousFilter::filterPixel(int x, int y, int step, uint32_t src, uint32_t dst)
+{
+	const std::vector<float>* color = mColor[src];
+	size_t center = size_t(y) * mWidth + x;
+	float cr = color[0][center], cg = color[1][center], cb = color[2][center];
+	float cnx = mNormal[0][center], cny = mNormal[1][center], cnz = mNormal[2][center];
+	float cpx = mPosition[0][center], cpy = mPosition[1][center], cpz = mPosition[2][center];
+
+	// As accumulateTap() in atrous.cs.hlsl
+	float sumR = 0.f, sumG = 0.f, sumB = 0.f, sumWeights = 0.f;
+	for (int dy = -2; dy <= 2; dy++)
+	{
+		int ty = std::min(std::max(y + dy * step, 0), mHeight - 1);
+		for (int dx = -2; dx <= 2; dx++)
+		{
+			int tx = std::min(std::max(x + dx * step, 0), mWidth - 1);
+			size_t tap = size_t(ty) * mWidth + tx;
+
+			float r = color[0][tap], g = color[1][tap], b = color[2][tap];
+			float colorDist2 = atrousDist2(cr - r, cg - g, cb - b);
+			float normalDist2 = atrousDist2(cnx - mNormal[0][tap], cny - mNormal[1][tap], cnz - mNormal[2][tap]);
+			float positionDist2 = atrousDist2(cpx - mPosition[0][tap], cpy - mPosition[1][tap], cpz - mPosition[2][tap]);
+
+			float weight = atrousEdgeWeight(colorDist2, normalDist2, positionDist2, mInvPhi2[0], mInvPhi2[1], mInvPhi2[2]) * (kAtrousKernel[dy + 2] * kAtrousKernel[dx + 2]);
+			sumR = sumR + r * weight;
+			sumG = sumG + g * weight;
+			sumB = sumB + b * weight;
+			sumWeights = sumWeights + weight;
+		}
+	}
+
+	float rcp = atrousRcp(sumWeights);
+	mColor[dst][0][center] = sumR * rcp;
+	mColor[dst][1][center] = sumG * rcp;
+	mColor[dst][2][center] = sumB * rcp;
+}
+
+void CpuAtrousFilter::filterQuad(int x, int y, int step, uint32_t src, uint32_t dst)
+{
+	const std::vector<float>* color = mColor[src];
+	size_t center = size_t(y) * mWidth + x;
+	__m128 cr = _mm_loadu_ps(&color[0][center]), cg = _mm_loadu_ps(&color[1][center]), cb = _mm_loadu_ps(&color[2][center]);
+	__m128 cnx = _mm_loadu_ps(&mNormal[0][center]), cny = _mm_loadu_ps(&mNormal[1][center]), cnz = _mm_loadu_ps(&mNormal[2][center]);
+	__m128 cpx = _mm_loadu_ps(&mPosition[0][center]), cpy = _mm_loadu_ps(&mPosition[1][center]), cpz = _mm_loadu_ps(&mPosition[2][center]);
+	__m128 invPhi2[3] = { _mm_set1_ps(mInvPhi2[0]), _mm_set1_ps(mInvPhi2[1]), _mm_set1_ps(mInvPhi2[2]) };
+
+	__m128 sumR = _mm_setzero_ps(), sumG = _mm_setzero_ps(), sumB = _mm_setzero_ps(), sumWeights = _mm_setzero_ps();
+	for (int dy = -2; dy <= 2; dy++)
+	{
+		size_t row = size_t(std::min(std::max(y + dy * step, 0), mHeight - 1)) * mWidth;
+		for (int dx = -2; dx <= 2; dx++)
+		{
+			int tx = x + dx * step;
+			__m128 r = loadRow4(&color[0][row], tx, mWidth), g = loadRow4(&color[1][row], tx, mWidth), b = loadRow4(&color[2][row], tx, mWidth);
+			__m128 colorDist2 = atrousDist2x4(_mm_sub_ps(cr, r), _mm_sub_ps(cg, g), _mm_sub_ps(cb, b));
+			__m128 normalDist2 = atrousDist2x4(_mm_sub_ps(cnx, loadRow4(&mNormal[0][row], tx, mWidth)), _mm_sub_ps(cny, loadRow4(&mNormal[1][row], tx, mWidth)),
+			                                   _mm_sub_ps(cnz, loadRow4(&mNormal[2][row], tx, mWidth)));
+			__m128 positionDist2 = atrousDist2x4(_mm_sub_ps(cpx, loadRow4(&mPosition[0][row], tx, mWidth)), _mm_sub_ps(cpy, loadRow4(&mPosition[1][row], tx, mWidth)),
+			                                     _mm_sub_ps(cpz, loadRow4(&mPosition[2][row], tx, mWidth)));
+
+			// atrousEdgeWeight()
+			__m128 weight = atrousExp4(_mm_mul_ps(negate(colorDist2), invPhi2[0]));
+			weight = _mm_mul_ps(weight, atrousExp4(_mm_mul_ps(negate(normalDist2), invPhi2[1])));
+			weight = _mm_mul_ps(weight, atrousExp4(_mm_mul_ps(negate(positionDist2), invPhi2[2])));
+			weight = _mm_mul_ps(weight, _mm_set1_ps(kAtrousKernel[dy + 2] * kAtrousKernel[dx + 2]));
+
+			sumR = _mm_add_ps(sumR, _mm_mul_ps(r, weight));
+			sumG = _mm_add_ps(sumG, _mm_mul_ps(g, weight));
+			sumB = _mm_add_ps(sumB, _mm_mul_ps(b, weight));
+			sumWeights = _mm_add_ps(sumWeights, weight);
+		}
+	}
+
+	__m128 rcp = atrousRcp4(sumWeights);
+	_mm_storeu_ps(&mColor[dst][0][center], _mm_mul_ps(sumR, rcp));
+	_mm_storeu_ps(&mColor[dst][1][center], _mm_mul_ps(sumG, rcp));
+	_mm_storeu_ps(&mColor[dst][2][center], _mm_mul_ps(sumB, rcp));
+}
+
+CpuAtrousFilter::SimdBenchmark CpuAtrousFilter::benchmarkSimd(const uvec2& dim, const std::vector<vec4>& color, const std::vector<vec4>& position,
+                                                              const std::vector<vec4>& normal, uint32_t runs)
+{
+	SimdBenchmark result;
+	runs = std::max(1u, runs);
+	bool savedUseSimd = mSettings.useSimd;
+	std::vector<vec4> images[2];
+
+	for (uint32_t simd = 0; simd < 2; simd++)
+	{
+		mSettings.useSimd = (simd != 0);
+		CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+		for (uint32_t run = 0; run < runs; run++) filter(dim, color, position, normal, images[simd]);
+		float ms = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint())) / float(runs);
+		(simd ? result.simdMs : result.scalarMs) = ms;
+	}
+
+	mSettings.useSimd = savedUseSimd;
+	result.difference = compare(images[0], images[1]);
+	return result;
+}
+
+CpuAtrousFilter::Comparison CpuAtrousFilter::compare(const std::vector<vec4>& a, const std::vector<vec4>& b)
+{
+	Comparison result;
+	result.pixels = uint32_t(std::min(a.size(), b.size()));
+	for (uint32_t i = 0; i < result.pixels; i++)
+	{
+		bool mismatch = false;
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			uint32_t ua = orderedBits(a[i][c]), ub = orderedBits(b[i][c]);
+			uint32_t ulps = (ua > ub) ? ua - ub : ub - ua;
+			result.maxUlps = std::max(result.maxUlps, ulps);
+			mismatch |= (ulps != 0);
+		}
+		if (mismatch) result.mismatches++;
+	}
+	return result;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Falcor.h"
+#include "../../SharedUtils/TiledDispatch.h"
+
+/** The edge-avoiding a-trous denoiser of atrous.cs.hlsl on the CPU, filtering four pixels at a time with SSE.  It
+    runs the same math (Shaders/AtrousFilter.h) in the same order, so for the same input it writes the same bits as
+    the compute shader, and as its own scalar path.  DenoisingPass uses it to validate the GPU filter, and
+    CpuReSTIRPass to denoise without a GPU.
+
+    Like the shader, it flushes denormals to zero (the tile kernels set FTZ/DAZ for their thread) and expects host code
+    built without floating-point contraction into FMAs (MSVC's default /fp:precise).
+
+Usage:
+     CpuAtrousFilter::SharedPtr pFilter = CpuAtrousFilter::create();
+     pFilter->getSettings().iterations = 4;
+
+     // Color from "ShadedOutput", G-buffer from "WorldPosition" and "WorldNormal"
+     pFilter->filter(screenSize, color, position, normal, denoised);
+
+     CpuAtrousFilter::SimdBenchmark bench = pFilter->benchmarkSimd(screenSize, color, position, normal);
+     CpuAtrousFilter::Comparison cmp = CpuAtrousFilter::compare(gpuResult, denoised);
+*/
+class CpuAtrousFilter : public std::enable_shared_from_this<CpuAtrousFilter>
+{
+public:
+	using SharedPtr = std::shared_ptr<CpuAtrousFilter>;
+	using SharedConstPtr = std::shared_ptr<const CpuAtrousFilter>;
+	virtual ~CpuAtrousFilter() = default;
+
+	// Filter controls, matching DenoisingPass' GUI
+	struct Settings
+	{
+		uint32_t iterations = 4;           ///< Step sizes 1, 2, 4, ...
+		float    colorPhi = 0.5f;
+		float    normalPhi = 0.0625f;
+		float    positionPhi = 0.05f;
+		bool     useSimd = true;           ///< Four pixels at a time (otherwise one, through the shared scalar code)
+	};
+
+	// How far apart two filtered images are
+	struct Comparison
+	{
+		uint32_t pixels = 0;
+		uint32_t mismatches = 0;           ///< Pixels whose rgb bits differ
+		uint32_t maxUlps = 0;              ///< Largest difference of any channel, in units in the last place
+	};
+
+	// SIMD vs. scalar filtering, as measured by benchmarkSimd()
+	struct SimdBenchmark
+	{
+		float      scalarMs = 0.f;         ///< Time per filtered image
+		float      simdMs = 0.f;
+		Comparison difference;             ///< Between the two (should have no mismatches)
+	};
+
+	// Create a filter.  If no dispatcher is given, one is created using all cores.
+	static SharedPtr create(const TiledDispatch::SharedPtr& pDispatch = nullptr);
+
+	// Filter the rgb of <color> with the G-buffer <position> and <normal> (all dim.x * dim.y texels), writing <output>
+	//     (alpha 1).  Output may alias color.
+	void filter(const uvec2& dim, const std::vector<vec4>& color, const std::vector<vec4>& position, const std::vector<vec4>& normal,
+	            std::vector<vec4>& output);
+
+	// Filter the same image <runs> times with the scalar and the SIMD path and compare their results
+	SimdBenchmark benchmarkSimd(const uvec2& dim, const std::vector<vec4>& color, const std::vector<vec4>& position, const std::vector<vec4>& normal,
+	                            uint32_t runs = 8);
+
+	// Compare the rgb of two images of the same size
+	static Comparison compare(const std::vector<vec4>& a, const std::vector<vec4>& b);
+
+	// Accessors
+	Settings& getSettings()                             { return mSettings; }
+	const TiledDispatch::SharedPtr& getDispatch() const { return mpDispatch; }
+
+protected:
+	CpuAtrousFilter(const TiledDispatch::SharedPtr& pDispatch);
+
+	// Planar copies of the inputs, so that four neighboring pixels are one load
+	void loadPlanes(const uvec2& dim, const std::vector<vec4>& color, const std::vector<vec4>& position, const std::vector<vec4>& normal);
+
+	// One iteration (taps <step> pixels apart) for pixel (x, y), or the four pixels from there, reading plane set <src> and writing <dst>
+	void filterPixel(int x, int y, int step, uint32_t src, uint32_t dst);
+	void filterQuad(int x, int y, int step, uint32_t src, uint32_t dst);
+
+	TiledDispatch::SharedPtr      mpDispatch;
+	Settings                      mSettings;
+
+	int                           mWidth = 0;
+	int                           mHeight = 0;
+	float                         mInvPhi2[3];         ///< atrousInvPhi2() of color, normal, position phi
+	std::vector<float>            mColor[2][3];        ///< Ping-ponged rgb planes
+	std::vector<float>            mPosition[3];
+	std::vector<float>            mNormal[3];          ///< Decoded from the packed G-buffer, as the shader sees them
+};
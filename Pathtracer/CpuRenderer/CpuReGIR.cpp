@@ -0,0 +1,189 @@
+#include "CpuReGIR.h"
+
+using namespace CpuReSTIR;
+
+namespace {
+	// Seeds for validate()'s fills, distinct from any frame counter the passes use (which start at 0x1456u)
+	const uint32_t kCellSeed = 0xC3110000u;
+	const uint32_t kPixelSeed = 0xC3120000u;
+};
+
+std::string CpuReGIR::Report::toString() const
+{
+	std::string s;
+	if (slotsCompared > 0)
+	{
+		s += std::to_string(slotsCompared) + " slots vs. CPU replay:  " + std::to_string(100.f * slotMismatchRate) +
+			"% different lights, max W error " + std::to_string(maxWeightError) + "\n";
+	}
+	s += std::to_string(cellsChecked) + " cells vs. brute force:  E[wSum/M] error " + std::to_string(cellWeightSumError) +
+		", E[W] error " + std::to_string(cellCoverageError) + ", per-pixel estimate error " + std::to_string(pixelEstimateError);
+	return s;
+}
+
+CpuReGIR::SharedPtr CpuReGIR::create(const TiledDispatch::SharedPtr& pDispatch)
+{
+	return SharedPtr(new CpuReGIR(pDispatch ? pDispatch : TiledDispatch::create()));
+}
+
+void CpuReGIR::buildCells(const ReGIRGrid& grid, const std::vector<LightData>& lights, uint32_t frameCount, std::vector<vec4>& slots) const
+{
+	slots.assign(grid.getSlotCount(), vec4(0.f));
+	if (lights.empty()) return;
+
+	// Same launch as BuildCellReservoirsPass:  x = slot within the cell, y = cell
+	uint32_t lightsPerCell = grid.getLightsPerCell();
+	vec3 cellSize = grid.getCellSize();
+	mpDispatch->execute(uvec2(lightsPerCell, grid.getCellTotal()), [&](const uvec2& tileStart, const uvec2& tileEnd)
+	{
+		for (uint32_t cell = tileStart.y; cell < tileEnd.y; cell++)
+		{
+			vec3 gridCellCenter = grid.mapCellIndexToWorld(cell);
+			for (uint32_t x = tileStart.x; x < tileEnd.x; x++)
+			{
+				uint32_t lightSlot = x + lightsPerCell * cell;
+				uint32_t randSeed = initRand(lightSlot, frameCount, 16);
+				slots[lightSlot] = packReservoir(sampleLightsRIS(gridCellCenter, cellSize, lights, grid.getCellCandidates(), randSeed));
+			}
+		}
+	});
+}
+
+Reservoir CpuReGIR::sampleCell(const ReGIRGrid& grid, const std::vector<vec4>& slots, const std::vector<LightData>& lights,
+                               const GBuffer& gBuffer, int cellIndex, int lightSamples, uint32_t& randSeed) const
+{
+	int lightsCount = int(lights.size());
+	uint32_t lightsPerCell = grid.getLightsPerCell();
+
+	// To hold information about current light
+	float dist = 0.f;
+	vec3 lightIntensity;
+	vec3 lightDirection;
+
+	Reservoir reservoir;
+	for (int i = 0; i < lightSamples && lightsCount > 0; i++) {
+		Reservoir candidate;
+		if (cellIndex >= 0) {
+			uint32_t slot = std::min(uint32_t(nextRand(randSeed) * float(lightsPerCell)), lightsPerCell - 1);
+			candidate = createReservoir(slots[uint32_t(cellIndex) * lightsPerCell + slot]);
+		}
+		else {
+			candidate.y = float(std::min(int(nextRand(randSeed) * lightsCount), lightsCount - 1));
+			candidate.W = float(lightsCount);
+		}
+
+		float p_hat = evaluatePHat(gBuffer, lights, lightDirection, lightIntensity, dist, candidate.y);
+		updateReservoir(reservoir, candidate.y, p_hat * candidate.W, randSeed);
+	}
+
+	if (reservoir.wSum > 0.f) {
+		float p_hat = evaluatePHat(gBuffer, lights, lightDirection, lightIntensity, dist, reservoir.y);
+		reservoir.W = (p_hat == 0.f) ? 0.f : (1.f / p_hat) * (reservoir.wSum / reservoir.M);
+	}
+	return reservoir;
+}
+
+CpuReGIR::Report CpuReGIR::validate(const ReGIRGrid& grid, const std::vector<LightData>& lights, const std::vector<vec4>& gpuSlots,
+                                    uint32_t cellCount, uint32_t trials, int lightSamples) const
+{
+	Report report;
+	if (lights.empty() || trials == 0) return report;
+
+	// 1. The GPU grid should match a replay of the same build
+	if (!gpuSlots.empty())
+	{
+		if (gpuSlots.size() != grid.getSlotCount())
+		{
+			logWarning("CpuReGIR::validate() - GPU grid has " + std::to_string(gpuSlots.size()) + " slots, expected " + std::to_string(grid.getSlotCount()));
+		}
+		else
+		{
+			std::vector<vec4> cpuSlots;
+			buildCells(grid, lights, grid.getLastBuildFrame(), cpuSlots);
+
+			uint32_t mismatches = 0;
+			for (size_t i = 0; i < cpuSlots.size(); i++)
+			{
+				if (gpuSlots[i].x != cpuSlots[i].x) mismatches++;
+				else if (cpuSlots[i].z > 0.f) report.maxWeightError = std::max(report.maxWeightError, fabsf(gpuSlots[i].z - cpuSlots[i].z) / cpuSlots[i].z);
+			}
+			report.slotsCompared = uint32_t(cpuSlots.size());
+			report.slotMismatchRate = float(mismatches) / float(cpuSlots.size());
+		}
+	}
+
+	// 2. Statistics of evenly spaced cells, against brute-force sums over all lights
+	uint32_t lightsCount = uint32_t(lights.size());
+	uint32_t lightsPerCell = grid.getLightsPerCell();
+	vec3 cellSize = grid.getCellSize();
+	cellCount = std::min(cellCount, grid.getCellTotal());
+	for (uint32_t k = 0; k < cellCount; k++)
+	{
+		uint32_t cell = uint32_t(uint64_t(k) * grid.getCellTotal() / cellCount);
+		vec3 gridCellCenter = grid.mapCellIndexToWorld(cell);
+
+		double pHatSum = 0.0;
+		uint32_t visibleLights = 0;
+		for (uint32_t l = 0; l < lightsCount; l++)
+		{
+			float p_hat = evaluateCellPHat(gridCellCenter, cellSize, lights[l]);
+			pHatSum += p_hat;
+			visibleLights += (p_hat > 0.f) ? 1 : 0;
+		}
+		if (visibleLights == 0) continue;
+
+		double wSumMean = 0.0, wMean = 0.0;
+		for (uint32_t t = 0; t < trials; t++)
+		{
+			uint32_t randSeed = initRand(cell * trials + t, kCellSeed, 16);
+			Reservoir r = sampleLightsRIS(gridCellCenter, cellSize, lights, grid.getCellCandidates(), randSeed);
+			wSumMean += r.wSum / r.M;
+			wMean += r.W;
+		}
+		wSumMean /= trials;
+		wMean /= trials;
+		report.cellWeightSumError = std::max(report.cellWeightSumError, float(fabs(wSumMean - pHatSum) / pHatSum));
+		report.cellCoverageError = std::max(report.cellCoverageError, float(fabs(wMean - visibleLights) / visibleLights));
+
+		// 3. A random shading point in the cell (white albedo, random normal), resampled from fresh fills of the cell's slots
+		uint32_t pointSeed = initRand(cell, kPixelSeed, 16);
+		vec3 offset = vec3(nextRand(pointSeed), nextRand(pointSeed), nextRand(pointSeed)) - 0.5f;
+		vec3 normal = vec3(nextRand(pointSeed), nextRand(pointSeed), nextRand(pointSeed)) * 2.f - 1.f;
+		GBuffer gBuffer;
+		gBuffer.pos = vec4(gridCellCenter + offset * cellSize, 1.f);
+		gBuffer.norm = vec4(glm::length(normal) > 0.f ? glm::normalize(normal) : vec3(0.f, 1.f, 0.f), 0.f);
+		gBuffer.color = vec4(1.f);
+
+		float dist;
+		vec3 lightIntensity;
+		vec3 lightDirection;
+		double bruteForce = 0.0;
+		for (uint32_t l = 0; l < lightsCount; l++)
+		{
+			bruteForce += evaluatePHat(gBuffer, lights, lightDirection, lightIntensity, dist, float(l));
+		}
+
+		if (bruteForce > 0.0)
+		{
+			std::vector<vec4> cellSlots(lightsPerCell);
+			uint32_t randSeed = initRand(cell, kPixelSeed + 1, 16);
+			double estimate = 0.0;
+			for (uint32_t t = 0; t < trials; t++)
+			{
+				for (uint32_t s = 0; s < lightsPerCell; s++)
+				{
+					cellSlots[s] = packReservoir(sampleLightsRIS(gridCellCenter, cellSize, lights, grid.getCellCandidates(), randSeed));
+				}
+
+				Reservoir r = sampleCell(grid, cellSlots, lights, gBuffer, 0, lightSamples, randSeed);
+				if (r.W > 0.f) estimate += r.W * evaluatePHat(gBuffer, lights, lightDirection, lightIntensity, dist, r.y);
+			}
+			estimate /= trials;
+			report.pixelEstimateError = std::max(report.pixelEstimateError, float(fabs(estimate - bruteForce) / bruteForce));
+		}
+
+		report.cellsChecked++;
+	}
+
+	return report;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Falcor.h"
+#include "../../SharedUtils/TiledDispatch.h"
+#include "../Passes/ReGIRGrid.h"
+#include "CpuReSTIRUtils.h"
+
+/** A CPU implementation of the ReGIR light grid in buildCellReservoirs.hlsl / sampleLightGrid.hlsl, used to check
+    the GPU grid against brute force.
+
+    buildCells() fills every light slot exactly as the GPU does (same seeds, same operation order), so a GPU grid
+    read back after BuildCellReservoirsPass can be compared slot by slot.  validate() additionally checks the
+    statistics of the sampling itself against brute-force sums over all lights:
+
+      * Cells:   each slot's reservoir is an RIS estimate, so E[wSum / M] must equal the sum of the cell's target
+                 function over all lights, and E[W] must equal the number of lights the cell can see.
+      * Pixels:  resampling a cell's slots for a shading point gives an unbiased estimate of its unshadowed direct
+                 lighting, so E[p_hat(y) * W] must equal the sum of p_hat over all lights.
+
+Usage:
+     CpuReGIR::SharedPtr pReGIR = CpuReGIR::create();
+     std::vector<vec4> slots;
+     pReGIR->buildCells(*pGrid, lights, pGrid->getLastBuildFrame(), slots);
+
+     CpuReGIR::Report report = pReGIR->validate(*pGrid, lights, gpuSlots);
+     logInfo(report.toString());
+*/
+
+namespace CpuReSTIR
+{
+	// Mirrors evaluateCellPHat() in regirUtils.hlsli
+	inline float evaluateCellPHat(const vec3& cellCenter, const vec3& cellSize, const LightData& light)
+	{
+		vec3 lightDirection;
+		vec3 lightIntensity;
+		float dist;
+		getLightData(light, cellCenter, lightDirection, lightIntensity, dist);
+
+		float minDistSquared = 0.25f * glm::dot(cellSize, cellSize);
+		return glm::length(lightIntensity) / std::max(dist * dist, minDistSquared);
+	}
+
+	// Mirrors sampleLightsRIS() in regirUtils.hlsli
+	inline Reservoir sampleLightsRIS(const vec3& cellCenter, const vec3& cellSize, const std::vector<LightData>& lights, int candidates, uint32_t& randSeed)
+	{
+		int lightsCount = int(lights.size());
+		Reservoir r;
+		for (int i = 0; i < candidates; i++) {
+			int light = std::min(int(nextRand(randSeed) * lightsCount), lightsCount - 1);
+			float p = 1.f / float(lightsCount);
+			float p_hat = evaluateCellPHat(cellCenter, cellSize, lights[light]);
+			updateReservoir(r, float(light), p_hat / p, randSeed);
+		}
+
+		float p_hat = evaluateCellPHat(cellCenter, cellSize, lights[int(r.y)]);
+		r.W = (p_hat == 0.f) ? 0.f : (1.f / p_hat) * (r.wSum / r.M);
+		return r;
+	}
+};
+
+class CpuReGIR : public std::enable_shared_from_this<CpuReGIR>
+{
+public:
+	using SharedPtr = std::shared_ptr<CpuReGIR>;
+	using SharedConstPtr = std::shared_ptr<const CpuReGIR>;
+	virtual ~CpuReGIR() = default;
+
+	// Results of validate().  Errors are 0 for a perfect match; the statistical ones shrink as 1 / sqrt(trials).
+	struct Report
+	{
+		uint32_t slotsCompared = 0;          ///< GPU slots compared against the CPU replay (0 if no GPU data was given)
+		float    slotMismatchRate = 0.f;     ///< Fraction of slots whose light differs from the CPU replay
+		float    maxWeightError = 0.f;       ///< Max relative error of W among slots with the same light
+
+		uint32_t cellsChecked = 0;
+		float    cellWeightSumError = 0.f;   ///< Max relative error of E[wSum / M] vs. the brute-force sum, over checked cells
+		float    cellCoverageError = 0.f;    ///< Max relative error of E[W] vs. the number of lights with p_hat > 0, over checked cells
+		float    pixelEstimateError = 0.f;   ///< Max relative error of E[p_hat(y) * W] vs. the brute-force sum, over checked shading points
+
+		std::string toString() const;
+	};
+
+	// Create a checker.  If no dispatcher is given, one is created using all cores.
+	static SharedPtr create(const TiledDispatch::SharedPtr& pDispatch = nullptr);
+
+	// Fill all of the grid's light slots, exactly as buildCellReservoirs.hlsl does with gFrameCount = frameCount
+	void buildCells(const ReGIRGrid& grid, const std::vector<LightData>& lights, uint32_t frameCount, std::vector<vec4>& slots) const;
+
+	// Resample one shading point's light from the cell's slots, as sampleLightGrid.hlsl does (minus the shadow ray).
+	//     <cellIndex> of -1 falls back to uniform light sampling.
+	CpuReSTIR::Reservoir sampleCell(const ReGIRGrid& grid, const std::vector<vec4>& slots, const std::vector<LightData>& lights,
+	                                const CpuReSTIR::GBuffer& gBuffer, int cellIndex, int lightSamples, uint32_t& randSeed) const;
+
+	// Compare <gpuSlots> (if not empty) against a CPU replay of the grid's last build, then check the statistics of
+	//     <cellCount> evenly spaced cells using <trials> independent fills each
+	Report validate(const ReGIRGrid& grid, const std::vector<LightData>& lights, const std::vector<vec4>& gpuSlots,
+	                uint32_t cellCount = 8, uint32_t trials = 1024, int lightSamples = 8) const;
+
+protected:
+	CpuReGIR(const TiledDispatch::SharedPtr& pDispatch) : mpDispatch(pDispatch) {}
+
+	TiledDispatch::SharedPtr      mpDispatch;
+};
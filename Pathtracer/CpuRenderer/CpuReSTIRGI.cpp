@@ -0,0 +1,380 @@
+#include "CpuReSTIRGI.h"
+
+using namespace CpuReSTIR;
+using BufferId = CpuReSTIRRenderer::BufferId;
+using GIBufferId = ReservoirStore::GIBufferId;
+
+namespace {
+	// benchmarkConvergence() measures every 8th pixel in x and y
+	const uint32_t kBenchmarkPixelStride = 8;
+
+	// Seed for benchmarkConvergence()'s reference, distinct from the passes' frame counters
+	const uint32_t kReferenceSeed = 0xC3210000u;
+
+	// Rays traced by the current thread since its last tile finished.  Flushed into mRayCount once per tile.
+	thread_local uint64_t tRayCount = 0;
+};
+
+CpuReSTIRGI::SharedPtr CpuReSTIRGI::create(const CpuReSTIRRenderer::SharedPtr& pRenderer)
+{
+	if (!pRenderer) return nullptr;
+	return SharedPtr(new CpuReSTIRGI(pRenderer));
+}
+
+CpuReSTIRGI::CpuReSTIRGI(const CpuReSTIRRenderer::SharedPtr& pRenderer) : mpRenderer(pRenderer), mRayCount(0)
+{
+}
+
+void CpuReSTIRGI::resize()
+{
+	mScreenSize = mpRenderer->getScreenSize();
+	size_t pixels = size_t(mScreenSize.x) * mScreenSize.y;
+
+	// Start from empty reservoirs (M = 0), as ReservoirStore does
+	PackedGIReservoir empty = packGIReservoir(emptyGIReservoir());
+	for (auto& buffer : mReservoirs)
+	{
+		buffer.assign(pixels, empty);
+	}
+	mIndirect.assign(pixels, vec4(0.f));
+}
+
+void CpuReSTIRGI::dispatch(const std::function<void(const uvec2&)>& kernel)
+{
+	mpRenderer->getDispatch()->execute(mScreenSize, [&](const uvec2& tileStart, const uvec2& tileEnd)
+	{
+		for (uint32_t y = tileStart.y; y < tileEnd.y; y++)
+		{
+			for (uint32_t x = tileStart.x; x < tileEnd.x; x++)
+			{
+				kernel(uvec2(x, y));
+			}
+		}
+		mRayCount += tRayCount;
+		tRayCount = 0;
+	});
+}
+
+void CpuReSTIRGI::renderFrame()
+{
+	if (mpRenderer->getScreenSize() != mScreenSize) resize();
+	if (mScreenSize.x == 0 || mScreenSize.y == 0) return;
+
+	mRayCount = 0;
+	executeCreateGISamples();
+	executeGISpatialReuse();
+	executeShadeWithGIReservoirs();
+	mFrameRayCount = mRayCount;
+}
+
+void CpuReSTIRGI::executeCreateGISamples()
+{
+	uint32_t frameCount = mCreateFrameCount++;
+	dispatch([&](const uvec2& pixelIndex) { createGISamplesRayGen(pixelIndex, frameCount); });
+}
+
+void CpuReSTIRGI::executeGISpatialReuse()
+{
+	uint32_t frameCount = mSpatialFrameCount++;
+	dispatch([&](const uvec2& pixelIndex) { giSpatialReuseRayGen(pixelIndex, frameCount); });
+}
+
+void CpuReSTIRGI::executeShadeWithGIReservoirs()
+{
+	dispatch([&](const uvec2& pixelIndex) { shadeWithGIReservoirsRayGen(pixelIndex); });
+}
+
+bool CpuReSTIRGI::traceGISampleRay(const vec3& origin, const vec3& direction, SampleHit& hit) const
+{
+	CpuScene::Ray ray = { origin, mpRenderer->getSettings().minT, direction, 1e+38f };
+	CpuScene::Hit sceneHit;
+	tRayCount++;
+	if (!mpRenderer->getScene()->intersect(ray, sceneHit)) return false;
+
+	CpuScene::ShadingData shadeData = mpRenderer->getScene()->getShadingData(sceneHit);
+	hit.hitPos = shadeData.posW;
+	hit.hitNorm = shadeData.N;
+	hit.diffuse = shadeData.diffuse;
+	return true;
+}
+
+float CpuReSTIRGI::shadowRayVisibility(const vec3& origin, const vec3& direction, float minT, float maxT) const
+{
+	CpuScene::Ray ray = { origin, minT, direction, maxT };
+	tRayCount++;
+	return mpRenderer->getScene()->occluded(ray) ? 0.f : 1.f;
+}
+
+vec3 CpuReSTIRGI::giDirectLighting(uint32_t& rndSeed, const vec3& hit, const vec3& norm, const vec3& diffuseColor) const
+{
+	const std::vector<LightData>& lights = mpRenderer->getScene()->getLights();
+	int lightsCount = int(lights.size());
+	if (lightsCount == 0) return vec3(0.f);
+
+	int light = std::min(int(nextRand(rndSeed) * lightsCount), lightsCount - 1);
+
+	float dist;
+	vec3 lightIntensity;
+	vec3 lightDirection;
+	getLightData(lights[light], hit, lightDirection, lightIntensity, dist);
+
+	float cosTheta = saturate(glm::dot(norm, lightDirection));
+	float shadow = shadowRayVisibility(hit, lightDirection, mpRenderer->getSettings().minT, dist);
+
+	vec3 color = float(lightsCount) * shadow * cosTheta * lightIntensity;
+	color *= diffuseColor / float(M_PI);
+	return color;
+}
+
+vec3 CpuReSTIRGI::getSampleRadiance(uint32_t& randSeed, SampleHit hit) const
+{
+	vec3 radiance = giDirectLighting(randSeed, hit.hitPos, hit.hitNorm, hit.diffuse);
+	vec3 throughput = vec3(1.f, 1.f, 1.f);
+	for (uint32_t depth = 1; depth < mSettings.maxDepth; depth++)
+	{
+		throughput *= hit.diffuse;
+		vec3 wi = getCosHemisphereSample(randSeed, hit.hitNorm);
+		if (!traceGISampleRay(hit.hitPos, wi, hit))
+		{
+			radiance += throughput * mpRenderer->getSettings().bgColor;
+			break;
+		}
+		radiance += throughput * giDirectLighting(randSeed, hit.hitPos, hit.hitNorm, hit.diffuse);
+	}
+	return radiance;
+}
+
+void CpuReSTIRGI::createGISamplesRayGen(const uvec2& pixelIndex, uint32_t frameCount)
+{
+	const uvec2& dim = mScreenSize;
+	uint32_t index = giReservoirIndex(pixelIndex, dim);
+
+	// Read G-buffer data
+	const vec4& worldPos = texel(BufferId::WorldPosition, index);
+	const vec4& worldNorm = texel(BufferId::WorldNormal, index);
+
+	GIReservoir r = emptyGIReservoir();
+	if (worldPos.w == 0)
+	{
+		reservoir(GIBufferId::CurrGIReservoirs, index) = packGIReservoir(r);
+		return;
+	}
+	r.visiblePos = vec3(worldPos);
+	r.visibleNorm = vec3(worldNorm);
+
+	// Initialize random number generator
+	uint32_t randSeed = initRand(pixelIndex.x + dim.x * pixelIndex.y, frameCount, 16);
+
+	// New sample:  one bounce in a cosine-distributed direction.  Misses become a far-away sample point facing us.
+	vec3 wi = getCosHemisphereSample(randSeed, vec3(worldNorm));
+	GIReservoir candidate = emptyGIReservoir();
+	candidate.M = 1.f;
+	SampleHit hit;
+	if (traceGISampleRay(vec3(worldPos), wi, hit))
+	{
+		candidate.samplePos = hit.hitPos;
+		candidate.sampleNorm = hit.hitNorm;
+		candidate.radiance = getSampleRadiance(randSeed, hit);
+	}
+	else
+	{
+		candidate.samplePos = vec3(worldPos) + wi * GI_SKY_DISTANCE;
+		candidate.sampleNorm = -wi;
+		candidate.radiance = mpRenderer->getSettings().bgColor;
+	}
+
+	float pdf = saturate(glm::dot(vec3(worldNorm), wi)) / float(M_PI);
+	float p_hat = giTargetFunction(candidate.radiance, vec3(worldPos), vec3(worldNorm), candidate.samplePos);
+	mergeGIReservoir(r, candidate, (pdf > 0.f) ? p_hat / pdf : 0.f, randSeed);
+
+	// Temporal reuse:  last frame's reservoir reconnects from its visible point to ours
+	uvec2 prevIndex;
+	if (mSettings.enableReSTIRGI && mSettings.doTemporalReuse &&
+		reprojectPixel(pixelIndex, dim, texel(BufferId::MotionVectors, index), vec3(worldNorm), mpRenderer->getBuffer(BufferId::PrevWorldNormal), prevIndex))
+	{
+		GIReservoir prevReservoir = unpackGIReservoir(reservoir(GIBufferId::PrevGIReservoirs, giReservoirIndex(prevIndex, dim)));
+		prevReservoir.M = std::min(mSettings.maxTemporalM, prevReservoir.M);
+
+		float jacobian = giReconnectionJacobian(vec3(worldPos), prevReservoir.visiblePos, prevReservoir.samplePos, prevReservoir.sampleNorm);
+		p_hat = giTargetFunction(prevReservoir.radiance, vec3(worldPos), vec3(worldNorm), prevReservoir.samplePos);
+		mergeGIReservoir(r, prevReservoir, p_hat * jacobian * prevReservoir.W * prevReservoir.M, randSeed);
+	}
+
+	finalizeGIReservoir(r);
+	reservoir(GIBufferId::CurrGIReservoirs, index) = packGIReservoir(r);
+}
+
+void CpuReSTIRGI::giSpatialReuseRayGen(const uvec2& pixelIndex, uint32_t frameCount)
+{
+	const uvec2& dim = mScreenSize;
+	uint32_t index = giReservoirIndex(pixelIndex, dim);
+
+	// Read G-buffer data
+	const vec4& worldPos = texel(BufferId::WorldPosition, index);
+	const vec4& worldNorm = texel(BufferId::WorldNormal, index);
+
+	if (!mSettings.enableReSTIRGI || !mSettings.doSpatialReuse || worldPos.w == 0)
+	{
+		reservoir(GIBufferId::SpatialGIReservoirs, index) = reservoir(GIBufferId::CurrGIReservoirs, index);
+		return;
+	}
+
+	// Initialize random number generator
+	uint32_t randSeed = initRand(pixelIndex.x + dim.x * pixelIndex.y, frameCount, 16);
+
+	// Our own reservoir needs no reconnection
+	GIReservoir current = unpackGIReservoir(reservoir(GIBufferId::CurrGIReservoirs, index));
+	GIReservoir r = emptyGIReservoir();
+	r.visiblePos = vec3(worldPos);
+	r.visibleNorm = vec3(worldNorm);
+	float p_hat = giTargetFunction(current.radiance, vec3(worldPos), vec3(worldNorm), current.samplePos);
+	mergeGIReservoir(r, current, p_hat * current.W * current.M, randSeed);
+
+	for (uint32_t i = 0; i < uint32_t(mSettings.spatialNeighbors); i++)
+	{
+		uvec2 neighborIndex = getGISpatialNeighborIndex(pixelIndex, dim, uint32_t(mSettings.spatialRadius), randSeed);
+		uint32_t neighbor = giReservoirIndex(neighborIndex, dim);
+		if (!isSimilarGISurface(worldNorm, texel(BufferId::WorldNormal, neighbor))) continue;
+
+		GIReservoir neighborReservoir = unpackGIReservoir(reservoir(GIBufferId::CurrGIReservoirs, neighbor));
+		if (neighborReservoir.M == 0.f) continue;
+
+		float jacobian = giReconnectionJacobian(vec3(worldPos), neighborReservoir.visiblePos, neighborReservoir.samplePos, neighborReservoir.sampleNorm);
+		if (jacobian > GI_MAX_JACOBIAN || jacobian < 1.f / GI_MAX_JACOBIAN) continue;
+
+		p_hat = giTargetFunction(neighborReservoir.radiance, vec3(worldPos), vec3(worldNorm), neighborReservoir.samplePos);
+		if (p_hat > 0.f && mSettings.doVisibilityReuse)
+		{
+			// Stop just short of the sample point, which would otherwise occlude itself
+			vec3 toSample = neighborReservoir.samplePos - vec3(worldPos);
+			float dist = glm::length(toSample);
+			p_hat *= shadowRayVisibility(vec3(worldPos), toSample / dist, mpRenderer->getSettings().minT, dist * 0.999f);
+		}
+		mergeGIReservoir(r, neighborReservoir, p_hat * jacobian * neighborReservoir.W * neighborReservoir.M, randSeed);
+	}
+
+	finalizeGIReservoir(r);
+	reservoir(GIBufferId::SpatialGIReservoirs, index) = packGIReservoir(r);
+}
+
+void CpuReSTIRGI::shadeWithGIReservoirsRayGen(const uvec2& pixelIndex)
+{
+	uint32_t index = giReservoirIndex(pixelIndex, mScreenSize);
+
+	// Next frame reuses our temporal reservoirs, not the spatial ones, so that neighbors' samples don't feed back into it
+	reservoir(GIBufferId::PrevGIReservoirs, index) = reservoir(GIBufferId::CurrGIReservoirs, index);
+
+	mIndirect[index] = vec4(0.f, 0.f, 0.f, 1.f);
+	const vec4& worldPos = texel(BufferId::WorldPosition, index);
+	if (worldPos.w == 0) return;
+
+	GIReservoir r = unpackGIReservoir(reservoir(GIBufferId::SpatialGIReservoirs, index));
+	if (r.W <= 0.f) return;
+
+	// Lambertian BRDF times the cosine toward the sample point, weighted by the reservoir
+	vec3 toSample = glm::normalize(r.samplePos - vec3(worldPos));
+	float cosTheta = saturate(glm::dot(vec3(texel(BufferId::WorldNormal, index)), toSample));
+	vec3 indirect = vec3(texel(BufferId::MaterialDiffuse, index)) / float(M_PI) * r.radiance * cosTheta * r.W;
+	mIndirect[index] = vec4(indirect, 1.f);
+}
+
+CpuReSTIRGI::ConvergenceBenchmark CpuReSTIRGI::benchmarkConvergence(const CameraData& camera, uint32_t frames, uint32_t referenceSamples)
+{
+	ConvergenceBenchmark result;
+	result.referenceSamples = std::max(1u, referenceSamples);
+	frames = std::max(1u, frames);
+
+	// Twice, so last frame's G-buffer (and so reprojection) is valid for the still camera
+	mpRenderer->executeGBuffer(camera);
+	mpRenderer->executeGBuffer(camera);
+	resize();
+	if (mScreenSize.x == 0 || mScreenSize.y == 0) return result;
+
+	// Reference:  the mean of many one-bounce samples, as fullGI.hlsl takes them
+	std::vector<vec3> reference(mIndirect.size(), vec3(0.f));
+	std::vector<uint8_t> measured(mIndirect.size(), 0);   // Not vector<bool>:  tiles write it concurrently
+	dispatch([&](const uvec2& pixelIndex)
+	{
+		if (pixelIndex.x % kBenchmarkPixelStride != 0 || pixelIndex.y % kBenchmarkPixelStride != 0) return;
+		uint32_t index = giReservoirIndex(pixelIndex, mScreenSize);
+		const vec4& worldPos = texel(BufferId::WorldPosition, index);
+		if (worldPos.w == 0) return;
+
+		vec3 norm = vec3(texel(BufferId::WorldNormal, index));
+		uint32_t randSeed = initRand(index, kReferenceSeed, 16);
+		vec3 sum = vec3(0.f);
+		for (uint32_t s = 0; s < result.referenceSamples; s++)
+		{
+			// Cosine sampling cancels the cosine and the Lambertian 1 / pi
+			vec3 wi = getCosHemisphereSample(randSeed, norm);
+			SampleHit hit;
+			sum += traceGISampleRay(vec3(worldPos), wi, hit) ? getSampleRadiance(randSeed, hit) : mpRenderer->getSettings().bgColor;
+		}
+		reference[index] = vec3(texel(BufferId::MaterialDiffuse, index)) * sum / float(result.referenceSamples);
+		measured[index] = 1;
+	});
+
+	double referenceSq = 0.0;
+	for (size_t i = 0; i < reference.size(); i++)
+	{
+		if (!measured[i]) continue;
+		referenceSq += glm::dot(reference[i], reference[i]);
+		result.pixels++;
+	}
+
+	// Both runs start from the same frame counters, without history
+	Settings savedSettings = mSettings;
+	uint32_t createFrameCount = mCreateFrameCount;
+	uint32_t spatialFrameCount = mSpatialFrameCount;
+	double pixels = double(mScreenSize.x) * mScreenSize.y;
+	auto measure = [&](bool enableReSTIRGI, float& msPerFrame, std::vector<ConvergencePoint>& points)
+	{
+		mSettings.enableReSTIRGI = enableReSTIRGI;
+		mCreateFrameCount = createFrameCount;
+		mSpatialFrameCount = spatialFrameCount;
+		resize();
+
+		std::vector<vec3> sum(mIndirect.size(), vec3(0.f));
+		double ms = 0.0;
+		uint64_t rays = 0;
+		uint32_t nextPoint = 1;
+		for (uint32_t f = 1; f <= frames; f++)
+		{
+			CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+			renderFrame();
+			ms += CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+			rays += mFrameRayCount;
+			for (size_t i = 0; i < sum.size(); i++) sum[i] += vec3(mIndirect[i]);
+			if (f != nextPoint && f != frames) continue;
+
+			double errorSq = 0.0;
+			for (size_t i = 0; i < sum.size(); i++)
+			{
+				if (!measured[i]) continue;
+				vec3 diff = sum[i] / float(f) - reference[i];
+				errorSq += glm::dot(diff, diff);
+			}
+
+			ConvergencePoint point;
+			point.frames = f;
+			point.raysPerPixel = float(double(rays) / pixels);
+			point.error = (referenceSq > 0.0) ? float(std::sqrt(errorSq / referenceSq)) : 0.f;
+			points.push_back(point);
+			if (f == nextPoint) nextPoint *= 2;
+		}
+		msPerFrame = float(ms / frames);
+	};
+
+	measure(false, result.fullGIMsPerFrame, result.fullGI);
+	measure(true, result.restirGIMsPerFrame, result.restirGI);
+
+	// Efficiency is 1 / (error^2 * cost);  error^2 alone falls as 1 / rays for fullGI
+	const ConvergencePoint& full = result.fullGI.back();
+	const ConvergencePoint& gi = result.restirGI.back();
+	float giCost = gi.error * gi.error * gi.raysPerPixel;
+	result.efficiencyGain = (giCost > 0.f) ? (full.error * full.error * full.raysPerPixel) / giCost : 0.f;
+
+	mSettings = savedSettings;
+	resize();
+	return result;
+}
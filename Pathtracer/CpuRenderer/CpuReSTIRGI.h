@@ -0,0 +1,211 @@
+#pragma once
+
+#include "Falcor.h"
+#include "CpuReSTIRRenderer.h"
+
+/** A CPU implementation of the ReSTIR GI passes,
+
+       CreateGISamplesPass -> GISpatialReusePass -> ShadeWithGIReservoirsPass
+
+    mirroring createGISamples.hlsl, giSpatialReuse.hlsl and shadeWithGIReservoirs.hlsl one for one (same GIReservoir
+    packing, seeds and per-pass frame counters).  It runs on top of a CpuReSTIRRenderer, reading its G-buffer and tracing
+    through its CpuScene, and writes each pixel's indirect lighting only (what ShadeWithGIReservoirsPass adds to
+    "ShadedOutput").  Bounce rays that miss the scene see the renderer's background color, standing in for the
+    environment map.
+
+    With ReSTIR GI disabled each pixel keeps just its new sample, which is exactly fullGI.hlsl's one-bounce estimate.
+    benchmarkConvergence() uses that to measure how much faster resampling converges for the rays it spends.
+
+Usage:
+     CpuReSTIRGI::SharedPtr pGI = CpuReSTIRGI::create(pRenderer);
+     pRenderer->executeGBuffer(camera);
+     pGI->renderFrame();
+     const std::vector<vec4>& indirect = pGI->getIndirect();
+
+     CpuReSTIRGI::ConvergenceBenchmark bench = pGI->benchmarkConvergence(camera);   // ReSTIR GI vs. fullGI, per ray
+*/
+
+namespace CpuReSTIR
+{
+	// As in restirGIUtils.hlsli
+	const float kGISimilarNormal = 0.9f;
+	const float kGISimilarDepth = 0.1f;
+
+	// Mirrors giReservoirIndex() in restirGIUtils.hlsli
+	inline uint32_t giReservoirIndex(const uvec2& pixelIndex, const uvec2& dim)
+	{
+		return pixelIndex.y * dim.x + pixelIndex.x;
+	}
+
+	// Mirrors mergeGIReservoir() in restirGIUtils.hlsli
+	inline void mergeGIReservoir(GIReservoir& r, const GIReservoir& candidate, float wi, uint32_t& randSeed)
+	{
+		r.wSum += wi;
+		r.M += candidate.M;
+		if (nextRand(randSeed) < (wi / r.wSum)) {
+			r.samplePos = candidate.samplePos;
+			r.sampleNorm = candidate.sampleNorm;
+			r.radiance = candidate.radiance;
+		}
+	}
+
+	// Mirrors finalizeGIReservoir() in restirGIUtils.hlsli
+	inline void finalizeGIReservoir(GIReservoir& r)
+	{
+		float p_hat = giTargetFunction(r.radiance, r.visiblePos, r.visibleNorm, r.samplePos);
+		r.W = (p_hat > 0.f) ? r.wSum / (r.M * p_hat) : 0.f;
+	}
+
+	// Mirrors getGISpatialNeighborIndex() in restirGIUtils.hlsli
+	inline uvec2 getGISpatialNeighborIndex(const uvec2& pixelIndex, const uvec2& dim, uint32_t radius, uint32_t& randSeed)
+	{
+		int offsetX = int(nextRand(randSeed) * float(2 * radius + 1)) - int(radius);
+		int offsetY = int(nextRand(randSeed) * float(2 * radius + 1)) - int(radius);
+		return uvec2(glm::clamp(ivec2(pixelIndex) + ivec2(offsetX, offsetY), ivec2(0, 0), ivec2(dim) - 1));
+	}
+
+	// Mirrors isSimilarGISurface() in restirGIUtils.hlsli
+	inline bool isSimilarGISurface(const vec4& norm, const vec4& neighborNorm)
+	{
+		if (glm::dot(vec3(norm), vec3(neighborNorm)) < kGISimilarNormal) return false;
+		return std::abs(neighborNorm.w - norm.w) <= kGISimilarDepth * norm.w;
+	}
+
+	// Mirrors getPerpendicularVector() in simpleGIUtils.hlsli
+	inline vec3 getPerpendicularVector(const vec3& u)
+	{
+		vec3 a = glm::abs(u);
+		uint32_t xm = ((a.x - a.y) < 0 && (a.x - a.z) < 0) ? 1 : 0;
+		uint32_t ym = (a.y - a.z) < 0 ? (1 ^ xm) : 0;
+		uint32_t zm = 1 ^ (xm | ym);
+		return glm::cross(u, vec3(float(xm), float(ym), float(zm)));
+	}
+
+	// Mirrors getCosHemisphereSample() in simpleGIUtils.hlsli
+	inline vec3 getCosHemisphereSample(uint32_t& randSeed, const vec3& hitNorm)
+	{
+		// Get 2 random numbers to select our sample with
+		float randX = nextRand(randSeed);
+		float randY = nextRand(randSeed);
+
+		// Cosine weighted hemisphere sample from RNG
+		vec3 bitangent = getPerpendicularVector(hitNorm);
+		vec3 tangent = glm::cross(bitangent, hitNorm);
+		float r = std::sqrt(randX);
+		float phi = 2.0f * 3.14159265f * randY;
+
+		// Get our cosine-weighted hemisphere lobe sample direction
+		return tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + hitNorm * std::sqrt(std::max(0.0f, 1.0f - randX));
+	}
+};
+
+class CpuReSTIRGI : public std::enable_shared_from_this<CpuReSTIRGI>
+{
+public:
+	using SharedPtr = std::shared_ptr<CpuReSTIRGI>;
+	using SharedConstPtr = std::shared_ptr<const CpuReSTIRGI>;
+	virtual ~CpuReSTIRGI() = default;
+
+	// Equivalent of the GUI / ResourceManager controls of the GPU passes
+	struct Settings
+	{
+		bool     enableReSTIRGI = true;        ///< ResourceManager::getReSTIRGI()
+		bool     doTemporalReuse = true;       ///< ResourceManager::getTemporal()
+		bool     doSpatialReuse = true;        ///< ResourceManager::getSpatial()
+		bool     doVisibilityReuse = false;    ///< GISpatialReusePass's "GI Visibility Reuse"
+		uint32_t maxDepth = 1;                 ///< CreateGISamplesPass's "Max Ray Depth"
+		float    maxTemporalM = 20.f;          ///< CreateGISamplesPass's "Temporal M Cap"
+		int32_t  spatialNeighbors = 5;
+		int32_t  spatialRadius = 30;
+	};
+
+	// Error after some number of frames, as recorded by benchmarkConvergence()
+	struct ConvergencePoint
+	{
+		uint32_t frames = 0;                   ///< Frames averaged
+		float    raysPerPixel = 0.f;           ///< Rays the GI passes traced for them, per pixel
+		float    error = 0.f;                  ///< Relative RMSE of their mean vs. the reference
+	};
+
+	// ReSTIR GI vs. fullGI's one-sample estimate from a still camera, as measured by benchmarkConvergence().  Error is over
+	//     every 8th pixel in x and y that sees geometry.  Spatial reuse is biased (neighbors' samples count toward M even where
+	//     ours cannot use them), so ReSTIR GI's error levels off at a floor that grows with the spatial radius.
+	struct ConvergenceBenchmark
+	{
+		uint32_t pixels = 0;                   ///< Reference pixels
+		uint32_t referenceSamples = 0;         ///< Bounce samples per reference pixel
+		float    fullGIMsPerFrame = 0.f;       ///< Frame time, ReSTIR GI disabled
+		float    restirGIMsPerFrame = 0.f;     ///< Frame time, ReSTIR GI enabled
+		std::vector<ConvergencePoint> fullGI;  ///< After 1, 2, 4, ... frames, ReSTIR GI disabled
+		std::vector<ConvergencePoint> restirGI;   ///< Same, ReSTIR GI enabled
+		float    efficiencyGain = 0.f;         ///< After all frames:  (fullGI error^2 * rays) / (ReSTIR GI error^2 * rays)
+	};
+
+	// Create ReSTIR GI passes on top of the given renderer, sharing its scene, G-buffer and dispatcher
+	static SharedPtr create(const CpuReSTIRRenderer::SharedPtr& pRenderer);
+
+	// Run all three stages on the renderer's current G-buffer.  (Re)allocates our reservoirs if the screen size changed.
+	void renderFrame();
+
+	// The individual stages, in order.  renderFrame() calls these for you.
+	void executeCreateGISamples();
+	void executeGISpatialReuse();
+	void executeShadeWithGIReservoirs();
+
+	// Render <frames> frames from a still camera with ReSTIR GI disabled, then enabled, starting without history each time,
+	//     and compare the running mean of each against a reference of <referenceSamples> bounce samples per pixel.
+	//     Overwrites the renderer's G-buffer and clears our temporal history.
+	ConvergenceBenchmark benchmarkConvergence(const CameraData& camera, uint32_t frames = 64, uint32_t referenceSamples = 1024);
+
+	// Accessors
+	Settings& getSettings()                                 { return mSettings; }
+	const std::vector<vec4>& getIndirect() const            { return mIndirect; }   ///< Indirect lighting only, one texel per pixel
+	const std::vector<PackedGIReservoir>& getReservoirs(ReservoirStore::GIBufferId id) const { return mReservoirs[uint32_t(id)]; }
+	uint64_t getFrameRayCount() const                       { return mFrameRayCount; }   ///< Rays traced by the last renderFrame()
+
+protected:
+	CpuReSTIRGI(const CpuReSTIRRenderer::SharedPtr& pRenderer);
+
+	// Where a bounce ray hit, as GISampleRayPayload in createGISamples.hlsl
+	struct SampleHit
+	{
+		vec3 hitPos;
+		vec3 hitNorm;
+		vec3 diffuse;
+	};
+
+	// Per-pixel entry points, equivalent to each stage's ray generation shader
+	void createGISamplesRayGen(const uvec2& pixelIndex, uint32_t frameCount);
+	void giSpatialReuseRayGen(const uvec2& pixelIndex, uint32_t frameCount);
+	void shadeWithGIReservoirsRayGen(const uvec2& pixelIndex);
+
+	// Shared helpers from the shaders
+	bool   traceGISampleRay(const vec3& origin, const vec3& direction, SampleHit& hit) const;
+	float  shadowRayVisibility(const vec3& origin, const vec3& direction, float minT, float maxT) const;
+	vec3   giDirectLighting(uint32_t& rndSeed, const vec3& hit, const vec3& norm, const vec3& diffuseColor) const;
+	vec3   getSampleRadiance(uint32_t& randSeed, SampleHit hit) const;
+
+	// Reallocate our reservoirs (empty, M = 0) for the renderer's screen size
+	void   resize();
+
+	// Launch a per-pixel kernel over the whole screen.  Rays traced by the kernel are added to mRayCount.
+	void   dispatch(const std::function<void(const uvec2&)>& kernel);
+
+	const vec4& texel(CpuReSTIRRenderer::BufferId id, uint32_t index) const { return mpRenderer->getBuffer(id)[index]; }
+	PackedGIReservoir& reservoir(ReservoirStore::GIBufferId id, uint32_t index) { return mReservoirs[uint32_t(id)][index]; }
+
+	CpuReSTIRRenderer::SharedPtr  mpRenderer;
+	Settings                      mSettings;
+
+	uvec2                         mScreenSize = uvec2(0, 0);
+	std::vector<PackedGIReservoir> mReservoirs[uint32_t(ReservoirStore::GIBufferId::Count)];   ///< As kept by ReservoirStore
+	std::vector<vec4>             mIndirect;
+
+	// Each GPU pass owns its own frame counter to seed its random number generator
+	uint32_t                      mCreateFrameCount = 0x2379u;
+	uint32_t                      mSpatialFrameCount = 0x3187u;
+
+	// Ray statistics
+	std::atomic<uint64_t>         mRayCount;
+	uint64_t                      mFrameRayCount = 0;
+};
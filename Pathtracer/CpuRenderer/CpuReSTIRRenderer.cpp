@@ -0,0 +1,1293 @@
+#include "CpuReSTIRRenderer.h"
+
+using namespace CpuReSTIR;
+
+namespace {
+	// Matches SPATIAL_LENGTH in spatialReuse.hlsl (the most neighbors the unbiased weights keep track of)
+	const uint32_t kSpatialLength = 8;
+
+	// Matches ENV_LIGHT_DISTANCE in envMapSampling.hlsli
+	const float kEnvLightDistance = 1.0e5f;
+
+	// Matches EMISSIVE_SHADOW_OFFSET in emissiveLights.hlsli
+	const float kEmissiveShadowOffset = 1.0e-3f;
+
+	// benchmarkLightSampling() measures every 8th pixel in x and y
+	const uint32_t kBenchmarkPixelStride = 8;
+
+	// Rays traced by the current thread since its last tile finished.  Flushed into mRayCount once per tile.
+	thread_local uint64_t tRayCount = 0;
+
+	// Same for reservoir buffer bytes read or written, flushed into mReservoirBytes
+	thread_local uint64_t tReservoirBytes = 0;
+};
+
+CpuReSTIRRenderer::SharedPtr CpuReSTIRRenderer::create(const CpuScene::SharedPtr& pScene, const TiledDispatch::SharedPtr& pDispatch)
+{
+	if (!pScene) return nullptr;
+	return SharedPtr(new CpuReSTIRRenderer(pScene, pDispatch ? pDispatch : TiledDispatch::create()));
+}
+
+CpuReSTIRRenderer::CpuReSTIRRenderer(const CpuScene::SharedPtr& pScene, const TiledDispatch::SharedPtr& pDispatch) :
+	mpScene(pScene), mpDispatch(pDispatch), mpAliasTable(LightAliasTable::create()), mpLightBvh(LightBvh::create()),
+	mpEnvSampler(EnvMapSampler::create(pDispatch)), mpEmissiveLights(EmissiveLights::create(pDispatch)), mRayCount(0), mReservoirBytes(0)
+{
+}
+
+void CpuReSTIRRenderer::resize(const uvec2& size)
+{
+	mScreenSize = size;
+	for (auto& buffer : mBuffers)
+	{
+		buffer.assign(size_t(size.x) * size.y, vec4(0.f));
+	}
+
+	// Start from empty reservoirs (M = 0), as ReservoirStore does
+	mReservoirsPerPixel = glm::clamp(mSettings.reservoirsPerPixel, 1u, ReservoirStore::kMaxReservoirsPerPixel);
+	mReservoirFormat = mSettings.reservoirFormat;
+	for (auto& buffer : mReservoirs)
+	{
+		buffer.assign(size_t(size.x) * size.y * mReservoirsPerPixel, FullReservoir{ 0, 0, 0.f, 0.f });
+	}
+	mSpatialReservoirsIn = mReservoirs[uint32_t(ReservoirStore::BufferId::SpatialReservoirsOut)];
+	mHasLastCamera = false;
+}
+
+void CpuReSTIRRenderer::dispatchTiles(const TiledDispatch::TileKernel& kernel)
+{
+	mpDispatch->execute(mScreenSize, [&](const uvec2& tileStart, const uvec2& tileEnd)
+	{
+		kernel(tileStart, tileEnd);
+		mRayCount += tRayCount;
+		mReservoirBytes += tReservoirBytes;
+		tRayCount = 0;
+		tReservoirBytes = 0;
+	});
+}
+
+void CpuReSTIRRenderer::dispatch(const std::function<void(const uvec2&)>& kernel)
+{
+	dispatchTiles([&](const uvec2& tileStart, const uvec2& tileEnd)
+	{
+		for (uint32_t y = tileStart.y; y < tileEnd.y; y++)
+		{
+			for (uint32_t x = tileStart.x; x < tileEnd.x; x++)
+			{
+				kernel(uvec2(x, y));
+			}
+		}
+	});
+}
+
+void CpuReSTIRRenderer::renderFrame(const CameraData& camera)
+{
+	if (mScreenSize.x == 0 || mScreenSize.y == 0) return;
+	if (mSettings.reservoirsPerPixel != mReservoirsPerPixel || mSettings.reservoirFormat != mReservoirFormat) resize(mScreenSize);
+	mRayCount = 0;
+	mReservoirBytes = 0;
+
+	executeGBuffer(camera);
+	executeCreateLightSamples(camera);
+
+	uint32_t iterations = uint32_t(std::max(1, mSettings.spatialIterations));
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		executeSpatialReuse(i, iterations);
+	}
+	executeShadeWithReservoirs();
+
+	mFrameRayCount = mRayCount;
+	mFrameReservoirBytes = mReservoirBytes;
+}
+
+void CpuReSTIRRenderer::executeGBuffer(const CameraData& camera)
+{
+	// Ping-pong, as RayTracedGBufferPass does:  what we wrote last frame becomes the previous G-buffer
+	std::swap(mBuffers[uint32_t(BufferId::WorldPosition)], mBuffers[uint32_t(BufferId::PrevWorldPosition)]);
+	std::swap(mBuffers[uint32_t(BufferId::WorldNormal)], mBuffers[uint32_t(BufferId::PrevWorldNormal)]);
+	std::swap(mBuffers[uint32_t(BufferId::MaterialDiffuse)], mBuffers[uint32_t(BufferId::PrevMaterialDiffuse)]);
+
+	// Motion vectors are relative to last frame's camera.  Without one, there is no motion yet.
+	if (!mHasLastCamera)
+	{
+		mLastCameraMatrix = camera.viewProjMat;
+		mLastCameraPos = camera.posW;
+		mHasLastCamera = true;
+	}
+
+	// Clear our G-buffer to black (the miss shader only writes the diffuse color)
+	for (BufferId id : { BufferId::WorldPosition, BufferId::WorldNormal, BufferId::MaterialDiffuse, BufferId::MotionVectors })
+	{
+		std::fill(mBuffers[uint32_t(id)].begin(), mBuffers[uint32_t(id)].end(), vec4(0.f));
+	}
+
+	// Primary rays are coherent, so trace them as 2x2 packets
+	dispatchTiles([&](const uvec2& tileStart, const uvec2& tileEnd)
+	{
+		for (uint32_t y = tileStart.y; y < tileEnd.y; y += 2)
+		{
+			for (uint32_t x = tileStart.x; x < tileEnd.x; x += 2)
+			{
+				gBufferRayGen(uvec2(x, y), tileEnd, camera);
+			}
+		}
+	});
+
+	// This frame's camera is next frame's previous one
+	mLastCameraMatrix = camera.viewProjMat;
+	mLastCameraPos = camera.posW;
+}
+
+void CpuReSTIRRenderer::executeCreateLightSamples(const CameraData& camera)
+{
+	// Rebuild the light selection table if any light's power changed, and refit the light BVH if any light moved
+	if (mSettings.lightSelection == LightSelection::AliasTable) mpAliasTable->update(mpScene->getLightPowers());
+	if (mSettings.lightSelection == LightSelection::Bvh) mpLightBvh->update(mpScene->getLights(), mpScene->getLightPowers());
+
+	uint32_t frameCount = mCreateFrameCount++;
+	dispatch([&](const uvec2& pixelIndex) { createLightSamplesRayGen(pixelIndex, frameCount); });
+}
+
+void CpuReSTIRRenderer::executeSpatialReuse(uint32_t iter, uint32_t totalIter)
+{
+	// Each SpatialReusePass instance in the GPU pipeline has its own frame counter
+	if (mSpatialFrameCount.size() < totalIter) mSpatialFrameCount.resize(totalIter, 0x1456u);
+	uint32_t frameCount = mSpatialFrameCount[iter]++;
+
+	// The shader reads and writes SpatialReservoirsOut in the same launch on iterations > 0.  To keep the
+	//     result deterministic across thread counts, read neighbors from a snapshot (mSpatialReservoirsIn).
+	if (iter != 0)
+	{
+		mSpatialReservoirsIn = mReservoirs[uint32_t(ReservoirStore::BufferId::SpatialReservoirsOut)];
+	}
+
+	dispatch([&](const uvec2& pixelIndex) { spatialReuseRayGen(pixelIndex, frameCount, iter, totalIter); });
+}
+
+void CpuReSTIRRenderer::executeShadeWithReservoirs()
+{
+	dispatch([&](const uvec2& pixelIndex) { shadeWithReservoirsRayGen(pixelIndex); });
+}
+
+Reservoir CpuReSTIRRenderer::loadReservoir(const std::vector<FullReservoir>& buffer, const uvec2& pixelIndex, uint32_t k) const
+{
+	tReservoirBytes += ReservoirStore::getReservoirSize(mReservoirFormat);
+	return unpackReservoir(buffer[reservoirIndex(pixelIndex, mScreenSize, k, mReservoirsPerPixel)]);
+}
+
+void CpuReSTIRRenderer::storeReservoir(ReservoirStore::BufferId id, const uvec2& pixelIndex, uint32_t k, const Reservoir& reservoir)
+{
+	tReservoirBytes += ReservoirStore::getReservoirSize(mReservoirFormat);
+	mReservoirs[uint32_t(id)][reservoirIndex(pixelIndex, mScreenSize, k, mReservoirsPerPixel)] = packReservoirBuffer(reservoir, mReservoirFormat);
+}
+
+void CpuReSTIRRenderer::copyReservoirs(ReservoirStore::BufferId dst, ReservoirStore::BufferId src, const uvec2& pixelIndex)
+{
+	// All of a pixel's reservoirs are adjacent
+	size_t first = reservoirIndex(pixelIndex, mScreenSize, 0, mReservoirsPerPixel);
+	std::copy_n(mReservoirs[uint32_t(src)].begin() + first, mReservoirsPerPixel, mReservoirs[uint32_t(dst)].begin() + first);
+	tReservoirBytes += 2 * mReservoirsPerPixel * ReservoirStore::getReservoirSize(mReservoirFormat);
+}
+
+GBuffer CpuReSTIRRenderer::loadGBuffer(const uvec2& pixelIndex, bool previousFrame) const
+{
+	GBuffer gBuffer;
+	gBuffer.pos = texel(previousFrame ? BufferId::PrevWorldPosition : BufferId::WorldPosition, pixelIndex);
+	gBuffer.norm = texel(previousFrame ? BufferId::PrevWorldNormal : BufferId::WorldNormal, pixelIndex);
+	gBuffer.color = texel(previousFrame ? BufferId::PrevMaterialDiffuse : BufferId::MaterialDiffuse, pixelIndex);
+	return gBuffer;
+}
+
+float CpuReSTIRRenderer::shadowRayVisibility(const vec3& origin, const vec3& direction, float minT, float maxT) const
+{
+	CpuScene::Ray ray = { origin, minT, direction, maxT };
+	tRayCount++;
+	return mpScene->occluded(ray) ? 0.f : 1.f;
+}
+
+vec3 CpuReSTIRRenderer::lambertianDirect(float u, const vec3& hit, const vec3& norm, const vec3& diffuseColor) const
+{
+	const std::vector<LightData>& lights = mpScene->getLights();
+	int lightsCount = int(lights.size());
+
+	// Pick a single random light to sample
+	int light = std::min(int(u * lightsCount), lightsCount - 1);
+
+	// Query scene to get information about current light
+	float dist;
+	vec3 lightIntensity;
+	vec3 lightDirection;
+	getLightData(lights[light], hit, lightDirection, lightIntensity, dist);
+
+	// Lambertian dot product
+	float cosTheta = saturate(glm::dot(norm, lightDirection));
+
+	// Shoot shadow ray
+	float shadow = shadowRayVisibility(hit, lightDirection, mSettings.minT, dist);
+
+	// Compute Lambertian shading color (divide by probability of light = 1.0 / N)
+	vec3 color = float(lightsCount) * shadow * cosTheta * lightIntensity;
+	color *= diffuseColor / float(M_PI);
+	color /= dist * dist;
+
+	return color;
+}
+
+uvec2 CpuReSTIRRenderer::getSpatialNeighborIndex(const uvec2& pixelIndex, const vec2& u) const
+{
+	const uvec2& dim = mScreenSize;
+	uint32_t radius = uint32_t(mSettings.spatialRadius);
+
+	// Calculate neighbor offset -> [0, 1] -> [0, 2 * NEIGHBOR_RADIUS] -> [-NEIGHBOR_RADIUS, NEIGHBOR_RADIUS].
+	//     As in the shader, this is unsigned math:  offsets past the left / top edge wrap and clamp to dim - 1.
+	uvec2 neighborOffset;
+	neighborOffset.x = uint32_t(int(u.x * 2 * radius)) - radius;
+	neighborOffset.y = uint32_t(int(u.y * 2 * radius)) - radius;
+
+	// Clamp index
+	uvec2 neighborIndex;
+	neighborIndex.x = std::min(pixelIndex.x + neighborOffset.x, dim.x - 1);
+	neighborIndex.y = std::min(pixelIndex.y + neighborOffset.y, dim.y - 1);
+	return neighborIndex;
+}
+
+CpuScene::Ray CpuReSTIRRenderer::getPrimaryRay(const uvec2& pixelIndex, const CameraData& camera) const
+{
+	// Convert pixel (x, y) into world-space ray direction
+	vec2 pixelLocation = vec2(pixelIndex) + vec2(0.5f, 0.5f);
+	vec2 pixelCenter = pixelLocation / vec2(mScreenSize);
+	vec2 ndc = vec2(2, -2) * pixelCenter + vec2(-1, 1);
+	vec3 rayDirection = (ndc.x * camera.cameraU +
+	                     ndc.y * camera.cameraV +
+	                             camera.cameraW);
+
+	CpuScene::Ray ray = { camera.posW, 0.0f, rayDirection, 1e+38f };
+	return ray;
+}
+
+void CpuReSTIRRenderer::storeGBuffer(const uvec2& pixelIndex, const CameraData& camera, const CpuScene::Hit* pHit)
+{
+	if (!pHit)
+	{
+		// If miss, store background color in diffuse texture
+		texel(BufferId::MaterialDiffuse, pixelIndex) = vec4(mSettings.bgColor, 1.0f);
+		return;
+	}
+
+	CpuScene::ShadingData shadeData = mpScene->getShadingData(*pHit);
+	texel(BufferId::WorldPosition, pixelIndex) = vec4(shadeData.posW, 1.f);
+	texel(BufferId::WorldNormal, pixelIndex) = vec4(shadeData.N, glm::length(shadeData.posW - camera.posW));
+	texel(BufferId::MaterialDiffuse, pixelIndex) = vec4(shadeData.diffuse, shadeData.opacity);
+
+	// Where the surface was last frame.  Our scene copy is static, so only the camera moves.
+	texel(BufferId::MotionVectors, pixelIndex) = computeMotionVector(pixelIndex, mScreenSize, shadeData.posW, mLastCameraMatrix, mLastCameraPos);
+}
+
+void CpuReSTIRRenderer::gBufferRayGen(const uvec2& quadIndex, const uvec2& tileEnd, const CameraData& camera)
+{
+	// Lane i covers pixel quadIndex + (i & 1, i >> 1).  Lanes past the tile edge are disabled.
+	CpuScene::RayPacket packet;
+	packet.activeMask = 0;
+	for (uint32_t lane = 0; lane < 4; lane++)
+	{
+		uvec2 pixelIndex = quadIndex + uvec2(lane & 1, lane >> 1);
+		packet.setRay(lane, getPrimaryRay(pixelIndex, camera));
+		if (pixelIndex.x < tileEnd.x && pixelIndex.y < tileEnd.y) packet.activeMask |= (1u << lane);
+	}
+
+	CpuScene::HitPacket hits;
+	uint32_t hitMask = mpScene->intersect4(packet, hits);
+	for (uint32_t lane = 0; lane < 4; lane++)
+	{
+		if (!(packet.activeMask & (1u << lane))) continue;
+
+		CpuScene::Hit hit;
+		if (hitMask & (1u << lane)) hit = hits.getHit(lane);
+		storeGBuffer(quadIndex + uvec2(lane & 1, lane >> 1), camera, (hitMask & (1u << lane)) ? &hit : nullptr);
+		tRayCount++;
+	}
+}
+
+CpuReSTIRRenderer::RayBenchmark CpuReSTIRRenderer::benchmarkRays(const CameraData& camera, uint32_t passes)
+{
+	RayBenchmark result;
+	const std::vector<LightData>& lights = mpScene->getLights();
+	if (mScreenSize.x == 0 || mScreenSize.y == 0) return result;
+
+	// Shadow rays start at the primary hits, so fill in the G-buffer first
+	executeGBuffer(camera);
+
+	auto measure = [&](const TiledDispatch::TileKernel& kernel)
+	{
+		mRayCount = 0;
+		CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+		for (uint32_t i = 0; i < passes; i++) dispatchTiles(kernel);
+		double ms = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+		return (ms > 0.0) ? float(double(mRayCount) / (ms * 1000.0)) : 0.f;
+	};
+
+	result.primaryMraysPerSec = measure([&](const uvec2& tileStart, const uvec2& tileEnd)
+	{
+		for (uint32_t y = tileStart.y; y < tileEnd.y; y++)
+		{
+			for (uint32_t x = tileStart.x; x < tileEnd.x; x++)
+			{
+				CpuScene::Hit hit;
+				mpScene->intersect(getPrimaryRay(uvec2(x, y), camera), hit);
+				tRayCount++;
+			}
+		}
+	});
+
+	result.primaryPacketMraysPerSec = measure([&](const uvec2& tileStart, const uvec2& tileEnd)
+	{
+		for (uint32_t y = tileStart.y; y < tileEnd.y; y += 2)
+		{
+			for (uint32_t x = tileStart.x; x < tileEnd.x; x += 2)
+			{
+				CpuScene::RayPacket packet;
+				packet.activeMask = 0;
+				for (uint32_t lane = 0; lane < 4; lane++)
+				{
+					uvec2 pixelIndex = uvec2(x + (lane & 1), y + (lane >> 1));
+					packet.setRay(lane, getPrimaryRay(pixelIndex, camera));
+					if (pixelIndex.x < tileEnd.x && pixelIndex.y < tileEnd.y)
+					{
+						packet.activeMask |= (1u << lane);
+						tRayCount++;
+					}
+				}
+				CpuScene::HitPacket hits;
+				mpScene->intersect4(packet, hits);
+			}
+		}
+	});
+
+	if (!lights.empty())
+	{
+		result.shadowMraysPerSec = measure([&](const uvec2& tileStart, const uvec2& tileEnd)
+		{
+			for (uint32_t y = tileStart.y; y < tileEnd.y; y++)
+			{
+				for (uint32_t x = tileStart.x; x < tileEnd.x; x++)
+				{
+					vec4 worldPos = texel(BufferId::WorldPosition, uvec2(x, y));
+					if (worldPos.w == 0) continue;
+
+					float dist;
+					vec3 lightIntensity;
+					vec3 lightDirection;
+					getLightData(lights[(x + y * mScreenSize.x) % lights.size()], vec3(worldPos), lightDirection, lightIntensity, dist);
+					shadowRayVisibility(vec3(worldPos), lightDirection, mSettings.minT, dist);
+				}
+			}
+		});
+	}
+
+	return result;
+}
+
+CpuReSTIRRenderer::LightSamplingBenchmark CpuReSTIRRenderer::benchmarkLightSampling(const CameraData& camera, uint32_t trials, uint32_t tableLightCount)
+{
+	LightSamplingBenchmark result;
+	LightAliasTable::BuildBenchmark build = LightAliasTable::benchmarkBuild(tableLightCount);
+	result.tableLightCount = build.lightCount;
+	result.tableBuildMs = build.buildMs;
+	result.tableMaxPdfError = build.maxPdfError;
+
+	const std::vector<LightData>& lights = mpScene->getLights();
+	int lightsCount = int(lights.size());
+	if (mScreenSize.x == 0 || mScreenSize.y == 0 || lightsCount == 0 || trials < 2) return result;
+
+	executeGBuffer(camera);
+	mpAliasTable->update(mpScene->getLightPowers());
+	mpLightBvh->update(lights, mpScene->getLightPowers());
+
+	// Relative variance (variance / mean^2) of p_hat(y) * W = wSum / M, the RIS estimate of sum(p_hat) over all lights,
+	//     for uniform (.x), alias table (.y) and light BVH (.z) candidates.  Negative where undefined.
+	std::vector<vec3> relVariance(size_t(mScreenSize.x) * mScreenSize.y, vec3(-1.f));
+	dispatch([&](const uvec2& pixelIndex)
+	{
+		if (pixelIndex.x % kBenchmarkPixelStride != 0 || pixelIndex.y % kBenchmarkPixelStride != 0) return;
+
+		GBuffer gBuffer = loadGBuffer(pixelIndex);
+		if (gBuffer.pos.w == 0) return;
+
+		uint32_t pixel = pixelIndex.x + mScreenSize.x * pixelIndex.y;
+		PixelSampler pixelSampler = createPixelSampler(mSettings.samplerType, pixelIndex.x, pixelIndex.y);
+		int candidates = std::min(lightsCount, mSettings.lightSamples);
+		for (int selection = 0; selection < 3; selection++)
+		{
+			double sum = 0.0, sumSq = 0.0;
+			for (uint32_t t = 0; t < trials; t++)
+			{
+				Reservoir reservoir;
+				for (int i = 0; i < candidates; i++)
+				{
+					float dist, p;
+					vec3 lightIntensity, lightDirection;
+					uint32_t candidateIndex = t * uint32_t(candidates) + uint32_t(i);
+					int light = sampleSceneLight(vec3(gBuffer.pos), vec3(gBuffer.norm), pixelSampler, candidateIndex, p, LightSelection(selection));
+					float p_hat = CpuReSTIR::evaluatePHat(gBuffer, lights, lightDirection, lightIntensity, dist, float(light));
+					updateReservoir(reservoir, float(light), (p > 0.f) ? p_hat / p : 0.f, pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE_RIS, candidateIndex, 0));
+				}
+				double estimate = (reservoir.M > 0.f) ? double(reservoir.wSum / reservoir.M) : 0.0;
+				sum += estimate;
+				sumSq += estimate * estimate;
+			}
+
+			double mean = sum / trials;
+			double variance = std::max(0.0, sumSq / trials - mean * mean);
+			if (mean > 0.0) relVariance[pixel][selection] = float(variance / (mean * mean));
+		}
+	});
+
+	double uniformSum = 0.0, aliasSum = 0.0, bvhSum = 0.0;
+	for (const vec3& v : relVariance)
+	{
+		if (v.x < 0.f || v.y < 0.f || v.z < 0.f) continue;
+		uniformSum += v.x;
+		aliasSum += v.y;
+		bvhSum += v.z;
+		result.pixels++;
+	}
+	if (result.pixels > 0)
+	{
+		result.uniformVariance = float(uniformSum / result.pixels);
+		result.aliasVariance = float(aliasSum / result.pixels);
+		result.bvhVariance = float(bvhSum / result.pixels);
+		result.aliasVarianceReduction = (aliasSum > 0.0) ? float(uniformSum / aliasSum) : 0.f;
+		result.bvhVarianceReduction = (bvhSum > 0.0) ? float(uniformSum / bvhSum) : 0.f;
+	}
+	return result;
+}
+
+std::vector<vec3> CpuReSTIRRenderer::computeDirectReference(const CameraData& camera)
+{
+	const std::vector<LightData>& lights = mpScene->getLights();
+
+	// What shadeWithReservoirs.hlsl computes for one light, summed over all lights
+	executeGBuffer(camera);
+	std::vector<vec3> reference(size_t(mScreenSize.x) * mScreenSize.y, vec3(0.f));
+	dispatch([&](const uvec2& pixelIndex)
+	{
+		GBuffer gBuffer = loadGBuffer(pixelIndex);
+		if (gBuffer.pos.w == 0) return;
+
+		vec3 sum = vec3(0.f);
+		for (const LightData& light : lights)
+		{
+			float dist;
+			vec3 lightIntensity, lightDirection;
+			getLightData(light, vec3(gBuffer.pos), lightDirection, lightIntensity, dist);
+			float cosTheta = saturate(glm::dot(vec3(gBuffer.norm), lightDirection));
+			if (cosTheta <= 0.f) continue;
+			float shadow = shadowRayVisibility(vec3(gBuffer.pos), lightDirection, mSettings.minT, dist);
+			sum += shadow * cosTheta * lightIntensity * vec3(gBuffer.color) / float(M_PI) / (dist * dist);
+		}
+		reference[pixelIndex.x + mScreenSize.x * pixelIndex.y] = sum;
+	});
+	return reference;
+}
+
+void CpuReSTIRRenderer::measureFrames(const CameraData& camera, uint32_t frames, const std::vector<vec3>& reference, float& bytesPerPixel, float& msPerFrame, float& error)
+{
+	double referenceSq = 0.0;
+	for (const vec3& c : reference) referenceSq += glm::dot(c, c);
+
+	// Start without history, from the frame counters we were given
+	resize(mScreenSize);
+
+	double bytes = 0.0, ms = 0.0, errorSum = 0.0;
+	for (uint32_t f = 0; f < frames; f++)
+	{
+		CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+		renderFrame(camera);
+		ms += CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+		bytes += double(mFrameReservoirBytes);
+
+		// Background pixels show the albedo in both, so only geometry counts
+		const std::vector<vec4>& shaded = getBuffer(BufferId::ShadedOutput);
+		double errorSq = 0.0;
+		for (size_t i = 0; i < shaded.size(); i++)
+		{
+			if (mBuffers[uint32_t(BufferId::WorldPosition)][i].w == 0) continue;
+			vec3 diff = vec3(shaded[i]) - reference[i];
+			errorSq += glm::dot(diff, diff);
+		}
+		errorSum += (referenceSq > 0.0) ? std::sqrt(errorSq / referenceSq) : 0.0;
+	}
+
+	double pixels = double(mScreenSize.x) * mScreenSize.y;
+	bytesPerPixel = float(bytes / (pixels * frames));
+	msPerFrame = float(ms / frames);
+	error = float(errorSum / frames);
+}
+
+CpuReSTIRRenderer::ReservoirBenchmark CpuReSTIRRenderer::benchmarkReservoirs(const CameraData& camera, uint32_t reservoirsPerPixel, uint32_t frames)
+{
+	ReservoirBenchmark result;
+	result.reservoirsPerPixel = glm::clamp(reservoirsPerPixel, 1u, ReservoirStore::kMaxReservoirsPerPixel);
+	result.frames = std::max(1u, frames);
+	if (mScreenSize.x == 0 || mScreenSize.y == 0 || mpScene->getLights().empty()) return result;
+
+	std::vector<vec3> reference = computeDirectReference(camera);
+
+	// Both runs start from the same frame counters, so reservoir k = 0 sees the same random numbers in each
+	uint32_t savedReservoirsPerPixel = mSettings.reservoirsPerPixel;
+	uint32_t createFrameCount = mCreateFrameCount;
+	std::vector<uint32_t> spatialFrameCount = mSpatialFrameCount;
+	auto measure = [&](uint32_t count, float& bytesPerPixel, float& msPerFrame, float& error)
+	{
+		mSettings.reservoirsPerPixel = count;
+		mCreateFrameCount = createFrameCount;
+		mSpatialFrameCount = spatialFrameCount;
+		measureFrames(camera, result.frames, reference, bytesPerPixel, msPerFrame, error);
+	};
+
+	measure(1, result.baseBytesPerPixel, result.baseMsPerFrame, result.baseError);
+	measure(result.reservoirsPerPixel, result.bytesPerPixel, result.msPerFrame, result.error);
+
+	mSettings.reservoirsPerPixel = savedReservoirsPerPixel;
+	resize(mScreenSize);
+	return result;
+}
+
+CpuReSTIRRenderer::ReservoirEncodingBenchmark CpuReSTIRRenderer::benchmarkReservoirEncoding(const CameraData& camera, uint32_t frames, uint32_t samples)
+{
+	ReservoirEncodingBenchmark result;
+	result.frames = std::max(1u, frames);
+
+	// Round trip:  light IDs over the full 32 bits, M up to the largest half, W log-uniform over the compact format's range
+	uint32_t randSeed = initRand(samples, 0x1456u, 16);
+	for (uint32_t i = 0; i < samples; i++)
+	{
+		float M = std::floor(std::exp2(nextRand(randSeed) * 15.99f));
+		float W = std::exp2(-30.f + 62.99f * nextRand(randSeed));
+		uint32_t lightId = (uint32_t(nextRand(randSeed) * 65536.f) << 16) | uint32_t(nextRand(randSeed) * 65536.f);
+
+		CompactReservoir packed = encodeCompactReservoir(lightId, M, W);
+		if (packed.lightId != lightId) result.lightIdErrors++;
+		result.maxMError = std::max(result.maxMError, std::abs(compactReservoirM(packed) - M) / M);
+		result.maxWError = std::max(result.maxWError, std::abs(compactReservoirW(packed) - W) / W);
+		result.samples++;
+	}
+
+	if (mScreenSize.x == 0 || mScreenSize.y == 0 || mpScene->getLights().empty()) return result;
+
+	// Render with each format from the same frame counters, and compare both against the same reference
+	std::vector<vec3> reference = computeDirectReference(camera);
+	ReservoirStore::Format savedFormat = mSettings.reservoirFormat;
+	uint32_t createFrameCount = mCreateFrameCount;
+	std::vector<uint32_t> spatialFrameCount = mSpatialFrameCount;
+	auto measure = [&](ReservoirStore::Format format, float& mbPerFrame, float& msPerFrame, float& error)
+	{
+		mSettings.reservoirFormat = format;
+		mCreateFrameCount = createFrameCount;
+		mSpatialFrameCount = spatialFrameCount;
+		float bytesPerPixel;
+		measureFrames(camera, result.frames, reference, bytesPerPixel, msPerFrame, error);
+		mbPerFrame = bytesPerPixel * 1920.f * 1080.f / (1024.f * 1024.f);
+	};
+
+	measure(ReservoirStore::Format::Full, result.fullMBPerFrame, result.fullMsPerFrame, result.fullError);
+	measure(ReservoirStore::Format::Compact, result.compactMBPerFrame, result.compactMsPerFrame, result.compactError);
+
+	mSettings.reservoirFormat = savedFormat;
+	resize(mScreenSize);
+	return result;
+}
+
+CpuReSTIRRenderer::BiasBenchmark CpuReSTIRRenderer::benchmarkBias(const CameraData& camera, uint32_t frames)
+{
+	BiasBenchmark result;
+	result.frames = std::max(1u, frames);
+	if (mScreenSize.x == 0 || mScreenSize.y == 0 || mpScene->getLights().empty()) return result;
+
+	// Background pixels show the albedo in every frame, so only geometry counts
+	std::vector<vec3> reference = computeDirectReference(camera);
+	std::vector<bool> geometry(reference.size());
+	double referenceSum = 0.0, referenceSq = 0.0;
+	for (size_t i = 0; i < reference.size(); i++)
+	{
+		geometry[i] = (mBuffers[uint32_t(BufferId::WorldPosition)][i].w != 0);
+		if (!geometry[i]) continue;
+		referenceSum += double(reference[i].x) + reference[i].y + reference[i].z;
+		referenceSq += glm::dot(reference[i], reference[i]);
+	}
+
+	// Every mode starts without history, from the same frame counters
+	bool savedUnbiased = mSettings.unbiased, savedVisibility = mSettings.unbiasedVisibility;
+	uint32_t createFrameCount = mCreateFrameCount;
+	std::vector<uint32_t> spatialFrameCount = mSpatialFrameCount;
+	auto measure = [&](bool unbiased, bool visibility, float& msPerFrame, float& bias, float& error)
+	{
+		mSettings.unbiased = unbiased;
+		mSettings.unbiasedVisibility = visibility;
+		mCreateFrameCount = createFrameCount;
+		mSpatialFrameCount = spatialFrameCount;
+		resize(mScreenSize);
+
+		std::vector<dvec3> sum(reference.size(), dvec3(0.0));
+		double ms = 0.0;
+		for (uint32_t f = 0; f < result.frames; f++)
+		{
+			CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+			renderFrame(camera);
+			ms += CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+
+			const std::vector<vec4>& shaded = getBuffer(BufferId::ShadedOutput);
+			for (size_t i = 0; i < shaded.size(); i++) sum[i] += dvec3(vec3(shaded[i]));
+		}
+
+		double meanSum = 0.0, errorSq = 0.0;
+		for (size_t i = 0; i < sum.size(); i++)
+		{
+			if (!geometry[i]) continue;
+			dvec3 mean = sum[i] / double(result.frames);
+			dvec3 diff = mean - dvec3(reference[i]);
+			meanSum += mean.x + mean.y + mean.z;
+			errorSq += glm::dot(diff, diff);
+		}
+		msPerFrame = float(ms / result.frames);
+		bias = (referenceSum > 0.0) ? float(meanSum / referenceSum - 1.0) : 0.f;
+		error = (referenceSq > 0.0) ? float(std::sqrt(errorSq / referenceSq)) : 0.f;
+	};
+
+	measure(false, false, result.biasedMsPerFrame, result.biasedBias, result.biasedError);
+	measure(true, false, result.unbiasedMsPerFrame, result.unbiasedBias, result.unbiasedError);
+	measure(true, true, result.visibilityMsPerFrame, result.visibilityBias, result.visibilityError);
+
+	mSettings.unbiased = savedUnbiased;
+	mSettings.unbiasedVisibility = savedVisibility;
+	resize(mScreenSize);
+	return result;
+}
+
+CpuReSTIRRenderer::AdaptiveSamplingBenchmark CpuReSTIRRenderer::benchmarkAdaptiveSampling(const CameraData& camera, float targetError, uint32_t maxFrames)
+{
+	AdaptiveSamplingBenchmark result;
+	result.targetError = targetError;
+	if (mScreenSize.x == 0 || mScreenSize.y == 0 || mpScene->getLights().empty() || !(targetError > 0.f)) return result;
+
+	// Background pixels show the albedo, so only geometry counts
+	std::vector<vec3> reference = computeDirectReference(camera);
+	const std::vector<vec4>& position = getBuffer(BufferId::WorldPosition);
+	double referenceSq = 0.0;
+	for (size_t i = 0; i < reference.size(); i++)
+	{
+		if (position[i].w == 0) continue;
+		referenceSq += glm::dot(reference[i], reference[i]);
+		result.pixels++;
+	}
+	if (referenceSq == 0.0) return result;
+
+	CpuAdaptiveSampler::SharedPtr pSampler = CpuAdaptiveSampler::create(mpDispatch);
+	pSampler->resize(mScreenSize);
+	auto measure = [&](bool adaptive, uint32_t& frames, float& ms, float& samplesPerPixel, float& error)
+	{
+		pSampler->getSettings().adaptive = adaptive;
+		pSampler->getSettings().errorThreshold = targetError;
+		pSampler->reset();
+
+		std::vector<vec4> frame(reference.size());
+		double time = 0.0;
+		error = 1.f;
+		for (frames = 0; frames < maxFrames && error > targetError && !(adaptive && pSampler->isConverged()); frames++)
+		{
+			// What fullGI.hlsl's ray generation does with direct lighting only, taking the budgeted samples
+			CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+			const std::vector<uint32_t>& sampleCounts = pSampler->getSampleCounts();
+			const std::vector<vec4>& statistics = pSampler->getStatistics();
+			dispatch([&](const uvec2& pixelIndex)
+			{
+				size_t i = pixelIndex.x + size_t(mScreenSize.x) * pixelIndex.y;
+				GBuffer gBuffer = loadGBuffer(pixelIndex);
+				if (gBuffer.pos.w == 0)
+				{
+					frame[i] = vec4(vec3(gBuffer.color), 1.f);
+					return;
+				}
+
+				// As fullGI.hlsl:  the pixel's samples continue where its accumulated ones left off
+				PixelSampler pixelSampler = createPixelSampler(mSettings.samplerType, pixelIndex.x, pixelIndex.y);
+				uint32_t firstSample = uint32_t(statistics[i].x);
+				uint32_t count = sampleCounts[i];
+				vec3 sum = vec3(0.f);
+				for (uint32_t s = 0; s < count; s++)
+				{
+					float u = pixelSample(pixelSampler, SAMPLE_DOMAIN_DIRECT_LIGHT, firstSample + s, 0);
+					sum += lambertianDirect(u, vec3(gBuffer.pos), vec3(gBuffer.norm), vec3(gBuffer.color));
+				}
+				frame[i] = vec4(sum / float(std::max(count, 1u)), float(count));
+			});
+			pSampler->accumulate(frame);
+			time += CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+
+			const std::vector<vec4>& accumulated = pSampler->getAccumulated();
+			double errorSq = 0.0;
+			for (size_t i = 0; i < accumulated.size(); i++)
+			{
+				if (position[i].w == 0) continue;
+				vec3 diff = vec3(accumulated[i]) - reference[i];
+				errorSq += glm::dot(diff, diff);
+			}
+			error = float(std::sqrt(errorSq / referenceSq));
+		}
+
+		ms = float(time);
+		samplesPerPixel = float(double(pSampler->getSampleTotal()) / double(pSampler->getSampleCounts().size()));
+	};
+
+	measure(false, result.uniformFrames, result.uniformMs, result.uniformSamplesPerPixel, result.uniformError);
+	measure(true, result.adaptiveFrames, result.adaptiveMs, result.adaptiveSamplesPerPixel, result.adaptiveError);
+	result.convergedPixels = pSampler->getConvergedCount();
+	result.speedup = (result.adaptiveMs > 0.f) ? result.uniformMs / result.adaptiveMs : 0.f;
+	return result;
+}
+
+CpuReSTIRRenderer::ReprojectionValidation CpuReSTIRRenderer::validateReprojection(const std::vector<CameraData>& cameras)
+{
+	ReprojectionValidation result;
+	if (mScreenSize.x == 0 || mScreenSize.y == 0 || cameras.size() < 2) return result;
+
+	// What each pixel's reprojection got right, filled in in parallel and summed afterwards
+	enum : uint8_t { kGeometry = 1, kVisible = 2, kAccepted = 4, kCameraOnlyAccepted = 8 };
+	std::vector<uint8_t> flags(size_t(mScreenSize.x) * mScreenSize.y);
+	std::vector<float> motionError(flags.size()), positionError(flags.size()), cameraOnlyError(flags.size());
+
+	double motionErrorSum = 0.0, positionErrorSum = 0.0, cameraOnlyErrorSum = 0.0;
+	resize(mScreenSize);
+	executeGBuffer(cameras[0]);
+	for (size_t f = 1; f < cameras.size(); f++)
+	{
+		const CameraData& prevCamera = cameras[f - 1];
+		mat3 prevBasisInv = glm::inverse(mat3(prevCamera.cameraU, prevCamera.cameraV, prevCamera.cameraW));
+		executeGBuffer(cameras[f]);
+
+		const std::vector<vec4>& prevPos = getBuffer(BufferId::PrevWorldPosition);
+		const std::vector<vec4>& prevNorm = getBuffer(BufferId::PrevWorldNormal);
+		dispatch([&](const uvec2& pixelIndex)
+		{
+			size_t i = pixelIndex.x + size_t(mScreenSize.x) * pixelIndex.y;
+			flags[i] = 0;
+			GBuffer gBuffer = loadGBuffer(pixelIndex);
+			if (gBuffer.pos.w == 0) return;
+			flags[i] |= kGeometry;
+
+			// Ground truth:  invert getPrimaryRay() for last frame's camera, then check nothing was in the way
+			vec3 posW = vec3(gBuffer.pos);
+			vec3 toPos = posW - prevCamera.posW;
+			vec3 uvw = prevBasisInv * toPos;
+			vec2 truePixel = vec2(((uvw.x / uvw.z) + 1.f) * 0.5f * float(mScreenSize.x), (1.f - (uvw.y / uvw.z)) * 0.5f * float(mScreenSize.y));
+			bool onScreen = uvw.z > 0.f && truePixel.x >= 0.f && truePixel.y >= 0.f && truePixel.x < float(mScreenSize.x) && truePixel.y < float(mScreenSize.y);
+			float dist = glm::length(toPos);
+			if (onScreen && dist > 0.f && shadowRayVisibility(prevCamera.posW, toPos / dist, 0.f, dist * 0.999f) > 0.f) flags[i] |= kVisible;
+
+			// What the passes do
+			const vec4& motion = texel(BufferId::MotionVectors, pixelIndex);
+			uvec2 prevIndex;
+			if (reprojectPixel(pixelIndex, mScreenSize, motion, vec3(gBuffer.norm), prevNorm, prevIndex))
+			{
+				flags[i] |= kAccepted;
+				positionError[i] = glm::length(vec3(prevPos[prevIndex.y * mScreenSize.x + prevIndex.x]) - posW) / std::max(gBuffer.norm.w, 1e-6f);
+			}
+			if (flags[i] & kVisible) motionError[i] = glm::length(vec2(pixelIndex) + 0.5f + vec2(motion) - truePixel);
+
+			// What we did before motion vectors:  project with last frame's view-projection matrix, and take whatever is there
+			vec4 prevScreenPos = prevCamera.viewProjMat * vec4(posW, 1.f);
+			vec2 cameraOnlyPixel = vec2(((prevScreenPos.x / prevScreenPos.w) + 1.f) * 0.5f * float(mScreenSize.x), (1.f - (prevScreenPos.y / prevScreenPos.w)) * 0.5f * float(mScreenSize.y));
+			if (cameraOnlyPixel.x >= 0.f && cameraOnlyPixel.y >= 0.f && cameraOnlyPixel.x < float(mScreenSize.x) && cameraOnlyPixel.y < float(mScreenSize.y))
+			{
+				uvec2 cameraOnlyIndex = glm::min(uvec2(cameraOnlyPixel), mScreenSize - 1u);
+				flags[i] |= kCameraOnlyAccepted;
+				cameraOnlyError[i] = glm::length(vec3(prevPos[cameraOnlyIndex.y * mScreenSize.x + cameraOnlyIndex.x]) - posW) / std::max(gBuffer.norm.w, 1e-6f);
+			}
+		});
+
+		for (size_t i = 0; i < flags.size(); i++)
+		{
+			if (!(flags[i] & kGeometry)) continue;
+			bool visible = (flags[i] & kVisible) != 0, accepted = (flags[i] & kAccepted) != 0, cameraOnly = (flags[i] & kCameraOnlyAccepted) != 0;
+			result.pixels++;
+			result.visible += visible;
+			result.accepted += accepted;
+			result.falseAccepts += accepted && !visible;
+			result.falseRejects += !accepted && visible;
+			result.cameraOnlyAccepted += cameraOnly;
+			result.cameraOnlyFalseAccepts += cameraOnly && !visible;
+			if (visible) motionErrorSum += motionError[i];
+			if (accepted) positionErrorSum += positionError[i];
+			if (cameraOnly) cameraOnlyErrorSum += cameraOnlyError[i];
+		}
+		result.frames++;
+	}
+
+	if (result.visible) result.meanMotionError = float(motionErrorSum / result.visible);
+	if (result.accepted) result.meanPositionError = float(positionErrorSum / result.accepted);
+	if (result.cameraOnlyAccepted) result.cameraOnlyPositionError = float(cameraOnlyErrorSum / result.cameraOnlyAccepted);
+
+	resize(mScreenSize);
+	return result;
+}
+
+int CpuReSTIRRenderer::sampleSceneLight(const vec3& posW, const vec3& normal, const PixelSampler& pixelSampler, uint32_t index, float& p, LightSelection selection) const
+{
+	int lightsCount = int(mpScene->getLightCount());
+
+	// The table and BVH may lag behind the scene if its lights were never refreshed; fall back to uniform then
+	if (selection == LightSelection::Bvh && mpLightBvh->getLightCount() == uint32_t(lightsCount))
+	{
+		uint32_t level = 0;
+		return int(mpLightBvh->sample(posW, normal, [&]() { return pixelSample(pixelSampler, SAMPLE_DOMAIN_LIGHT_TREE + level++, index, 0); }, p));
+	}
+
+	int light = std::min(int(pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE, index, 0) * lightsCount), lightsCount - 1);
+	p = 1.f / float(lightsCount);
+
+	if (selection == LightSelection::AliasTable && mpAliasTable->getLightCount() == uint32_t(lightsCount))
+	{
+		const LightAliasTable::Entry& entry = mpAliasTable->getEntries()[light];
+		if (pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE_ALIAS, index, 0) >= entry.prob) light = int(entry.alias);
+		p = mpAliasTable->getEntries()[light].pdf;
+	}
+	return light;
+}
+
+int CpuReSTIRRenderer::sampleSourceLight(const vec3& posW, const vec3& normal, const PixelSampler& pixelSampler, uint32_t index, float& p, LightSelection selection) const
+{
+	// Same mixture as createLightSamples.hlsl:  a point on an emissive triangle (as id EMISSIVE_ID_BASE + point), a cell
+	//     of the environment map (as id lightsCount + cell) or one of the scene's lights
+	vec2 u = vec2(pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE, index, 0), pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE, index, 1));
+	float emissiveProb = emissiveCandidateProb();
+	if (emissiveProb > 0.f && pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE_EMISSIVE, index, 0) < emissiveProb)
+	{
+		uint32_t triangle = mpEmissiveLights->sampleTriangle(u.x, pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE_ALIAS, index, 0), p);
+		uint32_t pointsPerTriangle = mpEmissiveLights->getPointsPerTriangle();
+		uint32_t point = std::min(uint32_t(u.y * float(pointsPerTriangle)), pointsPerTriangle - 1);
+		p *= emissiveProb / float(pointsPerTriangle);
+		return int(EMISSIVE_ID_BASE + triangle * pointsPerTriangle + point);
+	}
+
+	float envProb = envCandidateProb();
+	if (envProb > 0.f && pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE_ENV, index, 0) < envProb)
+	{
+		uint32_t cell = mpEnvSampler->sample(u.x, u.y, p);
+		p *= envProb * (1.f - emissiveProb);
+		return int(mpScene->getLightCount() + cell);
+	}
+
+	int light = sampleSceneLight(posW, normal, pixelSampler, index, p, selection);
+	p *= (1.f - envProb) * (1.f - emissiveProb);
+	return light;
+}
+
+float CpuReSTIRRenderer::envCandidateProb() const
+{
+	// As envMapSampling.hlsli sees it:  EnvMapSampler::setIntoVars() binds an empty grid unless the sampler is active
+	if (!mpEnvSampler->isActive()) return 0.f;
+	return (mpScene->getLightCount() > 0) ? mpEnvSampler->getCandidateFraction() : 1.f;
+}
+
+float CpuReSTIRRenderer::emissiveCandidateProb() const
+{
+	// As emissiveLights.hlsli sees it:  EmissiveLights::setIntoVars() binds no triangles unless they're active
+	if (!mpEmissiveLights->isActive()) return 0.f;
+	return (mpScene->getLightCount() > 0 || mpEnvSampler->isActive()) ? mpEmissiveLights->getCandidateFraction() : 1.f;
+}
+
+void CpuReSTIRRenderer::getEnvCellData(uint32_t cell, vec3& toLight, vec3& lightIntensity, float& distToLight) const
+{
+	// Same as getEnvCellData() in envMapSampling.hlsli.  Cells of an older grid deliver nothing.
+	toLight = mpEnvSampler->getCellDirection(cell);
+	distToLight = kEnvLightDistance;
+	if (!mpEnvSampler->isActive() || cell >= mpEnvSampler->getCellCount())
+	{
+		lightIntensity = vec3(0.f);
+		return;
+	}
+
+	const vec4& cellData = mpEnvSampler->getCells()[cell];
+	lightIntensity = vec3(cellData) * cellData.a * (distToLight * distToLight);
+}
+
+void CpuReSTIRRenderer::getEmissivePointData(uint32_t pointId, const vec3& hitPos, vec3& toLight, vec3& lightIntensity, float& distToLight) const
+{
+	// Same as getEmissivePointData() in emissiveLights.hlsli.  Points past the current triangles deliver nothing.
+	uint32_t pointsPerTriangle = std::max(mpEmissiveLights->getPointsPerTriangle(), 1u);
+	uint32_t triIndex = pointId / pointsPerTriangle;
+	if (!mpEmissiveLights->isActive() || triIndex >= mpEmissiveLights->getTriangleCount())
+	{
+		toLight = vec3(0.f, 1.f, 0.f);
+		lightIntensity = vec3(0.f);
+		distToLight = 1.f;
+		return;
+	}
+
+	const EmissiveTriangle& tri = mpEmissiveLights->getTriangles()[triIndex];
+	vec3 toPoint = mpEmissiveLights->getPointPosition(pointId) - hitPos;
+	float dist = glm::length(toPoint);
+	toLight = (dist > 0.f) ? toPoint / dist : vec3(0.f, 1.f, 0.f);
+	distToLight = dist * (1.f - kEmissiveShadowOffset);
+
+	vec3 N = glm::normalize(glm::cross(tri.edge1, tri.edge2));
+	float cosLight = glm::dot(N, -toLight);
+	cosLight = (((tri.radianceB >> 16) & EMISSIVE_FLAG_TWO_SIDED) != 0) ? std::abs(cosLight) : std::max(cosLight, 0.f);
+
+	// lightIntensity / distToLight^2 is then radiance * area / points * cosLight / dist^2
+	float shorten = 1.f - kEmissiveShadowOffset;
+	lightIntensity = mpEmissiveLights->getRadiance(triIndex) * (tri.area / float(pointsPerTriangle)) * cosLight * (shorten * shorten);
+}
+
+void CpuReSTIRRenderer::getCandidateLightData(int light, const vec3& hitPos, vec3& toLight, vec3& lightIntensity, float& distToLight) const
+{
+	// Same as getCandidateLightData() in restirUtils.hlsli:  one of the scene's lights, past them a cell of the environment
+	//     map, or from EMISSIVE_ID_BASE on a point on an emissive triangle
+	uint32_t lightsCount = uint32_t(mpScene->getLightCount());
+	if (uint32_t(light) >= EMISSIVE_ID_BASE)
+	{
+		getEmissivePointData(uint32_t(light) - EMISSIVE_ID_BASE, hitPos, toLight, lightIntensity, distToLight);
+	}
+	else if (uint32_t(light) >= lightsCount)
+	{
+		getEnvCellData(uint32_t(light) - lightsCount, toLight, lightIntensity, distToLight);
+	}
+	else
+	{
+		getLightData(mpScene->getLights()[light], hitPos, toLight, lightIntensity, distToLight);
+	}
+}
+
+float CpuReSTIRRenderer::evaluatePHat(const GBuffer& gBuffer, vec3& lightDirection, vec3& lightIntensity, float& dist, float light) const
+{
+	// Calculate p_hat(r.y) for reservoir's light sample
+	getCandidateLightData(int(light), vec3(gBuffer.pos), lightDirection, lightIntensity, dist);
+	float cosTheta = saturate(glm::dot(vec3(gBuffer.norm), lightDirection));
+	return evaluateBSDF(vec3(gBuffer.color), lightIntensity, cosTheta, dist);
+}
+
+void CpuReSTIRRenderer::createLightSamplesRayGen(const uvec2& pixelIndex, uint32_t frameCount)
+{
+	const uvec2& dim = mScreenSize;
+	const std::vector<LightData>& lights = mpScene->getLights();
+	int lightsCount = int(lights.size());
+
+	// Read G-buffer data
+	GBuffer gBuffer = loadGBuffer(pixelIndex);
+	vec3 albedo = vec3(gBuffer.color);
+
+	// Each frame draws the next points of the pixel's sequences (see SampleSequences.h)
+	PixelSampler pixelSampler = createPixelSampler(mSettings.samplerType, pixelIndex.x, pixelIndex.y);
+
+	vec3 shadeColor = vec3(0.f, 0.f, 0.f);
+	if (gBuffer.pos.w == 0)
+	{
+		shadeColor = albedo;
+	}
+	else if (!mSettings.enableWeightedRIS && lightsCount > 0)
+	{
+		shadeColor += lambertianDirect(pixelSample(pixelSampler, SAMPLE_DOMAIN_DIRECT_LIGHT, frameCount, 0), vec3(gBuffer.pos), vec3(gBuffer.norm), vec3(gBuffer.color));
+	}
+
+	texel(BufferId::CurrReservoirs, pixelIndex) = vec4(shadeColor, 1.f);
+	if (!mSettings.enableWeightedRIS) return;
+
+	// Follow the motion vector into last frame, unless it saw a different surface there
+	uvec2 prevIndex;
+	reprojectPixel(pixelIndex, dim, texel(BufferId::MotionVectors, pixelIndex), vec3(gBuffer.norm), getBuffer(BufferId::PrevWorldNormal), prevIndex);
+
+	// Each of our reservoirs goes through RIS, visibility reuse and temporal reuse on its own
+	for (uint32_t k = 0; k < mReservoirsPerPixel; k++)
+	{
+		Reservoir reservoir;
+		uint32_t reservoirFrame = frameCount * mReservoirsPerPixel + k;
+		if (gBuffer.pos.w != 0 && hasCandidateSources())
+		{
+			// To hold information about current light
+			float dist = 0.f;
+			vec3 lightIntensity;
+			vec3 lightDirection;
+
+			float cosTheta = 0.f;
+			float p_hat = 0.f;
+
+			// 1. WEIGHTED RIS: Generate initial candidate light samples (M = 32)
+			int candidates = (mpEnvSampler->isActive() || mpEmissiveLights->isActive()) ? mSettings.lightSamples : std::min(lightsCount, mSettings.lightSamples);
+			for (int i = 0; i < candidates; i++) {
+				// Randomly pick a light to sample
+				float p;
+				uint32_t candidateIndex = reservoirFrame * uint32_t(mSettings.lightSamples) + uint32_t(i);
+				int light = sampleSourceLight(vec3(gBuffer.pos), vec3(gBuffer.norm), pixelSampler, candidateIndex, p, mSettings.lightSelection);
+				getCandidateLightData(light, vec3(gBuffer.pos), lightDirection, lightIntensity, dist);
+
+				// Calcuate light weight based on BRDF and PDF
+				cosTheta = saturate(glm::dot(vec3(gBuffer.norm), lightDirection));
+
+				// Evaluate p_hat
+				p_hat = evaluateBSDF(vec3(gBuffer.color), lightIntensity, cosTheta, dist);
+				updateReservoir(reservoir, float(light), (p > 0.f) ? p_hat / p : 0.f, pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE_RIS, candidateIndex, 0));
+			}
+
+			// Calculate p_hat(r.y) for reservoir's light
+			p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, reservoir.y);
+
+			// Update reservoir weight
+			if (p_hat == 0.f) {
+				reservoir.W = 0.f;
+			}
+			else {
+				reservoir.W = (1.f / p_hat) * (reservoir.wSum / reservoir.M);
+			}
+
+			// 2. VISIBILITY REUSE: Evaluate visibility for initial candidates
+			float shadowed = shadowRayVisibility(vec3(gBuffer.pos), lightDirection, mSettings.minT, dist);
+			if (shadowed <= 0.001f) {
+				reservoir.W = 0.f;
+			}
+
+			// 3. TEMPORAL REUSE
+			if (mSettings.doTemporalReuse)
+			{
+				Reservoir tempReservoir;
+
+				// Get previous reservoir
+				Reservoir prev_reservoir;
+				if (prevIndex.x != uint32_t(-1) && prevIndex.y != uint32_t(-1)) {
+					prev_reservoir = loadReservoir(mReservoirs[uint32_t(ReservoirStore::BufferId::PrevReservoirs)], prevIndex, k);
+				}
+
+				// Add current reservoir
+				updateReservoir(tempReservoir, reservoir.y, p_hat * reservoir.W * reservoir.M, pixelSample(pixelSampler, SAMPLE_DOMAIN_TEMPORAL_RIS, 2 * reservoirFrame, 0));
+
+				// Add previous reservoir
+				p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, prev_reservoir.y);
+				prev_reservoir.M = std::min(20.f * reservoir.M, prev_reservoir.M);
+				updateReservoir(tempReservoir, prev_reservoir.y, p_hat * prev_reservoir.W * prev_reservoir.M, pixelSample(pixelSampler, SAMPLE_DOMAIN_TEMPORAL_RIS, 2 * reservoirFrame + 1, 0));
+
+				// Update M
+				tempReservoir.M = reservoir.M + prev_reservoir.M;
+
+				// Set weight
+				p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, tempReservoir.y);
+
+				if (p_hat == 0.f) {
+					tempReservoir.W = 0.f;
+				}
+				else if (!mSettings.unbiased) {
+					tempReservoir.W = (1.f / p_hat) * (tempReservoir.wSum / tempReservoir.M);
+				}
+				else {
+					// Only count the samples of pixels that could have produced tempReservoir.y.  Ours can (p_hat > 0);
+					//     last frame's pixel is judged by last frame's G-buffer, as its samples were drawn there.
+					float Z = reservoir.M;
+					if (prevIndex.x != uint32_t(-1) && prevIndex.y != uint32_t(-1)) {
+						GBuffer prevGBuffer = loadGBuffer(prevIndex, true);
+
+						vec3 prevLightDirection;
+						vec3 prevLightIntensity;
+						float prevDist = 0.f;
+						float prev_p_hat = evaluatePHat(prevGBuffer, prevLightDirection, prevLightIntensity, prevDist, tempReservoir.y);
+						if (prev_p_hat > 0.f && mSettings.unbiasedVisibility) {
+							prev_p_hat *= shadowRayVisibility(vec3(prevGBuffer.pos), prevLightDirection, mSettings.minT, prevDist);
+						}
+						if (prev_p_hat > 0.f) {
+							Z += prev_reservoir.M;
+						}
+					}
+					tempReservoir.W = (Z > 0.f) ? (1.f / p_hat) * (tempReservoir.wSum / Z) : 0.f;
+				}
+				reservoir = tempReservoir;
+			}
+		}
+
+		storeReservoir(ReservoirStore::BufferId::CurrReservoirs, pixelIndex, k, reservoir);
+	}
+}
+
+void CpuReSTIRRenderer::spatialReuseRayGen(const uvec2& pixelIndex, uint32_t frameCount, uint32_t iter, uint32_t totalIter)
+{
+	const std::vector<LightData>& lights = mpScene->getLights();
+	const std::vector<FullReservoir>& input = (iter != 0) ? mSpatialReservoirsIn : mReservoirs[uint32_t(ReservoirStore::BufferId::CurrReservoirs)];
+
+	// Read G-buffer data
+	GBuffer gBuffer = loadGBuffer(pixelIndex);
+	vec3 albedo = vec3(gBuffer.color);
+
+	// Each iteration of each frame draws the next points of the pixel's sequences (see SampleSequences.h)
+	PixelSampler pixelSampler = createPixelSampler(mSettings.samplerType, pixelIndex.x, pixelIndex.y);
+	uint32_t iteration = frameCount * totalIter + iter;
+
+	vec3 shadeColor = vec3(0.f, 0.f, 0.f);
+	if (gBuffer.pos.w == 0)
+	{
+		shadeColor = albedo;
+	}
+	else if ((!mSettings.enableWeightedRIS || !mSettings.doSpatialReuse) && !lights.empty())
+	{
+		shadeColor += lambertianDirect(pixelSample(pixelSampler, SAMPLE_DOMAIN_DIRECT_LIGHT, frameCount, 0), vec3(gBuffer.pos), vec3(gBuffer.norm), vec3(gBuffer.color));
+	}
+
+	texel(BufferId::SpatialReservoirs, pixelIndex) = vec4(shadeColor, 1.f);
+	if (!mSettings.enableWeightedRIS) return;
+
+	if (!mSettings.doSpatialReuse)
+	{
+		copyReservoirs(ReservoirStore::BufferId::SpatialReservoirs, ReservoirStore::BufferId::CurrReservoirs, pixelIndex);
+		return;
+	}
+
+	// Each of our reservoirs is combined with the same-numbered reservoir of the same neighbors
+	Reservoir spatialReservoirs[ReservoirStore::kMaxReservoirsPerPixel];
+	float sampleCounts[ReservoirStore::kMaxReservoirsPerPixel] = {};
+
+	if (gBuffer.pos.w != 0 && hasCandidateSources())
+	{
+		// To hold information about current light
+		float dist = 0.f;
+		vec3 lightIntensity;
+		vec3 lightDirection;
+		float p_hat;
+
+		// Neighbors we combined, for the unbiased weights (which are why we stop at kSpatialLength of them)
+		uvec2 q[kSpatialLength];
+		uint32_t neighborCount = 0;
+		int neighbors = mSettings.unbiased ? std::min(mSettings.spatialNeighbors, int(kSpatialLength)) : mSettings.spatialNeighbors;
+
+		// Combine current reservoirs with spatial reservoirs
+		for (uint32_t k = 0; k < mReservoirsPerPixel; k++) {
+			Reservoir reservoir = loadReservoir(input, pixelIndex, k);
+			p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, reservoir.y);
+			uint32_t risIndex = (iteration * mReservoirsPerPixel + k) * uint32_t(mSettings.spatialNeighbors + 1);
+			updateReservoir(spatialReservoirs[k], reservoir.y, p_hat * reservoir.W * reservoir.M, pixelSample(pixelSampler, SAMPLE_DOMAIN_SPATIAL_RIS, risIndex, 0));
+			sampleCounts[k] = reservoir.M;
+		}
+
+		// Loop through neighbors and combine them with spatial reservoirs
+		for (int i = 0; i < neighbors; ++i)
+		{
+			uint32_t neighborSample = iteration * uint32_t(mSettings.spatialNeighbors) + uint32_t(i);
+			vec2 u = vec2(pixelSample(pixelSampler, SAMPLE_DOMAIN_NEIGHBOR, neighborSample, 0), pixelSample(pixelSampler, SAMPLE_DOMAIN_NEIGHBOR, neighborSample, 1));
+			uvec2 neighborIndex = getSpatialNeighborIndex(pixelIndex, u);
+
+			vec4 neighborNorm = texel(BufferId::WorldNormal, neighborIndex);
+
+			// Check that the angle between the normals are within 25-50 degrees
+			if ((glm::dot(vec3(gBuffer.norm), vec3(neighborNorm))) < 0.9) continue;
+
+			// Check if neighbor exceeds 10% of current pixel's depth
+			if (neighborNorm.w > 1.1f * gBuffer.norm.w || neighborNorm.w < 0.9f * gBuffer.norm.w) continue;
+
+			// Combine neighbor's reservoirs
+			if (neighborCount < kSpatialLength) q[neighborCount++] = neighborIndex;
+			for (uint32_t k = 0; k < mReservoirsPerPixel; k++) {
+				Reservoir neighborReservoir = loadReservoir(input, neighborIndex, k);
+				p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, neighborReservoir.y);
+				uint32_t risIndex = (iteration * mReservoirsPerPixel + k) * uint32_t(mSettings.spatialNeighbors + 1) + uint32_t(i) + 1;
+				updateReservoir(spatialReservoirs[k], neighborReservoir.y, p_hat * neighborReservoir.W * neighborReservoir.M, pixelSample(pixelSampler, SAMPLE_DOMAIN_SPATIAL_RIS, risIndex, 0));
+				sampleCounts[k] += neighborReservoir.M;
+			}
+		}
+
+		for (uint32_t k = 0; k < mReservoirsPerPixel; k++) {
+			// Update M
+			Reservoir& spatialReservoir = spatialReservoirs[k];
+			spatialReservoir.M = sampleCounts[k];
+
+			// Update weight
+			p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, spatialReservoir.y);
+
+			if (p_hat == 0.f) {
+				spatialReservoir.W = 0.f;
+			}
+			else if (!mSettings.unbiased) {
+				spatialReservoir.W = (1.f / p_hat) * (spatialReservoir.wSum / spatialReservoir.M);
+			}
+			else {
+				// Only count the samples of pixels that could have produced spatialReservoir.y.  Ours can (p_hat > 0), and
+				//     if it cannot see the sample, the visibility test below zeroes W anyway.
+				float Z = loadReservoir(input, pixelIndex, k).M;
+				for (uint32_t i = 0; i < neighborCount; i++) {
+					GBuffer neighborGBuffer = loadGBuffer(q[i]);
+
+					vec3 neighborLightDirection;
+					vec3 neighborLightIntensity;
+					float neighborDist = 0.f;
+					float neighbor_p_hat = evaluatePHat(neighborGBuffer, neighborLightDirection, neighborLightIntensity, neighborDist, spatialReservoir.y);
+					if (neighbor_p_hat > 0.f && mSettings.unbiasedVisibility) {
+						neighbor_p_hat *= shadowRayVisibility(vec3(neighborGBuffer.pos), neighborLightDirection, mSettings.minT, neighborDist);
+					}
+					if (neighbor_p_hat > 0.f) {
+						Z += loadReservoir(input, q[i], k).M;
+					}
+				}
+				spatialReservoir.W = (Z > 0.f) ? (1.f / p_hat) * (spatialReservoir.wSum / Z) : 0.f;
+			}
+
+			// Evaluate visibility for initial candidates
+			float shadowed = shadowRayVisibility(vec3(gBuffer.pos), lightDirection, mSettings.minT, dist);
+			if (shadowed <= 0.001f) {
+				spatialReservoir.W = 0.f;
+			}
+		}
+	}
+
+	ReservoirStore::BufferId outputId = (iter == totalIter - 1) ? ReservoirStore::BufferId::SpatialReservoirs : ReservoirStore::BufferId::SpatialReservoirsOut;
+	for (uint32_t k = 0; k < mReservoirsPerPixel; k++) {
+		storeReservoir(outputId, pixelIndex, k, spatialReservoirs[k]);
+	}
+}
+
+void CpuReSTIRRenderer::shadeWithReservoirsRayGen(const uvec2& pixelIndex)
+{
+	// Read G-buffer data
+	vec4 worldPos = texel(BufferId::WorldPosition, pixelIndex);
+	vec4 worldNorm = texel(BufferId::WorldNormal, pixelIndex);
+	vec4 difMatlColor = texel(BufferId::MaterialDiffuse, pixelIndex);
+	vec3 albedo = vec3(difMatlColor);
+
+	vec3 shadeColor = vec3(0.f, 0.f, 0.f);
+	if (mSettings.enableWeightedRIS)
+	{
+		// Keep our reservoirs for next frame, and average the contributions of all of them
+		copyReservoirs(ReservoirStore::BufferId::PrevReservoirs, ReservoirStore::BufferId::SpatialReservoirs, pixelIndex);
+		for (uint32_t k = 0; k < mReservoirsPerPixel && worldPos.w != 0 && hasCandidateSources(); k++)
+		{
+			Reservoir reservoir = unpackReservoir(mReservoirs[uint32_t(ReservoirStore::BufferId::PrevReservoirs)][reservoirIndex(pixelIndex, mScreenSize, k, mReservoirsPerPixel)]);
+
+			// Do shading with light stored in reservoir
+			float dist;
+			vec3 lightIntensity;
+			vec3 lightDirection;
+
+			int lightSample = int(reservoir.y);
+			getCandidateLightData(lightSample, vec3(worldPos), lightDirection, lightIntensity, dist);
+
+			// Lambertian dot product
+			float cosTheta = saturate(glm::dot(vec3(worldNorm), lightDirection));
+
+			// Shoot shadow ray
+			float shadow = shadowRayVisibility(vec3(worldPos), lightDirection, mSettings.minT, dist);
+
+			// Compute Lambertian shading color (divide by probability of light = 1.0 / N)
+			vec3 color = shadow * cosTheta * lightIntensity * reservoir.W;
+			color *= albedo / float(M_PI);
+			color /= dist * dist;
+			shadeColor += color;
+		}
+		shadeColor /= float(mReservoirsPerPixel);
+	}
+
+	if (worldPos.w != 0)
+	{
+		if (!mSettings.enableWeightedRIS)
+		{
+			shadeColor = vec3(texel(BufferId::SpatialReservoirs, pixelIndex));
+		}
+	}
+	else
+	{
+		shadeColor = albedo;
+	}
+
+	texel(BufferId::ShadedOutput, pixelIndex) = vec4(shadeColor, 1.f);
+}
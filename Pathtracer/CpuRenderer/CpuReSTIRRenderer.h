@@ -0,0 +1,321 @@
+#pragma once
+
+#include "Falcor.h"
+#include "../../SharedUtils/CpuScene.h"
+#include "../../SharedUtils/TiledDispatch.h"
+#include "../Passes/LightAliasTable.h"
+#include "../Passes/LightBvh.h"
+#include "../Passes/EnvMapSampler.h"
+#include "../Passes/EmissiveLights.h"
+#include "../Passes/SampleGenerator.h"
+#include "CpuReSTIRUtils.h"
+#include "CpuAdaptiveSampler.h"
+#include <atomic>
+
+/** A multithreaded CPU implementation of our ReSTIR pipeline.  It runs the same four stages as the GPU path,
+
+       RayTracedGBufferPass -> CreateLightSamplesPass -> SpatialReusePass (x N) -> ShadeWithReservoirsPass
+
+    mirroring rtGBuffer.hlsl, createLightSamples.hlsl, spatialReuse.hlsl and shadeWithReservoirs.hlsl one for one:
+    the same ReservoirStore layout and reservoir encodings, the same sample sequences (SampleSequences.h) and
+    indices into them, and the same per-pass frame counters.  Candidates come from the same mixture of the scene's lights,
+    environment map cells and points on emissive triangles (see sampleSourceLight());  build getEnvMapSampler() from
+    the map and getEmissiveLights() from the scene to draw from them.  All work is launched over screen tiles through a TiledDispatch, and primary rays are
+    traced as 2x2 pixel packets through the CpuScene's SIMD BVH.
+
+Usage:
+     CpuReSTIRRenderer::SharedPtr pRenderer = CpuReSTIRRenderer::create(CpuScene::create(pScene, pRenderContext));
+     pRenderer->resize(uvec2(1920, 1080));
+     pRenderer->getEnvMapSampler()->update(pRenderContext, pEnvMap);   // Optional
+     pRenderer->getEmissiveLights()->update(pRenderContext, pScene);   // Optional
+     pRenderer->getSettings().spatialIterations = 2;
+
+     pRenderer->renderFrame(pScene->getActiveCamera()->getData());
+     const std::vector<vec4>& image = pRenderer->getBuffer(CpuReSTIRRenderer::BufferId::ShadedOutput);
+
+     CpuReSTIRRenderer::RayBenchmark bench = pRenderer->benchmarkRays(camera);   // Mrays/s of the intersection engine
+     CpuReSTIRRenderer::LightSamplingBenchmark lightBench = pRenderer->benchmarkLightSampling(camera);
+     CpuReSTIRRenderer::ReservoirBenchmark resBench = pRenderer->benchmarkReservoirs(camera, 4);   // 4 vs. 1 reservoirs per pixel
+     CpuReSTIRRenderer::ReservoirEncodingBenchmark encBench = pRenderer->benchmarkReservoirEncoding(camera);
+     CpuReSTIRRenderer::BiasBenchmark biasBench = pRenderer->benchmarkBias(camera);
+     CpuReSTIRRenderer::AdaptiveSamplingBenchmark adaptiveBench = pRenderer->benchmarkAdaptiveSampling(camera, 0.05f);
+     CpuReSTIRRenderer::ReprojectionValidation reproj = pRenderer->validateReprojection(cameraPath);   // Cameras along a path
+*/
+
+class CpuReSTIRRenderer : public std::enable_shared_from_this<CpuReSTIRRenderer>
+{
+public:
+	using SharedPtr = std::shared_ptr<CpuReSTIRRenderer>;
+	using SharedConstPtr = std::shared_ptr<const CpuReSTIRRenderer>;
+	virtual ~CpuReSTIRRenderer() = default;
+
+	// The screen-sized buffers we keep.  Names match the ResourceManager textures used by the GPU passes.  (The reservoirs
+	//     themselves are kept separately, with the same layout as the ReservoirStore buffers; see getReservoirs().)
+	enum class BufferId : uint32_t
+	{
+		WorldPosition = 0,
+		WorldNormal,
+		MaterialDiffuse,
+		MotionVectors,         ///< Into last frame (see reprojection.hlsli)
+		PrevWorldPosition,     ///< Last frame's G-buffer, as ping-ponged by RayTracedGBufferPass
+		PrevWorldNormal,
+		PrevMaterialDiffuse,
+		CurrReservoirs,        ///< Shaded result without ReSTIR
+		SpatialReservoirs,     ///< Shaded result without ReSTIR
+		ShadedOutput,
+		Count
+	};
+
+	// Equivalent of the GUI / ResourceManager controls of the GPU passes
+	struct Settings
+	{
+		float    minT = 1.0e-4f;               ///< ResourceManager::getMinTDist()
+		int32_t  lightSamples = 32;            ///< M initial candidates
+		bool     enableWeightedRIS = true;     ///< ResourceManager::getWeightedRIS()
+		bool     doTemporalReuse = true;       ///< ResourceManager::getTemporal()
+		bool     doSpatialReuse = true;        ///< ResourceManager::getSpatial()
+		bool     unbiased = false;             ///< ResourceManager::getUnbiased()
+		bool     unbiasedVisibility = false;   ///< ResourceManager::getUnbiasedVisibility()
+		LightSelection lightSelection = LightSelection::AliasTable;   ///< How initial candidates are picked
+		uint32_t samplerType = SAMPLER_SOBOL;  ///< Sequence behind the candidates and reuse decisions (SampleGenerator::Type)
+		int32_t  spatialNeighbors = 5;
+		int32_t  spatialRadius = 30;
+		int32_t  spatialIterations = 1;
+		uint32_t reservoirsPerPixel = 1;       ///< ReservoirStore::getReservoirsPerPixel().  Changing it clears all temporal history.
+		ReservoirStore::Format reservoirFormat = ReservoirStore::Format::Full;   ///< ReservoirStore::getFormat().  Same.
+		vec3     bgColor = vec3(0.5f, 0.5f, 1.0f);
+	};
+
+	// Throughput of the CpuScene intersection engine, as measured by benchmarkRays()
+	struct RayBenchmark
+	{
+		float primaryMraysPerSec = 0.f;        ///< Closest hit, one camera ray at a time
+		float primaryPacketMraysPerSec = 0.f;  ///< Closest hit, camera rays in 2x2 pixel packets
+		float shadowMraysPerSec = 0.f;         ///< Any hit, from each primary hit toward one of the scene's lights
+	};
+
+	// Quality of power-based and light BVH vs. uniform candidate selection, as measured by benchmarkLightSampling()
+	struct LightSamplingBenchmark
+	{
+		uint32_t tableLightCount = 0;          ///< Lights in the synthetic alias table build
+		float    tableBuildMs = 0.f;           ///< Time to build it
+		float    tableMaxPdfError = 0.f;       ///< Max relative error of its implied pdf
+		uint32_t pixels = 0;                   ///< Shading points the variance was averaged over
+		float    uniformVariance = 0.f;        ///< Mean relative variance of the unshadowed RIS estimate, uniform candidates
+		float    aliasVariance = 0.f;          ///< Same, with candidates drawn from the alias table
+		float    bvhVariance = 0.f;            ///< Same, with candidates drawn from the light BVH
+		float    aliasVarianceReduction = 0.f; ///< uniformVariance / aliasVariance
+		float    bvhVarianceReduction = 0.f;   ///< uniformVariance / bvhVariance
+	};
+
+	// Cost and quality of N reservoirs per pixel vs. one, as measured by benchmarkReservoirs()
+	struct ReservoirBenchmark
+	{
+		uint32_t reservoirsPerPixel = 0;       ///< N
+		uint32_t frames = 0;                   ///< Frames rendered with each count
+		float    baseBytesPerPixel = 0.f;      ///< Reservoir buffer traffic per pixel and frame, one reservoir per pixel
+		float    bytesPerPixel = 0.f;          ///< Same, N reservoirs per pixel
+		float    baseMsPerFrame = 0.f;         ///< Frame time, one reservoir per pixel
+		float    msPerFrame = 0.f;             ///< Frame time, N reservoirs per pixel
+		float    baseError = 0.f;              ///< Relative RMSE of each frame vs. brute-force direct lighting, one reservoir per pixel
+		float    error = 0.f;                  ///< Same, N reservoirs per pixel
+	};
+
+	// Accuracy and memory traffic of the compact vs. the full reservoir format, as measured by benchmarkReservoirEncoding()
+	struct ReservoirEncodingBenchmark
+	{
+		uint32_t samples = 0;                  ///< Synthetic reservoirs round-tripped through the compact format
+		uint32_t lightIdErrors = 0;            ///< Light IDs that did not survive it
+		float    maxMError = 0.f;              ///< Max relative error of M
+		float    maxWError = 0.f;              ///< Max relative error of W
+		uint32_t frames = 0;                   ///< Frames rendered with each format
+		float    fullMBPerFrame = 0.f;         ///< Reservoir buffer traffic of a 1920x1080 frame, full format
+		float    compactMBPerFrame = 0.f;      ///< Same, compact format
+		float    fullMsPerFrame = 0.f;         ///< Frame time, full format
+		float    compactMsPerFrame = 0.f;      ///< Frame time, compact format
+		float    fullError = 0.f;              ///< Relative RMSE of each frame vs. brute-force direct lighting, full format
+		float    compactError = 0.f;           ///< Same, compact format
+	};
+
+	// Bias and cost of biased vs. unbiased reuse, as measured by benchmarkBias().  Bias is the relative error of the mean of all
+	//     frames' total energy vs. the reference (negative: too dark); the error is the relative RMSE of the per-pixel mean.
+	struct BiasBenchmark
+	{
+		uint32_t frames = 0;                   ///< Frames averaged with each mode
+		float    biasedMsPerFrame = 0.f;       ///< Frame time, biased reuse
+		float    unbiasedMsPerFrame = 0.f;     ///< Frame time, unbiased reuse (1/Z over neighbors with p_hat > 0)
+		float    visibilityMsPerFrame = 0.f;   ///< Frame time, unbiased reuse that also traces visibility for Z
+		float    biasedBias = 0.f;
+		float    unbiasedBias = 0.f;
+		float    visibilityBias = 0.f;
+		float    biasedError = 0.f;
+		float    unbiasedError = 0.f;
+		float    visibilityError = 0.f;
+	};
+
+	// Time to a target error with adaptive vs. uniform sampling, as measured by benchmarkAdaptiveSampling().  Each frame takes
+	//     the samples a CpuAdaptiveSampler budgets per pixel (one per pixel when uniform) of fullGI.hlsl's direct lighting
+	//     (one random light and a shadow ray), until the relative RMSE of the accumulated image reaches the target.
+	struct AdaptiveSamplingBenchmark
+	{
+		float    targetError = 0.f;            ///< Relative RMSE vs. brute-force direct lighting to reach
+		uint32_t pixels = 0;                   ///< Geometry pixels the error is measured over
+		uint32_t uniformFrames = 0;            ///< Frames to reach the target (or the most we render), one sample per pixel each
+		uint32_t adaptiveFrames = 0;           ///< Same, with per-pixel budgets
+		float    uniformMs = 0.f;              ///< Time spent sampling and accumulating until then
+		float    adaptiveMs = 0.f;
+		float    uniformSamplesPerPixel = 0.f; ///< Samples taken until then, per pixel
+		float    adaptiveSamplesPerPixel = 0.f;
+		float    uniformError = 0.f;           ///< Relative RMSE when we stopped
+		float    adaptiveError = 0.f;
+		uint32_t convergedPixels = 0;          ///< Pixels the adaptive run had stopped sampling
+		float    speedup = 0.f;                ///< uniformMs / adaptiveMs
+	};
+
+	// Accuracy of the motion vector reprojection over a camera path, as measured by validateReprojection().  The ground truth
+	//     projects each pixel's surface through last frame's camera basis (as getPrimaryRay() builds rays) and traces a ray
+	//     from last frame's camera to it, to tell whether last frame's camera saw it.
+	struct ReprojectionValidation
+	{
+		uint32_t frames = 0;                   ///< Camera moves checked (one less than the cameras given)
+		uint32_t pixels = 0;                   ///< Geometry pixels checked, over all moves
+		uint32_t visible = 0;                  ///< Of those, surfaces last frame's camera saw on screen
+		uint32_t accepted = 0;                 ///< Pixels reprojectPixel() kept history for
+		uint32_t falseAccepts = 0;             ///< Accepted, but the surface was hidden or off screen last frame
+		uint32_t falseRejects = 0;             ///< Rejected, but the surface was visible last frame
+		uint32_t cameraOnlyAccepted = 0;       ///< Pixels kept by reprojecting with last frame's view-projection matrix only (no disocclusion tests)
+		uint32_t cameraOnlyFalseAccepts = 0;   ///< Same, but the surface was hidden or off screen last frame
+		float    meanMotionError = 0.f;        ///< Mean distance (pixels) between the motion vector's target and the ground truth, over visible surfaces
+		float    meanPositionError = 0.f;      ///< Mean distance between this frame's surface and last frame's at the accepted pixel, relative to its depth
+		float    cameraOnlyPositionError = 0.f;   ///< Same, for the camera-matrix-only reprojection
+	};
+
+	// Create a renderer for the specified scene.  If no dispatcher is given, one is created using all cores.
+	static SharedPtr create(const CpuScene::SharedPtr& pScene, const TiledDispatch::SharedPtr& pDispatch = nullptr);
+
+	// (Re)allocate our screen-sized buffers.  Clears all temporal history.
+	void resize(const uvec2& size);
+
+	// Render one frame with the given camera.  Runs all four stages.
+	void renderFrame(const CameraData& camera);
+
+	// The individual stages, in order.  renderFrame() calls these for you.
+	void executeGBuffer(const CameraData& camera);
+	void executeCreateLightSamples(const CameraData& camera);
+	void executeSpatialReuse(uint32_t iter, uint32_t totalIter);
+	void executeShadeWithReservoirs();
+
+	// Trace <passes> full screens of each ray type with the given camera and report the ray throughput.  Overwrites the G-buffer.
+	RayBenchmark benchmarkRays(const CameraData& camera, uint32_t passes = 4);
+
+	// Time an alias table build over <tableLightCount> synthetic lights, then compare the variance of RIS with uniform,
+	//     power-based, and light BVH candidates (at our M) over <trials> runs per shading point.  Overwrites the G-buffer.
+	LightSamplingBenchmark benchmarkLightSampling(const CameraData& camera, uint32_t trials = 64, uint32_t tableLightCount = 1u << 20);
+
+	// Render <frames> frames from a still camera with one, then <reservoirsPerPixel> reservoirs per pixel, starting without
+	//     history each time, and compare their reservoir traffic, frame time and error against a reference shaded with every
+	//     light.  Clears all temporal history.
+	ReservoirBenchmark benchmarkReservoirs(const CameraData& camera, uint32_t reservoirsPerPixel, uint32_t frames = 16);
+
+	// Round-trip <samples> synthetic reservoirs through the compact format, then render <frames> frames from a still camera with
+	//     each format, as benchmarkReservoirs() does, and report their reservoir traffic scaled to a 1080p frame.  Clears all
+	//     temporal history.
+	ReservoirEncodingBenchmark benchmarkReservoirEncoding(const CameraData& camera, uint32_t frames = 16, uint32_t samples = 1u << 20);
+
+	// Average <frames> frames from a still camera with biased reuse, unbiased reuse, and unbiased reuse with visibility, starting
+	//     without history each time, and compare each mean against a reference shaded with every light.  Clears all temporal history.
+	BiasBenchmark benchmarkBias(const CameraData& camera, uint32_t frames = 64);
+
+	// Accumulate direct lighting from a still camera with one sample per pixel and frame, then with per-pixel budgets (with
+	//     <targetError> as the per-pixel threshold), until each reaches <targetError> or <maxFrames>.  Overwrites the G-buffer.
+	AdaptiveSamplingBenchmark benchmarkAdaptiveSampling(const CameraData& camera, float targetError = 0.05f, uint32_t maxFrames = 1024);
+
+	// Render the G-buffer for each camera in turn (e.g. sampled along an ObjectPath) and check each frame's reprojection into
+	//     the one before against the ground truth.  Clears all temporal history.
+	ReprojectionValidation validateReprojection(const std::vector<CameraData>& cameras);
+
+	// Accessors
+	Settings& getSettings()                                 { return mSettings; }
+	const std::vector<vec4>& getBuffer(BufferId id) const   { return mBuffers[uint32_t(id)]; }
+	const std::vector<FullReservoir>& getReservoirs(ReservoirStore::BufferId id) const { return mReservoirs[uint32_t(id)]; }
+	const uvec2& getScreenSize() const                      { return mScreenSize; }
+	const CpuScene::SharedPtr& getScene() const             { return mpScene; }
+	const TiledDispatch::SharedPtr& getDispatch() const     { return mpDispatch; }
+	const EnvMapSampler::SharedPtr& getEnvMapSampler() const { return mpEnvSampler; }   ///< Inactive until built from a map
+	const EmissiveLights::SharedPtr& getEmissiveLights() const { return mpEmissiveLights; }   ///< Inactive until built from a scene
+	uint64_t getFrameRayCount() const                       { return mFrameRayCount; }   ///< Rays traced by the last renderFrame()
+	uint64_t getFrameReservoirBytes() const                 { return mFrameReservoirBytes; }   ///< Reservoir bytes read and written by the last renderFrame()
+
+protected:
+	CpuReSTIRRenderer(const CpuScene::SharedPtr& pScene, const TiledDispatch::SharedPtr& pDispatch);
+
+	// Per-pixel entry points, equivalent to each stage's ray generation shader.  The G-buffer handles a 2x2 quad at a time.
+	void gBufferRayGen(const uvec2& quadIndex, const uvec2& tileEnd, const CameraData& camera);
+	void createLightSamplesRayGen(const uvec2& pixelIndex, uint32_t frameCount);
+	void spatialReuseRayGen(const uvec2& pixelIndex, uint32_t frameCount, uint32_t iter, uint32_t totalIter);
+	void shadeWithReservoirsRayGen(const uvec2& pixelIndex);
+
+	// Shared helpers from the shaders
+	CpuScene::Ray getPrimaryRay(const uvec2& pixelIndex, const CameraData& camera) const;
+	void   storeGBuffer(const uvec2& pixelIndex, const CameraData& camera, const CpuScene::Hit* pHit);
+	float  shadowRayVisibility(const vec3& origin, const vec3& direction, float minT, float maxT) const;
+	vec3   lambertianDirect(float u, const vec3& hit, const vec3& norm, const vec3& diffuseColor) const;
+	uvec2  getSpatialNeighborIndex(const uvec2& pixelIndex, const vec2& u) const;
+	CpuReSTIR::GBuffer loadGBuffer(const uvec2& pixelIndex, bool previousFrame = false) const;
+	int    sampleSceneLight(const vec3& posW, const vec3& normal, const PixelSampler& pixelSampler, uint32_t index, float& p, LightSelection selection) const;
+	int    sampleSourceLight(const vec3& posW, const vec3& normal, const PixelSampler& pixelSampler, uint32_t index, float& p, LightSelection selection) const;
+	float  envCandidateProb() const;
+	float  emissiveCandidateProb() const;
+	void   getEnvCellData(uint32_t cell, vec3& toLight, vec3& lightIntensity, float& distToLight) const;
+	void   getEmissivePointData(uint32_t pointId, const vec3& hitPos, vec3& toLight, vec3& lightIntensity, float& distToLight) const;
+	void   getCandidateLightData(int light, const vec3& hitPos, vec3& toLight, vec3& lightIntensity, float& distToLight) const;
+	float  evaluatePHat(const CpuReSTIR::GBuffer& gBuffer, vec3& lightDirection, vec3& lightIntensity, float& dist, float light) const;
+	bool   hasCandidateSources() const   { return mpScene->getLightCount() > 0 || mpEnvSampler->isActive() || mpEmissiveLights->isActive(); }
+	CpuReSTIR::Reservoir loadReservoir(const std::vector<FullReservoir>& buffer, const uvec2& pixelIndex, uint32_t k) const;
+	void   storeReservoir(ReservoirStore::BufferId id, const uvec2& pixelIndex, uint32_t k, const CpuReSTIR::Reservoir& reservoir);
+	void   copyReservoirs(ReservoirStore::BufferId dst, ReservoirStore::BufferId src, const uvec2& pixelIndex);
+
+	// Benchmark helpers:  every scene light's shadowed contribution per pixel, and the traffic, time and error vs. that of <frames> frames
+	std::vector<vec3> computeDirectReference(const CameraData& camera);
+	void   measureFrames(const CameraData& camera, uint32_t frames, const std::vector<vec3>& reference, float& bytesPerPixel, float& msPerFrame, float& error);
+
+	// Launch a per-tile / per-pixel kernel over the whole screen.  Rays traced and reservoir bytes touched by the kernel are
+	//     added to mRayCount and mReservoirBytes.
+	void dispatchTiles(const TiledDispatch::TileKernel& kernel);
+	void dispatch(const std::function<void(const uvec2&)>& kernel);
+
+	vec4& texel(BufferId id, const uvec2& pixelIndex)             { return mBuffers[uint32_t(id)][pixelIndex.y * mScreenSize.x + pixelIndex.x]; }
+	const vec4& texel(BufferId id, const uvec2& pixelIndex) const { return mBuffers[uint32_t(id)][pixelIndex.y * mScreenSize.x + pixelIndex.x]; }
+
+	CpuScene::SharedPtr           mpScene;
+	TiledDispatch::SharedPtr      mpDispatch;
+	Settings                      mSettings;
+	LightAliasTable::SharedPtr    mpAliasTable;        ///< Power-based source distribution, as in CreateLightSamplesPass
+	LightBvh::SharedPtr           mpLightBvh;          ///< Spatial source distribution, as in CreateLightSamplesPass
+	EnvMapSampler::SharedPtr      mpEnvSampler;        ///< Environment map cells as candidates, as in CreateLightSamplesPass
+	EmissiveLights::SharedPtr     mpEmissiveLights;    ///< Emissive triangles as candidates, as in CreateLightSamplesPass
+
+	uvec2                         mScreenSize = uvec2(0, 0);
+	std::vector<vec4>             mBuffers[uint32_t(BufferId::Count)];
+
+	// Reservoir buffers, as kept by ReservoirStore, plus a snapshot of SpatialReservoirsOut (see executeSpatialReuse())
+	uint32_t                      mReservoirsPerPixel = 1;
+	ReservoirStore::Format        mReservoirFormat = ReservoirStore::Format::Full;
+	std::vector<FullReservoir> mReservoirs[uint32_t(ReservoirStore::BufferId::Count)];
+	std::vector<FullReservoir> mSpatialReservoirsIn;
+
+	// Last frame's camera, kept by RayTracedGBufferPass for the motion vectors
+	mat4                          mLastCameraMatrix;
+	vec3                          mLastCameraPos;
+	bool                          mHasLastCamera = false;
+
+	// Each GPU pass owns its own frame counter to seed its random number generator.  (ShadeWithReservoirsPass never draws a random number.)
+	uint32_t                      mCreateFrameCount = 0x1456u;
+	std::vector<uint32_t>         mSpatialFrameCount;
+
+	// Ray statistics
+	std::atomic<uint64_t>         mRayCount;
+	uint64_t                      mFrameRayCount = 0;
+	std::atomic<uint64_t>         mReservoirBytes;
+	uint64_t                      mFrameReservoirBytes = 0;
+};
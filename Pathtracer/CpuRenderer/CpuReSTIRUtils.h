@@ -0,0 +1,215 @@
+#pragma once
+
+#include "Falcor.h"
+#include "../Passes/ReservoirStore.h"
+
+/** C++ mirrors of the HLSL helpers in simpleGIUtils.hlsli, restirUtils.hlsli and reprojection.hlsli, used by the CPU reference
+    renderer.  These intentionally keep the names, argument order, and floating point operation order of the
+    shader code, so the CPU and GPU paths consume random numbers identically and can be diffed pixel by pixel.
+    If you change one of the shader helpers, change its twin here too.
+*/
+
+using namespace Falcor;
+
+namespace CpuReSTIR
+{
+	// As in reprojection.hlsli
+	const float kReprojectionDepthTolerance = 0.1f;
+	const float kReprojectionNormalThreshold = 0.9f;
+
+	// Mirrors the Reservoir struct in restirUtils.hlsli.  Stored in textures as float4(y, M, W, wSum).
+	struct Reservoir
+	{
+		float y = 0.f;       ///< Index of the selected light (stored as a float, as on the GPU)
+		float M = 0.f;       ///< Number of candidates seen
+		float W = 0.f;       ///< Unbiased contribution weight
+		float wSum = 0.f;    ///< Sum of candidate weights
+	};
+
+	// Mirrors the GBuffer struct in restirUtils.hlsli
+	struct GBuffer
+	{
+		vec4 pos;
+		vec4 norm;
+		vec4 color;
+	};
+
+	inline Reservoir createReservoir(const vec4& res)
+	{
+		Reservoir r;
+		r.y = res.x;
+		r.M = res.y;
+		r.W = res.z;
+		r.wSum = res.w;
+		return r;
+	}
+
+	inline vec4 packReservoir(const Reservoir& r)
+	{
+		return vec4(r.y, r.M, r.W, r.wSum);
+	}
+
+	// Mirrors packReservoir() / unpackReservoir() in restirUtils.hlsli, for either RESERVOIR_FORMAT.  We keep both
+	//     formats in a FullReservoir:  a compact reservoir's M bits and W are what the GPU would decode, with wSum = 0.
+	inline FullReservoir packReservoirBuffer(const Reservoir& r, ReservoirStore::Format format)
+	{
+		if (format == ReservoirStore::Format::Compact)
+		{
+			CompactReservoir c = encodeCompactReservoir(uint32_t(r.y), r.M, r.W);
+			return FullReservoir{ c.lightId, c.MW & 0xFFFFu, compactReservoirW(c), 0.f };
+		}
+		return encodeFullReservoir(uint32_t(r.y), r.M, r.W, r.wSum);
+	}
+
+	inline Reservoir unpackReservoir(const FullReservoir& p)
+	{
+		Reservoir r;
+		r.y = float(p.lightId);
+		r.M = f16tof32(p.M);
+		r.W = p.W;
+		r.wSum = p.wSum;
+		return r;
+	}
+
+	// Mirrors reservoirIndex() in restirUtils.hlsli
+	inline uint32_t reservoirIndex(const uvec2& pixelIndex, const uvec2& dim, uint32_t k, uint32_t reservoirsPerPixel)
+	{
+		return (pixelIndex.y * dim.x + pixelIndex.x) * reservoirsPerPixel + k;
+	}
+
+	// Generates a seed for a random number generator from 2 inputs plus a backoff (TEA)
+	inline uint32_t initRand(uint32_t val0, uint32_t val1, uint32_t backoff = 16)
+	{
+		uint32_t v0 = val0, v1 = val1, s0 = 0;
+		for (uint32_t n = 0; n < backoff; n++)
+		{
+			s0 += 0x9e3779b9;
+			v0 += ((v1 << 4) + 0xa341316c) ^ (v1 + s0) ^ ((v1 >> 5) + 0xc8013ea4);
+			v1 += ((v0 << 4) + 0xad90777d) ^ (v0 + s0) ^ ((v0 >> 5) + 0x7e95761e);
+		}
+		return v0;
+	}
+
+	// Takes our seed, updates it, and returns a pseudorandom float in [0..1].  Uses the LCG's top 24 bits:  its low bits
+	//     repeat with short periods.
+	inline float nextRand(uint32_t& s)
+	{
+		s = (1664525u * s + 1013904223u);
+		return float(s >> 8) / float(0x01000000);
+	}
+
+	inline float saturate(float x)
+	{
+		return glm::clamp(x, 0.f, 1.f);
+	}
+
+	// Mirrors getLightData() (Falcor's evalDirectionalLight() / evalPointLight() folded into one)
+	inline void getLightData(const LightData& light, const vec3& hitPos, vec3& toLight, vec3& lightIntensity, float& distToLight)
+	{
+		vec3 L, posW;
+		if (light.type == LightDirectional)
+		{
+			lightIntensity = light.intensity;
+			L = -glm::normalize(light.dirW);
+			float dist = glm::length(hitPos - light.posW);
+			posW = hitPos - light.dirW * dist;
+		}
+		else
+		{
+			posW = light.posW;
+			L = light.posW - hitPos;
+			float distSquared = glm::dot(L, L);
+			L = (distSquared > 1e-5f) ? glm::normalize(L) : vec3(0.f);
+
+			// Distance falloff, plus spot-light cutoff and penumbra
+			float falloff = 1.f / ((0.01f * 0.01f) + distSquared);
+			float cosTheta = -glm::dot(L, light.dirW);
+			if (cosTheta < light.cosOpeningAngle)
+			{
+				falloff = 0.f;
+			}
+			else if (light.penumbraAngle > 0.f)
+			{
+				float deltaAngle = light.openingAngle - acosf(cosTheta);
+				falloff *= saturate((deltaAngle - light.penumbraAngle) / light.penumbraAngle);
+			}
+			lightIntensity = light.intensity * falloff;
+		}
+
+		// The shader normalizes a zero vector here (yielding NaNs); keep it zero instead
+		toLight = (glm::length(L) > 0.f) ? glm::normalize(L) : vec3(0.f);
+		distToLight = glm::length(posW - hitPos);
+	}
+
+	// RIS
+
+	inline void updateReservoir(Reservoir& res, float xi, float wi, uint32_t& randSeed)
+	{
+		res.wSum += wi;
+		res.M++;
+		if (nextRand(randSeed) < (wi / res.wSum)) {
+			res.y = xi;
+		}
+	}
+
+	// Same, with the caller's uniform number u deciding whether to keep xi
+	inline void updateReservoir(Reservoir& res, float xi, float wi, float u)
+	{
+		res.wSum += wi;
+		res.M++;
+		if (u < (wi / res.wSum)) {
+			res.y = xi;
+		}
+	}
+
+	inline float evaluateBSDF(const vec3& albedo, const vec3& lightIntensity, float cosTheta, float lightDist)
+	{
+		vec3 f = albedo / float(M_PI);
+		vec3 Le = lightIntensity;
+		float G = cosTheta / (lightDist * lightDist);
+		return glm::length(f * Le * G);
+	}
+
+	inline float evaluatePHat(const GBuffer& gBuffer, const std::vector<LightData>& lights, vec3& lightDirection, vec3& lightIntensity, float& dist, float light)
+	{
+		// Calculate p_hat(r.y) for reservoir's light sample
+		getLightData(lights[int(light)], vec3(gBuffer.pos), lightDirection, lightIntensity, dist);
+		float cosTheta = saturate(glm::dot(vec3(gBuffer.norm), lightDirection));
+		float p_hat = evaluateBSDF(vec3(gBuffer.color), lightIntensity, cosTheta, dist);
+
+		return p_hat;
+	}
+
+	// Mirrors computeMotionVector() in reprojection.hlsli.  mul(float4(p, 1), M) in HLSL (with row-major packing) is M * p in glm.
+	inline vec4 computeMotionVector(const uvec2& pixelIndex, const uvec2& dim, const vec3& prevPosW, const mat4& prevViewProj, const vec3& prevCameraPos)
+	{
+		vec4 prevScreenPos = prevViewProj * vec4(prevPosW, 1.f);
+		if (prevScreenPos.w <= 0.f) return vec4(0.f);   // Behind last frame's camera
+		prevScreenPos /= prevScreenPos.w;
+
+		vec2 prevPixel = vec2(((prevScreenPos.x + 1.f) * 0.5f) * (float)dim.x,
+		                      ((1.f - prevScreenPos.y) * 0.5f) * (float)dim.y);
+		return vec4(prevPixel - (vec2(pixelIndex) + 0.5f), glm::length(prevPosW - prevCameraPos), 1.f);
+	}
+
+	// Mirrors reprojectPixel() in reprojection.hlsli.  prevNorm is last frame's "WorldNormal", dim.x texels per row.
+	inline bool reprojectPixel(const uvec2& pixelIndex, const uvec2& dim, const vec4& motion, const vec3& normal, const std::vector<vec4>& prevNorm, uvec2& prevIndex)
+	{
+		prevIndex = uvec2(uint32_t(-1), uint32_t(-1));
+		if (motion.w == 0.f) return false;
+
+		// Off screen last frame?
+		vec2 prevPixel = vec2(pixelIndex) + 0.5f + vec2(motion);
+		if (!(prevPixel.x >= 0.f && prevPixel.y >= 0.f && prevPixel.x < (float)dim.x && prevPixel.y < (float)dim.y)) return false;
+		uvec2 candidate = glm::min(uvec2(prevPixel), dim - 1u);
+
+		// Disocclusion:  last frame's pixel saw something else (or nothing)
+		const vec4& prevNormDepth = prevNorm[candidate.y * dim.x + candidate.x];
+		if (prevNormDepth.w <= 0.f) return false;
+		if (std::abs(prevNormDepth.w - motion.z) > kReprojectionDepthTolerance * motion.z) return false;
+		if (glm::dot(normal, vec3(prevNormDepth)) < kReprojectionNormalThreshold) return false;
+
+		prevIndex = candidate;
+		return true;
+	}
+};
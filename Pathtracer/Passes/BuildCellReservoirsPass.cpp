@@ -1,12 +1,18 @@
 #include "BuildCellReservoirsPass.h"
 
 namespace {
-	const char* kFileInitReservoirs = "Shaders\\buildCellReservoirs.hlsl";
-	const uint32_t kThreadGroupSize = 256;
+	const char* kFileRayTrace = "Shaders\\buildCellReservoirs.hlsl";
+
+	// Function names for shader entry points
+	const char* kEntryPointRayGen = "BuildCellReservoirsRayGen";
+
+	const char* kEntryPointMiss0 = "ShadowMiss";
+	const char* kEntryShadowAnyHit = "ShadowAnyHit";
+	const char* kEntryShadowClosestHit = "ShadowClosestHit";
 };
 
-BuildCellReservoirsPass::BuildCellReservoirsPass(const std::string& outBuf)
-	: mOutChannel(outBuf), ::RenderPass("Build Cell Reservoirs Pass", "Build Cell Reservoirs Options")
+BuildCellReservoirsPass::BuildCellReservoirsPass(const ReGIRGrid::SharedPtr& pGrid)
+	: mpGrid(pGrid), ::RenderPass("Build Cell Reservoirs Pass", "Build Cell Reservoirs Options")
 {
 }
 
@@ -15,61 +21,102 @@ bool BuildCellReservoirsPass::initialize(RenderContext* pRenderContext, Resource
 	// Stash a copy of our resource manager, allowing us to access shared rendering resources
 	mpResManager = pResManager;
 
-	// Request texture resources for this pass (Note: We do not need a z-buffer since ray tracing does not generate one by default)
-	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse", "LightGrid"});
-	mpResManager->requestTextureResource(mOutChannel);
-	mpResManager->requestTextureResource(ResourceManager::kEnvironmentMap);
-
 	// Set the default scene
 	mpResManager->setDefaultSceneName("Scenes/pink_room/pink_room.fscene");
 
-	// Create compute shader from filename
-	mInitReservoirsPass.pComputeProgram = ComputeProgram::createFromFile(kFileInitReservoirs, "main");
-	
-	if (mInitReservoirsPass.pComputeProgram) {
-		mInitReservoirsPass.pComputeVars = ComputeVars::create(mInitReservoirsPass.pComputeProgram->getReflector());
-		//mInitReservoirsPass.pComputeVars->setStructuredBuffer("gLightGrid", mpAliveList);
-		
-		// Create state
-		mInitReservoirsPass.pComputeState = ComputeState::create();
-		mInitReservoirsPass.pComputeState->setProgram(mInitReservoirsPass.pComputeProgram);
-	}
+	// Create wrapper around ray tracing pass
+	mpRays = RayLaunch::create(kFileRayTrace, kEntryPointRayGen);
+
+	// Ray type 0 (shadow rays; not traced, but a ray tracing program needs a hit group)
+	mpRays->addMissShader(kFileRayTrace, kEntryPointMiss0);
+	mpRays->addHitShader(kFileRayTrace, kEntryShadowClosestHit, kEntryShadowAnyHit);
+
+	// Compile
+	mpRays->compileRayProgram();
+	if (mpScene) mpRays->setScene(mpScene);
 
 	return true;
 }
 
+bool BuildCellReservoirsPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	// The light grid is a buffer of its own;  we touch no channels
+	return true;
+}
+
 void BuildCellReservoirsPass::initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene)
 {
 	// Save copy of scene
 	if (pScene) {
 		mpScene = std::dynamic_pointer_cast<RtScene>(pScene);
 	}
+
+	// Cover the new scene with our grid
+	if (mpGrid) mpGrid->fitToScene(mpScene);
+
+	// Pass scene to ray tracer
+	if (mpRays) {
+		mpRays->setScene(mpScene);
+	}
 }
 
 void BuildCellReservoirsPass::renderGui(Gui* pGui)
 {
 	int dirty = 0;
-	// User-controlled max depth
-	dirty |= (int)pGui->addIntVar("Max Ray Depth", mRayDepth, 0, 8);
-	// Checkbox to determine if we are shooting indirect rays or not
-	//dirty |= (int)pGui->addCheckBox(mDoIndirectLighting ? "Enable Direct Illumination" : "Enable Indirect Illumination", mDoIndirectLighting);
+	if (mpGrid) dirty |= (int)mpGrid->renderGui(pGui, mpScene);
+
+	if (pGui->addButton("Validate Grid On CPU")) mValidateGrid = true;
+	if (!mValidationReport.empty()) pGui->addText(mValidationReport.c_str());
 	if (dirty) setRefreshFlag();
 }
 
 void BuildCellReservoirsPass::execute(RenderContext* pRenderContext)
 {
-	// Get output buffer and clear it to black
-	Texture::SharedPtr outTex = mpResManager->getClearedTexture(mOutChannel, vec4(0.f, 0.f, 0.f, 0.f));
-
 	// Check that pass is ready to render
-	if (!outTex) return;
+	if (!mpGrid || !mpRays || !mpRays->readyToRender()) return;
+
+	// Grid layout
+	auto globalVars = mpRays->getGlobalVars();
+	globalVars["GlobalCB"]["gFrameCount"] = mFrameCount;
+	globalVars["GlobalCB"]["gGridOrigin"] = mpGrid->getOrigin();
+	globalVars["GlobalCB"]["gGridCellSize"] = mpGrid->getCellSize();
+	globalVars["GlobalCB"]["gGridCellCount"] = ivec3(mpGrid->getCellCount());
+	globalVars["GlobalCB"]["gGridLightsPerCell"] = mpGrid->getLightsPerCell();
+	globalVars["GlobalCB"]["gCellCandidates"] = mpGrid->getCellCandidates();
+	mpGrid->setLastBuildFrame(mFrameCount++);
+
+	// Pass ReGIR grid structure for updating
+	TypedBufferBase::SharedPtr pLightGrid = mpGrid->getBuffer();
+	globalVars["gLightGrid"] = pLightGrid;
+
+	// Launch one thread per light slot
+	mpRays->execute(pRenderContext, uvec2(mpGrid->getLightsPerCell(), mpGrid->getCellTotal()));
+
+	if (mValidateGrid)
+	{
+		mValidateGrid = false;
+		validateGrid();
+	}
+}
+
+void BuildCellReservoirsPass::validateGrid()
+{
+	if (!mpScene) return;
+	if (!mpCpuReGIR) mpCpuReGIR = CpuReGIR::create();
 
-	// Launch compute shader
-	pRenderContext->pushComputeState(mInitReservoirsPass.pComputeState);
-	pRenderContext->pushComputeVars(mInitReservoirsPass.pComputeVars);
+	std::vector<LightData> lights;
+	for (const auto& pLight : mpScene->getLights())
+	{
+		lights.push_back(pLight->getData());
+	}
 
-	pRenderContext->dispatch(1, 1, 1); // TODO: change this to 16 x 16 x 16
+	// Read back what we just built (map() waits for the GPU)
+	TypedBuffer<vec4>::SharedPtr pLightGrid = mpGrid->getBuffer();
+	const vec4* pSlots = reinterpret_cast<const vec4*>(pLightGrid->map(Buffer::MapType::Read));
+	std::vector<vec4> gpuSlots(pSlots, pSlots + mpGrid->getSlotCount());
+	pLightGrid->unmap();
 
-	pRenderContext->popComputeVars();
-	pRenderContext->popComputeState();
-}
\ No newline at end of file
+	CpuReGIR::Report report = mpCpuReGIR->validate(*mpGrid, lights, gpuSlots);
+	mValidationReport = report.toString();
+	logInfo("BuildCellReservoirsPass: " + mValidationReport);
+}
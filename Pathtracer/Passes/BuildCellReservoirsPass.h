@@ -2,18 +2,22 @@
 
 #include "../SharedUtils/RenderPass.h"
 #include "../SharedUtils/RayLaunch.h"
+#include "../CpuRenderer/CpuReGIR.h"
+#include "ReGIRGrid.h"
 
+// Fills the ReGIR light grid each frame:  every light slot of every cell gets one RIS reservoir, resampled from all
+//     scene lights with respect to the cell's center.  SampleLightGridPass then resamples these per pixel.
 class BuildCellReservoirsPass : public ::RenderPass, inherit_shared_from_this<::RenderPass, BuildCellReservoirsPass>
 {
 public:
 	using SharedPtr = std::shared_ptr<BuildCellReservoirsPass>;
 	using SharedConstPtr = std::shared_ptr<const BuildCellReservoirsPass>;
 
-	static SharedPtr create(const std::string& outBuf) { return SharedPtr(new BuildCellReservoirsPass(outBuf)); }
+	static SharedPtr create(const ReGIRGrid::SharedPtr& pGrid) { return SharedPtr(new BuildCellReservoirsPass(pGrid)); }
 	virtual ~BuildCellReservoirsPass() = default;
 
 protected:
-	BuildCellReservoirsPass(const std::string& outBuf);
+	BuildCellReservoirsPass(const ReGIRGrid::SharedPtr& pGrid);
 
 	// RenderPass functionality
 	bool initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager) override;
@@ -24,25 +28,20 @@ protected:
 	// Override default RenderPass functionality (that control the rendering pipeline and its GUI)
 	bool requiresScene() override { return true; }       // Adds 'load scene' option to GUI.
 	bool usesRayTracing() override { return true; }      // Removes a GUI control that is confusing for this simple demo
-	bool usesEnvironmentMap() override { return true; }  // Use environment map to illuminate the scene
-	bool usesCompute() override { return true;  }        // Uses a compute pass to construct the world-space grid
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
+
+	// Read back the grid and compare it against the CPU implementation and brute force
+	void validateGrid();
 
 	// Internal state variables for this pass
-	RayLaunch::SharedPtr          mpRays;              ///< Wrapper around DXR pass
+	RayLaunch::SharedPtr          mpRays;              ///< Wrapper around DXR pass (one ray gen thread per light slot)
 	RtScene::SharedPtr            mpScene;             ///< Falcor scene representation, with additions for ray tracing
-	
-	int32_t                       mRayDepth = 1;       ///< Current max. ray depth
-
-	//ComputeVars::SharedPtr        mpComputeVars;       ///< Falcor compute vars representation
-	//ComputeState::SharedPtr       mpComputeState;      ///< Falcor compute state representation
+	ReGIRGrid::SharedPtr          mpGrid;              ///< The grid we fill (shared with SampleLightGridPass)
+	CpuReGIR::SharedPtr           mpCpuReGIR;          ///< CPU reference, created on first validation
 
-	struct
-	{
-		ComputeState::SharedPtr pComputeState;
-		ComputeProgram::SharedPtr pComputeProgram;
-		ComputeVars::SharedPtr pComputeVars;
-	} mInitReservoirsPass;
+	bool                          mValidateGrid = false;  ///< Validate after the next build?
+	std::string                   mValidationReport;
 
-	// Compute output channel
-	std::string                   mOutChannel;
+	// Counter to initialize random numbers each frame
+	uint32_t                      mFrameCount = 0x1456u;  ///< A frame counter to act as seed for random number generator 
 };
@@ -0,0 +1,453 @@
+#include "CpuReSTIRPass.h"
+
+namespace {
+	// The textures we fill in.  These are the same ones the GPU ReSTIR passes produce.
+	const std::pair<CpuReSTIRRenderer::BufferId, const char*> kOutputs[] = {
+		{ CpuReSTIRRenderer::BufferId::WorldPosition,   "WorldPosition" },
+		{ CpuReSTIRRenderer::BufferId::WorldNormal,     "WorldNormal" },
+		{ CpuReSTIRRenderer::BufferId::MaterialDiffuse, "MaterialDiffuse" },
+		{ CpuReSTIRRenderer::BufferId::MotionVectors,   "MotionVectors" },
+		{ CpuReSTIRRenderer::BufferId::PrevWorldNormal, "PrevWorldNormal" },
+		{ CpuReSTIRRenderer::BufferId::ShadedOutput,    "ShadedOutput" },
+	};
+};
+
+CpuReSTIRPass::CpuReSTIRPass(int spatialIterations, int denoiseIterations) :
+	mSpatialIterations(spatialIterations),
+	mDenoiseIterations(denoiseIterations),
+	::RenderPass("CPU ReSTIR Pass", "CPU ReSTIR Options")
+{
+}
+
+bool CpuReSTIRPass::initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager)
+{
+	// Stash a copy of our resource manager, allowing us to access shared rendering resources
+	mpResManager = pResManager;
+
+	// Request texture resources for this pass
+	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse", "ShadedOutput" });
+	mpResManager->requestTextureResources({ "MotionVectors", "PrevWorldNormal" });   // For the denoiser's reprojection
+	mpResManager->requestTextureResource(ResourceManager::kEnvironmentMap);          // For environment map candidates
+	if (mDenoiseIterations > 0) mpResManager->requestTextureResource("HDRColorOutput");   // When we denoise ourselves
+
+	// Set the default scene
+	mpResManager->setDefaultSceneName("Scenes/pink_room/pink_room.fscene");
+
+	return true;
+}
+
+bool CpuReSTIRPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	// Everything we upload is overwritten in full each frame
+	for (const auto& output : kOutputs)
+		usage.writes.push_back(output.second);
+	if (mDenoiseIterations > 0)
+		usage.writes.push_back("HDRColorOutput");
+	return true;
+}
+
+void CpuReSTIRPass::initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene)
+{
+	// Save copy of scene
+	if (pScene) {
+		mpScene = std::dynamic_pointer_cast<RtScene>(pScene);
+	}
+
+	// Read the scene back to the CPU and build our acceleration structure
+	mpCpuScene = CpuScene::create(mpScene, pRenderContext);
+	mpRenderer = CpuReSTIRRenderer::create(mpCpuScene);
+	if (mpRenderer)
+	{
+		mpDenoiser = CpuAtrousFilter::create(mpRenderer->getDispatch());
+		mpGI = CpuReSTIRGI::create(mpRenderer);
+		logInfo("CpuReSTIRPass: rendering with " + std::to_string(mpRenderer->getDispatch()->getThreadCount()) + " threads");
+	}
+}
+
+void CpuReSTIRPass::renderGui(Gui* pGui)
+{
+	int dirty = 0;
+	dirty |= (int)pGui->addIntVar("M", mLightSamples, 0, 32);
+	dirty |= (int)pGui->addIntVar("Spatial Neighbors", mSpatialNeighbors, 0, 100);
+	dirty |= (int)pGui->addIntVar("Spatial Radius", mSpatialRadius, 0, 100);
+	dirty |= (int)pGui->addIntVar("Spatial Iterations", mSpatialIterations, 1, 8);
+	dirty |= (int)pGui->addIntVar("Reservoirs Per Pixel", mReservoirsPerPixel, 1, int(ReservoirStore::kMaxReservoirsPerPixel));
+	dirty |= (int)pGui->addDropdown("Reservoir Format", mReservoirFormatList, mReservoirFormat);
+	dirty |= (int)pGui->addDropdown("Light Selection", mLightSelectionList, mLightSelection);
+	dirty |= (int)pGui->addDropdown("Sampler", SampleGenerator::getTypeList(), mSamplerType);
+	if (mpRenderer)
+	{
+		dirty |= (int)mpRenderer->getEnvMapSampler()->renderGui(pGui);
+		dirty |= (int)mpRenderer->getEmissiveLights()->renderGui(pGui);
+	}
+	if (mDenoiseIterations > 0 && mpDenoiser)
+	{
+		CpuAtrousFilter::Settings& denoise = mpDenoiser->getSettings();
+		dirty |= (int)pGui->addCheckBox("CPU Denoising", mDoDenoise);
+		dirty |= (int)pGui->addIntVar("Denoise Iterations", mDenoiseIterations, 1, 8);
+		dirty |= (int)pGui->addFloatVar("Color Weight", denoise.colorPhi, 0.f, 200.f);
+		dirty |= (int)pGui->addFloatVar("Normal Weight", denoise.normalPhi, 0.f, 10.f);
+		dirty |= (int)pGui->addFloatVar("Position Weight", denoise.positionPhi, 0.f, 10.f);
+		dirty |= (int)pGui->addCheckBox("SIMD Denoiser", denoise.useSimd);
+	}
+	if (mpRenderer)
+	{
+		pGui->addText(("Threads: " + std::to_string(mpRenderer->getDispatch()->getThreadCount())).c_str());
+		pGui->addText(("CPU frame time: " + std::to_string(mLastFrameTime) + " ms").c_str());
+		float frameMrays = (mLastFrameTime > 0.f) ? float(mpRenderer->getFrameRayCount()) / (mLastFrameTime * 1000.f) : 0.f;
+		pGui->addText(("Frame rays: " + std::to_string(mpRenderer->getFrameRayCount()) + " (" + std::to_string(frameMrays) + " Mrays/s)").c_str());
+		if (mDenoiseIterations > 0) pGui->addText(("CPU denoise time: " + std::to_string(mLastDenoiseTime) + " ms").c_str());
+
+		if (pGui->addButton("Benchmark rays")) mRunBenchmark = true;
+		pGui->addText(("  Primary (single): " + std::to_string(mBenchmark.primaryMraysPerSec) + " Mrays/s").c_str());
+		pGui->addText(("  Primary (2x2 packets): " + std::to_string(mBenchmark.primaryPacketMraysPerSec) + " Mrays/s").c_str());
+		pGui->addText(("  Shadow: " + std::to_string(mBenchmark.shadowMraysPerSec) + " Mrays/s").c_str());
+
+		if (pGui->addButton("Benchmark task scheduler")) mRunSchedulerBenchmark = true;
+		pGui->addText(("  Spawn: " + std::to_string(mSchedulerBenchmark.spawnNs) + " ns, steal: " + std::to_string(mSchedulerBenchmark.stealNs) +
+			" ns, parallelFor: " + std::to_string(mSchedulerBenchmark.parallelForUs) + " us").c_str());
+		for (const TaskScheduler::Benchmark::ScalingPoint& point : mSchedulerBenchmark.scaling)
+		{
+			pGui->addText(("  " + std::to_string(point.threadCount) + " threads: " + std::to_string(point.ms) + " ms (" + std::to_string(point.speedup) + "x)").c_str());
+		}
+
+		if (pGui->addButton("Benchmark light sampling")) mRunLightBenchmark = true;
+		pGui->addText(("  Alias table build (" + std::to_string(mLightBenchmark.tableLightCount) + " lights): " + std::to_string(mLightBenchmark.tableBuildMs) + " ms").c_str());
+		pGui->addText(("  Variance reduction vs. uniform: " + std::to_string(mLightBenchmark.aliasVarianceReduction) + "x power, " +
+			std::to_string(mLightBenchmark.bvhVarianceReduction) + "x light BVH").c_str());
+
+		if (pGui->addButton("Benchmark light BVH")) mRunLightBvhBenchmark = true;
+		for (const LightBvh::Benchmark& bench : mLightBvhBenchmarks)
+		{
+			pGui->addText(("  " + std::to_string(bench.lightCount) + " lights:  build " + std::to_string(bench.buildMs) + " ms, refit " +
+				std::to_string(bench.refitMs) + " ms, sample " + std::to_string(bench.sampleNs) + " ns").c_str());
+		}
+
+		if (pGui->addButton("Benchmark samplers")) mRunSamplerBenchmark = true;
+		for (const SampleGenerator::Benchmark& bench : mSamplerBenchmarks)
+		{
+			pGui->addText(("  " + std::string(SampleGenerator::getTypeName(bench.type)) + ":  discrepancy " + std::to_string(bench.discrepancy) +
+				", error slope " + std::to_string(bench.smoothSlope) + " smooth, " + std::to_string(bench.edgeSlope) + " edge").c_str());
+		}
+
+		if (pGui->addButton("Benchmark reservoirs")) mRunReservoirBenchmark = true;
+		pGui->addText(("  1 per pixel: " + std::to_string(mReservoirBenchmark.baseBytesPerPixel) + " B/pixel, " +
+			std::to_string(mReservoirBenchmark.baseMsPerFrame) + " ms, error " + std::to_string(mReservoirBenchmark.baseError)).c_str());
+		pGui->addText(("  " + std::to_string(mReservoirBenchmark.reservoirsPerPixel) + " per pixel: " + std::to_string(mReservoirBenchmark.bytesPerPixel) + " B/pixel, " +
+			std::to_string(mReservoirBenchmark.msPerFrame) + " ms, error " + std::to_string(mReservoirBenchmark.error)).c_str());
+
+		if (pGui->addButton("Benchmark reservoir encoding")) mRunEncodingBenchmark = true;
+		pGui->addText(("  Compact round trip: max error " + std::to_string(mEncodingBenchmark.maxWError) + " (W), " + std::to_string(mEncodingBenchmark.maxMError) + " (M)").c_str());
+		pGui->addText(("  1080p traffic: " + std::to_string(mEncodingBenchmark.fullMBPerFrame) + " MB full, " + std::to_string(mEncodingBenchmark.compactMBPerFrame) + " MB compact").c_str());
+
+		if (pGui->addButton("Benchmark bias")) mRunBiasBenchmark = true;
+		pGui->addText(("  Biased: " + std::to_string(mBiasBenchmark.biasedMsPerFrame) + " ms, bias " + std::to_string(mBiasBenchmark.biasedBias)).c_str());
+		pGui->addText(("  Unbiased: " + std::to_string(mBiasBenchmark.unbiasedMsPerFrame) + " ms, bias " + std::to_string(mBiasBenchmark.unbiasedBias)).c_str());
+		pGui->addText(("  Unbiased + visibility: " + std::to_string(mBiasBenchmark.visibilityMsPerFrame) + " ms, bias " + std::to_string(mBiasBenchmark.visibilityBias)).c_str());
+
+		if (pGui->addButton("Benchmark adaptive sampling")) mRunAdaptiveBenchmark = true;
+		pGui->addText(("  Uniform: " + std::to_string(mAdaptiveBenchmark.uniformMs) + " ms, " + std::to_string(mAdaptiveBenchmark.uniformSamplesPerPixel) +
+			" samples/pixel, error " + std::to_string(mAdaptiveBenchmark.uniformError)).c_str());
+		pGui->addText(("  Adaptive: " + std::to_string(mAdaptiveBenchmark.adaptiveMs) + " ms, " + std::to_string(mAdaptiveBenchmark.adaptiveSamplesPerPixel) +
+			" samples/pixel, error " + std::to_string(mAdaptiveBenchmark.adaptiveError)).c_str());
+
+		if (pGui->addButton("Benchmark ReSTIR GI")) mRunGIBenchmark = true;
+		if (!mGIBenchmark.restirGI.empty())
+		{
+			const CpuReSTIRGI::ConvergencePoint& full = mGIBenchmark.fullGI.back();
+			const CpuReSTIRGI::ConvergencePoint& gi = mGIBenchmark.restirGI.back();
+			pGui->addText(("  fullGI: error " + std::to_string(full.error) + " at " + std::to_string(full.raysPerPixel) + " rays/pixel").c_str());
+			pGui->addText(("  ReSTIR GI: error " + std::to_string(gi.error) + " at " + std::to_string(gi.raysPerPixel) + " rays/pixel (" +
+				std::to_string(mGIBenchmark.efficiencyGain) + "x efficiency)").c_str());
+		}
+
+		if (pGui->addButton("Benchmark SIMD denoiser")) mRunDenoiseBenchmark = true;
+		pGui->addText(("  Scalar: " + std::to_string(mDenoiseBenchmark.scalarMs) + " ms, SIMD: " + std::to_string(mDenoiseBenchmark.simdMs) + " ms, " +
+			std::to_string(mDenoiseBenchmark.difference.mismatches) + " pixels differ").c_str());
+
+		if (pGui->addButton("Validate reprojection")) mRunReprojectionValidation = true;
+		pGui->addText(("  Motion vectors: " + std::to_string(mReprojection.accepted) + " of " + std::to_string(mReprojection.pixels) + " pixels kept, " +
+			std::to_string(mReprojection.falseAccepts) + " wrongly").c_str());
+		pGui->addText(("  Camera matrix only: " + std::to_string(mReprojection.cameraOnlyAccepted) + " kept, " + std::to_string(mReprojection.cameraOnlyFalseAccepts) + " wrongly").c_str());
+
+		// Snapshot for headless batch rendering (see BatchRenderer), next to the scene file
+		if (pGui->addButton("Save CPU scene") && mpScene)
+		{
+			const std::string& sceneFile = mpScene->getFilename();
+			std::string snapshotFile = sceneFile.substr(0, sceneFile.find_last_of('.')) + ".cpuscene";
+			mSavedSnapshot = mpCpuScene->save(snapshotFile) ? snapshotFile : "";
+			if (!mSavedSnapshot.empty()) logInfo("CpuReSTIRPass: saved " + mSavedSnapshot);
+		}
+		if (!mSavedSnapshot.empty()) pGui->addText(("  Saved " + mSavedSnapshot).c_str());
+	}
+	if (dirty) setRefreshFlag();
+}
+
+void CpuReSTIRPass::execute(RenderContext* pRenderContext)
+{
+	// Check that pass is ready to render
+	if (!mpRenderer || !mpScene || !mpScene->getActiveCamera()) return;
+
+	// Our screen-sized buffers need to track the window size
+	uvec2 screenSize = mpResManager->getScreenSize();
+	if (mpRenderer->getScreenSize() != screenSize) mpRenderer->resize(screenSize);
+
+	// Same controls the GPU passes read from the resource manager
+	CpuReSTIRRenderer::Settings& settings = mpRenderer->getSettings();
+	settings.minT = mpResManager->getMinTDist();
+	settings.enableWeightedRIS = mpResManager->getWeightedRIS();
+	settings.doTemporalReuse = mpResManager->getTemporal();
+	settings.doSpatialReuse = mpResManager->getSpatial();
+	settings.unbiased = mpResManager->getUnbiased();
+	settings.unbiasedVisibility = mpResManager->getUnbiasedVisibility();
+	settings.lightSamples = mLightSamples;
+	settings.spatialNeighbors = mSpatialNeighbors;
+	settings.spatialRadius = mSpatialRadius;
+	settings.spatialIterations = mSpatialIterations;
+	settings.lightSelection = LightSelection(mLightSelection);
+	settings.samplerType = mSamplerType;
+	settings.reservoirsPerPixel = uint32_t(mReservoirsPerPixel);
+	settings.reservoirFormat = ReservoirStore::Format(mReservoirFormat);
+
+	// Lights may have been edited via the GUI
+	mpCpuScene->refreshLights();
+
+	// Environment map cells as candidates, rebuilt if the map changed (as CreateLightSamplesPass does)
+	const EnvMapSampler::SharedPtr& pEnvSampler = mpRenderer->getEnvMapSampler();
+	if (pEnvSampler->isEnabled()) pEnvSampler->update(pRenderContext, mpResManager->getTexture(ResourceManager::kEnvironmentMap));
+
+	// Emissive triangles as candidates, extracted again when the scene changes
+	const EmissiveLights::SharedPtr& pEmissiveLights = mpRenderer->getEmissiveLights();
+	if (pEmissiveLights->isEnabled()) pEmissiveLights->update(pRenderContext, mpScene);
+
+	if (mRunBenchmark)
+	{
+		mRunBenchmark = false;
+		mBenchmark = mpRenderer->benchmarkRays(mpScene->getActiveCamera()->getData());
+		logInfo("CpuReSTIRPass: " + std::to_string(mpCpuScene->getTriangleCount()) + " triangles at " +
+			std::to_string(screenSize.x) + "x" + std::to_string(screenSize.y) + ", " +
+			std::to_string(mpRenderer->getDispatch()->getThreadCount()) + " threads:  primary " +
+			std::to_string(mBenchmark.primaryMraysPerSec) + " Mrays/s, primary 2x2 packets " +
+			std::to_string(mBenchmark.primaryPacketMraysPerSec) + " Mrays/s, shadow " +
+			std::to_string(mBenchmark.shadowMraysPerSec) + " Mrays/s");
+	}
+
+	if (mRunSchedulerBenchmark)
+	{
+		mRunSchedulerBenchmark = false;
+		mSchedulerBenchmark = TaskScheduler::benchmark(mpRenderer->getDispatch()->getThreadCount() - 1);
+		std::string scaling;
+		for (const TaskScheduler::Benchmark::ScalingPoint& point : mSchedulerBenchmark.scaling)
+		{
+			scaling += (scaling.empty() ? "" : ", ") + std::to_string(point.threadCount) + " threads " + std::to_string(point.speedup) + "x";
+		}
+		logInfo("CpuReSTIRPass: task scheduler with " + std::to_string(mSchedulerBenchmark.threadCount) + " threads:  spawn " +
+			std::to_string(mSchedulerBenchmark.spawnNs) + " ns, steal " + std::to_string(mSchedulerBenchmark.stealNs) + " ns per task, empty parallelFor " +
+			std::to_string(mSchedulerBenchmark.parallelForUs) + " us;  speedup " + scaling);
+	}
+
+	if (mRunLightBenchmark)
+	{
+		mRunLightBenchmark = false;
+		mLightBenchmark = mpRenderer->benchmarkLightSampling(mpScene->getActiveCamera()->getData());
+		logInfo("CpuReSTIRPass: alias table over " + std::to_string(mLightBenchmark.tableLightCount) + " lights built in " +
+			std::to_string(mLightBenchmark.tableBuildMs) + " ms (max pdf error " + std::to_string(mLightBenchmark.tableMaxPdfError) + ");  " +
+			"M = " + std::to_string(mLightSamples) + " over " + std::to_string(mLightBenchmark.pixels) + " pixels:  relative variance " +
+			std::to_string(mLightBenchmark.uniformVariance) + " uniform, " + std::to_string(mLightBenchmark.aliasVariance) + " power-based (" +
+			std::to_string(mLightBenchmark.aliasVarianceReduction) + "x lower), " + std::to_string(mLightBenchmark.bvhVariance) + " light BVH (" +
+			std::to_string(mLightBenchmark.bvhVarianceReduction) + "x lower)");
+	}
+
+	if (mRunLightBvhBenchmark)
+	{
+		mRunLightBvhBenchmark = false;
+		mLightBvhBenchmarks.clear();
+		for (uint32_t lightCount : { 10000u, 100000u, 1000000u })
+		{
+			LightBvh::Benchmark bench = LightBvh::benchmark(lightCount);
+			mLightBvhBenchmarks.push_back(bench);
+			logInfo("CpuReSTIRPass: light BVH over " + std::to_string(bench.lightCount) + " lights (" + std::to_string(bench.nodeCount) + " nodes):  build " +
+				std::to_string(bench.buildMs) + " ms, refit " + std::to_string(bench.refitMs) + " ms, sample " + std::to_string(bench.sampleNs) +
+				" ns (" + std::to_string(bench.avgDepth) + " levels)");
+		}
+	}
+
+	if (mRunSamplerBenchmark)
+	{
+		mRunSamplerBenchmark = false;
+		mSamplerBenchmarks = SampleGenerator::benchmark();
+		for (const SampleGenerator::Benchmark& bench : mSamplerBenchmarks)
+		{
+			logInfo("CpuReSTIRPass: " + std::string(SampleGenerator::getTypeName(bench.type)) + " sampler over " + std::to_string(bench.pixels) + " pixels x " +
+				std::to_string(bench.samples) + " spp:  L2-star discrepancy " + std::to_string(bench.discrepancy) + " (" + std::to_string(bench.domainDiscrepancy) +
+				" across domains), RMSE slope " + std::to_string(bench.smoothSlope) + " smooth / " + std::to_string(bench.edgeSlope) + " edge, RMSE " +
+				std::to_string(bench.smoothError) + " / " + std::to_string(bench.edgeError) + ", " + std::to_string(bench.nsPerSample) + " ns per sample");
+		}
+	}
+
+	if (mRunReservoirBenchmark)
+	{
+		mRunReservoirBenchmark = false;
+		mReservoirBenchmark = mpRenderer->benchmarkReservoirs(mpScene->getActiveCamera()->getData(), uint32_t(mReservoirsPerPixel));
+		const CpuReSTIRRenderer::ReservoirBenchmark& bench = mReservoirBenchmark;
+		logInfo("CpuReSTIRPass: " + std::to_string(bench.frames) + " frames at " + std::to_string(screenSize.x) + "x" + std::to_string(screenSize.y) +
+			":  1 reservoir per pixel " + std::to_string(bench.baseBytesPerPixel) + " B/pixel, " + std::to_string(bench.baseMsPerFrame) + " ms, relative RMSE " +
+			std::to_string(bench.baseError) + ";  " + std::to_string(bench.reservoirsPerPixel) + " reservoirs per pixel " + std::to_string(bench.bytesPerPixel) +
+			" B/pixel, " + std::to_string(bench.msPerFrame) + " ms, relative RMSE " + std::to_string(bench.error));
+	}
+
+	if (mRunEncodingBenchmark)
+	{
+		mRunEncodingBenchmark = false;
+		mEncodingBenchmark = mpRenderer->benchmarkReservoirEncoding(mpScene->getActiveCamera()->getData());
+		const CpuReSTIRRenderer::ReservoirEncodingBenchmark& bench = mEncodingBenchmark;
+		logInfo("CpuReSTIRPass: compact reservoirs over " + std::to_string(bench.samples) + " round trips:  max relative error " +
+			std::to_string(bench.maxWError) + " (W), " + std::to_string(bench.maxMError) + " (M), " + std::to_string(bench.lightIdErrors) + " light ID errors;  " +
+			std::to_string(bench.frames) + " frames:  full " + std::to_string(bench.fullMBPerFrame) + " MB per 1080p frame, " + std::to_string(bench.fullMsPerFrame) +
+			" ms, relative RMSE " + std::to_string(bench.fullError) + ";  compact " + std::to_string(bench.compactMBPerFrame) + " MB per 1080p frame, " +
+			std::to_string(bench.compactMsPerFrame) + " ms, relative RMSE " + std::to_string(bench.compactError));
+	}
+
+	if (mRunBiasBenchmark)
+	{
+		mRunBiasBenchmark = false;
+		mBiasBenchmark = mpRenderer->benchmarkBias(mpScene->getActiveCamera()->getData());
+		const CpuReSTIRRenderer::BiasBenchmark& bench = mBiasBenchmark;
+		logInfo("CpuReSTIRPass: mean of " + std::to_string(bench.frames) + " frames at " + std::to_string(screenSize.x) + "x" + std::to_string(screenSize.y) +
+			" vs. reference:  biased " + std::to_string(bench.biasedMsPerFrame) + " ms, bias " + std::to_string(bench.biasedBias) + ", relative RMSE " +
+			std::to_string(bench.biasedError) + ";  unbiased " + std::to_string(bench.unbiasedMsPerFrame) + " ms, bias " + std::to_string(bench.unbiasedBias) +
+			", relative RMSE " + std::to_string(bench.unbiasedError) + ";  unbiased with visibility " + std::to_string(bench.visibilityMsPerFrame) + " ms, bias " +
+			std::to_string(bench.visibilityBias) + ", relative RMSE " + std::to_string(bench.visibilityError));
+	}
+
+	if (mRunAdaptiveBenchmark)
+	{
+		mRunAdaptiveBenchmark = false;
+		mAdaptiveBenchmark = mpRenderer->benchmarkAdaptiveSampling(mpScene->getActiveCamera()->getData());
+		const CpuReSTIRRenderer::AdaptiveSamplingBenchmark& bench = mAdaptiveBenchmark;
+		logInfo("CpuReSTIRPass: time to relative RMSE " + std::to_string(bench.targetError) + " over " + std::to_string(bench.pixels) + " pixels:  uniform " +
+			std::to_string(bench.uniformFrames) + " frames, " + std::to_string(bench.uniformMs) + " ms, " + std::to_string(bench.uniformSamplesPerPixel) +
+			" samples/pixel, error " + std::to_string(bench.uniformError) + ";  adaptive " + std::to_string(bench.adaptiveFrames) + " frames, " +
+			std::to_string(bench.adaptiveMs) + " ms, " + std::to_string(bench.adaptiveSamplesPerPixel) + " samples/pixel, error " +
+			std::to_string(bench.adaptiveError) + ", " + std::to_string(bench.convergedPixels) + " pixels converged;  speedup " + std::to_string(bench.speedup) + "x");
+	}
+
+	if (mRunReprojectionValidation)
+	{
+		mRunReprojectionValidation = false;
+		mReprojection = mpRenderer->validateReprojection(getCameraPath(kReprojectionFrames));
+		const CpuReSTIRRenderer::ReprojectionValidation& result = mReprojection;
+		logInfo("CpuReSTIRPass: reprojection over " + std::to_string(result.frames) + " camera moves, " + std::to_string(result.pixels) + " pixels (" +
+			std::to_string(result.visible) + " seen last frame):  motion vectors keep " + std::to_string(result.accepted) + ", " + std::to_string(result.falseAccepts) +
+			" wrongly, and drop " + std::to_string(result.falseRejects) + " wrongly, motion error " + std::to_string(result.meanMotionError) + " pixels, position error " +
+			std::to_string(result.meanPositionError) + ";  camera matrix only keeps " + std::to_string(result.cameraOnlyAccepted) + ", " +
+			std::to_string(result.cameraOnlyFalseAccepts) + " wrongly, position error " + std::to_string(result.cameraOnlyPositionError));
+	}
+
+	if (mRunGIBenchmark && mpGI)
+	{
+		mRunGIBenchmark = false;
+		CpuReSTIRGI::Settings& giSettings = mpGI->getSettings();
+		giSettings.doTemporalReuse = mpResManager->getTemporal();
+		giSettings.doSpatialReuse = mpResManager->getSpatial();
+		mGIBenchmark = mpGI->benchmarkConvergence(mpScene->getActiveCamera()->getData());
+		const CpuReSTIRGI::ConvergenceBenchmark& bench = mGIBenchmark;
+		std::string points;
+		for (size_t i = 0; i < bench.restirGI.size(); i++)
+		{
+			points += "\n  " + std::to_string(bench.fullGI[i].frames) + " frames:  fullGI " + std::to_string(bench.fullGI[i].raysPerPixel) + " rays/pixel, relative RMSE " +
+				std::to_string(bench.fullGI[i].error) + ";  ReSTIR GI " + std::to_string(bench.restirGI[i].raysPerPixel) + " rays/pixel, relative RMSE " +
+				std::to_string(bench.restirGI[i].error);
+		}
+		logInfo("CpuReSTIRPass: ReSTIR GI vs. fullGI over " + std::to_string(bench.pixels) + " pixels (reference of " + std::to_string(bench.referenceSamples) +
+			" samples):  fullGI " + std::to_string(bench.fullGIMsPerFrame) + " ms, ReSTIR GI " + std::to_string(bench.restirGIMsPerFrame) + " ms, " +
+			std::to_string(bench.efficiencyGain) + "x efficiency" + points);
+	}
+
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+	mpRenderer->renderFrame(mpScene->getActiveCamera()->getData());
+	mLastFrameTime = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+
+	// Upload our results so the downstream GPU passes can consume them
+	for (const auto& output : kOutputs)
+	{
+		Texture::SharedPtr pTex = mpResManager->getTexture(output.second);
+		if (pTex) pRenderContext->updateTextureData(pTex.get(), mpRenderer->getBuffer(output.first).data());
+	}
+
+	// Stand in for the DenoisingPasses, if there are none
+	const std::vector<vec4>& shaded = mpRenderer->getBuffer(CpuReSTIRRenderer::BufferId::ShadedOutput);
+	const std::vector<vec4>& position = mpRenderer->getBuffer(CpuReSTIRRenderer::BufferId::WorldPosition);
+	const std::vector<vec4>& normal = mpRenderer->getBuffer(CpuReSTIRRenderer::BufferId::WorldNormal);
+	if (mDenoiseIterations > 0)
+	{
+		Texture::SharedPtr pTex = mpResManager->getTexture("HDRColorOutput");
+		if (pTex && mDoDenoise && mpResManager->getDenoising())
+		{
+			start = CpuTimer::getCurrentTimePoint();
+			mpDenoiser->getSettings().iterations = uint32_t(mDenoiseIterations);
+			mpDenoiser->filter(screenSize, shaded, position, normal, mDenoised);
+			mLastDenoiseTime = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+			pRenderContext->updateTextureData(pTex.get(), mDenoised.data());
+		}
+		else if (pTex) pRenderContext->updateTextureData(pTex.get(), shaded.data());
+	}
+
+	if (mRunDenoiseBenchmark)
+	{
+		mRunDenoiseBenchmark = false;
+		if (mDenoiseIterations > 0) mpDenoiser->getSettings().iterations = uint32_t(mDenoiseIterations);
+		mDenoiseBenchmark = mpDenoiser->benchmarkSimd(screenSize, shaded, position, normal);
+		const CpuAtrousFilter::SimdBenchmark& bench = mDenoiseBenchmark;
+		logInfo("CpuReSTIRPass: a-trous denoiser at " + std::to_string(screenSize.x) + "x" + std::to_string(screenSize.y) + ", " +
+			std::to_string(mpDenoiser->getSettings().iterations) + " iterations:  scalar " + std::to_string(bench.scalarMs) + " ms, SIMD " +
+			std::to_string(bench.simdMs) + " ms, " + std::to_string(bench.difference.mismatches) + " of " + std::to_string(bench.difference.pixels) +
+			" pixels differ (max " + std::to_string(bench.difference.maxUlps) + " ulps)");
+	}
+}
+
+std::vector<CameraData> CpuReSTIRPass::getCameraPath(uint32_t frames) const
+{
+	const Camera::SharedPtr& pActiveCamera = mpScene->getActiveCamera();
+
+	// Follow the scene's first path if it has one.  Otherwise circle the active camera around its target.
+	ObjectPath::SharedPtr pPath = ObjectPath::create();
+	float duration = 0.f;
+	if (mpScene->getPathCount() > 0 && mpScene->getPath(0)->getKeyFrameCount() > 1)
+	{
+		const ObjectPath::SharedPtr& pScenePath = mpScene->getPath(0);
+		for (uint32_t i = 0; i < pScenePath->getKeyFrameCount(); i++)
+		{
+			const ObjectPath::Frame& frame = pScenePath->getKeyFrame(i);
+			pPath->addKeyFrame(frame.time, frame.position, frame.target, frame.up);
+		}
+		duration = pScenePath->getKeyFrame(pScenePath->getKeyFrameCount() - 1).time;
+	}
+	else
+	{
+		vec3 target = pActiveCamera->getTarget(), up = pActiveCamera->getUpVector();
+		vec3 offset = pActiveCamera->getPosition() - target;
+		for (uint32_t i = 0; i <= 4; i++)
+		{
+			float angle = float(M_PI) * 0.25f * float(i) / 4.f;   // A quarter turn (sideways and back) over the path
+			pPath->addKeyFrame(float(i), target + vec3(glm::rotate(mat4(), angle, up) * vec4(offset, 0.f)), target, up);
+		}
+		duration = 4.f;
+	}
+
+	// Sample it with a camera matching the active one (without jitter, so the motion is only the path's)
+	Camera::SharedPtr pCamera = Camera::create();
+	pCamera->setAspectRatio(pActiveCamera->getAspectRatio());
+	pCamera->setFocalLength(pActiveCamera->getFocalLength());
+	pCamera->setFrameHeight(pActiveCamera->getFrameHeight());
+	pCamera->setDepthRange(pActiveCamera->getNearPlane(), pActiveCamera->getFarPlane());
+	pPath->attachObject(pCamera);
+
+	std::vector<CameraData> cameras;
+	for (uint32_t f = 0; f < frames; f++)
+	{
+		pPath->animate(double(duration) * f / std::max(1u, frames - 1));
+		cameras.push_back(pCamera->getData());
+	}
+	return cameras;
+}
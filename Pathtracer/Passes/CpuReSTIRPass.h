@@ -0,0 +1,114 @@
+#pragma once
+
+#include "../SharedUtils/RenderPass.h"
+#include "../CpuRenderer/CpuReSTIRRenderer.h"
+#include "../CpuRenderer/CpuReSTIRGI.h"
+#include "../CpuRenderer/CpuAtrousFilter.h"
+
+// Runs the whole ReSTIR chain (G-buffer, light samples, spatial reuse, shading) on the CPU via CpuReSTIRRenderer,
+//     then uploads the G-buffer and "ShadedOutput" so the rest of the pipeline (denoising, tone mapping) is unchanged.
+//     Given denoising iterations, it also runs the a-trous denoiser itself (CpuAtrousFilter) and writes "HDRColorOutput",
+//     standing in for the DenoisingPasses.
+class CpuReSTIRPass : public ::RenderPass, inherit_shared_from_this<::RenderPass, CpuReSTIRPass>
+{
+public:
+	using SharedPtr = std::shared_ptr<CpuReSTIRPass>;
+	using SharedConstPtr = std::shared_ptr<const CpuReSTIRPass>;
+
+	static SharedPtr create(int spatialIterations = 1, int denoiseIterations = 0) { return SharedPtr(new CpuReSTIRPass(spatialIterations, denoiseIterations)); }
+	virtual ~CpuReSTIRPass() = default;
+
+protected:
+	CpuReSTIRPass(int spatialIterations, int denoiseIterations);
+
+	// RenderPass functionality
+	bool initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager) override;
+	void initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene) override;
+	void renderGui(Gui* pGui) override;
+	void execute(RenderContext* pRenderContext) override;
+
+	// <frames> cameras along the scene's first path, or around the active camera's target if it has none
+	std::vector<CameraData> getCameraPath(uint32_t frames) const;
+
+	// Override default RenderPass functionality (that control the rendering pipeline and its GUI)
+	bool requiresScene() override { return true; }       // Adds 'load scene' option to GUI.
+	bool usesRayTracing() override { return true; }      // Removes a GUI control that is confusing for this simple demo
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
+
+	// Internal state variables for this pass
+	RtScene::SharedPtr            mpScene;             ///< Falcor scene representation, with additions for ray tracing
+	CpuScene::SharedPtr           mpCpuScene;          ///< CPU copy of the scene's geometry, materials, and lights
+	CpuReSTIRRenderer::SharedPtr  mpRenderer;          ///< Does all the actual work
+	CpuAtrousFilter::SharedPtr    mpDenoiser;          ///< Denoises on the CPU (with mDenoiseIterations > 0), and for the SIMD benchmark
+	CpuReSTIRGI::SharedPtr        mpGI;                ///< ReSTIR GI on top of mpRenderer, for the convergence benchmark
+
+	// User controls (mirroring the GPU passes' GUIs)
+	int32_t                       mLightSamples = 32;
+	int32_t                       mSpatialNeighbors = 5;
+	int32_t                       mSpatialRadius = 30;
+	int32_t                       mSpatialIterations = 1;
+	int32_t                       mReservoirsPerPixel = 1;
+	uint32_t                      mReservoirFormat = uint32_t(ReservoirStore::Format::Full);
+	Gui::DropdownList             mReservoirFormatList = { { uint32_t(ReservoirStore::Format::Full), "Full (16 bytes)" }, { uint32_t(ReservoirStore::Format::Compact), "Compact (8 bytes)" } };
+	uint32_t                      mLightSelection = uint32_t(LightSelection::AliasTable);
+	Gui::DropdownList             mLightSelectionList = { { uint32_t(LightSelection::Uniform), "Uniform" }, { uint32_t(LightSelection::AliasTable), "Light power" }, { uint32_t(LightSelection::Bvh), "Light BVH" } };
+	uint32_t                      mSamplerType = uint32_t(SampleGenerator::Type::Sobol);
+
+	int32_t                       mDenoiseIterations = 0;   ///< A-trous iterations we run ourselves (0:  the DenoisingPasses do)
+	bool                          mDoDenoise = true;
+	float                         mLastFrameTime = 0.f; ///< CPU render time of the last frame (ms)
+	float                         mLastDenoiseTime = 0.f;   ///< CPU denoising time of the last frame (ms)
+	std::vector<vec4>             mDenoised;
+
+	// Ray tracing throughput, measured on request from the GUI
+	bool                          mRunBenchmark = false;
+	CpuReSTIRRenderer::RayBenchmark mBenchmark;
+
+	// Power-based and light BVH vs. uniform light selection, measured on request from the GUI
+	bool                          mRunLightBenchmark = false;
+	CpuReSTIRRenderer::LightSamplingBenchmark mLightBenchmark;
+
+	// Light BVH build / refit / sampling cost over synthetic light counts, measured on request from the GUI
+	bool                          mRunLightBvhBenchmark = false;
+	std::vector<LightBvh::Benchmark> mLightBvhBenchmarks;
+
+	// Discrepancy and convergence of each sample sequence, measured on request from the GUI
+	bool                          mRunSamplerBenchmark = false;
+	std::vector<SampleGenerator::Benchmark> mSamplerBenchmarks;
+
+	// N vs. one reservoir per pixel (N = mReservoirsPerPixel), measured on request from the GUI
+	bool                          mRunReservoirBenchmark = false;
+	CpuReSTIRRenderer::ReservoirBenchmark mReservoirBenchmark;
+
+	// Compact vs. full reservoir format, measured on request from the GUI
+	bool                          mRunEncodingBenchmark = false;
+	CpuReSTIRRenderer::ReservoirEncodingBenchmark mEncodingBenchmark;
+
+	// Bias and cost of biased vs. unbiased reuse, measured on request from the GUI
+	bool                          mRunBiasBenchmark = false;
+	CpuReSTIRRenderer::BiasBenchmark mBiasBenchmark;
+
+	// Time to a target error with adaptive vs. uniform sampling, measured on request from the GUI
+	bool                          mRunAdaptiveBenchmark = false;
+	CpuReSTIRRenderer::AdaptiveSamplingBenchmark mAdaptiveBenchmark;
+
+	// ReSTIR GI vs. fullGI convergence per ray, measured on request from the GUI
+	bool                          mRunGIBenchmark = false;
+	CpuReSTIRGI::ConvergenceBenchmark mGIBenchmark;
+
+	// SIMD vs. scalar CPU denoising, measured on request from the GUI
+	bool                          mRunDenoiseBenchmark = false;
+	CpuAtrousFilter::SimdBenchmark mDenoiseBenchmark;
+
+	// Task scheduler overhead and scaling, measured on request from the GUI
+	bool                          mRunSchedulerBenchmark = false;
+	TaskScheduler::Benchmark      mSchedulerBenchmark;
+
+	// Motion vector vs. camera matrix reprojection along a camera path, checked on request from the GUI
+	static const uint32_t         kReprojectionFrames = 64;
+	bool                          mRunReprojectionValidation = false;
+	CpuReSTIRRenderer::ReprojectionValidation mReprojection;
+
+	// Where the GUI last saved a CpuScene snapshot for batch rendering
+	std::string                   mSavedSnapshot;
+};
@@ -0,0 +1,111 @@
+#include "CreateGISamplesPass.h"
+
+namespace {
+	const char* kFileRayTrace = "Shaders\\createGISamples.hlsl";
+
+	// Function names for shader entry points
+	const char* kEntryPointRayGen = "CreateGISamplesRayGen";
+
+	const char* kEntryPointMiss0 = "ShadowMiss";
+	const char* kEntryShadowAnyHit = "ShadowAnyHit";
+	const char* kEntryShadowClosestHit = "ShadowClosestHit";
+
+	const char* kEntryPointMiss1 = "GISampleMiss";
+	const char* kEntryGISampleAnyHit = "GISampleAnyHit";
+	const char* kEntryGISampleClosestHit = "GISampleClosestHit";
+};
+
+CreateGISamplesPass::CreateGISamplesPass(const ReservoirStore::SharedPtr& pReservoirs, const EnvMapSampler::SharedPtr& pEnvSampler) :
+	mpReservoirs(pReservoirs),
+	mpEnvSampler(pEnvSampler),
+	::RenderPass("Create GI Samples Pass", "Create GI Samples Options")
+{
+}
+
+bool CreateGISamplesPass::initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager)
+{
+	// Stash a copy of our resource manager, allowing us to access shared rendering resources
+	mpResManager = pResManager;
+
+	// Request texture resources for this pass
+	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse" });
+	mpResManager->requestTextureResources({ "PrevWorldNormal", "MotionVectors" });   // Kept by RayTracedGBufferPass
+	mpResManager->requestTextureResource(ResourceManager::kEnvironmentMap);
+
+	// Set the default scene
+	mpResManager->setDefaultSceneName("Scenes/pink_room/pink_room.fscene");
+
+	// Create wrapper around ray tracing pass
+	mpRays = RayLaunch::create(kFileRayTrace, kEntryPointRayGen);
+
+	// Ray type 0 (shadow rays)
+	mpRays->addMissShader(kFileRayTrace, kEntryPointMiss0);
+	mpRays->addHitShader(kFileRayTrace, kEntryShadowClosestHit, kEntryShadowAnyHit);
+
+	// Ray type 1 (bounce rays, which just report what they hit)
+	mpRays->addMissShader(kFileRayTrace, kEntryPointMiss1);
+	mpRays->addHitShader(kFileRayTrace, kEntryGISampleClosestHit, kEntryGISampleAnyHit);
+
+	// Compile
+	mpRays->compileRayProgram();
+	mpRays->setMaxRecursionDepth(1u);   // Further bounces are traced from the ray generation shader
+	if (mpScene) mpRays->setScene(mpScene);
+
+	return true;
+}
+
+bool CreateGISamplesPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	usage.reads = { "WorldPosition", "WorldNormal", "PrevWorldNormal", "MotionVectors" };
+	return true;
+}
+
+void CreateGISamplesPass::initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene)
+{
+	// Save copy of scene
+	if (pScene) {
+		mpScene = std::dynamic_pointer_cast<RtScene>(pScene);
+	}
+
+	// Pass scene to ray tracer
+	if (mpRays) {
+		mpRays->setScene(mpScene);
+	}
+}
+
+void CreateGISamplesPass::renderGui(Gui* pGui)
+{
+	int dirty = 0;
+	dirty |= (int)pGui->addIntVar("Max Ray Depth", mRayDepth, 1, mMaxRayDepth);
+	dirty |= (int)pGui->addIntVar("Temporal M Cap", mMaxTemporalM, 1, 500);
+	if (dirty) setRefreshFlag();
+}
+
+void CreateGISamplesPass::execute(RenderContext* pRenderContext)
+{
+	// Check that pass is ready to render
+	if (!mpRays || !mpRays->readyToRender()) return;
+
+	auto globalVars = mpRays->getGlobalVars();
+	globalVars["GlobalCB"]["gMinT"] = mpResManager->getMinTDist();
+	globalVars["GlobalCB"]["gFrameCount"] = mFrameCount++;
+	globalVars["GlobalCB"]["gMaxDepth"] = uint32_t(mRayDepth);
+	globalVars["GlobalCB"]["gMaxTemporalM"] = float(mMaxTemporalM);
+	globalVars["GlobalCB"]["gEnableReSTIRGI"] = mpResManager->getReSTIRGI();
+	globalVars["GlobalCB"]["gDoTemporalReuse"] = mpResManager->getTemporal();
+	globalVars["GlobalCB"]["gEnvInDirectLighting"] = mpEnvSampler && mpEnvSampler->isActive();
+
+	// Pass G-Buffer textures to shader, and last frame's normals and the motion vectors into it for reprojection
+	globalVars["gPos"]      = mpResManager->getTexture("WorldPosition");
+	globalVars["gNorm"]     = mpResManager->getTexture("WorldNormal");
+	globalVars["gPrevNorm"] = mpResManager->getTexture("PrevWorldNormal");
+	globalVars["gMotion"]   = mpResManager->getTexture("MotionVectors");
+
+	mpReservoirs->setIntoVars(globalVars, { ReservoirStore::GIBufferId::CurrGIReservoirs, ReservoirStore::GIBufferId::PrevGIReservoirs }, mpResManager->getScreenSize());
+
+	// Set environment map texture for bounce rays that miss
+	globalVars["gEnvMap"] = mpResManager->getTexture(ResourceManager::kEnvironmentMap);
+
+	// Launch ray tracing
+	mpRays->execute(pRenderContext, mpResManager->getScreenSize());
+}
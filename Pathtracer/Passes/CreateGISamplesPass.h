@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../SharedUtils/RenderPass.h"
+#include "../SharedUtils/RayLaunch.h"
+#include "ReservoirStore.h"
+#include "EnvMapSampler.h"
+
+// ReSTIR GI, stage 1 (createGISamples.hlsl):  traces one bounce ray per pixel, stores the point it hits as a new GI
+//     reservoir, and merges last frame's reservoir into it through the motion vectors (temporal reuse).
+class CreateGISamplesPass : public ::RenderPass, inherit_shared_from_this<::RenderPass, CreateGISamplesPass>
+{
+public:
+	using SharedPtr = std::shared_ptr<CreateGISamplesPass>;
+	using SharedConstPtr = std::shared_ptr<const CreateGISamplesPass>;
+
+	static SharedPtr create(const ReservoirStore::SharedPtr& pReservoirs, const EnvMapSampler::SharedPtr& pEnvSampler) { return SharedPtr(new CreateGISamplesPass(pReservoirs, pEnvSampler)); }
+	virtual ~CreateGISamplesPass() = default;
+
+protected:
+	CreateGISamplesPass(const ReservoirStore::SharedPtr& pReservoirs, const EnvMapSampler::SharedPtr& pEnvSampler);
+
+	// RenderPass functionality
+	bool initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager) override;
+	void initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene) override;
+	void renderGui(Gui* pGui) override;
+	void execute(RenderContext* pRenderContext) override;
+
+	// Override default RenderPass functionality (that control the rendering pipeline and its GUI)
+	bool requiresScene() override { return true; }       // Adds 'load scene' option to GUI.
+	bool usesRayTracing() override { return true; }      // Removes a GUI control that is confusing for this simple demo
+	bool usesEnvironmentMap() override { return true; }  // Use environment map to illuminate the scene
+	bool usesReSTIRGI() override { return true; }        // Adds the 'ReSTIR GI' toggle
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
+
+	// Internal state variables for this pass
+	RayLaunch::SharedPtr          mpRays;              ///< Wrapper around DXR pass
+	RtScene::SharedPtr            mpScene;             ///< Falcor scene representation, with additions for ray tracing
+	ReservoirStore::SharedPtr     mpReservoirs;        ///< GI reservoirs, shared with the GI spatial reuse and shading passes
+	EnvMapSampler::SharedPtr      mpEnvSampler;        ///< If it's active, direct lighting already has the environment map
+
+	int32_t                       mRayDepth = 1;       ///< Bounces from the visible point (1:  direct lighting at the sample point only)
+	const int32_t                 mMaxRayDepth = 8;    ///< Max supported ray depth
+	int32_t                       mMaxTemporalM = 20;  ///< Cap on the samples last frame's reservoir brings along
+
+	// Counter to initialize random numbers each frame
+	uint32_t                      mFrameCount = 0x2379u;                        ///< A frame counter to act as seed for random number generator
+};
@@ -15,8 +15,11 @@ namespace {
 	const char* kEntryIndirectClosestHit = "IndirectClosestHit";
 };
 
-CreateLightSamplesPass::CreateLightSamplesPass(const std::string& outBuf, const RenderParams& params) : 
+CreateLightSamplesPass::CreateLightSamplesPass(const std::string& outBuf, const RenderParams& params, const ReservoirStore::SharedPtr& pReservoirs, const EnvMapSampler::SharedPtr& pEnvSampler, const EmissiveLights::SharedPtr& pEmissiveLights) : 
 	mOutChannel(outBuf), 
+	mpReservoirs(pReservoirs), 
+	mpEnvSampler(pEnvSampler),
+	mpEmissiveLights(pEmissiveLights),
 	mEnableReSTIR(params.mEnableReSTIR), 
 	mDoTemporalReuse(params.mTemporalReuse),
 	::RenderPass("Create Light Samples Pass", "Create Light Samples Options")
@@ -29,13 +32,19 @@ bool CreateLightSamplesPass::initialize(RenderContext* pRenderContext, ResourceM
 	mpResManager = pResManager;
 
 	// Request texture resources for this pass (Note: We do not need a z-buffer since ray tracing does not generate one by default)
-	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse", "CurrReservoirs", "PrevReservoirs"});
+	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse", "CurrReservoirs"});
+	mpResManager->requestTextureResources({ "PrevWorldPosition", "PrevWorldNormal", "PrevMaterialDiffuse", "MotionVectors" });   // Kept by RayTracedGBufferPass
 	mpResManager->requestTextureResource(mOutChannel);
 	mpResManager->requestTextureResource(ResourceManager::kEnvironmentMap);
 
 	// Set the default scene
 	mpResManager->setDefaultSceneName("Scenes/pink_room/pink_room.fscene");
 
+	// Light selection structures, updated from the scene's lights every frame
+	mpAliasTable = LightAliasTable::create();
+	mpLightBvh = LightBvh::create();
+	mpSampleGenerator = SampleGenerator::create();
+
 	// Create wrapper around ray tracing pass
 	mpRays = RayLaunch::create(kFileRayTrace, kEntryPointRayGen);
 
@@ -47,7 +56,8 @@ bool CreateLightSamplesPass::initialize(RenderContext* pRenderContext, ResourceM
 	mpRays->addMissShader(kFileRayTrace, kEntryPointMiss1);
 	mpRays->addHitShader(kFileRayTrace, kEntryIndirectClosestHit, kEntryIndirectAnyHit);
 	
-	// Compile
+	// Compile (for the number of reservoirs per pixel we keep)
+	mpReservoirs->addDefines(mpRays);
 	mpRays->compileRayProgram();
 	mpRays->setMaxRecursionDepth(uint32_t(mMaxRayDepth));
 	if (mpScene) mpRays->setScene(mpScene);
@@ -55,14 +65,12 @@ bool CreateLightSamplesPass::initialize(RenderContext* pRenderContext, ResourceM
 	return true;
 }
 
-bool CreateLightSamplesPass::hasCameraMoved()
+bool CreateLightSamplesPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
 {
-	if (!mpScene || !mpScene->getActiveCamera())
-	{
-		return false;
-	}
-	bool hasCameraChanged = (mpLastCameraMatrix != mpScene->getActiveCamera()->getViewProjMatrix());
-	return hasCameraChanged;
+	usage.reads = { "WorldPosition", "WorldNormal", "MaterialDiffuse", "Emissive", "PrevWorldPosition", "PrevWorldNormal",
+	                "PrevMaterialDiffuse", "MotionVectors" };
+	usage.writes = { "CurrReservoirs", mOutChannel };
+	return true;
 }
 
 void CreateLightSamplesPass::initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene)
@@ -72,12 +80,6 @@ void CreateLightSamplesPass::initScene(RenderContext* pRenderContext, Scene::Sha
 		mpScene = std::dynamic_pointer_cast<RtScene>(pScene);
 	}
 
-	// Get copy of scene's camera matrix
-	if (mpScene && mpScene->getActiveCamera())
-	{
-		mpLastCameraMatrix = mpScene->getActiveCamera()->getViewProjMatrix();
-	}
-
 	// Pass scene to ray tracer
 	if (mpRays) {
 		mpRays->setScene(mpScene);
@@ -93,6 +95,32 @@ void CreateLightSamplesPass::renderGui(Gui* pGui)
 	dirty |= (int)pGui->addCheckBox(mEnableReSTIR ? "Show Direct Lighting" : "Show ReSTIR", mEnableReSTIR);
 	dirty |= (int)pGui->addCheckBox(mDoVisibilityReuse ? "Disable Visibility Reuse" : "Enable Visibility Reuse", mDoVisibilityReuse);
 	dirty |= (int)pGui->addCheckBox(mDoTemporalReuse ? "Disable Temporal Reuse" : "Enable Temporal Reuse", mDoTemporalReuse);
+	dirty |= (int)pGui->addDropdown("Light Selection", mLightSelectionList, mLightSelection);
+	if (mLightSelection == uint32_t(LightSelection::AliasTable)) {
+		pGui->addText((std::to_string(mpAliasTable->getLightCount()) + " lights, table built in " + std::to_string(mpAliasTable->getLastBuildTime()) + " ms").c_str());
+	}
+	else if (mLightSelection == uint32_t(LightSelection::Bvh)) {
+		pGui->addText((std::to_string(mpLightBvh->getNodes().size()) + " nodes, built in " + std::to_string(mpLightBvh->getLastBuildTime()) + " ms, refit in " + std::to_string(mpLightBvh->getLastRefitTime()) + " ms").c_str());
+	}
+	dirty |= (int)mpEnvSampler->renderGui(pGui);
+	if (pGui->addButton("Benchmark env map sampling")) {
+		mEnvBenchmark = EnvMapSampler::benchmark();
+		EnvMapSampler::logBenchmark(mEnvBenchmark);
+	}
+	if (mEnvBenchmark.samples > 0) {
+		pGui->addText(("  " + std::to_string(mEnvBenchmark.mapSize.x) + "x" + std::to_string(mEnvBenchmark.mapSize.y) + " build: " + std::to_string(mEnvBenchmark.buildMs) +
+			" ms, variance " + std::to_string(mEnvBenchmark.varianceReduction) + "x lower than cosine sampling").c_str());
+	}
+	dirty |= (int)mpEmissiveLights->renderGui(pGui);
+	if (pGui->addButton("Benchmark emissive extraction")) {
+		mEmissiveBenchmark = EmissiveLights::benchmark();
+		EmissiveLights::logBenchmark(mEmissiveBenchmark);
+	}
+	if (mEmissiveBenchmark.inputTriangles > 0) {
+		pGui->addText(("  " + std::to_string(mEmissiveBenchmark.inputTriangles) + " triangles: " + std::to_string(mEmissiveBenchmark.extractMs) + " ms (" +
+			std::to_string(mEmissiveBenchmark.serialExtractMs) + " ms on one thread), " + std::to_string(mEmissiveBenchmark.outputBytes / (1024 * 1024)) + " MB out").c_str());
+	}
+	dirty |= (int)mpSampleGenerator->renderGui(pGui);
 	if (dirty) setRefreshFlag();
 }
 
@@ -111,14 +139,22 @@ void CreateLightSamplesPass::execute(RenderContext* pRenderContext)
 	globalVars["GlobalCB"]["gMaxDepth"] = mRayDepth;
 	globalVars["GlobalCB"]["gLightSamples"] = mLightSamples;
 	globalVars["GlobalCB"]["gEmitMult"] = 1.0f;
-	globalVars["GlobalCB"]["gLastCameraMatrix"] = mpLastCameraMatrix;
-	if (hasCameraMoved()) mpLastCameraMatrix = mpScene->getActiveCamera()->getViewProjMatrix();
 
 	globalVars["GlobalCB"]["gDoIndirectLighting"] = mDoIndirectLighting;
 	globalVars["GlobalCB"]["gDoDirectLighting"] = mDoDirectLighting;
 	globalVars["GlobalCB"]["gEnableWeightedRIS"] = mpResManager->getWeightedRIS();
 	globalVars["GlobalCB"]["gDoVisiblityReuse"] = mDoVisibilityReuse;
 	globalVars["GlobalCB"]["gDoTemporalReuse"] = mpResManager->getTemporal();
+	globalVars["GlobalCB"]["gLightSelection"] = mLightSelection;
+	globalVars["GlobalCB"]["gUnbiased"] = mpResManager->getUnbiased();
+	globalVars["GlobalCB"]["gUnbiasedVisibility"] = mpResManager->getUnbiasedVisibility();
+
+	// Rebuild the light selection table if any light's power changed, and refit the light BVH if any light moved
+	if (mLightSelection == uint32_t(LightSelection::AliasTable)) mpAliasTable->update(mpScene);
+	if (mLightSelection == uint32_t(LightSelection::Bvh)) mpLightBvh->update(mpScene);
+	mpAliasTable->setIntoVars(globalVars, "gLightAliasTable");
+	mpLightBvh->setIntoVars(globalVars, "gLightBvh");
+	mpSampleGenerator->setIntoVars(globalVars);
 	
 	// Pass G-Buffer textures to shader
 	globalVars["gPos"]        = mpResManager->getTexture("WorldPosition");
@@ -126,14 +162,27 @@ void CreateLightSamplesPass::execute(RenderContext* pRenderContext)
 	globalVars["gDiffuseMtl"] = mpResManager->getTexture("MaterialDiffuse");
 	globalVars["gEmissive"]   = mpResManager->getTexture("Emissive");
 
+	// Last frame's G-buffer and the motion vectors into it, to find and judge last frame's pixel
+	globalVars["gPrevPos"]        = mpResManager->getTexture("PrevWorldPosition");
+	globalVars["gPrevNorm"]       = mpResManager->getTexture("PrevWorldNormal");
+	globalVars["gPrevDiffuseMtl"] = mpResManager->getTexture("PrevMaterialDiffuse");
+	globalVars["gMotion"]         = mpResManager->getTexture("MotionVectors");
+
 	// Pass ReGIR grid structure for updating
 	globalVars["gCurrReservoirs"]  = mpResManager->getTexture("CurrReservoirs");
-	globalVars["gPrevReservoirs"]  = mpResManager->getTexture("PrevReservoirs");
+	mpReservoirs->setIntoVars(globalVars, { ReservoirStore::BufferId::CurrReservoirs, ReservoirStore::BufferId::PrevReservoirs }, mpResManager->getScreenSize());
 
 	//globalVars["gOutput"]     = outTex;
 
-	// Set environment map texture for indirect illumination
-	globalVars["gEnvMap"] = mpResManager->getTexture(ResourceManager::kEnvironmentMap);
+	// Set environment map texture for indirect illumination, and rebuild its sampling table if the map changed
+	Texture::SharedPtr envMap = mpResManager->getTexture(ResourceManager::kEnvironmentMap);
+	globalVars["gEnvMap"] = envMap;
+	if (mpEnvSampler->isEnabled()) mpEnvSampler->update(pRenderContext, envMap);
+	mpEnvSampler->setIntoVars(globalVars);
+
+	// Emissive triangles as candidates, extracted again when the scene changes
+	if (mpEmissiveLights->isEnabled()) mpEmissiveLights->update(pRenderContext, mpScene);
+	mpEmissiveLights->setIntoVars(globalVars);
 
 	// Launch ray tracing
 	mpRays->execute(pRenderContext, mpResManager->getScreenSize());
@@ -2,6 +2,12 @@
 
 #include "../SharedUtils/RenderPass.h"
 #include "../SharedUtils/RayLaunch.h"
+#include "LightAliasTable.h"
+#include "EnvMapSampler.h"
+#include "EmissiveLights.h"
+#include "LightBvh.h"
+#include "ReservoirStore.h"
+#include "SampleGenerator.h"
 
 class CreateLightSamplesPass : public ::RenderPass, inherit_shared_from_this<::RenderPass, CreateLightSamplesPass>
 {
@@ -9,11 +15,11 @@ public:
 	using SharedPtr = std::shared_ptr<CreateLightSamplesPass>;
 	using SharedConstPtr = std::shared_ptr<const CreateLightSamplesPass>;
 
-	static SharedPtr create(const std::string &outBuf, const RenderParams &params) { return SharedPtr(new CreateLightSamplesPass(outBuf, params)); }
+	static SharedPtr create(const std::string &outBuf, const RenderParams &params, const ReservoirStore::SharedPtr& pReservoirs, const EnvMapSampler::SharedPtr& pEnvSampler, const EmissiveLights::SharedPtr& pEmissiveLights) { return SharedPtr(new CreateLightSamplesPass(outBuf, params, pReservoirs, pEnvSampler, pEmissiveLights)); }
 	virtual ~CreateLightSamplesPass() = default;
 
 protected:
-	CreateLightSamplesPass(const std::string& outBuf, const RenderParams& params);
+	CreateLightSamplesPass(const std::string& outBuf, const RenderParams& params, const ReservoirStore::SharedPtr& pReservoirs, const EnvMapSampler::SharedPtr& pEnvSampler, const EmissiveLights::SharedPtr& pEmissiveLights);
 
 	// RenderPass functionality
 	bool initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager) override;
@@ -25,11 +31,19 @@ protected:
 	bool requiresScene() override { return true; }       // Adds 'load scene' option to GUI.
 	bool usesRayTracing() override { return true; }      // Removes a GUI control that is confusing for this simple demo
 	bool usesEnvironmentMap() override { return true; }  // Use environment map to illuminate the scene
-	bool hasCameraMoved();                               // Determine if there has been any camera motion.
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
 
 	// Internal state variables for this pass
 	RayLaunch::SharedPtr          mpRays;              ///< Wrapper around DXR pass
 	RtScene::SharedPtr            mpScene;             ///< Falcor scene representation, with additions for ray tracing
+	LightAliasTable::SharedPtr    mpAliasTable;        ///< Power-based source distribution for the initial candidates
+	LightBvh::SharedPtr           mpLightBvh;          ///< Spatial source distribution for the initial candidates
+	ReservoirStore::SharedPtr     mpReservoirs;        ///< Per-pixel reservoirs, shared with the spatial reuse and shading passes
+	SampleGenerator::SharedPtr    mpSampleGenerator;   ///< Sequence behind the candidates and the RIS decisions
+	EnvMapSampler::SharedPtr      mpEnvSampler;        ///< Environment map cells as candidates, shared with the reuse, shading and GI passes
+	EnvMapSampler::Benchmark      mEnvBenchmark;
+	EmissiveLights::SharedPtr     mpEmissiveLights;    ///< Emissive triangles as candidates, shared with the reuse and shading passes
+	EmissiveLights::Benchmark     mEmissiveBenchmark;
 
 	// Output buffer
 	std::string                   mOutChannel;
@@ -40,13 +54,13 @@ protected:
 	bool                          mEnableReSTIR = true;
 	bool                          mDoVisibilityReuse = true;
 	bool                          mDoTemporalReuse = true;
+	uint32_t                      mLightSelection = uint32_t(LightSelection::AliasTable);   ///< See LightSelection
+	Gui::DropdownList             mLightSelectionList = { { uint32_t(LightSelection::Uniform), "Uniform" }, { uint32_t(LightSelection::AliasTable), "Light power" }, { uint32_t(LightSelection::Bvh), "Light BVH" } };
 		
 	int32_t                       mLightSamples = 32;  ///< Number of initial candidates (M)
 	int32_t                       mRayDepth = 1;       ///< Current max. ray depth
 	const int32_t                 mMaxRayDepth = 8;    ///< Max supported ray depth
 	
-	mat4                          mpLastCameraMatrix;
-	
 	// Counter to initialize thin lens random numbers each frame
 	uint32_t                      mFrameCount = 0x1456u;                        ///< A frame counter to act as seed for random number generator 
 };
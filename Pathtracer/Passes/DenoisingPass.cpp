@@ -17,12 +17,18 @@
 **********************************************************************************************************************/
 
 #include "DenoisingPass.h"
+#include "../Shaders/AtrousFilter.h"
 
 namespace {
 	const char* kFileRayTrace = "Shaders\\atrous.hlsl";
+	const char* kFileCompute = "Shaders\\atrous.cs.hlsl";
 
 	// Function names for shader entry points
 	const char* kEntryPointRayGen = "DenoisingRayGen";
+	const char* kEntryPointTemporalRayGen = "TemporalAccumulationRayGen";
+	const char* kEntryPointPackGBuffer = "PackGBuffer";
+	const char* kEntryPointFused = "AtrousFused";
+	const char* kEntryPointIteration = "AtrousIteration";
 };
 
 DenoisingPass::DenoisingPass(const std::string& outBuf, const int iter, const int totalIter) :
@@ -39,22 +45,62 @@ bool DenoisingPass::initialize(RenderContext* pRenderContext, ResourceManager::S
 	mpResManager = pResManager;
 
 	// Request texture resources for this pass (Note: We do not need a z-buffer since ray tracing does not generate one by default)
-	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse", "ShadedOutput"
+	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse", "ShadedOutput",
 										    "CurrReservoirs", "DenoiseIn", "DenoiseOut", "DenoisedImage"});
 
+	// Reprojected history for the temporal stage (motion vectors and last frame's normals come from RayTracedGBufferPass)
+	mpResManager->requestTextureResources({ "MotionVectors", "PrevWorldNormal", "DenoiseHistory", "PrevDenoiseHistory" });
+
+	// The compute denoiser's packed G-buffer (see AtrousFilter.h)
+	mpResManager->requestTextureResource("DenoisePackedGBuffer", ResourceFormat::RGBA32Uint);
+
 	// Set the default scene
 	mpResManager->setDefaultSceneName("Scenes/pink_room/pink_room.fscene");
 
 	// Create wrapper around ray tracing pass
 	mpRays = RayLaunch::create(kFileRayTrace, kEntryPointRayGen);
 
+	// The first iteration accumulates reprojected history before filtering
+	if (mIter == 0) mpTemporalRays = RayLaunch::create(kFileRayTrace, kEntryPointTemporalRayGen);
+
+	// The first iteration also runs all of them through the compute shader, when that is enabled
+	if (mIter == 0) {
+		mpPackGBuffer = ComputePass::create(kFileCompute, kEntryPointPackGBuffer);
+		mpFusedIterations = ComputePass::create(kFileCompute, kEntryPointFused);
+		mpIteration = ComputePass::create(kFileCompute, kEntryPointIteration);
+	}
+
 	// Compile
 	mpRays->compileRayProgram();
 	if (mpScene) mpRays->setScene(mpScene);
+	if (mpTemporalRays) {
+		mpTemporalRays->compileRayProgram();
+		if (mpScene) mpTemporalRays->setScene(mpScene);
+	}
 
 	return true;
 }
 
+bool DenoisingPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	usage.reads = { "WorldPosition", "WorldNormal", "ShadedOutput", "MotionVectors", "PrevWorldNormal" };
+	usage.writes = { mOutChannel, "DenoiseOut" };
+	usage.persistent = { "DenoiseHistory", "PrevDenoiseHistory" };
+
+	// The first iteration also runs the whole compute shader denoiser;  later ray generation iterations filter its result
+	if (mIter == 0)
+	{
+		usage.writes.push_back("DenoiseIn");
+		usage.writes.push_back("DenoisePackedGBuffer");
+		usage.formats["DenoisePackedGBuffer"] = ResourceFormat::RGBA32Uint;
+	}
+	else
+	{
+		usage.reads.push_back("DenoiseOut");
+	}
+	return true;
+}
+
 void DenoisingPass::initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene)
 {
 	// Save copy of scene
@@ -66,6 +112,9 @@ void DenoisingPass::initScene(RenderContext* pRenderContext, Scene::SharedPtr pS
 	if (mpRays) {
 		mpRays->setScene(mpScene);
 	}
+	if (mpTemporalRays) {
+		mpTemporalRays->setScene(mpScene);
+	}
 }
 
 void DenoisingPass::renderGui(Gui* pGui)
@@ -76,17 +125,62 @@ void DenoisingPass::renderGui(Gui* pGui)
 	dirty |= (int)pGui->addFloatVar("Color Weight", mColorPhi, 0.f, 200.f);
 	dirty |= (int)pGui->addFloatVar("Normal Weight", mNormalPhi, 0.f, 10.f);
 	dirty |= (int)pGui->addFloatVar("Position Weight", mPositionPhi, 0.f, 10.f);
+	if (mpTemporalRays) {
+		dirty |= (int)pGui->addCheckBox("Temporal Accumulation", mDoTemporalFilter);
+		if (mDoTemporalFilter) dirty |= (int)pGui->addIntVar("History Length", mTemporalHistory, 1, 256);
+	}
+	if (mpResManager->getComputeDenoising())
+	{
+		if (mIter != 0) {
+			pGui->addText("The compute shader denoiser uses the first iteration's weights");
+		}
+		else {
+			if (pGui->addButton("Validate on CPU")) mRunCpuValidation = true;
+			pGui->addText(("  " + std::to_string(mCpuValidation.mismatches) + " of " + std::to_string(mCpuValidation.pixels) +
+				" pixels differ from CpuAtrousFilter (max " + std::to_string(mCpuValidation.maxUlps) + " ulps)").c_str());
+		}
+	}
 	if (dirty) setRefreshFlag();
 }
 
 void DenoisingPass::execute(RenderContext* pRenderContext)
 {
+	// The compute shader denoiser runs every iteration from the first iteration's pass
+	bool doCompute = mpResManager->getDenoising() && mpResManager->getComputeDenoising();
+	if (doCompute && mIter != 0) return;
+
 	// Get output buffer and clear it to black
 	Texture::SharedPtr outTex = mpResManager->getClearedTexture(mOutChannel, vec4(0.f, 0.f, 0.f, 0.f));
 
 	// Check that pass is ready to render
 	if (!outTex || !mpRays || !mpRays->readyToRender()) return;
 
+	// Accumulate this frame into the reprojected history, which the first iteration then filters
+	bool doTemporalFilter = mpTemporalRays && mDoTemporalFilter && mpResManager->getDenoising() && mpTemporalRays->readyToRender();
+	if (doTemporalFilter)
+	{
+		mpResManager->swapTextures("DenoiseHistory", "PrevDenoiseHistory");
+
+		auto temporalVars = mpTemporalRays->getGlobalVars();
+		temporalVars["GlobalCB"]["gTemporalHistory"] = uint32_t(mTemporalHistory);
+		temporalVars["gShadedOutput"] = mpResManager->getTexture("ShadedOutput");
+		temporalVars["gNorm"] = mpResManager->getTexture("WorldNormal");
+		temporalVars["gMotion"] = mpResManager->getTexture("MotionVectors");
+		temporalVars["gPrevNorm"] = mpResManager->getTexture("PrevWorldNormal");
+		temporalVars["gDenoiseHistory"] = mpResManager->getTexture("DenoiseHistory");
+		temporalVars["gPrevDenoiseHistory"] = mpResManager->getTexture("PrevDenoiseHistory");
+		mpTemporalRays->execute(pRenderContext, mpResManager->getScreenSize());
+	}
+
+	if (doCompute)
+	{
+		Texture::SharedPtr pColor = mpResManager->getTexture(doTemporalFilter ? "DenoiseHistory" : "ShadedOutput");
+		executeCompute(pRenderContext, pColor, outTex);
+		if (mRunCpuValidation) validateOnCpu(pRenderContext, pColor, outTex);
+		mRunCpuValidation = false;
+		return;
+	}
+
 	// Pass background color to miss shader #0
 	auto globalVars = mpRays->getGlobalVars();
 	globalVars["GlobalCB"]["gFrameCount"] = mFrameCount++;
@@ -97,6 +191,7 @@ void DenoisingPass::execute(RenderContext* pRenderContext)
 	globalVars["GlobalCB"]["gPositionPhi"] = mPositionPhi;
 	globalVars["GlobalCB"]["gIter"] = mIter;
 	globalVars["GlobalCB"]["gTotalIter"] = mTotalIter;
+	globalVars["GlobalCB"]["gTemporalFilter"] = doTemporalFilter;
 
 	// Pass G-Buffer textures to shader
 	globalVars["gPos"] = mpResManager->getTexture("WorldPosition");
@@ -106,6 +201,7 @@ void DenoisingPass::execute(RenderContext* pRenderContext)
 	globalVars["gShadedOutput"] = mpResManager->getTexture("ShadedOutput");
 	globalVars["gDenoiseIn"] = mpResManager->getTexture("DenoiseIn");
 	globalVars["gDenoiseOut"] = mpResManager->getTexture("DenoiseOut");
+	globalVars["gDenoiseHistory"] = mpResManager->getTexture("DenoiseHistory");
 
 	globalVars["gOutput"]     = outTex;
 
@@ -114,4 +210,83 @@ void DenoisingPass::execute(RenderContext* pRenderContext)
 
 	// Launch ray tracing
 	mpRays->execute(pRenderContext, mpResManager->getScreenSize());
-}
\ No newline at end of file
+}
+
+void DenoisingPass::executeCompute(RenderContext* pRenderContext, Texture::SharedPtr pColor, Texture::SharedPtr pOutTex)
+{
+	uvec2 screenSize = mpResManager->getScreenSize();
+	Texture::SharedPtr pPackedGBuffer = mpResManager->getTexture("DenoisePackedGBuffer");
+
+	// Position and normal into a single fetch per neighbor
+	auto packVars = mpPackGBuffer->getVars();
+	packVars["AtrousCB"]["gScreenSize"] = screenSize;
+	packVars["gPos"] = mpResManager->getTexture("WorldPosition");
+	packVars["gNorm"] = mpResManager->getTexture("WorldNormal");
+	packVars["gPackedGBufferOut"] = pPackedGBuffer;
+	mpPackGBuffer->execute(pRenderContext, screenSize.x, screenSize.y);
+
+	// Intermediate iterations ping-pong between these, and the last one writes our output
+	Texture::SharedPtr pTemp[2] = { mpResManager->getTexture("DenoiseOut"), mpResManager->getTexture("DenoiseIn") };
+	uint32_t totalIter = uint32_t(std::max(1, mTotalIter));
+	uint32_t fusedIter = std::min(totalIter, uint32_t(ATROUS_FUSED_ITERATIONS));
+
+	auto setFilterVars = [&](SimpleVars::SharedPtr vars, Texture::SharedPtr pIn, Texture::SharedPtr pOut)
+	{
+		vars["AtrousCB"]["gScreenSize"] = screenSize;
+		vars["AtrousCB"]["gInvColorPhi2"] = atrousInvPhi2(mColorPhi);
+		vars["AtrousCB"]["gInvNormalPhi2"] = atrousInvPhi2(mNormalPhi);
+		vars["AtrousCB"]["gInvPositionPhi2"] = atrousInvPhi2(mPositionPhi);
+		vars["gPackedGBuffer"] = pPackedGBuffer;
+		vars["gColorIn"] = pIn;
+		vars["gColorOut"] = pOut;
+	};
+
+	// The first (small step size) iterations out of groupshared memory
+	Texture::SharedPtr pIn = pColor;
+	Texture::SharedPtr pOut = (fusedIter == totalIter) ? pOutTex : pTemp[0];
+	auto fusedVars = mpFusedIterations->getVars();
+	setFilterVars(fusedVars, pIn, pOut);
+	fusedVars["AtrousCB"]["gFusedIterations"] = fusedIter;
+	mpFusedIterations->execute(pRenderContext, screenSize.x, screenSize.y);
+
+	// Then one dispatch per iteration
+	for (uint32_t iter = fusedIter; iter < totalIter; iter++)
+	{
+		pIn = pOut;
+		pOut = (iter == totalIter - 1) ? pOutTex : pTemp[(iter - fusedIter + 1) % 2];
+		auto iterVars = mpIteration->getVars();
+		setFilterVars(iterVars, pIn, pOut);
+		iterVars["AtrousCB"]["gStepSize"] = 1u << iter;
+		mpIteration->execute(pRenderContext, screenSize.x, screenSize.y);
+	}
+}
+
+void DenoisingPass::validateOnCpu(RenderContext* pRenderContext, Texture::SharedPtr pColor, Texture::SharedPtr pOutTex)
+{
+	if (!mpCpuFilter) mpCpuFilter = CpuAtrousFilter::create();
+
+	// All of these are RGBA32Float
+	auto readBack = [&](const Texture::SharedPtr& pTex)
+	{
+		std::vector<uint8_t> bytes = pRenderContext->readTextureSubresource(pTex.get(), 0);
+		std::vector<vec4> texels(bytes.size() / sizeof(vec4));
+		if (!texels.empty()) std::memcpy(texels.data(), bytes.data(), texels.size() * sizeof(vec4));
+		return texels;
+	};
+	std::vector<vec4> color = readBack(pColor);
+	std::vector<vec4> position = readBack(mpResManager->getTexture("WorldPosition"));
+	std::vector<vec4> normal = readBack(mpResManager->getTexture("WorldNormal"));
+	std::vector<vec4> gpuResult = readBack(pOutTex);
+
+	CpuAtrousFilter::Settings& settings = mpCpuFilter->getSettings();
+	settings.iterations = uint32_t(std::max(1, mTotalIter));
+	settings.colorPhi = mColorPhi;
+	settings.normalPhi = mNormalPhi;
+	settings.positionPhi = mPositionPhi;
+
+	std::vector<vec4> cpuResult;
+	mpCpuFilter->filter(mpResManager->getScreenSize(), color, position, normal, cpuResult);
+	mCpuValidation = CpuAtrousFilter::compare(gpuResult, cpuResult);
+	logInfo("DenoisingPass: " + std::to_string(mCpuValidation.mismatches) + " of " + std::to_string(mCpuValidation.pixels) +
+		" pixels differ between the compute and CPU a-trous filters, by at most " + std::to_string(mCpuValidation.maxUlps) + " ulps");
+}
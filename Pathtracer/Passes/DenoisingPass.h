@@ -21,6 +21,8 @@
 #include "../SharedUtils/RenderPass.h"
 #include "../SharedUtils/SimpleVars.h"
 #include "../SharedUtils/RayLaunch.h"
+#include "../SharedUtils/ComputePass.h"
+#include "../CpuRenderer/CpuAtrousFilter.h"
 
 class DenoisingPass : public ::RenderPass, inherit_shared_from_this<::RenderPass, DenoisingPass>
 {
@@ -40,15 +42,31 @@ protected:
 	void renderGui(Gui* pGui) override;
 	void execute(RenderContext* pRenderContext) override;
 
+	// Runs every iteration through atrous.cs.hlsl (only the first iteration's pass does this), filtering <pColor> into <pOutTex>
+	void executeCompute(RenderContext* pRenderContext, Texture::SharedPtr pColor, Texture::SharedPtr pOutTex);
+
+	// Reads back the compute denoiser's input and output, and checks that CpuAtrousFilter produces the same bits
+	void validateOnCpu(RenderContext* pRenderContext, Texture::SharedPtr pColor, Texture::SharedPtr pOutTex);
+
 	// Override default RenderPass functionality (that control the rendering pipeline and its GUI)
 	bool requiresScene() override { return true; }      // Adds 'load scene' option to GUI.
 	bool usesRayTracing() override { return true; }      // Removes a GUI control that is confusing for this simple demo
 	bool usesEnvironmentMap() override { return true; }  // Use environment map to illuminate the scene
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
 
 	// Internal state variables for this pass
 	RayLaunch::SharedPtr          mpRays;              ///< Wrapper around DXR pass
+	RayLaunch::SharedPtr          mpTemporalRays;      ///< Temporal accumulation ahead of the first iteration (only that iteration has one)
 	RtScene::SharedPtr            mpScene;             ///< Falcor scene representation, with additions for ray tracing
 
+	// Compute shader denoiser (only the first iteration has one)
+	ComputePass::SharedPtr        mpPackGBuffer;       ///< Position and normal into one uint4 per pixel
+	ComputePass::SharedPtr        mpFusedIterations;   ///< The first ATROUS_FUSED_ITERATIONS iterations, out of groupshared memory
+	ComputePass::SharedPtr        mpIteration;         ///< Each later iteration
+	CpuAtrousFilter::SharedPtr    mpCpuFilter;         ///< To check its results against, created on request from the GUI
+	bool                          mRunCpuValidation = false;
+	CpuAtrousFilter::Comparison   mCpuValidation;
+
 	// Output buffer
 	std::string                   mOutChannel;
 
@@ -59,6 +77,8 @@ protected:
 	float                         mColorPhi = 0.5f;       ///< Color weight
 	float                         mNormalPhi = 0.0625f;   ///< Normal weight
 	float                         mPositionPhi = 0.05f;   ///< Normal weight
+	bool                          mDoTemporalFilter = true; ///< Accumulate reprojected history before filtering
+	int32_t                       mTemporalHistory = 16;  ///< Most frames of history each pixel keeps
 
 	// Counter to initialize thin lens random numbers each frame
 	uint32_t                      mFrameCount = 0x1456u;                        ///< A frame counter to act as seed for random number generator 
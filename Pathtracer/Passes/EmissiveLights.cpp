@@ -0,0 +1,736 @@
+#include "EmissiveLights.h"
+#include "glm/gtc/packing.hpp"
+#include <algorithm>
+#include <map>
+#include <random>
+
+namespace {
+	const uint32_t kLaunchWidth = 256;           // build() launches over the triangles in rows of this many
+	const uint32_t kMaxTextureSamples = 256;     // Per triangle, when averaging an emissive texture over it
+	const float kMaxRadiance = 65504.f;          // Largest half
+
+	float luminance(const vec3& rgb)
+	{
+		float l = glm::dot(rgb, vec3(0.2126f, 0.7152f, 0.0722f));
+		return std::isfinite(l) ? std::max(l, 0.f) : 0.f;
+	}
+
+	// Reads one float vertex element from a mapped vertex buffer into a vec4 (as CpuScene does)
+	void readElement(const uint8_t* pData, uint32_t stride, uint32_t offset, ResourceFormat format, uint32_t idx, vec4& out)
+	{
+		const float* pSrc = reinterpret_cast<const float*>(pData + size_t(idx) * stride + offset);
+		uint32_t channels = getFormatChannelCount(format);
+		for (uint32_t c = 0; c < std::min(channels, 4u); c++) out[c] = pSrc[c];
+	}
+
+	// Decode mip 0 of a texture to linear rgb.  Blitting it into an RGBA32Float target first handles every format
+	//     the GPU can sample, including block-compressed ones (e.g. from the TextureCache) and sRGB.
+	EmissiveLights::TextureData decodeTexture(RenderContext* pRenderContext, const Texture::SharedPtr& pTexture)
+	{
+		EmissiveLights::TextureData tex;
+		tex.width = pTexture->getWidth();
+		tex.height = pTexture->getHeight();
+		Texture::SharedPtr pDecoded = Texture::create2D(tex.width, tex.height, ResourceFormat::RGBA32Float, 1, 1, nullptr,
+			Resource::BindFlags::RenderTarget | Resource::BindFlags::ShaderResource);
+		pRenderContext->blit(pTexture->getSRV(0, 1), pDecoded->getRTV(), uvec4(-1), uvec4(-1), Sampler::Filter::Point);
+
+		std::vector<uint8> data = pRenderContext->readTextureSubresource(pDecoded.get(), 0);
+		const vec4* pTexels = reinterpret_cast<const vec4*>(data.data());
+		tex.texels.resize(size_t(tex.width) * tex.height);
+		for (size_t i = 0; i < tex.texels.size(); i++) tex.texels[i] = vec3(pTexels[i]);
+		return tex;
+	}
+
+	// Average of <tex> over the triangle with texture coordinates uv0, uv1, uv2:  nearest texels at lattice points
+	//     uniform over the triangle, about one per texel it covers
+	vec3 averageTexture(const EmissiveLights::TextureData& tex, const vec2& uv0, const vec2& uv1, const vec2& uv2, uint32_t triIndex)
+	{
+		if (tex.texels.empty()) return vec3(0.f);
+		vec2 e1 = uv1 - uv0, e2 = uv2 - uv0;
+		float texelArea = 0.5f * std::abs(e1.x * e2.y - e1.y * e2.x) * float(tex.width) * float(tex.height);
+		uint32_t count = 1;
+		while (count < kMaxTextureSamples && float(count) < texelArea) count *= 2;
+
+		vec3 sum(0.f);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float su = std::sqrt(emissiveToFloat(emissiveLatticeU(triIndex, i, count)));
+			float v = emissiveToFloat(emissiveLatticeV(triIndex, i));
+			vec2 uv = uv0 + e1 * (su * (1.f - v)) + e2 * (su * v);
+			int x = int(std::floor(uv.x * float(tex.width))) % int(tex.width);
+			int y = int(std::floor(uv.y * float(tex.height))) % int(tex.height);
+			if (x < 0) x += int(tex.width);
+			if (y < 0) y += int(tex.height);
+			sum += tex.texels[size_t(y) * tex.width + x];
+		}
+		return sum / float(count);
+	}
+
+	// A triangle in the layout of EmissiveTriangle.h, with its radiance rounded to halfs
+	EmissiveTriangle packTriangle(const vec3& p0, const vec3& p1, const vec3& p2, const vec3& radiance, bool twoSided)
+	{
+		EmissiveTriangle tri;
+		tri.p0 = p0;
+		tri.edge1 = p1 - p0;
+		tri.edge2 = p2 - p0;
+		tri.area = 0.5f * glm::length(glm::cross(tri.edge1, tri.edge2));
+		vec3 r = glm::clamp(radiance, vec3(0.f), vec3(kMaxRadiance));
+		tri.radianceRG = uint32_t(glm::packHalf1x16(r.r)) | (uint32_t(glm::packHalf1x16(r.g)) << 16);
+		tri.radianceB = uint32_t(glm::packHalf1x16(r.b)) | ((twoSided ? EMISSIVE_FLAG_TWO_SIDED : 0u) << 16);
+		return tri;
+	}
+
+	vec3 unpackRadiance(const EmissiveTriangle& tri)
+	{
+		return vec3(glm::unpackHalf1x16(uint16_t(tri.radianceRG)), glm::unpackHalf1x16(uint16_t(tri.radianceRG >> 16)), glm::unpackHalf1x16(uint16_t(tri.radianceB)));
+	}
+
+	// Emitted power:  pi times radiance times area, for each face that emits
+	float trianglePower(const EmissiveTriangle& tri)
+	{
+		float sides = ((tri.radianceB >> 16) & EMISSIVE_FLAG_TWO_SIDED) ? 2.f : 1.f;
+		float power = float(M_PI) * luminance(unpackRadiance(tri)) * tri.area * sides;
+		return std::isfinite(power) ? power : 0.f;
+	}
+
+	// Irradiance a point on a triangle delivers to (P, N), standing for <area> of it, with <radiance>
+	float pointIrradiance(const EmissiveTriangle& tri, const vec3& pos, float area, float radiance, const vec3& P, const vec3& N)
+	{
+		vec3 toPoint = pos - P;
+		float dist2 = glm::dot(toPoint, toPoint);
+		if (dist2 <= 0.f) return 0.f;
+		vec3 toLight = toPoint / std::sqrt(dist2);
+		float cosLight = -glm::dot(glm::normalize(glm::cross(tri.edge1, tri.edge2)), toLight);
+		cosLight = ((tri.radianceB >> 16) & EMISSIVE_FLAG_TWO_SIDED) ? std::abs(cosLight) : std::max(cosLight, 0.f);
+		return radiance * area * cosLight * std::max(glm::dot(N, toLight), 0.f) / dist2;
+	}
+
+	double readUserNumber(const Scene::UserVariable& var)
+	{
+		switch (var.type)
+		{
+		case Scene::UserVariable::Type::Int:    return double(var.i32);
+		case Scene::UserVariable::Type::Uint:   return double(var.u32);
+		case Scene::UserVariable::Type::Int64:  return double(var.i64);
+		case Scene::UserVariable::Type::Uint64: return double(var.u64);
+		case Scene::UserVariable::Type::Double: return var.d64;
+		default:                                return 0.0;
+		}
+	}
+
+	// Append the scene's user-defined quad lights (see EmissiveLights.h) to <input>, two triangles each
+	void addQuadLights(const Scene* pScene, EmissiveLights::Input& input)
+	{
+		std::map<std::string, const Scene::UserVariable*> vars;
+		for (uint32_t i = 0; i < pScene->getUserVariableCount(); i++)
+		{
+			std::string name;
+			const Scene::UserVariable& var = pScene->getUserVariable(i, name);
+			vars[name] = &var;
+		}
+		auto find = [&](const std::string& name, Scene::UserVariable::Type type) -> const Scene::UserVariable*
+		{
+			auto it = vars.find(name);
+			return (it != vars.end() && it->second->type == type) ? it->second : nullptr;
+		};
+
+		auto countIt = vars.find("numLights");
+		uint32_t count = (countIt != vars.end()) ? uint32_t(std::max(readUserNumber(*countIt->second), 0.0)) : 0;
+		for (uint32_t l = 0; l < count; l++)
+		{
+			std::string prefix = "l" + std::to_string(l) + "_";
+			const Scene::UserVariable* pPower = find(prefix + "power", Scene::UserVariable::Type::Vec3);
+			const Scene::UserVariable* pCenter = find(prefix + "center", Scene::UserVariable::Type::Vec3);
+			const Scene::UserVariable* pLeft = find(prefix + "left", Scene::UserVariable::Type::Vec3);
+			const Scene::UserVariable* pUp = find(prefix + "up", Scene::UserVariable::Type::Vec3);
+			const Scene::UserVariable* pExtent = find(prefix + "extent", Scene::UserVariable::Type::Vec2);
+			if (!pPower || !pCenter || !pLeft || !pUp || !pExtent || glm::length(pLeft->vec3) <= 0.f || glm::length(pUp->vec3) <= 0.f)
+			{
+				logWarning("EmissiveLights - user-defined light " + std::to_string(l) + " is incomplete, skipping it");
+				continue;
+			}
+
+			vec3 left = glm::normalize(pLeft->vec3) * (0.5f * pExtent->vec2.x);
+			vec3 up = glm::normalize(pUp->vec3) * (0.5f * pExtent->vec2.y);
+			float area = 4.f * glm::length(glm::cross(left, up));
+			if (!(area > 0.f)) continue;
+
+			// Lambertian from both faces:  power = 2 pi radiance area
+			EmissiveLights::MaterialData mat;
+			mat.emissive = pPower->vec3 / (2.f * float(M_PI) * area);
+			mat.twoSided = true;
+			uint32_t materialId = uint32_t(input.materials.size());
+			input.materials.push_back(mat);
+
+			uint32_t base = uint32_t(input.positions.size());
+			const vec3& center = pCenter->vec3;
+			input.positions.insert(input.positions.end(), { center - left - up, center + left - up, center + left + up, center - left + up });
+			if (!input.texCrds.empty()) input.texCrds.resize(input.positions.size(), vec2(0.f));
+			input.indices.push_back(uvec3(base, base + 1, base + 2));
+			input.indices.push_back(uvec3(base, base + 2, base + 3));
+			input.triMaterial.insert(input.triMaterial.end(), 2, materialId);
+		}
+	}
+
+	// FNV-1a over <size> bytes, continuing from <hash>
+	uint64_t hashBytes(uint64_t hash, const void* pData, size_t size)
+	{
+		const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData);
+		for (size_t i = 0; i < size; i++) hash = (hash ^ pBytes[i]) * 0x100000001B3ull;
+		return hash;
+	}
+
+	template<typename T>
+	uint64_t hashValue(uint64_t hash, const T& value)
+	{
+		return hashBytes(hash, &value, sizeof(T));
+	}
+
+	// Hash of what update() extracts from <pScene>, short of the vertex data:  the instances, every material's emission, the
+	//     transforms of the meshes that emit, and the user-defined variables the quad lights come from.  Cheap enough to
+	//     compare every frame, so moving an emitter or changing what emits rebuilds the list.
+	uint64_t hashEmitters(const RtScene* pScene)
+	{
+		uint64_t hash = 0xCBF29CE484222325ull;
+		for (uint32_t modelId = 0; modelId < pScene->getModelCount(); modelId++)
+		{
+			for (uint32_t modelInstId = 0; modelInstId < pScene->getModelInstanceCount(modelId); modelInstId++)
+			{
+				const auto& pModelInstance = pScene->getModelInstance(modelId, modelInstId);
+				const Model* pModel = pModelInstance->getObject().get();
+				hash = hashValue(hash, pModel);
+				for (uint32_t meshId = 0; meshId < pModel->getMeshCount(); meshId++)
+				{
+					for (uint32_t meshInstId = 0; meshInstId < pModel->getMeshInstanceCount(meshId); meshInstId++)
+					{
+						const auto& pMeshInstance = pModel->getMeshInstance(meshId, meshInstId);
+						const Material* pMaterial = pMeshInstance->getObject()->getMaterial().get();
+						const Texture* pTexture = pMaterial->getEmissiveTexture().get();
+						hash = hashValue(hash, pMaterial);
+						hash = hashValue(hash, pMaterial->getEmissiveColor());
+						hash = hashValue(hash, pTexture);
+						hash = hashValue(hash, pMaterial->getDoubleSided());
+						if (!pTexture && luminance(pMaterial->getEmissiveColor()) <= 0.f) continue;
+
+						hash = hashValue(hash, pModelInstance->getTransformMatrix());
+						hash = hashValue(hash, pMeshInstance->getTransformMatrix());
+					}
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < pScene->getUserVariableCount(); i++)
+		{
+			std::string name;
+			const Scene::UserVariable& var = pScene->getUserVariable(i, name);
+			hash = hashBytes(hash, name.data(), name.size());
+			hash = hashValue(hash, var.type);
+			if (var.type == Scene::UserVariable::Type::Vec2)      hash = hashValue(hash, var.vec2);
+			else if (var.type == Scene::UserVariable::Type::Vec3) hash = hashValue(hash, var.vec3);
+			else                                                  hash = hashValue(hash, readUserNumber(var));
+		}
+		return hash;
+	}
+};
+
+size_t EmissiveLights::Input::getByteSize() const
+{
+	size_t bytes = positions.size() * sizeof(vec3) + texCrds.size() * sizeof(vec2) + indices.size() * sizeof(uvec3) +
+		triMaterial.size() * sizeof(uint32_t) + materials.size() * sizeof(MaterialData);
+	for (const TextureData& tex : textures) bytes += tex.texels.size() * sizeof(vec3);
+	return bytes;
+}
+
+EmissiveLights::SharedPtr EmissiveLights::create(const TiledDispatch::SharedPtr& pDispatch)
+{
+	return SharedPtr(new EmissiveLights(pDispatch ? pDispatch : TiledDispatch::create()));
+}
+
+void EmissiveLights::setMaxPointsPerTriangle(uint32_t count)
+{
+	mMaxPointsPerTriangle = 1;
+	while (mMaxPointsPerTriangle * 2 <= std::min(count, 256u)) mMaxPointsPerTriangle *= 2;
+}
+
+uint32_t EmissiveLights::getPointsPerTriangle() const
+{
+	uint32_t count = mMaxPointsPerTriangle;
+	while (count > 1 && uint64_t(count) * mTriangles.size() > EMISSIVE_ID_COUNT) count /= 2;
+	return count;
+}
+
+uint64_t EmissiveLights::getByteSize() const
+{
+	return uint64_t(mTriangles.size()) * sizeof(EmissiveTriangle) + uint64_t(mEntries.size()) * sizeof(LightAliasTable::Entry);
+}
+
+bool EmissiveLights::update(RenderContext* pRenderContext, const RtScene::SharedPtr& pScene)
+{
+	if (!pScene) return false;
+	uint64_t sourceHash = hashEmitters(pScene.get());
+	if (mpSourceScene.lock() == pScene && mSourceHash == sourceHash) return false;
+	mpSourceScene = pScene;
+	mSourceHash = sourceHash;
+
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+	Input input;
+	std::map<const Material*, uint32_t> materialMap;      // kInvalidIndex for materials that don't emit
+	std::map<const Texture*, uint32_t> textureMap;
+	uint32_t meshTriangles = 0;
+	for (uint32_t modelId = 0; modelId < pScene->getModelCount(); modelId++)
+	{
+		for (uint32_t modelInstId = 0; modelInstId < pScene->getModelInstanceCount(modelId); modelInstId++)
+		{
+			const auto& pModelInstance = pScene->getModelInstance(modelId, modelInstId);
+			const Model* pModel = pModelInstance->getObject().get();
+			mat4 modelXform = pModelInstance->getTransformMatrix();
+
+			for (uint32_t meshId = 0; meshId < pModel->getMeshCount(); meshId++)
+			{
+				for (uint32_t meshInstId = 0; meshInstId < pModel->getMeshInstanceCount(meshId); meshInstId++)
+				{
+					const auto& pMeshInstance = pModel->getMeshInstance(meshId, meshInstId);
+					const Mesh::SharedPtr& pMesh = pMeshInstance->getObject();
+					const Vao::SharedPtr& pVao = pMesh->getVao();
+					meshTriangles += pMesh->getIndexCount() / 3;
+
+					// Only meshes whose material emits are read back
+					const Material* pMaterial = pMesh->getMaterial().get();
+					auto materialIt = materialMap.find(pMaterial);
+					if (materialIt == materialMap.end())
+					{
+						MaterialData mat;
+						mat.emissive = pMaterial->getEmissiveColor();
+						mat.twoSided = pMaterial->getDoubleSided();
+						const Texture::SharedPtr& pTexture = pMaterial->getEmissiveTexture();
+						if (pTexture)
+						{
+							auto textureIt = textureMap.find(pTexture.get());
+							if (textureIt == textureMap.end())
+							{
+								textureIt = textureMap.emplace(pTexture.get(), uint32_t(input.textures.size())).first;
+								input.textures.push_back(decodeTexture(pRenderContext, pTexture));
+							}
+							mat.emissiveTexture = textureIt->second;
+						}
+						bool emits = (mat.emissiveTexture != kInvalidIndex) || luminance(mat.emissive) > 0.f;
+						materialIt = materialMap.emplace(pMaterial, emits ? uint32_t(input.materials.size()) : kInvalidIndex).first;
+						if (emits) input.materials.push_back(mat);
+					}
+					uint32_t materialId = materialIt->second;
+					if (materialId == kInvalidIndex) continue;
+					if (pVao->getPrimitiveTopology() != Vao::Topology::TriangleList || !pVao->getIndexBuffer()) continue;
+
+					// Positions, and texture coordinates for a textured material
+					mat4 xform = modelXform * pMeshInstance->getTransformMatrix();
+					bool textured = (input.materials[materialId].emissiveTexture != kInvalidIndex);
+					uint32_t baseVertex = uint32_t(input.positions.size());
+					input.positions.resize(baseVertex + pMesh->getVertexCount());
+					input.texCrds.resize(input.positions.size(), vec2(0.f));
+					const uint32_t kLocations[] = { VERTEX_POSITION_LOC, VERTEX_TEXCOORD_LOC };
+					for (uint32_t a = 0; a < (textured ? 2u : 1u); a++)
+					{
+						Vao::ElementDesc desc = pVao->getElementIndexByLocation(kLocations[a]);
+						if (desc.vbIndex == Vao::ElementDesc::kInvalidIndex) continue;
+
+						const auto& pLayout = pVao->getVertexLayout()->getBufferLayout(desc.vbIndex);
+						const Buffer::SharedPtr& pVB = pVao->getVertexBuffer(desc.vbIndex);
+						ResourceFormat format = pLayout->getElementFormat(desc.elementIndex);
+						if (getFormatType(format) != FormatType::Float || getFormatBytesPerBlock(format) != 4 * getFormatChannelCount(format))
+						{
+							logWarning("EmissiveLights - unsupported vertex format " + to_string(format) + ", ignoring attribute");
+							continue;
+						}
+
+						const uint8_t* pData = reinterpret_cast<const uint8_t*>(pVB->map(Buffer::MapType::Read));
+						for (uint32_t v = 0; v < pMesh->getVertexCount(); v++)
+						{
+							vec4 element(0.f, 0.f, 0.f, 1.f);
+							readElement(pData, pLayout->getStride(), pLayout->getElementOffset(desc.elementIndex), format, v, element);
+							if (a == 0) input.positions[baseVertex + v] = vec3(xform * vec4(vec3(element), 1.f));
+							else        input.texCrds[baseVertex + v] = vec2(element);
+						}
+						pVB->unmap();
+					}
+
+					// Read back the index buffer (16- or 32-bit)
+					const Buffer::SharedPtr& pIB = pVao->getIndexBuffer();
+					bool is16Bit = (pVao->getIndexBufferFormat() == ResourceFormat::R16Uint);
+					const void* pIndices = pIB->map(Buffer::MapType::Read);
+					for (uint32_t i = 0; i + 2 < pMesh->getIndexCount(); i += 3)
+					{
+						uvec3 tri;
+						for (uint32_t k = 0; k < 3; k++)
+						{
+							tri[k] = baseVertex + (is16Bit ? uint32_t(reinterpret_cast<const uint16_t*>(pIndices)[i + k])
+							                               : reinterpret_cast<const uint32_t*>(pIndices)[i + k]);
+						}
+						input.indices.push_back(tri);
+						input.triMaterial.push_back(materialId);
+					}
+					pIB->unmap();
+				}
+			}
+		}
+	}
+	addQuadLights(pScene.get(), input);
+	mLastReadbackMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+
+	build(input);
+	mLastBuildMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+	logInfo("EmissiveLights: " + std::to_string(mTriangles.size()) + " emissive triangles of " + std::to_string(input.indices.size()) + " read back (" +
+		std::to_string(meshTriangles) + " in the scene's meshes), " + std::to_string(getByteSize() / 1024) + " KB;  readback " + std::to_string(mLastReadbackMs) +
+		" ms, total " + std::to_string(mLastBuildMs) + " ms");
+	return true;
+}
+
+bool EmissiveLights::update(const CpuScene::SharedPtr& pScene)
+{
+	if (!pScene || mpSourceCpuScene.lock() == pScene) return false;
+	mpSourceCpuScene = pScene;
+
+	// The materials that emit, and their textures
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+	Input input;
+	const std::vector<CpuScene::MaterialData>& materials = pScene->getMaterials();
+	std::vector<uint32_t> materialMap(materials.size(), kInvalidIndex);
+	std::map<uint32_t, uint32_t> textureMap;
+	for (size_t m = 0; m < materials.size(); m++)
+	{
+		MaterialData mat;
+		mat.emissive = materials[m].emissive;
+		mat.twoSided = materials[m].doubleSided;
+		uint32_t texture = materials[m].emissiveTexture;
+		if (texture != CpuScene::kInvalidIndex)
+		{
+			auto textureIt = textureMap.find(texture);
+			if (textureIt == textureMap.end())
+			{
+				const CpuScene::TextureData& src = pScene->getTextures()[texture];
+				TextureData tex;
+				tex.width = src.width;
+				tex.height = src.height;
+				tex.texels.resize(src.texels.size());
+				for (size_t i = 0; i < src.texels.size(); i++) tex.texels[i] = vec3(src.texels[i]);
+				textureIt = textureMap.emplace(texture, uint32_t(input.textures.size())).first;
+				input.textures.push_back(std::move(tex));
+			}
+			mat.emissiveTexture = textureIt->second;
+		}
+		if (mat.emissiveTexture == kInvalidIndex && luminance(mat.emissive) <= 0.f) continue;
+		materialMap[m] = uint32_t(input.materials.size());
+		input.materials.push_back(mat);
+	}
+
+	// Its geometry is already in world space:  copy the emissive triangles, and only the vertices they use
+	const std::vector<vec3>& positions = pScene->getPositions();
+	const std::vector<vec2>& texCrds = pScene->getTexCrds();
+	const std::vector<uvec3>& indices = pScene->getIndices();
+	const std::vector<uint32_t>& triMaterial = pScene->getTriangleMaterials();
+	std::vector<uint32_t> vertexMap(positions.size(), kInvalidIndex);
+	for (size_t t = 0; t < indices.size(); t++)
+	{
+		uint32_t materialId = materialMap[triMaterial[t]];
+		if (materialId == kInvalidIndex) continue;
+
+		uvec3 tri;
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[t][k];
+			if (vertexMap[v] == kInvalidIndex)
+			{
+				vertexMap[v] = uint32_t(input.positions.size());
+				input.positions.push_back(positions[v]);
+				input.texCrds.push_back(v < texCrds.size() ? texCrds[v] : vec2(0.f));
+			}
+			tri[k] = vertexMap[v];
+		}
+		input.indices.push_back(tri);
+		input.triMaterial.push_back(materialId);
+	}
+	mLastReadbackMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+
+	build(input);
+	mLastBuildMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+	logInfo("EmissiveLights: " + std::to_string(mTriangles.size()) + " emissive triangles of " + std::to_string(input.indices.size()) + " copied (" +
+		std::to_string(indices.size()) + " in the CPU scene), " + std::to_string(getByteSize() / 1024) + " KB;  total " + std::to_string(mLastBuildMs) + " ms");
+	return true;
+}
+
+void EmissiveLights::build(const Input& input)
+{
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+	uint32_t inputCount = uint32_t(input.indices.size());
+	std::vector<EmissiveTriangle> triangles(inputCount);
+	std::vector<float> powers(inputCount, 0.f);
+
+	// Triangles are independent:  launch over them in rows of kLaunchWidth, so each tile covers a contiguous range
+	if (inputCount > 0)
+	{
+		mpDispatch->execute(uvec2(kLaunchWidth, (inputCount + kLaunchWidth - 1) / kLaunchWidth), [&](const uvec2& tileStart, const uvec2& tileEnd)
+		{
+			for (uint32_t y = tileStart.y; y < tileEnd.y; y++)
+			{
+				for (uint32_t i = y * kLaunchWidth + tileStart.x; i < std::min(y * kLaunchWidth + tileEnd.x, inputCount); i++)
+				{
+					const uvec3& idx = input.indices[i];
+					const MaterialData& mat = input.materials[input.triMaterial[i]];
+					vec3 radiance = mat.emissive;
+					if (mat.emissiveTexture != kInvalidIndex && !input.texCrds.empty())
+					{
+						radiance = averageTexture(input.textures[mat.emissiveTexture], input.texCrds[idx.x], input.texCrds[idx.y], input.texCrds[idx.z], i);
+					}
+					triangles[i] = packTriangle(input.positions[idx.x], input.positions[idx.y], input.positions[idx.z], radiance, mat.twoSided);
+					powers[i] = trianglePower(triangles[i]);
+				}
+			}
+		});
+	}
+
+	// Keep the triangles that emit, in order.  If the candidate ids would run out, keep the most powerful ones.
+	std::vector<uint32_t> kept;
+	for (uint32_t i = 0; i < inputCount; i++) if (powers[i] > 0.f) kept.push_back(i);
+	if (kept.size() > EMISSIVE_ID_COUNT)
+	{
+		logWarning("EmissiveLights - " + std::to_string(kept.size()) + " emissive triangles, keeping the " + std::to_string(EMISSIVE_ID_COUNT) + " most powerful");
+		std::nth_element(kept.begin(), kept.begin() + EMISSIVE_ID_COUNT, kept.end(), [&](uint32_t a, uint32_t b) { return powers[a] > powers[b]; });
+		kept.resize(EMISSIVE_ID_COUNT);
+		std::sort(kept.begin(), kept.end());
+	}
+
+	mTriangles.resize(kept.size());
+	std::vector<float> keptPowers(kept.size());
+	mTotalPower = 0.0;
+	for (size_t i = 0; i < kept.size(); i++)
+	{
+		mTriangles[i] = triangles[kept[i]];
+		keptPowers[i] = powers[kept[i]];
+		mTotalPower += keptPowers[i];
+	}
+	LightAliasTable::build(keptPowers, mEntries);
+	mBuildCount++;
+	mBufferDirty = true;
+	mLastBuildMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+}
+
+uint32_t EmissiveLights::sampleTriangle(float u, float uAlias, float& pdf) const
+{
+	uint32_t count = getTriangleCount();
+	if (count == 0) { pdf = 0.f; return 0; }
+
+	uint32_t bucket = std::min(uint32_t(u * float(count)), count - 1);
+	uint32_t triangle = (uAlias < mEntries[bucket].prob) ? bucket : mEntries[bucket].alias;
+	pdf = mEntries[triangle].pdf;
+	return triangle;
+}
+
+vec3 EmissiveLights::samplePoint(uint32_t triangle, float u0, float u1) const
+{
+	const EmissiveTriangle& tri = mTriangles[triangle];
+	float su = std::sqrt(u0);
+	return tri.p0 + tri.edge1 * (su * (1.f - u1)) + tri.edge2 * (su * u1);
+}
+
+vec3 EmissiveLights::getPointPosition(uint32_t pointIndex) const
+{
+	uint32_t pointsPerTriangle = getPointsPerTriangle();
+	uint32_t triangle = pointIndex / pointsPerTriangle;
+	if (triangle >= getTriangleCount()) return vec3(0.f);
+	uint32_t latticePoint = pointIndex % pointsPerTriangle;
+	return samplePoint(triangle, emissiveToFloat(emissiveLatticeU(triangle, latticePoint, pointsPerTriangle)), emissiveToFloat(emissiveLatticeV(triangle, latticePoint)));
+}
+
+vec3 EmissiveLights::getRadiance(uint32_t triangle) const
+{
+	return (triangle < getTriangleCount()) ? unpackRadiance(mTriangles[triangle]) : vec3(0.f);
+}
+
+void EmissiveLights::setIntoVars(SimpleVars::SharedPtr& pVars)
+{
+	size_t triangleCount = std::max<size_t>(1, mTriangles.size());
+	if (!mpTriangleBuffer || mpTriangleBuffer->getElementCount() != triangleCount)
+	{
+		mpTriangleBuffer = pVars->createStructuredBuffer("gEmissiveTriangles", triangleCount);
+		mBufferDirty = true;
+	}
+	if (!mpTableBuffer || mpTableBuffer->getElementCount() != triangleCount)
+	{
+		mpTableBuffer = pVars->createStructuredBuffer("gEmissiveAliasTable", triangleCount);
+		mBufferDirty = true;
+	}
+	if (!mpTriangleBuffer || !mpTableBuffer) return;
+
+	if (mBufferDirty && !mTriangles.empty())
+	{
+		mpTriangleBuffer->setBlob(mTriangles.data(), 0, mTriangles.size() * sizeof(EmissiveTriangle));
+		mpTableBuffer->setBlob(mEntries.data(), 0, mEntries.size() * sizeof(LightAliasTable::Entry));
+	}
+	mBufferDirty = false;
+
+	pVars["gEmissiveTriangles"] = mpTriangleBuffer;
+	pVars["gEmissiveAliasTable"] = mpTableBuffer;
+	pVars["EmissiveLightsCB"]["gEmissiveTriangleCount"] = isActive() ? getTriangleCount() : 0u;
+	pVars["EmissiveLightsCB"]["gEmissivePointsPerTriangle"] = getPointsPerTriangle();
+	pVars["EmissiveLightsCB"]["gEmissiveCandidateProb"] = mCandidateFraction;
+}
+
+bool EmissiveLights::renderGui(Gui* pGui)
+{
+	bool dirty = pGui->addCheckBox("Sample emissive triangles", mEnabled);
+	if (mEnabled)
+	{
+		dirty |= pGui->addFloatVar("Emissive candidates", mCandidateFraction, 0.f, 1.f, 0.05f);
+		int32_t points = int32_t(mMaxPointsPerTriangle);
+		if (pGui->addIntVar("Points per triangle", points, 1, 256))
+		{
+			setMaxPointsPerTriangle(uint32_t(points));
+			dirty = true;
+		}
+		pGui->addText((std::to_string(mTriangles.size()) + " triangles, " + std::to_string(getPointsPerTriangle()) + " points each, " +
+			std::to_string(getByteSize() / 1024) + " KB, extracted in " + std::to_string(mLastBuildMs) + " ms").c_str());
+	}
+	return dirty;
+}
+
+EmissiveLights::Benchmark EmissiveLights::benchmark(uint32_t triangleCount, uint32_t samples)
+{
+	Benchmark result;
+	if (triangleCount < 2 || samples == 0) return result;
+
+	// A gently curved 2x2 sheet, one unit above the origin and facing down, cut into side x side quads.  Rows in the
+	//     first half take a 1024^2 striped texture (whose dark stripes drop out), the rest one of eight constant
+	//     materials spanning three orders of magnitude.
+	uint32_t side = std::max(1u, uint32_t(std::sqrt(double(triangleCount) / 2.0)));
+	Input input;
+	for (uint32_t m = 0; m < 8; m++)
+	{
+		MaterialData mat;
+		mat.emissive = vec3(1.f, 0.9f, 0.8f) * std::pow(10.f, float(m) * 3.f / 7.f - 1.f);
+		input.materials.push_back(mat);
+	}
+	MaterialData texturedMat;
+	texturedMat.emissiveTexture = 0;
+	input.materials.push_back(texturedMat);
+
+	TextureData tex;
+	tex.width = tex.height = 1024;
+	tex.texels.resize(size_t(tex.width) * tex.height);
+	for (uint32_t y = 0; y < tex.height; y++)
+	{
+		for (uint32_t x = 0; x < tex.width; x++) tex.texels[size_t(y) * tex.width + x] = ((x / 32) % 2 == 0) ? vec3(20.f, 16.f, 12.f) : vec3(0.f);
+	}
+	input.textures.push_back(std::move(tex));
+
+	for (uint32_t y = 0; y <= side; y++)
+	{
+		for (uint32_t x = 0; x <= side; x++)
+		{
+			vec2 uv(float(x) / float(side), float(y) / float(side));
+			input.positions.push_back(vec3(2.f * uv.x - 1.f, 1.f + 0.05f * std::sin(6.f * uv.x) * std::cos(6.f * uv.y), 2.f * uv.y - 1.f));
+			input.texCrds.push_back(uv);
+		}
+	}
+	for (uint32_t y = 0; y < side; y++)
+	{
+		for (uint32_t x = 0; x < side; x++)
+		{
+			uint32_t v00 = y * (side + 1) + x, v10 = v00 + 1, v01 = v00 + side + 1, v11 = v01 + 1;
+			uint32_t materialId = (y < side / 2) ? 8u : ((x * 7u + y * 3u) % 8u);
+			input.indices.push_back(uvec3(v00, v10, v11));   // Counterclockwise seen from below:  faces down
+			input.indices.push_back(uvec3(v00, v11, v01));
+			input.triMaterial.insert(input.triMaterial.end(), 2, materialId);
+		}
+	}
+	result.inputTriangles = uint32_t(input.indices.size());
+	result.inputBytes = input.getByteSize();
+
+	// Extraction, with the memory it holds on to and its peak
+	TiledDispatch::SharedPtr pDispatch = TiledDispatch::create();
+	uint64_t residentBefore = getProcessWorkingSet();
+	uint64_t peakBefore = getProcessPeakWorkingSet();
+	SharedPtr pLights = create(pDispatch);
+	pLights->build(input);
+	result.residentBytes = getProcessWorkingSet() - std::min(residentBefore, getProcessWorkingSet());
+	result.peakBytes = getProcessPeakWorkingSet() - peakBefore;
+	result.extractMs = pLights->getLastBuildTime();
+	result.threadCount = pDispatch->getThreadCount();
+	result.emissiveTriangles = pLights->getTriangleCount();
+	result.outputBytes = pLights->getByteSize();
+	{
+		SharedPtr pSerialLights = create(TiledDispatch::create(1));
+		pSerialLights->build(input);
+		result.serialExtractMs = pSerialLights->getLastBuildTime();
+	}
+	if (pLights->getTotalPower() <= 0.0) return result;
+
+	// The table against power / total power
+	for (uint32_t t = 0; t < pLights->getTriangleCount(); t++)
+	{
+		double expected = double(trianglePower(pLights->mTriangles[t])) / pLights->getTotalPower();
+		result.maxPdfError = std::max(result.maxPdfError, float(std::abs(double(pLights->mEntries[t].pdf) / expected - 1.0)));
+	}
+
+	// Irradiance at the origin, facing up:  every triangle at its centroid (they're tiny), against uniform area samples
+	const vec3 P(0.f), N(0.f, 1.f, 0.f);
+	double reference = 0.0;
+	for (const EmissiveTriangle& tri : pLights->mTriangles)
+	{
+		reference += pointIrradiance(tri, tri.p0 + (tri.edge1 + tri.edge2) / 3.f, tri.area, luminance(unpackRadiance(tri)), P, N);
+	}
+	std::mt19937 rng(0x1456u);
+	std::uniform_real_distribution<float> uniform(0.f, 1.f);
+	double estimate = 0.0;
+	for (uint32_t s = 0; s < samples; s++)
+	{
+		float pdf;
+		uint32_t t = pLights->sampleTriangle(uniform(rng), uniform(rng), pdf);
+		const EmissiveTriangle& tri = pLights->mTriangles[t];
+		vec3 pos = pLights->samplePoint(t, uniform(rng), uniform(rng));
+		if (pdf > 0.f) estimate += pointIrradiance(tri, pos, tri.area, luminance(unpackRadiance(tri)), P, N) / pdf;
+	}
+	result.sampledError = float(std::abs(estimate / double(samples) / reference - 1.0));
+
+	// The fixed points where they matter most:  a single 1x1 quad light half a unit above the receiver.  Reference from
+	//     a 512^2 midpoint rule over each triangle.
+	Input quad;
+	MaterialData quadMat;
+	quadMat.emissive = vec3(1.f);
+	quad.materials.push_back(quadMat);
+	quad.positions = { vec3(-0.5f, 0.5f, -0.5f), vec3(0.5f, 0.5f, -0.5f), vec3(0.5f, 0.5f, 0.5f), vec3(-0.5f, 0.5f, 0.5f) };
+	quad.indices = { uvec3(0, 1, 2), uvec3(0, 2, 3) };
+	quad.triMaterial = { 0, 0 };
+	SharedPtr pQuad = create(pDispatch);
+	pQuad->build(quad);
+	const vec3 quadP(0.2f, 0.f, 0.1f);
+	const uint32_t kRule = 512;
+	double quadReference = 0.0, latticeSum = 0.0;
+	uint32_t pointsPerTriangle = pQuad->getPointsPerTriangle();
+	for (uint32_t t = 0; t < pQuad->getTriangleCount(); t++)
+	{
+		const EmissiveTriangle& tri = pQuad->mTriangles[t];
+		for (uint32_t i = 0; i < kRule; i++)
+		{
+			for (uint32_t j = 0; j < kRule; j++)
+			{
+				vec3 pos = pQuad->samplePoint(t, (float(i) + 0.5f) / float(kRule), (float(j) + 0.5f) / float(kRule));
+				quadReference += pointIrradiance(tri, pos, tri.area / float(kRule * kRule), 1.f, quadP, N);
+			}
+		}
+		for (uint32_t k = 0; k < pointsPerTriangle; k++)
+		{
+			latticeSum += pointIrradiance(tri, pQuad->getPointPosition(t * pointsPerTriangle + k), tri.area / float(pointsPerTriangle), 1.f, quadP, N);
+		}
+	}
+	result.latticeBias = (quadReference > 0.0) ? float(std::abs(latticeSum / quadReference - 1.0)) : 0.f;
+	return result;
+}
+
+void EmissiveLights::logBenchmark(const Benchmark& bench)
+{
+	auto mb = [](uint64_t bytes) { return std::to_string(double(bytes) / (1024.0 * 1024.0)) + " MB"; };
+	logInfo("EmissiveLights: " + std::to_string(bench.emissiveTriangles) + " of " + std::to_string(bench.inputTriangles) + " triangles emit;  extraction " +
+		std::to_string(bench.extractMs) + " ms on " + std::to_string(bench.threadCount) + " threads, " + std::to_string(bench.serialExtractMs) + " ms on one;  " +
+		"memory:  " + mb(bench.inputBytes) + " of mesh data in, " + mb(bench.outputBytes) + " out (" + std::to_string(sizeof(EmissiveTriangle) + sizeof(LightAliasTable::Entry)) +
+		" bytes per triangle), working set +" + mb(bench.residentBytes) + ", peak +" + mb(bench.peakBytes) + ";  max pdf error " + std::to_string(bench.maxPdfError) +
+		", sampled irradiance error " + std::to_string(bench.sampledError) + ", fixed-point bias " + std::to_string(bench.latticeBias));
+}
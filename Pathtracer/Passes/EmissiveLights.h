@@ -0,0 +1,165 @@
+#pragma once
+
+#include "Falcor.h"
+#include "../SharedUtils/SimpleVars.h"
+#include "../SharedUtils/TiledDispatch.h"
+#include "../SharedUtils/CpuScene.h"
+#include "../Shaders/EmissiveTriangle.h"
+#include "LightAliasTable.h"
+
+using namespace Falcor;
+
+// Emissive geometry as ReSTIR light candidates.  update() reads back every mesh whose material emits (skipping all the
+//     others), plus the quad lights in the scene's user-defined variables, and build() flattens them into a list of
+//     world-space triangles, each with its emitted radiance averaged over the triangle (over the texels it covers,
+//     for an emissive texture).  A triangle's power is pi times that radiance's luminance times its area, doubled if
+//     it emits from both faces, and an alias table over the powers picks triangles (see emissiveLights.hlsli):
+//
+//         bucket   = min(int(u0 * N), N - 1);
+//         triangle = (u1 < table[bucket].prob) ? bucket : table[bucket].alias;
+//         pdf      = table[triangle].pdf;
+//
+//     build() extracts the triangles in parallel on a TiledDispatch, and drops the ones that don't emit;  only the
+//     alias table is built serially.
+//
+//     The user-defined quad lights are read as numLights, then l<i>_power (watts, rgb), l<i>_center, l<i>_left and
+//     l<i>_up (the quad's axes) and l<i>_extent (its width and height along them).  They have no facing, so they emit
+//     from both sides.
+//
+//     On the GPU a candidate is one of a fixed set of points per triangle (see EmissiveTriangle.h), since a reservoir
+//     holds an id rather than a position.  samplePoint() is the continuous, uniform-over-area sample those points
+//     stratify;  benchmark() reports the bias of using the points instead.
+class EmissiveLights : public std::enable_shared_from_this<EmissiveLights>
+{
+public:
+	using SharedPtr = std::shared_ptr<EmissiveLights>;
+	using SharedConstPtr = std::shared_ptr<const EmissiveLights>;
+	virtual ~EmissiveLights() = default;
+
+	static const uint32_t kInvalidIndex = 0xFFFFFFFFu;
+
+	// A decoded, mip 0 copy of an emissive texture
+	struct TextureData
+	{
+		uint32_t          width = 0;
+		uint32_t          height = 0;
+		std::vector<vec3> texels;
+	};
+
+	// An emissive material:  the texture if there is one, the constant color otherwise (as Falcor's shading does)
+	struct MaterialData
+	{
+		vec3     emissive = vec3(0.f);
+		uint32_t emissiveTexture = kInvalidIndex;   ///< Index into Input::textures
+		bool     twoSided = false;
+	};
+
+	// What build() extracts from:  world-space triangles and their emissive materials
+	struct Input
+	{
+		std::vector<vec3>         positions;
+		std::vector<vec2>         texCrds;           ///< Per position;  may be empty if no material has a texture
+		std::vector<uvec3>        indices;
+		std::vector<uint32_t>     triMaterial;
+		std::vector<MaterialData> materials;
+		std::vector<TextureData>  textures;
+
+		size_t getByteSize() const;
+	};
+
+	// Result of benchmark()
+	struct Benchmark
+	{
+		uint32_t inputTriangles = 0;
+		uint32_t emissiveTriangles = 0;      ///< Kept, i.e. with non-zero power
+		uint32_t threadCount = 0;
+		float    extractMs = 0.f;            ///< build() on every thread
+		float    serialExtractMs = 0.f;      ///< Same, on one thread
+		uint64_t inputBytes = 0;             ///< Mesh data the extraction reads
+		uint64_t outputBytes = 0;            ///< Packed triangles plus alias table, as uploaded
+		uint64_t residentBytes = 0;          ///< Growth of the working set while the result is held
+		uint64_t peakBytes = 0;              ///< Growth of the process's peak working set during the extraction
+		float    maxPdfError = 0.f;          ///< Max relative error between the table's pdf and power / total power
+		float    sampledError = 0.f;         ///< Relative error of irradiance estimated from uniform area samples
+		float    latticeBias = 0.f;          ///< Relative error of irradiance from the fixed points of a single, nearby quad light
+	};
+
+	// Create an extractor.  If no dispatcher is given, one is created using all cores.
+	static SharedPtr create(const TiledDispatch::SharedPtr& pDispatch = nullptr);
+
+	// Extract from <pScene> if it isn't the scene of the last build, or if an instance moved, a material's emission changed
+	//     or a quad light changed since.  Returns true if the list was rebuilt.
+	bool update(RenderContext* pRenderContext, const RtScene::SharedPtr& pScene);
+
+	// Same, from a CPU copy of a scene (e.g. a snapshot loaded for batch rendering).  It has no quad lights, and doesn't
+	//     change, so only a different scene is extracted again.
+	bool update(const CpuScene::SharedPtr& pScene);
+
+	// Extract the emissive triangles from <input> and build the alias table over them
+	void build(const Input& input);
+
+	// Same as sampleEmissivePoint()'s triangle pick in emissiveLights.hlsli.  Returns the triangle and its probability in pdf.
+	uint32_t sampleTriangle(float u, float uAlias, float& pdf) const;
+
+	// A point uniformly distributed over <triangle>'s area
+	vec3 samplePoint(uint32_t triangle, float u0, float u1) const;
+
+	// Position of candidate point <pointIndex> (its id past EMISSIVE_ID_BASE), as getEmissivePointData() finds it
+	vec3 getPointPosition(uint32_t pointIndex) const;
+
+	// Emitted radiance of a triangle, as unpacked by the shaders
+	vec3 getRadiance(uint32_t triangle) const;
+
+	// Bind gEmissiveTriangles, gEmissiveAliasTable and the EmissiveLightsCB constants, uploading first if needed.  Binds
+	//     no triangles (so no candidate is drawn from them) unless isActive().
+	void setIntoVars(SimpleVars::SharedPtr& pVars);
+
+	// Sampling and GUI controls.  Returns true if any changed.
+	bool renderGui(Gui* pGui);
+
+	// Time extraction from a synthetic, finely tessellated emitter of about <triangleCount> triangles, half of them
+	//     textured, on all threads and on one, and measure its memory.  Then check the sampling:  the table's pdfs, the
+	//     irradiance estimated from <samples> uniform area samples, and irradiance from the fixed points.
+	static Benchmark benchmark(uint32_t triangleCount = 1u << 22, uint32_t samples = 1u << 20);
+	static void logBenchmark(const Benchmark& bench);
+
+	// Accessors
+	bool isEnabled() const                          { return mEnabled; }
+	void setEnabled(bool enabled)                   { mEnabled = enabled; }
+	bool isActive() const                           { return mEnabled && mTotalPower > 0.0; }   ///< Enabled, with something that emits
+	float getCandidateFraction() const              { return mCandidateFraction; }              ///< Share of RIS candidates drawn from the triangles
+	void setCandidateFraction(float fraction)       { mCandidateFraction = glm::clamp(fraction, 0.f, 1.f); }
+	uint32_t getMaxPointsPerTriangle() const        { return mMaxPointsPerTriangle; }
+	void setMaxPointsPerTriangle(uint32_t count);
+	uint32_t getPointsPerTriangle() const;          ///< At most getMaxPointsPerTriangle(), fewer if the ids would run out
+	uint32_t getTriangleCount() const               { return uint32_t(mTriangles.size()); }
+	const std::vector<EmissiveTriangle>& getTriangles() const { return mTriangles; }
+	const std::vector<LightAliasTable::Entry>& getEntries() const { return mEntries; }
+	double getTotalPower() const                    { return mTotalPower; }
+	uint64_t getByteSize() const;                   ///< Of the packed triangles and the alias table
+	float getLastBuildTime() const                  { return mLastBuildMs; }      ///< In ms (with the readback, after update())
+	float getLastReadbackTime() const               { return mLastReadbackMs; }   ///< In ms, after update()
+	uint32_t getBuildCount() const                  { return mBuildCount; }
+
+protected:
+	EmissiveLights(const TiledDispatch::SharedPtr& pDispatch) : mpDispatch(pDispatch) {}
+
+	TiledDispatch::SharedPtr      mpDispatch;
+	std::weak_ptr<RtScene>        mpSourceScene;                  ///< Scene of the last build
+	uint64_t                      mSourceHash = 0;                ///< Its instances, emission and quad lights, as of the last build
+	std::weak_ptr<CpuScene>       mpSourceCpuScene;               ///< Same, when built from a CpuScene
+	bool                          mEnabled = true;
+	float                         mCandidateFraction = 0.5f;
+	uint32_t                      mMaxPointsPerTriangle = 16;
+
+	std::vector<EmissiveTriangle> mTriangles;
+	std::vector<LightAliasTable::Entry> mEntries;
+	double                        mTotalPower = 0.0;              ///< Sum of the triangles' powers
+	float                         mLastBuildMs = 0.f;
+	float                         mLastReadbackMs = 0.f;
+	uint32_t                      mBuildCount = 0;
+
+	StructuredBuffer::SharedPtr   mpTriangleBuffer;
+	StructuredBuffer::SharedPtr   mpTableBuffer;
+	bool                          mBufferDirty = true;
+};
@@ -0,0 +1,345 @@
+#include "EnvMapSampler.h"
+#include "glm/gtc/packing.hpp"
+#include <random>
+
+namespace {
+	float luminance(const vec3& rgb)
+	{
+		float l = glm::dot(rgb, vec3(0.2126f, 0.7152f, 0.0722f));
+		return std::isfinite(l) ? std::max(l, 0.f) : 0.f;
+	}
+
+	// An alias pick from <count> entries with one random number:  its integer part picks the bucket, its fraction
+	//     whether to keep the bucket's own entry.  Same as envAliasPick() in envMapSampling.hlsli.
+	uint32_t aliasPick(const LightAliasTable::Entry* pTable, uint32_t count, float u)
+	{
+		float scaled = u * float(count);
+		uint32_t bucket = std::min(uint32_t(scaled), count - 1);
+		return (scaled - float(bucket) < pTable[bucket].prob) ? bucket : pTable[bucket].alias;
+	}
+
+	// Same as wsVectorToLatLong() in simpleGIUtils.hlsli
+	vec2 directionToLatLong(const vec3& dir)
+	{
+		vec3 p = glm::normalize(dir);
+		return vec2((1.f + std::atan2(p.x, -p.z) * float(1.0 / M_PI)) * 0.5f, std::acos(glm::clamp(p.y, -1.f, 1.f)) * float(1.0 / M_PI));
+	}
+};
+
+EnvMapSampler::SharedPtr EnvMapSampler::create(const TiledDispatch::SharedPtr& pDispatch)
+{
+	return SharedPtr(new EnvMapSampler(pDispatch ? pDispatch : TiledDispatch::create()));
+}
+
+void EnvMapSampler::setMaxGridSize(const uvec2& size)
+{
+	// Candidate ids are gLightsCount + cell in a float, and must stay below the emissive triangles' EMISSIVE_ID_BASE (2^23):
+	//     leave 2^22 of them to the lights
+	mMaxGridSize = glm::max(size, uvec2(1, 1));
+	while (uint64_t(mMaxGridSize.x) * mMaxGridSize.y > (1ull << 22)) mMaxGridSize = glm::max(mMaxGridSize / 2u, uvec2(1, 1));
+}
+
+vec3 EnvMapSampler::latLongToDirection(const vec2& uv)
+{
+	float phi = (2.f * uv.x - 1.f) * float(M_PI);
+	float theta = uv.y * float(M_PI);
+	float sinTheta = std::sin(theta);
+	return vec3(sinTheta * std::sin(phi), std::cos(theta), -sinTheta * std::cos(phi));
+}
+
+bool EnvMapSampler::update(RenderContext* pRenderContext, const Texture::SharedPtr& pEnvMap)
+{
+	if (!pEnvMap || mpSourceMap.lock() == pEnvMap) return false;
+	mpSourceMap = pEnvMap;
+
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+	ResourceFormat format = pEnvMap->getFormat();
+	uint32_t channels = getFormatChannelCount(format);
+	uint32_t bytesPerTexel = getFormatBytesPerBlock(format);
+	FormatType type = getFormatType(format);
+	uvec2 size(pEnvMap->getWidth(), pEnvMap->getHeight());
+	size_t texelCount = size_t(size.x) * size.y;
+
+	bool isFloat32 = type == FormatType::Float && bytesPerTexel == 4 * channels;
+	bool isFloat16 = type == FormatType::Float && bytesPerTexel == 2 * channels;
+	bool isUnorm8 = (type == FormatType::Unorm || type == FormatType::UnormSrgb) && bytesPerTexel == channels;
+	if (isCompressedFormat(format) || channels < 3 || (!isFloat32 && !isFloat16 && !isUnorm8))
+	{
+		logWarning("EnvMapSampler - environment map format " + to_string(format) + " is not supported, not sampling it");
+		build(nullptr, uvec2(0, 0), 4);
+		return true;
+	}
+
+	std::vector<uint8> data = pRenderContext->readTextureSubresource(pEnvMap.get(), 0);
+	if (isFloat32)
+	{
+		build(reinterpret_cast<const float*>(data.data()), size, channels);
+	}
+	else
+	{
+		// Widen to rgb floats first (the map is read once per change, so the copy doesn't matter)
+		bool isBgr = (format == ResourceFormat::BGRA8Unorm || format == ResourceFormat::BGRA8UnormSrgb ||
+		              format == ResourceFormat::BGRX8Unorm || format == ResourceFormat::BGRX8UnormSrgb);
+		std::vector<float> texels(texelCount * 3);
+		for (size_t i = 0; i < texelCount; i++)
+		{
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				texels[i * 3 + c] = isFloat16 ? glm::unpackHalf1x16(reinterpret_cast<const uint16_t*>(data.data())[i * channels + c])
+				                              : float(data[i * bytesPerTexel + c]) / 255.f;
+			}
+			if (isBgr) std::swap(texels[i * 3], texels[i * 3 + 2]);
+		}
+		build(texels.data(), size, 3);
+	}
+
+	mLastBuildMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+	return true;
+}
+
+void EnvMapSampler::build(const float* pTexels, const uvec2& size, uint32_t channels)
+{
+	mMapSize = pTexels ? size : uvec2(0, 0);
+	mGridSize = glm::min(mMapSize, mMaxGridSize);
+	uint32_t columns = mGridSize.x, rows = mGridSize.y;
+	mCells.assign(size_t(columns) * rows, vec4(0.f));
+	mEntries.resize(mCells.empty() ? 0 : rows + mCells.size());
+	mTotalPower = 0.0;
+	mBuildCount++;
+	mBufferDirty = true;
+	if (mCells.empty()) return;
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+
+	// Rows are independent, so the launch is one cell wide and each tile filters and builds its own rows' tables
+	std::vector<float> rowPowers(rows, 0.f);
+	mpDispatch->execute(uvec2(1, rows), [&](const uvec2& tileStart, const uvec2& tileEnd)
+	{
+		std::vector<float> weights(columns);
+		std::vector<LightAliasTable::Entry> rowTable;
+		for (uint32_t row = tileStart.y; row < tileEnd.y; row++)
+		{
+			// Every cell in a row covers 2 pi / columns in phi and the same band of cos(theta)
+			uint32_t y0 = uint32_t(uint64_t(row) * size.y / rows);
+			uint32_t y1 = uint32_t(uint64_t(row + 1) * size.y / rows);
+			float solidAngle = float(2.0 * M_PI / double(columns) * (std::cos(M_PI * row / rows) - std::cos(M_PI * (row + 1) / rows)));
+
+			double rowPower = 0.0;
+			for (uint32_t column = 0; column < columns; column++)
+			{
+				uint32_t x0 = uint32_t(uint64_t(column) * size.x / columns);
+				uint32_t x1 = uint32_t(uint64_t(column + 1) * size.x / columns);
+				vec3 sum(0.f);
+				for (uint32_t y = y0; y < y1; y++)
+				{
+					const float* pTexel = pTexels + (size_t(y) * size.x + x0) * channels;
+					for (uint32_t x = x0; x < x1; x++, pTexel += channels) sum += vec3(pTexel[0], pTexel[1], pTexel[2]);
+				}
+				vec3 radiance = sum / float((x1 - x0) * (y1 - y0));
+				mCells[size_t(row) * columns + column] = vec4(radiance, solidAngle);
+				weights[column] = luminance(radiance) * solidAngle;
+				rowPower += weights[column];
+			}
+
+			LightAliasTable::build(weights, rowTable);
+			std::copy(rowTable.begin(), rowTable.end(), mEntries.begin() + rows + size_t(row) * columns);
+			rowPowers[row] = float(rowPower);
+		}
+	});
+
+	std::vector<LightAliasTable::Entry> marginal;
+	LightAliasTable::build(rowPowers, marginal);
+	std::copy(marginal.begin(), marginal.end(), mEntries.begin());
+	for (float power : rowPowers) mTotalPower += power;
+	mLastBuildMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+}
+
+uint32_t EnvMapSampler::sample(float u0, float u1, float& pdf) const
+{
+	uint32_t columns = mGridSize.x, rows = mGridSize.y;
+	if (mCells.empty()) { pdf = 0.f; return 0; }
+
+	uint32_t row = aliasPick(mEntries.data(), rows, u0);
+	const LightAliasTable::Entry* pRowTable = mEntries.data() + rows + size_t(row) * columns;
+	uint32_t column = aliasPick(pRowTable, columns, u1);
+	pdf = mEntries[row].pdf * pRowTable[column].pdf;
+	return row * columns + column;
+}
+
+float EnvMapSampler::getCellPdf(uint32_t cell) const
+{
+	if (cell >= getCellCount()) return 0.f;
+	uint32_t row = cell / mGridSize.x;
+	return mEntries[row].pdf * mEntries[mGridSize.y + cell].pdf;
+}
+
+vec3 EnvMapSampler::getCellDirection(uint32_t cell) const
+{
+	if (mCells.empty()) return vec3(0.f, 1.f, 0.f);
+	vec2 uv((float(cell % mGridSize.x) + 0.5f) / float(mGridSize.x), (float(cell / mGridSize.x) + 0.5f) / float(mGridSize.y));
+	return latLongToDirection(uv);
+}
+
+void EnvMapSampler::setIntoVars(SimpleVars::SharedPtr& pVars)
+{
+	size_t entryCount = std::max<size_t>(1, mEntries.size());
+	size_t cellCount = std::max<size_t>(1, mCells.size());
+	if (!mpTableBuffer || mpTableBuffer->getElementCount() != entryCount)
+	{
+		mpTableBuffer = pVars->createStructuredBuffer("gEnvAliasTable", entryCount);
+		mBufferDirty = true;
+	}
+	if (!mpCellBuffer || mpCellBuffer->getElementCount() != cellCount)
+	{
+		mpCellBuffer = pVars->createStructuredBuffer("gEnvCells", cellCount);
+		mBufferDirty = true;
+	}
+	if (!mpTableBuffer || !mpCellBuffer) return;
+
+	if (mBufferDirty && !mCells.empty())
+	{
+		mpTableBuffer->setBlob(mEntries.data(), 0, mEntries.size() * sizeof(LightAliasTable::Entry));
+		mpCellBuffer->setBlob(mCells.data(), 0, mCells.size() * sizeof(vec4));
+	}
+	mBufferDirty = false;
+
+	pVars["gEnvAliasTable"] = mpTableBuffer;
+	pVars["gEnvCells"] = mpCellBuffer;
+	pVars["EnvMapSamplingCB"]["gEnvGridSize"] = isActive() ? mGridSize : uvec2(0, 0);
+	pVars["EnvMapSamplingCB"]["gEnvCandidateProb"] = mCandidateFraction;
+}
+
+bool EnvMapSampler::renderGui(Gui* pGui)
+{
+	bool dirty = pGui->addCheckBox("Sample environment map", mEnabled);
+	if (mEnabled)
+	{
+		dirty |= pGui->addFloatVar("Env map candidates", mCandidateFraction, 0.f, 1.f, 0.05f);
+		pGui->addText((std::to_string(mGridSize.x) + "x" + std::to_string(mGridSize.y) + " cells from a " + std::to_string(mMapSize.x) + "x" +
+			std::to_string(mMapSize.y) + " map, built in " + std::to_string(mLastBuildMs) + " ms").c_str());
+	}
+	return dirty;
+}
+
+EnvMapSampler::Benchmark EnvMapSampler::benchmark(const uvec2& mapSize, uint32_t samples, uint32_t trials)
+{
+	Benchmark result;
+	result.mapSize = mapSize;
+	result.samples = samples;
+	if (mapSize.x == 0 || mapSize.y == 0 || samples == 0 || trials < 2) return result;
+
+	// A sky brightening toward the horizon over a dark ground, and a sun of half a degree about 35 degrees up that
+	//     gives most of the light while covering a few hundred texels
+	TiledDispatch::SharedPtr pDispatch = TiledDispatch::create();
+	const vec3 sunDirection = glm::normalize(vec3(0.5f, 0.57f, -0.65f));
+	const float sunCos = std::cos(glm::radians(0.25f));
+	std::vector<float> texels(size_t(mapSize.x) * mapSize.y * 3);
+	pDispatch->execute(uvec2(1, mapSize.y), [&](const uvec2& tileStart, const uvec2& tileEnd)
+	{
+		for (uint32_t y = tileStart.y; y < tileEnd.y; y++)
+		{
+			for (uint32_t x = 0; x < mapSize.x; x++)
+			{
+				vec3 dir = latLongToDirection(vec2((float(x) + 0.5f) / float(mapSize.x), (float(y) + 0.5f) / float(mapSize.y)));
+				vec3 radiance = (dir.y > 0.f) ? glm::mix(vec3(1.2f, 1.4f, 1.6f), vec3(0.3f, 0.5f, 1.f), dir.y) : vec3(0.1f, 0.09f, 0.08f);
+				if (glm::dot(dir, sunDirection) > sunCos) radiance = vec3(60000.f, 55000.f, 50000.f);
+				float* pTexel = &texels[(size_t(y) * mapSize.x + x) * 3];
+				pTexel[0] = radiance.r; pTexel[1] = radiance.g; pTexel[2] = radiance.b;
+			}
+		}
+	});
+
+	SharedPtr pSampler = create(pDispatch);
+	pSampler->build(texels.data(), mapSize, 3);
+	result.buildMs = pSampler->getLastBuildTime();
+	result.threadCount = pDispatch->getThreadCount();
+	result.gridSize = pSampler->getGridSize();
+
+	SharedPtr pSerialSampler = create(TiledDispatch::create(1));
+	pSerialSampler->build(texels.data(), mapSize, 3);
+	result.serialBuildMs = pSerialSampler->getLastBuildTime();
+
+	// Irradiance (of luminance) on a slightly tilted surface, looking up texels as the shaders do
+	const vec3 N = glm::normalize(vec3(0.2f, 1.f, 0.1f));
+	auto lookup = [&](const vec3& dir)
+	{
+		vec2 uv = directionToLatLong(dir);
+		uint32_t x = std::min(uint32_t(uv.x * float(mapSize.x)), mapSize.x - 1);
+		uint32_t y = std::min(uint32_t(uv.y * float(mapSize.y)), mapSize.y - 1);
+		const float* pTexel = &texels[(size_t(y) * mapSize.x + x) * 3];
+		return luminance(vec3(pTexel[0], pTexel[1], pTexel[2]));
+	};
+
+	// Reference:  every texel, weighted by its solid angle
+	std::vector<double> rowIrradiance(mapSize.y, 0.0);
+	pDispatch->execute(uvec2(1, mapSize.y), [&](const uvec2& tileStart, const uvec2& tileEnd)
+	{
+		for (uint32_t y = tileStart.y; y < tileEnd.y; y++)
+		{
+			double solidAngle = 2.0 * M_PI / double(mapSize.x) * (std::cos(M_PI * y / mapSize.y) - std::cos(M_PI * (y + 1) / mapSize.y));
+			for (uint32_t x = 0; x < mapSize.x; x++)
+			{
+				vec3 dir = latLongToDirection(vec2((float(x) + 0.5f) / float(mapSize.x), (float(y) + 0.5f) / float(mapSize.y)));
+				const float* pTexel = &texels[(size_t(y) * mapSize.x + x) * 3];
+				rowIrradiance[y] += luminance(vec3(pTexel[0], pTexel[1], pTexel[2])) * std::max(glm::dot(N, dir), 0.f) * solidAngle;
+			}
+		}
+	});
+	double reference = 0.0;
+	for (double irradiance : rowIrradiance) reference += irradiance;
+	if (reference <= 0.0) return result;
+
+	// What ReSTIR sees:  each cell a light from its center
+	double cellIrradiance = 0.0;
+	for (uint32_t cell = 0; cell < pSampler->getCellCount(); cell++)
+	{
+		const vec4& cellData = pSampler->getCells()[cell];
+		cellIrradiance += luminance(vec3(cellData)) * cellData.a * std::max(glm::dot(N, pSampler->getCellDirection(cell)), 0.f);
+	}
+	result.cellBias = float(std::abs(cellIrradiance / reference - 1.0));
+
+	// Cosine-weighted directions, against directions from the table spread uniformly over their cell's solid angle
+	std::mt19937 rng(0x1456u);
+	std::uniform_real_distribution<float> uniform(0.f, 1.f);
+	vec3 bitangent = glm::normalize(glm::cross(N, std::abs(N.x) < 0.9f ? vec3(1.f, 0.f, 0.f) : vec3(0.f, 1.f, 0.f)));
+	vec3 tangent = glm::cross(bitangent, N);
+	uvec2 grid = result.gridSize;
+	double cosineSq = 0.0, importanceSq = 0.0;
+	for (uint32_t t = 0; t < trials; t++)
+	{
+		double cosineSum = 0.0, importanceSum = 0.0;
+		for (uint32_t s = 0; s < samples; s++)
+		{
+			float r = std::sqrt(uniform(rng));
+			float phi = 2.f * float(M_PI) * uniform(rng);
+			vec3 wi = tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + N * std::sqrt(std::max(0.f, 1.f - r * r));
+			cosineSum += M_PI * lookup(wi);
+
+			float pdf;
+			uint32_t cell = pSampler->sample(uniform(rng), uniform(rng), pdf);
+			uint32_t row = cell / grid.x, column = cell % grid.x;
+			float cosTheta0 = std::cos(float(M_PI) * float(row) / float(grid.y));
+			float cosTheta1 = std::cos(float(M_PI) * float(row + 1) / float(grid.y));
+			float cosTheta = cosTheta0 + uniform(rng) * (cosTheta1 - cosTheta0);
+			vec3 dir = latLongToDirection(vec2((float(column) + uniform(rng)) / float(grid.x), std::acos(glm::clamp(cosTheta, -1.f, 1.f)) * float(1.0 / M_PI)));
+			float solidAnglePdf = pdf / pSampler->getCells()[cell].a;
+			if (solidAnglePdf > 0.f) importanceSum += lookup(dir) * std::max(glm::dot(N, dir), 0.f) / solidAnglePdf;
+		}
+		double cosineError = cosineSum / double(samples) - reference;
+		double importanceError = importanceSum / double(samples) - reference;
+		cosineSq += cosineError * cosineError;
+		importanceSq += importanceError * importanceError;
+	}
+	result.cosineError = float(std::sqrt(cosineSq / double(trials)) / reference);
+	result.importanceError = float(std::sqrt(importanceSq / double(trials)) / reference);
+	result.varianceReduction = (importanceSq > 0.0) ? float(cosineSq / importanceSq) : 0.f;
+	return result;
+}
+
+void EnvMapSampler::logBenchmark(const Benchmark& bench)
+{
+	logInfo("EnvMapSampler: " + std::to_string(bench.mapSize.x) + "x" + std::to_string(bench.mapSize.y) + " map into " + std::to_string(bench.gridSize.x) + "x" +
+		std::to_string(bench.gridSize.y) + " cells:  build " + std::to_string(bench.buildMs) + " ms on " + std::to_string(bench.threadCount) + " threads, " +
+		std::to_string(bench.serialBuildMs) + " ms on one;  irradiance from " + std::to_string(bench.samples) + " directions:  relative RMSE " +
+		std::to_string(bench.cosineError) + " cosine-weighted, " + std::to_string(bench.importanceError) + " from the table (" +
+		std::to_string(bench.varianceReduction) + "x lower variance);  cell-center bias " + std::to_string(bench.cellBias));
+}
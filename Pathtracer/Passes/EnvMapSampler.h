@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Falcor.h"
+#include "../SharedUtils/SimpleVars.h"
+#include "../SharedUtils/TiledDispatch.h"
+#include "LightAliasTable.h"
+
+using namespace Falcor;
+
+// Importance sampling of the lat-long environment map, for drawing env map directions as RIS candidates.  The map is
+//     box-filtered down to a grid of at most getMaxGridSize() cells, and each cell is weighted by its average luminance
+//     times the solid angle it covers (cells near the poles cover less).  A 2D alias table then picks a cell in two
+//     steps, each taking one random number and two table reads (see envMapSampling.hlsli):
+//
+//         row    = alias pick from the marginal table over rows         (entries [0, rows))
+//         column = alias pick from that row's conditional table         (entries rows + row * columns + [0, columns))
+//         pdf    = marginal[row].pdf * conditional[column].pdf
+//
+//     The row tables are independent, so build() filters and builds them in parallel on a TiledDispatch;  only the
+//     marginal table over the rows is built serially.  update() reads the map back and rebuilds whenever
+//     ResourceManager hands out a different environment map texture.
+//
+//     Each cell is its own sample:  a ReSTIR candidate id can't carry a continuous direction, so the grid is capped
+//     at 2^22 cells to keep candidate ids (gLightsCount + cell) below the emissive triangles' (see EmissiveTriangle.h),
+//     and exact in the reservoirs' float y.
+class EnvMapSampler : public std::enable_shared_from_this<EnvMapSampler>
+{
+public:
+	using SharedPtr = std::shared_ptr<EnvMapSampler>;
+	using SharedConstPtr = std::shared_ptr<const EnvMapSampler>;
+	virtual ~EnvMapSampler() = default;
+
+	// Result of benchmark()
+	struct Benchmark
+	{
+		uvec2    mapSize = uvec2(0, 0);
+		uvec2    gridSize = uvec2(0, 0);
+		uint32_t threadCount = 0;
+		float    buildMs = 0.f;              ///< Full build on every thread
+		float    serialBuildMs = 0.f;        ///< Same, on one thread
+		uint32_t samples = 0;                ///< Per irradiance estimate
+		float    cosineError = 0.f;          ///< Relative RMSE of the estimate with cosine-weighted directions
+		float    importanceError = 0.f;      ///< ... with directions drawn from the table
+		float    varianceReduction = 0.f;    ///< Variance of the cosine estimate over the importance-sampled one
+		float    cellBias = 0.f;             ///< Relative error of treating each cell as a light at its center (what ReSTIR sees)
+	};
+
+	// Create a sampler.  If no dispatcher is given, one is created using all cores.
+	static SharedPtr create(const TiledDispatch::SharedPtr& pDispatch = nullptr);
+
+	// Rebuild from <pEnvMap> if it isn't the texture of the last build.  Returns true if the table was rebuilt.
+	bool update(RenderContext* pRenderContext, const Texture::SharedPtr& pEnvMap);
+
+	// Build from size.x * size.y texels of <channels> floats (rgb first), in row-major order
+	void build(const float* pTexels, const uvec2& size, uint32_t channels);
+
+	// Same as sampleEnvCell() in envMapSampling.hlsli.  Returns the cell and its probability in pdf.
+	uint32_t sample(float u0, float u1, float& pdf) const;
+
+	// Probability of sample() returning <cell>, and the direction through its center
+	float getCellPdf(uint32_t cell) const;
+	vec3 getCellDirection(uint32_t cell) const;
+
+	// Bind gEnvAliasTable, gEnvCells and the EnvMapSamplingCB constants, uploading the table first if needed.  Binds an
+	//     empty grid (so no candidate is drawn from the map) unless isActive().
+	void setIntoVars(SimpleVars::SharedPtr& pVars);
+
+	// Sampling and GUI controls.  Returns true if any changed.
+	bool renderGui(Gui* pGui);
+
+	// Time builds from a synthetic <mapSize> sky with a small, bright sun, and compare the variance of irradiance
+	//     estimates with <samples> directions drawn from the table against cosine-weighted ones
+	static Benchmark benchmark(const uvec2& mapSize = uvec2(8192, 4096), uint32_t samples = 16, uint32_t trials = 4096);
+	static void logBenchmark(const Benchmark& bench);
+
+	// Inverse of wsVectorToLatLong() in simpleGIUtils.hlsli
+	static vec3 latLongToDirection(const vec2& uv);
+
+	// Accessors
+	bool isEnabled() const                          { return mEnabled; }
+	void setEnabled(bool enabled)                   { mEnabled = enabled; }
+	bool isActive() const                           { return mEnabled && mTotalPower > 0.0; }   ///< Enabled, with a map that emits
+	float getCandidateFraction() const              { return mCandidateFraction; }              ///< Share of RIS candidates drawn from the map
+	void setCandidateFraction(float fraction)       { mCandidateFraction = glm::clamp(fraction, 0.f, 1.f); }
+	uvec2 getMaxGridSize() const                    { return mMaxGridSize; }
+	void setMaxGridSize(const uvec2& size);
+	uvec2 getGridSize() const                       { return mGridSize; }
+	uvec2 getMapSize() const                        { return mMapSize; }
+	uint32_t getCellCount() const                   { return mGridSize.x * mGridSize.y; }
+	const std::vector<LightAliasTable::Entry>& getEntries() const { return mEntries; }
+	const std::vector<vec4>& getCells() const       { return mCells; }       ///< rgb:  average radiance, a:  solid angle
+	float getLastBuildTime() const                  { return mLastBuildMs; }   ///< In ms (with the readback, after update())
+	uint32_t getBuildCount() const                  { return mBuildCount; }
+
+protected:
+	EnvMapSampler(const TiledDispatch::SharedPtr& pDispatch) : mpDispatch(pDispatch) {}
+
+	TiledDispatch::SharedPtr      mpDispatch;
+	std::weak_ptr<Texture>        mpSourceMap;                    ///< Map of the last build
+	bool                          mEnabled = true;
+	float                         mCandidateFraction = 0.5f;
+	uvec2                         mMaxGridSize = uvec2(1024, 512);
+
+	uvec2                         mMapSize = uvec2(0, 0);
+	uvec2                         mGridSize = uvec2(0, 0);
+	std::vector<LightAliasTable::Entry> mEntries;                 ///< Marginal table over rows, then each row's table
+	std::vector<vec4>             mCells;
+	double                        mTotalPower = 0.0;              ///< Sum of luminance times solid angle over the cells
+	float                         mLastBuildMs = 0.f;
+	uint32_t                      mBuildCount = 0;
+
+	StructuredBuffer::SharedPtr   mpTableBuffer;
+	StructuredBuffer::SharedPtr   mpCellBuffer;
+	bool                          mBufferDirty = true;
+};
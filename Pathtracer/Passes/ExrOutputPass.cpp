@@ -0,0 +1,240 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#include "ExrOutputPass.h"
+
+namespace {
+	// How ExrWriter reads a texture's bytes:  the value type and values per texel.  Returns false for formats it can't read.
+	bool getSourceLayout(ResourceFormat format, ExrWriter::SourceType& source, uint32_t& channels)
+	{
+		switch (format)
+		{
+		case ResourceFormat::RGBA32Float:    source = ExrWriter::SourceType::Float32;    channels = 4; return true;
+		case ResourceFormat::RGB32Float:     source = ExrWriter::SourceType::Float32;    channels = 3; return true;
+		case ResourceFormat::RG32Float:      source = ExrWriter::SourceType::Float32;    channels = 2; return true;
+		case ResourceFormat::R32Float:       source = ExrWriter::SourceType::Float32;    channels = 1; return true;
+		case ResourceFormat::RGBA16Float:    source = ExrWriter::SourceType::Float16;    channels = 4; return true;
+		case ResourceFormat::RG16Float:      source = ExrWriter::SourceType::Float16;    channels = 2; return true;
+		case ResourceFormat::R16Float:       source = ExrWriter::SourceType::Float16;    channels = 1; return true;
+		case ResourceFormat::RGBA32Uint:     source = ExrWriter::SourceType::Uint32;     channels = 4; return true;
+		case ResourceFormat::RGB32Uint:      source = ExrWriter::SourceType::Uint32;     channels = 3; return true;
+		case ResourceFormat::RG32Uint:       source = ExrWriter::SourceType::Uint32;     channels = 2; return true;
+		case ResourceFormat::R32Uint:        source = ExrWriter::SourceType::Uint32;     channels = 1; return true;
+		case ResourceFormat::RGBA8Unorm:     source = ExrWriter::SourceType::Unorm8;     channels = 4; return true;
+		case ResourceFormat::RG8Unorm:       source = ExrWriter::SourceType::Unorm8;     channels = 2; return true;
+		case ResourceFormat::R8Unorm:        source = ExrWriter::SourceType::Unorm8;     channels = 1; return true;
+		case ResourceFormat::RGBA8UnormSrgb: source = ExrWriter::SourceType::UnormSrgb8; channels = 4; return true;
+		default:                             return false;
+		}
+	}
+};
+
+ExrOutputPass::ExrOutputPass(const std::string& directory, const std::vector<ChannelSpec>& channels, ExrWriter::Compression compression, ExrWriter::QueuePolicy policy)
+	: mDirectory(directory), mChannels(channels), mCompression(uint32_t(compression)), ::RenderPass("EXR Output Pass", "EXR Output Options")
+{
+	// Room for what's in flight, plus one
+	mpWriter = ExrWriter::create(compression, kMaxPendingFrames + 1, policy);
+}
+
+std::vector<ExrOutputPass::ChannelSpec> ExrOutputPass::getDefaultChannels()
+{
+	const ExrWriter::PixelType half = ExrWriter::PixelType::Half;
+	return {
+		{ "HDRColorOutput", 3, half },
+		{ "WorldPosition", 3, ExrWriter::PixelType::Float },   // Half would lose too much away from the origin
+		{ "WorldNormal", 3, half },
+		{ "MaterialDiffuse", 3, half },
+		{ "ShadedOutput", 3, half },
+		{ "CurrReservoirs", 3, half },
+		{ "SpatialReservoirs", 3, half },
+		{ "MotionVectors", 2, half },
+	};
+}
+
+bool ExrOutputPass::parseChannels(const std::string& list, std::vector<ChannelSpec>& channels)
+{
+	std::vector<ChannelSpec> parsed;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t end = std::min(list.find(',', start), list.size());
+		std::string entry = list.substr(start, end - start);
+		start = end + 1;
+
+		ChannelSpec spec;
+		size_t colon = entry.find(':');
+		spec.channel = entry.substr(0, colon);
+		if (spec.channel.empty()) return false;
+		if (colon != std::string::npos)
+		{
+			std::string format = entry.substr(colon + 1);
+			size_t digits = format.find_first_of("1234");
+			if (digits == std::string::npos || digits + 1 != format.size()) return false;
+			std::string type = format.substr(0, digits);
+			if (type == "half") spec.type = ExrWriter::PixelType::Half;
+			else if (type == "float") spec.type = ExrWriter::PixelType::Float;
+			else if (type == "uint") spec.type = ExrWriter::PixelType::Uint;
+			else return false;
+			spec.components = uint32_t(format[digits] - '0');
+		}
+		parsed.push_back(spec);
+	}
+	channels = parsed;
+	return true;
+}
+
+bool ExrOutputPass::initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager)
+{
+	// Stash a copy of our resource manager.  We don't request our channels:  those no other pass creates are skipped.
+	if (!pResManager || !mpWriter) return false;
+	mpResManager = pResManager;
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		mCompressionList.push_back({ int32_t(i), ExrWriter::getCompressionName(ExrWriter::Compression(i)) });
+	}
+
+	if (!isDirectoryExists(mDirectory) && !createDirectory(mDirectory))
+	{
+		logWarning("ExrOutputPass: could not create " + mDirectory);
+		return false;
+	}
+	return true;
+}
+
+bool ExrOutputPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	// The readbacks copy the channels as of this pass, so transient channels must live until here
+	for (const ChannelSpec& spec : mChannels) usage.reads.push_back(spec.channel);
+	return true;
+}
+
+void ExrOutputPass::renderGui(Gui* pGui)
+{
+	pGui->addCheckBox("Write EXR frames", mCapturing);
+	if (pGui->addDropdown("Compression", mCompressionList, mCompression)) {
+		mpWriter->setCompression(ExrWriter::Compression(mCompression));
+	}
+
+	ExrWriter::Stats stats = mpWriter->getStats();
+	float ratio = (stats.fileBytes > 0) ? float(double(stats.rawBytes) / double(stats.fileBytes)) : 0.f;
+	pGui->addText((std::to_string(stats.written) + " written to " + mDirectory + ", " + std::to_string(stats.waiting + uint32_t(mPending.size())) + " in flight, " +
+		std::to_string(mSkippedFrames + stats.dropped) + " skipped").c_str());
+	if (stats.written > 0) {
+		pGui->addText(("  ratio " + std::to_string(ratio) + ", encode " + std::to_string(stats.encodeMs / float(stats.written)) + " ms, disk " +
+			std::to_string(stats.diskMs / float(stats.written)) + " ms, readback " + std::to_string(mLastReadbackMs) + " ms per frame").c_str());
+	}
+
+	if (pGui->addButton("Benchmark EXR writer")) {
+		mBenchmark = ExrWriter::benchmark();
+		ExrWriter::logBenchmark(mBenchmark);
+	}
+	for (const ExrWriter::Benchmark::Run& run : mBenchmark.runs) {
+		pGui->addText(("  " + std::string(ExrWriter::getCompressionName(run.compression)) + ": " + std::to_string(run.framesPerSecond) + " frames/s at " +
+			std::to_string(mBenchmark.size.x) + "x" + std::to_string(mBenchmark.size.y) + ", ratio " + std::to_string(run.ratio)).c_str());
+	}
+}
+
+void ExrOutputPass::execute(RenderContext* pRenderContext)
+{
+	mFrameCount++;
+
+	// Hand frames whose readbacks the GPU has had time to finish to the writer
+	while (!mPending.empty() && mPending.front().issued + kReadbackLatency <= mFrameCount)
+	{
+		submit(mPending.front());
+		mPending.pop_front();
+	}
+	if (!mCapturing) return;
+
+	uint32_t fileIndex = mNextFileIndex++;
+	if (mpWriter->getQueuePolicy() == ExrWriter::QueuePolicy::Drop)
+	{
+		// Skip the frame (and its readbacks) if it wouldn't fit in the writer's queue
+		if (mPending.size() >= kMaxPendingFrames || mpWriter->getQueuedCount() + uint32_t(mPending.size()) >= mpWriter->getMaxQueued())
+		{
+			mSkippedFrames++;
+			return;
+		}
+	}
+	else if (mPending.size() >= kMaxPendingFrames)
+	{
+		// Make room, waiting on the GPU (and on the writer) if we must
+		submit(mPending.front());
+		mPending.pop_front();
+	}
+
+	PendingFrame pending;
+	pending.frame = fileIndex;
+	pending.issued = mFrameCount;
+	for (uint32_t i = 0; i < mChannels.size(); i++)
+	{
+		Texture::SharedPtr pTex = mpResManager->getTexture(mChannels[i].channel);
+		if (!pTex) continue;
+
+		// Every layer of a file shares its size, that of the first channel found
+		if (pending.readbacks.empty())
+		{
+			pending.width = pTex->getWidth();
+			pending.height = pTex->getHeight();
+		}
+		ExrWriter::SourceType source;
+		uint32_t sourceChannels;
+		if (pTex->getWidth() != pending.width || pTex->getHeight() != pending.height || !getSourceLayout(pTex->getFormat(), source, sourceChannels)) continue;
+
+		pending.specs.push_back(i);
+		pending.formats.push_back(pTex->getFormat());
+		pending.readbacks.push_back(pRenderContext->asyncReadTextureSubresource(pTex.get(), 0));
+	}
+	if (!pending.readbacks.empty()) mPending.push_back(std::move(pending));
+}
+
+void ExrOutputPass::submit(PendingFrame& pending)
+{
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+	char filename[32];
+	snprintf(filename, sizeof(filename), "/frame_%05u.exr", pending.frame);
+
+	ExrWriter::Frame frame;
+	frame.filename = mDirectory + filename;
+	frame.width = pending.width;
+	frame.height = pending.height;
+	for (size_t i = 0; i < pending.readbacks.size(); i++)
+	{
+		const ChannelSpec& spec = mChannels[pending.specs[i]];
+		ExrWriter::Layer layer;
+		getSourceLayout(pending.formats[i], layer.source, layer.sourceChannels);
+		layer.name = (pending.specs[i] == 0) ? "" : spec.channel;   // The first channel is the beauty image
+		layer.channels = glm::clamp(spec.components, 1u, layer.sourceChannels);
+		layer.type = spec.type;
+		layer.data = pending.readbacks[i]->getData();
+		frame.layers.push_back(std::move(layer));
+	}
+	pending.readbacks.clear();
+	mLastReadbackMs = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+
+	mpWriter->write(std::move(frame));
+}
+
+void ExrOutputPass::shutdown()
+{
+	// Write everything captured so far before the writer goes away
+	for (PendingFrame& pending : mPending) submit(pending);
+	mPending.clear();
+	mpWriter->flush();
+}
@@ -0,0 +1,108 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#pragma once
+
+#include "../SharedUtils/RenderPass.h"
+#include "../SharedUtils/ExrWriter.h"
+
+// Writes ResourceManager channels (the beauty image and AOVs such as the G-buffer, reservoir and denoiser inputs) to one
+//     multi-channel EXR file per frame, <directory>/frame_00000.exr, ...  Each channel becomes a layer:  the first one
+//     the unnamed beauty layer (R, G, B), the others <channel>.R, <channel>.G, ...
+//
+//     The channels are read back asynchronously (ReadTextureTask) and collected kReadbackLatency frames later, once the
+//     GPU is done with them, then converted, compressed and written by an ExrWriter on its own threads.  With
+//     ExrWriter::QueuePolicy::Drop, frames are skipped (before any readback is issued) while the writer is behind, so
+//     rendering never waits on the disk;  Block writes every frame, at whatever rate the writer sustains.  File numbers
+//     count rendered frames, so skipped frames show up as gaps.
+class ExrOutputPass : public ::RenderPass, inherit_shared_from_this<::RenderPass, ExrOutputPass>
+{
+public:
+	using SharedPtr = std::shared_ptr<ExrOutputPass>;
+	using SharedConstPtr = std::shared_ptr<const ExrOutputPass>;
+
+	// A channel to write, its components (1 to 4, clamped to the texture's) and how to store them
+	struct ChannelSpec
+	{
+		std::string          channel;
+		uint32_t             components = 3;
+		ExrWriter::PixelType type = ExrWriter::PixelType::Half;
+	};
+
+	static SharedPtr create(const std::string& directory, const std::vector<ChannelSpec>& channels = getDefaultChannels(),
+		ExrWriter::Compression compression = ExrWriter::Compression::ZIP, ExrWriter::QueuePolicy policy = ExrWriter::QueuePolicy::Drop)
+	{
+		return SharedPtr(new ExrOutputPass(directory, channels, compression, policy));
+	}
+	virtual ~ExrOutputPass() = default;
+
+	// HDRColorOutput, then the G-buffer, the shading without ReSTIR and the denoiser's inputs
+	static std::vector<ChannelSpec> getDefaultChannels();
+
+	// Parse a comma-separated list of <channel>[:<type><components>], e.g. "HDRColorOutput,WorldPosition:float3,MotionVectors:half2",
+	//     where type is half, float or uint (half3 if omitted).  Returns false, leaving channels as is, if any entry is malformed.
+	static bool parseChannels(const std::string& list, std::vector<ChannelSpec>& channels);
+
+	// Start or stop writing frames
+	void setCapturing(bool capture) { mCapturing = capture; }
+
+protected:
+	ExrOutputPass(const std::string& directory, const std::vector<ChannelSpec>& channels, ExrWriter::Compression compression, ExrWriter::QueuePolicy policy);
+
+	// Readbacks of one frame's channels, in flight
+	struct PendingFrame
+	{
+		uint32_t                                         frame = 0;       ///< Number in the file name
+		uint64_t                                         issued = 0;      ///< mFrameCount when the readbacks were issued
+		uint32_t                                         width = 0;
+		uint32_t                                         height = 0;
+		std::vector<uint32_t>                            specs;           ///< Index into mChannels of each readback
+		std::vector<ResourceFormat>                      formats;
+		std::vector<CopyContext::ReadTextureTask::SharedPtr> readbacks;
+	};
+
+	static const uint32_t kReadbackLatency = 2;     ///< Frames between issuing a readback and mapping it
+	static const uint32_t kMaxPendingFrames = 2;    ///< Frames of readbacks in flight (each a full copy of every channel)
+
+	// RenderPass functionality
+	bool initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager) override;
+	void renderGui(Gui* pGui) override;
+	void execute(RenderContext* pRenderContext) override;
+	void shutdown() override;
+
+	// Map <pending>'s readbacks (waiting for the GPU if needed) and queue them with the writer
+	void submit(PendingFrame& pending);
+
+	// Override default RenderPass functionality (that control the rendering pipeline and its GUI)
+	bool appliesPostprocess() override { return true; }
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
+
+	// Internal state variables for this pass
+	ExrWriter::SharedPtr          mpWriter;
+	std::string                   mDirectory;
+	std::vector<ChannelSpec>      mChannels;
+	std::deque<PendingFrame>      mPending;
+	bool                          mCapturing = false;
+	uint32_t                      mCompression = uint32_t(ExrWriter::Compression::ZIP);   ///< For the GUI dropdown
+	Gui::DropdownList             mCompressionList;
+	uint64_t                      mFrameCount = 0;
+	uint32_t                      mNextFileIndex = 0;
+	uint32_t                      mSkippedFrames = 0;   ///< Not read back, as the writer was behind (QueuePolicy::Drop)
+	float                         mLastReadbackMs = 0.f;  ///< Mapping and copying the last frame's readbacks
+	ExrWriter::Benchmark          mBenchmark;
+};
@@ -17,6 +17,7 @@
 **********************************************************************************************************************/
 
 #include "FullGlobalIlluminationPass.h"
+#include "../Shaders/AdaptiveSampling.h"
 
 namespace {
 	const char* kFileRayTrace = "Shaders\\fullGI.hlsl";
@@ -47,6 +48,7 @@ bool FullGlobalIlluminationPass::initialize(RenderContext* pRenderContext, Resou
 	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse" });
 	mpResManager->requestTextureResource(mOutChannel);
 	mpResManager->requestTextureResource(ResourceManager::kEnvironmentMap);
+	mpResManager->requestTextureResource(ADAPTIVE_SAMPLE_COUNT_CHANNEL);
 
 	// Set the default scene
 	mpResManager->setDefaultSceneName("Scenes/pink_room/pink_room.fscene");
@@ -67,6 +69,15 @@ bool FullGlobalIlluminationPass::initialize(RenderContext* pRenderContext, Resou
 	mpRays->setMaxRecursionDepth(uint32_t(mMaxRayDepth));
 	if (mpScene) mpRays->setScene(mpScene);
 
+	mpSampleGenerator = SampleGenerator::create();
+
+	return true;
+}
+
+bool FullGlobalIlluminationPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	usage.reads = { "WorldPosition", "WorldNormal", "MaterialDiffuse", "Emissive", ADAPTIVE_SAMPLE_COUNT_CHANNEL };
+	usage.writes = { mOutChannel };
 	return true;
 }
 
@@ -90,6 +101,7 @@ void FullGlobalIlluminationPass::renderGui(Gui* pGui)
 	dirty |= (int)pGui->addIntVar("Max Ray Depth", mRayDepth, 0, mMaxRayDepth);
 	// Checkbox to determine if we are shooting indirect rays or not
 	dirty |= (int)pGui->addCheckBox(mDoIndirectLighting ? "Enable Direct Illumination" : "Enable Indirect Illumination", mDoIndirectLighting);
+	dirty |= (int)mpSampleGenerator->renderGui(pGui);
 	if (dirty) setRefreshFlag();
 }
 
@@ -101,6 +113,16 @@ void FullGlobalIlluminationPass::execute(RenderContext* pRenderContext)
 	// Check that pass is ready to render
 	if (!outTex || !mpRays || !mpRays->readyToRender()) return;
 
+	// Follow the accumulation pass' per-pixel sample budget only while the camera stands still, as it does
+	bool cameraMoved = false;
+	if (mpScene && mpScene->getActiveCamera())
+	{
+		const mat4& viewMatrix = mpScene->getActiveCamera()->getViewMatrix();
+		cameraMoved = (viewMatrix != mLastCameraMatrix);
+		mLastCameraMatrix = viewMatrix;
+	}
+	Texture::SharedPtr sampleCountTex = mpResManager->getTexture(ADAPTIVE_SAMPLE_COUNT_CHANNEL);
+
 	// Pass background color to miss shader #0
 	auto globalVars = mpRays->getGlobalVars();
 	globalVars["GlobalCB"]["gMinT"] = mpResManager->getMinTDist();
@@ -109,6 +131,8 @@ void FullGlobalIlluminationPass::execute(RenderContext* pRenderContext)
 	globalVars["GlobalCB"]["gDoDirectLighting"] = mDoDirectLighting;
 	globalVars["GlobalCB"]["gMaxDepth"] = mRayDepth;
 	globalVars["GlobalCB"]["gEmitMult"] = 1.0f;
+	globalVars["GlobalCB"]["gAdaptive"] = sampleCountTex && !cameraMoved;
+	mpSampleGenerator->setIntoVars(globalVars);
 	
 	// Pass G-Buffer textures to shader
 	globalVars["gPos"]        = mpResManager->getTexture("WorldPosition");
@@ -120,6 +144,7 @@ void FullGlobalIlluminationPass::execute(RenderContext* pRenderContext)
 
 	// Set environment map texture for indirect illumination
 	globalVars["gEnvMap"] = mpResManager->getTexture(ResourceManager::kEnvironmentMap);
+	globalVars["gSampleCount"] = sampleCountTex;
 
 	// Launch ray tracing
 	mpRays->execute(pRenderContext, mpResManager->getScreenSize());
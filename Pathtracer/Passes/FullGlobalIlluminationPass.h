@@ -20,6 +20,7 @@
 
 #include "../SharedUtils/RenderPass.h"
 #include "../SharedUtils/RayLaunch.h"
+#include "SampleGenerator.h"
 
 class FullGlobalIlluminationPass : public ::RenderPass, inherit_shared_from_this<::RenderPass, FullGlobalIlluminationPass>
 {
@@ -43,10 +44,12 @@ protected:
 	bool requiresScene() override { return true; }       // Adds 'load scene' option to GUI.
 	bool usesRayTracing() override { return true; }      // Removes a GUI control that is confusing for this simple demo
 	bool usesEnvironmentMap() override { return true; }  // Use environment map to illuminate the scene
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
 
 	// Internal state variables for this pass
 	RayLaunch::SharedPtr          mpRays;              ///< Wrapper around DXR pass
 	RtScene::SharedPtr            mpScene;             ///< Falcor scene representation, with additions for ray tracing
+	SampleGenerator::SharedPtr    mpSampleGenerator;   ///< Sequence behind the light picks and bounce directions
 
 	// Output buffer
 	std::string                   mOutChannel;
@@ -58,6 +61,9 @@ protected:
 	int32_t                       mRayDepth = 1;       ///< Current max. ray depth
 	const int32_t                 mMaxRayDepth = 8;    ///< Max supported ray depth
 	
+	// The camera of the last frame, so the accumulation pass' sample budget is only followed while it stands still
+	mat4                          mLastCameraMatrix;
+
 	// Counter to initialize thin lens random numbers each frame
 	uint32_t                      mFrameCount = 0x1456u;                        ///< A frame counter to act as seed for random number generator 
 };
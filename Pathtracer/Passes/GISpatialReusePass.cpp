@@ -0,0 +1,96 @@
+#include "GISpatialReusePass.h"
+
+namespace {
+	const char* kFileRayTrace = "Shaders\\giSpatialReuse.hlsl";
+
+	// Function names for shader entry points
+	const char* kEntryPointRayGen = "GISpatialReuseRayGen";
+
+	const char* kEntryPointMiss0 = "ShadowMiss";
+	const char* kEntryShadowAnyHit = "ShadowAnyHit";
+	const char* kEntryShadowClosestHit = "ShadowClosestHit";
+};
+
+GISpatialReusePass::GISpatialReusePass(const ReservoirStore::SharedPtr& pReservoirs) :
+	mpReservoirs(pReservoirs),
+	::RenderPass("GI Spatial Reuse Pass", "GI Spatial Reuse Options")
+{
+}
+
+bool GISpatialReusePass::initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager)
+{
+	// Stash a copy of our resource manager, allowing us to access shared rendering resources
+	mpResManager = pResManager;
+
+	// Request texture resources for this pass
+	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal" });
+
+	// Set the default scene
+	mpResManager->setDefaultSceneName("Scenes/pink_room/pink_room.fscene");
+
+	// Create wrapper around ray tracing pass
+	mpRays = RayLaunch::create(kFileRayTrace, kEntryPointRayGen);
+
+	// Ray type 0 (visibility of neighbors' sample points)
+	mpRays->addMissShader(kFileRayTrace, kEntryPointMiss0);
+	mpRays->addHitShader(kFileRayTrace, kEntryShadowClosestHit, kEntryShadowAnyHit);
+
+	// Compile
+	mpRays->compileRayProgram();
+	mpRays->setMaxRecursionDepth(1u);
+	if (mpScene) mpRays->setScene(mpScene);
+
+	return true;
+}
+
+bool GISpatialReusePass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	usage.reads = { "WorldPosition", "WorldNormal" };
+	return true;
+}
+
+void GISpatialReusePass::initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene)
+{
+	// Save copy of scene
+	if (pScene) {
+		mpScene = std::dynamic_pointer_cast<RtScene>(pScene);
+	}
+
+	// Pass scene to ray tracer
+	if (mpRays) {
+		mpRays->setScene(mpScene);
+	}
+}
+
+void GISpatialReusePass::renderGui(Gui* pGui)
+{
+	int dirty = 0;
+	dirty |= (int)pGui->addIntVar("GI Spatial Neighbors", mSpatialNeighbors, 0, 32);
+	dirty |= (int)pGui->addIntVar("GI Spatial Radius", mSpatialRadius, 0, 100);
+	dirty |= (int)pGui->addCheckBox("GI Visibility Reuse", mDoVisibilityReuse);
+	if (dirty) setRefreshFlag();
+}
+
+void GISpatialReusePass::execute(RenderContext* pRenderContext)
+{
+	// Check that pass is ready to render
+	if (!mpRays || !mpRays->readyToRender()) return;
+
+	auto globalVars = mpRays->getGlobalVars();
+	globalVars["GlobalCB"]["gMinT"] = mpResManager->getMinTDist();
+	globalVars["GlobalCB"]["gFrameCount"] = mFrameCount++;
+	globalVars["GlobalCB"]["gSpatialNeighbors"] = uint32_t(mSpatialNeighbors);
+	globalVars["GlobalCB"]["gSpatialRadius"] = uint32_t(mSpatialRadius);
+	globalVars["GlobalCB"]["gEnableReSTIRGI"] = mpResManager->getReSTIRGI();
+	globalVars["GlobalCB"]["gDoSpatialReuse"] = mpResManager->getSpatial();
+	globalVars["GlobalCB"]["gDoVisibilityReuse"] = mDoVisibilityReuse;
+
+	// Pass G-Buffer textures to shader
+	globalVars["gPos"]  = mpResManager->getTexture("WorldPosition");
+	globalVars["gNorm"] = mpResManager->getTexture("WorldNormal");
+
+	mpReservoirs->setIntoVars(globalVars, { ReservoirStore::GIBufferId::CurrGIReservoirs, ReservoirStore::GIBufferId::SpatialGIReservoirs }, mpResManager->getScreenSize());
+
+	// Launch ray tracing
+	mpRays->execute(pRenderContext, mpResManager->getScreenSize());
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../SharedUtils/RenderPass.h"
+#include "../SharedUtils/RayLaunch.h"
+#include "ReservoirStore.h"
+
+// ReSTIR GI, stage 2 (giSpatialReuse.hlsl):  merges each pixel's GI reservoir with those of random neighbors on a similar
+//     surface, correcting their weights by the reconnection Jacobian and optionally checking visibility to their samples.
+class GISpatialReusePass : public ::RenderPass, inherit_shared_from_this<::RenderPass, GISpatialReusePass>
+{
+public:
+	using SharedPtr = std::shared_ptr<GISpatialReusePass>;
+	using SharedConstPtr = std::shared_ptr<const GISpatialReusePass>;
+
+	static SharedPtr create(const ReservoirStore::SharedPtr& pReservoirs) { return SharedPtr(new GISpatialReusePass(pReservoirs)); }
+	virtual ~GISpatialReusePass() = default;
+
+protected:
+	GISpatialReusePass(const ReservoirStore::SharedPtr& pReservoirs);
+
+	// RenderPass functionality
+	bool initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager) override;
+	void initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene) override;
+	void renderGui(Gui* pGui) override;
+	void execute(RenderContext* pRenderContext) override;
+
+	// Override default RenderPass functionality (that control the rendering pipeline and its GUI)
+	bool requiresScene() override { return true; }       // Adds 'load scene' option to GUI.
+	bool usesRayTracing() override { return true; }      // Removes a GUI control that is confusing for this simple demo
+	bool usesReSTIRGI() override { return true; }        // Adds the 'ReSTIR GI' toggle
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
+
+	// Internal state variables for this pass
+	RayLaunch::SharedPtr          mpRays;              ///< Wrapper around DXR pass
+	RtScene::SharedPtr            mpScene;             ///< Falcor scene representation, with additions for ray tracing
+	ReservoirStore::SharedPtr     mpReservoirs;        ///< GI reservoirs, shared with the GI sampling and shading passes
+
+	// User controls
+	int32_t                       mSpatialNeighbors = 5;
+	int32_t                       mSpatialRadius = 30;
+	bool                          mDoVisibilityReuse = true;   ///< Trace a ray to each neighbor's sample point
+
+	// Counter to initialize random numbers each frame
+	uint32_t                      mFrameCount = 0x3187u;                        ///< A frame counter to act as seed for random number generator
+};
@@ -0,0 +1,149 @@
+#include "LightAliasTable.h"
+#include <random>
+
+bool LightAliasTable::update(const Scene::SharedPtr& pScene)
+{
+	std::vector<float> lightPowers;
+	if (pScene)
+	{
+		for (const auto& pLight : pScene->getLights())
+		{
+			lightPowers.push_back(pLight->getPower());
+		}
+	}
+	return update(lightPowers);
+}
+
+bool LightAliasTable::update(const std::vector<float>& lightPowers)
+{
+	// Any change moves probability mass between buckets all over the table, so there's no cheaper partial update
+	if (mBuildCount > 0 && lightPowers == mPowers) return false;
+
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+	mPowers = lightPowers;
+	build(mPowers, mEntries);
+	mLastBuildMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+
+	mBuildCount++;
+	mBufferDirty = true;
+	return true;
+}
+
+uint32_t LightAliasTable::sample(float u0, float u1, float& pdf) const
+{
+	uint32_t lightsCount = getLightCount();
+	if (lightsCount == 0) { pdf = 0.f; return 0; }
+
+	uint32_t bucket = std::min(uint32_t(u0 * lightsCount), lightsCount - 1);
+	uint32_t light = (u1 < mEntries[bucket].prob) ? bucket : mEntries[bucket].alias;
+	pdf = mEntries[light].pdf;
+	return light;
+}
+
+void LightAliasTable::setIntoVars(SimpleVars::SharedPtr& pVars, const std::string& name)
+{
+	size_t elementCount = std::max<size_t>(1, mEntries.size());
+	if (!mpBuffer || mpBuffer->getElementCount() != elementCount)
+	{
+		mpBuffer = pVars->createStructuredBuffer(name, elementCount);
+		if (!mpBuffer) return;
+		mBufferDirty = true;
+	}
+
+	if (mBufferDirty && !mEntries.empty())
+	{
+		mpBuffer->setBlob(mEntries.data(), 0, mEntries.size() * sizeof(Entry));
+	}
+	mBufferDirty = false;
+
+	pVars[name] = mpBuffer;
+}
+
+void LightAliasTable::build(const std::vector<float>& weights, std::vector<Entry>& table)
+{
+	uint32_t count = uint32_t(weights.size());
+	table.resize(count);
+	if (count == 0) return;
+
+	double total = 0.0;
+	for (float w : weights) total += std::max(w, 0.f);
+
+	// Nothing emits?  Fall back to uniform selection.
+	if (total <= 0.0)
+	{
+		for (uint32_t i = 0; i < count; i++) table[i] = { 1.f, i, 1.f / float(count), 0 };
+		return;
+	}
+
+	// Vose's method:  scale the weights so they average 1, then repeatedly fill an under-full bucket from an over-full one
+	std::vector<double> scaled(count);
+	std::vector<uint32_t> small, large;
+	uint32_t heaviest = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		double w = std::max(weights[i], 0.f);
+		scaled[i] = w * double(count) / total;
+		table[i] = { 1.f, i, float(w / total), 0 };
+		(scaled[i] < 1.0 ? small : large).push_back(i);
+		if (weights[i] > weights[heaviest]) heaviest = i;
+	}
+
+	while (!small.empty() && !large.empty())
+	{
+		uint32_t s = small.back();
+		uint32_t l = large.back();
+		small.pop_back();
+
+		table[s].prob = float(scaled[s]);
+		table[s].alias = l;
+
+		scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+		if (scaled[l] < 1.0)
+		{
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+
+	// Whatever is left is (up to round-off) exactly full.  Never let round-off make a zero-power light selectable, though.
+	for (uint32_t l : large) table[l].prob = 1.f;
+	for (uint32_t s : small)
+	{
+		bool emits = weights[s] > 0.f;
+		table[s].prob = emits ? 1.f : 0.f;
+		table[s].alias = emits ? s : heaviest;
+	}
+}
+
+LightAliasTable::BuildBenchmark LightAliasTable::benchmarkBuild(uint32_t lightCount)
+{
+	BuildBenchmark result;
+	result.lightCount = lightCount;
+
+	// Log-normal powers:  a few very bright lights among many dim ones, like our scenes
+	std::mt19937 rng(0x1456u);
+	std::lognormal_distribution<float> powerDist(0.f, 2.f);
+	std::vector<float> powers(lightCount);
+	for (float& power : powers) power = powerDist(rng);
+
+	std::vector<Entry> table;
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+	build(powers, table);
+	result.buildMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+
+	// The probability of ending up at each light:  its own bucket's kept share, plus what other buckets alias to it
+	std::vector<double> implied(lightCount, 0.0);
+	for (uint32_t i = 0; i < lightCount; i++)
+	{
+		implied[i] += table[i].prob;
+		implied[table[i].alias] += 1.0 - table[i].prob;
+	}
+	for (uint32_t i = 0; i < lightCount; i++)
+	{
+		if (table[i].pdf <= 0.f) continue;
+		double error = std::abs(implied[i] / double(lightCount) - double(table[i].pdf)) / double(table[i].pdf);
+		result.maxPdfError = std::max(result.maxPdfError, float(error));
+	}
+
+	return result;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Falcor.h"
+#include "../SharedUtils/SimpleVars.h"
+
+using namespace Falcor;
+
+// A Walker / Vose alias table over the scene's lights, weighted by emitted power (Light::getPower()).  Used as the
+//     source distribution for the initial RIS candidates instead of picking lights uniformly.  Sampling takes two
+//     random numbers and two table reads, regardless of the number of lights:
+//
+//         bucket = min(int(u0 * N), N - 1);
+//         light  = (u1 < table[bucket].prob) ? bucket : table[bucket].alias;
+//         pdf    = table[light].pdf;
+//
+//     update() re-reads the light powers every frame, but only rebuilds (and re-uploads) the table when one changed.
+class LightAliasTable : public std::enable_shared_from_this<LightAliasTable>
+{
+public:
+	using SharedPtr = std::shared_ptr<LightAliasTable>;
+	using SharedConstPtr = std::shared_ptr<const LightAliasTable>;
+	virtual ~LightAliasTable() = default;
+
+	// One table entry.  Must match LightAliasEntry in restirUtils.hlsli.
+	struct Entry
+	{
+		float    prob;    ///< Probability of keeping this bucket's own light
+		uint32_t alias;   ///< Light picked otherwise
+		float    pdf;     ///< Probability of picking this bucket's light overall (power / total power)
+		uint32_t pad;
+	};
+
+	// Result of benchmarkBuild()
+	struct BuildBenchmark
+	{
+		uint32_t lightCount = 0;
+		float    buildMs = 0.f;       ///< Time for a full build
+		float    maxPdfError = 0.f;   ///< Max relative error between the table's implied pdf and power / total power
+	};
+
+	static SharedPtr create() { return SharedPtr(new LightAliasTable()); }
+
+	// Read the scene's light powers and rebuild if any changed.  Returns true if the table was rebuilt.
+	bool update(const Scene::SharedPtr& pScene);
+	bool update(const std::vector<float>& lightPowers);
+
+	// Same as sampleSourceLight() in createLightSamples.hlsl, given the two random numbers it draws
+	uint32_t sample(float u0, float u1, float& pdf) const;
+
+	// Bind the table to the StructuredBuffer<LightAliasEntry> <name> of a program, uploading it first if needed
+	void setIntoVars(SimpleVars::SharedPtr& pVars, const std::string& name);
+
+	// Fill <table> for the given (non-negative) weights.  All zero weights give a uniform table.
+	static void build(const std::vector<float>& weights, std::vector<Entry>& table);
+
+	// Time a build over <lightCount> lights with powers spanning several orders of magnitude
+	static BuildBenchmark benchmarkBuild(uint32_t lightCount = 1u << 20);
+
+	// Accessors
+	const std::vector<Entry>& getEntries() const  { return mEntries; }
+	uint32_t getLightCount() const                { return uint32_t(mEntries.size()); }
+	float    getLastBuildTime() const             { return mLastBuildMs; }    ///< In ms
+	uint32_t getBuildCount() const                { return mBuildCount; }
+
+protected:
+	LightAliasTable() = default;
+
+	std::vector<float>            mPowers;             ///< Light powers of the last build
+	std::vector<Entry>            mEntries;
+	float                         mLastBuildMs = 0.f;
+	uint32_t                      mBuildCount = 0;
+
+	StructuredBuffer::SharedPtr   mpBuffer;
+	bool                          mBufferDirty = true;
+};
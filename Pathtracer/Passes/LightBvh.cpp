@@ -0,0 +1,423 @@
+#include "LightBvh.h"
+#include <random>
+
+namespace {
+	const float kPi = 3.14159265f;
+
+	// Split candidates per axis during the build
+	const uint32_t kBinCount = 12;
+
+	// Past this depth, split at the median so pathological light layouts cannot blow up the recursion
+	const uint32_t kMaxSahDepth = 48;
+
+	float surfaceArea(const vec3& boundsMin, const vec3& boundsMax)
+	{
+		vec3 e = glm::max(boundsMax - boundsMin, vec3(0.f));
+		return 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	// Solid angle our lights below a node can emit into.  Conty Estevez and Kulla weigh this by the emitter cosine,
+	//     but getLightData() has none:  lights emit evenly inside their cone.
+	float orientationMeasure(float thetaO, float thetaE)
+	{
+		float thetaW = std::min(thetaO + thetaE, kPi);
+		return 2.f * kPi * (1.f - std::cos(thetaW));
+	}
+
+	// Surface area orientation heuristic
+	float nodeCost(const LightBvh::Node& node, float regularization)
+	{
+		return node.power * surfaceArea(node.boundsMin, node.boundsMax) * orientationMeasure(node.thetaO, node.thetaE) * regularization;
+	}
+};
+
+LightBvh::UpdateType LightBvh::update(const Scene::SharedPtr& pScene)
+{
+	std::vector<LightData> lights;
+	std::vector<float> lightPowers;
+	if (pScene)
+	{
+		for (const auto& pLight : pScene->getLights())
+		{
+			lights.push_back(pLight->getData());
+			lightPowers.push_back(pLight->getPower());
+		}
+	}
+	return update(lights, lightPowers);
+}
+
+LightBvh::UpdateType LightBvh::update(const std::vector<LightData>& lights, const std::vector<float>& lightPowers)
+{
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+
+	// Without a power (e.g., a CPU scene that never read them), weigh every light the same
+	uint32_t count = uint32_t(lights.size());
+	std::vector<Node> leaves(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		leaves[i] = createLeaf(lights[i], (i < lightPowers.size()) ? lightPowers[i] : 1.f, i);
+	}
+
+	if (mRebuildRequested || count != getLightCount())
+	{
+		mRebuildRequested = false;
+		build(leaves);
+		mLastBuildMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+		mBufferDirty = true;
+		return UpdateType::Rebuild;
+	}
+
+	bool changed = false;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Node& leaf = mNodes[mLightToLeaf[i]];
+		if (std::memcmp(&leaf, &leaves[i], sizeof(Node)) != 0)
+		{
+			leaf = leaves[i];
+			changed = true;
+		}
+	}
+	if (!changed) return UpdateType::None;
+
+	refit();
+	mLastRefitMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+	mBufferDirty = true;
+	return UpdateType::Refit;
+}
+
+float LightBvh::evalPdf(const vec3& posW, const vec3& normal, uint32_t light) const
+{
+	if (light >= getLightCount()) return 0.f;
+
+	float pdf = 1.f;
+	uint32_t nodeIndex = mLightToLeaf[light];
+	while (nodeIndex != 0)
+	{
+		uint32_t parent = mParents[nodeIndex];
+		float leftImportance = importance(mNodes[parent + 1], posW, normal);
+		float rightImportance = importance(mNodes[mNodes[parent].data], posW, normal);
+		float total = leftImportance + rightImportance;
+		if (total <= 0.f) return 0.f;
+
+		pdf *= ((nodeIndex == parent + 1) ? leftImportance : rightImportance) / total;
+		nodeIndex = parent;
+	}
+	return pdf;
+}
+
+float LightBvh::importance(const Node& node, const vec3& posW, const vec3& normal)
+{
+	if (node.power <= 0.f) return 0.f;
+
+	// Bounding sphere of the node, and the angle it subtends from the shading point
+	vec3 center = 0.5f * (node.boundsMin + node.boundsMax);
+	float radius = 0.5f * glm::length(node.boundsMax - node.boundsMin);
+	vec3 toPoint = posW - center;
+	float dist2 = glm::dot(toPoint, toPoint);
+	vec3 wi = (dist2 > 0.f) ? toPoint / std::sqrt(dist2) : node.axis;
+	float thetaU = (dist2 <= radius * radius) ? kPi : std::asin(std::min(1.f, radius / std::sqrt(dist2)));
+
+	// Can any emission cone below the node reach the point?
+	float theta = std::acos(glm::clamp(glm::dot(node.axis, wi), -1.f, 1.f));
+	float thetaP = std::max(0.f, theta - node.thetaO - thetaU);
+	if (node.thetaE < kPi && thetaP >= node.thetaE) return 0.f;
+
+	// Is any of the node above the point's horizon?  (p_hat uses saturate(dot(N, L)))
+	float receiver = 1.f;
+	if (!(node.flags & kInfiniteFlag))
+	{
+		float thetaI = std::acos(glm::clamp(-glm::dot(normal, wi), -1.f, 1.f));
+		float thetaIP = std::max(0.f, thetaI - thetaU);
+		if (thetaIP >= 0.5f * kPi) return 0.f;
+		receiver = std::cos(thetaIP);
+	}
+
+	// Our lights emit evenly inside their cone, so there is no emitter cosine.  Clamp like getLightData()'s falloff.
+	dist2 = std::max(dist2, std::max(0.25f * radius * radius, 1e-4f));
+	return node.power * receiver / dist2;
+}
+
+void LightBvh::setIntoVars(SimpleVars::SharedPtr& pVars, const std::string& name)
+{
+	size_t elementCount = std::max<size_t>(1, mNodes.size());
+	if (!mpBuffer || mpBuffer->getElementCount() != elementCount)
+	{
+		mpBuffer = pVars->createStructuredBuffer(name, elementCount);
+		if (!mpBuffer) return;
+		mBufferDirty = true;
+	}
+
+	if (mBufferDirty && !mNodes.empty())
+	{
+		mpBuffer->setBlob(mNodes.data(), 0, mNodes.size() * sizeof(Node));
+	}
+	mBufferDirty = false;
+
+	pVars[name] = mpBuffer;
+}
+
+LightBvh::Node LightBvh::createLeaf(const LightData& light, float power, uint32_t lightIndex)
+{
+	Node leaf = {};
+	leaf.power = std::max(power, 0.f);
+	leaf.data = lightIndex | kLeafFlag;
+	leaf.boundsMin = light.posW;
+	leaf.boundsMax = light.posW;
+
+	// Analytic area lights:  their unit square / disc / sphere, transformed to world space
+	if (light.type == LightAreaRect || light.type == LightAreaDisc || light.type == LightAreaSphere)
+	{
+		float zExtent = (light.type == LightAreaSphere) ? 1.f : 0.f;
+		for (uint32_t corner = 0; corner < 8; corner++)
+		{
+			vec4 local = vec4((corner & 1) ? 1.f : -1.f, (corner & 2) ? 1.f : -1.f, (corner & 4) ? zExtent : -zExtent, 1.f);
+			vec3 world = vec3(light.transMat * local);
+			leaf.boundsMin = glm::min(leaf.boundsMin, world);
+			leaf.boundsMax = glm::max(leaf.boundsMax, world);
+		}
+	}
+
+	// Point and directional lights emit in every direction, which makes their axis meaningless.  Say so with
+	//     thetaO = pi, so merging them never spends any time on cone unions.
+	float axisLength = glm::length(light.dirW);
+	leaf.axis = (axisLength > 0.f) ? light.dirW / axisLength : vec3(0.f, 0.f, 1.f);
+	leaf.thetaE = (light.type != LightDirectional && axisLength > 0.f && light.cosOpeningAngle > -1.f) ? std::acos(std::min(light.cosOpeningAngle, 1.f)) : kPi;
+	leaf.thetaO = (leaf.thetaE < kPi) ? 0.f : kPi;
+	leaf.flags = (light.type == LightDirectional) ? kInfiniteFlag : 0;
+	return leaf;
+}
+
+LightBvh::Node LightBvh::merge(const Node& a, const Node& b)
+{
+	Node node = {};
+	node.boundsMin = glm::min(a.boundsMin, b.boundsMin);
+	node.boundsMax = glm::max(a.boundsMax, b.boundsMax);
+	node.power = a.power + b.power;
+	node.thetaE = std::max(a.thetaE, b.thetaE);
+	node.flags = a.flags | b.flags;
+
+	// Smallest cone around both cones of axes.  Call the wider one w0.
+	const Node& w0 = (a.thetaO >= b.thetaO) ? a : b;
+	const Node& w1 = (a.thetaO >= b.thetaO) ? b : a;
+	node.axis = w0.axis;
+	node.thetaO = w0.thetaO;
+	if (w0.thetaO >= kPi) return node;
+
+	float thetaD = std::acos(glm::clamp(glm::dot(w0.axis, w1.axis), -1.f, 1.f));
+	if (std::min(thetaD + w1.thetaO, kPi) <= w0.thetaO) return node;
+
+	float thetaO = 0.5f * (w0.thetaO + thetaD + w1.thetaO);
+	vec3 rotationAxis = glm::cross(w0.axis, w1.axis);
+	float rotationLength = glm::length(rotationAxis);
+	if (thetaO >= kPi || rotationLength < 1e-6f)
+	{
+		node.thetaO = kPi;
+		return node;
+	}
+
+	// Rotate w0's axis toward w1's until the cone just covers both (plus a little slack for round-off)
+	float thetaR = thetaO - w0.thetaO;
+	vec3 k = rotationAxis / rotationLength;
+	node.axis = glm::normalize(w0.axis * std::cos(thetaR) + glm::cross(k, w0.axis) * std::sin(thetaR));
+	node.thetaO = std::min(thetaO + 1e-5f, kPi);
+	return node;
+}
+
+void LightBvh::build(std::vector<Node>& leaves)
+{
+	uint32_t count = uint32_t(leaves.size());
+	mNodes.clear();
+	mParents.clear();
+	mLightToLeaf.assign(count, 0);
+	if (count == 0) return;
+
+	mNodes.reserve(2 * count - 1);
+	mParents.reserve(2 * count - 1);
+	buildRecursive(leaves, 0, count, 0);
+}
+
+uint32_t LightBvh::buildRecursive(std::vector<Node>& leaves, uint32_t begin, uint32_t end, uint32_t depth)
+{
+	uint32_t nodeIndex = uint32_t(mNodes.size());
+	mNodes.push_back(leaves[begin]);
+	mParents.push_back(nodeIndex);
+
+	if (end - begin == 1)
+	{
+		mLightToLeaf[leaves[begin].data & ~kLeafFlag] = nodeIndex;
+		return nodeIndex;
+	}
+
+	// Bounds of all lights, and of their centers
+	vec3 boundsMin = leaves[begin].boundsMin, boundsMax = leaves[begin].boundsMax;
+	vec3 centroidMin = 0.5f * (boundsMin + boundsMax);
+	vec3 centroidMax = centroidMin;
+	for (uint32_t i = begin + 1; i < end; i++)
+	{
+		boundsMin = glm::min(boundsMin, leaves[i].boundsMin);
+		boundsMax = glm::max(boundsMax, leaves[i].boundsMax);
+		vec3 centroid = 0.5f * (leaves[i].boundsMin + leaves[i].boundsMax);
+		centroidMin = glm::min(centroidMin, centroid);
+		centroidMax = glm::max(centroidMax, centroid);
+	}
+
+	// Binned SAOH split over all three axes
+	int bestAxis = -1;
+	uint32_t bestBin = 0;
+	float bestCost = FLT_MAX;
+	vec3 centroidExtent = centroidMax - centroidMin;
+	vec3 boundsExtent = boundsMax - boundsMin;
+	float maxExtent = std::max(boundsExtent.x, std::max(boundsExtent.y, boundsExtent.z));
+	if (end - begin > 2 && depth < kMaxSahDepth)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (centroidExtent[axis] <= 0.f) continue;
+
+			Node bins[kBinCount];
+			uint32_t binCounts[kBinCount] = {};
+			for (uint32_t i = begin; i < end; i++)
+			{
+				float centroid = 0.5f * (leaves[i].boundsMin[axis] + leaves[i].boundsMax[axis]);
+				uint32_t bin = std::min(uint32_t(kBinCount * (centroid - centroidMin[axis]) / centroidExtent[axis]), kBinCount - 1);
+				bins[bin] = binCounts[bin] ? merge(bins[bin], leaves[i]) : leaves[i];
+				binCounts[bin]++;
+			}
+
+			// Sweep from the right, then evaluate each split from the left.  Thin boxes are penalized, as in Conty Estevez and Kulla.
+			float regularization = (boundsExtent[axis] > 0.f) ? maxExtent / boundsExtent[axis] : 1.f;
+			Node right[kBinCount];
+			uint32_t rightCounts[kBinCount] = {};
+			for (int bin = int(kBinCount) - 1; bin > 0; bin--)
+			{
+				uint32_t next = (bin + 1 < int(kBinCount)) ? rightCounts[bin + 1] : 0;
+				rightCounts[bin] = next + binCounts[bin];
+				if (binCounts[bin]) right[bin] = next ? merge(right[bin + 1], bins[bin]) : bins[bin];
+				else if (next) right[bin] = right[bin + 1];
+			}
+
+			Node left;
+			uint32_t leftCount = 0;
+			for (uint32_t bin = 0; bin + 1 < kBinCount; bin++)
+			{
+				if (binCounts[bin]) left = leftCount ? merge(left, bins[bin]) : bins[bin];
+				leftCount += binCounts[bin];
+				if (leftCount == 0 || rightCounts[bin + 1] == 0) continue;
+
+				float cost = nodeCost(left, regularization) + nodeCost(right[bin + 1], regularization);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+	}
+
+	// Partition around the best split.  Without a useful one (e.g., all lights in one spot, or just two lights), split the range in half.
+	uint32_t mid = begin;
+	if (bestAxis >= 0 && bestCost > 0.f)
+	{
+		Node* pMid = std::partition(leaves.data() + begin, leaves.data() + end, [&](const Node& leaf)
+		{
+			float centroid = 0.5f * (leaf.boundsMin[bestAxis] + leaf.boundsMax[bestAxis]);
+			uint32_t bin = std::min(uint32_t(kBinCount * (centroid - centroidMin[bestAxis]) / centroidExtent[bestAxis]), kBinCount - 1);
+			return bin <= bestBin;
+		});
+		mid = uint32_t(pMid - leaves.data());
+	}
+	if (mid == begin || mid == end)
+	{
+		int axis = (centroidExtent.x >= centroidExtent.y && centroidExtent.x >= centroidExtent.z) ? 0 : (centroidExtent.y >= centroidExtent.z ? 1 : 2);
+		mid = (begin + end) / 2;
+		std::nth_element(leaves.begin() + begin, leaves.begin() + mid, leaves.begin() + end, [axis](const Node& a, const Node& b)
+		{
+			return a.boundsMin[axis] + a.boundsMax[axis] < b.boundsMin[axis] + b.boundsMax[axis];
+		});
+	}
+
+	uint32_t leftChild = buildRecursive(leaves, begin, mid, depth + 1);
+	uint32_t rightChild = buildRecursive(leaves, mid, end, depth + 1);
+	mParents[leftChild] = nodeIndex;
+	mParents[rightChild] = nodeIndex;
+
+	mNodes[nodeIndex] = merge(mNodes[leftChild], mNodes[rightChild]);
+	mNodes[nodeIndex].data = rightChild;
+	return nodeIndex;
+}
+
+void LightBvh::refit()
+{
+	// Children always come after their parent, so one backwards sweep updates everything bottom-up
+	for (size_t i = mNodes.size(); i-- > 0;)
+	{
+		if (mNodes[i].data & kLeafFlag) continue;
+
+		uint32_t rightChild = mNodes[i].data;
+		mNodes[i] = merge(mNodes[i + 1], mNodes[rightChild]);
+		mNodes[i].data = rightChild;
+	}
+}
+
+LightBvh::Benchmark LightBvh::benchmark(uint32_t lightCount, uint32_t sampleCount)
+{
+	Benchmark result;
+	result.lightCount = lightCount;
+	if (lightCount == 0) return result;
+
+	// Log-normal powers; a quarter of the lights are spot lights pointing in random directions
+	std::mt19937 rng(0x1456u);
+	std::uniform_real_distribution<float> position(-50.f, 50.f);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	std::lognormal_distribution<float> powerDist(0.f, 2.f);
+	std::vector<LightData> lights(lightCount);
+	std::vector<float> powers(lightCount);
+	for (uint32_t i = 0; i < lightCount; i++)
+	{
+		LightData& light = lights[i];
+		light = {};
+		light.type = LightPoint;
+		light.posW = vec3(position(rng), position(rng), position(rng));
+		light.dirW = glm::normalize(vec3(unit(rng), unit(rng), unit(rng)) + vec3(0.f, 1e-3f, 0.f));
+		light.openingAngle = (i % 4 == 0) ? 0.5f + 0.5f * std::abs(unit(rng)) : kPi;
+		light.cosOpeningAngle = std::cos(light.openingAngle);
+		powers[i] = powerDist(rng);
+	}
+
+	LightBvh::SharedPtr pBvh = LightBvh::create();
+	pBvh->update(lights, powers);
+	result.buildMs = pBvh->getLastBuildTime();
+	result.nodeCount = uint32_t(pBvh->getNodes().size());
+
+	for (LightData& light : lights) light.posW += vec3(unit(rng), unit(rng), unit(rng));
+	pBvh->update(lights, powers);
+	result.refitMs = pBvh->getLastRefitTime();
+
+	// Same LCG as nextRand(), so the timing reflects what the shaders do
+	uint32_t state = 0x1456u;
+	uint64_t visited = 0;
+	auto nextRandom = [&]() { visited++; state = 1664525u * state + 1013904223u; return float(state >> 8) / float(0x01000000); };
+
+	std::vector<vec3> points(1024), normals(1024);
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		points[i] = vec3(position(rng), position(rng), position(rng));
+		normals[i] = glm::normalize(vec3(unit(rng), unit(rng), unit(rng)) + vec3(0.f, 1e-3f, 0.f));
+	}
+
+	float sumPdf = 0.f;
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+	for (uint32_t i = 0; i < sampleCount; i++)
+	{
+		float pdf;
+		uint32_t pointIndex = i & 1023;
+		pBvh->sample(points[pointIndex], normals[pointIndex], nextRandom, pdf);
+		sumPdf += pdf;
+	}
+	double ms = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+	result.sampleNs = float(ms * 1e6 / std::max(1u, sampleCount));
+	result.avgDepth = float(double(visited) / std::max(1u, sampleCount));
+	if (sumPdf < 0.f) logWarning("LightBvh::benchmark():  negative pdf");   // Keeps the loop from being optimized away
+	return result;
+}
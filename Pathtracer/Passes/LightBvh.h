@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Falcor.h"
+#include "../SharedUtils/SimpleVars.h"
+
+using namespace Falcor;
+
+// How the initial RIS candidates are drawn.  Must match LIGHT_SELECTION_* in restirUtils.hlsli.
+enum class LightSelection : uint32_t
+{
+	Uniform = 0,       ///< Every light equally likely
+	AliasTable = 1,    ///< Proportional to light power (LightAliasTable)
+	Bvh = 2,           ///< Proportional to estimated contribution at the shading point (LightBvh)
+};
+
+// A binary BVH over the scene's lights, for picking lights near (and facing) the shading point more often.
+//     Following Conty Estevez and Kulla ("Importance Sampling of Many Lights With Adaptive Tree Splitting", 2018),
+//     each node stores the bounds, total power, and a cone bounding the emission directions of its lights.  Sampling
+//     walks down from the root, picking each child with probability proportional to a conservative estimate of its
+//     contribution, so the pdf of the selected light is the product of the branch probabilities.
+//
+//     Lights are bounded where getLightData() evaluates them:  at posW, emitting into the cone around dirW cut off at
+//     cosOpeningAngle.  Analytic area lights additionally include their shape's bounds.  Directional lights sit at
+//     the far-away posW Falcor gives them, and nodes holding one skip the receiver cosine bound, since their light
+//     arrives from -dirW rather than from posW.
+//
+//     update() rebuilds when the number of lights changes, refits (keeping the topology) when only light transforms
+//     or powers change, and does nothing otherwise.
+class LightBvh : public std::enable_shared_from_this<LightBvh>
+{
+public:
+	using SharedPtr = std::shared_ptr<LightBvh>;
+	using SharedConstPtr = std::shared_ptr<const LightBvh>;
+	virtual ~LightBvh() = default;
+
+	static const uint32_t kLeafFlag = 0x80000000u;      ///< In Node::data, marks a leaf (the rest is the light index)
+	static const uint32_t kInfiniteFlag = 0x1u;         ///< In Node::flags, the node holds a directional light
+
+	// One node, stored in depth-first order:  an inner node's first child directly follows it.  Must match LightBvhNode in lightBvh.hlsli.
+	struct Node
+	{
+		vec3     boundsMin;
+		float    power;       ///< Sum of Light::getPower() below this node
+		vec3     boundsMax;
+		uint32_t data;        ///< Leaf:  light index | kLeafFlag.  Inner node:  index of the second child.
+		vec3     axis;        ///< Emission cone axis
+		float    thetaO;      ///< Half angle of the cone bounding the axes below this node
+		float    thetaE;      ///< Emission cut-off angle around each of those axes
+		uint32_t flags;
+		uint32_t pad[2];
+	};
+
+	enum class UpdateType { None, Refit, Rebuild };
+
+	// Result of benchmark()
+	struct Benchmark
+	{
+		uint32_t lightCount = 0;
+		uint32_t nodeCount = 0;
+		float    buildMs = 0.f;
+		float    refitMs = 0.f;       ///< After moving every light
+		float    sampleNs = 0.f;      ///< Per sample() call, from random shading points
+		float    avgDepth = 0.f;      ///< Average number of nodes visited per sample
+	};
+
+	static SharedPtr create() { return SharedPtr(new LightBvh()); }
+
+	// Read the scene's lights, then rebuild or refit as needed
+	UpdateType update(const Scene::SharedPtr& pScene);
+	UpdateType update(const std::vector<LightData>& lights, const std::vector<float>& lightPowers);
+
+	// Force a full rebuild on the next update() (e.g., once lights have moved far enough to make refits poor)
+	void requestRebuild()                          { mRebuildRequested = true; }
+
+	// Pick a light for the shading point, as sampleLightBvh() in createLightSamples.hlsl does.  <nextRandom> is called
+	//     once per inner node visited.  Returns the light index, with <pdf> = 0 if no light can contribute.
+	template<typename RandomFunc>
+	uint32_t sample(const vec3& posW, const vec3& normal, RandomFunc&& nextRandom, float& pdf) const;
+
+	// Probability that sample() returns <light> at the shading point (CPU only; walks up from the light's leaf)
+	float evalPdf(const vec3& posW, const vec3& normal, uint32_t light) const;
+
+	// Conservative estimate of the light reaching the shading point from below <node>.  Zero only if no light below can contribute.
+	static float importance(const Node& node, const vec3& posW, const vec3& normal);
+
+	// Bind the nodes to the StructuredBuffer<LightBvhNode> <name> of a program, uploading them first if needed
+	void setIntoVars(SimpleVars::SharedPtr& pVars, const std::string& name);
+
+	// Time a build, a refit, and sampling over <lightCount> random point and spot lights in a 100^3 box
+	static Benchmark benchmark(uint32_t lightCount, uint32_t sampleCount = 1u << 20);
+
+	// Accessors
+	const std::vector<Node>& getNodes() const      { return mNodes; }
+	uint32_t getLightCount() const                 { return uint32_t(mLightToLeaf.size()); }
+	float    getLastBuildTime() const              { return mLastBuildMs; }   ///< In ms
+	float    getLastRefitTime() const              { return mLastRefitMs; }   ///< In ms
+
+protected:
+	LightBvh() = default;
+
+	// Bounds of a single light
+	static Node createLeaf(const LightData& light, float power, uint32_t lightIndex);
+
+	// Bounds of two nodes together
+	static Node merge(const Node& a, const Node& b);
+
+	void build(std::vector<Node>& leaves);
+	uint32_t buildRecursive(std::vector<Node>& leaves, uint32_t begin, uint32_t end, uint32_t depth);
+	void refit();
+
+	std::vector<Node>             mNodes;
+	std::vector<uint32_t>         mParents;            ///< Parent of each node (root: itself)
+	std::vector<uint32_t>         mLightToLeaf;        ///< Leaf node of each light
+	bool                          mRebuildRequested = false;
+	float                         mLastBuildMs = 0.f;
+	float                         mLastRefitMs = 0.f;
+
+	StructuredBuffer::SharedPtr   mpBuffer;
+	bool                          mBufferDirty = true;
+};
+
+template<typename RandomFunc>
+uint32_t LightBvh::sample(const vec3& posW, const vec3& normal, RandomFunc&& nextRandom, float& pdf) const
+{
+	pdf = 0.f;
+	if (mNodes.empty()) return 0;
+
+	pdf = 1.f;
+	uint32_t nodeIndex = 0;
+	while (!(mNodes[nodeIndex].data & kLeafFlag))
+	{
+		uint32_t left = nodeIndex + 1;
+		uint32_t right = mNodes[nodeIndex].data;
+		float leftImportance = importance(mNodes[left], posW, normal);
+		float rightImportance = importance(mNodes[right], posW, normal);
+		float total = leftImportance + rightImportance;
+		if (total <= 0.f) { pdf = 0.f; return 0; }
+
+		if (nextRandom() < leftImportance / total) {
+			nodeIndex = left;
+			pdf *= leftImportance / total;
+		}
+		else {
+			nodeIndex = right;
+			pdf *= rightImportance / total;
+		}
+	}
+	return mNodes[nodeIndex].data & ~kLeafFlag;
+}
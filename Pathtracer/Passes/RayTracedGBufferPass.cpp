@@ -37,6 +37,12 @@ bool RayTracedGBufferPass::initialize(RenderContext* pRenderContext, ResourceMan
 	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse",
 										    "MaterialSpecRough", "MaterialExtraParams" });
 
+	// Last frame's G-buffer, kept for unbiased temporal reuse (we swap it with this frame's before overwriting the latter)
+	mpResManager->requestTextureResources({ "PrevWorldPosition", "PrevWorldNormal", "PrevMaterialDiffuse" });
+
+	// Per-pixel motion vectors, for reprojecting into the previous frame's buffers (see reprojection.hlsli)
+	mpResManager->requestTextureResource("MotionVectors");
+
 	// Set the default scene
 	mpResManager->setDefaultSceneName("Scenes/pink_room/pink_room.fscene");
 
@@ -52,6 +58,14 @@ bool RayTracedGBufferPass::initialize(RenderContext* pRenderContext, ResourceMan
 	return true;
 }
 
+bool RayTracedGBufferPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	// This frame's G-buffer becomes next frame's Prev* channels (see execute()), so neither may be aliased
+	usage.writes = { "WorldPosition", "WorldNormal", "MaterialDiffuse", "MaterialSpecRough", "MaterialExtraParams", "Emissive", "MotionVectors" };
+	usage.persistent = { "WorldPosition", "WorldNormal", "MaterialDiffuse", "PrevWorldPosition", "PrevWorldNormal", "PrevMaterialDiffuse" };
+	return true;
+}
+
 void RayTracedGBufferPass::initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene)
 {
 	// Save copy of scene
@@ -59,6 +73,12 @@ void RayTracedGBufferPass::initScene(RenderContext* pRenderContext, Scene::Share
 		mpScene = std::dynamic_pointer_cast<RtScene>(pScene);
 	}
 
+	// A new scene has no motion yet:  start from its current camera
+	if (mpScene && mpScene->getActiveCamera()) {
+		mLastViewProjMatrix = mpScene->getActiveCamera()->getViewProjMatrix();
+		mLastCameraPos = mpScene->getActiveCamera()->getPosition();
+	}
+
 	// Pass scene to ray tracer
 	if (mpRays) {
 		mpRays->setScene(mpScene);
@@ -70,6 +90,11 @@ void RayTracedGBufferPass::execute(RenderContext* pRenderContext)
 	// Check that pass is ready to render
 	if (!mpRays || !mpRays->readyToRender()) return;
 
+	// Ping-pong:  what we wrote last frame becomes the previous G-buffer, and we write over the one before
+	mpResManager->swapTextures("WorldPosition",   "PrevWorldPosition");
+	mpResManager->swapTextures("WorldNormal",     "PrevWorldNormal");
+	mpResManager->swapTextures("MaterialDiffuse", "PrevMaterialDiffuse");
+
 	// Load G-buffer textures and clear them to black
 	vec4 black = vec4(0, 0, 0, 0);
 	Texture::SharedPtr wsPos    = mpResManager->getClearedTexture("WorldPosition",       black);
@@ -78,6 +103,12 @@ void RayTracedGBufferPass::execute(RenderContext* pRenderContext)
 	Texture::SharedPtr matSpec  = mpResManager->getClearedTexture("MaterialSpecRough",   black);
 	Texture::SharedPtr matExtra = mpResManager->getClearedTexture("MaterialExtraParams", black);
 	Texture::SharedPtr matEmit  = mpResManager->getClearedTexture("Emissive",            black);
+	Texture::SharedPtr motion   = mpResManager->getClearedTexture("MotionVectors",       black);
+
+	// Last frame's camera, for the motion vectors
+	auto globalVars = mpRays->getGlobalVars();
+	globalVars["GlobalCB"]["gPrevViewProjMat"] = mLastViewProjMatrix;
+	globalVars["GlobalCB"]["gPrevCameraPos"] = mLastCameraPos;
 
 	// Pass background color to miss shader #0
 	auto missVars = mpRays->getMissVars(0);
@@ -94,8 +125,15 @@ void RayTracedGBufferPass::execute(RenderContext* pRenderContext)
 		pVars["gMatSpec"] = matSpec;
 		pVars["gMatExtra"] = matExtra;
 		pVars["gMatEmissive"] = matEmit;
+		pVars["gMotion"] = motion;
 	}
 
 	// Launch ray tracing
 	mpRays->execute(pRenderContext, mpResManager->getScreenSize());
+
+	// This frame's camera is next frame's previous one
+	if (mpScene && mpScene->getActiveCamera()) {
+		mLastViewProjMatrix = mpScene->getActiveCamera()->getViewProjMatrix();
+		mLastCameraPos = mpScene->getActiveCamera()->getPosition();
+	}
 }
\ No newline at end of file
@@ -41,8 +41,13 @@ protected:
 	// Override default RenderPass functionality (that control the rendering pipeline and its GUI)
 	bool requiresScene() override { return true; }      // Adds 'load scene' option to GUI.
 	bool usesRayTracing() override { return true; }      // Removes a GUI control that is confusing for this simple demo
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
 
 	// Internal state variables for this pass
 	RayLaunch::SharedPtr          mpRays;              ///< Wrapper around DXR pass
 	RtScene::SharedPtr            mpScene;             ///< Falcor scene representation, with additions for ray tracing
+
+	// Last frame's camera, for the motion vectors
+	mat4                          mLastViewProjMatrix;
+	vec3                          mLastCameraPos;
 };
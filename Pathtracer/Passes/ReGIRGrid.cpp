@@ -0,0 +1,120 @@
+#include "ReGIRGrid.h"
+
+namespace {
+	// Keep grids on flat scenes (e.g., a single quad) from collapsing to zero-sized cells
+	const float kMinExtent = 1e-3f;
+
+	// Max cells along each axis in the GUI.  128^3 cells x 32 slots is already 1 GB of reservoirs.
+	const int32_t kMaxCellsPerAxis = 128;
+};
+
+ReGIRGrid::ReGIRGrid(const uvec3& cellCount, uint32_t lightsPerCell) :
+	mCellCount(glm::max(cellCount, uvec3(1))),
+	mLightsPerCell(std::max(1u, lightsPerCell))
+{
+}
+
+void ReGIRGrid::fitToScene(const Scene::SharedPtr& pScene, float padding)
+{
+	if (!pScene) return;
+
+	BoundingBox sceneAABB;
+	bool first = true;
+	for (uint32_t i = 0; i < pScene->getModelCount(); ++i)
+	{
+		for (uint32_t j = 0; j < pScene->getModelInstanceCount(i); ++j)
+		{
+			const BoundingBox& instanceAABB = pScene->getModelInstance(i, j)->getBoundingBox();
+			sceneAABB = first ? instanceAABB : BoundingBox::fromUnion(sceneAABB, instanceAABB);
+			first = false;
+		}
+	}
+	if (first) return;
+
+	// BoundingBox::extent is the half size
+	vec3 extent = glm::max(2.f * sceneAABB.extent * (1.f + 2.f * padding), vec3(kMinExtent));
+	setBounds(sceneAABB.center - 0.5f * extent, extent);
+}
+
+void ReGIRGrid::setBounds(const vec3& origin, const vec3& extent)
+{
+	mOrigin = origin;
+	mExtent = glm::max(extent, vec3(kMinExtent));
+}
+
+void ReGIRGrid::setCellCount(const uvec3& cellCount)
+{
+	mCellCount = glm::max(cellCount, uvec3(1));
+}
+
+void ReGIRGrid::setLightsPerCell(uint32_t lightsPerCell)
+{
+	mLightsPerCell = std::max(1u, lightsPerCell);
+}
+
+int ReGIRGrid::mapWorldToGrid(const vec3& posW) const
+{
+	ivec3 gridCell = ivec3(glm::floor((posW - mOrigin) / getCellSize()));
+	if (gridCell.x < 0 || gridCell.y < 0 || gridCell.z < 0 ||
+		gridCell.x >= int(mCellCount.x) || gridCell.y >= int(mCellCount.y) || gridCell.z >= int(mCellCount.z)) return -1;
+
+	return gridCell.x + int(mCellCount.x) * gridCell.y + int(mCellCount.x * mCellCount.y) * gridCell.z;
+}
+
+vec3 ReGIRGrid::mapCellIndexToWorld(uint32_t cellIndex) const
+{
+	uvec3 coords = uvec3(cellIndex % mCellCount.x, (cellIndex / mCellCount.x) % mCellCount.y, cellIndex / (mCellCount.x * mCellCount.y));
+	return (vec3(coords) + 0.5f) * getCellSize() + mOrigin;
+}
+
+TypedBuffer<vec4>::SharedPtr ReGIRGrid::getBuffer()
+{
+	if (!mpBuffer || mpBuffer->getElementCount() != getSlotCount())
+	{
+		mpBuffer = TypedBuffer<vec4>::create(getSlotCount());
+	}
+	return mpBuffer;
+}
+
+bool ReGIRGrid::renderGui(Gui* pGui, const Scene::SharedPtr& pScene)
+{
+	int dirty = 0;
+
+	ivec3 cellCount = ivec3(mCellCount);
+	if (pGui->addInt3Var("Grid Cells", cellCount, 1, kMaxCellsPerAxis))
+	{
+		setCellCount(uvec3(cellCount));
+		dirty = 1;
+	}
+
+	int32_t lightsPerCell = int32_t(mLightsPerCell);
+	if (pGui->addIntVar("Lights Per Cell", lightsPerCell, 1, 512))
+	{
+		setLightsPerCell(uint32_t(lightsPerCell));
+		dirty = 1;
+	}
+
+	int32_t candidates = mCellCandidates;
+	if (pGui->addIntVar("Candidates Per Slot", candidates, 1, 256))
+	{
+		setCellCandidates(candidates);
+		dirty = 1;
+	}
+
+	vec3 origin = mOrigin, extent = mExtent;
+	dirty |= (int)pGui->addFloat3Var("Grid Origin", origin, -FLT_MAX, FLT_MAX, 0.1f);
+	dirty |= (int)pGui->addFloat3Var("Grid Extent", extent, kMinExtent, FLT_MAX, 0.1f);
+	if (pGui->addButton("Fit Grid To Scene"))
+	{
+		fitToScene(pScene);
+		dirty = 1;
+	}
+	else
+	{
+		setBounds(origin, extent);
+	}
+
+	vec3 cellSize = getCellSize();
+	pGui->addText(("Cell size: " + std::to_string(cellSize.x) + " x " + std::to_string(cellSize.y) + " x " + std::to_string(cellSize.z)).c_str());
+	return dirty != 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Falcor.h"
+
+using namespace Falcor;
+
+// The world-space light grid used by ReGIR, shared by BuildCellReservoirsPass (which fills it each frame) and
+//     SampleLightGridPass (which resamples it per pixel).  The layout matches regirUtils.hlsli:  cells are x-major,
+//     and each cell owns getLightsPerCell() consecutive light slots, stored as float4(y, M, W, wSum) reservoirs.
+class ReGIRGrid : public std::enable_shared_from_this<ReGIRGrid>
+{
+public:
+	using SharedPtr = std::shared_ptr<ReGIRGrid>;
+	using SharedConstPtr = std::shared_ptr<const ReGIRGrid>;
+	virtual ~ReGIRGrid() = default;
+
+	static SharedPtr create(const uvec3& cellCount = uvec3(16, 16, 16), uint32_t lightsPerCell = 32) { return SharedPtr(new ReGIRGrid(cellCount, lightsPerCell)); }
+
+	// Place the grid over the scene's bounding box (the same box Scene::getCenter() / getRadius() are derived from),
+	//     grown by <padding> (a fraction of its size) on every side.  Keeps the cell count.
+	void fitToScene(const Scene::SharedPtr& pScene, float padding = 0.05f);
+
+	// Change the layout.  Bounds are kept when changing the cell count; the cell size follows.
+	void setBounds(const vec3& origin, const vec3& extent);
+	void setCellCount(const uvec3& cellCount);
+	void setLightsPerCell(uint32_t lightsPerCell);
+	void setCellCandidates(int32_t candidates)     { mCellCandidates = std::max(1, candidates); }
+
+	// Layout accessors
+	const vec3&  getOrigin() const                 { return mOrigin; }
+	const vec3&  getExtent() const                 { return mExtent; }
+	vec3         getCellSize() const               { return mExtent / vec3(mCellCount); }
+	const uvec3& getCellCount() const              { return mCellCount; }
+	uint32_t     getLightsPerCell() const          { return mLightsPerCell; }
+	int32_t      getCellCandidates() const         { return mCellCandidates; }   ///< RIS candidates per light slot
+	uint32_t     getCellTotal() const              { return mCellCount.x * mCellCount.y * mCellCount.z; }
+	uint32_t     getSlotCount() const              { return getCellTotal() * mLightsPerCell; }
+
+	// Same as mapWorldToGrid() / mapCellIndexToWorld() in regirUtils.hlsli:  linear cell index of a world-space
+	//     position (-1 if outside the grid), and the world-space center of a cell
+	int  mapWorldToGrid(const vec3& posW) const;
+	vec3 mapCellIndexToWorld(uint32_t cellIndex) const;
+
+	// GPU storage of the light slots.  (Re)allocated whenever the layout changes.
+	TypedBuffer<vec4>::SharedPtr getBuffer();
+
+	// Frame counter of the last fill, so a CPU replay (see CpuReGIR) can reproduce its random numbers
+	void     setLastBuildFrame(uint32_t frameCount)  { mLastBuildFrame = frameCount; }
+	uint32_t getLastBuildFrame() const               { return mLastBuildFrame; }
+
+	// Add layout controls to a pass' GUI.  Returns true if anything changed.
+	bool renderGui(Gui* pGui, const Scene::SharedPtr& pScene);
+
+protected:
+	ReGIRGrid(const uvec3& cellCount, uint32_t lightsPerCell);
+
+	vec3                          mOrigin = vec3(-8.f);
+	vec3                          mExtent = vec3(16.f);
+	uvec3                         mCellCount;
+	uint32_t                      mLightsPerCell;
+	int32_t                       mCellCandidates = 8;
+	uint32_t                      mLastBuildFrame = 0;
+
+	TypedBuffer<vec4>::SharedPtr  mpBuffer;            ///< getSlotCount() reservoirs
+};
@@ -0,0 +1,76 @@
+#include "ReservoirStore.h"
+
+namespace {
+	const char* kShaderNames[] = { "gCurrReservoirBuffer", "gPrevReservoirBuffer", "gSpatialReservoirOutBuffer", "gSpatialReservoirBuffer" };
+	const char* kGIShaderNames[] = { "gGICurrReservoirBuffer", "gGIPrevReservoirBuffer", "gGISpatialReservoirBuffer" };
+};
+
+ReservoirStore::ReservoirStore(uint32_t reservoirsPerPixel, Format format) :
+	mReservoirsPerPixel(glm::clamp(reservoirsPerPixel, 1u, kMaxReservoirsPerPixel)),
+	mFormat(format)
+{
+}
+
+void ReservoirStore::addDefines(const RayLaunch::SharedPtr& pRays) const
+{
+	pRays->addDefine("RESERVOIRS_PER_PIXEL", std::to_string(mReservoirsPerPixel));
+	pRays->addDefine("RESERVOIR_FORMAT", std::to_string(uint32_t(mFormat)));
+}
+
+const char* ReservoirStore::getShaderName(BufferId id)
+{
+	return kShaderNames[uint32_t(id)];
+}
+
+const char* ReservoirStore::getShaderName(GIBufferId id)
+{
+	return kGIShaderNames[uint32_t(id)];
+}
+
+void ReservoirStore::checkScreenSize(const uvec2& screenSize)
+{
+	// A new screen size invalidates every buffer, including the ones this program doesn't bind
+	if (screenSize != mScreenSize)
+	{
+		for (auto& pBuffer : mpBuffers) pBuffer = nullptr;
+		for (auto& pBuffer : mpGIBuffers) pBuffer = nullptr;
+		mScreenSize = screenSize;
+	}
+}
+
+StructuredBuffer::SharedPtr ReservoirStore::createBuffer(SimpleVars::SharedPtr& pVars, const char* name, size_t elementCount, uint32_t elementSize)
+{
+	StructuredBuffer::SharedPtr pBuffer = pVars->createStructuredBuffer(name, elementCount);
+	if (!pBuffer) return nullptr;
+
+	// Start from empty reservoirs (M = 0), so the first frame's temporal reuse finds nothing
+	std::vector<uint8_t> empty(elementCount * elementSize, 0);
+	pBuffer->setBlob(empty.data(), 0, empty.size());
+	return pBuffer;
+}
+
+void ReservoirStore::setIntoVars(SimpleVars::SharedPtr& pVars, const std::vector<BufferId>& ids, const uvec2& screenSize)
+{
+	checkScreenSize(screenSize);
+
+	size_t elementCount = std::max<size_t>(1, size_t(screenSize.x) * screenSize.y * mReservoirsPerPixel);
+	for (BufferId id : ids)
+	{
+		StructuredBuffer::SharedPtr& pBuffer = mpBuffers[uint32_t(id)];
+		if (!pBuffer) pBuffer = createBuffer(pVars, getShaderName(id), elementCount, getReservoirSize(mFormat));
+		if (pBuffer) pVars[getShaderName(id)] = pBuffer;
+	}
+}
+
+void ReservoirStore::setIntoVars(SimpleVars::SharedPtr& pVars, const std::vector<GIBufferId>& ids, const uvec2& screenSize)
+{
+	checkScreenSize(screenSize);
+
+	size_t elementCount = std::max<size_t>(1, size_t(screenSize.x) * screenSize.y);
+	for (GIBufferId id : ids)
+	{
+		StructuredBuffer::SharedPtr& pBuffer = mpGIBuffers[uint32_t(id)];
+		if (!pBuffer) pBuffer = createBuffer(pVars, getShaderName(id), elementCount, getGIReservoirSize());
+		if (pBuffer) pVars[getShaderName(id)] = pBuffer;
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Falcor.h"
+#include "../SharedUtils/SimpleVars.h"
+#include "../SharedUtils/RayLaunch.h"
+#include "../Shaders/ReservoirEncoding.h"
+#include "../Shaders/GIReservoir.h"
+
+using namespace Falcor;
+
+// Per-pixel reservoir storage shared by CreateLightSamplesPass, SpatialReusePass and ShadeWithReservoirsPass.
+//     Each pixel owns getReservoirsPerPixel() consecutive reservoirs in every buffer, so all N reservoirs of a pixel
+//     are read or written together:
+//
+//         index = (pixel.y * width + pixel.x) * RESERVOIRS_PER_PIXEL + k
+//
+//     The count is fixed for the lifetime of the store and reaches the shaders as the RESERVOIRS_PER_PIXEL define
+//     (see addDefines()), so their per-reservoir loops unroll.  Buffers are allocated on first use from the program
+//     binding them, reallocated (and so cleared) when the screen size changes, and otherwise persist across frames,
+//     which is what temporal reuse of PrevReservoirs relies on.  Reservoirs are stored in one of the formats of
+//     ReservoirEncoding.h, which also reaches the shaders as a define (RESERVOIR_FORMAT).
+//
+//     The ReSTIR GI passes keep their reservoirs here too, in a second set of buffers (GIBufferId) with one
+//     PackedGIReservoir (GIReservoir.h) per pixel, allocated and cleared the same way.
+class ReservoirStore : public std::enable_shared_from_this<ReservoirStore>
+{
+public:
+	using SharedPtr = std::shared_ptr<ReservoirStore>;
+	using SharedConstPtr = std::shared_ptr<const ReservoirStore>;
+	virtual ~ReservoirStore() = default;
+
+	static const uint32_t kMaxReservoirsPerPixel = 16;
+
+	// The buffers we keep.  These used to be the reservoir textures of the same names.
+	enum class BufferId : uint32_t
+	{
+		CurrReservoirs = 0,    ///< Written by CreateLightSamplesPass
+		PrevReservoirs,        ///< Last frame's final reservoirs, written by ShadeWithReservoirsPass
+		SpatialReservoirsOut,  ///< Between spatial reuse iterations
+		SpatialReservoirs,     ///< Final reservoirs, read by ShadeWithReservoirsPass
+		Count
+	};
+
+	// The GI reservoir buffers, used by CreateGISamplesPass, GISpatialReusePass and ShadeWithGIReservoirsPass
+	enum class GIBufferId : uint32_t
+	{
+		CurrGIReservoirs = 0,  ///< Written by CreateGISamplesPass (new samples after temporal reuse)
+		PrevGIReservoirs,      ///< Last frame's CurrGIReservoirs, kept by ShadeWithGIReservoirsPass
+		SpatialGIReservoirs,   ///< After spatial reuse, read by ShadeWithGIReservoirsPass
+		Count
+	};
+
+	// How each reservoir is stored (see ReservoirEncoding.h)
+	enum class Format : uint32_t
+	{
+		Full = RESERVOIR_FORMAT_FULL,          ///< FullReservoir, 16 bytes
+		Compact = RESERVOIR_FORMAT_COMPACT,    ///< CompactReservoir, 8 bytes
+	};
+
+	static SharedPtr create(uint32_t reservoirsPerPixel = 1, Format format = Format::Full) { return SharedPtr(new ReservoirStore(reservoirsPerPixel, format)); }
+
+	// Set RESERVOIRS_PER_PIXEL and RESERVOIR_FORMAT for a pass' shaders.  Call before compiling them.
+	void addDefines(const RayLaunch::SharedPtr& pRays) const;
+
+	// Bind the given buffers to a program, under their getShaderName()s, (re)allocating them for <screenSize> first if needed
+	void setIntoVars(SimpleVars::SharedPtr& pVars, const std::vector<BufferId>& ids, const uvec2& screenSize);
+
+	// Same for GI reservoir buffers
+	void setIntoVars(SimpleVars::SharedPtr& pVars, const std::vector<GIBufferId>& ids, const uvec2& screenSize);
+
+	// Name of a buffer's RWStructuredBuffer<PackedReservoir> (or <PackedGIReservoir>) in the shaders
+	static const char* getShaderName(BufferId id);
+	static const char* getShaderName(GIBufferId id);
+
+	// Size of one reservoir in the given format
+	static uint32_t getReservoirSize(Format format)   { return (format == Format::Compact) ? uint32_t(sizeof(CompactReservoir)) : uint32_t(sizeof(FullReservoir)); }
+
+	// Accessors
+	uint32_t getReservoirsPerPixel() const         { return mReservoirsPerPixel; }
+	Format   getFormat() const                     { return mFormat; }
+	static uint32_t getGIReservoirSize()           { return uint32_t(sizeof(PackedGIReservoir)); }
+	uint32_t getBytesPerPixel() const              { return mReservoirsPerPixel * getReservoirSize(mFormat); }   ///< In one buffer
+
+protected:
+	ReservoirStore(uint32_t reservoirsPerPixel, Format format);
+
+	// Drop every buffer if the screen size changed
+	void checkScreenSize(const uvec2& screenSize);
+
+	// Allocate a buffer of <elementCount> elements of <elementSize> bytes, starting from empty reservoirs (M = 0)
+	static StructuredBuffer::SharedPtr createBuffer(SimpleVars::SharedPtr& pVars, const char* name, size_t elementCount, uint32_t elementSize);
+
+	uint32_t                      mReservoirsPerPixel;
+	Format                        mFormat;
+	uvec2                         mScreenSize = uvec2(0, 0);
+	StructuredBuffer::SharedPtr   mpBuffers[uint32_t(BufferId::Count)];
+	StructuredBuffer::SharedPtr   mpGIBuffers[uint32_t(GIBufferId::Count)];
+};
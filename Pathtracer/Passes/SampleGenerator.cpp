@@ -0,0 +1,264 @@
+#include "SampleGenerator.h"
+#include <random>
+
+namespace {
+	const char* kTypeNames[] = { "Uniform", "Sobol", "R2", "Blue noise" };
+
+	// Ulichney's void-and-cluster method over a toroidal BLUE_NOISE_TILE_SIZE^2 tile
+	std::vector<float> generateBlueNoiseMask()
+	{
+		const int size = BLUE_NOISE_TILE_SIZE;
+		const int count = size * size;
+		const float sigma = 1.5f;
+
+		// Gaussian energy of a set pixel at each toroidal offset
+		std::vector<float> kernel(count);
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				float dx = float(std::min(x, size - x));
+				float dy = float(std::min(y, size - y));
+				kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.f * sigma * sigma));
+			}
+		}
+
+		std::vector<uint8_t> pattern(count, 0);
+		std::vector<float> energy(count, 0.f);
+		auto splat = [&](int p, float sign)
+		{
+			int px = p % size, py = p / size;
+			for (int y = 0; y < size; y++)
+			{
+				const float* pKernelRow = &kernel[((y - py) & (size - 1)) * size];
+				for (int x = 0; x < size; x++) energy[y * size + x] += sign * pKernelRow[(x - px) & (size - 1)];
+			}
+		};
+		auto tightestCluster = [&]()
+		{
+			int best = 0;
+			float bestEnergy = -std::numeric_limits<float>::infinity();
+			for (int p = 0; p < count; p++) if (pattern[p] && energy[p] > bestEnergy) { best = p; bestEnergy = energy[p]; }
+			return best;
+		};
+		auto largestVoid = [&]()
+		{
+			int best = 0;
+			float bestEnergy = std::numeric_limits<float>::infinity();
+			for (int p = 0; p < count; p++) if (!pattern[p] && energy[p] < bestEnergy) { best = p; bestEnergy = energy[p]; }
+			return best;
+		};
+
+		// Initial binary pattern:  a tenth of the pixels, at random, then relaxed by moving the tightest cluster into the
+		//     largest void until that's the same pixel
+		std::mt19937 rng(0x1456u);
+		int ones = count / 10;
+		for (int placed = 0; placed < ones;)
+		{
+			int p = int(rng() % uint32_t(count));
+			if (pattern[p]) continue;
+			pattern[p] = 1;
+			splat(p, 1.f);
+			placed++;
+		}
+		for (int moves = 0; moves < count; moves++)
+		{
+			int cluster = tightestCluster();
+			pattern[cluster] = 0;
+			splat(cluster, -1.f);
+			int hole = largestVoid();
+			pattern[hole] = 1;
+			splat(hole, 1.f);
+			if (hole == cluster) break;
+		}
+
+		// Ranks below the prototype's count come from removing its tightest clusters, the others from filling its largest voids
+		std::vector<int> rank(count);
+		std::vector<uint8_t> prototype = pattern;
+		std::vector<float> prototypeEnergy = energy;
+		for (int r = ones - 1; r >= 0; r--)
+		{
+			int cluster = tightestCluster();
+			pattern[cluster] = 0;
+			splat(cluster, -1.f);
+			rank[cluster] = r;
+		}
+		pattern = prototype;
+		energy = prototypeEnergy;
+		for (int r = ones; r < count; r++)
+		{
+			int hole = largestVoid();
+			pattern[hole] = 1;
+			splat(hole, 1.f);
+			rank[hole] = r;
+		}
+
+		std::vector<float> mask(count);
+		for (int p = 0; p < count; p++) mask[p] = (float(rank[p]) + 0.5f) / float(count);
+		return mask;
+	}
+
+	// L2-star discrepancy of a 2D point set (Warnock's formula)
+	double l2StarDiscrepancy(const std::vector<float>& xs, const std::vector<float>& ys)
+	{
+		size_t n = xs.size();
+		double single = 0.0, pairs = 0.0;
+		for (size_t i = 0; i < n; i++)
+		{
+			single += (1.0 - double(xs[i]) * xs[i]) * (1.0 - double(ys[i]) * ys[i]);
+			for (size_t j = 0; j < n; j++)
+			{
+				pairs += (1.0 - std::max(xs[i], xs[j])) * (1.0 - std::max(ys[i], ys[j]));
+			}
+		}
+		double d2 = 1.0 / 9.0 - 0.5 * single / double(n) + pairs / (double(n) * double(n));
+		return std::sqrt(std::max(d2, 0.0));
+	}
+
+	// Least-squares slope of log2(errors) over log2(spp), skipping exact results
+	float convergenceSlope(const std::vector<uint32_t>& spp, const std::vector<double>& errors)
+	{
+		double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+		uint32_t n = 0;
+		for (size_t i = 0; i < spp.size(); i++)
+		{
+			if (errors[i] <= 0.0) continue;
+			double x = std::log2(double(spp[i])), y = std::log2(errors[i]);
+			sx += x; sy += y; sxx += x * x; sxy += x * y;
+			n++;
+		}
+		double denominator = double(n) * sxx - sx * sx;
+		return (n > 1 && denominator > 0.0) ? float((double(n) * sxy - sx * sy) / denominator) : 0.f;
+	}
+};
+
+float blueNoiseMaskTexel(uint32_t x, uint32_t y)
+{
+	return SampleGenerator::getBlueNoiseMask()[y * BLUE_NOISE_TILE_SIZE + x];
+}
+
+const std::vector<float>& SampleGenerator::getBlueNoiseMask()
+{
+	static const std::vector<float> sMask = generateBlueNoiseMask();
+	return sMask;
+}
+
+const char* SampleGenerator::getTypeName(Type type)
+{
+	return (uint32_t(type) < SAMPLER_COUNT) ? kTypeNames[uint32_t(type)] : "Unknown";
+}
+
+const Gui::DropdownList& SampleGenerator::getTypeList()
+{
+	static const Gui::DropdownList sList = {
+		{ uint32_t(Type::Uniform), kTypeNames[SAMPLER_UNIFORM] },
+		{ uint32_t(Type::Sobol), kTypeNames[SAMPLER_SOBOL] },
+		{ uint32_t(Type::R2), kTypeNames[SAMPLER_R2] },
+		{ uint32_t(Type::BlueNoise), kTypeNames[SAMPLER_BLUE_NOISE] },
+	};
+	return sList;
+}
+
+bool SampleGenerator::renderGui(Gui* pGui)
+{
+	return pGui->addDropdown("Sampler", getTypeList(), mType);
+}
+
+const Texture::SharedPtr& SampleGenerator::getBlueNoiseTexture()
+{
+	if (!mpBlueNoiseTexture)
+	{
+		const std::vector<float>& mask = getBlueNoiseMask();
+		mpBlueNoiseTexture = Texture::create2D(BLUE_NOISE_TILE_SIZE, BLUE_NOISE_TILE_SIZE, ResourceFormat::R32Float, 1, 1, mask.data());
+	}
+	return mpBlueNoiseTexture;
+}
+
+void SampleGenerator::setIntoVars(SimpleVars::SharedPtr& pVars, const std::string& cbName)
+{
+	pVars[cbName]["gSamplerType"] = mType;
+	pVars["gBlueNoiseMask"] = getBlueNoiseTexture();
+}
+
+std::vector<SampleGenerator::Benchmark> SampleGenerator::benchmark(uint32_t pixels, uint32_t samples)
+{
+	std::vector<Benchmark> results;
+	if (pixels == 0 || samples == 0) return results;
+	getBlueNoiseMask();   // Generated once, outside the timing
+
+	const double kSmoothIntegral = 7.0 / 6.0;          // (x + y)^2 over the unit square
+	const double kEdgeIntegral = 0.78539816339744831;  // x^2 + y^2 < 1
+	std::vector<uint32_t> spp;
+	for (uint32_t count = 1; count <= samples; count *= 2) spp.push_back(count);
+
+	for (uint32_t type = 0; type < SAMPLER_COUNT; type++)
+	{
+		Benchmark result;
+		result.type = Type(type);
+		result.pixels = pixels;
+		result.samples = samples;
+
+		std::vector<double> smoothSq(spp.size(), 0.0), edgeSq(spp.size(), 0.0);
+		std::vector<float> xs(samples), ys(samples);
+		double discrepancy = 0.0, domainDiscrepancy = 0.0;
+		for (uint32_t p = 0; p < pixels; p++)
+		{
+			PixelSampler s = createPixelSampler(type, p % BLUE_NOISE_TILE_SIZE, p / BLUE_NOISE_TILE_SIZE);
+
+			// A 2D domain, integrated at each power of two of its points
+			double smoothSum = 0.0, edgeSum = 0.0;
+			size_t next = 0;
+			for (uint32_t i = 0; i < samples; i++)
+			{
+				xs[i] = pixelSample(s, SAMPLE_DOMAIN_BOUNCE, i, 0);
+				ys[i] = pixelSample(s, SAMPLE_DOMAIN_BOUNCE, i, 1);
+				smoothSum += double(xs[i] + ys[i]) * double(xs[i] + ys[i]);
+				edgeSum += (xs[i] * xs[i] + ys[i] * ys[i] < 1.f) ? 1.0 : 0.0;
+				if (next < spp.size() && i + 1 == spp[next])
+				{
+					double smoothError = smoothSum / double(i + 1) / kSmoothIntegral - 1.0;
+					double edgeError = edgeSum / double(i + 1) / kEdgeIntegral - 1.0;
+					smoothSq[next] += smoothError * smoothError;
+					edgeSq[next] += edgeError * edgeError;
+					next++;
+				}
+			}
+			discrepancy += l2StarDiscrepancy(xs, ys);
+
+			// Two 1D decisions at the same index, from different domains
+			for (uint32_t i = 0; i < samples; i++)
+			{
+				xs[i] = pixelSample(s, SAMPLE_DOMAIN_CANDIDATE, i, 0);
+				ys[i] = pixelSample(s, SAMPLE_DOMAIN_CANDIDATE_RIS, i, 0);
+			}
+			domainDiscrepancy += l2StarDiscrepancy(xs, ys);
+		}
+
+		std::vector<double> smoothRmse(spp.size()), edgeRmse(spp.size());
+		for (size_t i = 0; i < spp.size(); i++)
+		{
+			smoothRmse[i] = std::sqrt(smoothSq[i] / double(pixels));
+			edgeRmse[i] = std::sqrt(edgeSq[i] / double(pixels));
+		}
+		result.discrepancy = float(discrepancy / double(pixels));
+		result.domainDiscrepancy = float(domainDiscrepancy / double(pixels));
+		result.smoothSlope = convergenceSlope(spp, smoothRmse);
+		result.edgeSlope = convergenceSlope(spp, edgeRmse);
+		result.smoothError = float(smoothRmse.back());
+		result.edgeError = float(edgeRmse.back());
+
+		float sum = 0.f;
+		CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+		for (uint32_t p = 0; p < pixels; p++)
+		{
+			PixelSampler s = createPixelSampler(type, p % BLUE_NOISE_TILE_SIZE, p / BLUE_NOISE_TILE_SIZE);
+			for (uint32_t i = 0; i < samples; i++) sum += pixelSample(s, SAMPLE_DOMAIN_CANDIDATE, i, 0);
+		}
+		double ms = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+		result.nsPerSample = float(ms * 1e6 / (double(pixels) * double(samples)));
+		if (sum < 0.f) logWarning("SampleGenerator::benchmark():  negative sample");   // Keeps the loop from being optimized away
+
+		results.push_back(result);
+	}
+	return results;
+}
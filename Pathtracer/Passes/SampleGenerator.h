@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Falcor.h"
+#include "../SharedUtils/SimpleVars.h"
+#include "../Shaders/SampleSequences.h"
+
+using namespace Falcor;
+
+// A pass' choice of sample sequence for its random decisions, and the blue-noise mask behind SAMPLER_BLUE_NOISE.  The
+//     sequences themselves live in SampleSequences.h, shared with the CPU renderer; a shader using them includes that
+//     header, declares a "uint gSamplerType" in its GlobalCB, and gets both bound by setIntoVars().
+//
+//     The mask is generated once per process with Ulichney's void-and-cluster method (toroidal Gaussian energy, sigma 1.5),
+//     so it tiles without seams.
+class SampleGenerator : public std::enable_shared_from_this<SampleGenerator>
+{
+public:
+	using SharedPtr = std::shared_ptr<SampleGenerator>;
+	using SharedConstPtr = std::shared_ptr<const SampleGenerator>;
+	virtual ~SampleGenerator() = default;
+
+	// Must match SAMPLER_* in SampleSequences.h
+	enum class Type : uint32_t
+	{
+		Uniform = SAMPLER_UNIFORM,      ///< Hashed white noise
+		Sobol = SAMPLER_SOBOL,          ///< Owen-scrambled Sobol
+		R2 = SAMPLER_R2,                ///< R2 with a per-pixel shift
+		BlueNoise = SAMPLER_BLUE_NOISE, ///< R2 shifted by the blue-noise mask
+	};
+
+	// Quality of one sampler, as measured by benchmark().  The points are each pixel's first <samples> of a 2D domain.
+	struct Benchmark
+	{
+		Type     type = Type::Uniform;
+		uint32_t pixels = 0;
+		uint32_t samples = 0;
+		float    discrepancy = 0.f;            ///< Mean L2-star discrepancy of a domain's points
+		float    domainDiscrepancy = 0.f;      ///< Same, pairing the first dimension of two different domains (high:  they correlate)
+		float    smoothSlope = 0.f;            ///< Slope of log2(RMSE) over log2(spp) integrating a smooth function (-0.5:  Monte Carlo)
+		float    edgeSlope = 0.f;              ///< Same, integrating a quarter disk (a discontinuity, like a shadow edge)
+		float    smoothError = 0.f;            ///< Relative RMSE at <samples> spp
+		float    edgeError = 0.f;
+		float    nsPerSample = 0.f;            ///< Time to draw one value
+	};
+
+	static SharedPtr create(Type type = Type::Sobol) { return SharedPtr(new SampleGenerator(type)); }
+
+	// Sampler dropdown.  Returns true if the choice changed.
+	bool renderGui(Gui* pGui);
+
+	// Set gSamplerType in the constant buffer <cbName> and bind gBlueNoiseMask, creating it first if needed
+	void setIntoVars(SimpleVars::SharedPtr& pVars, const std::string& cbName = "GlobalCB");
+
+	// The mask as a texture, created on first use.  For passes that bind gBlueNoiseMask and the sampler type themselves.
+	const Texture::SharedPtr& getBlueNoiseTexture();
+
+	// The mask, BLUE_NOISE_TILE_SIZE^2 texels in [0, 1) in row-major order, each value taken once
+	static const std::vector<float>& getBlueNoiseMask();
+
+	// Measure discrepancy and convergence of each sampler over <pixels> pixels
+	static std::vector<Benchmark> benchmark(uint32_t pixels = 256, uint32_t samples = 256);
+
+	static const char* getTypeName(Type type);
+	static const Gui::DropdownList& getTypeList();
+
+	// Accessors
+	Type getType() const                           { return Type(mType); }
+	void setType(Type type)                        { mType = uint32_t(type); }
+
+protected:
+	SampleGenerator(Type type) : mType(uint32_t(type)) {}
+
+	uint32_t                      mType;
+	Texture::SharedPtr            mpBlueNoiseTexture;
+};
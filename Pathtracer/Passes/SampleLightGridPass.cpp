@@ -9,14 +9,10 @@ namespace {
 	const char* kEntryPointMiss0 = "ShadowMiss";
 	const char* kEntryShadowAnyHit = "ShadowAnyHit";
 	const char* kEntryShadowClosestHit = "ShadowClosestHit";
-
-	const char* kEntryPointMiss1 = "IndirectMiss";
-	const char* kEntryIndirectAnyHit = "IndirectAnyHit";
-	const char* kEntryIndirectClosestHit = "IndirectClosestHit";
 };
 
-SampleLightGridPass::SampleLightGridPass(const std::string& outBuf)
-	: mOutChannel(outBuf), ::RenderPass("Sample Light Grid Pass", "Sample Light Grid Pass Options")
+SampleLightGridPass::SampleLightGridPass(const std::string& outBuf, const ReGIRGrid::SharedPtr& pGrid)
+	: mOutChannel(outBuf), mpGrid(pGrid), ::RenderPass("Sample Light Grid Pass", "Sample Light Grid Pass Options")
 {
 }
 
@@ -26,9 +22,8 @@ bool SampleLightGridPass::initialize(RenderContext* pRenderContext, ResourceMana
 	mpResManager = pResManager;
 
 	// Request texture resources for this pass (Note: We do not need a z-buffer since ray tracing does not generate one by default)
-	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse", "LightGrid"});
+	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse" });
 	mpResManager->requestTextureResource(mOutChannel);
-	mpResManager->requestTextureResource(ResourceManager::kEnvironmentMap);
 
 	// Set the default scene
 	mpResManager->setDefaultSceneName("Scenes/pink_room/pink_room.fscene");
@@ -40,18 +35,20 @@ bool SampleLightGridPass::initialize(RenderContext* pRenderContext, ResourceMana
 	mpRays->addMissShader(kFileRayTrace, kEntryPointMiss0);
 	mpRays->addHitShader(kFileRayTrace, kEntryShadowClosestHit, kEntryShadowAnyHit);
 
-	// Ray type 1 (indirect GI rays)
-	mpRays->addMissShader(kFileRayTrace, kEntryPointMiss1);
-	mpRays->addHitShader(kFileRayTrace, kEntryIndirectClosestHit, kEntryIndirectAnyHit);
-	
 	// Compile
 	mpRays->compileRayProgram();
-	mpRays->setMaxRecursionDepth(uint32_t(mMaxRayDepth));
 	if (mpScene) mpRays->setScene(mpScene);
 
 	return true;
 }
 
+bool SampleLightGridPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	usage.reads = { "WorldPosition", "WorldNormal", "MaterialDiffuse" };
+	usage.writes = { mOutChannel };
+	return true;
+}
+
 void SampleLightGridPass::initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene)
 {
 	// Save copy of scene
@@ -68,10 +65,8 @@ void SampleLightGridPass::initScene(RenderContext* pRenderContext, Scene::Shared
 void SampleLightGridPass::renderGui(Gui* pGui)
 {
 	int dirty = 0;
-	// User-controlled max depth
-	dirty |= (int)pGui->addIntVar("Max Ray Depth", mRayDepth, 0, mMaxRayDepth);
-	// Checkbox to determine if we are shooting indirect rays or not
-	//dirty |= (int)pGui->addCheckBox(mDoIndirectLighting ? "Enable Direct Illumination" : "Enable Indirect Illumination", mDoIndirectLighting);
+	dirty |= (int)pGui->addIntVar("Light Samples", mLightSamples, 1, 64);
+	dirty |= (int)pGui->addCheckBox("Jitter Cell Lookup", mJitterCell);
 	if (dirty) setRefreshFlag();
 }
 
@@ -81,31 +76,31 @@ void SampleLightGridPass::execute(RenderContext* pRenderContext)
 	Texture::SharedPtr outTex = mpResManager->getClearedTexture(mOutChannel, vec4(0.f, 0.f, 0.f, 0.f));
 
 	// Check that pass is ready to render
-	if (!outTex || !mpRays || !mpRays->readyToRender()) return;
+	if (!outTex || !mpGrid || !mpRays || !mpRays->readyToRender()) return;
 
-	// Pass background color to miss shader #0
 	auto globalVars = mpRays->getGlobalVars();
 	globalVars["GlobalCB"]["gMinT"] = mpResManager->getMinTDist();
 	globalVars["GlobalCB"]["gFrameCount"] = mFrameCount++;
-	globalVars["GlobalCB"]["gDoIndirectLighting"] = mDoIndirectLighting;
-	globalVars["GlobalCB"]["gDoDirectLighting"] = mDoDirectLighting;
-	globalVars["GlobalCB"]["gMaxDepth"] = mRayDepth;
-	globalVars["GlobalCB"]["gEmitMult"] = 1.0f;
+	globalVars["GlobalCB"]["gLightSamples"] = mLightSamples;
+	globalVars["GlobalCB"]["gJitterCell"] = mJitterCell;
+
+	// Grid layout (must match what BuildCellReservoirsPass used this frame)
+	globalVars["GlobalCB"]["gGridOrigin"] = mpGrid->getOrigin();
+	globalVars["GlobalCB"]["gGridCellSize"] = mpGrid->getCellSize();
+	globalVars["GlobalCB"]["gGridCellCount"] = ivec3(mpGrid->getCellCount());
+	globalVars["GlobalCB"]["gGridLightsPerCell"] = mpGrid->getLightsPerCell();
 	
 	// Pass G-Buffer textures to shader
 	globalVars["gPos"]        = mpResManager->getTexture("WorldPosition");
 	globalVars["gNorm"]       = mpResManager->getTexture("WorldNormal");
 	globalVars["gDiffuseMtl"] = mpResManager->getTexture("MaterialDiffuse");
-	globalVars["gEmissive"]   = mpResManager->getTexture("Emissive");
 
-	// Pass ReGIR grid structure for updating
-	globalVars["gLightGrid"]  = mpResManager->getTexture("LightGrid");
+	// Pass ReGIR grid structure for sampling
+	TypedBufferBase::SharedPtr pLightGrid = mpGrid->getBuffer();
+	globalVars["gLightGrid"]  = pLightGrid;
 
 	globalVars["gOutput"]     = outTex;
 
-	// Set environment map texture for indirect illumination
-	globalVars["gEnvMap"] = mpResManager->getTexture(ResourceManager::kEnvironmentMap);
-
 	// Launch ray tracing
 	mpRays->execute(pRenderContext, mpResManager->getScreenSize());
-}
\ No newline at end of file
+}
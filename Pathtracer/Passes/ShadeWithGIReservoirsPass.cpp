@@ -0,0 +1,91 @@
+#include "ShadeWithGIReservoirsPass.h"
+
+namespace {
+	const char* kFileRayTrace = "Shaders\\shadeWithGIReservoirs.hlsl";
+
+	// Function names for shader entry points
+	const char* kEntryPointRayGen = "ShadeWithGIReservoirsRayGen";
+
+	const char* kEntryPointMiss0 = "ShadowMiss";
+	const char* kEntryShadowAnyHit = "ShadowAnyHit";
+	const char* kEntryShadowClosestHit = "ShadowClosestHit";
+};
+
+ShadeWithGIReservoirsPass::ShadeWithGIReservoirsPass(const ReservoirStore::SharedPtr& pReservoirs) :
+	mpReservoirs(pReservoirs),
+	::RenderPass("Shade With GI Reservoirs Pass", "Shade With GI Reservoirs Options")
+{
+}
+
+bool ShadeWithGIReservoirsPass::initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager)
+{
+	// Stash a copy of our resource manager, allowing us to access shared rendering resources
+	mpResManager = pResManager;
+
+	// Request texture resources for this pass
+	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse", "ShadedOutput" });
+
+	// Set the default scene
+	mpResManager->setDefaultSceneName("Scenes/pink_room/pink_room.fscene");
+
+	// Create wrapper around ray tracing pass (we trace no rays, but a program needs a ray type)
+	mpRays = RayLaunch::create(kFileRayTrace, kEntryPointRayGen);
+	mpRays->addMissShader(kFileRayTrace, kEntryPointMiss0);
+	mpRays->addHitShader(kFileRayTrace, kEntryShadowClosestHit, kEntryShadowAnyHit);
+
+	// Compile
+	mpRays->compileRayProgram();
+	mpRays->setMaxRecursionDepth(1u);
+	if (mpScene) mpRays->setScene(mpScene);
+
+	return true;
+}
+
+bool ShadeWithGIReservoirsPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	// Adds to the direct lighting already in ShadedOutput
+	usage.reads = { "WorldPosition", "WorldNormal", "MaterialDiffuse", "ShadedOutput" };
+	usage.writes = { "ShadedOutput" };
+	return true;
+}
+
+void ShadeWithGIReservoirsPass::initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene)
+{
+	// Save copy of scene
+	if (pScene) {
+		mpScene = std::dynamic_pointer_cast<RtScene>(pScene);
+	}
+
+	// Pass scene to ray tracer
+	if (mpRays) {
+		mpRays->setScene(mpScene);
+	}
+}
+
+void ShadeWithGIReservoirsPass::renderGui(Gui* pGui)
+{
+	int dirty = 0;
+	dirty |= (int)pGui->addCheckBox(mDoIndirectLighting ? "Hide Indirect Lighting" : "Show Indirect Lighting", mDoIndirectLighting);
+	if (dirty) setRefreshFlag();
+}
+
+void ShadeWithGIReservoirsPass::execute(RenderContext* pRenderContext)
+{
+	// Check that pass is ready to render
+	if (!mpRays || !mpRays->readyToRender()) return;
+
+	auto globalVars = mpRays->getGlobalVars();
+	globalVars["GlobalCB"]["gDoIndirectLighting"] = mDoIndirectLighting;
+
+	// Pass G-Buffer textures to shader
+	globalVars["gPos"]        = mpResManager->getTexture("WorldPosition");
+	globalVars["gNorm"]       = mpResManager->getTexture("WorldNormal");
+	globalVars["gDiffuseMtl"] = mpResManager->getTexture("MaterialDiffuse");
+	globalVars["gShadedOutput"] = mpResManager->getTexture("ShadedOutput");
+
+	mpReservoirs->setIntoVars(globalVars, { ReservoirStore::GIBufferId::CurrGIReservoirs, ReservoirStore::GIBufferId::SpatialGIReservoirs,
+		ReservoirStore::GIBufferId::PrevGIReservoirs }, mpResManager->getScreenSize());
+
+	// Launch ray tracing
+	mpRays->execute(pRenderContext, mpResManager->getScreenSize());
+}
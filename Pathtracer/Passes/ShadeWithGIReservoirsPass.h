@@ -0,0 +1,41 @@
+#pragma once
+
+#include "../SharedUtils/RenderPass.h"
+#include "../SharedUtils/RayLaunch.h"
+#include "ReservoirStore.h"
+
+// ReSTIR GI, stage 3 (shadeWithGIReservoirs.hlsl):  adds the indirect lighting of each pixel's final GI reservoir to
+//     "ShadedOutput", after ShadeWithReservoirsPass wrote the direct lighting there, and keeps this frame's temporal
+//     reservoirs for the next one.
+class ShadeWithGIReservoirsPass : public ::RenderPass, inherit_shared_from_this<::RenderPass, ShadeWithGIReservoirsPass>
+{
+public:
+	using SharedPtr = std::shared_ptr<ShadeWithGIReservoirsPass>;
+	using SharedConstPtr = std::shared_ptr<const ShadeWithGIReservoirsPass>;
+
+	static SharedPtr create(const ReservoirStore::SharedPtr& pReservoirs) { return SharedPtr(new ShadeWithGIReservoirsPass(pReservoirs)); }
+	virtual ~ShadeWithGIReservoirsPass() = default;
+
+protected:
+	ShadeWithGIReservoirsPass(const ReservoirStore::SharedPtr& pReservoirs);
+
+	// RenderPass functionality
+	bool initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager) override;
+	void initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene) override;
+	void renderGui(Gui* pGui) override;
+	void execute(RenderContext* pRenderContext) override;
+
+	// Override default RenderPass functionality (that control the rendering pipeline and its GUI)
+	bool requiresScene() override { return true; }       // Adds 'load scene' option to GUI.
+	bool usesRayTracing() override { return true; }      // Removes a GUI control that is confusing for this simple demo
+	bool usesReSTIRGI() override { return true; }        // Adds the 'ReSTIR GI' toggle
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
+
+	// Internal state variables for this pass
+	RayLaunch::SharedPtr          mpRays;              ///< Wrapper around DXR pass
+	RtScene::SharedPtr            mpScene;             ///< Falcor scene representation, with additions for ray tracing
+	ReservoirStore::SharedPtr     mpReservoirs;        ///< GI reservoirs, shared with the GI sampling and spatial reuse passes
+
+	// User controls
+	bool                          mDoIndirectLighting = true;
+};
@@ -15,8 +15,11 @@ namespace {
 	const char* kEntryIndirectClosestHit = "IndirectClosestHit";
 };
 
-ShadeWithReservoirsPass::ShadeWithReservoirsPass(const std::string& outBuf, const RenderParams& params) : 
+ShadeWithReservoirsPass::ShadeWithReservoirsPass(const std::string& outBuf, const RenderParams& params, const ReservoirStore::SharedPtr& pReservoirs, const EnvMapSampler::SharedPtr& pEnvSampler, const EmissiveLights::SharedPtr& pEmissiveLights) : 
 	mOutChannel(outBuf), 
+	mpReservoirs(pReservoirs),
+	mpEnvSampler(pEnvSampler),
+	mpEmissiveLights(pEmissiveLights),
 	mEnableReSTIR(params.mEnableReSTIR),
 	::RenderPass("Shade With Reservoirs Pass", "Shade With Reservoirs Options")
 {
@@ -28,7 +31,7 @@ bool ShadeWithReservoirsPass::initialize(RenderContext* pRenderContext, Resource
 	mpResManager = pResManager;
 
 	// Request texture resources for this pass (Note: We do not need a z-buffer since ray tracing does not generate one by default)
-	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse", "CurrReservoirs", "PrevReservoirs", "ShadedOutput"});
+	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse", "SpatialReservoirs", "ShadedOutput"});
 	mpResManager->requestTextureResource(mOutChannel);
 	mpResManager->requestTextureResource(ResourceManager::kEnvironmentMap);
 
@@ -46,7 +49,8 @@ bool ShadeWithReservoirsPass::initialize(RenderContext* pRenderContext, Resource
 	mpRays->addMissShader(kFileRayTrace, kEntryPointMiss1);
 	mpRays->addHitShader(kFileRayTrace, kEntryIndirectClosestHit, kEntryIndirectAnyHit);
 	
-	// Compile
+	// Compile (for the number of reservoirs per pixel we keep)
+	mpReservoirs->addDefines(mpRays);
 	mpRays->compileRayProgram();
 	mpRays->setMaxRecursionDepth(uint32_t(mMaxRayDepth));
 	if (mpScene) mpRays->setScene(mpScene);
@@ -54,6 +58,13 @@ bool ShadeWithReservoirsPass::initialize(RenderContext* pRenderContext, Resource
 	return true;
 }
 
+bool ShadeWithReservoirsPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	usage.reads = { "WorldPosition", "WorldNormal", "MaterialDiffuse", "Emissive", "SpatialReservoirs" };
+	usage.writes = { "ShadedOutput", mOutChannel };
+	return true;
+}
+
 void ShadeWithReservoirsPass::initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene)
 {
 	// Save copy of scene
@@ -101,13 +112,15 @@ void ShadeWithReservoirsPass::execute(RenderContext* pRenderContext)
 
 	// Pass ReGIR grid structure for updating
 	globalVars["gSpatialReservoirs"]  = mpResManager->getTexture("SpatialReservoirs");
-	globalVars["gPrevReservoirs"]	  = mpResManager->getTexture("PrevReservoirs");
+	mpReservoirs->setIntoVars(globalVars, { ReservoirStore::BufferId::SpatialReservoirs, ReservoirStore::BufferId::PrevReservoirs }, mpResManager->getScreenSize());
 	globalVars["gShadedOutput"] = mpResManager->getTexture("ShadedOutput");
 
 	//globalVars["gOutput"]     = outTex;
 
-	// Set environment map texture for indirect illumination
+	// Set environment map texture for indirect illumination, and its cells for the reservoirs that picked one
 	globalVars["gEnvMap"] = mpResManager->getTexture(ResourceManager::kEnvironmentMap);
+	mpEnvSampler->setIntoVars(globalVars);
+	mpEmissiveLights->setIntoVars(globalVars);
 
 	// Launch ray tracing
 	mpRays->execute(pRenderContext, mpResManager->getScreenSize());
@@ -2,6 +2,9 @@
 
 #include "../SharedUtils/RenderPass.h"
 #include "../SharedUtils/RayLaunch.h"
+#include "ReservoirStore.h"
+#include "EnvMapSampler.h"
+#include "EmissiveLights.h"
 
 class ShadeWithReservoirsPass : public ::RenderPass, inherit_shared_from_this<::RenderPass, ShadeWithReservoirsPass>
 {
@@ -9,11 +12,11 @@ public:
 	using SharedPtr = std::shared_ptr<ShadeWithReservoirsPass>;
 	using SharedConstPtr = std::shared_ptr<const ShadeWithReservoirsPass>;
 
-	static SharedPtr create(const std::string &outBuf, const RenderParams& params) { return SharedPtr(new ShadeWithReservoirsPass(outBuf, params)); }
+	static SharedPtr create(const std::string &outBuf, const RenderParams& params, const ReservoirStore::SharedPtr& pReservoirs, const EnvMapSampler::SharedPtr& pEnvSampler, const EmissiveLights::SharedPtr& pEmissiveLights) { return SharedPtr(new ShadeWithReservoirsPass(outBuf, params, pReservoirs, pEnvSampler, pEmissiveLights)); }
 	virtual ~ShadeWithReservoirsPass() = default;
 
 protected:
-	ShadeWithReservoirsPass(const std::string& outBuf, const RenderParams& params);
+	ShadeWithReservoirsPass(const std::string& outBuf, const RenderParams& params, const ReservoirStore::SharedPtr& pReservoirs, const EnvMapSampler::SharedPtr& pEnvSampler, const EmissiveLights::SharedPtr& pEmissiveLights);
 
 	// RenderPass functionality
 	bool initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager) override;
@@ -25,10 +28,14 @@ protected:
 	bool requiresScene() override { return true; }       // Adds 'load scene' option to GUI.
 	bool usesRayTracing() override { return true; }      // Removes a GUI control that is confusing for this simple demo
 	bool usesEnvironmentMap() override { return true; }  // Use environment map to illuminate the scene
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
 
 	// Internal state variables for this pass
 	RayLaunch::SharedPtr          mpRays;              ///< Wrapper around DXR pass
 	RtScene::SharedPtr            mpScene;             ///< Falcor scene representation, with additions for ray tracing
+	ReservoirStore::SharedPtr     mpReservoirs;        ///< Per-pixel reservoirs, shared with the light sampling and spatial reuse passes
+	EnvMapSampler::SharedPtr      mpEnvSampler;        ///< Environment map cells the reservoirs may hold, shared with the light sampling pass
+	EmissiveLights::SharedPtr     mpEmissiveLights;    ///< Emissive triangles the reservoirs may hold, shared with the light sampling pass
 
 	// Output buffer
 	std::string                   mOutChannel;
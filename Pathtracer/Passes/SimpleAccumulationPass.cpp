@@ -17,6 +17,7 @@
 **********************************************************************************************************************/
 
 #include "SimpleAccumulationPass.h"
+#include "../Shaders/AdaptiveSampling.h"
 
 namespace {
 	const char* kAccumShader = "Shaders\\accumulation.ps.hlsl";
@@ -40,6 +41,7 @@ bool SimpleAccumulationPass::initialize(RenderContext* pRenderContext, ResourceM
 
 	// Request texture resources for this pass (Note: We do not need a z-buffer since ray tracing does not generate one by default)
 	mpResManager->requestTextureResource(mAccumChannel);
+	mpResManager->requestTextureResource(ADAPTIVE_SAMPLE_COUNT_CHANNEL);
 
 	// Set the default scene
 	mpResManager->setDefaultSceneName("Scenes/pink_room/pink_room.fscene");
@@ -50,6 +52,15 @@ bool SimpleAccumulationPass::initialize(RenderContext* pRenderContext, ResourceM
 	return true;
 }
 
+bool SimpleAccumulationPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	// The sample budget we write is read by ray generation, before us, next frame
+	usage.reads = { mAccumChannel, "MotionVectors", "WorldNormal", "PrevWorldNormal" };
+	usage.writes = { mAccumChannel, ADAPTIVE_SAMPLE_COUNT_CHANNEL };
+	usage.persistent = { ADAPTIVE_SAMPLE_COUNT_CHANNEL };
+	return true;
+}
+
 void SimpleAccumulationPass::initScene(RenderContext* pRenderContext, Scene::SharedPtr pScene)
 {
 	// Reset accumulation when loading new scene
@@ -70,7 +81,8 @@ void SimpleAccumulationPass::initScene(RenderContext* pRenderContext, Scene::Sha
 void SimpleAccumulationPass::resize(uint32_t width, uint32_t height)
 {
 	mpLastFrame = Texture::create2D(width, height, ResourceFormat::RGBA32Float, 1, 1, nullptr, ResourceManager::kDefaultFlags);
-	mpInternalFbo = ResourceManager::createFbo(width, height, ResourceFormat::RGBA32Float);
+	mpLastCount = Texture::create2D(width, height, ResourceFormat::RGBA32Float, 1, 1, nullptr, ResourceManager::kDefaultFlags);
+	mpInternalFbo = ResourceManager::createFbo(width, height, { ResourceFormat::RGBA32Float, ResourceFormat::RGBA32Float, ResourceFormat::RGBA32Float });
 	mpGfxState->setFbo(mpInternalFbo);
 	mAccumCount = 0;
 }
@@ -88,6 +100,30 @@ void SimpleAccumulationPass::renderGui(Gui* pGui)
 		setRefreshFlag();
 	}
 
+	// Keep per-pixel history through camera and object motion (needs the G-buffer pass's motion vectors)
+	if (pGui->addCheckBox("Reproject on motion", mDoReprojection))
+	{
+		mAccumCount = 0;
+		setRefreshFlag();
+	}
+	if (mDoReprojection)
+	{
+		pGui->addIntVar("History while moving", mMaxMovingHistory, 1, 256);
+	}
+
+	// Spend samples where the relative error is still above the threshold (while the camera stands still)
+	if (pGui->addCheckBox("Adaptive sampling", mDoAdaptive))
+	{
+		mAccumCount = 0;
+		setRefreshFlag();
+	}
+	if (mDoAdaptive)
+	{
+		pGui->addFloatVar("Target relative error", mErrorThreshold, 0.001f, 0.5f, 0.001f);
+		pGui->addIntVar("Min samples per pixel", mMinSamples, 2, 1024);
+		pGui->addIntVar("Max samples per frame", mMaxSamples, 1, 64);
+	}
+
 	// Display count of accumulated frame
 	pGui->addText("");
 	pGui->addText((std::string("Frame Count: ") + std::to_string(mAccumCount)).c_str());
@@ -108,20 +144,49 @@ void SimpleAccumulationPass::execute(RenderContext* pRenderContext)
 	// Texture to accumulate
 	Texture::SharedPtr inTex = mpResManager->getTexture(mAccumChannel);
 
-	// Check that pass is ready to render
-	if (!inTex || !mDoAccumulation) return;
+	// Without accumulation, nothing budgets samples, so ray generation takes one per pixel
+	vec4 noBudget = vec4(0.f);
+	if (!inTex || !mDoAccumulation)
+	{
+		mpResManager->getClearedTexture(ADAPTIVE_SAMPLE_COUNT_CHANNEL, noBudget);
+		return;
+	}
 
-	if (hasCameraMoved())
+	// Reprojecting needs last frame's G-buffer and the motion vectors into it
+	Texture::SharedPtr motionTex = mpResManager->getTexture("MotionVectors");
+	Texture::SharedPtr normTex = mpResManager->getTexture("WorldNormal");
+	Texture::SharedPtr prevNormTex = mpResManager->getTexture("PrevWorldNormal");
+	bool reproject = mDoReprojection && motionTex && normTex && prevNormTex;
+
+	// Without reprojection, any camera motion throws away the history.  With it, the history follows the motion,
+	//     but we keep less of it while moving, so that lighting that changes with the view catches up quickly.
+	uint32_t maxHistory = 0xFFFFFFFFu;
+	bool cameraMoved = hasCameraMoved();
+	if (cameraMoved)
 	{
-		mAccumCount = 0;
+		if (reproject) maxHistory = uint32_t(mMaxMovingHistory);
+		else mAccumCount = 0;
 		mpLastCameraMatrix = mpScene->getActiveCamera()->getViewMatrix();
 	}
 
 	// Set ray tracing shader variables for ray generation shader
 	auto accumVars = mpAccumShader->getVars();
 	accumVars["PerFrameCB"]["gAccumCount"] = mAccumCount++;
+	accumVars["PerFrameCB"]["gReproject"] = reproject;
+	accumVars["PerFrameCB"]["gMaxHistory"] = maxHistory;
+	accumVars["PerFrameCB"]["gAdaptive"] = mDoAdaptive && !cameraMoved;   // Ray generation takes one sample per pixel while moving, too
+	accumVars["PerFrameCB"]["gErrorThreshold"] = mErrorThreshold;
+	accumVars["PerFrameCB"]["gMinSamples"] = float(mMinSamples);
+	accumVars["PerFrameCB"]["gMaxSamples"] = float(mMaxSamples);
 	accumVars["gLastFrame"] = mpLastFrame;
 	accumVars["gCurFrame"] = inTex;
+	accumVars["gLastCount"] = mpLastCount;
+	if (reproject)
+	{
+		accumVars["gMotion"] = motionTex;
+		accumVars["gNorm"] = normTex;
+		accumVars["gPrevNorm"] = prevNormTex;
+	}
 
 	// Execute shader
 	mpAccumShader->execute(pRenderContext, mpGfxState);
@@ -131,6 +196,11 @@ void SimpleAccumulationPass::execute(RenderContext* pRenderContext)
 
 	// Keep copy of accumulation to use next frame
 	pRenderContext->blit(mpInternalFbo->getColorTexture(0)->getSRV(), mpLastFrame->getRTV());
+	pRenderContext->blit(mpInternalFbo->getColorTexture(1)->getSRV(), mpLastCount->getRTV());
+
+	// Next frame's sample budget
+	Texture::SharedPtr sampleCountTex = mpResManager->getTexture(ADAPTIVE_SAMPLE_COUNT_CHANNEL);
+	if (sampleCountTex) pRenderContext->blit(mpInternalFbo->getColorTexture(2)->getSRV(), sampleCountTex->getRTV());
 }
 
 void SimpleAccumulationPass::stateRefreshed()
@@ -42,6 +42,7 @@ protected:
 
 	// Override default RenderPass functionality (that control the rendering pipeline and its GUI)
 	bool appliesPostprocess() override { return true; }      // Adds 'load scene' option to GUI.
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
 	bool hasCameraMoved();  // Determine if there has been any camera motion.
 
 	// Texture we're accumulating in
@@ -55,6 +56,17 @@ protected:
 	Texture::SharedPtr            mpLastFrame;            ///< Radius for ambient occlusion rays (only examine nearby geometry determined by this radius)          
 	uint32_t                      mAccumCount = 0;        ///< Frame count to use as seed for random number generator
 	bool                          mDoAccumulation = true; ///< Is accumulation enabled
+	bool                          mDoReprojection = true; ///< Follow motion vectors instead of restarting when the camera moves
+	int32_t                       mMaxMovingHistory = 8;  ///< Most frames each pixel keeps while the camera moves (when reprojecting)
+	Texture::SharedPtr            mpLastCount;            ///< Samples accumulated in each pixel of mpLastFrame, and their statistics (see AdaptiveSampling.h)
+
+	// Adaptive sampling:  we budget each pixel's samples for the next frame in the "AdaptiveSampleCount" channel, which
+	//     ray generation passes that support it (FullGlobalIlluminationPass) follow, and write the count they took in alpha.
+	//     Its w is the pixel's samples so far, where they continue in the pixel's sample sequences (see SampleSequences.h)
+	bool                          mDoAdaptive = false;    ///< Budget samples by each pixel's relative error
+	float                         mErrorThreshold = 0.02f;   ///< Relative standard error below which a pixel is converged
+	int32_t                       mMinSamples = 16;       ///< Samples each pixel takes before it may converge
+	int32_t                       mMaxSamples = 4;        ///< Most samples a pixel takes in one frame
 	Scene::SharedPtr              mpScene;                ///< Number of ambient occlusion rays to shoot per pixel
 	mat4                          mpLastCameraMatrix;     ///< The last camera matrix 
 	Fbo::SharedPtr                mpInternalFbo;          ///< Temp framebuffer
@@ -45,6 +45,13 @@ bool SimpleToneMappingPass::initialize(RenderContext* pRenderContext, ResourceMa
 	return true;
 }
 
+bool SimpleToneMappingPass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	usage.reads = { mInChannel };
+	usage.writes = { mOutChannel };
+	return true;
+}
+
 void SimpleToneMappingPass::renderGui(Gui* pGui)
 {
 	// Use Falcor tone mapper's UI
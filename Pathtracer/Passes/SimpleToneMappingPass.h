@@ -39,6 +39,7 @@ protected:
 
 	// Override default RenderPass functionality (that control the rendering pipeline and its GUI)
 	bool appliesPostprocess() override { return true; }
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
 
 	// Internal state variables for this pass
 	std::string                       mInChannel;          ///< Input texture
@@ -11,8 +11,11 @@ namespace {
 	const char* kEntryShadowClosestHit = "ShadowClosestHit";
 };
 
-SpatialReusePass::SpatialReusePass(const std::string& outBuf, const int iter, const int totalIter) :
+SpatialReusePass::SpatialReusePass(const std::string& outBuf, const int iter, const int totalIter, const ReservoirStore::SharedPtr& pReservoirs, const EnvMapSampler::SharedPtr& pEnvSampler, const EmissiveLights::SharedPtr& pEmissiveLights) :
 	mOutChannel(outBuf), 
+	mpReservoirs(pReservoirs),
+	mpEnvSampler(pEnvSampler),
+	mpEmissiveLights(pEmissiveLights),
 	mIter(iter),
 	mTotalIter(totalIter),
 	::RenderPass("Spatial Reuse Pass", "Spatial Reuse Options")
@@ -25,10 +28,13 @@ bool SpatialReusePass::initialize(RenderContext* pRenderContext, ResourceManager
 	mpResManager = pResManager;
 
 	// Request texture resources for this pass (Note: We do not need a z-buffer since ray tracing does not generate one by default)
-	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse", "CurrReservoirs"
-		, "SpatialReservoirsIn", "SpatialReservoirsOut", "SpatialReservoirs"});
-	mpResManager->requestTextureResource(mOutChannel);
-	mpResManager->requestTextureResource(ResourceManager::kEnvironmentMap);
+	mpResManager->requestTextureResources({ "WorldPosition", "WorldNormal", "MaterialDiffuse", "SpatialReservoirs"});
+	mOutIndex = mpResManager->requestTextureResource(mOutChannel);
+	mEnvMapIndex = mpResManager->requestTextureResource(ResourceManager::kEnvironmentMap);
+	mPosIndex = mpResManager->getTextureIndex("WorldPosition");
+	mNormIndex = mpResManager->getTextureIndex("WorldNormal");
+	mDiffuseMtlIndex = mpResManager->getTextureIndex("MaterialDiffuse");
+	mSpatialReservoirsIndex = mpResManager->getTextureIndex("SpatialReservoirs");
 
 	// Set the default scene
 	mpResManager->setDefaultSceneName("Scenes/pink_room/pink_room.fscene");
@@ -40,11 +46,21 @@ bool SpatialReusePass::initialize(RenderContext* pRenderContext, ResourceManager
 	mpRays->addMissShader(kFileRayTrace, kEntryPointMiss0);
 	mpRays->addHitShader(kFileRayTrace, kEntryShadowClosestHit, kEntryShadowAnyHit);
 	
-	// Compile
+	// Compile (for the number of reservoirs per pixel we keep)
+	mpReservoirs->addDefines(mpRays);
 	mpRays->compileRayProgram();
 	mpRays->setMaxRecursionDepth(uint32_t(mMaxRayDepth));
 	if (mpScene) mpRays->setScene(mpScene);
 
+	mpSampleGenerator = SampleGenerator::create();
+
+	return true;
+}
+
+bool SpatialReusePass::describeChannelUsage(ResourceManager::ChannelUsage &usage)
+{
+	usage.reads = { "WorldPosition", "WorldNormal", "MaterialDiffuse" };
+	usage.writes = { "SpatialReservoirs", mOutChannel };
 	return true;
 }
 
@@ -67,43 +83,146 @@ void SpatialReusePass::renderGui(Gui* pGui)
 	// Enable/disable different passes
 	dirty |= (int)pGui->addIntVar("Spatial Neighbors", mSpatialNeighbors, 0, 100);
 	dirty |= (int)pGui->addIntVar("Spatial Radius", mSpatialRadius, 0, 100);
+	dirty |= (int)mpSampleGenerator->renderGui(pGui);
 	if (dirty) setRefreshFlag();
+
+	if (pGui->addButton("Benchmark binding")) {
+		mBindingBenchmark = benchmarkBinding();
+		logBenchmark(mBindingBenchmark);
+	}
+	if (mBindingBenchmark.frames > 0) {
+		pGui->addText(("  By name: " + std::to_string(mBindingBenchmark.byNameUs) + " us/frame, resolved: " +
+			std::to_string(mBindingBenchmark.resolvedUs) + " us/frame").c_str());
+	}
+}
+
+SpatialReusePass::BindingBenchmark SpatialReusePass::benchmarkBinding(uint32_t frames)
+{
+	BindingBenchmark result;
+	if (!mpRays || !mpRays->readyToRender() || frames == 0) return result;
+	SimpleVars::SharedPtr globalVars = mpRays->getGlobalVars();
+	SpatialReuseParams params = getParams();
+	result.frames = frames;
+
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+	mBindings.varsId = 0;
+	resolveBindings(globalVars);
+	result.resolveUs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()) * 1e3);
+
+	start = CpuTimer::getCurrentTimePoint();
+	for (uint32_t frame = 0; frame < frames; frame++)
+	{
+		params.frameCount = frame;
+		bindByName(globalVars, params);
+	}
+	result.byNameUs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()) * 1e3 / double(frames));
+
+	// Same work as execute():  the channel lookups are by index, and the mask and env map are bound through their handles
+	start = CpuTimer::getCurrentTimePoint();
+	for (uint32_t frame = 0; frame < frames; frame++)
+	{
+		params.frameCount = frame;
+		resolveBindings(globalVars);
+		globalVars->setConstants(mBindings.params, params);
+		globalVars->setResource(mBindings.pos, mpResManager->getTexture(mPosIndex));
+		globalVars->setResource(mBindings.norm, mpResManager->getTexture(mNormIndex));
+		globalVars->setResource(mBindings.diffuseMtl, mpResManager->getTexture(mDiffuseMtlIndex));
+		globalVars->setResource(mBindings.spatialReservoirs, mpResManager->getTexture(mSpatialReservoirsIndex));
+		globalVars->setResource(mBindings.envMap, mpResManager->getTexture(mEnvMapIndex));
+		globalVars->setResource(mBindings.blueNoiseMask, mpSampleGenerator->getBlueNoiseTexture());
+	}
+	result.resolvedUs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()) * 1e3 / double(frames));
+	return result;
+}
+
+void SpatialReusePass::logBenchmark(const BindingBenchmark& bench)
+{
+	logInfo("Spatial reuse binding, " + std::to_string(bench.frames) + " frames:  by name " + std::to_string(bench.byNameUs) +
+		" us/frame, resolved " + std::to_string(bench.resolvedUs) + " us/frame (" +
+		std::to_string(bench.byNameUs / std::max(bench.resolvedUs, 1e-6f)) + "x), resolving once " + std::to_string(bench.resolveUs) + " us");
+}
+
+SpatialReuseParams SpatialReusePass::getParams() const
+{
+	SpatialReuseParams params;
+	params.minT = mpResManager->getMinTDist();
+	params.frameCount = mFrameCount;
+	params.maxDepth = uint32_t(mRayDepth);
+	params.samplerType = uint32_t(mpSampleGenerator->getType());
+	params.spatialNeighbors = uint32_t(mSpatialNeighbors);
+	params.spatialRadius = uint32_t(mSpatialRadius);
+	params.iter = uint32_t(mIter);
+	params.totalIter = uint32_t(mTotalIter);
+	params.enableReSTIR = mpResManager->getWeightedRIS() ? 1u : 0u;
+	params.doSpatialReuse = mpResManager->getSpatial() ? 1u : 0u;
+	params.unbiased = mpResManager->getUnbiased() ? 1u : 0u;
+	params.unbiasedVisibility = mpResManager->getUnbiasedVisibility() ? 1u : 0u;
+	return params;
+}
+
+void SpatialReusePass::resolveBindings(SimpleVars::SharedPtr& pVars)
+{
+	if (mBindings.varsId == pVars->getId()) return;
+
+	mBindings.varsId = pVars->getId();
+	mBindings.params = pVars->resolveConstants("GlobalCB", "gParams", sizeof(SpatialReuseParams));
+	mBindings.pos = pVars->resolveResource("gPos");
+	mBindings.norm = pVars->resolveResource("gNorm");
+	mBindings.diffuseMtl = pVars->resolveResource("gDiffuseMtl");
+	mBindings.spatialReservoirs = pVars->resolveResource("gSpatialReservoirs");
+	mBindings.envMap = pVars->resolveResource("gEnvMap");
+	mBindings.blueNoiseMask = pVars->resolveResource("gBlueNoiseMask");
+}
+
+void SpatialReusePass::bindByName(SimpleVars::SharedPtr& pVars, const SpatialReuseParams& params)
+{
+	// Each member separately, as a cbuffer of loose variables would be set
+	pVars["GlobalCB"]["gParams.minT"] = params.minT;
+	pVars["GlobalCB"]["gParams.frameCount"] = params.frameCount;
+	pVars["GlobalCB"]["gParams.maxDepth"] = params.maxDepth;
+	pVars["GlobalCB"]["gParams.samplerType"] = params.samplerType;
+	pVars["GlobalCB"]["gParams.spatialNeighbors"] = params.spatialNeighbors;
+	pVars["GlobalCB"]["gParams.spatialRadius"] = params.spatialRadius;
+	pVars["GlobalCB"]["gParams.iter"] = params.iter;
+	pVars["GlobalCB"]["gParams.totalIter"] = params.totalIter;
+	pVars["GlobalCB"]["gParams.enableReSTIR"] = params.enableReSTIR;
+	pVars["GlobalCB"]["gParams.doSpatialReuse"] = params.doSpatialReuse;
+	pVars["GlobalCB"]["gParams.unbiased"] = params.unbiased;
+	pVars["GlobalCB"]["gParams.unbiasedVisibility"] = params.unbiasedVisibility;
+	pVars["gBlueNoiseMask"] = mpSampleGenerator->getBlueNoiseTexture();
+	pVars["gPos"] = mpResManager->getTexture("WorldPosition");
+	pVars["gNorm"] = mpResManager->getTexture("WorldNormal");
+	pVars["gDiffuseMtl"] = mpResManager->getTexture("MaterialDiffuse");
+	pVars["gSpatialReservoirs"] = mpResManager->getTexture("SpatialReservoirs");
+	pVars["gEnvMap"] = mpResManager->getTexture(ResourceManager::kEnvironmentMap);
 }
 
 void SpatialReusePass::execute(RenderContext* pRenderContext)
 {
 	// Get output buffer and clear it to black
-	Texture::SharedPtr outTex = mpResManager->getClearedTexture(mOutChannel, vec4(0.f, 0.f, 0.f, 0.f));
+	Texture::SharedPtr outTex = mpResManager->getClearedTexture(mOutIndex, vec4(0.f, 0.f, 0.f, 0.f));
 
 	// Check that pass is ready to render
 	if (!outTex || !mpRays || !mpRays->readyToRender()) return;
 
-	// Pass background color to miss shader #0
+	// Pass our constants in one copy, and the G-buffer, sampler mask and environment map through pre-resolved handles
 	auto globalVars = mpRays->getGlobalVars();
-	globalVars["GlobalCB"]["gMinT"] = mpResManager->getMinTDist();
-	globalVars["GlobalCB"]["gFrameCount"] = mFrameCount++;
-	globalVars["GlobalCB"]["gMaxDepth"] = mRayDepth;
-	globalVars["GlobalCB"]["gSpatialNeighbors"] = mSpatialNeighbors;
-	globalVars["GlobalCB"]["gSpatialRadius"] = mSpatialRadius;
-	globalVars["GlobalCB"]["gEnableReSTIR"] = mpResManager->getWeightedRIS();
-	globalVars["GlobalCB"]["gDoSpatialReuse"] = mpResManager->getSpatial();
-	globalVars["GlobalCB"]["gIter"] = mIter;
-	globalVars["GlobalCB"]["gTotalIter"] = mTotalIter;
-	
-	// Pass G-Buffer textures to shader
-	globalVars["gPos"]        = mpResManager->getTexture("WorldPosition");
-	globalVars["gNorm"]       = mpResManager->getTexture("WorldNormal");
-	globalVars["gDiffuseMtl"] = mpResManager->getTexture("MaterialDiffuse");
+	resolveBindings(globalVars);
+	globalVars->setConstants(mBindings.params, getParams());
+	mFrameCount++;
+	globalVars->setResource(mBindings.pos, mpResManager->getTexture(mPosIndex));
+	globalVars->setResource(mBindings.norm, mpResManager->getTexture(mNormIndex));
+	globalVars->setResource(mBindings.diffuseMtl, mpResManager->getTexture(mDiffuseMtlIndex));
+	globalVars->setResource(mBindings.blueNoiseMask, mpSampleGenerator->getBlueNoiseTexture());
 
 	// Pass ReGIR grid structure for updating
-	globalVars["gCurrReservoirs"]  = mpResManager->getTexture("CurrReservoirs");
-	globalVars["gSpatialReservoirsOut"] = mpResManager->getTexture("SpatialReservoirsOut");
-	globalVars["gSpatialReservoirs"]    = mpResManager->getTexture("SpatialReservoirs");
-
-	//globalVars["gOutput"]     = outTex;
+	globalVars->setResource(mBindings.spatialReservoirs, mpResManager->getTexture(mSpatialReservoirsIndex));
+	mpReservoirs->setIntoVars(globalVars, { ReservoirStore::BufferId::CurrReservoirs, ReservoirStore::BufferId::SpatialReservoirsOut, ReservoirStore::BufferId::SpatialReservoirs }, mpResManager->getScreenSize());
 
-	// Set environment map texture for indirect illumination
-	globalVars["gEnvMap"] = mpResManager->getTexture(ResourceManager::kEnvironmentMap);
+	// Set environment map texture for indirect illumination, and its cells for the reservoirs that picked one
+	globalVars->setResource(mBindings.envMap, mpResManager->getTexture(mEnvMapIndex));
+	mpEnvSampler->setIntoVars(globalVars);
+	mpEmissiveLights->setIntoVars(globalVars);
 
 	// Launch ray tracing
 	mpRays->execute(pRenderContext, mpResManager->getScreenSize());
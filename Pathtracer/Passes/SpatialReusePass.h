@@ -2,6 +2,11 @@
 
 #include "../SharedUtils/RenderPass.h"
 #include "../SharedUtils/RayLaunch.h"
+#include "ReservoirStore.h"
+#include "SampleGenerator.h"
+#include "EnvMapSampler.h"
+#include "EmissiveLights.h"
+#include "../Shaders/SpatialReuseParams.h"
 
 class SpatialReusePass : public ::RenderPass, inherit_shared_from_this<::RenderPass, SpatialReusePass>
 {
@@ -9,11 +14,24 @@ public:
 	using SharedPtr = std::shared_ptr<SpatialReusePass>;
 	using SharedConstPtr = std::shared_ptr<const SpatialReusePass>;
 
-	static SharedPtr create(const std::string &outBuf, const int iter, const int totalIter) { return SharedPtr(new SpatialReusePass(outBuf, iter, totalIter)); }
+	static SharedPtr create(const std::string &outBuf, const int iter, const int totalIter, const ReservoirStore::SharedPtr& pReservoirs, const EnvMapSampler::SharedPtr& pEnvSampler, const EmissiveLights::SharedPtr& pEmissiveLights) { return SharedPtr(new SpatialReusePass(outBuf, iter, totalIter, pReservoirs, pEnvSampler, pEmissiveLights)); }
 	virtual ~SpatialReusePass() = default;
 
+	// Result of benchmarkBinding()
+	struct BindingBenchmark
+	{
+		uint32_t frames = 0;
+		float    byNameUs = 0.f;       ///< CPU time to set the pass' constants and textures by name, per frame
+		float    resolvedUs = 0.f;     ///< Same, through the handles resolved by resolveBindings()
+		float    resolveUs = 0.f;      ///< Resolving the handles once
+	};
+
+	// Time <frames> frames' worth of this pass' bindings, by name and through handles, on its current program vars
+	BindingBenchmark benchmarkBinding(uint32_t frames = 10000);
+	static void logBenchmark(const BindingBenchmark& bench);
+
 protected:
-	SpatialReusePass(const std::string& outBuf, const int iter, const int totalIter);
+	SpatialReusePass(const std::string& outBuf, const int iter, const int totalIter, const ReservoirStore::SharedPtr& pReservoirs, const EnvMapSampler::SharedPtr& pEnvSampler, const EmissiveLights::SharedPtr& pEmissiveLights);
 
 	// RenderPass functionality
 	bool initialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager) override;
@@ -25,10 +43,47 @@ protected:
 	bool requiresScene() override { return true; }       // Adds 'load scene' option to GUI.
 	bool usesRayTracing() override { return true; }      // Removes a GUI control that is confusing for this simple demo
 	bool usesEnvironmentMap() override { return true; }  // Use environment map to illuminate the scene
+	bool describeChannelUsage(ResourceManager::ChannelUsage &usage) override;
+
+	// Constants for this frame's launch
+	SpatialReuseParams getParams() const;
+
+	// Resolve mBindings against <pVars>, unless they were resolved against it already
+	void resolveBindings(SimpleVars::SharedPtr& pVars);
+
+	// Set everything mBindings covers by name, as execute() did before the handles (for benchmarkBinding())
+	void bindByName(SimpleVars::SharedPtr& pVars, const SpatialReuseParams& params);
 
 	// Internal state variables for this pass
 	RayLaunch::SharedPtr          mpRays;              ///< Wrapper around DXR pass
 	RtScene::SharedPtr            mpScene;             ///< Falcor scene representation, with additions for ray tracing
+	ReservoirStore::SharedPtr     mpReservoirs;        ///< Per-pixel reservoirs, shared with the light sampling and shading passes
+	SampleGenerator::SharedPtr    mpSampleGenerator;   ///< Sequence behind the neighbor picks and the RIS decisions
+	EnvMapSampler::SharedPtr      mpEnvSampler;        ///< Environment map cells the reservoirs may hold, shared with the light sampling pass
+	EmissiveLights::SharedPtr     mpEmissiveLights;    ///< Emissive triangles the reservoirs may hold, shared with the light sampling pass
+
+	// Per-frame bindings, resolved once per set of program vars (see SimpleVars::resolveConstants())
+	struct Bindings
+	{
+		uint64_t                     varsId = 0;       ///< SimpleVars::getId() of the vars they were resolved against
+		SimpleVars::ConstantsHandle  params;           ///< GlobalCB's gParams
+		SimpleVars::ResourceHandle   pos;
+		SimpleVars::ResourceHandle   norm;
+		SimpleVars::ResourceHandle   diffuseMtl;
+		SimpleVars::ResourceHandle   spatialReservoirs;
+		SimpleVars::ResourceHandle   envMap;
+		SimpleVars::ResourceHandle   blueNoiseMask;
+	};
+	Bindings                      mBindings;
+
+	// Resource manager channels, looked up once
+	int32_t                       mPosIndex = -1;
+	int32_t                       mNormIndex = -1;
+	int32_t                       mDiffuseMtlIndex = -1;
+	int32_t                       mSpatialReservoirsIndex = -1;
+	int32_t                       mEnvMapIndex = -1;
+	int32_t                       mOutIndex = -1;
+	BindingBenchmark              mBindingBenchmark;
 
 	// Output buffer
 	std::string                   mOutChannel;
@@ -25,13 +25,112 @@
 #include "Passes/CreateLightSamplesPass.h"
 #include "Passes/SpatialReusePass.h"
 #include "Passes/ShadeWithReservoirsPass.h"
+#include "Passes/CreateGISamplesPass.h"
+#include "Passes/GISpatialReusePass.h"
+#include "Passes/ShadeWithGIReservoirsPass.h"
+#include "Passes/CpuReSTIRPass.h"
 #include "Passes/SimpleAccumulationPass.h"
 #include "Passes/SimpleToneMappingPass.h"
 #include "Passes/FullGlobalIlluminationPass.h"
 #include "Passes/DenoisingPass.h"
+#include "Passes/ExrOutputPass.h"
+#include "CpuRenderer/BatchRenderer.h"
+#include "Graphics/Model/Loaders/BinaryModelImporter.h"
+#include <algorithm>
+
+namespace {
+	// Split a command line into arguments at spaces and tabs.  Double quotes group an argument with spaces (e.g. a path),
+	//     and are dropped.
+	std::vector<std::string> splitCommandLine(const char* cmdLine)
+	{
+		std::vector<std::string> args;
+		std::string arg;
+		bool inArg = false, quoted = false;
+		for (const char* c = cmdLine; c && *c; c++)
+		{
+			if (*c == '"') {
+				quoted = !quoted;
+				inArg = true;
+			}
+			else if (!quoted && (*c == ' ' || *c == '\t')) {
+				if (inArg) args.push_back(arg);
+				arg.clear();
+				inArg = false;
+			}
+			else {
+				arg += *c;
+				inArg = true;
+			}
+		}
+		if (inArg) args.push_back(arg);
+		return args;
+	}
+};
 
 int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nShowCmd)
 {
+	// Flags match whole arguments (so -unbiased doesn't also match -unbiasedVisibility), and a flag's value is the next argument
+	const std::vector<std::string> args = splitCommandLine(lpCmdLine);
+	auto hasArg = [&](const char* flag) { return std::find(args.begin(), args.end(), flag) != args.end(); };
+	auto getArgValue = [&](const char* flag, std::string& value)
+	{
+		auto it = std::find(args.begin(), args.end(), flag);
+		if (it == args.end() || it + 1 == args.end()) return false;
+		value = *(it + 1);
+		return true;
+	};
+
+	// Headless batch rendering (-batch <job file>):  render the job's frames on the CPU and exit, without creating a window
+	std::string jobFile;
+	if (getArgValue("-batch", jobFile)) {
+		BatchRenderer::Job job;
+		BatchRenderer::SharedPtr pBatch = BatchRenderer::parseJob(jobFile, job) ? BatchRenderer::create(job) : nullptr;
+		return (pBatch && pBatch->render()) ? 0 : 1;
+	}
+
+	// Binary model load benchmark (-benchmarkBin <file.bin>):  compare parsing the mapped file with reading it through a stream, and exit
+	std::string modelFile;
+	if (getArgValue("-benchmarkBin", modelFile)) {
+		BinaryModelImporter::Benchmark result = BinaryModelImporter::benchmark(modelFile);
+		if (result.fileBytes == 0) return 1;
+		auto mb = [](uint64_t bytes) { return std::to_string(bytes / (1024 * 1024)) + " MB"; };
+		logInfo("BinaryModelImporter: " + modelFile + " (v" + std::to_string(result.version) + ", " + mb(result.fileBytes) + ", " + mb(result.copiedBytes) + " copied when mapped)\n" +
+			"    mapped:   " + std::to_string(result.mappedMs) + " ms, resident +" + mb(result.mappedResidentBytes) + ", peak +" + mb(result.mappedPeakBytes) + "\n" +
+			"    streamed: " + std::to_string(result.streamMs) + " ms, resident +" + mb(result.streamResidentBytes) + ", peak +" + mb(result.streamPeakBytes));
+		return 0;
+	}
+
+	// Environment map sampling benchmark (-benchmarkEnvMap):  build times for an 8K sky, and variance against cosine sampling, and exit
+	if (hasArg("-benchmarkEnvMap")) {
+		EnvMapSampler::logBenchmark(EnvMapSampler::benchmark());
+		return 0;
+	}
+
+	// Emissive triangle extraction benchmark (-benchmarkEmissive):  time and memory for a 4M-triangle emitter, and sampling checks, and exit
+	if (hasArg("-benchmarkEmissive")) {
+		EmissiveLights::logBenchmark(EmissiveLights::benchmark());
+		return 0;
+	}
+
+	// EXR writer benchmark (-benchmarkExr):  frames/s and compression ratio writing 4K G-buffer layers with each compression, and exit
+	if (hasArg("-benchmarkExr")) {
+		ExrWriter::logBenchmark(ExrWriter::benchmark());
+		return 0;
+	}
+
+	// Shader cache self-test (-testShaderCache):  hits, misses, corrupt entries and racing writers against a stub compiler, and exit
+	if (hasArg("-testShaderCache")) {
+		ShaderCache::SelfTest result = ShaderCache::runSelfTest();
+		logInfo(std::string("ShaderCache self-test ") + (result.passed ? "passed" : "FAILED:  " + result.message) + " (" + std::to_string(result.checks) +
+			" checks, " + std::to_string(result.stubCompiles) + " stub compiles, " + std::to_string(result.ms) + " ms)");
+		return result.passed ? 0 : 1;
+	}
+
+	// Compile every shader from scratch instead of reading compiled code from <exe dir>/ShaderCache (-noShaderCache)
+	if (hasArg("-noShaderCache")) {
+		ShaderCache::getDefault()->setEnabled(false);
+	}
+
 	// Create our rendering pipeline
 	RenderingPipeline *pipeline = new RenderingPipeline();
 
@@ -41,22 +140,103 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 	params.mSpatialReuse = pipeline->mDoSpatialReuse;
 
 	// Add passes into our pipeline
-	pipeline->setPass(0, RayTracedGBufferPass::create()); 
-	pipeline->setPass(1, CreateLightSamplesPass::create("HDRColorOutput", params));  // collect light samples and temporal reuse
-
 	int spatial_iterations = 1;
-	for (int i = 0; i < spatial_iterations; i++) {
-		pipeline->setPass(2 + i, SpatialReusePass::create("HDRColorOutput", i, spatial_iterations)); // spatial reuse
+	bool cpuDenoise = hasArg("-cpuDenoise");   // Implies -cpu
+	bool useCpu = hasArg("-cpu") || cpuDenoise;
+	bool useReGIR = hasArg("-regir");
+	bool useReSTIRGI = hasArg("-restirgi");
+	int gi_passes = 0;
+	std::string reservoirsValue;
+	uint32_t reservoirsPerPixel = getArgValue("-reservoirs", reservoirsValue) ? uint32_t(std::max(1, atoi(reservoirsValue.c_str()))) : 1u;
+	bool compactReservoirs = hasArg("-compactReservoirs");
+	pipeline->mDoUnbiased = hasArg("-unbiased");
+	pipeline->mDoUnbiasedVisibility = hasArg("-unbiasedVisibility");
+
+	// Stream per-pass timings to <name>.json (Chrome trace) and <name>.csv for the whole run (-trace <name>)
+	std::string traceName;
+	if (getArgValue("-trace", traceName)) {
+		pipeline->startProfileTrace(traceName);
+	}
+
+	// Cache decoded, mip-mapped and block-compressed textures in <dir> (-texcache <dir>; add -texcacheBC7 to encode color as BC7)
+	TextureCache::Settings cacheSettings;
+	if (getArgValue("-texcache", cacheSettings.directory)) {
+		if (hasArg("-texcacheBC7")) cacheSettings.compression = TextureCache::Compression::BC7;
+		TextureCache::setSettings(cacheSettings);
 	}
-	
-	pipeline->setPass(2 + spatial_iterations, ShadeWithReservoirsPass::create("HDRColorOutput", params)); // use reservoirs to perform shading
 
-	// Apply denoising filter (num. iterations dependent on filter size)
+	// Denoising filter iterations (dependent on filter size)
 	int num_iterations = (int)glm::floor(glm::log2(pipeline->getFilterSize() / 5.f));
-	for (int j = 0; j < num_iterations; j++) {
-		pipeline->setPass(3 + spatial_iterations + j, DenoisingPass::create("HDRColorOutput", j, num_iterations));
+
+	if (useCpu) {
+		// Run G-buffer, light sampling, spatial reuse, and shading on the CPU (remaining slots up to the denoiser stay empty).
+		//     With -cpuDenoise it denoises, too, in place of the DenoisingPasses.
+		pipeline->setPass(0, CpuReSTIRPass::create(spatial_iterations, cpuDenoise ? num_iterations : 0));
+	}
+	else if (useReGIR) {
+		// Direct lighting from a world-space light grid (ReGIR) instead of per-pixel reservoirs
+		ReGIRGrid::SharedPtr pGrid = ReGIRGrid::create();
+		pipeline->setPass(0, RayTracedGBufferPass::create());
+		pipeline->setPass(1, BuildCellReservoirsPass::create(pGrid));                       // fill cell reservoirs
+		pipeline->setPass(2, SampleLightGridPass::create("HDRColorOutput", pGrid));         // resample cells per pixel and shade
+	}
+	else {
+		// N reservoirs per pixel (-reservoirs N), resampled independently and averaged when shading.  8 instead of 16 bytes each with -compactReservoirs.
+		ReservoirStore::SharedPtr pReservoirs = ReservoirStore::create(reservoirsPerPixel, compactReservoirs ? ReservoirStore::Format::Compact : ReservoirStore::Format::Full);
+		EnvMapSampler::SharedPtr pEnvSampler = EnvMapSampler::create();   // Environment map cells as light candidates
+		EmissiveLights::SharedPtr pEmissiveLights = EmissiveLights::create();   // Points on emissive triangles as light candidates
+		pipeline->setPass(0, RayTracedGBufferPass::create());
+		pipeline->setPass(1, CreateLightSamplesPass::create("HDRColorOutput", params, pReservoirs, pEnvSampler, pEmissiveLights));  // collect light samples and temporal reuse
+
+		for (int i = 0; i < spatial_iterations; i++) {
+			pipeline->setPass(2 + i, SpatialReusePass::create("HDRColorOutput", i, spatial_iterations, pReservoirs, pEnvSampler, pEmissiveLights)); // spatial reuse
+		}
+
+		pipeline->setPass(2 + spatial_iterations, ShadeWithReservoirsPass::create("HDRColorOutput", params, pReservoirs, pEnvSampler, pEmissiveLights)); // use reservoirs to perform shading
+
+		if (useReSTIRGI) {
+			// Indirect lighting from resampled one-bounce samples (ReSTIR GI), added to the direct lighting
+			pipeline->setPass(3 + spatial_iterations, CreateGISamplesPass::create(pReservoirs, pEnvSampler));   // new samples and temporal reuse
+			pipeline->setPass(4 + spatial_iterations, GISpatialReusePass::create(pReservoirs));         // spatial reuse
+			pipeline->setPass(5 + spatial_iterations, ShadeWithGIReservoirsPass::create(pReservoirs));  // add indirect lighting
+			gi_passes = 3;
+		}
+	}
+
+	// Apply denoising filter
+	for (int j = 0; j < num_iterations && !cpuDenoise; j++) {
+		pipeline->setPass(3 + spatial_iterations + gi_passes + j, DenoisingPass::create("HDRColorOutput", j, num_iterations));
+	}
+
+	// Write the HDR image and AOVs to <dir>/frame_00000.exr, ... from the first frame (-exr <dir>).  -exrChannels <list> picks the
+	//     channels (see ExrOutputPass::parseChannels()), -exrCompression none|rle|zips|zip the compression, and -exrBlock waits
+	//     for the writer instead of skipping frames while it's behind.
+	int exr_passes = 0;
+	std::string exrDir;
+	if (getArgValue("-exr", exrDir)) {
+		std::vector<ExrOutputPass::ChannelSpec> exrChannels = ExrOutputPass::getDefaultChannels();
+		std::string list;
+		if (getArgValue("-exrChannels", list)) {
+			if (!ExrOutputPass::parseChannels(list, exrChannels)) logWarning("Ignoring malformed -exrChannels " + list);
+		}
+		ExrWriter::Compression exrCompression = ExrWriter::Compression::ZIP;
+		std::string name;
+		if (getArgValue("-exrCompression", name)) {
+			if (!ExrWriter::parseCompression(name, exrCompression)) logWarning("Unknown -exrCompression " + name + ", using zip");
+		}
+		ExrWriter::QueuePolicy exrPolicy = hasArg("-exrBlock") ? ExrWriter::QueuePolicy::Block : ExrWriter::QueuePolicy::Drop;
+		ExrOutputPass::SharedPtr pExrOutput = ExrOutputPass::create(exrDir, exrChannels, exrCompression, exrPolicy);
+		pExrOutput->setCapturing(true);
+		pipeline->setPass(3 + spatial_iterations + gi_passes + num_iterations, pExrOutput);
+		exr_passes = 1;
+	}
+	pipeline->setPass(3 + spatial_iterations + gi_passes + num_iterations + exr_passes, SimpleToneMappingPass::create("HDRColorOutput", ResourceManager::kOutputChannel));
+
+	// Report what aliasing transient channels saves for this pipeline at 1080p, without creating a window (-aliasingReport)
+	if (hasArg("-aliasingReport")) {
+		pipeline->simulateChannelAliasing(1920, 1080);
+		return 0;
 	}
-	pipeline->setPass(3 + spatial_iterations + num_iterations, SimpleToneMappingPass::create("HDRColorOutput", ResourceManager::kOutputChannel));
 
 	// Define a set of config / window parameters for our program
     SampleConfig config;
@@ -0,0 +1,101 @@
+#ifndef _ADAPTIVE_SAMPLING_H
+#define _ADAPTIVE_SAMPLING_H
+
+/*******************************************************************
+	Per-pixel convergence statistics for adaptive sampling, shared
+	between the accumulation shader (accumulation.ps.hlsl) and its
+	CPU twin (CpuAdaptiveSampler).
+
+	Each pixel keeps a running weighted mean and sum of squared
+	differences (West's form of Welford's update) of its luminance.
+	A frame adds one observation:  the mean of the n samples the pixel
+	took that frame.  From those we estimate the relative standard
+	error of the pixel's mean, and how many samples it still needs to
+	get below a threshold.  Pixels below it are converged and take no
+	more samples (0).
+
+	The state is a float4, as stored in the accumulation pass' count
+	texture:  x = samples, y = sum of squared differences, z =
+	observations, w = mean luminance.
+*******************************************************************/
+
+#ifdef __cplusplus
+#include "Data/HostDeviceSharedMacros.h"
+#else
+#include "HostDeviceSharedMacros.h"
+#endif
+
+#define ADAPTIVE_MIN_LUMINANCE  1.0e-3f   ///< Relative error of darker pixels is measured against this
+#define ADAPTIVE_NOT_CONVERGED  1.0e30f   ///< Relative error of a pixel without enough observations to estimate it
+
+// ResourceManager channel the accumulation pass writes each pixel's sample budget for the next frame to:  x is the number
+//     of samples, y is 1 if x is valid (0:  take one sample), z the pixel's relative error
+#define ADAPTIVE_SAMPLE_COUNT_CHANNEL  "AdaptiveSampleCount"
+
+/*******************************************************************
+                    Glue code for CPU/GPU compilation
+*******************************************************************/
+
+#ifdef HOST_CODE
+#include <cmath>
+#define ADAPTIVE_INOUT(T) T&
+
+inline float adaptiveSqrt(float value)                  { return std::sqrt(value); }
+inline float adaptiveCeil(float value)                  { return std::ceil(value); }
+inline float adaptiveAbs(float value)                   { return std::abs(value); }
+inline float adaptiveMin(float a, float b)              { return (b < a) ? b : a; }
+inline float adaptiveMax(float a, float b)              { return (a < b) ? b : a; }
+#else
+#define ADAPTIVE_INOUT(T) inout T
+
+#define adaptiveSqrt   sqrt
+#define adaptiveCeil   ceil
+#define adaptiveAbs    abs
+#define adaptiveMin    min
+#define adaptiveMax    max
+#endif
+
+/*******************************************************************
+                    Statistics
+*******************************************************************/
+
+// The luminance the statistics track
+inline float adaptiveLuminance(float r, float g, float b)
+{
+	return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+// Add an observation <value> that averages <n> samples (n > 0) to a pixel's statistics
+inline void adaptiveAddObservation(ADAPTIVE_INOUT(float) samples, ADAPTIVE_INOUT(float) m2, ADAPTIVE_INOUT(float) observations, ADAPTIVE_INOUT(float) mean, float value, float n)
+{
+	samples = samples + n;
+	float delta = value - mean;
+	mean = mean + delta * (n / samples);
+	m2 = m2 + n * delta * (value - mean);
+	observations = observations + 1.f;
+}
+
+// Relative standard error of a pixel's mean.  An observation of n samples has variance sigma^2 / n, so the weighted sum
+//     of squared differences estimates (observations - 1) * sigma^2 whatever the per-frame sample counts were.
+inline float adaptiveRelativeError(float samples, float m2, float observations, float mean)
+{
+	if (observations < 2.f) return ADAPTIVE_NOT_CONVERGED;
+	float variance = adaptiveMax(m2, 0.f) / (observations - 1.f);
+	float standardError = adaptiveSqrt(variance / samples);
+	return standardError / adaptiveMax(adaptiveAbs(mean), ADAPTIVE_MIN_LUMINANCE);
+}
+
+// Samples a pixel should take next frame:  1 until it has <minSamples>, then 0 once its error is below <threshold>, or as
+//     many as should get it there (the error falls as 1 / sqrt(samples)), between 1 and <maxSamples>
+inline float adaptiveSampleCount(float relativeError, float samples, float threshold, float minSamples, float maxSamples)
+{
+	if (samples < minSamples) return 1.f;
+	if (relativeError <= threshold) return 0.f;
+	float ratio = adaptiveMin(relativeError / threshold, 1.0e4f);
+	float needed = samples * ratio * ratio - samples;
+	return adaptiveMin(adaptiveMax(adaptiveCeil(needed), 1.f), maxSamples);
+}
+
+#undef ADAPTIVE_INOUT
+
+#endif // _ADAPTIVE_SAMPLING_H
@@ -0,0 +1,132 @@
+#ifndef _ATROUS_FILTER_H
+#define _ATROUS_FILTER_H
+
+/*******************************************************************
+	Edge-avoiding a-trous filter math, shared between the compute
+	denoiser (atrous.cs.hlsl) and its CPU twin (CpuAtrousFilter).
+
+	Both sides must produce the same bits, so nothing here relies on
+	operations whose precision D3D leaves open:  exp() is a polynomial
+	over exact exponent bit tricks, division is a Newton-iterated
+	reciprocal, and every expression is a chain of single adds and
+	multiplies (kept from fusing into mads by ATROUS_PRECISE).  Inputs
+	that would go denormal are flushed to zero, as the GPU does and as
+	CpuAtrousFilter asks the CPU to.
+*******************************************************************/
+
+#ifdef __cplusplus
+#include "Data/HostDeviceSharedMacros.h"
+#else
+#include "HostDeviceSharedMacros.h"
+#endif
+
+#define ATROUS_TILE_SIZE        16    ///< Compute threads per group along x and y (and CPU tile size)
+#define ATROUS_FUSED_ITERATIONS 2     ///< Iterations the first dispatch runs out of groupshared memory (step sizes 1 and 2)
+#define ATROUS_FUSED_APRON      6     ///< Pixels around a tile those iterations read:  2 * (1 + 2)
+
+/*******************************************************************
+                    Glue code for CPU/GPU compilation
+*******************************************************************/
+
+#ifdef HOST_CODE
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#define ATROUS_UINT    uint32_t
+#define ATROUS_PRECISE
+
+inline uint32_t atrousAsUint(float value)  { uint32_t bits; std::memcpy(&bits, &value, sizeof(bits)); return bits; }
+inline float    atrousAsFloat(uint32_t bits) { float value; std::memcpy(&value, &bits, sizeof(value)); return value; }
+inline float    atrousFloor(float value)     { return std::floor(value); }
+inline float    atrousMin(float a, float b)  { return (b < a) ? b : a; }
+inline float    atrousMax(float a, float b)  { return (a < b) ? b : a; }
+#else
+#define ATROUS_UINT    uint
+#define ATROUS_PRECISE precise
+
+#define atrousAsUint   asuint
+#define atrousAsFloat  asfloat
+#define atrousFloor    floor
+#define atrousMin      min
+#define atrousMax      max
+#endif
+
+/*******************************************************************
+                    Filter
+*******************************************************************/
+
+// 1D B3-spline taps;  the 5x5 kernel weight of tap (i, j) is kAtrousKernel[i] * kAtrousKernel[j] (exact in float)
+static const float kAtrousKernel[5] = { 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+
+// e^x for x <= 0, to a relative error under 1e-5 (mostly from rounding x * log2(e)).  Results below 2^-125 (and x = -Inf)
+//     become 0.
+inline float atrousExp(float x)
+{
+	ATROUS_PRECISE float t = x * 1.44269504f;                  // log2(e)
+	if (!(t >= -125.f)) return 0.f;
+
+	// 2^t = 2^i * 2^f with f in [-0.5, 0.5]
+	ATROUS_PRECISE float i = atrousFloor(t + 0.5f);
+	ATROUS_PRECISE float f = t - i;
+	ATROUS_PRECISE float p = 1.f + f * (0.693147182f + f * (0.240226462f + f * (0.0555033237f + f * (0.00961843785f + f * (0.00133988748f + f * 0.000153533620f)))));
+	return p * atrousAsFloat(ATROUS_UINT(int(i) + 127) << 23);
+}
+
+// 1 / x for positive, normal x, from an integer estimate and three Newton steps
+inline float atrousRcp(float x)
+{
+	ATROUS_PRECISE float y = atrousAsFloat(0x7EF311C3u - atrousAsUint(x));
+	y = y * (2.f - x * y);
+	y = y * (2.f - x * y);
+	y = y * (2.f - x * y);
+	return y;
+}
+
+// Squared length, summed in a fixed order (dot() may not be)
+inline float atrousDist2(float x, float y, float z)
+{
+	ATROUS_PRECISE float d = x * x + y * y;
+	d = d + z * z;
+	return d;
+}
+
+// Edge-stopping weight of a neighbor, from its squared color, normal and position distances to the center pixel
+//     and the reciprocal squared phi of each term
+inline float atrousEdgeWeight(float colorDist2, float normalDist2, float positionDist2, float invColorPhi2, float invNormalPhi2, float invPositionPhi2)
+{
+	ATROUS_PRECISE float w = atrousExp(-colorDist2 * invColorPhi2);
+	w = w * atrousExp(-normalDist2 * invNormalPhi2);
+	w = w * atrousExp(-positionDist2 * invPositionPhi2);
+	return w;
+}
+
+// 1 / (phi * phi), set once by the host so both sides filter with the same bits.  0 for phi = 0 (that term is off).
+inline float atrousInvPhi2(float phi)
+{
+	return (phi > 0.f) ? 1.f / (phi * phi) : 0.f;
+}
+
+/*******************************************************************
+                    Packed G-buffer
+*******************************************************************/
+
+// The filter reads one uint4 per neighbor:  world position (xyz, as float bits) and the normal in w, quantized to
+//     11:11:10 bits.  Decoded components are multiples of 2^-10 (2^-9 for z), at most about 1e-3 off.
+inline ATROUS_UINT atrousPackNormal(float x, float y, float z)
+{
+	ATROUS_PRECISE float qx = x * 1024.f + 1024.5f;
+	ATROUS_PRECISE float qy = y * 1024.f + 1024.5f;
+	ATROUS_PRECISE float qz = z * 512.f + 512.5f;
+	ATROUS_UINT ux = ATROUS_UINT(atrousMin(atrousMax(qx, 0.f), 2047.f));
+	ATROUS_UINT uy = ATROUS_UINT(atrousMin(atrousMax(qy, 0.f), 2047.f));
+	ATROUS_UINT uz = ATROUS_UINT(atrousMin(atrousMax(qz, 0.f), 1023.f));
+	return ux | (uy << 11) | (uz << 22);
+}
+
+inline float atrousUnpackNormalX(ATROUS_UINT packed) { ATROUS_PRECISE float v = float(packed & 0x7FFu) * (1.f / 1024.f) - 1.f; return v; }
+inline float atrousUnpackNormalY(ATROUS_UINT packed) { ATROUS_PRECISE float v = float((packed >> 11) & 0x7FFu) * (1.f / 1024.f) - 1.f; return v; }
+inline float atrousUnpackNormalZ(ATROUS_UINT packed) { ATROUS_PRECISE float v = float(packed >> 22) * (1.f / 512.f) - 1.f; return v; }
+
+#undef ATROUS_UINT
+
+#endif // _ATROUS_FILTER_H
@@ -0,0 +1,78 @@
+#ifndef _EMISSIVE_TRIANGLE_H
+#define _EMISSIVE_TRIANGLE_H
+
+/*******************************************************************
+	Emissive triangles as RIS candidates, shared between the shaders
+	(through emissiveLights.hlsli) and the host (EmissiveLights).
+
+	A reservoir keeps one light id rather than a position, so each
+	emissive triangle offers a fixed set of points (a power of two
+	of them, the same for every triangle) and a candidate is one of
+	those points:
+
+	    id = EMISSIVE_ID_BASE + triangle * pointsPerTriangle + point
+
+	The points are a Fibonacci lattice, rotated per triangle and
+	warped to be uniform over its area, so a uniform pick among them
+	stands in for a uniform area sample, and together they stratify
+	the triangle.  Ids start at 2^23, above the scene's lights and
+	the environment map's cells (see EnvMapSampler), and stay below
+	2^24, so they're exact in the reservoirs' float y.
+*******************************************************************/
+
+#ifdef __cplusplus
+#include "Data/HostDeviceSharedMacros.h"
+#else
+#include "HostDeviceSharedMacros.h"
+#endif
+
+#define EMISSIVE_ID_BASE          0x800000u   ///< First emissive candidate id (2^23)
+#define EMISSIVE_ID_COUNT         0x800000u   ///< Ids left for triangles times points per triangle
+#define EMISSIVE_FLAG_TWO_SIDED   1u          ///< Emits from both faces
+
+/*******************************************************************
+                    Glue code for CPU/GPU compilation
+*******************************************************************/
+
+#ifdef HOST_CODE
+#include <cstdint>
+#include "glm/vec3.hpp"
+#define EMISSIVE_UINT uint32_t
+#define EMISSIVE_FLOAT3 glm::vec3
+#else
+#define EMISSIVE_UINT uint
+#define EMISSIVE_FLOAT3 float3
+#endif
+
+// One emissive triangle in world space (48 bytes).  Structured buffers aren't padded to 16-byte rows, so the layout
+//     matches on both sides.
+struct EmissiveTriangle
+{
+	EMISSIVE_FLOAT3 p0;           ///< First vertex
+	EMISSIVE_UINT   radianceRG;   ///< Emitted radiance, averaged over the triangle:  red (low 16 bits) and green as halfs
+	EMISSIVE_FLOAT3 edge1;        ///< Second vertex - p0
+	EMISSIVE_UINT   radianceB;    ///< Blue as a half (low 16 bits), EMISSIVE_FLAG_* (high 16 bits)
+	EMISSIVE_FLOAT3 edge2;        ///< Third vertex - p0
+	float           area;
+};
+
+// Point <pointIndex> of a triangle's <count> lattice points (count a power of two), in 0.32 fixed point.  u spreads the
+//     points evenly and v steps by the golden ratio;  both are shifted along R2 by the triangle, so neighboring
+//     triangles don't line their points up.
+inline EMISSIVE_UINT emissiveLatticeU(EMISSIVE_UINT triIndex, EMISSIVE_UINT pointIndex, EMISSIVE_UINT count)
+{
+	return pointIndex * (0xFFFFFFFFu / count + 1u) + triIndex * 0xC13FA9A9u;
+}
+
+inline EMISSIVE_UINT emissiveLatticeV(EMISSIVE_UINT triIndex, EMISSIVE_UINT pointIndex)
+{
+	return pointIndex * 0x9E3779B9u + triIndex * 0x91E10DA5u;
+}
+
+// The top 24 bits of <bits> as a float in [0, 1)
+inline float emissiveToFloat(EMISSIVE_UINT bits)
+{
+	return float(bits >> 8) * (1.f / 16777216.f);
+}
+
+#endif // _EMISSIVE_TRIANGLE_H
@@ -0,0 +1,197 @@
+#ifndef _GI_RESERVOIR_H
+#define _GI_RESERVOIR_H
+
+/*******************************************************************
+	ReSTIR GI reservoirs, shared between the shaders (through
+	restirGIUtils.hlsli) and the host (ReservoirStore, CpuReSTIRGI).
+
+	A GI reservoir holds one indirect sample:  the visible point it
+	was found from, the point a bounce ray from there hit (the
+	sample point, with its normal) and the radiance leaving the
+	sample point toward the visible point.  Reusing the sample at
+	another visible point reconnects to the same sample point, so
+	its weight is scaled by the Jacobian of that change of solid
+	angle (giReconnectionJacobian()).
+
+	Stored reservoirs are finalized, as in ReservoirEncoding.h, so
+	wSum is dropped and M and W share a uint the way they do in a
+	CompactReservoir.
+*******************************************************************/
+
+#include "ReservoirEncoding.h"
+
+#define GI_SKY_DISTANCE   1.0e4f    ///< Bounce rays that miss the scene get a sample point this far out, facing back
+#define GI_MAX_JACOBIAN   10.f      ///< Spatial reuse skips neighbors whose sample would be stretched or squeezed more than this
+
+/*******************************************************************
+                    Glue code for CPU/GPU compilation
+*******************************************************************/
+
+#ifdef HOST_CODE
+#include "glm/glm.hpp"
+#define GI_UINT   uint32_t
+#define GI_FLOAT3 glm::vec3
+
+inline float giAbs(float value)  { return std::abs(value); }
+inline float giSqrt(float value) { return std::sqrt(value); }
+#else
+#define GI_UINT   uint
+#define GI_FLOAT3 float3
+
+#define giAbs     abs
+#define giSqrt    sqrt
+#endif
+
+/*******************************************************************
+                    Reservoirs
+*******************************************************************/
+
+struct GIReservoir
+{
+	GI_FLOAT3 visiblePos;       ///< Where the sample was found (or, once stored, the pixel it belongs to)
+	GI_FLOAT3 visibleNorm;
+	GI_FLOAT3 samplePos;        ///< Chosen sample:  the bounce ray's hit
+	GI_FLOAT3 sampleNorm;
+	GI_FLOAT3 radiance;         ///< Leaving samplePos toward visiblePos
+	float M;                    ///< Number of samples seen so far
+	float W;                    ///< Unbiased contribution weight
+	float wSum;                 ///< Sum of weights
+};
+
+// 48 bytes
+struct PackedGIReservoir
+{
+	GI_FLOAT3 visiblePos;
+	GI_UINT   visibleNorm;      ///< Octahedral, 16:16
+	GI_FLOAT3 samplePos;
+	GI_UINT   sampleNorm;       ///< Octahedral, 16:16
+	GI_FLOAT3 radiance;
+	GI_UINT   MW;               ///< M as a half (low 16 bits), W as an unsigned 6e10 float (high 16 bits)
+};
+
+// Dot product, spelled out so that both sides add in the same order
+inline float giDot(GI_FLOAT3 a, GI_FLOAT3 b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline float giLuminance(GI_FLOAT3 color)
+{
+	return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+// Unit normal to octahedral coordinates, 16 bits each
+inline GI_UINT packGINormal(GI_FLOAT3 n)
+{
+	float l1 = giAbs(n.x) + giAbs(n.y) + giAbs(n.z);
+	if (!(l1 > 0.f)) return 0x7FFF7FFFu;   // No normal:  +z, roughly
+	float x = n.x / l1;
+	float y = n.y / l1;
+	if (n.z < 0.f)
+	{
+		float foldedX = (1.f - giAbs(y)) * ((x >= 0.f) ? 1.f : -1.f);
+		float foldedY = (1.f - giAbs(x)) * ((y >= 0.f) ? 1.f : -1.f);
+		x = foldedX;
+		y = foldedY;
+	}
+	GI_UINT ux = GI_UINT(x * 32767.f + 32767.5f);
+	GI_UINT uy = GI_UINT(y * 32767.f + 32767.5f);
+	return ux | (uy << 16);
+}
+
+inline GI_FLOAT3 unpackGINormal(GI_UINT packed)
+{
+	float x = float(packed & 0xFFFFu) / 32767.f - 1.f;
+	float y = float(packed >> 16) / 32767.f - 1.f;
+	float z = 1.f - giAbs(x) - giAbs(y);
+	if (z < 0.f)
+	{
+		float unfoldedX = (1.f - giAbs(y)) * ((x >= 0.f) ? 1.f : -1.f);
+		float unfoldedY = (1.f - giAbs(x)) * ((y >= 0.f) ? 1.f : -1.f);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+	float invLength = 1.f / giSqrt(x * x + y * y + z * z);
+	return GI_FLOAT3(x * invLength, y * invLength, z * invLength);
+}
+
+inline PackedGIReservoir packGIReservoir(GIReservoir r)
+{
+	PackedGIReservoir p;
+	p.visiblePos = r.visiblePos;
+	p.visibleNorm = packGINormal(r.visibleNorm);
+	p.samplePos = r.samplePos;
+	p.sampleNorm = packGINormal(r.sampleNorm);
+	p.radiance = r.radiance;
+	p.MW = (f32tof16(r.M) & 0xFFFFu) | (packUnsignedFloat16(r.W) << 16);
+	return p;
+}
+
+inline GIReservoir unpackGIReservoir(PackedGIReservoir p)
+{
+	GIReservoir r;
+	r.visiblePos = p.visiblePos;
+	r.visibleNorm = unpackGINormal(p.visibleNorm);
+	r.samplePos = p.samplePos;
+	r.sampleNorm = unpackGINormal(p.sampleNorm);
+	r.radiance = p.radiance;
+	r.M = f16tof32(p.MW & 0xFFFFu);
+	r.W = unpackUnsignedFloat16(p.MW >> 16);
+	r.wSum = 0.f;
+	return r;
+}
+
+inline GIReservoir emptyGIReservoir()
+{
+	GIReservoir r;
+	r.visiblePos = GI_FLOAT3(0.f, 0.f, 0.f);
+	r.visibleNorm = GI_FLOAT3(0.f, 0.f, 1.f);
+	r.samplePos = GI_FLOAT3(0.f, 0.f, 0.f);
+	r.sampleNorm = GI_FLOAT3(0.f, 0.f, 1.f);
+	r.radiance = GI_FLOAT3(0.f, 0.f, 0.f);
+	r.M = 0.f;
+	r.W = 0.f;
+	r.wSum = 0.f;
+	return r;
+}
+
+/*******************************************************************
+                    Resampling
+*******************************************************************/
+
+// Target function:  the luminance of the sample's radiance, times the cosine toward it at the visible point (so a
+//     Lambertian visible point's contribution, up to its albedo)
+inline float giTargetFunction(GI_FLOAT3 radiance, GI_FLOAT3 visiblePos, GI_FLOAT3 visibleNorm, GI_FLOAT3 samplePos)
+{
+	GI_FLOAT3 toSample = samplePos - visiblePos;
+	float dist2 = giDot(toSample, toSample);
+	if (!(dist2 > 0.f)) return 0.f;
+	float cosTheta = giDot(visibleNorm, toSample) / giSqrt(dist2);
+	return (cosTheta > 0.f) ? giLuminance(radiance) * cosTheta : 0.f;
+}
+
+// Jacobian of reusing, at receiverPos, a sample found at sourcePos:  how much larger the solid angle around the sample
+//     point is seen from the receiver than from the source,
+//
+//         |cos phi_r| / |cos phi_q| * |x_q - x_s|^2 / |x_r - x_s|^2
+//
+//     with phi the angle between the sample point's normal and the direction back to each visible point.  The sample's
+//     contribution weight W (a reciprocal solid angle pdf at the source) times this is its weight at the receiver.
+inline float giReconnectionJacobian(GI_FLOAT3 receiverPos, GI_FLOAT3 sourcePos, GI_FLOAT3 samplePos, GI_FLOAT3 sampleNorm)
+{
+	GI_FLOAT3 toReceiver = receiverPos - samplePos;
+	GI_FLOAT3 toSource = sourcePos - samplePos;
+	float receiverDist2 = giDot(toReceiver, toReceiver);
+	float sourceDist2 = giDot(toSource, toSource);
+	if (!(receiverDist2 > 0.f) || !(sourceDist2 > 0.f)) return 0.f;
+
+	float cosReceiver = giAbs(giDot(sampleNorm, toReceiver)) / giSqrt(receiverDist2);
+	float cosSource = giAbs(giDot(sampleNorm, toSource)) / giSqrt(sourceDist2);
+	if (!(cosSource > 0.f)) return 0.f;
+	return (cosReceiver / cosSource) * (sourceDist2 / receiverDist2);
+}
+
+#undef GI_UINT
+#undef GI_FLOAT3
+
+#endif // _GI_RESERVOIR_H
@@ -0,0 +1,159 @@
+#ifndef _RESERVOIR_ENCODING_H
+#define _RESERVOIR_ENCODING_H
+
+/*******************************************************************
+	Reservoir buffer formats, shared between the shaders (through
+	restirUtils.hlsli) and the host (ReservoirStore, CpuReSTIRRenderer).
+
+	Stored reservoirs are always finalized, i.e. their W has been
+	computed, and later passes only read y, M and W.  The compact
+	format therefore drops wSum, keeps M as a half and W as an
+	unsigned 16-bit float with a 6-bit exponent (W is never negative,
+	and needs more range than a half has).
+*******************************************************************/
+
+#ifdef __cplusplus
+#include "Data/HostDeviceSharedMacros.h"
+#else
+#include "HostDeviceSharedMacros.h"
+#endif
+
+#define RESERVOIR_FORMAT_FULL       0   ///< 16 bytes:  light ID, M (half), W, wSum
+#define RESERVOIR_FORMAT_COMPACT    1   ///< 8 bytes:   light ID, M (half) | W (unsigned 6e10 float)
+
+/*******************************************************************
+                    Glue code for CPU/GPU compilation
+*******************************************************************/
+
+#ifdef HOST_CODE
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#define RESERVOIR_UINT uint32_t
+
+inline uint32_t asuint(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+inline float asfloat(uint32_t bits)
+{
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// The half nearest to <value> (ties to even) in the low 16 bits, as f32tof16() on the GPU
+inline uint32_t f32tof16(float value)
+{
+	uint32_t f = asuint(value);
+	uint32_t sign = (f >> 16) & 0x8000u;
+	uint32_t absF = f & 0x7FFFFFFFu;
+
+	if (absF >= 0x7F800000u) return sign | 0x7C00u | ((absF > 0x7F800000u) ? 0x200u : 0u);   // Inf, NaN
+	if (absF >= 0x477FF000u) return sign | 0x7C00u;                                           // Rounds past 65504
+	if (absF < 0x38800000u)
+	{
+		// Denormal half (or zero):  shift the full mantissa down to units of 2^-24
+		if (absF < 0x33000000u) return sign;
+		uint32_t mantissa = (absF & 0x007FFFFFu) | 0x00800000u;
+		uint32_t shift = 126u - (absF >> 23);
+		uint32_t h = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1u), halfway = 1u << (shift - 1u);
+		if (rest > halfway || (rest == halfway && (h & 1u))) h++;
+		return sign | h;
+	}
+
+	// Normal half:  rebias the exponent and drop 13 mantissa bits
+	uint32_t h = (absF - 0x38000000u) >> 13;
+	uint32_t rest = absF & 0x1FFFu;
+	if (rest > 0x1000u || (rest == 0x1000u && (h & 1u))) h++;
+	return sign | h;
+}
+
+// The half in the low 16 bits of <value>, as f16tof32() on the GPU
+inline float f16tof32(uint32_t value)
+{
+	uint32_t exponent = (value >> 10) & 0x1Fu;
+	uint32_t mantissa = value & 0x3FFu;
+	float magnitude;
+	if (exponent == 0) magnitude = std::ldexp(float(mantissa), -24);
+	else if (exponent == 31) magnitude = mantissa ? std::numeric_limits<float>::quiet_NaN() : std::numeric_limits<float>::infinity();
+	else magnitude = std::ldexp(float(mantissa | 0x400u), int(exponent) - 25);
+	return (value & 0x8000u) ? -magnitude : magnitude;
+}
+#else
+#define RESERVOIR_UINT uint
+#endif
+
+/*******************************************************************
+                    Formats
+*******************************************************************/
+
+struct FullReservoir
+{
+	RESERVOIR_UINT lightId;     ///< Chosen sample
+	RESERVOIR_UINT M;           ///< Number of samples seen so far, as a half
+	float W;                    ///< Weight
+	float wSum;                 ///< Sum of weights
+};
+
+struct CompactReservoir
+{
+	RESERVOIR_UINT lightId;     ///< Chosen sample
+	RESERVOIR_UINT MW;          ///< M as a half (low 16 bits), W as an unsigned 6e10 float (high 16 bits)
+};
+
+// Unsigned float with a 6-bit exponent (bias 31) and 10-bit mantissa:  [2^-30, 2^33) with a relative error of at
+//     most 2^-11.  Smaller values flush to zero, larger ones (and Inf) clamp to the largest value, negatives and NaN become 0.
+inline RESERVOIR_UINT packUnsignedFloat16(float value)
+{
+	if (!(value > 0.f)) return 0;
+	RESERVOIR_UINT bits = asuint(value) + 0x1000u;          // Round to nearest on the 10 mantissa bits we keep
+	int exponent = int(bits >> 23) - 127 + 31;
+	if (exponent <= 0) return 0;
+	if (exponent >= 64) return 0xFFFFu;
+	return (RESERVOIR_UINT(exponent) << 10) | ((bits >> 13) & 0x3FFu);
+}
+
+inline float unpackUnsignedFloat16(RESERVOIR_UINT value)
+{
+	RESERVOIR_UINT exponent = (value >> 10) & 0x3Fu;
+	if (exponent == 0) return 0.f;
+	return asfloat(((exponent + 127u - 31u) << 23) | ((value & 0x3FFu) << 13));
+}
+
+inline FullReservoir encodeFullReservoir(RESERVOIR_UINT lightId, float M, float W, float wSum)
+{
+	FullReservoir p;
+	p.lightId = lightId;
+	p.M = f32tof16(M);
+	p.W = W;
+	p.wSum = wSum;
+	return p;
+}
+
+inline CompactReservoir encodeCompactReservoir(RESERVOIR_UINT lightId, float M, float W)
+{
+	CompactReservoir p;
+	p.lightId = lightId;
+	p.MW = (f32tof16(M) & 0xFFFFu) | (packUnsignedFloat16(W) << 16);
+	return p;
+}
+
+inline float compactReservoirM(CompactReservoir p)
+{
+	return f16tof32(p.MW & 0xFFFFu);
+}
+
+inline float compactReservoirW(CompactReservoir p)
+{
+	return unpackUnsignedFloat16(p.MW >> 16);
+}
+
+#undef RESERVOIR_UINT
+
+#endif // _RESERVOIR_ENCODING_H
@@ -0,0 +1,205 @@
+#ifndef _SAMPLE_SEQUENCES_H
+#define _SAMPLE_SEQUENCES_H
+
+/*******************************************************************
+	Per-pixel sample sequences, shared between the shaders and the
+	host (SampleGenerator, CpuReSTIRRenderer).
+
+	Every random decision draws from a sample domain:  a sequence of
+	2D points per pixel, indexed by how many times the pixel made that
+	decision before.  Domains are independent of each other, so RIS
+	candidates, neighbor picks and bounce directions don't correlate,
+	while the points within one domain are stratified (for the
+	low-discrepancy samplers) over consecutive indices.  Callers
+	therefore number their draws contiguously, e.g. candidate i of
+	frame f is index f * M + i.
+
+	SAMPLER_UNIFORM     hashed white noise (uses all 32 bits, unlike
+	                    the LCG behind nextRand())
+	SAMPLER_SOBOL       2D Sobol, Owen-scrambled per pixel and domain
+	                    with hashed nested uniform scrambling (Burley,
+	                    "Practical Hash-based Owen Scrambling", 2020)
+	SAMPLER_R2          Roberts' R2 sequence with a per pixel and
+	                    domain toroidal shift
+	SAMPLER_BLUE_NOISE  R2 shifted by a 64x64 void-and-cluster
+	                    blue-noise mask (at a toroidal offset per
+	                    domain), so neighboring pixels' errors are
+	                    blue noise at every index, and each pixel's
+	                    points stay low-discrepancy over the index
+
+	R2 and blue noise decorrelate domains by their shifts alone:  at
+	the same index, two domains' points differ by a constant per
+	pixel.  Each is still uniform over the pixels' random shifts, so
+	estimates stay unbiased, but SAMPLER_SOBOL (which also shuffles
+	each domain's points) is the better default.
+*******************************************************************/
+
+#ifdef __cplusplus
+#include "Data/HostDeviceSharedMacros.h"
+#else
+#include "HostDeviceSharedMacros.h"
+#endif
+
+#define SAMPLER_UNIFORM      0
+#define SAMPLER_SOBOL        1
+#define SAMPLER_R2           2
+#define SAMPLER_BLUE_NOISE   3
+#define SAMPLER_COUNT        4
+
+#define BLUE_NOISE_TILE_SIZE 64     ///< Width and height of the blue-noise mask (a power of two)
+
+// Sample domains.  Each is a 2D sequence;  1D decisions use its first dimension.
+#define SAMPLE_DOMAIN_DIRECT_LIGHT     0    ///< Light for one-sample direct lighting.  fullGI:  + 2 * bounce depth
+#define SAMPLE_DOMAIN_BOUNCE           1    ///< Cosine-weighted bounce direction (2D).  fullGI:  + 2 * bounce depth
+#define SAMPLE_DOMAIN_CANDIDATE        32   ///< Which light a RIS candidate is (2D for environment map cells)
+#define SAMPLE_DOMAIN_CANDIDATE_ALIAS  33   ///< Alias table:  keep the bucket's own light or take its alias
+#define SAMPLE_DOMAIN_CANDIDATE_RIS    34   ///< Keep a candidate in the reservoir
+#define SAMPLE_DOMAIN_TEMPORAL_RIS     35   ///< Keep the current or last frame's sample
+#define SAMPLE_DOMAIN_NEIGHBOR         36   ///< Spatial reuse neighbor offset (2D)
+#define SAMPLE_DOMAIN_SPATIAL_RIS      37   ///< Keep a neighbor's sample
+#define SAMPLE_DOMAIN_CANDIDATE_ENV    38   ///< Draw a RIS candidate from the environment map instead of the lights
+#define SAMPLE_DOMAIN_CANDIDATE_EMISSIVE 39  ///< Draw a RIS candidate from the emissive triangles instead of the map or the lights
+#define SAMPLE_DOMAIN_LIGHT_TREE       64   ///< Light BVH walk:  + level
+
+/*******************************************************************
+                    Glue code for CPU/GPU compilation
+*******************************************************************/
+
+#ifdef HOST_CODE
+#include <cstdint>
+#define SAMPLER_UINT uint32_t
+
+inline uint32_t samplerReverseBits(uint32_t x)
+{
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00FF00FFu) << 8) | ((x & 0xFF00FF00u) >> 8);
+	x = ((x & 0x0F0F0F0Fu) << 4) | ((x & 0xF0F0F0F0u) >> 4);
+	x = ((x & 0x33333333u) << 2) | ((x & 0xCCCCCCCCu) >> 2);
+	x = ((x & 0x55555555u) << 1) | ((x & 0xAAAAAAAAu) >> 1);
+	return x;
+}
+
+// The blue-noise mask texel (x, y), in [0, 1).  Implemented by SampleGenerator.cpp.
+float blueNoiseMaskTexel(uint32_t x, uint32_t y);
+#define SAMPLER_BLUE_NOISE_MASK(x, y) blueNoiseMaskTexel(x, y)
+#else
+#define SAMPLER_UINT uint
+#define samplerReverseBits reversebits
+
+// Bound by SampleGenerator::setIntoVars()
+shared Texture2D<float> gBlueNoiseMask;
+#define SAMPLER_BLUE_NOISE_MASK(x, y) gBlueNoiseMask[uint2(x, y)]
+#endif
+
+/*******************************************************************
+                    Sequences
+*******************************************************************/
+
+// Second dimension of the Sobol sequence (the first is the bit-reversed index)
+static const SAMPLER_UINT kSobolDirections1[32] = {
+	0x80000000u, 0xC0000000u, 0xA0000000u, 0xF0000000u, 0x88000000u, 0xCC000000u, 0xAA000000u, 0xFF000000u,
+	0x80800000u, 0xC0C00000u, 0xA0A00000u, 0xF0F00000u, 0x88880000u, 0xCCCC0000u, 0xAAAA0000u, 0xFFFF0000u,
+	0x80008000u, 0xC000C000u, 0xA000A000u, 0xF000F000u, 0x88008800u, 0xCC00CC00u, 0xAA00AA00u, 0xFF00FF00u,
+	0x80808080u, 0xC0C0C0C0u, 0xA0A0A0A0u, 0xF0F0F0F0u, 0x88888888u, 0xCCCCCCCCu, 0xAAAAAAAAu, 0xFFFFFFFFu,
+};
+
+#define SAMPLER_R2_ALPHA0     0xC13FA9A9u   ///< 2^32 / plastic number:  R2
+#define SAMPLER_R2_ALPHA1     0x91E10DA5u   ///< 2^32 / plastic number^2
+
+// Everything a pixel needs to draw from its sequences
+struct PixelSampler
+{
+	SAMPLER_UINT type;   ///< SAMPLER_*
+	SAMPLER_UINT seed;   ///< Hash of the pixel:  scrambles its sequences
+	SAMPLER_UINT x;      ///< The pixel, for the blue-noise mask
+	SAMPLER_UINT y;
+};
+
+// A 32-bit integer hash with good avalanche (Wellons' lowbias32)
+inline SAMPLER_UINT samplerHash(SAMPLER_UINT x)
+{
+	x ^= x >> 16;
+	x *= 0x7FEB352Du;
+	x ^= x >> 15;
+	x *= 0x846CA68Bu;
+	x ^= x >> 16;
+	return x;
+}
+
+// The top 24 bits of <bits> as a float in [0, 1)
+inline float samplerToFloat(SAMPLER_UINT bits)
+{
+	return float(bits >> 8) * (1.f / 16777216.f);
+}
+
+// Owen scrambling of a bit-reversed value (Laine and Karras' hash, as improved by Burley)
+inline SAMPLER_UINT samplerLaineKarras(SAMPLER_UINT x, SAMPLER_UINT seed)
+{
+	x ^= x * 0x3D20ADEAu;
+	x += seed;
+	x *= (seed >> 16) | 1u;
+	x ^= x * 0x05526C56u;
+	x ^= x * 0x53A22864u;
+	return x;
+}
+
+inline SAMPLER_UINT samplerNestedUniformScramble(SAMPLER_UINT x, SAMPLER_UINT seed)
+{
+	return samplerReverseBits(samplerLaineKarras(samplerReverseBits(x), seed));
+}
+
+// Unscrambled Sobol point <index>, dimension <dim> (0 or 1), in 0.32 fixed point
+inline SAMPLER_UINT samplerSobol(SAMPLER_UINT index, SAMPLER_UINT dim)
+{
+	if (dim == 0) return samplerReverseBits(index);
+	SAMPLER_UINT x = 0;
+	for (SAMPLER_UINT bit = 0; index != 0; bit++, index >>= 1)
+	{
+		if ((index & 1u) != 0) x ^= kSobolDirections1[bit];
+	}
+	return x;
+}
+
+inline PixelSampler createPixelSampler(SAMPLER_UINT type, SAMPLER_UINT x, SAMPLER_UINT y)
+{
+	PixelSampler s;
+	s.type = type;
+	s.seed = samplerHash(x ^ samplerHash(y ^ 0x5BD1E995u));
+	s.x = x;
+	s.y = y;
+	return s;
+}
+
+// Dimension <dim> (0 or 1) of point <index> of the pixel's sequence in <domain>, in [0, 1)
+inline float pixelSample(PixelSampler s, SAMPLER_UINT domain, SAMPLER_UINT index, SAMPLER_UINT dim)
+{
+	SAMPLER_UINT domainSeed = samplerHash(s.seed ^ samplerHash(domain + 0x68BC21EBu));
+	SAMPLER_UINT dimSeed = samplerHash(domainSeed + dim + 1u);
+	SAMPLER_UINT bits;
+	if (s.type == SAMPLER_SOBOL)
+	{
+		// Shuffle the points (so domains sharing an index don't share a point), then scramble each dimension
+		SAMPLER_UINT shuffled = samplerNestedUniformScramble(index, domainSeed);
+		bits = samplerNestedUniformScramble(samplerSobol(shuffled, dim), dimSeed);
+	}
+	else if (s.type == SAMPLER_R2)
+	{
+		bits = dimSeed + index * ((dim == 0) ? SAMPLER_R2_ALPHA0 : SAMPLER_R2_ALPHA1);
+	}
+	else if (s.type == SAMPLER_BLUE_NOISE)
+	{
+		// Offset the mask per domain and dimension along R2 (so offsets stay well apart), then step along R2 by the index
+		SAMPLER_UINT offsetIndex = 2u * domain + dim + 1u;
+		SAMPLER_UINT maskX = (s.x + ((offsetIndex * SAMPLER_R2_ALPHA0) >> 26)) & (BLUE_NOISE_TILE_SIZE - 1);
+		SAMPLER_UINT maskY = (s.y + ((offsetIndex * SAMPLER_R2_ALPHA1) >> 26)) & (BLUE_NOISE_TILE_SIZE - 1);
+		float mask = SAMPLER_BLUE_NOISE_MASK(maskX, maskY);
+		bits = SAMPLER_UINT(mask * 4294967040.f) + index * ((dim == 0) ? SAMPLER_R2_ALPHA0 : SAMPLER_R2_ALPHA1);
+	}
+	else
+	{
+		bits = samplerHash(dimSeed ^ samplerHash(index));
+	}
+	return samplerToFloat(bits);
+}
+
+#endif // _SAMPLE_SEQUENCES_H
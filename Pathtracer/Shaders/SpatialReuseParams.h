@@ -0,0 +1,50 @@
+#ifndef _SPATIAL_REUSE_PARAMS_H
+#define _SPATIAL_REUSE_PARAMS_H
+
+/*******************************************************************
+	Constants of the spatial reuse pass, declared once for both
+	spatialReuse.hlsl (as GlobalCB's gParams) and SpatialReusePass,
+	which fills one on the CPU and copies it into the constant
+	buffer whole, through a handle resolved once (see
+	SimpleVars::resolveConstants()), instead of setting a dozen
+	variables by name every frame.
+
+	HLSL packs constant buffers in 16-byte rows.  Keeping every
+	member a 4-byte scalar means no member straddles a row, so the
+	C++ struct has the same layout with no padding.  Flags are uints
+	for the same reason (a C++ bool is one byte).  Add members in
+	fours to keep the struct a whole number of rows.
+*******************************************************************/
+
+#ifdef __cplusplus
+#include "Data/HostDeviceSharedMacros.h"
+#else
+#include "HostDeviceSharedMacros.h"
+#endif
+
+#ifdef HOST_CODE
+#include <cstdint>
+#define SPATIAL_UINT uint32_t
+#else
+#define SPATIAL_UINT uint
+#endif
+
+struct SpatialReuseParams
+{
+	float        minT;                 ///< Avoid ray self-intersection
+	SPATIAL_UINT frameCount;           ///< Frame counter to act as random seed
+	SPATIAL_UINT maxDepth;             ///< Max recursion depth
+	SPATIAL_UINT samplerType;          ///< Sequence behind the neighbor picks and reuse decisions (SAMPLER_*)
+
+	SPATIAL_UINT spatialNeighbors;     ///< Neighbors merged per iteration
+	SPATIAL_UINT spatialRadius;        ///< In pixels
+	SPATIAL_UINT iter;                 ///< This pass' iteration, in [0, totalIter)
+	SPATIAL_UINT totalIter;
+
+	SPATIAL_UINT enableReSTIR;
+	SPATIAL_UINT doSpatialReuse;
+	SPATIAL_UINT unbiased;             ///< Normalize by the neighbors that could have produced the sample (1/Z)
+	SPATIAL_UINT unbiasedVisibility;   ///< ... tracing a shadow ray from each of them to tell
+};
+
+#endif // _SPATIAL_REUSE_PARAMS_H
@@ -16,21 +16,97 @@
 # ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 **********************************************************************************************************************/
 
+#include "reprojection.hlsli"
+#include "AdaptiveSampling.h"
+
 // Frame count
 cbuffer PerFrameCB
 {
 	uint gAccumCount;
+	bool gReproject;      // Follow the motion vectors into per-pixel history, instead of restarting when the camera moves
+	uint gMaxHistory;     // Most frames of history each pixel keeps (when reprojecting)
+	bool gAdaptive;       // gCurFrame's alpha is the number of samples each pixel took (0:  none), as budgeted last frame
+	float gErrorThreshold;   // Relative standard error below which a pixel is converged (when adaptive)
+	float gMinSamples;    // Samples each pixel takes before it may converge
+	float gMaxSamples;    // Most samples a pixel takes in one frame
 };
 
 Texture2D<float4> gLastFrame;
 Texture2D<float4> gCurFrame;
+Texture2D<float4> gLastCount;   // Each pixel's statistics (see AdaptiveSampling.h); x is the samples accumulated in gLastFrame
+
+// Only used when reprojecting
+Texture2D<float4> gMotion;      // Motion vectors into last frame (see reprojection.hlsli)
+Texture2D<float4> gNorm;        // This and last frame's G-buffer normals, to reject disocclusions
+Texture2D<float4> gPrevNorm;
+
+struct AccumOutput
+{
+	float4 color : SV_Target0;
+	float4 count : SV_Target1;
+	float4 sampleCount : SV_Target2;   // Samples to take next frame, 1 if adaptive (0 if not, so ray generation takes one), relative error,
+	                                   //     samples accumulated (where the pixel's next sample is in its sequences)
+};
 
-float4 main(float2 tex : TEXCOORD, float4 pos : SV_Position) : SV_Target0
+AccumOutput main(float2 tex : TEXCOORD, float4 pos : SV_Position)
 {
     uint2 pixel = (uint2)pos.xy;
     float4 curColor = gCurFrame[pixel];
-    float4 prevColor = gLastFrame[pixel];
+    float n = gAdaptive ? curColor.a : 1.f;
+    curColor.a = 1.f;
 
-    return (gAccumCount * prevColor + curColor) / (gAccumCount + 1);
-}
+    // Find this pixel's history:  its accumulated color and statistics
+    bool hasHistory = false;
+    float4 prevColor = float4(0.f, 0.f, 0.f, 0.f);
+    float4 state = float4(0.f, 0.f, 0.f, 0.f);
+    if (!gReproject)
+    {
+        hasHistory = (gAccumCount > 0);
+        if (hasHistory)
+        {
+            prevColor = gLastFrame[pixel];
+            state = gLastCount[pixel];
+        }
+    }
+    else
+    {
+        // Blend with the pixel that saw the same surface last frame, if any
+        uint2 dim;
+        gCurFrame.GetDimensions(dim.x, dim.y);
+
+        uint2 prevIndex;
+        if (gAccumCount > 0 && reprojectPixel(pixel, dim, gMotion[pixel], gNorm[pixel].xyz, gPrevNorm, prevIndex))
+        {
+            hasHistory = true;
+            prevColor = gLastFrame[prevIndex];
+            state = gLastCount[prevIndex];
+
+            // Keep at most gMaxHistory samples, with the same variance estimate
+            if (state.x > float(gMaxHistory))
+            {
+                float observations = max(state.z * float(gMaxHistory) / state.x, 1.f);
+                state.y = (state.z > 1.f) ? state.y * (observations - 1.f) / (state.z - 1.f) : 0.f;
+                state.z = observations;
+                state.x = float(gMaxHistory);
+            }
+        }
+    }
 
+    AccumOutput result;
+    if (n > 0.f)
+    {
+        result.color = (state.x * prevColor + n * curColor) / (state.x + n);
+        adaptiveAddObservation(state.x, state.y, state.z, state.w, adaptiveLuminance(curColor.r, curColor.g, curColor.b), n);
+    }
+    else
+    {
+        // A converged pixel that took no samples keeps its history
+        result.color = hasHistory ? prevColor : gLastFrame[pixel];
+    }
+    result.count = state;
+
+    float relativeError = adaptiveRelativeError(state.x, state.y, state.z, state.w);
+    float samples = gAdaptive ? adaptiveSampleCount(relativeError, state.x, gErrorThreshold, gMinSamples, gMaxSamples) : 1.f;
+    result.sampleCount = float4(samples, gAdaptive ? 1.f : 0.f, relativeError, state.x);
+    return result;
+}
@@ -0,0 +1,177 @@
+// Compute version of the edge-avoiding a-trous denoiser in atrous.hlsl.  DenoisingPass runs it as:
+//
+//     PackGBuffer       once per frame:  position and normal into a single uint4 per pixel
+//     AtrousFused       the first two iterations (step sizes 1 and 2) out of a groupshared tile plus apron
+//     AtrousIteration   each later iteration, whose taps are too far apart to cache
+//
+// The math lives in AtrousFilter.h, which CpuAtrousFilter shares to produce the same bits on the CPU.
+
+#include "AtrousFilter.h"
+
+#define TILE_SIZE      ATROUS_TILE_SIZE
+#define REGION_SIZE    (ATROUS_TILE_SIZE + 2 * ATROUS_FUSED_APRON)       // Cached pixels per side
+#define FILTERED_APRON (ATROUS_FUSED_APRON - 2)                          // Pixels around the tile the step 2 iteration reads
+#define FILTERED_SIZE  (ATROUS_TILE_SIZE + 2 * FILTERED_APRON)           // Step 1 results per side
+
+cbuffer AtrousCB
+{
+	uint2 gScreenSize;
+	uint  gStepSize;            // AtrousIteration:  distance between taps
+	uint  gFusedIterations;     // AtrousFused:  1 (just step 1) or 2
+	float gInvColorPhi2;        // atrousInvPhi2() of each edge-stopping term
+	float gInvNormalPhi2;
+	float gInvPositionPhi2;
+}
+
+// G-buffer (PackGBuffer)
+Texture2D<float4>   gPos;
+Texture2D<float4>   gNorm;
+RWTexture2D<uint4>  gPackedGBufferOut;
+
+// Filter input and output
+Texture2D<uint4>    gPackedGBuffer;
+Texture2D<float4>   gColorIn;
+RWTexture2D<float4> gColorOut;
+
+// AtrousFused's cache:  the tile and its apron, and the step 1 result the step 2 iteration reads
+groupshared float3 sColor[REGION_SIZE * REGION_SIZE];
+groupshared uint4  sGBuffer[REGION_SIZE * REGION_SIZE];
+groupshared float3 sFiltered[FILTERED_SIZE * FILTERED_SIZE];
+
+// The center pixel, unpacked once
+struct CenterPixel
+{
+	float3 color;
+	float3 pos;
+	float3 norm;
+};
+
+CenterPixel loadCenter(float3 color, uint4 gBuffer)
+{
+	CenterPixel center;
+	center.color = color;
+	center.pos = asfloat(gBuffer.xyz);
+	center.norm = float3(atrousUnpackNormalX(gBuffer.w), atrousUnpackNormalY(gBuffer.w), atrousUnpackNormalZ(gBuffer.w));
+	return center;
+}
+
+// Adds one neighbor (color and packed G-buffer) with kernel weight kernelWeight
+void accumulateTap(CenterPixel center, float3 color, uint4 gBuffer, float kernelWeight, inout float3 sum, inout float sumWeights)
+{
+	float3 pos = asfloat(gBuffer.xyz);
+	float colorDist2 = atrousDist2(center.color.x - color.x, center.color.y - color.y, center.color.z - color.z);
+	float normalDist2 = atrousDist2(center.norm.x - atrousUnpackNormalX(gBuffer.w), center.norm.y - atrousUnpackNormalY(gBuffer.w),
+	                                center.norm.z - atrousUnpackNormalZ(gBuffer.w));
+	float positionDist2 = atrousDist2(center.pos.x - pos.x, center.pos.y - pos.y, center.pos.z - pos.z);
+
+	precise float weight = atrousEdgeWeight(colorDist2, normalDist2, positionDist2, gInvColorPhi2, gInvNormalPhi2, gInvPositionPhi2) * kernelWeight;
+	precise float3 newSum = sum + color * weight;
+	precise float newSumWeights = sumWeights + weight;
+	sum = newSum;
+	sumWeights = newSumWeights;
+}
+
+float4 resolve(float3 sum, float sumWeights)
+{
+	precise float3 result = sum * atrousRcp(sumWeights);
+	return float4(result, 1.f);
+}
+
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void PackGBuffer(uint3 dispatchId : SV_DispatchThreadID)
+{
+	uint2 pixel = dispatchId.xy;
+	if (any(pixel >= gScreenSize)) return;
+
+	float3 pos = gPos[pixel].xyz;
+	float3 norm = gNorm[pixel].xyz;
+	gPackedGBufferOut[pixel] = uint4(asuint(pos), atrousPackNormal(norm.x, norm.y, norm.z));
+}
+
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void AtrousFused(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)
+{
+	int2 tileOrigin = int2(groupId.xy) * TILE_SIZE;
+	int2 regionOrigin = tileOrigin - ATROUS_FUSED_APRON;
+	int2 maxPixel = int2(gScreenSize) - 1;
+	uint thread = threadId.y * TILE_SIZE + threadId.x;
+
+	// Cache the tile and its apron.  Off-screen pixels hold their clamped neighbor, just as the filter clamps its taps.
+	for (uint i = thread; i < REGION_SIZE * REGION_SIZE; i += TILE_SIZE * TILE_SIZE)
+	{
+		int2 pixel = clamp(regionOrigin + int2(i % REGION_SIZE, i / REGION_SIZE), 0, maxPixel);
+		sColor[i] = gColorIn[pixel].xyz;
+		sGBuffer[i] = gPackedGBuffer[pixel];
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	// Step 1 over the tile, and when fusing, also over the pixels around it that step 2 reads.  Those off screen
+	//     get the result of the pixel they clamp to (filtered around that pixel, not around themselves).
+	int apron = (gFusedIterations > 1) ? FILTERED_APRON : 0;
+	int size = TILE_SIZE + 2 * apron;
+	for (uint j = thread; j < uint(size * size); j += TILE_SIZE * TILE_SIZE)
+	{
+		int2 target = tileOrigin - apron + int2(j % uint(size), j / uint(size));
+		int2 pixel = clamp(target, 0, maxPixel);
+		int2 local = pixel - regionOrigin;
+
+		CenterPixel center = loadCenter(sColor[local.y * REGION_SIZE + local.x], sGBuffer[local.y * REGION_SIZE + local.x]);
+		precise float3 sum = float3(0.f, 0.f, 0.f);
+		precise float sumWeights = 0.f;
+		for (int dy = -2; dy <= 2; dy++)
+		{
+			for (int dx = -2; dx <= 2; dx++)
+			{
+				int tap = (local.y + dy) * REGION_SIZE + (local.x + dx);
+				accumulateTap(center, sColor[tap], sGBuffer[tap], kAtrousKernel[dy + 2] * kAtrousKernel[dx + 2], sum, sumWeights);
+			}
+		}
+
+		float4 result = resolve(sum, sumWeights);
+		if (gFusedIterations > 1) sFiltered[j] = result.xyz;
+		else if (all(target <= maxPixel)) gColorOut[target] = result;
+	}
+	if (gFusedIterations < 2) return;
+	GroupMemoryBarrierWithGroupSync();
+
+	// Step 2 over the tile, from step 1's result
+	int2 pixel = tileOrigin + int2(threadId.xy);
+	if (any(pixel > maxPixel)) return;
+
+	int2 filtered = int2(threadId.xy) + FILTERED_APRON;
+	int2 local = int2(threadId.xy) + ATROUS_FUSED_APRON;
+	CenterPixel center = loadCenter(sFiltered[filtered.y * FILTERED_SIZE + filtered.x], sGBuffer[local.y * REGION_SIZE + local.x]);
+	precise float3 sum = float3(0.f, 0.f, 0.f);
+	precise float sumWeights = 0.f;
+	for (int dy = -2; dy <= 2; dy++)
+	{
+		for (int dx = -2; dx <= 2; dx++)
+		{
+			int2 f = filtered + 2 * int2(dx, dy);
+			int2 g = local + 2 * int2(dx, dy);
+			accumulateTap(center, sFiltered[f.y * FILTERED_SIZE + f.x], sGBuffer[g.y * REGION_SIZE + g.x], kAtrousKernel[dy + 2] * kAtrousKernel[dx + 2], sum, sumWeights);
+		}
+	}
+	gColorOut[pixel] = resolve(sum, sumWeights);
+}
+
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void AtrousIteration(uint3 dispatchId : SV_DispatchThreadID)
+{
+	int2 pixel = int2(dispatchId.xy);
+	int2 maxPixel = int2(gScreenSize) - 1;
+	if (any(pixel > maxPixel)) return;
+
+	CenterPixel center = loadCenter(gColorIn[pixel].xyz, gPackedGBuffer[pixel]);
+	precise float3 sum = float3(0.f, 0.f, 0.f);
+	precise float sumWeights = 0.f;
+	for (int dy = -2; dy <= 2; dy++)
+	{
+		for (int dx = -2; dx <= 2; dx++)
+		{
+			int2 tap = clamp(pixel + int2(dx, dy) * int(gStepSize), 0, maxPixel);
+			accumulateTap(center, gColorIn[tap].xyz, gPackedGBuffer[tap], kAtrousKernel[dy + 2] * kAtrousKernel[dx + 2], sum, sumWeights);
+		}
+	}
+	gColorOut[pixel] = resolve(sum, sumWeights);
+}
@@ -18,6 +18,7 @@
 #include "HostDeviceSharedMacros.h"
 #include "HostDeviceData.h"
 #include "simpleGIUtils.hlsli"
+#include "reprojection.hlsli"
 
 #define PI                 3.14159265f
 
@@ -37,6 +38,8 @@ shared cbuffer GlobalCB
 	float gPositionPhi;
 	uint  gIter;
 	uint  gTotalIter;
+	bool  gTemporalFilter;    // Accumulate reprojected history before the first a-trous iteration
+	uint  gTemporalHistory;   // Most frames of history each pixel keeps
 }
 
 // Input and output textures
@@ -47,6 +50,12 @@ shared RWTexture2D<float4> gOutput;        // Output to store final denoised res
 shared RWTexture2D<float4> gDenoiseIn;     // Store intermediate denoised result
 shared RWTexture2D<float4> gDenoiseOut;    // Store intermediate denoised result
 
+// Temporal accumulation
+shared Texture2D<float4>   gMotion;              // Motion vectors into last frame (see reprojection.hlsli)
+shared Texture2D<float4>   gPrevNorm;            // Last frame's G-buffer normal, to reject disocclusions
+shared RWTexture2D<float4> gDenoiseHistory;      // Accumulated color (rgb) and number of frames in it (a)
+shared Texture2D<float4>   gPrevDenoiseHistory;  // Last frame's
+
 // Environment map
 shared Texture2D<float4>   gEnvMap;
 
@@ -62,6 +71,27 @@ static const float kernel[25] = { 1.f / 256.f, 1.f / 64.f, 3.f / 128.f, 1.f / 64
 								  1.f / 64.f, 1.f / 16.f, 3.f / 32.f, 1.f / 16.f, 1 / 64.f,
 								  1.f / 256.f, 1.f / 64.f, 3.f / 128.f, 1.f / 64.f, 1.f / 256.f };
 
+[shader("raygeneration")]
+void TemporalAccumulationRayGen()
+{
+	// Get our pixel's position on the screen
+	uint2 pixelIndex = DispatchRaysIndex().xy;
+	uint2 dim = DispatchRaysDimensions().xy;
+
+	// Blend with the pixel that saw the same surface last frame, if any
+	float3 col = gShadedOutput[pixelIndex].xyz;
+	float count = 0.f;
+	uint2 prevIndex;
+	if (reprojectPixel(pixelIndex, dim, gMotion[pixelIndex], gNorm[pixelIndex].xyz, gPrevNorm, prevIndex))
+	{
+		float4 prev = gPrevDenoiseHistory[prevIndex];
+		count = min(prev.w, float(gTemporalHistory));
+		col = (count * prev.xyz + col) / (count + 1.f);
+	}
+
+	gDenoiseHistory[pixelIndex] = float4(col, count + 1.f);
+}
+
 [shader("raygeneration")]
 void DenoisingRayGen()
 {
@@ -77,7 +107,7 @@ void DenoisingRayGen()
 		// Read G-buffer data
 		float4 pos = gPos[pixelIndex];
 		float4 norm = gNorm[pixelIndex];
-		float4 col = gShadedOutput[pixelIndex];
+		float4 col = gTemporalFilter ? gDenoiseHistory[pixelIndex] : gShadedOutput[pixelIndex];
 
 		if (gIter != 0) {
 			col = gDenoiseOut[pixelIndex];
@@ -100,7 +130,7 @@ void DenoisingRayGen()
 
 			// Color
 			if (gIter == 0) {
-				col_n = gShadedOutput[uv].xyz;
+				col_n = gTemporalFilter ? gDenoiseHistory[uv].xyz : gShadedOutput[uv].xyz;
 			}
 			else {
 				col_n = gDenoiseOut[uv].xyz;
@@ -1,6 +1,9 @@
 #include "HostDeviceSharedMacros.h"
 #include "HostDeviceData.h"
 #include "simpleGIUtils.hlsli"
+#include "restirUtils.hlsli"
+#include "regirUtils.hlsli"
+#include "shadowRay.hlsli"
 
 // Include and import common Falcor utilities and data structures
 import Raytracing;                   // Shared ray tracing specific functions & data
@@ -8,25 +11,41 @@ import ShaderCommon;                 // Shared shading data structures
 import Shading;                      // Shading functions, etc     
 import Lights;                       // Light structures for our current scene
 
-// Input and output textures
-//shared Texture2D<float4>   gLightGridPrev; // Track grid history for temporal reuse (TODO: make extendable to GRID_HISTORY_LENGTH)
-RWTexture2D<float4> gLightGrid;     // ReGIR grid structure to hold light reservoirs (numCells x numReservoirsPerCell)
-//shared RWTexture2D<float4> gOutput;        // Output to store shaded result
+shared cbuffer GlobalCB
+{
+	uint   gFrameCount;      // Frame counter to act as random seed 
+	float3 gGridOrigin;      // World-space corner of the grid
+	float3 gGridCellSize;    // World-space size of a cell
+	int3   gGridCellCount;   // Cells along each axis
+	uint   gGridLightsPerCell; // Light slots per cell
+	int    gCellCandidates;  // RIS candidates per light slot
+}
+
+// ReGIR grid structure to hold light reservoirs (numCells x numReservoirsPerCell)
+shared RWBuffer<float4> gLightGrid;
 
-[numthreads(256, 1, 1)]
-void main(uint lightSlot : SV_DispatchThreadID)
+// Launched over (gGridLightsPerCell, numCells):  one thread per light slot
+[shader("raygeneration")]
+void BuildCellReservoirsRayGen()
 {
-	//// One thread per light slot (reservoir) in grid cell
-	//// Find center of grid cell in which sample belongs
-	//int gridCellLinearIndex = lightSlot / gGridLightsPerCell;
-	//float3 gridCellCenter = mapCellIndexToWorld(gridCellLinearIndex);
+	uint2 launchIndex = DispatchRaysIndex().xy;
+	uint lightSlot = launchIndex.x + gGridLightsPerCell * launchIndex.y;
+
+	LightGrid grid = { gGridOrigin, gGridCellSize, gGridCellCount, gGridLightsPerCell };
+
+	// Initialize random number generator
+	uint randSeed = initRand(lightSlot, gFrameCount, 16);
+
+	// Find center of grid cell in which sample belongs
+	int gridCellLinearIndex = int(launchIndex.y);
+	float3 gridCellCenter = mapCellIndexToWorld(gridCellLinearIndex, grid);
 
-	//// Select light sample to be stored in light slot
-	//Reservoir lightSlotReservoir = sampleLightRIS(gridCellCenter);
-	//lightSlotReservoir.totalWeight /= lightSlotReservoir.M;
-	//lightSlotReservoir.M = 1;
+	// Select light sample to be stored in light slot
+	Reservoir lightSlotReservoir = { 0, 0, 0, 0 };
+	if (gLightsCount > 0) {
+		lightSlotReservoir = sampleLightsRIS(gridCellCenter, grid, gLightsCount, gCellCandidates, randSeed);
+	}
 
 	// Store in grid
-	//gLightGrid[gridCellLinearIndex][lightSlot] = lightSlotReservoir;
-	gLightGrid[0] = float4(1.0, 0.0, 0.0, 1.0);
-}
\ No newline at end of file
+	gLightGrid[lightSlot] = float4(lightSlotReservoir.y, lightSlotReservoir.M, lightSlotReservoir.W, lightSlotReservoir.wSum);
+}
@@ -0,0 +1,180 @@
+// ReSTIR GI, stage 1:  each pixel traces one cosine-distributed bounce ray (as fullGI.hlsl does), turns the point it hits
+//     into a GI reservoir, and, with temporal reuse, merges it with last frame's reservoir at the reprojected pixel.
+
+#include "HostDeviceSharedMacros.h"
+#include "HostDeviceData.h"
+#include "simpleGIUtils.hlsli"
+#include "shadowRay.hlsli"
+#include "reprojection.hlsli"
+#include "restirGIUtils.hlsli"
+
+// Include and import common Falcor utilities and data structures
+import Raytracing;                   // Shared ray tracing specific functions & data
+import ShaderCommon;                 // Shared shading data structures
+import Shading;                      // Shading functions, etc
+import Lights;                       // Light structures for our current scene
+
+shared cbuffer GlobalCB
+{
+	float gMinT;             // Avoid ray self-intersection
+	uint  gFrameCount;       // Frame counter to act as random seed
+	uint  gMaxDepth;         // Bounces to the sample point and beyond (1:  just direct lighting at the sample point)
+	float gMaxTemporalM;     // Cap on the samples last frame's reservoir brings along
+	bool  gEnableReSTIRGI;   // Otherwise keep just the new sample (fullGI.hlsl's estimate)
+	bool  gDoTemporalReuse;
+	bool  gEnvInDirectLighting;   // Direct lighting samples the environment map (see EnvMapSampler), so bounces that miss bring nothing
+}
+
+// Input textures
+shared Texture2D<float4>   gPos;           // G-buffer world-space position
+shared Texture2D<float4>   gNorm;          // G-buffer world-space normal
+shared Texture2D<float4>   gPrevNorm;      // Last frame's, to judge reprojection
+shared Texture2D<float4>   gMotion;        // Motion vectors into last frame (see reprojection.hlsli)
+
+// GI reservoirs (see ReservoirStore)
+shared RWStructuredBuffer<PackedGIReservoir> gGICurrReservoirBuffer;   // Output:  this frame's reservoirs
+shared RWStructuredBuffer<PackedGIReservoir> gGIPrevReservoirBuffer;   // Last frame's, for temporal reuse
+
+// Environment map
+shared Texture2D<float4>   gEnvMap;
+
+struct GISampleRayPayload
+{
+	float3 hitPos;
+	float3 hitNorm;
+	float3 diffuse;
+	float  hitT;      // Negative on a miss
+};
+
+[shader("miss")]
+void GISampleMiss(inout GISampleRayPayload rayData)
+{
+	rayData.hitT = -1.f;
+}
+
+[shader("anyhit")]
+void GISampleAnyHit(inout GISampleRayPayload rayData, BuiltInTriangleIntersectionAttributes attribs)
+{
+	// If we hit a transparent texel, ignore the hit; otherwise, accept
+	if (alphaTestFails(attribs)) IgnoreHit();
+}
+
+[shader("closesthit")]
+void GISampleClosestHit(inout GISampleRayPayload rayData, BuiltInTriangleIntersectionAttributes attribs)
+{
+	// Just record the hit; the ray generation shader shades it
+	ShadingData shadeData = getHitShadingData(attribs);
+	rayData.hitPos = shadeData.posW;
+	rayData.hitNorm = shadeData.N;
+	rayData.diffuse = shadeData.diffuse;
+	rayData.hitT = RayTCurrent();
+}
+
+bool traceGISampleRay(float3 origin, float3 direction, out GISampleRayPayload rayData)
+{
+	RayDesc ray;
+	ray.Origin = origin;
+	ray.Direction = direction;
+	ray.TMin = gMinT;
+	ray.TMax = 1e+38f;
+
+	rayData.hitPos = float3(0.f, 0.f, 0.f);
+	rayData.hitNorm = float3(0.f, 0.f, 0.f);
+	rayData.diffuse = float3(0.f, 0.f, 0.f);
+	rayData.hitT = -1.f;
+
+	// Trace ray (using hit group and miss shader #1)
+	TraceRay(gRtScene, 0, 0xFF, 1, hitProgramCount, 1, ray, rayData);
+	return rayData.hitT >= 0.f;
+}
+
+float3 envMapRadiance(float3 direction)
+{
+	float2 dim;
+	gEnvMap.GetDimensions(dim.x, dim.y);
+	float2 uv = wsVectorToLatLong(direction);
+	return gEnvMap[uint2(uv * dim)].rgb;
+}
+
+// Radiance leaving a bounce ray's hit toward the ray's origin:  direct lighting there, plus gMaxDepth - 1 further
+//     diffuse bounces, each adding its own direct lighting (or the environment map, when it misses).  This is what
+//     fullGI.hlsl's IndirectClosestHit returns.
+float3 getSampleRadiance(inout uint randSeed, GISampleRayPayload hit)
+{
+	float3 radiance = giDirectLighting(randSeed, hit.hitPos, hit.hitNorm, hit.diffuse, gMinT);
+	float3 throughput = float3(1.f, 1.f, 1.f);
+	for (uint depth = 1; depth < gMaxDepth; depth++)
+	{
+		throughput *= hit.diffuse;
+		float3 wi = getCosHemisphereSample(randSeed, hit.hitNorm);
+		if (!traceGISampleRay(hit.hitPos, wi, hit))
+		{
+			radiance += throughput * envMapRadiance(wi);
+			break;
+		}
+		radiance += throughput * giDirectLighting(randSeed, hit.hitPos, hit.hitNorm, hit.diffuse, gMinT);
+	}
+	return radiance;
+}
+
+[shader("raygeneration")]
+void CreateGISamplesRayGen()
+{
+	// Get our pixel's position on the screen
+	uint2 pixelIndex = DispatchRaysIndex().xy;
+	uint2 dim = DispatchRaysDimensions().xy;
+	uint index = giReservoirIndex(pixelIndex, dim);
+
+	// Read G-buffer data
+	float4 worldPos = gPos[pixelIndex];
+	float4 worldNorm = gNorm[pixelIndex];
+
+	GIReservoir reservoir = emptyGIReservoir();
+	if (worldPos.w == 0)
+	{
+		gGICurrReservoirBuffer[index] = packGIReservoir(reservoir);
+		return;
+	}
+	reservoir.visiblePos = worldPos.xyz;
+	reservoir.visibleNorm = worldNorm.xyz;
+
+	// Initialize random number generator
+	uint randSeed = initRand(pixelIndex.x + dim.x * pixelIndex.y, gFrameCount, 16);
+
+	// New sample:  one bounce in a cosine-distributed direction.  Misses become a far-away sample point facing us.
+	float3 wi = getCosHemisphereSample(randSeed, worldNorm.xyz);
+	GIReservoir candidate = emptyGIReservoir();
+	candidate.M = 1.f;
+	GISampleRayPayload hit;
+	if (traceGISampleRay(worldPos.xyz, wi, hit))
+	{
+		candidate.samplePos = hit.hitPos;
+		candidate.sampleNorm = hit.hitNorm;
+		candidate.radiance = getSampleRadiance(randSeed, hit);
+	}
+	else
+	{
+		candidate.samplePos = worldPos.xyz + wi * GI_SKY_DISTANCE;
+		candidate.sampleNorm = -wi;
+		candidate.radiance = gEnvInDirectLighting ? float3(0.f, 0.f, 0.f) : envMapRadiance(wi);
+	}
+
+	float pdf = saturate(dot(worldNorm.xyz, wi)) / M_PI;
+	float p_hat = giTargetFunction(candidate.radiance, worldPos.xyz, worldNorm.xyz, candidate.samplePos);
+	mergeGIReservoir(reservoir, candidate, (pdf > 0.f) ? p_hat / pdf : 0.f, randSeed);
+
+	// Temporal reuse:  last frame's reservoir reconnects from its visible point to ours
+	uint2 prevIndex;
+	if (gEnableReSTIRGI && gDoTemporalReuse && reprojectPixel(pixelIndex, dim, gMotion[pixelIndex], worldNorm.xyz, gPrevNorm, prevIndex))
+	{
+		GIReservoir prevReservoir = unpackGIReservoir(gGIPrevReservoirBuffer[giReservoirIndex(prevIndex, dim)]);
+		prevReservoir.M = min(gMaxTemporalM, prevReservoir.M);
+
+		float jacobian = giReconnectionJacobian(worldPos.xyz, prevReservoir.visiblePos, prevReservoir.samplePos, prevReservoir.sampleNorm);
+		p_hat = giTargetFunction(prevReservoir.radiance, worldPos.xyz, worldNorm.xyz, prevReservoir.samplePos);
+		mergeGIReservoir(reservoir, prevReservoir, p_hat * jacobian * prevReservoir.W * prevReservoir.M, randSeed);
+	}
+
+	finalizeGIReservoir(reservoir);
+	gGICurrReservoirBuffer[index] = packGIReservoir(reservoir);
+}
@@ -18,8 +18,11 @@
 #include "HostDeviceSharedMacros.h"
 #include "HostDeviceData.h"
 #include "restirUtils.hlsli"
+#include "lightBvh.hlsli"
 #include "simpleGIUtils.hlsli"
 #include "shadowRay.hlsli"
+#include "reprojection.hlsli"
+#include "SampleSequences.h"
 
 #define PI 3.14159265f
 
@@ -31,7 +34,6 @@ import Lights;                       // Light structures for our current scene
 
 shared cbuffer GlobalCB
 {
-	float4x4 gLastCameraMatrix;
 	float gMinT;          // Avoid ray self-intersection
 	uint  gFrameCount;    // Frame counter to act as random seed 
 	uint  gMaxDepth;      // Max recursion depth
@@ -43,6 +45,10 @@ shared cbuffer GlobalCB
 	bool  gEnableWeightedRIS;
 	bool  gDoVisibilityReuse;
 	bool  gDoTemporalReuse;
+	uint  gLightSelection;  // How RIS candidates are picked (LIGHT_SELECTION_*)
+	bool  gUnbiased;             // Normalize temporal reuse by the pixels that could have produced the sample (1/Z)
+	bool  gUnbiasedVisibility;   // ... tracing a shadow ray from each of them to tell
+	uint  gSamplerType;          // Sequence behind the candidates and reuse decisions (SAMPLER_*)
 }
 
 // Input and output textures
@@ -50,12 +56,25 @@ shared Texture2D<float4>   gPos;           // G-buffer world-space position
 shared Texture2D<float4>   gNorm;          // G-buffer world-space normal
 shared Texture2D<float4>   gDiffuseMtl;    // G-buffer diffuse material
 shared Texture2D<float4>   gEmissive;
-shared RWTexture2D<float4> gCurrReservoirs;        // Output to store shaded result
-shared RWTexture2D<float4> gPrevReservoirs;        // Output to store shaded result
+shared Texture2D<float4>   gPrevPos;          // Last frame's G-buffer, for the unbiased temporal weights
+shared Texture2D<float4>   gPrevNorm;
+shared Texture2D<float4>   gPrevDiffuseMtl;
+shared Texture2D<float4>   gMotion;           // Motion vectors into last frame (see reprojection.hlsli)
+shared RWTexture2D<float4> gCurrReservoirs;        // Output to store shaded result (without ReSTIR)
+
+// Per-pixel reservoirs (see ReservoirStore)
+shared RWStructuredBuffer<PackedReservoir> gCurrReservoirBuffer;   // Output:  this frame's reservoirs
+shared RWStructuredBuffer<PackedReservoir> gPrevReservoirBuffer;   // Last frame's, for temporal reuse
 
 // Environment map
 shared Texture2D<float4>   gEnvMap;
 
+// Power-based light selection table (see LightAliasTable)
+shared StructuredBuffer<LightAliasEntry> gLightAliasTable;
+
+// Light BVH for picking lights by estimated contribution (see LightBvh)
+shared StructuredBuffer<LightBvhNode> gLightBvh;
+
 struct IndirectRayPayload
 {
 	float3 color;
@@ -111,10 +130,11 @@ float3 shootIndirectRay(float3 rayOrigin, float3 rayDir, float minT, uint seed,
 	return rayData.color;
 }
 
-float3 lambertianDirect(inout uint rndSeed, float3 hit, float3 norm, float3 diffuseColor)
+// Direct lighting from a single light, picked by the uniform number u
+float3 lambertianDirect(float u, float3 hit, float3 norm, float3 diffuseColor)
 {
 	// Pick a single random light to sample
-	int light = min(int(nextRand(rndSeed) * gLightsCount), gLightsCount - 1);
+	int light = min(int(u * gLightsCount), gLightsCount - 1);
 
 	// Query scene to get information about current light
 	float dist;
@@ -159,7 +179,7 @@ void IndirectClosestHit(inout IndirectRayPayload rayData, BuiltInTriangleInterse
 	// Direct illumination
 	if (gDoDirectLighting)
 	{
-		rayData.color += lambertianDirect(rayData.randSeed, shadeData.posW, shadeData.N, shadeData.diffuse);
+		rayData.color += lambertianDirect(nextRand(rayData.randSeed), shadeData.posW, shadeData.N, shadeData.diffuse);
 	}
 
 	// Indirect illumination
@@ -169,23 +189,82 @@ void IndirectClosestHit(inout IndirectRayPayload rayData, BuiltInTriangleInterse
 	}
 }
 
-uint2 pickTemporalNeighbor(float4 worldPos, uint2 pixelIndex, uint2 dim) 
+// Walk the light BVH from the root, picking each child by its estimated contribution.  Returns the light's probability in pdf (0 if none can contribute).
+//     Level l of the walk draws point <index> of domain SAMPLE_DOMAIN_LIGHT_TREE + l.
+int sampleLightBvh(float3 posW, float3 N, PixelSampler pixelSampler, uint index, out float pdf)
 {
-	if (gFrameCount > 0)
+	pdf = 1.f;
+	uint nodeIndex = 0;
+	uint level = 0;
+	LightBvhNode node = gLightBvh[0];
+	while ((node.data & LIGHT_BVH_LEAF) == 0)
 	{
-		float4 prevScreenPos = mul(worldPos, gLastCameraMatrix);
-		prevScreenPos /= prevScreenPos.w;
+		LightBvhNode left = gLightBvh[nodeIndex + 1];
+		LightBvhNode right = gLightBvh[node.data];
+		float leftImportance = lightBvhImportance(left, posW, N);
+		float rightImportance = lightBvhImportance(right, posW, N);
+		float total = leftImportance + rightImportance;
+		if (total <= 0.f) { pdf = 0.f; return 0; }
+
+		if (pixelSample(pixelSampler, SAMPLE_DOMAIN_LIGHT_TREE + level++, index, 0) < leftImportance / total) {
+			nodeIndex = nodeIndex + 1;
+			node = left;
+			pdf *= leftImportance / total;
+		}
+		else {
+			nodeIndex = node.data;
+			node = right;
+			pdf *= rightImportance / total;
+		}
+	}
+	return int(node.data & ~LIGHT_BVH_LEAF);
+}
 
-		uint2 prevIndex = pixelIndex;
-		prevIndex.x = ((prevScreenPos.x + 1.f) * 0.5f) * (float)dim.x;
-		prevIndex.y = ((1.f - prevScreenPos.y) * 0.5f) * (float)dim.y;
+// Pick RIS candidate <index> of our pixel from the scene's lights and return its probability in p
+int sampleSceneLight(float3 posW, float3 N, PixelSampler pixelSampler, uint index, out float p)
+{
+	if (gLightSelection == LIGHT_SELECTION_BVH)
+	{
+		return sampleLightBvh(posW, N, pixelSampler, index, p);
+	}
 
-		if (prevIndex.x >= 0 && prevIndex.x < dim.x && prevIndex.y >= 0 && prevIndex.y < dim.y) {
-			return prevIndex;
-		}
+	int light = min(int(pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE, index, 0) * gLightsCount), gLightsCount - 1);
+	p = 1.f / float(gLightsCount);
+
+	if (gLightSelection == LIGHT_SELECTION_ALIAS_TABLE)
+	{
+		LightAliasEntry entry = gLightAliasTable[light];
+		if (pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE_ALIAS, index, 0) >= entry.prob) light = int(entry.alias);
+		p = gLightAliasTable[light].pdf;
 	}
+	return light;
+}
 
-	return uint2(-1, -1);
+// Pick RIS candidate <index> of our pixel from our source distribution and return its probability in p:  a point on an
+//     emissive triangle (as id EMISSIVE_ID_BASE + point, see emissiveLights.hlsli), a cell of the environment map (as
+//     id gLightsCount + cell, see envMapSampling.hlsli) or one of the scene's lights
+int sampleSourceLight(float3 posW, float3 N, PixelSampler pixelSampler, uint index, out float p)
+{
+	float2 u = float2(pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE, index, 0), pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE, index, 1));
+	float emissiveProb = emissiveCandidateProb();
+	if (emissiveProb > 0.f && pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE_EMISSIVE, index, 0) < emissiveProb)
+	{
+		uint pointIndex = sampleEmissivePoint(u, pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE_ALIAS, index, 0), p);
+		p *= emissiveProb;
+		return int(EMISSIVE_ID_BASE + pointIndex);
+	}
+
+	float envProb = envCandidateProb();
+	if (envProb > 0.f && pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE_ENV, index, 0) < envProb)
+	{
+		uint cell = sampleEnvCell(u, p);
+		p *= envProb * (1.f - emissiveProb);
+		return int(gLightsCount + cell);
+	}
+
+	int light = sampleSceneLight(posW, N, pixelSampler, index, p);
+	p *= (1.f - envProb) * (1.f - emissiveProb);
+	return light;
 }
 
 [shader("raygeneration")]
@@ -203,36 +282,56 @@ void CreateLightSamplesRayGen()
 
 	float3 albedo = gBuffer.color.rgb;
 
-	// Initialize random number generator
-	uint randSeed = initRand(pixelIndex.x + dim.x * pixelIndex.y, gFrameCount, 16);
+	// Each frame draws the next points of the pixel's sequences (see SampleSequences.h)
+	PixelSampler pixelSampler = createPixelSampler(gSamplerType, pixelIndex.x, pixelIndex.y);
 
-	Reservoir reservoir = { 0, 0, 0, 0 };
 	float3 shadeColor = float3(0.f, 0.f, 0.f);
-	if (gBuffer.pos.w != 0)
+	if (gBuffer.pos.w == 0)
+	{
+		shadeColor = albedo;
+	}
+	else if (!gEnableWeightedRIS)
 	{
-		// To hold information about current light
-		float dist;
-		float3 lightIntensity;
-		float3 lightDirection;
+		shadeColor += lambertianDirect(pixelSample(pixelSampler, SAMPLE_DOMAIN_DIRECT_LIGHT, gFrameCount, 0), gBuffer.pos.xyz, gBuffer.norm.xyz, gBuffer.color.rgb);
+	}
+
+	gCurrReservoirs[pixelIndex] = float4(shadeColor, 1.f);
+	if (!gEnableWeightedRIS) return;
+
+	// Follow the motion vector into last frame, unless it saw a different surface there
+	uint2 prevIndex;
+	reprojectPixel(pixelIndex, dim, gMotion[pixelIndex], gBuffer.norm.xyz, gPrevNorm, prevIndex);
 
-		if (gEnableWeightedRIS)
+	// Each of our reservoirs goes through RIS, visibility reuse and temporal reuse on its own
+	for (uint k = 0; k < RESERVOIRS_PER_PIXEL; k++)
+	{
+		Reservoir reservoir = { 0, 0, 0, 0 };
+		uint reservoirFrame = gFrameCount * RESERVOIRS_PER_PIXEL + k;
+		if (gBuffer.pos.w != 0)
 		{
+			// To hold information about current light
+			float dist;
+			float3 lightIntensity;
+			float3 lightDirection;
+
 			float cosTheta = 0.f;
 			float p_hat = 0.f;
 
 			// 1. WEIGHTED RIS: Generate initial candidate light samples (M = 32)
-			for (int i = 0; i < min(gLightsCount, gLightSamples); i++) {
+			int candidates = int((envSamplingEnabled() || emissiveSamplingEnabled()) ? gLightSamples : min(gLightsCount, gLightSamples));
+			for (int i = 0; i < candidates; i++) {
 				// Randomly pick a light to sample
-				int light = min(int(nextRand(randSeed) * gLightsCount), gLightsCount - 1);
-				getLightData(light, gBuffer.pos.xyz, lightDirection, lightIntensity, dist);
+				float p;
+				uint candidateIndex = reservoirFrame * gLightSamples + i;
+				int light = sampleSourceLight(gBuffer.pos.xyz, gBuffer.norm.xyz, pixelSampler, candidateIndex, p);
+				getCandidateLightData(light, gBuffer.pos.xyz, lightDirection, lightIntensity, dist);
 
 				// Calcuate light weight based on BRDF and PDF
-				float p = 1.f / float(gLightsCount);
 				cosTheta = saturate(dot(gBuffer.norm.xyz, lightDirection));
 
 				// Evaluate p_hat
 				p_hat = evaluateBSDF(gBuffer.color.rgb, lightIntensity, cosTheta, dist);
-				updateReservoir(reservoir, float(light), p_hat / p, randSeed);
+				updateReservoir(reservoir, float(light), (p > 0.f) ? p_hat / p : 0.f, pixelSample(pixelSampler, SAMPLE_DOMAIN_CANDIDATE_RIS, candidateIndex, 0));
 			}
 
 			// Calculate p_hat(r.y) for reservoir's light
@@ -262,18 +361,17 @@ void CreateLightSamplesRayGen()
 
 				// Get previous reservoir
 				Reservoir prev_reservoir = { 0, 0, 0, 0 };
-				uint2 prevIndex = pickTemporalNeighbor(gBuffer.pos, pixelIndex, dim);
 				if (prevIndex.x != -1 && prevIndex.y != -1) {
-					prev_reservoir = createReservoir(gPrevReservoirs[prevIndex]);
+					prev_reservoir = unpackReservoir(gPrevReservoirBuffer[reservoirIndex(prevIndex, dim, k)]);
 				}
 
 				// Add current reservoir
-				updateReservoir(tempReservoir, reservoir.y, p_hat * reservoir.W * reservoir.M, randSeed);
+				updateReservoir(tempReservoir, reservoir.y, p_hat * reservoir.W * reservoir.M, pixelSample(pixelSampler, SAMPLE_DOMAIN_TEMPORAL_RIS, 2 * reservoirFrame, 0));
 
 				// Add previous reservoir
 				p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, prev_reservoir.y);
 				prev_reservoir.M = min(20.f * reservoir.M, prev_reservoir.M);
-				updateReservoir(tempReservoir, prev_reservoir.y, p_hat * prev_reservoir.W * prev_reservoir.M, randSeed);
+				updateReservoir(tempReservoir, prev_reservoir.y, p_hat * prev_reservoir.W * prev_reservoir.M, pixelSample(pixelSampler, SAMPLE_DOMAIN_TEMPORAL_RIS, 2 * reservoirFrame + 1, 0));
 
 				// Update M
 				tempReservoir.M = reservoir.M + prev_reservoir.M;
@@ -284,47 +382,36 @@ void CreateLightSamplesRayGen()
 				if (p_hat == 0.f) {
 					tempReservoir.W = 0.f;
 				}
-				else {
-#ifdef BIASED
+				else if (!gUnbiased) {
 					tempReservoir.W = (1.f / p_hat) * (tempReservoir.wSum / tempReservoir.M);
-#endif
-#ifdef UNBIASED
-					float p_hat_orig = p_hat;
-					float Z = 0.f;
-					uint2 q[2] = { pixelIndex, prevIndex };
-					Reservoir r[2] = { reservoir, prev_reservoir };
-					for (int i = 0; i < 2; i++) {
-						// Get gBuffer data
-						GBuffer pixelGBuffer;
-						pixelGBuffer.pos = gPos[q[i]]; // TODO: will need to store previous gBuffer data
-						pixelGBuffer.norm = gNorm[q[i]];
-						pixelGBuffer.color = gDiffuseMtl[q[i]];
-
-						p_hat = evaluatePHat(pixelGBuffer, lightDirection, lightIntensity, dist, tempReservoir.y);
-						if (p_hat > 0) {
-							Z += r[i].M;
+				}
+				else {
+					// Only count the samples of pixels that could have produced tempReservoir.y.  Ours can (p_hat > 0);
+					//     last frame's pixel is judged by last frame's G-buffer, as its samples were drawn there.
+					float Z = reservoir.M;
+					if (prevIndex.x != -1 && prevIndex.y != -1) {
+						GBuffer prevGBuffer;
+						prevGBuffer.pos = gPrevPos[prevIndex];
+						prevGBuffer.norm = gPrevNorm[prevIndex];
+						prevGBuffer.color = gPrevDiffuseMtl[prevIndex];
+
+						float3 prevLightDirection;
+						float3 prevLightIntensity;
+						float prevDist;
+						float prev_p_hat = evaluatePHat(prevGBuffer, prevLightDirection, prevLightIntensity, prevDist, tempReservoir.y);
+						if (prev_p_hat > 0.f && gUnbiasedVisibility) {
+							prev_p_hat *= shadowRayVisibility(prevGBuffer.pos.xyz, prevLightDirection, gMinT, prevDist);
+						}
+						if (prev_p_hat > 0.f) {
+							Z += prev_reservoir.M;
 						}
 					}
-					tempReservoir.W = (1.f / p_hat_orig) * (tempReservoir.wSum / Z);
-#endif
+					tempReservoir.W = (Z > 0.f) ? (1.f / p_hat) * (tempReservoir.wSum / Z) : 0.f;
 				}
 				reservoir = tempReservoir;
-			}				
-		}
-		else
-		{
-			shadeColor += lambertianDirect(randSeed, gBuffer.pos.xyz, gBuffer.norm.xyz, gBuffer.color.rgb);
+			}
 		}
-	}
-	else
-	{
-		shadeColor = albedo;
-	}
 
-	gCurrReservoirs[pixelIndex] = float4(shadeColor, 1.f);
-
-	if (gEnableWeightedRIS)
-	{
-		gCurrReservoirs[pixelIndex] = float4(reservoir.y, reservoir.M, reservoir.W, reservoir.wSum);
+		gCurrReservoirBuffer[reservoirIndex(pixelIndex, dim, k)] = packReservoir(reservoir);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+// Emissive triangles as RIS candidates.  EmissiveLights extracts every triangle with an emissive material (and the
+//     scene's user-defined quad lights) into a flat list, and builds an alias table over it by power:  emitted radiance,
+//     averaged over the triangle, times its area.
+//
+// Candidate ids from EMISSIVE_ID_BASE on are points on those triangles (see EmissiveTriangle.h).  A point acts as a
+//     point light facing along the triangle's normal, standing for area / pointsPerTriangle of it.  To fit
+//     getLightData()'s convention (intensity / dist^2, shadow rays up to dist), dist stops EMISSIVE_SHADOW_OFFSET short
+//     of the point, so its shadow ray can't hit the emitter itself, with the intensity scaled to match.
+//
+// EmissiveLights.h mirrors sampleEmissivePoint() and the point positions on the CPU.
+
+#include "EmissiveTriangle.h"
+
+#define EMISSIVE_SHADOW_OFFSET  1.0e-3f   // Share of the distance the shadow ray stops short of the emitter
+
+// Set by EmissiveLights::setIntoVars()
+shared cbuffer EmissiveLightsCB
+{
+	uint  gEmissiveTriangleCount;       // 0:  don't draw candidates from emissive triangles
+	uint  gEmissivePointsPerTriangle;   // A power of two
+	float gEmissiveCandidateProb;       // Share of the candidates drawn from emissive triangles when there are other lights
+};
+
+shared StructuredBuffer<EmissiveTriangle> gEmissiveTriangles;
+shared StructuredBuffer<LightAliasEntry>  gEmissiveAliasTable;   // Over the triangles
+
+bool emissiveSamplingEnabled()
+{
+	return gEmissiveTriangleCount > 0;
+}
+
+// Probability of drawing a candidate from the emissive triangles instead of the environment map or the scene's lights
+float emissiveCandidateProb()
+{
+	if (!emissiveSamplingEnabled()) return 0.f;
+	return (gLightsCount > 0 || envSamplingEnabled()) ? gEmissiveCandidateProb : 1.f;
+}
+
+// Pick a triangle by power (u.x picks the bucket, uAlias whether to keep its own triangle) and one of its points
+//     uniformly (u.y).  Returns the point's index past EMISSIVE_ID_BASE, and its probability in pdf.
+uint sampleEmissivePoint(float2 u, float uAlias, out float pdf)
+{
+	uint bucket = min(uint(u.x * float(gEmissiveTriangleCount)), gEmissiveTriangleCount - 1);
+	LightAliasEntry entry = gEmissiveAliasTable[bucket];
+	uint triIndex = (uAlias < entry.prob) ? bucket : entry.alias;
+	uint pointIndex = min(uint(u.y * float(gEmissivePointsPerTriangle)), gEmissivePointsPerTriangle - 1);
+	pdf = gEmissiveAliasTable[triIndex].pdf / float(gEmissivePointsPerTriangle);
+	return triIndex * gEmissivePointsPerTriangle + pointIndex;
+}
+
+// getLightData() for a point (see above).  Points of an older build (e.g. in last frame's reservoirs) past the
+//     current triangles deliver nothing.
+void getEmissivePointData(uint pointId, float3 hitPos, out float3 toLight, out float3 lightIntensity, out float distToLight)
+{
+	uint pointsPerTriangle = max(gEmissivePointsPerTriangle, 1);
+	uint triIndex = pointId / pointsPerTriangle;
+	if (triIndex >= gEmissiveTriangleCount) {
+		toLight = float3(0.f, 1.f, 0.f);
+		lightIntensity = float3(0.f, 0.f, 0.f);
+		distToLight = 1.f;
+		return;
+	}
+
+	// Uniform over the triangle's area:  barycentrics (sqrt(u) (1 - v), sqrt(u) v) for edge1 and edge2
+	EmissiveTriangle tri = gEmissiveTriangles[triIndex];
+	uint latticePoint = pointId % pointsPerTriangle;
+	float su = sqrt(emissiveToFloat(emissiveLatticeU(triIndex, latticePoint, pointsPerTriangle)));
+	float v = emissiveToFloat(emissiveLatticeV(triIndex, latticePoint));
+	float3 pos = tri.p0 + tri.edge1 * (su * (1.f - v)) + tri.edge2 * (su * v);
+
+	float3 toPoint = pos - hitPos;
+	float dist = length(toPoint);
+	toLight = (dist > 0.f) ? toPoint / dist : float3(0.f, 1.f, 0.f);
+	distToLight = dist * (1.f - EMISSIVE_SHADOW_OFFSET);
+
+	float3 N = normalize(cross(tri.edge1, tri.edge2));
+	float cosLight = dot(N, -toLight);
+	cosLight = ((tri.radianceB >> 16) & EMISSIVE_FLAG_TWO_SIDED) ? abs(cosLight) : max(cosLight, 0.f);
+	float3 radiance = float3(f16tof32(tri.radianceRG), f16tof32(tri.radianceRG >> 16), f16tof32(tri.radianceB));
+
+	// lightIntensity / distToLight^2 is then radiance * area / points * cosLight / dist^2
+	float shorten = 1.f - EMISSIVE_SHADOW_OFFSET;
+	lightIntensity = radiance * (tri.area / float(pointsPerTriangle)) * cosLight * (shorten * shorten);
+}
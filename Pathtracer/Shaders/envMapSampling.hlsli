@@ -0,0 +1,78 @@
+// Importance sampling of the lat-long environment map as a set of RIS candidates.  EnvMapSampler averages the map down
+//     to a grid of cells, weights each by its luminance times its solid angle, and builds a 2D alias table:  a marginal
+//     table over the rows (entries [0, rows)), followed by each row's table over its columns.
+//
+// Candidate ids past the scene's lights are cells:  id = gLightsCount + cell.  A cell acts as a directional light from
+//     its center, with the cell's average radiance times its solid angle as the irradiance it delivers head-on.  To fit
+//     getLightData()'s point-light convention (intensity / dist^2, shadow rays up to dist), it's placed ENV_LIGHT_DISTANCE
+//     away with the intensity scaled to match.
+//
+// EnvMapSampler.h builds the table and mirrors sampleEnvCell() on the CPU.
+
+#define ENV_LIGHT_DISTANCE  1.0e5f   // Beyond any of our scenes
+
+// Set by EnvMapSampler::setIntoVars()
+shared cbuffer EnvMapSamplingCB
+{
+	uint2 gEnvGridSize;        // Columns and rows of cells.  (0, 0):  don't draw candidates from the map.
+	float gEnvCandidateProb;   // Share of the candidates drawn from the map when the scene has lights
+};
+
+shared StructuredBuffer<LightAliasEntry> gEnvAliasTable;
+shared StructuredBuffer<float4>          gEnvCells;        // rgb:  average radiance, a:  solid angle
+
+bool envSamplingEnabled()
+{
+	return gEnvGridSize.x > 0;
+}
+
+// Probability of drawing a candidate from the map instead of from the scene's lights
+float envCandidateProb()
+{
+	if (!envSamplingEnabled()) return 0.f;
+	return (gLightsCount > 0) ? gEnvCandidateProb : 1.f;
+}
+
+// An alias pick from <count> entries starting at <first>, with one random number:  its integer part picks the bucket,
+//     its fraction whether to keep the bucket's own entry
+uint envAliasPick(uint first, uint count, float u)
+{
+	float scaled = u * float(count);
+	uint bucket = min(uint(scaled), count - 1);
+	LightAliasEntry entry = gEnvAliasTable[first + bucket];
+	return (scaled - float(bucket) < entry.prob) ? bucket : entry.alias;
+}
+
+// Pick a cell with the 2D random point u, and return its probability in pdf
+uint sampleEnvCell(float2 u, out float pdf)
+{
+	uint row = envAliasPick(0, gEnvGridSize.y, u.x);
+	uint rowStart = gEnvGridSize.y + row * gEnvGridSize.x;
+	uint column = envAliasPick(rowStart, gEnvGridSize.x, u.y);
+	pdf = gEnvAliasTable[row].pdf * gEnvAliasTable[rowStart + column].pdf;
+	return row * gEnvGridSize.x + column;
+}
+
+// Inverse of wsVectorToLatLong() in simpleGIUtils.hlsli
+float3 envLatLongToDirection(float2 uv)
+{
+	float phi = (2.f * uv.x - 1.f) * M_PI;
+	float theta = uv.y * M_PI;
+	float sinTheta = sin(theta);
+	return float3(sinTheta * sin(phi), cos(theta), -sinTheta * cos(phi));
+}
+
+// getLightData() for a cell (see above).  Cells of an older grid (e.g. in last frame's reservoirs) deliver nothing.
+void getEnvCellData(uint cell, out float3 toLight, out float3 lightIntensity, out float distToLight)
+{
+	uint2 cellIndex = uint2(cell % max(gEnvGridSize.x, 1), cell / max(gEnvGridSize.x, 1));
+	toLight = envLatLongToDirection((float2(cellIndex) + 0.5f) / float2(max(gEnvGridSize, uint2(1, 1))));
+	distToLight = ENV_LIGHT_DISTANCE;
+	if (cellIndex.y >= gEnvGridSize.y) {
+		lightIntensity = float3(0.f, 0.f, 0.f);
+		return;
+	}
+
+	float4 cellData = gEnvCells[cell];
+	lightIntensity = cellData.rgb * cellData.a * (distToLight * distToLight);
+}
@@ -19,6 +19,7 @@
 #include "HostDeviceData.h"
 #include "simpleGIUtils.hlsli"
 #include "shadowRay.hlsli"
+#include "SampleSequences.h"
 
 // Include and import common Falcor utilities and data structures
 import Raytracing;                   // Shared ray tracing specific functions & data
@@ -34,6 +35,8 @@ shared cbuffer GlobalCB
 	bool  gDoDirectLighting; // Should we shoot shadow rays?
 	uint  gMaxDepth;      // Max recursion depth
 	float gEmitMult;      // Multiply emissive channel by this channel
+	bool  gAdaptive;      // Take as many samples as gSampleCount budgets (the camera stands still)
+	uint  gSamplerType;   // Sequence behind the light picks and bounce directions (SAMPLER_*)
 }
 
 // Input and output textures
@@ -46,10 +49,13 @@ shared RWTexture2D<float4> gOutput;        // Output to store shaded result
 // Environment map
 shared Texture2D<float4>   gEnvMap;
 
+// Samples per pixel budgeted by the accumulation pass (see AdaptiveSampling.h)
+shared Texture2D<float4>   gSampleCount;
+
 struct IndirectRayPayload
 {
 	float3 color;
-	uint randSeed;
+	uint sampleIndex;     // Which of the pixel's paths this is (see SampleSequences.h)
 	uint rayDepth;
 };
 
@@ -73,7 +79,7 @@ void IndirectAnyHit(inout IndirectRayPayload rayData, BuiltInTriangleIntersectio
 	if (alphaTestFails(attribs)) IgnoreHit();
 }
 
-float3 shootIndirectRay(float3 rayOrigin, float3 rayDir, float minT, uint seed, uint curDepth)
+float3 shootIndirectRay(float3 rayOrigin, float3 rayDir, float minT, uint sampleIndex, uint curDepth)
 {
 	// Setup indirect ray
 	RayDesc rayThroughput;
@@ -85,7 +91,7 @@ float3 shootIndirectRay(float3 rayOrigin, float3 rayDir, float minT, uint seed,
 	// Initialize payload
 	IndirectRayPayload rayData;
 	rayData.color = float3(0, 0, 0);
-	rayData.randSeed = seed;
+	rayData.sampleIndex = sampleIndex;
 	rayData.rayDepth = curDepth + 1;
 
 	// Trace ray (using hit group and miss shader #1)
@@ -101,10 +107,11 @@ float3 shootIndirectRay(float3 rayOrigin, float3 rayDir, float minT, uint seed,
 	return rayData.color;
 }
 
-float3 lambertianDirect(inout uint rndSeed, float3 hit, float3 norm, float3 diffuseColor)
+// Direct lighting from a single light, picked by the uniform number u
+float3 lambertianDirect(float u, float3 hit, float3 norm, float3 diffuseColor)
 {
 	// Pick a single random light to sample
-	int light = min(int(nextRand(rndSeed) * gLightsCount), gLightsCount - 1);
+	int light = min(int(u * gLightsCount), gLightsCount - 1);
 
 	// Query scene to get information about current light
 	float dist;
@@ -126,11 +133,13 @@ float3 lambertianDirect(inout uint rndSeed, float3 hit, float3 norm, float3 diff
 	return color;
 }
 
-float3 lambertianIndirect(inout uint rndSeed, float3 hit, float3 norm, float3 diffuseColor, uint depth)
+float3 lambertianIndirect(PixelSampler pixelSampler, uint sampleIndex, float3 hit, float3 norm, float3 diffuseColor, uint depth)
 {
 	// Use cosine-weighted hemisphere sampling to choose random direction
-	float3 wi = getCosHemisphereSample(rndSeed, norm);
-	float3 bounceColor = shootIndirectRay(hit, wi, gMinT, rndSeed, depth);
+	uint domain = SAMPLE_DOMAIN_BOUNCE + 2 * depth;
+	float2 u = float2(pixelSample(pixelSampler, domain, sampleIndex, 0), pixelSample(pixelSampler, domain, sampleIndex, 1));
+	float3 wi = getCosHemisphereSample(u, norm);
+	float3 bounceColor = shootIndirectRay(hit, wi, gMinT, sampleIndex, depth);
 
 	// Attenuate color by indirect color
 	return bounceColor * diffuseColor;
@@ -142,19 +151,24 @@ void IndirectClosestHit(inout IndirectRayPayload rayData, BuiltInTriangleInterse
 	// Extract data from scene description 
 	ShadingData shadeData = getHitShadingData(attribs);
 
+	// The path's decisions at this depth come from the pixel's sequences
+	uint2 pixelIndex = DispatchRaysIndex().xy;
+	PixelSampler pixelSampler = createPixelSampler(gSamplerType, pixelIndex.x, pixelIndex.y);
+
 	// Add emissive color
 	//rayData.color = gEmitMult * shadeData.emissive.rgb;
 
 	// Direct illumination
 	if (gDoDirectLighting)
 	{
-		rayData.color += lambertianDirect(rayData.randSeed, shadeData.posW, shadeData.N, shadeData.diffuse);
+		float u = pixelSample(pixelSampler, SAMPLE_DOMAIN_DIRECT_LIGHT + 2 * rayData.rayDepth, rayData.sampleIndex, 0);
+		rayData.color += lambertianDirect(u, shadeData.posW, shadeData.N, shadeData.diffuse);
 	}
 
 	// Indirect illumination
 	if (rayData.rayDepth < gMaxDepth)
 	{
-		rayData.color += lambertianIndirect(rayData.randSeed, shadeData.posW, shadeData.N, shadeData.diffuse, rayData.rayDepth);
+		rayData.color += lambertianIndirect(pixelSampler, rayData.sampleIndex, shadeData.posW, shadeData.N, shadeData.diffuse, rayData.rayDepth);
 	}
 }
 
@@ -173,31 +187,50 @@ void FullGIRayGen()
 	
 	float3 albedo = difMatlColor.rgb;
 
-	// Initialize random number generator
-	uint randSeed = initRand(pixelIndex.x + dim.x * pixelIndex.y, gFrameCount, 16);
+	// Path s of this frame is point firstSample + s of the pixel's sequences:  the pixel's samples so far follow on
+	//     from each other, as they should for the low-discrepancy samplers (see SampleSequences.h)
+	PixelSampler pixelSampler = createPixelSampler(gSamplerType, pixelIndex.x, pixelIndex.y);
+	uint firstSample = gFrameCount;
 
-	float3 shadeColor = float3(0.f, 0.f, 0.f);
-	if (worldPos.w != 0)
+	// Samples to take (0 once the pixel has converged).  The accumulation pass reads the count back from alpha.
+	uint sampleCount = 1;
+	if (gAdaptive)
 	{
-		// Add emissive color to primary rays
-		shadeColor = gEmitMult * emissiveData.rgb;
-
-		// Direct lighting
-		if (gDoDirectLighting)
+		float4 budget = gSampleCount[pixelIndex];
+		if (budget.y > 0.f)
 		{
-			shadeColor += lambertianDirect(randSeed, worldPos.xyz, worldNorm.xyz, difMatlColor.rgb);
+			sampleCount = uint(budget.x);
+			firstSample = uint(budget.w);
 		}
+	}
 
-		// Indirect lighting
-		if (gDoIndirectLighting && gMaxDepth > 0)
+	float3 shadeColor = float3(0.f, 0.f, 0.f);
+	if (worldPos.w != 0)
+	{
+		for (uint s = 0; s < sampleCount; s++)
 		{
-			shadeColor += lambertianIndirect(randSeed, worldPos.xyz, worldNorm.xyz, difMatlColor.rgb, 0);
+			// Add emissive color to primary rays
+			shadeColor += gEmitMult * emissiveData.rgb;
+
+			// Direct lighting
+			if (gDoDirectLighting)
+			{
+				float u = pixelSample(pixelSampler, SAMPLE_DOMAIN_DIRECT_LIGHT, firstSample + s, 0);
+				shadeColor += lambertianDirect(u, worldPos.xyz, worldNorm.xyz, difMatlColor.rgb);
+			}
+
+			// Indirect lighting
+			if (gDoIndirectLighting && gMaxDepth > 0)
+			{
+				shadeColor += lambertianIndirect(pixelSampler, firstSample + s, worldPos.xyz, worldNorm.xyz, difMatlColor.rgb, 0);
+			}
 		}
+		shadeColor /= max(sampleCount, 1u);
 	}
 	else
 	{
 		shadeColor = albedo;
 	}
 	
-	gOutput[pixelIndex] = float4(shadeColor, 1.f);
+	gOutput[pixelIndex] = float4(shadeColor, float(sampleCount));
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+// ReSTIR GI, stage 2:  each pixel merges its reservoir with those of random neighbors on a similar surface, scaling their
+//     weights by the reconnection Jacobian (and, optionally, zeroing samples it cannot see).
+
+#include "HostDeviceSharedMacros.h"
+#include "HostDeviceData.h"
+#include "simpleGIUtils.hlsli"
+#include "shadowRay.hlsli"
+#include "restirGIUtils.hlsli"
+
+// Include and import common Falcor utilities and data structures
+import Raytracing;                   // Shared ray tracing specific functions & data
+import ShaderCommon;                 // Shared shading data structures
+import Shading;                      // Shading functions, etc
+import Lights;                       // Light structures for our current scene
+
+shared cbuffer GlobalCB
+{
+	float gMinT;             // Avoid ray self-intersection
+	uint  gFrameCount;       // Frame counter to act as random seed
+	uint  gSpatialNeighbors;
+	uint  gSpatialRadius;
+	bool  gEnableReSTIRGI;
+	bool  gDoSpatialReuse;
+	bool  gDoVisibilityReuse;   // Trace a ray to each neighbor's sample point before taking it
+}
+
+// Input textures
+shared Texture2D<float4>   gPos;           // G-buffer world-space position
+shared Texture2D<float4>   gNorm;          // G-buffer world-space normal
+
+// GI reservoirs (see ReservoirStore)
+shared RWStructuredBuffer<PackedGIReservoir> gGICurrReservoirBuffer;      // Input:  after temporal reuse
+shared RWStructuredBuffer<PackedGIReservoir> gGISpatialReservoirBuffer;   // Output:  what we shade with
+
+[shader("raygeneration")]
+void GISpatialReuseRayGen()
+{
+	// Get our pixel's position on the screen
+	uint2 pixelIndex = DispatchRaysIndex().xy;
+	uint2 dim = DispatchRaysDimensions().xy;
+	uint index = giReservoirIndex(pixelIndex, dim);
+
+	// Read G-buffer data
+	float4 worldPos = gPos[pixelIndex];
+	float4 worldNorm = gNorm[pixelIndex];
+
+	if (!gEnableReSTIRGI || !gDoSpatialReuse || worldPos.w == 0)
+	{
+		gGISpatialReservoirBuffer[index] = gGICurrReservoirBuffer[index];
+		return;
+	}
+
+	// Initialize random number generator
+	uint randSeed = initRand(pixelIndex.x + dim.x * pixelIndex.y, gFrameCount, 16);
+
+	// Our own reservoir needs no reconnection
+	GIReservoir current = unpackGIReservoir(gGICurrReservoirBuffer[index]);
+	GIReservoir reservoir = emptyGIReservoir();
+	reservoir.visiblePos = worldPos.xyz;
+	reservoir.visibleNorm = worldNorm.xyz;
+	float p_hat = giTargetFunction(current.radiance, worldPos.xyz, worldNorm.xyz, current.samplePos);
+	mergeGIReservoir(reservoir, current, p_hat * current.W * current.M, randSeed);
+
+	for (uint i = 0; i < gSpatialNeighbors; i++)
+	{
+		uint2 neighborIndex = getGISpatialNeighborIndex(pixelIndex, dim, gSpatialRadius, randSeed);
+		if (!isSimilarGISurface(worldNorm, gNorm[neighborIndex])) continue;
+
+		GIReservoir neighbor = unpackGIReservoir(gGICurrReservoirBuffer[giReservoirIndex(neighborIndex, dim)]);
+		if (neighbor.M == 0.f) continue;
+
+		float jacobian = giReconnectionJacobian(worldPos.xyz, neighbor.visiblePos, neighbor.samplePos, neighbor.sampleNorm);
+		if (jacobian > GI_MAX_JACOBIAN || jacobian < 1.f / GI_MAX_JACOBIAN) continue;
+
+		p_hat = giTargetFunction(neighbor.radiance, worldPos.xyz, worldNorm.xyz, neighbor.samplePos);
+		if (p_hat > 0.f && gDoVisibilityReuse)
+		{
+			// Stop just short of the sample point, which would otherwise occlude itself
+			float3 toSample = neighbor.samplePos - worldPos.xyz;
+			float dist = length(toSample);
+			p_hat *= shadowRayVisibility(worldPos.xyz, toSample / dist, gMinT, dist * 0.999f);
+		}
+		mergeGIReservoir(reservoir, neighbor, p_hat * jacobian * neighbor.W * neighbor.M, randSeed);
+	}
+
+	finalizeGIReservoir(reservoir);
+	gGISpatialReservoirBuffer[index] = packGIReservoir(reservoir);
+}
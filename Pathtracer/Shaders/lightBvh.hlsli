@@ -0,0 +1,53 @@
+// Light BVH for importance sampling many lights (Conty Estevez and Kulla 2018).  Nodes are stored depth-first:  an
+//     inner node's first child directly follows it, and its data field holds the index of the second.  Each node
+//     bounds the positions, total power, and emission cone of the lights below it.
+//
+// LightBvh.h builds the tree and mirrors lightBvhImportance() on the CPU.
+
+#define LIGHT_BVH_LEAF      0x80000000   // In data:  leaf, the rest is the light index
+#define LIGHT_BVH_INFINITE  0x1          // In flags:  holds a directional light
+
+// Must match LightBvh::Node
+struct LightBvhNode {
+	float3 boundsMin;
+	float  power;    // Sum of the light powers below this node
+	float3 boundsMax;
+	uint   data;     // Leaf:  light index | LIGHT_BVH_LEAF.  Inner node:  index of the second child.
+	float3 axis;     // Emission cone axis
+	float  thetaO;   // Half angle of the cone bounding the axes below this node
+	float  thetaE;   // Emission cut-off angle around each of those axes
+	uint   flags;
+	uint2  pad;
+};
+
+// Conservative estimate of the light reaching posW (with normal N) from below the node
+float lightBvhImportance(LightBvhNode node, float3 posW, float3 N)
+{
+	if (node.power <= 0.f) return 0.f;
+
+	// Bounding sphere of the node, and the angle it subtends from the shading point
+	float3 center = 0.5f * (node.boundsMin + node.boundsMax);
+	float radius = 0.5f * length(node.boundsMax - node.boundsMin);
+	float3 toPoint = posW - center;
+	float dist2 = dot(toPoint, toPoint);
+	float3 wi = (dist2 > 0.f) ? toPoint * rsqrt(dist2) : node.axis;
+	float thetaU = (dist2 <= radius * radius) ? M_PI : asin(min(1.f, radius * rsqrt(dist2)));
+
+	// Can any emission cone below the node reach the point?
+	float theta = acos(clamp(dot(node.axis, wi), -1.f, 1.f));
+	float thetaP = max(0.f, theta - node.thetaO - thetaU);
+	if (node.thetaE < M_PI && thetaP >= node.thetaE) return 0.f;
+
+	// Is any of the node above the point's horizon?
+	float receiver = 1.f;
+	if ((node.flags & LIGHT_BVH_INFINITE) == 0)
+	{
+		float thetaI = acos(clamp(-dot(N, wi), -1.f, 1.f));
+		float thetaIP = max(0.f, thetaI - thetaU);
+		if (thetaIP >= 0.5f * M_PI) return 0.f;
+		receiver = cos(thetaIP);
+	}
+
+	dist2 = max(dist2, max(0.25f * radius * radius, 1e-4f));
+	return node.power * receiver / dist2;
+}
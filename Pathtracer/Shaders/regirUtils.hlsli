@@ -1,87 +1,69 @@
+// World-space light grid (ReGIR).  Cells are laid out x-major, then y, then z, and each cell owns
+//     gridLightsPerCell consecutive light slots.  Each slot holds a Reservoir (see restirUtils.hlsli)
+//     packed as float4(y, M, W, wSum), resampled from all scene lights with respect to the cell center.
+//
+// Include after simpleGIUtils.hlsli and restirUtils.hlsli.  CpuReGIR.h mirrors these functions on the CPU.
+
+struct LightGrid {
+	float3 origin;         // World-space corner of cell (0, 0, 0)
+	float3 cellSize;       // World-space extent of one cell
+	int3   cellCount;      // Number of cells along each axis
+	uint   lightsPerCell;  // Light slots (reservoirs) per cell
+};
+
 // Index conversion
-bool outOfBounds(int3 gridCell) {
+bool outOfBounds(int3 gridCell, int3 dims) {
 	return gridCell.x < 0 || gridCell.y < 0 || gridCell.z < 0 ||
-		gridCell.x >= gridCellCount.x || gridCell.y >= gridCellCount.y || gridCell.z >= gridCellCount.z;
+		gridCell.x >= dims.x || gridCell.y >= dims.y || gridCell.z >= dims.z;
 }
 
 int coords3DToLinear(int3 coords, int3 dims) {
-	return coords.x + dims.x * coords.y + dim.x * dim.y * coords.z;
+	return coords.x + dims.x * coords.y + dims.x * dims.y * coords.z;
 }
 
-float3 mapCellIndexToWorld(int gridCellIndex, int gridCellSize) {
-	// TODO: change these numbers to macros
-	const float3 gridCenter = float3(0.0, 0.0, 0.0);
-	const int3 gridCellCount = int3(16, 16, 16);
-	const float3 gridOrigin = gridCenter - float3(gridCellCount) * (gridCellSize * 0.5);
-
-	int3 gridCellPos;
-	gridCellPos.x = gridCellIndex;
-	gridCellPos.y = gridCellPos.x / 16.0;
-	gridCellPos.x %= 16.0;
-	gridCellPos.z = gridCellPos.y / 16.0;
-	gridCellPos.y %= 16.0;
-	
-	return (float3(gridCellPos) + 0.5) * gridCellSize + gridOrigin;
+int3 linearToCoords3D(int index, int3 dims) {
+	return int3(index % dims.x, (index / dims.x) % dims.y, index / (dims.x * dims.y));
 }
 
-int3 mapWorldToGrid(float3 worldPos, int3 gridDims, int gridCellSize) {
-	const float3 gridCenter = float3(0.0, 0.0, 0.0);
-	const int3 gridCellCount = int3(16, 16, 16);
-	const float3 gridOrigin = gridCenter - float3(gridCellCount) * (gridCellSize * 0.5);
-
-	int3 gridCell = int3(floor((worldPos - gridOrigin) / gridCellSize));
-
-	if (outOfBounds(gridCell)) return -1;
-
-	return coords3DToLinear(gridCell, gridDims);
+float3 mapCellIndexToWorld(int gridCellIndex, LightGrid grid) {
+	// Returns the center of the cell
+	return (float3(linearToCoords3D(gridCellIndex, grid.cellCount)) + 0.5) * grid.cellSize + grid.origin;
 }
 
-struct LightSample {
-	uint lightID;
-};
-
-struct Reservoir {
-	LightSample lsample;
-	uint M;
-	float totalWeight;
-	float sampleTargetPdf;
-};
+int mapWorldToGrid(float3 worldPos, LightGrid grid) {
+	// Returns the linear index of the cell containing worldPos, or -1 if it lies outside the grid
+	int3 gridCell = int3(floor((worldPos - grid.origin) / grid.cellSize));
 
-// RIS
+	if (outOfBounds(gridCell, grid.cellCount)) return -1;
 
-void updateReservoir(inout Reservoir result, in Reservoir input, in float weight, in uint randSeed) {
-	result.totalWeight += input.weight;
-	result.M++;
-	if (nextRand(randSeed) < (weight / result.totalWeight)) {
-		result.lsample = input.lsample;
-		result.sampleTargetPdf = input.sampleTargetPdf;
-	}
-	return result;
+	return coords3DToLinear(gridCell, grid.cellCount);
 }
 
-Reservoir mergeReservoirs(Reservoir r1, Reservoir r2) {
-	Reservoir merged;
-	updateReservoir(merged, r1);
-	updateReservoir(merged, r2);
-	merged.M = r1.M + r2.M;
-	return merged;
+// Target function used to fill a cell:  the light's unshadowed contribution at the cell center.  There is no
+//     BSDF or cosine term, since the cell is shared by every surface in it.  Like evaluatePHat(), this divides
+//     getLightData()'s (already attenuated) intensity by the squared distance, so cells favor the same lights as
+//     the per-pixel target; the distance is clamped to half a cell diagonal so lights inside the cell don't dominate it.
+float evaluateCellPHat(float3 cellCenter, LightGrid grid, float light) {
+	float3 lightDirection;
+	float3 lightIntensity;
+	float dist;
+	getLightData(light, cellCenter, lightDirection, lightIntensity, dist);
+
+	float minDistSquared = 0.25 * dot(grid.cellSize, grid.cellSize);
+	return length(lightIntensity) / max(dist * dist, minDistSquared);
 }
 
-Reservoir sampleLightsRIS(float3 p, int lightsCount) {
-	Reservoir r;
-	for (int i = 0; i < min(lightCount, 8); i++) {
-		Reservoir input;
-		LightSample candidate = sampleFromSourcePool(sourcePdf);
-		float3 lightVector = candidate.position - gridCellCenter;
-		float lightDistanceSquared = max(gMinDistanceSquared, dot(lightVector, lightVector));
-		float sourcePdf = 1 / 8;
-		input.sampleTargetPdf = candidate.intensity / lightDistanceSquared;
-		updateReservoir(r, input, weight, randSeed);
+// RIS:  pick one of lightsCount lights (uniform source PDF) using `candidates` candidates
+Reservoir sampleLightsRIS(float3 cellCenter, LightGrid grid, int lightsCount, int candidates, inout uint randSeed) {
+	Reservoir r = { 0, 0, 0, 0 };
+	for (int i = 0; i < candidates; i++) {
+		int light = min(int(nextRand(randSeed) * lightsCount), lightsCount - 1);
+		float p = 1.f / float(lightsCount);
+		float p_hat = evaluateCellPHat(cellCenter, grid, float(light));
+		updateReservoir(r, float(light), p_hat / p, randSeed);
 	}
+
+	float p_hat = evaluateCellPHat(cellCenter, grid, r.y);
+	r.W = (p_hat == 0.f) ? 0.f : (1.f / p_hat) * (r.wSum / r.M);
 	return r;
 }
-
-Reservoir sampleLightsUsingRIS(float3 p) {
-	// TODO: use this to sample w.r.t. BRDF during 
-	return 0.0;
-}
\ No newline at end of file
@@ -0,0 +1,45 @@
+// Temporal reprojection through per-pixel motion vectors.  RayTracedGBufferPass writes the "MotionVectors" texture
+//     with computeMotionVector() (camera and object motion), and temporal reuse, accumulation and denoising all find
+//     last frame's pixel with reprojectPixel(), which also rejects disocclusions by comparing depth and normal against
+//     last frame's G-buffer.
+//
+// CpuReSTIRUtils.h mirrors both functions on the CPU.
+
+#define REPROJECTION_DEPTH_TOLERANCE   0.1f   // Largest relative difference between the expected and stored last-frame depth
+#define REPROJECTION_NORMAL_THRESHOLD  0.9f   // Smallest cosine between this and last frame's normal
+
+// Motion vector of the surface seen through pixelIndex, which was at prevPosW last frame:  xy is the offset (in pixels)
+//     from this pixel's center to where that surface was on screen, z its distance to last frame's camera, and w is
+//     1 (0 if there is no such pixel:  no surface, or one behind last frame's camera).
+float4 computeMotionVector(uint2 pixelIndex, uint2 dim, float3 prevPosW, float4x4 prevViewProj, float3 prevCameraPos)
+{
+	float4 prevScreenPos = mul(float4(prevPosW, 1.f), prevViewProj);
+	if (prevScreenPos.w <= 0.f) return float4(0.f, 0.f, 0.f, 0.f);   // Behind last frame's camera
+	prevScreenPos /= prevScreenPos.w;
+
+	float2 prevPixel = float2(((prevScreenPos.x + 1.f) * 0.5f) * (float)dim.x,
+	                          ((1.f - prevScreenPos.y) * 0.5f) * (float)dim.y);
+	return float4(prevPixel - (float2(pixelIndex) + 0.5f), length(prevPosW - prevCameraPos), 1.f);
+}
+
+// Last frame's pixel for pixelIndex, if it saw the same surface.  prevNorm is last frame's "WorldNormal" (normal and
+//     distance to the camera).
+bool reprojectPixel(uint2 pixelIndex, uint2 dim, float4 motion, float3 normal, Texture2D<float4> prevNorm, out uint2 prevIndex)
+{
+	prevIndex = uint2(-1, -1);
+	if (motion.w == 0.f) return false;
+
+	// Off screen last frame?
+	float2 prevPixel = float2(pixelIndex) + 0.5f + motion.xy;
+	if (!(prevPixel.x >= 0.f && prevPixel.y >= 0.f && prevPixel.x < (float)dim.x && prevPixel.y < (float)dim.y)) return false;
+	uint2 candidate = min(uint2(prevPixel), dim - 1);
+
+	// Disocclusion:  last frame's pixel saw something else (or nothing)
+	float4 prevNormDepth = prevNorm[candidate];
+	if (prevNormDepth.w <= 0.f) return false;
+	if (abs(prevNormDepth.w - motion.z) > REPROJECTION_DEPTH_TOLERANCE * motion.z) return false;
+	if (dot(normal, prevNormDepth.xyz) < REPROJECTION_NORMAL_THRESHOLD) return false;
+
+	prevIndex = candidate;
+	return true;
+}
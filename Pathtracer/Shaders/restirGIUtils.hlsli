@@ -0,0 +1,67 @@
+// ReSTIR GI:  resampling of one-bounce indirect samples, kept one reservoir per pixel (see GIReservoir.h and
+//     ReservoirStore's GI buffers).  Used by createGISamples.hlsl, giSpatialReuse.hlsl and shadeWithGIReservoirs.hlsl.
+//
+// Include after simpleGIUtils.hlsli and shadowRay.hlsli.  CpuReSTIRUtils.h mirrors these functions on the CPU.
+
+#include "GIReservoir.h"
+
+#define GI_SIMILAR_NORMAL   0.9f    // Smallest cosine between the normals of a pixel and a spatial neighbor it reuses
+#define GI_SIMILAR_DEPTH    0.1f    // Largest relative difference of their distances to the camera
+
+uint giReservoirIndex(uint2 pixelIndex, uint2 dim)
+{
+	return pixelIndex.y * dim.x + pixelIndex.x;
+}
+
+// Adds a candidate reservoir (a new sample has M = 1) with resampling weight wi, keeping its sample with
+//     probability wi / wSum.  The visible point stays ours.
+void mergeGIReservoir(inout GIReservoir r, GIReservoir candidate, float wi, inout uint randSeed)
+{
+	r.wSum += wi;
+	r.M += candidate.M;
+	if (nextRand(randSeed) < (wi / r.wSum)) {
+		r.samplePos = candidate.samplePos;
+		r.sampleNorm = candidate.sampleNorm;
+		r.radiance = candidate.radiance;
+	}
+}
+
+// Sets W for the reservoir's sample, as seen from its visible point
+void finalizeGIReservoir(inout GIReservoir r)
+{
+	float p_hat = giTargetFunction(r.radiance, r.visiblePos, r.visibleNorm, r.samplePos);
+	r.W = (p_hat > 0.f) ? r.wSum / (r.M * p_hat) : 0.f;
+}
+
+// Random pixel within radius of ours (clamped to the screen)
+uint2 getGISpatialNeighborIndex(uint2 pixelIndex, uint2 dim, uint radius, inout uint randSeed)
+{
+	int offsetX = int(nextRand(randSeed) * (2 * radius + 1)) - int(radius);
+	int offsetY = int(nextRand(randSeed) * (2 * radius + 1)) - int(radius);
+	return uint2(clamp(int2(pixelIndex) + int2(offsetX, offsetY), int2(0, 0), int2(dim) - 1));
+}
+
+// Whether a neighbor's surface is close enough to ours to share its samples
+bool isSimilarGISurface(float4 norm, float4 neighborNorm)
+{
+	if (dot(norm.xyz, neighborNorm.xyz) < GI_SIMILAR_NORMAL) return false;
+	return abs(neighborNorm.w - norm.w) <= GI_SIMILAR_DEPTH * norm.w;
+}
+
+// Direct lighting from one random light, as lambertianDirect() in fullGI.hlsl
+float3 giDirectLighting(inout uint rndSeed, float3 hit, float3 norm, float3 diffuseColor, float minT)
+{
+	int light = min(int(nextRand(rndSeed) * gLightsCount), gLightsCount - 1);
+
+	float dist;
+	float3 lightIntensity;
+	float3 lightDirection;
+	getLightData(light, hit, lightDirection, lightIntensity, dist);
+
+	float cosTheta = saturate(dot(norm, lightDirection));
+	float shadow = shadowRayVisibility(hit, lightDirection, minT, dist);
+
+	float3 color = gLightsCount * shadow * cosTheta * lightIntensity;
+	color *= diffuseColor / M_PI;
+	return color;
+}
@@ -1,5 +1,4 @@
-#define BIASED
-//#define UNBIASED
+#include "ReservoirEncoding.h"
 
 struct GBuffer {
 	float4 pos;
@@ -14,6 +13,72 @@ struct Reservoir {
 	float wSum;  // Sum of weights
 };
 
+// How RIS candidates are picked (must match LightSelection in LightBvh.h)
+#define LIGHT_SELECTION_UNIFORM      0
+#define LIGHT_SELECTION_ALIAS_TABLE  1
+#define LIGHT_SELECTION_BVH          2
+
+// One entry of the light alias table built by LightAliasTable (must match LightAliasTable::Entry)
+struct LightAliasEntry {
+	float prob;  // Probability of keeping this bucket's own light
+	uint alias;  // Light picked otherwise
+	float pdf;   // Probability of picking this bucket's light overall
+	uint pad;
+};
+
+// Environment map cells as candidates (see EnvMapSampler)
+#include "envMapSampling.hlsli"
+
+// Points on emissive triangles as candidates (see EmissiveLights)
+#include "emissiveLights.hlsli"
+
+// Reservoirs kept per pixel (set by ReservoirStore::addDefines())
+#ifndef RESERVOIRS_PER_PIXEL
+#define RESERVOIRS_PER_PIXEL 1
+#endif
+
+// How reservoirs are stored in the reservoir buffers (set by ReservoirStore::addDefines(), see ReservoirEncoding.h)
+#ifndef RESERVOIR_FORMAT
+#define RESERVOIR_FORMAT RESERVOIR_FORMAT_FULL
+#endif
+
+#if RESERVOIR_FORMAT == RESERVOIR_FORMAT_COMPACT
+typedef CompactReservoir PackedReservoir;
+#else
+typedef FullReservoir PackedReservoir;
+#endif
+
+PackedReservoir packReservoir(Reservoir r)
+{
+#if RESERVOIR_FORMAT == RESERVOIR_FORMAT_COMPACT
+	return encodeCompactReservoir(uint(r.y), r.M, r.W);
+#else
+	return encodeFullReservoir(uint(r.y), r.M, r.W, r.wSum);
+#endif
+}
+
+Reservoir unpackReservoir(PackedReservoir p)
+{
+	Reservoir r;
+	r.y = float(p.lightId);
+#if RESERVOIR_FORMAT == RESERVOIR_FORMAT_COMPACT
+	r.M = compactReservoirM(p);
+	r.W = compactReservoirW(p);
+	r.wSum = 0.f;   // Not stored:  only needed while a reservoir is being built
+#else
+	r.M = f16tof32(p.M);
+	r.W = p.W;
+	r.wSum = p.wSum;
+#endif
+	return r;
+}
+
+// Where reservoir k of a pixel lives in the reservoir buffers.  A pixel's reservoirs are adjacent.
+uint reservoirIndex(uint2 pixelIndex, uint2 dim, uint k)
+{
+	return (pixelIndex.y * dim.x + pixelIndex.x) * RESERVOIRS_PER_PIXEL + k;
+}
+
 Reservoir createReservoir(in float4 res)
 {
 	Reservoir r;
@@ -34,6 +99,15 @@ void updateReservoir(inout Reservoir res, in float xi, in float wi, inout uint r
 	}
 }
 
+// Same, with the caller's uniform number u (e.g. from a sample domain, see SampleSequences.h) deciding whether to keep xi
+void updateReservoir(inout Reservoir res, in float xi, in float wi, in float u) {
+	res.wSum += wi;
+	res.M++;
+	if (u < (wi / res.wSum)) {
+		res.y = xi;
+	}
+}
+
 float evaluateBSDF(float3 albedo, float3 lightIntensity, float cosTheta, float lightDist) {
 	float3 f = albedo / M_PI;
 	float3 Le = lightIntensity;
@@ -41,9 +115,23 @@ float evaluateBSDF(float3 albedo, float3 lightIntensity, float cosTheta, float l
 	return length(f * Le * G);
 }
 
+// getLightData() for a RIS candidate:  one of the scene's lights, past them a cell of the environment map, or from
+//     EMISSIVE_ID_BASE on a point on an emissive triangle
+void getCandidateLightData(int light, float3 hitPos, out float3 toLight, out float3 lightIntensity, out float distToLight) {
+	if (uint(light) >= EMISSIVE_ID_BASE) {
+		getEmissivePointData(uint(light) - EMISSIVE_ID_BASE, hitPos, toLight, lightIntensity, distToLight);
+	}
+	else if (uint(light) >= gLightsCount) {
+		getEnvCellData(uint(light) - gLightsCount, toLight, lightIntensity, distToLight);
+	}
+	else {
+		getLightData(light, hitPos, toLight, lightIntensity, distToLight);
+	}
+}
+
 float evaluatePHat(GBuffer gBuffer, inout float3 lightDirection, inout float3 lightIntensity, inout float dist, float light) {
 	// Calculate p_hat(r.y) for reservoir's light sample
-	getLightData(light, gBuffer.pos.xyz, lightDirection, lightIntensity, dist);
+	getCandidateLightData(int(light), gBuffer.pos.xyz, lightDirection, lightIntensity, dist);
 	float cosTheta = saturate(dot(gBuffer.norm.xyz, lightDirection));
 	float p_hat = evaluateBSDF(gBuffer.color.rgb, lightIntensity, cosTheta, dist);
 
@@ -66,17 +154,16 @@ float evaluatePHat(GBuffer gBuffer, inout float3 lightDirection, inout float3 li
 //}
 
 // Halton sequence - https://en.wikipedia.org/wiki/Halton_sequence
-float halton(inout uint i, uint b)
+//     Point i's coordinate for base b:  the radical inverse of i
+float halton(uint i, uint b)
 {
-	i = (1664525u * i + 1013904223u);
-
 	float f = 1.0;
 	float r = 0.0;
 
 	while (i > 0) {
 		f = f / float(b);
 		r = r + f * float(i % b);
-		i = floor(i / b);
+		i = i / b;
 	}
 	return r;
 }
\ No newline at end of file
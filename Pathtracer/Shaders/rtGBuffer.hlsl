@@ -22,6 +22,9 @@
 // Helper function to determine if the geometry uses alpha testing
 #include "alphaTest.hlsli"
 
+// Motion vectors for temporal reprojection
+#include "reprojection.hlsli"
+
 // Include and import common Falcor utilities and data structures
 __import Raytracing;                   // Shared ray tracing specific functions & data
 __import ShaderCommon;                 // Shared shading data structures
@@ -34,6 +37,14 @@ RWTexture2D<float4> gMatDif;
 RWTexture2D<float4> gMatSpec;
 RWTexture2D<float4> gMatExtra;
 RWTexture2D<float4> gMatEmissive;
+RWTexture2D<float4> gMotion;       // Motion vectors (see computeMotionVector())
+
+// Last frame's camera, to find where each surface was on screen
+shared cbuffer GlobalCB
+{
+	float4x4 gPrevViewProjMat;
+	float3   gPrevCameraPos;
+}
 
 // Simple ray payload structure; not currently used by this shader
 struct SimpleRayPayload
@@ -102,4 +113,8 @@ void PrimaryClosestHit(inout SimpleRayPayload, BuiltInTriangleIntersectionAttrib
 	gMatSpec[pixelIndex] = float4(shadeData.specular, shadeData.linearRoughness);
 	gMatExtra[pixelIndex] = float4(shadeData.IoR, shadeData.doubleSidedMaterial ? 1.f : 0.f, 0.f, 0.f);
 	gMatEmissive[pixelIndex] = float4(shadeData.emissive, 0.f);
+
+	// Where the surface was last frame, following the instance's previous transform (and vertices, if animated)
+	float3 prevPosW = getPrevPosW(PrimitiveIndex(), attribs);
+	gMotion[pixelIndex] = computeMotionVector(pixelIndex, DispatchRaysDimensions().xy, prevPosW, gPrevViewProjMat, gPrevCameraPos);
 }
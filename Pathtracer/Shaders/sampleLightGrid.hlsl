@@ -18,6 +18,8 @@
 #include "HostDeviceSharedMacros.h"
 #include "HostDeviceData.h"
 #include "simpleGIUtils.hlsli"
+#include "restirUtils.hlsli"
+#include "regirUtils.hlsli"
 #include "shadowRay.hlsli"
 
 // Include and import common Falcor utilities and data structures
@@ -28,137 +30,23 @@ import Lights;                       // Light structures for our current scene
 
 shared cbuffer GlobalCB
 {
-	float gMinT;          // Avoid ray self-intersection
-	uint  gFrameCount;    // Frame counter to act as random seed 
-	bool  gDoIndirectLighting;  // Should we shoot indirect rays?
-	bool  gDoDirectLighting; // Should we shoot shadow rays?
-	uint  gMaxDepth;      // Max recursion depth
-	float gEmitMult;      // Multiply emissive channel by this channel
+	float  gMinT;            // Avoid ray self-intersection
+	uint   gFrameCount;      // Frame counter to act as random seed 
+	int    gLightSamples;    // Number of light slots resampled per pixel
+	bool   gJitterCell;      // Look up a random cell within half a cell of the hit (stochastic trilinear filtering)
+	float3 gGridOrigin;      // World-space corner of the grid
+	float3 gGridCellSize;    // World-space size of a cell
+	int3   gGridCellCount;   // Cells along each axis
+	uint   gGridLightsPerCell; // Light slots per cell
 }
 
 // Input and output textures
 shared Texture2D<float4>   gPos;           // G-buffer world-space position
 shared Texture2D<float4>   gNorm;          // G-buffer world-space normal
 shared Texture2D<float4>   gDiffuseMtl;    // G-buffer diffuse material
-shared Texture2D<float4>   gEmissive;
-shared Texture2D<float4>   gLightGrid;
+shared Buffer<float4>      gLightGrid;     // Cell reservoirs written by BuildCellReservoirsPass
 shared RWTexture2D<float4> gOutput;        // Output to store shaded result
 
-// Environment map
-shared Texture2D<float4>   gEnvMap;
-
-struct IndirectRayPayload
-{
-	float3 color;
-	uint randSeed;
-	uint rayDepth;
-};
-
-[shader("miss")]
-void IndirectMiss(inout IndirectRayPayload rayData)
-{
-	float2 dim;
-	gEnvMap.GetDimensions(dim.x, dim.y);
-
-	// Convert ray direction to (u, v) coordinate
-	float2 uv = wsVectorToLatLong(WorldRayDirection());
-
-	// Set environment map color as ray color
-	rayData.color = gEnvMap[uint2(uv * dim)].rgb;
-}
-
-[shader("anyhit")]
-void IndirectAnyHit(inout IndirectRayPayload rayData, BuiltInTriangleIntersectionAttributes attribs)
-{
-	// If we hit a transparent texel, ignore the hit; otherwise, accept
-	if (alphaTestFails(attribs)) IgnoreHit();
-}
-
-float3 shootIndirectRay(float3 rayOrigin, float3 rayDir, float minT, uint seed, uint curDepth)
-{
-	// Setup indirect ray
-	RayDesc rayThroughput;
-	rayThroughput.Origin = rayOrigin;
-	rayThroughput.Direction = rayDir;
-	rayThroughput.TMin = minT;
-	rayThroughput.TMax = 1e+38f;
-
-	// Initialize payload
-	IndirectRayPayload rayData;
-	rayData.color = float3(0, 0, 0);
-	rayData.randSeed = seed;
-	rayData.rayDepth = curDepth + 1;
-
-	// Trace ray (using hit group and miss shader #1)
-	TraceRay(gRtScene,
-		0,
-		0XFF,
-		1,
-		hitProgramCount,
-		1,
-		rayThroughput,
-		rayData);
-
-	return rayData.color;
-}
-
-float3 lambertianDirect(inout uint rndSeed, float3 hit, float3 norm, float3 diffuseColor)
-{
-	// Pick a single random light to sample
-	int light = min(int(nextRand(rndSeed) * gLightsCount), gLightsCount - 1);
-
-	// Query scene to get information about current light
-	float dist;
-	float3 lightIntensity;
-	float3 lightDirection;
-
-	getLightData(light, hit, lightDirection, lightIntensity, dist);
-
-	// Lambertian dot product
-	float cosTheta = saturate(dot(norm, lightDirection));
-
-	// Shoot shadow ray
-	float shadow = shadowRayVisibility(hit, lightDirection, gMinT, dist);
-
-	// Compute Lambertian shading color (divide by probability of light = 1.0 / N)
-	float3 color = gLightsCount * shadow * cosTheta * lightIntensity;
-	color *= diffuseColor / M_PI;
-
-	return color;
-}
-
-float3 lambertianIndirect(inout uint rndSeed, float3 hit, float3 norm, float3 diffuseColor, uint depth)
-{
-	// Use cosine-weighted hemisphere sampling to choose random direction
-	float3 wi = getCosHemisphereSample(rndSeed, norm);
-	float3 bounceColor = shootIndirectRay(hit, wi, gMinT, rndSeed, depth);
-
-	// Attenuate color by indirect color
-	return bounceColor * diffuseColor;
-}
-
-[shader("closesthit")]
-void IndirectClosestHit(inout IndirectRayPayload rayData, BuiltInTriangleIntersectionAttributes attribs)
-{
-	// Extract data from scene description 
-	ShadingData shadeData = getHitShadingData(attribs);
-
-	// Add emissive color
-	//rayData.color = gEmitMult * shadeData.emissive.rgb;
-
-	// Direct illumination
-	if (gDoDirectLighting)
-	{
-		rayData.color += lambertianDirect(rayData.randSeed, shadeData.posW, shadeData.N, shadeData.diffuse);
-	}
-
-	// Indirect illumination
-	if (rayData.rayDepth < gMaxDepth)
-	{
-		rayData.color += lambertianIndirect(rayData.randSeed, shadeData.posW, shadeData.N, shadeData.diffuse, rayData.rayDepth);
-	}
-}
-
 [shader("raygeneration")]
 void SampleLightGridRayGen()
 {
@@ -167,33 +55,74 @@ void SampleLightGridRayGen()
 	uint2 dim = DispatchRaysDimensions().xy;
 
 	// Read G-buffer data
-	float4 worldPos = gPos[pixelIndex];
-	float4 worldNorm = gNorm[pixelIndex];
-	float4 difMatlColor = gDiffuseMtl[pixelIndex];
-	float4 emissiveData = gEmissive[pixelIndex];
-	
-	float3 albedo = difMatlColor.rgb;
+	GBuffer gBuffer;
+	gBuffer.pos = gPos[pixelIndex];
+	gBuffer.norm = gNorm[pixelIndex];
+	gBuffer.color = gDiffuseMtl[pixelIndex];
+
+	float3 albedo = gBuffer.color.rgb;
 
 	// Initialize random number generator
 	uint randSeed = initRand(pixelIndex.x + dim.x * pixelIndex.y, gFrameCount, 16);
 
 	float3 shadeColor = albedo;
-	if (worldPos.w != 0)
+	if (gBuffer.pos.w != 0)
 	{
-		/*// Jitter intersection point within size of grid cell
-		float3 gridLoadPosition = worldPos + float3(nextRand(randSeed), nextRand(randSeed), nextRand(randSeed)) * 
-			2.0f - 1.0f) * gHalfGridCellSize;
-
-		// Find grid cell to sample from
-		int3 gridCellsCoords = mapWorldToGrid(gridLoadPosition);
-		uint gridCellIndex = coords3DToLinear(gridCellCoords, gLightGridDims);
-		uint gridCellStartIndex = gridCellIndex * gGridLightsPerCell;
-
-		Reservoir risReservoir = sampleLightUsingRIS(shadedPoint);
-		float lightSampleWeight = (risReservoir.totalWeight / M) / risReservoir.sampleTargetPdf;
-		LightSample light = loadLight(risReservoir.lightSample);
-		shadeColor = light.intensity * Brdf(light, worldPos) * lightSampleWeight;*/
+		shadeColor = float3(0.f, 0.f, 0.f);
+		LightGrid grid = { gGridOrigin, gGridCellSize, gGridCellCount, gGridLightsPerCell };
+
+		// Jitter intersection point within size of grid cell
+		float3 gridLoadPosition = gBuffer.pos.xyz;
+		if (gJitterCell) {
+			float3 jitter = float3(nextRand(randSeed), nextRand(randSeed), nextRand(randSeed)) * 2.0f - 1.0f;
+			gridLoadPosition += jitter * 0.5f * gGridCellSize;
+		}
+
+		// Find grid cell to sample from (falling back to the unjittered cell near the grid's border)
+		int gridCellIndex = mapWorldToGrid(gridLoadPosition, grid);
+		if (gridCellIndex < 0) gridCellIndex = mapWorldToGrid(gBuffer.pos.xyz, grid);
+
+		// To hold information about current light
+		float dist = 0.f;
+		float3 lightIntensity;
+		float3 lightDirection;
+
+		// Resample the cell's reservoirs with respect to this pixel's BSDF.  Each slot's W is an unbiased contribution
+		//     weight for the cell's target function, so it takes the place of 1 / p in the RIS weight.
+		Reservoir reservoir = { 0, 0, 0, 0 };
+		for (int i = 0; i < gLightSamples && gLightsCount > 0; i++) {
+			Reservoir candidate = { 0, 0, 0, 0 };
+			if (gridCellIndex >= 0) {
+				uint slot = min(uint(nextRand(randSeed) * gGridLightsPerCell), gGridLightsPerCell - 1);
+				candidate = createReservoir(gLightGrid[uint(gridCellIndex) * gGridLightsPerCell + slot]);
+			}
+			else {
+				// Outside the grid:  uniform light sampling, as in createLightSamples.hlsl
+				candidate.y = min(int(nextRand(randSeed) * gLightsCount), gLightsCount - 1);
+				candidate.W = float(gLightsCount);
+			}
+
+			float p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, candidate.y);
+			updateReservoir(reservoir, candidate.y, p_hat * candidate.W, randSeed);
+		}
+
+		// Calculate p_hat(r.y) for reservoir's light and its weight
+		if (reservoir.wSum > 0.f) {
+			float p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, reservoir.y);
+			reservoir.W = (p_hat == 0.f) ? 0.f : (1.f / p_hat) * (reservoir.wSum / reservoir.M);
+
+			// Lambertian dot product
+			float cosTheta = saturate(dot(gBuffer.norm.xyz, lightDirection));
+
+			// Shoot shadow ray
+			float shadow = shadowRayVisibility(gBuffer.pos.xyz, lightDirection, gMinT, dist);
+
+			// Compute Lambertian shading color, weighted by the reservoir
+			shadeColor = shadow * cosTheta * lightIntensity * reservoir.W;
+			shadeColor *= albedo / M_PI;
+			shadeColor /= dist * dist;
+		}
 	}
-	
+
 	gOutput[pixelIndex] = float4(shadeColor, 1.f);
-}
\ No newline at end of file
+}
@@ -0,0 +1,55 @@
+// ReSTIR GI, stage 3:  adds each pixel's indirect lighting, from the sample its final GI reservoir holds, to the direct
+//     lighting ShadeWithReservoirsPass wrote, and keeps this frame's temporal reservoirs for next frame.
+
+#include "HostDeviceSharedMacros.h"
+#include "HostDeviceData.h"
+#include "simpleGIUtils.hlsli"
+#include "shadowRay.hlsli"
+#include "restirGIUtils.hlsli"
+
+// Include and import common Falcor utilities and data structures
+import Raytracing;                   // Shared ray tracing specific functions & data
+import ShaderCommon;                 // Shared shading data structures
+import Shading;                      // Shading functions, etc
+import Lights;                       // Light structures for our current scene
+
+shared cbuffer GlobalCB
+{
+	bool  gDoIndirectLighting;   // Add the indirect lighting at all?
+}
+
+// Input and output textures
+shared Texture2D<float4>   gPos;           // G-buffer world-space position
+shared Texture2D<float4>   gNorm;          // G-buffer world-space normal
+shared Texture2D<float4>   gDiffuseMtl;    // G-buffer diffuse material
+shared RWTexture2D<float4> gShadedOutput;  // Direct lighting in, direct plus indirect out
+
+// GI reservoirs (see ReservoirStore)
+shared RWStructuredBuffer<PackedGIReservoir> gGICurrReservoirBuffer;      // After temporal reuse
+shared RWStructuredBuffer<PackedGIReservoir> gGISpatialReservoirBuffer;   // After spatial reuse
+shared RWStructuredBuffer<PackedGIReservoir> gGIPrevReservoirBuffer;      // Output:  kept for next frame's temporal reuse
+
+[shader("raygeneration")]
+void ShadeWithGIReservoirsRayGen()
+{
+	// Get our pixel's position on the screen
+	uint2 pixelIndex = DispatchRaysIndex().xy;
+	uint2 dim = DispatchRaysDimensions().xy;
+	uint index = giReservoirIndex(pixelIndex, dim);
+
+	// Next frame reuses our temporal reservoirs, not the spatial ones, so that neighbors' samples don't feed back into it
+	gGIPrevReservoirBuffer[index] = gGICurrReservoirBuffer[index];
+
+	float4 worldPos = gPos[pixelIndex];
+	if (!gDoIndirectLighting || worldPos.w == 0) return;
+
+	GIReservoir reservoir = unpackGIReservoir(gGISpatialReservoirBuffer[index]);
+	if (reservoir.W <= 0.f) return;
+
+	// Lambertian BRDF times the cosine toward the sample point, weighted by the reservoir
+	float3 toSample = normalize(reservoir.samplePos - worldPos.xyz);
+	float cosTheta = saturate(dot(gNorm[pixelIndex].xyz, toSample));
+	float3 indirect = gDiffuseMtl[pixelIndex].rgb / M_PI * reservoir.radiance * cosTheta * reservoir.W;
+
+	gShadedOutput[pixelIndex] = gShadedOutput[pixelIndex] + float4(indirect, 0.f);
+}
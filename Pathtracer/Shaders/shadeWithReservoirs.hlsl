@@ -17,6 +17,7 @@
 **********************************************************************************************************************/
 #include "HostDeviceSharedMacros.h"
 #include "HostDeviceData.h"
+#include "restirUtils.hlsli"
 #include "simpleGIUtils.hlsli"
 #include "shadowRay.hlsli"
 
@@ -44,10 +45,13 @@ shared Texture2D<float4>   gDiffuseMtl;    // G-buffer diffuse material
 shared Texture2D<float4>   gEmissive;
 shared Texture2D<float4>   gSpatialReservoirsIn;
 shared Texture2D<float4>   gSpatialReservoirsOut;
-shared Texture2D<float4>   gSpatialReservoirs;
-shared RWTexture2D<float4> gPrevReservoirs;
+shared Texture2D<float4>   gSpatialReservoirs;   // Shaded result (without ReSTIR)
 shared RWTexture2D<float4> gShadedOutput;        // Output to store shaded result
 
+// Per-pixel reservoirs (see ReservoirStore)
+shared RWStructuredBuffer<PackedReservoir> gSpatialReservoirBuffer;   // Final reservoirs of this frame
+shared RWStructuredBuffer<PackedReservoir> gPrevReservoirBuffer;      // Output:  kept for next frame's temporal reuse
+
 // Environment map
 shared Texture2D<float4>   gEnvMap;
 
@@ -181,22 +185,24 @@ void ShadeWithReservoirsRayGen()
 	// Initialize random number generator
 	uint randSeed = initRand(pixelIndex.x + dim.x * pixelIndex.y, gFrameCount, 16);
 
-	// Set previous reservoir
-	float4 reservoir = gSpatialReservoirs[pixelIndex];
-	gPrevReservoirs[pixelIndex] = reservoir;
-
 	float3 shadeColor = float3(0.f, 0.f, 0.f);
-	if (worldPos.w != 0)
+	if (gEnableReSTIR)
 	{
-		if (gEnableReSTIR)
+		// Keep our reservoirs for next frame, and average the contributions of all of them
+		for (uint k = 0; k < RESERVOIRS_PER_PIXEL; k++)
 		{
+			uint index = reservoirIndex(pixelIndex, dim, k);
+			PackedReservoir reservoir = gSpatialReservoirBuffer[index];
+			gPrevReservoirBuffer[index] = reservoir;
+			if (worldPos.w == 0) continue;
+
 			// Do shading with light stored in reservoir
 			float dist;
 			float3 lightIntensity;
 			float3 lightDirection;
 
-			int lightSample = gSpatialReservoirs[pixelIndex].x;
-			getLightData(lightSample, worldPos.xyz, lightDirection, lightIntensity, dist);
+			int lightSample = int(reservoir.lightId);
+			getCandidateLightData(lightSample, worldPos.xyz, lightDirection, lightIntensity, dist);
 
 			// Lambertian dot product
 			float cosTheta = saturate(dot(worldNorm.xyz, lightDirection));
@@ -205,11 +211,17 @@ void ShadeWithReservoirsRayGen()
 			float shadow = shadowRayVisibility(worldPos.xyz, lightDirection, gMinT, dist);
 
 			// Compute Lambertian shading color (divide by probability of light = 1.0 / N)
-			shadeColor = shadow * cosTheta * lightIntensity * gSpatialReservoirs[pixelIndex].z;
-			shadeColor *= albedo / M_PI;
-			shadeColor /= dist * dist;
+			float3 color = shadow * cosTheta * lightIntensity * reservoir.W;
+			color *= albedo / M_PI;
+			color /= dist * dist;
+			shadeColor += color;
 		}
-		else
+		shadeColor /= float(RESERVOIRS_PER_PIXEL);
+	}
+
+	if (worldPos.w != 0)
+	{
+		if (!gEnableReSTIR)
 		{
 			shadeColor = gSpatialReservoirs[pixelIndex].xyz;
 		}
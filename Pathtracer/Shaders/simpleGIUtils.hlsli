@@ -106,15 +106,12 @@ uint initRand(uint val0, uint val1, uint backoff = 16)
 float nextRand(inout uint s)
 {
 	s = (1664525u * s + 1013904223u);
-	return float(s & 0x00FFFFFF) / float(0x01000000);
+	return float(s >> 8) / float(0x01000000);
 }
 
-// Get a cosine-weighted random vector centered around a specified normal direction.
-float3 getCosHemisphereSample(inout uint randSeed, float3 hitNorm)
+// Get a cosine-weighted vector centered around a specified normal direction, from 2 uniform numbers
+float3 getCosHemisphereSample(float2 randVal, float3 hitNorm)
 {
-	// Get 2 random numbers to select our sample with
-	float2 randVal = float2(nextRand(randSeed), nextRand(randSeed));
-
 	// Cosine weighted hemisphere sample from RNG
 	float3 bitangent = getPerpendicularVector(hitNorm);
 	float3 tangent = cross(bitangent, hitNorm);
@@ -125,6 +122,14 @@ float3 getCosHemisphereSample(inout uint randSeed, float3 hitNorm)
 	return tangent * (r * cos(phi).x) + bitangent * (r * sin(phi)) + hitNorm.xyz * sqrt(max(0.0, 1.0f - randVal.x));
 }
 
+// Get a cosine-weighted random vector centered around a specified normal direction.
+float3 getCosHemisphereSample(inout uint randSeed, float3 hitNorm)
+{
+	// Get 2 random numbers to select our sample with
+	float2 randVal = float2(nextRand(randSeed), nextRand(randSeed));
+	return getCosHemisphereSample(randVal, hitNorm);
+}
+
 // Get a uniform weighted random vector centered around a specified normal direction.
 float3 getUniformHemisphereSample(inout uint randSeed, float3 hitNorm)
 {
@@ -20,9 +20,11 @@
 #include "restirUtils.hlsli"
 #include "simpleGIUtils.hlsli"
 #include "shadowRay.hlsli"
+#include "SampleSequences.h"
+#include "SpatialReuseParams.h"
 
 #define PI                 3.14159265f
-#define SPATIAL_LENGTH     6            // length of pixel and reservoir array
+#define SPATIAL_LENGTH     8            // Most neighbors the unbiased weights keep track of
 
 // Include and import common Falcor utilities and data structures
 import Raytracing;                   // Shared ray tracing specific functions & data
@@ -32,34 +34,29 @@ import Lights;                       // Light structures for our current scene
 
 shared cbuffer GlobalCB
 {
-	float gMinT;          // Avoid ray self-intersection
-	uint  gFrameCount;    // Frame counter to act as random seed 
-	uint  gMaxDepth;      // Max recursion depth
-	uint  gSpatialNeighbors;
-	uint  gSpatialRadius;
-	uint  gIter;
-	uint  gTotalIter;
-
-	bool  gEnableReSTIR;  
-	bool  gDoSpatialReuse;
+	SpatialReuseParams gParams;   // See SpatialReuseParams.h
 }
 
 // Input and output textures
 shared Texture2D<float4>   gPos;           // G-buffer world-space position
 shared Texture2D<float4>   gNorm;          // G-buffer world-space normal
 shared Texture2D<float4>   gDiffuseMtl;    // G-buffer diffuse material
-shared RWTexture2D<float4> gCurrReservoirs;        // Output to store shaded result
-shared RWTexture2D<float4> gSpatialReservoirs;     // Output to store shaded result
-shared RWTexture2D<float4> gSpatialReservoirsOut;     // Output to store shaded result
+shared RWTexture2D<float4> gSpatialReservoirs;     // Output to store shaded result (without ReSTIR)
+
+// Per-pixel reservoirs (see ReservoirStore)
+shared RWStructuredBuffer<PackedReservoir> gCurrReservoirBuffer;         // Input on the first iteration
+shared RWStructuredBuffer<PackedReservoir> gSpatialReservoirOutBuffer;   // Between iterations
+shared RWStructuredBuffer<PackedReservoir> gSpatialReservoirBuffer;      // Output of the last iteration
 
 
 // Environment map
 shared Texture2D<float4>   gEnvMap;
 
-float3 lambertianDirect(inout uint rndSeed, float3 hit, float3 norm, float3 diffuseColor)
+// Direct lighting from a single light, picked by the uniform number u
+float3 lambertianDirect(float u, float3 hit, float3 norm, float3 diffuseColor)
 {
 	// Pick a single random light to sample
-	int light = min(int(nextRand(rndSeed) * gLightsCount), gLightsCount - 1);
+	int light = min(int(u * gLightsCount), gLightsCount - 1);
 
 	// Query scene to get information about current light
 	float dist;
@@ -72,7 +69,7 @@ float3 lambertianDirect(inout uint rndSeed, float3 hit, float3 norm, float3 diff
 	float cosTheta = saturate(dot(norm, lightDirection));
 
 	// Shoot shadow ray
-	float shadow = shadowRayVisibility(hit, lightDirection, gMinT, dist);
+	float shadow = shadowRayVisibility(hit, lightDirection, gParams.minT, dist);
 
 	// Compute Lambertian shading color (divide by probability of light = 1.0 / N)
 	float3 color = gLightsCount * shadow * cosTheta * lightIntensity;
@@ -82,13 +79,14 @@ float3 lambertianDirect(inout uint rndSeed, float3 hit, float3 norm, float3 diff
 	return color;
 }
 
-uint2 getSpatialNeighborIndex(uint2 pixelIndex, uint2 dim, inout uint randSeed) {
+// A neighbor within the spatial radius of our pixel, picked by the 2D uniform point u
+uint2 getSpatialNeighborIndex(uint2 pixelIndex, uint2 dim, float2 u) {
 	uint2 neighborIndex = uint2(0, 0);
 	uint2 neighborOffset = uint2(0, 0);
 
 	// Alternative method
-	/*float r = radius * nextRand(randSeed);
-	float angle = 2.0f * M_PI * nextRand(randSeed);
+	/*float r = radius * u.x;
+	float angle = 2.0f * M_PI * u.y;
 	float2 neighborIndex2 = pixelIndex;
 	neighborIndex2.x += r * cos(angle);
 	neighborIndex2.y += r * sin(angle);
@@ -97,8 +95,8 @@ uint2 getSpatialNeighborIndex(uint2 pixelIndex, uint2 dim, inout uint randSeed)
 	u_neighborIndex.y = max(0, min(u_neighborIndex.y, dim.y - 1));*/
 
 	// Calculate neighbor offset -> [0, 1] -> [0, 2 * NEIGHBOR_RADIUS] -> [-NEIGHBOR_RADIUS, NEIGHBOR_RADIUS]
-	neighborOffset.x = int(nextRand(randSeed) * 2 * gSpatialRadius) - gSpatialRadius;
-	neighborOffset.y = int(nextRand(randSeed) * 2 * gSpatialRadius) - gSpatialRadius;
+	neighborOffset.x = int(u.x * 2 * gParams.spatialRadius) - gParams.spatialRadius;
+	neighborOffset.y = int(u.y * 2 * gParams.spatialRadius) - gParams.spatialRadius;
 
 	// Clamp index
 	neighborIndex.x = max(0, min(pixelIndex.x + neighborOffset.x, dim.x - 1));
@@ -108,6 +106,13 @@ uint2 getSpatialNeighborIndex(uint2 pixelIndex, uint2 dim, inout uint randSeed)
 	return u_neighborIndex;
 }
 
+// Reservoir k of a pixel, as left by the previous iteration (or by CreateLightSamplesPass)
+Reservoir loadInputReservoir(uint2 pixelIndex, uint2 dim, uint k)
+{
+	uint index = reservoirIndex(pixelIndex, dim, k);
+	return unpackReservoir((gParams.iter != 0) ? gSpatialReservoirOutBuffer[index] : gCurrReservoirBuffer[index]);
+}
+
 [shader("raygeneration")]
 void SpatialReuseRayGen()
 {
@@ -123,65 +128,93 @@ void SpatialReuseRayGen()
 
 	float3 albedo = gBuffer.color.rgb;
 
-	// Initialize random number generator
-	uint randSeed = initRand(pixelIndex.x + dim.x * pixelIndex.y, gFrameCount, 16);
+	// Each iteration of each frame draws the next points of the pixel's sequences (see SampleSequences.h)
+	PixelSampler pixelSampler = createPixelSampler(gParams.samplerType, pixelIndex.x, pixelIndex.y);
+	uint iteration = gParams.frameCount * gParams.totalIter + gParams.iter;
 
-	// Get this pixel's reservoir
-	Reservoir reservoir = createReservoir(gCurrReservoirs[pixelIndex]);
-	if (gIter != 0) {
-		reservoir = createReservoir(gSpatialReservoirsOut[pixelIndex]);
+	float3 shadeColor = float3(0.f, 0.f, 0.f);
+	if (gBuffer.pos.w == 0)
+	{
+		shadeColor = albedo;
+	}
+	else if (gParams.enableReSTIR == 0 || gParams.doSpatialReuse == 0)
+	{
+		shadeColor += lambertianDirect(pixelSample(pixelSampler, SAMPLE_DOMAIN_DIRECT_LIGHT, gParams.frameCount, 0), gBuffer.pos.xyz, gBuffer.norm.xyz, gBuffer.color.rgb);
 	}
 
-	Reservoir spatialReservoir = { 0, 0, 0, 0 };
+	gSpatialReservoirs[pixelIndex] = float4(shadeColor, 1.f);
+	if (gParams.enableReSTIR == 0) return;
+
+	if (gParams.doSpatialReuse == 0)
+	{
+		for (uint k = 0; k < RESERVOIRS_PER_PIXEL; k++) {
+			uint index = reservoirIndex(pixelIndex, dim, k);
+			gSpatialReservoirBuffer[index] = gCurrReservoirBuffer[index];
+		}
+		return;
+	}
+
+	// Each of our reservoirs is combined with the same-numbered reservoir of the same neighbors
+	Reservoir spatialReservoirs[RESERVOIRS_PER_PIXEL];
+	float sampleCounts[RESERVOIRS_PER_PIXEL];
+	for (uint k = 0; k < RESERVOIRS_PER_PIXEL; k++) {
+		Reservoir empty = { 0, 0, 0, 0 };
+		spatialReservoirs[k] = empty;
+		sampleCounts[k] = 0.f;
+	}
 
-	float3 shadeColor = float3(0.f, 0.f, 0.f);
 	if (gBuffer.pos.w != 0)
 	{
 		// To hold information about current light
 		float dist;
 		float3 lightIntensity;
 		float3 lightDirection;
+		float p_hat;
 
+		// Neighbors we combined, for the unbiased weights (which are why we stop at SPATIAL_LENGTH of them)
 		uint2 q[SPATIAL_LENGTH];
-		Reservoir r[SPATIAL_LENGTH];
+		uint neighborCount = 0;
+		int neighbors = (gParams.unbiased != 0) ? min(int(gParams.spatialNeighbors), SPATIAL_LENGTH) : int(gParams.spatialNeighbors);
+
+		// Combine current reservoirs with spatial reservoirs
+		for (uint k = 0; k < RESERVOIRS_PER_PIXEL; k++) {
+			Reservoir reservoir = loadInputReservoir(pixelIndex, dim, k);
+			p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, reservoir.y);
+			uint risIndex = (iteration * RESERVOIRS_PER_PIXEL + k) * (gParams.spatialNeighbors + 1);
+			updateReservoir(spatialReservoirs[k], reservoir.y, p_hat * reservoir.W * reservoir.M, pixelSample(pixelSampler, SAMPLE_DOMAIN_SPATIAL_RIS, risIndex, 0));
+			sampleCounts[k] = reservoir.M;
+		}
 
-		if (gEnableReSTIR && gDoSpatialReuse)
+		// Loop through neighbors and combine them with spatial reservoirs
+		for (int i = 0; i < neighbors; ++i)
 		{
-			// Combine current reservoir with spatial reservoir
-			float p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, reservoir.y);
-			updateReservoir(spatialReservoir, reservoir.y, p_hat * reservoir.W * reservoir.M, randSeed);
-			q[0] = pixelIndex;
-			r[0] = reservoir;
-
-			// Loop through neighbors and combine them with spatial reservoir
-			float sampleCount = reservoir.M;
-			for (int i = 0; i < gSpatialNeighbors; ++i)
-			{
-				uint2 neighborIndex = getSpatialNeighborIndex(pixelIndex, dim, randSeed);
-				Reservoir neighborReservoir = createReservoir(gCurrReservoirs[neighborIndex]);
-				if (gIter != 0) {
-					neighborReservoir = createReservoir(gSpatialReservoirsOut[neighborIndex]);
-				}
-				q[i + 1] = neighborIndex;
-				r[i + 1] = neighborReservoir;
+			uint neighborSample = iteration * gParams.spatialNeighbors + i;
+			float2 u = float2(pixelSample(pixelSampler, SAMPLE_DOMAIN_NEIGHBOR, neighborSample, 0), pixelSample(pixelSampler, SAMPLE_DOMAIN_NEIGHBOR, neighborSample, 1));
+			uint2 neighborIndex = getSpatialNeighborIndex(pixelIndex, dim, u);
 
-				float4 neighborNorm = gNorm[neighborIndex];
+			float4 neighborNorm = gNorm[neighborIndex];
 
-				// Check that the angle between the normals are within 25-50 degrees
-				if ((dot(gBuffer.norm.xyz, neighborNorm.xyz)) < 0.9) continue;
+			// Check that the angle between the normals are within 25-50 degrees
+			if ((dot(gBuffer.norm.xyz, neighborNorm.xyz)) < 0.9) continue;
 
-				// Check if neighbor exceeds 10% of current pixel's depth
-				if (neighborNorm.w > 1.1f * gBuffer.norm.w || neighborNorm.w < 0.9f * gBuffer.norm.w) continue;
+			// Check if neighbor exceeds 10% of current pixel's depth
+			if (neighborNorm.w > 1.1f * gBuffer.norm.w || neighborNorm.w < 0.9f * gBuffer.norm.w) continue;
 
-				// Combine neighbor's reservoir
+			// Combine neighbor's reservoirs
+			if (neighborCount < SPATIAL_LENGTH) q[neighborCount++] = neighborIndex;
+			for (uint k = 0; k < RESERVOIRS_PER_PIXEL; k++) {
+				Reservoir neighborReservoir = loadInputReservoir(neighborIndex, dim, k);
 				p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, neighborReservoir.y);
-				updateReservoir(spatialReservoir, neighborReservoir.y, p_hat * neighborReservoir.W * neighborReservoir.M, randSeed);
-			
-				sampleCount += neighborReservoir.M;
+				uint risIndex = (iteration * RESERVOIRS_PER_PIXEL + k) * (gParams.spatialNeighbors + 1) + i + 1;
+				updateReservoir(spatialReservoirs[k], neighborReservoir.y, p_hat * neighborReservoir.W * neighborReservoir.M, pixelSample(pixelSampler, SAMPLE_DOMAIN_SPATIAL_RIS, risIndex, 0));
+				sampleCounts[k] += neighborReservoir.M;
 			}
+		}
 
+		for (uint k = 0; k < RESERVOIRS_PER_PIXEL; k++) {
 			// Update M
-			spatialReservoir.M = sampleCount;
+			Reservoir spatialReservoir = spatialReservoirs[k];
+			spatialReservoir.M = sampleCounts[k];
 
 			// Update weight
 			p_hat = evaluatePHat(gBuffer, lightDirection, lightIntensity, dist, spatialReservoir.y);
@@ -189,61 +222,49 @@ void SpatialReuseRayGen()
 			if (p_hat == 0.f) {
 				spatialReservoir.W = 0.f;
 			}
-			else {
-#ifdef BIASED
+			else if (gParams.unbiased == 0) {
 				spatialReservoir.W = (1.f / p_hat) * (spatialReservoir.wSum / spatialReservoir.M);
-#endif
-#ifdef UNBIASED
-				float p_hat_orig = p_hat;
-				float Z = 0.f;
-				for (int i = 0; i < SPATIAL_LENGTH; i++) {
-					// Get gBuffer data
-					GBuffer pixelGBuffer;
-					pixelGBuffer.pos = gPos[q[i]];
-					pixelGBuffer.norm = gNorm[q[i]];
-					pixelGBuffer.color = gDiffuseMtl[q[i]];
-
-					p_hat = evaluatePHat(pixelGBuffer, lightDirection, lightIntensity, dist, spatialReservoir.y);
-					if (p_hat > 0) {
-						Z += r[i].M;
+			}
+			else {
+				// Only count the samples of pixels that could have produced spatialReservoir.y.  Ours can (p_hat > 0), and
+				//     if it cannot see the sample, the visibility test below zeroes W anyway.
+				float Z = loadInputReservoir(pixelIndex, dim, k).M;
+				for (uint i = 0; i < neighborCount; i++) {
+					GBuffer neighborGBuffer;
+					neighborGBuffer.pos = gPos[q[i]];
+					neighborGBuffer.norm = gNorm[q[i]];
+					neighborGBuffer.color = gDiffuseMtl[q[i]];
+
+					float3 neighborLightDirection;
+					float3 neighborLightIntensity;
+					float neighborDist;
+					float neighbor_p_hat = evaluatePHat(neighborGBuffer, neighborLightDirection, neighborLightIntensity, neighborDist, spatialReservoir.y);
+					if (neighbor_p_hat > 0.f && gParams.unbiasedVisibility != 0) {
+						neighbor_p_hat *= shadowRayVisibility(neighborGBuffer.pos.xyz, neighborLightDirection, gParams.minT, neighborDist);
+					}
+					if (neighbor_p_hat > 0.f) {
+						Z += loadInputReservoir(q[i], dim, k).M;
 					}
 				}
-				spatialReservoir.W = (1.f / p_hat_orig) * (spatialReservoir.wSum / Z);
-#endif
+				spatialReservoir.W = (Z > 0.f) ? (1.f / p_hat) * (spatialReservoir.wSum / Z) : 0.f;
 			}
 
 			// Evaluate visibility for initial candidates
-			float shadowed = shadowRayVisibility(gBuffer.pos.xyz, lightDirection, gMinT, dist);
+			float shadowed = shadowRayVisibility(gBuffer.pos.xyz, lightDirection, gParams.minT, dist);
 			if (shadowed <= 0.001f) {
 				spatialReservoir.W = 0.f;
 			}
+			spatialReservoirs[k] = spatialReservoir;
 		}
-		else
-		{
-			shadeColor += lambertianDirect(randSeed, gBuffer.pos.xyz, gBuffer.norm.xyz, gBuffer.color.rgb);
-		}
-	}
-	else
-	{
-		shadeColor = albedo;
 	}
 
-	gSpatialReservoirs[pixelIndex] = float4(shadeColor, 1.f);
-
-	if (gEnableReSTIR)
-	{
-		if (gDoSpatialReuse)
-		{
-			if (gIter == gTotalIter - 1) {
-				gSpatialReservoirs[pixelIndex] = float4(spatialReservoir.y, spatialReservoir.M, spatialReservoir.W, spatialReservoir.wSum);
-			}
-			else {
-				gSpatialReservoirsOut[pixelIndex] = float4(spatialReservoir.y, spatialReservoir.M, spatialReservoir.W, spatialReservoir.wSum);
-			}
+	for (uint k = 0; k < RESERVOIRS_PER_PIXEL; k++) {
+		uint index = reservoirIndex(pixelIndex, dim, k);
+		if (gParams.iter == gParams.totalIter - 1) {
+			gSpatialReservoirBuffer[index] = packReservoir(spatialReservoirs[k]);
 		}
-		else
-		{
-			gSpatialReservoirs[pixelIndex] = gCurrReservoirs[pixelIndex];
+		else {
+			gSpatialReservoirOutBuffer[index] = packReservoir(spatialReservoirs[k]);
 		}
 	}
 }
\ No newline at end of file
@@ -35,7 +35,7 @@ uint initRand(uint val0, uint val1, uint backoff = 16)
 float nextRand(inout uint s)
 {
 	s = (1664525u * s + 1013904223u);
-	return float(s & 0x00FFFFFF) / float(0x01000000);
+	return float(s >> 8) / float(0x01000000);
 }
 
 // This function tests if the alpha test fails, given the attributes of the current hit. 
@@ -0,0 +1,122 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#include "AsyncImageWriter.h"
+
+AsyncImageWriter::SharedPtr AsyncImageWriter::create(uint32_t maxQueued)
+{
+	if (maxQueued == 0) return nullptr;
+	return SharedPtr(new AsyncImageWriter(maxQueued));
+}
+
+AsyncImageWriter::AsyncImageWriter(uint32_t maxQueued) : mMaxQueued(maxQueued)
+{
+	mThread = std::thread(&AsyncImageWriter::workerLoop, this);
+}
+
+AsyncImageWriter::~AsyncImageWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWorkAvailable.notify_all();
+	mThread.join();
+}
+
+bool AsyncImageWriter::isSupportedFile(const std::string& filename)
+{
+	return hasSuffix(filename, ".exr", false) || hasSuffix(filename, ".pfm", false);
+}
+
+bool AsyncImageWriter::write(const std::string& filename, uint32_t width, uint32_t height, std::vector<vec4>&& pixels)
+{
+	if (!isSupportedFile(filename))
+	{
+		logWarning("AsyncImageWriter::write() - " + filename + " is neither an .exr nor a .pfm file");
+		return false;
+	}
+	if (pixels.size() != size_t(width) * height)
+	{
+		logWarning("AsyncImageWriter::write() - " + filename + " has " + std::to_string(pixels.size()) + " pixels, expected " +
+			std::to_string(width) + "x" + std::to_string(height));
+		return false;
+	}
+
+	Job job;
+	job.filename = filename;
+	job.width = width;
+	job.height = height;
+	job.format = hasSuffix(filename, ".pfm", false) ? Bitmap::FileFormat::PfmFile : Bitmap::FileFormat::ExrFile;
+	job.pixels = std::move(pixels);
+
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mSpaceAvailable.wait(lock, [this] { return mQueue.size() < mMaxQueued; });
+		mQueue.push_back(std::move(job));
+	}
+	mWorkAvailable.notify_one();
+	return true;
+}
+
+void AsyncImageWriter::flush()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mSpaceAvailable.wait(lock, [this] { return mQueue.empty() && !mBusy; });
+}
+
+uint32_t AsyncImageWriter::getWrittenCount() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mWrittenCount;
+}
+
+float AsyncImageWriter::getWriteTime() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mWriteTime;
+}
+
+void AsyncImageWriter::workerLoop()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWorkAvailable.wait(lock, [this] { return mStop || !mQueue.empty(); });
+			if (mQueue.empty()) return;   // Stopping, and everything has been written
+			job = std::move(mQueue.front());
+			mQueue.pop_front();
+			mBusy = true;
+		}
+		mSpaceAvailable.notify_all();
+
+		CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+		Bitmap::saveImage(job.filename, job.width, job.height, job.format, Bitmap::ExportFlags::None, ResourceFormat::RGBA32Float, true, job.pixels.data());
+		float duration = CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint());
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mBusy = false;
+			mWrittenCount++;
+			mWriteTime += duration;
+		}
+		mSpaceAvailable.notify_all();
+	}
+}
@@ -0,0 +1,92 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#pragma once
+
+#include "Falcor.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/** Writes HDR images to disk on a background thread, so that rendering the next frame overlaps encoding the last one.
+
+    Images are RGBA32Float, top row first, and are saved with Bitmap::saveImage() as OpenEXR or PFM (chosen by the
+    filename's extension; both keep RGB only).  At most <maxQueued> images wait to be written at any time; write()
+    blocks the caller until there is room, which bounds memory use when rendering outpaces the disk.
+
+Usage:
+     AsyncImageWriter::SharedPtr pWriter = AsyncImageWriter::create();
+     pWriter->write("frames/out_0000.exr", width, height, std::move(pixels));   // Returns as soon as it's queued
+     pWriter->flush();                                                          // Wait for everything queued so far
+
+The destructor writes everything still queued before returning.
+*/
+
+using namespace Falcor;
+
+class AsyncImageWriter : public std::enable_shared_from_this<AsyncImageWriter>
+{
+public:
+	using SharedPtr = std::shared_ptr<AsyncImageWriter>;
+	using SharedConstPtr = std::shared_ptr<const AsyncImageWriter>;
+	virtual ~AsyncImageWriter();
+
+	// Start the writer thread.  Returns nullptr if maxQueued is 0.
+	static SharedPtr create(uint32_t maxQueued = 4);
+
+	// Returns true if we know how to write <filename> (it ends in .exr or .pfm)
+	static bool isSupportedFile(const std::string& filename);
+
+	// Queue an image of width * height texels for writing.  Blocks while the queue is full.  Returns false (and drops the
+	//     image) if the filename is not supported or the pixel count doesn't match.
+	bool write(const std::string& filename, uint32_t width, uint32_t height, std::vector<vec4>&& pixels);
+
+	// Block until every image queued so far has been written
+	void flush();
+
+	// Accessors
+	uint32_t getWrittenCount() const;                    ///< Images written so far
+	float    getWriteTime() const;                       ///< Total time (ms) the writer thread spent saving them
+
+protected:
+	AsyncImageWriter(uint32_t maxQueued);
+
+	struct Job
+	{
+		std::string        filename;
+		uint32_t           width = 0;
+		uint32_t           height = 0;
+		Bitmap::FileFormat format = Bitmap::FileFormat::ExrFile;
+		std::vector<vec4>  pixels;
+	};
+
+	void workerLoop();
+
+	const uint32_t               mMaxQueued;
+	std::deque<Job>              mQueue;
+	bool                         mBusy = false;       ///< The worker is writing a job it has already taken off the queue
+	bool                         mStop = false;
+	uint32_t                     mWrittenCount = 0;
+	float                        mWriteTime = 0.f;
+
+	mutable std::mutex           mMutex;
+	std::condition_variable      mWorkAvailable;      ///< Signaled when a job is queued, or we're stopping
+	std::condition_variable      mSpaceAvailable;     ///< Signaled when a job is taken off the queue or finished
+	std::thread                  mThread;
+};
@@ -16,47 +16,73 @@
 # ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 **********************************************************************************************************************/
 
-#include "RenderPass.h"
-#include "Externals/dear_imgui/imgui.h"
+#include "ComputePass.h"
 
 using namespace Falcor;
 
-// public
+ComputePass::SharedPtr ComputePass::create(const char *computeShader, const char *csEntry)
+{
+	return SharedPtr(new ComputePass(computeShader, csEntry));
+}
 
-bool ::RenderPass::onInitialize(RenderContext* pRenderContext, ResourceManager::SharedPtr pResManager)
+ComputePass::ComputePass(const char *computeShader, const char *csEntry)
 {
-    assert(!mIsInitialized);
-	mIsInitialized = initialize(pRenderContext, pResManager);
-    return mIsInitialized;
+	mpProgram = ComputeProgram::createFromFile(computeShader, csEntry);
+	mpState = ComputeState::create();
+	mpState->setProgram(mpProgram);
+	mInvalidVarReflector = true;
 }
 
-void ::RenderPass::onRenderGui(Gui* pGui)
+void ComputePass::execute(RenderContext* pRenderContext, uint32_t nThreadX, uint32_t nThreadY, uint32_t nThreadZ)
 {
-    // Record current UI pos/size
-    ImVec2 pos = ImGui::GetWindowPos();
-    ImVec2 size = ImGui::GetWindowSize();
+	// Ok.  We're executing.  If we still have an invalid shader variable reflector, we'd better get one now!
+	if (mInvalidVarReflector) createComputeVariables();
 
-    mGuiPosition.x = (int)std::round(pos.x);
-    mGuiPosition.y = (int)std::round(pos.y);
-    mGuiSize.x = std::max(32, (int)std::round(size.x));
-    mGuiSize.y = std::max(32, (int)std::round(size.y));
+	if (mpProgram && mpVars && pRenderContext)
+	{
+		uvec3 groupSize = getThreadGroupSize();
+		uvec3 groups = (uvec3(nThreadX, nThreadY, nThreadZ) + groupSize - uvec3(1)) / groupSize;
 
-    renderGui(pGui);
+		pRenderContext->pushComputeState(mpState);
+		pRenderContext->pushComputeVars(mpVars);
+			pRenderContext->dispatch(groups.x, groups.y, groups.z);
+		pRenderContext->popComputeVars();
+		pRenderContext->popComputeState();
+	}
 }
 
-void ::RenderPass::onExecute(RenderContext* pRenderContext)
-{ 
-	mRefreshFlag = false;     // Did come afterwards, but that prevents discovery of a required refresh while rendering
-    execute(pRenderContext);
+void ComputePass::createComputeVariables()
+{
+	// Do we need to recreate our variables?  Do we also have a valid shader?
+	if (mInvalidVarReflector && mpProgram)
+	{
+		mpVars       = ComputeVars::create(mpProgram->getActiveVersion()->getReflector());
+		mpSimpleVars = SimpleVars::create(mpVars.get());
+		mInvalidVarReflector = false;
+	}
+}
+
+SimpleVars::SharedPtr ComputePass::getVars()
+{
+	if (mInvalidVarReflector)
+		createComputeVariables();
+
+	return mpSimpleVars;
+}
+
+uvec3 ComputePass::getThreadGroupSize() const
+{
+	return mpProgram->getActiveVersion()->getReflector()->getThreadGroupSize();
+}
+
+void ComputePass::addDefine(const std::string& name, const std::string& value)
+{
+	mpProgram->addDefine(name, value);
+	mInvalidVarReflector = true;
 }
 
-void ::RenderPass::onShutdown()
+void ComputePass::removeDefine(const std::string& name)
 {
-    // Enforce that onShutdown() is only called once, on successfully initialized passes.
-    assert(mIsInitialized);
-    if (mIsInitialized)
-    {
-        shutdown();
-    }
-    mIsInitialized = false;
+	mpProgram->removeDefine(name);
+	mInvalidVarReflector = true;
 }
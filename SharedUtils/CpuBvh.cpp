@@ -0,0 +1,561 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#include "CpuBvh.h"
+#include <algorithm>
+#include <emmintrin.h>
+
+namespace {
+	// Max triangles per leaf.  Leaves are stored as a single Tri4, so this must stay at 4.
+	const uint32_t kMaxLeafSize = 4;
+
+	// Number of centroid bins per axis used when evaluating SAH splits
+	const uint32_t kSahBins = 16;
+
+	// Beyond this depth, splits fall back to halving the range, which bounds the tree depth (and traversal stack use)
+	// even for pathological inputs
+	const uint32_t kMaxSahDepth = 48;
+
+	// Max entries on a traversal stack.  Each interior node pushes at most 3 entries more than it pops.
+	const uint32_t kStackSize = 256;
+
+	// Intermediate binary BVH, collapsed into Node4s once built
+	struct BinaryNode
+	{
+		vec3     boundsMin;
+		vec3     boundsMax;
+		uint32_t left = 0, right = 0;   ///< Children (interior nodes)
+		uint32_t begin = 0, count = 0;  ///< Range of the triangle order (leaves, count > 0)
+	};
+
+	float surfaceArea(const vec3& bMin, const vec3& bMax)
+	{
+		vec3 d = glm::max(bMax - bMin, vec3(0.0f));
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	// Avoid infinite reciprocals (and the NaNs they produce in the slab test) for axis-aligned rays
+	float safeReciprocal(float d)
+	{
+		const float kEpsilon = 1e-20f;
+		return 1.0f / ((fabsf(d) < kEpsilon) ? (d < 0.0f ? -kEpsilon : kEpsilon) : d);
+	}
+
+	// Moller-Trumbore for SoA triangles / rays.  Every operand is a 4-wide vector, so this either tests one ray (broadcast)
+	// against four triangles or four rays against one triangle (broadcast).  Barycentrics match DXR's (weights of vertices 1 and 2).
+	__m128 intersectTriangles(const __m128 o[3], const __m128 d[3], const __m128 v0[3], const __m128 e1[3], const __m128 e2[3],
+	                          const __m128& tMin, const __m128& tMax, __m128& t, __m128& u, __m128& v)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+		__m128 px = _mm_sub_ps(_mm_mul_ps(d[1], e2[2]), _mm_mul_ps(d[2], e2[1]));
+		__m128 py = _mm_sub_ps(_mm_mul_ps(d[2], e2[0]), _mm_mul_ps(d[0], e2[2]));
+		__m128 pz = _mm_sub_ps(_mm_mul_ps(d[0], e2[1]), _mm_mul_ps(d[1], e2[0]));
+		__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1[0], px), _mm_mul_ps(e1[1], py)), _mm_mul_ps(e1[2], pz));
+		__m128 valid = _mm_cmpge_ps(_mm_and_ps(det, absMask), _mm_set1_ps(1e-12f));
+		__m128 invDet = _mm_div_ps(one, det);
+
+		__m128 tx = _mm_sub_ps(o[0], v0[0]);
+		__m128 ty = _mm_sub_ps(o[1], v0[1]);
+		__m128 tz = _mm_sub_ps(o[2], v0[2]);
+		u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+
+		__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1[2]), _mm_mul_ps(tz, e1[1]));
+		__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1[0]), _mm_mul_ps(tx, e1[2]));
+		__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1[1]), _mm_mul_ps(ty, e1[0]));
+		v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], qx), _mm_mul_ps(d[1], qy)), _mm_mul_ps(d[2], qz)), invDet);
+		t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2[0], qx), _mm_mul_ps(e2[1], qy)), _mm_mul_ps(e2[2], qz)), invDet);
+
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+		valid = _mm_and_ps(valid, _mm_cmple_ps(u, one));
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+		valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(t, tMin));
+		valid = _mm_and_ps(valid, _mm_cmple_ps(t, tMax));
+		return valid;
+	}
+};
+
+void CpuBvh::RayPacket::setRay(uint32_t lane, const Ray& ray)
+{
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		origin[a][lane] = ray.origin[a];
+		direction[a][lane] = ray.direction[a];
+	}
+	tMin[lane] = ray.tMin;
+	tMax[lane] = ray.tMax;
+}
+
+CpuBvh::SharedPtr CpuBvh::create(const std::vector<vec3>& positions, const std::vector<uvec3>& indices,
+                                 const std::vector<uint8_t>& alphaTested, AlphaTestFunc alphaTest)
+{
+	if (indices.empty()) return nullptr;
+	if (!alphaTested.empty() && alphaTested.size() != indices.size())
+	{
+		logWarning("CpuBvh::create() - alphaTested must be empty or contain one entry per triangle");
+		return nullptr;
+	}
+
+	SharedPtr pBvh = SharedPtr(new CpuBvh());
+	pBvh->mAlphaTest = alphaTest;
+
+	CpuTimer timer;
+	CpuTimer::TimePoint start = timer.getCurrentTimePoint();
+	pBvh->build(positions, indices, alphaTest ? alphaTested : std::vector<uint8_t>());
+	pBvh->mBuildTime = float(timer.calcDuration(start, timer.getCurrentTimePoint()));
+	return pBvh;
+}
+
+void CpuBvh::build(const std::vector<vec3>& positions, const std::vector<uvec3>& indices, const std::vector<uint8_t>& alphaTested)
+{
+	uint32_t triCount = uint32_t(indices.size());
+	std::vector<uint32_t> triOrder(triCount);
+	for (uint32_t i = 0; i < triCount; i++) triOrder[i] = i;
+
+	// Per-triangle bounds and centroids, used throughout the build
+	std::vector<vec3> triMin(triCount), triMax(triCount), centroid(triCount);
+	for (uint32_t i = 0; i < triCount; i++)
+	{
+		const vec3& p0 = positions[indices[i].x];
+		const vec3& p1 = positions[indices[i].y];
+		const vec3& p2 = positions[indices[i].z];
+		triMin[i] = glm::min(p0, glm::min(p1, p2));
+		triMax[i] = glm::max(p0, glm::max(p1, p2));
+		centroid[i] = (triMin[i] + triMax[i]) * 0.5f;
+	}
+
+	// Step 1:  top-down binary build using a binned SAH
+	std::vector<BinaryNode> binNodes;
+	binNodes.reserve(2 * triCount / kMaxLeafSize + 1);
+
+	std::function<uint32_t(uint32_t, uint32_t, uint32_t)> buildNode = [&](uint32_t begin, uint32_t end, uint32_t depth) -> uint32_t
+	{
+		uint32_t nodeId = uint32_t(binNodes.size());
+		binNodes.push_back(BinaryNode());
+
+		vec3 bMin(FLT_MAX), bMax(-FLT_MAX), cMin(FLT_MAX), cMax(-FLT_MAX);
+		for (uint32_t i = begin; i < end; i++)
+		{
+			uint32_t tri = triOrder[i];
+			bMin = glm::min(bMin, triMin[tri]);
+			bMax = glm::max(bMax, triMax[tri]);
+			cMin = glm::min(cMin, centroid[tri]);
+			cMax = glm::max(cMax, centroid[tri]);
+		}
+		binNodes[nodeId].boundsMin = bMin;
+		binNodes[nodeId].boundsMax = bMax;
+
+		uint32_t count = end - begin;
+		if (count <= kMaxLeafSize)
+		{
+			binNodes[nodeId].begin = begin;
+			binNodes[nodeId].count = count;
+			return nodeId;
+		}
+
+		// Evaluate the SAH at every bin boundary along each axis, keeping the cheapest split
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		uint32_t bestBin = 0;
+		vec3 extent = cMax - cMin;
+		for (int axis = 0; axis < 3 && depth < kMaxSahDepth; axis++)
+		{
+			if (extent[axis] <= 0.0f) continue;
+			float scale = float(kSahBins) / extent[axis];
+
+			uint32_t binCount[kSahBins] = {};
+			vec3 binMin[kSahBins], binMax[kSahBins];
+			for (uint32_t b = 0; b < kSahBins; b++) { binMin[b] = vec3(FLT_MAX); binMax[b] = vec3(-FLT_MAX); }
+			for (uint32_t i = begin; i < end; i++)
+			{
+				uint32_t tri = triOrder[i];
+				uint32_t b = std::min(kSahBins - 1, uint32_t((centroid[tri][axis] - cMin[axis]) * scale));
+				binCount[b]++;
+				binMin[b] = glm::min(binMin[b], triMin[tri]);
+				binMax[b] = glm::max(binMax[b], triMax[tri]);
+			}
+
+			// Sweep from the right to get the area / count of everything right of each boundary, then sweep from the left
+			float rightArea[kSahBins];
+			uint32_t rightCount[kSahBins];
+			vec3 rMin(FLT_MAX), rMax(-FLT_MAX);
+			uint32_t rCount = 0;
+			for (uint32_t b = kSahBins - 1; b > 0; b--)
+			{
+				rMin = glm::min(rMin, binMin[b]);
+				rMax = glm::max(rMax, binMax[b]);
+				rCount += binCount[b];
+				rightArea[b] = surfaceArea(rMin, rMax);
+				rightCount[b] = rCount;
+			}
+
+			vec3 lMin(FLT_MAX), lMax(-FLT_MAX);
+			uint32_t lCount = 0;
+			for (uint32_t b = 1; b < kSahBins; b++)
+			{
+				lMin = glm::min(lMin, binMin[b - 1]);
+				lMax = glm::max(lMax, binMax[b - 1]);
+				lCount += binCount[b - 1];
+				if (lCount == 0 || rightCount[b] == 0) continue;
+
+				float cost = surfaceArea(lMin, lMax) * lCount + rightArea[b] * rightCount[b];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+
+		uint32_t mid;
+		if (bestAxis >= 0)
+		{
+			float scale = float(kSahBins) / extent[bestAxis];
+			float split = cMin[bestAxis];
+			mid = uint32_t(std::partition(triOrder.begin() + begin, triOrder.begin() + end, [&](uint32_t tri)
+			{
+				return std::min(kSahBins - 1, uint32_t((centroid[tri][bestAxis] - split) * scale)) < bestBin;
+			}) - triOrder.begin());
+		}
+		else
+		{
+			// All centroids coincide (or the tree is too deep); just halve the range along the widest axis
+			int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+			mid = begin + count / 2;
+			std::nth_element(triOrder.begin() + begin, triOrder.begin() + mid, triOrder.begin() + end,
+				[&](uint32_t a, uint32_t b) { return centroid[a][axis] < centroid[b][axis]; });
+		}
+
+		uint32_t leftId = buildNode(begin, mid, depth + 1);
+		uint32_t rightId = buildNode(mid, end, depth + 1);
+		binNodes[nodeId].left = leftId;
+		binNodes[nodeId].right = rightId;
+		return nodeId;
+	};
+	buildNode(0, triCount, 0);
+
+	// Step 2:  pack leaves into Tri4s
+	mNodes.clear();
+	mLeaves.clear();
+	mNodes.reserve(binNodes.size() / 3 + 1);
+	mLeaves.reserve(triCount / 2 + 1);
+
+	auto makeLeaf = [&](const BinaryNode& node) -> uint32_t
+	{
+		Tri4 leaf = {};
+		leaf.alphaMask = 0;
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			leaf.triangle[lane] = kInvalidIndex;
+			if (lane >= node.count) continue;     // Zero edges give a zero determinant, so unused lanes never hit
+
+			uint32_t tri = triOrder[node.begin + lane];
+			const vec3& p0 = positions[indices[tri].x];
+			vec3 e1 = positions[indices[tri].y] - p0;
+			vec3 e2 = positions[indices[tri].z] - p0;
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				leaf.v0[a][lane] = p0[a];
+				leaf.e1[a][lane] = e1[a];
+				leaf.e2[a][lane] = e2[a];
+			}
+			leaf.triangle[lane] = tri;
+			if (!alphaTested.empty() && alphaTested[tri]) leaf.alphaMask |= (1u << lane);
+		}
+		mLeaves.push_back(leaf);
+		return kLeafFlag | uint32_t(mLeaves.size() - 1);
+	};
+
+	// Step 3:  collapse the binary tree, pulling up grandchildren (largest surface area first) until each node has 4 children
+	std::function<uint32_t(uint32_t)> collapse = [&](uint32_t binId) -> uint32_t
+	{
+		const BinaryNode& node = binNodes[binId];
+		if (node.count > 0) return makeLeaf(node);
+
+		uint32_t children[4] = { node.left, node.right };
+		uint32_t childCount = 2;
+		while (childCount < 4)
+		{
+			int best = -1;
+			float bestArea = -1.0f;
+			for (uint32_t c = 0; c < childCount; c++)
+			{
+				const BinaryNode& child = binNodes[children[c]];
+				float area = surfaceArea(child.boundsMin, child.boundsMax);
+				if (child.count == 0 && area > bestArea)
+				{
+					bestArea = area;
+					best = int(c);
+				}
+			}
+			if (best < 0) break;
+
+			const BinaryNode& opened = binNodes[children[best]];
+			children[childCount++] = opened.right;
+			children[best] = opened.left;
+		}
+
+		uint32_t nodeId = uint32_t(mNodes.size());
+		mNodes.push_back(Node4());
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			uint32_t ref = (c < childCount) ? collapse(children[c]) : kInvalidIndex;
+			Node4& n = mNodes[nodeId];   // collapse() may have reallocated mNodes
+			n.child[c] = ref;
+			vec3 bMin = (c < childCount) ? binNodes[children[c]].boundsMin : vec3(FLT_MAX);
+			vec3 bMax = (c < childCount) ? binNodes[children[c]].boundsMax : vec3(-FLT_MAX);
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				n.bounds[2 * a][c] = bMin[a];
+				n.bounds[2 * a + 1][c] = bMax[a];
+			}
+		}
+		return nodeId;
+	};
+	mRoot = collapse(0);
+}
+
+template<bool kAnyHit>
+bool CpuBvh::traverse(const Ray& ray, Hit& hit) const
+{
+	__m128 o[3], d[3], inv[3], oInv[3];
+	uint32_t nearIdx[3], farIdx[3];
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		float invDir = safeReciprocal(ray.direction[a]);
+		o[a] = _mm_set1_ps(ray.origin[a]);
+		d[a] = _mm_set1_ps(ray.direction[a]);
+		inv[a] = _mm_set1_ps(invDir);
+		oInv[a] = _mm_set1_ps(ray.origin[a] * invDir);
+		nearIdx[a] = 2 * a + (invDir < 0.0f ? 1 : 0);
+		farIdx[a] = 2 * a + (invDir < 0.0f ? 0 : 1);
+	}
+	const __m128 tMin = _mm_set1_ps(ray.tMin);
+	float tMax = ray.tMax;
+	bool found = false;
+
+	struct StackEntry { uint32_t ref; float t; };
+	StackEntry stack[kStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = { mRoot, ray.tMin };
+
+	while (stackSize > 0)
+	{
+		StackEntry entry = stack[--stackSize];
+		if (entry.t > tMax) continue;
+
+		if (entry.ref & kLeafFlag)
+		{
+			const Tri4& leaf = mLeaves[entry.ref & ~kLeafFlag];
+			__m128 v0[3], e1[3], e2[3];
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				v0[a] = _mm_loadu_ps(leaf.v0[a]);
+				e1[a] = _mm_loadu_ps(leaf.e1[a]);
+				e2[a] = _mm_loadu_ps(leaf.e2[a]);
+			}
+			__m128 t, u, v;
+			int mask = _mm_movemask_ps(intersectTriangles(o, d, v0, e1, e2, tMin, _mm_set1_ps(tMax), t, u, v));
+			if (mask == 0) continue;
+
+			float tLane[4], uLane[4], vLane[4];
+			_mm_storeu_ps(tLane, t);
+			_mm_storeu_ps(uLane, u);
+			_mm_storeu_ps(vLane, v);
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				if (!(mask & (1 << lane)) || tLane[lane] > tMax) continue;
+
+				// Equivalent of the any-hit shader calling IgnoreHit()
+				vec2 bary(uLane[lane], vLane[lane]);
+				if ((leaf.alphaMask & (1u << lane)) && mAlphaTest(leaf.triangle[lane], bary)) continue;
+
+				hit.t = tLane[lane];
+				hit.triangle = leaf.triangle[lane];
+				hit.barycentrics = bary;
+				found = true;
+				if (kAnyHit) return true;
+				tMax = tLane[lane];
+			}
+		}
+		else
+		{
+			// Slab test against all four children at once
+			const Node4& node = mNodes[entry.ref];
+			__m128 tEnter = tMin, tExit = _mm_set1_ps(tMax);
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				__m128 tNear = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(node.bounds[nearIdx[a]]), inv[a]), oInv[a]);
+				__m128 tFar = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(node.bounds[farIdx[a]]), inv[a]), oInv[a]);
+				tEnter = _mm_max_ps(tEnter, tNear);
+				tExit = _mm_min_ps(tExit, tFar);
+			}
+			int mask = _mm_movemask_ps(_mm_cmple_ps(tEnter, tExit));
+			if (mask == 0) continue;
+
+			// Push hit children far-to-near, so the nearest is popped first
+			float tChild[4];
+			_mm_storeu_ps(tChild, tEnter);
+			StackEntry hits[4];
+			uint32_t hitCount = 0;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				if (!(mask & (1 << c))) continue;
+				StackEntry e = { node.child[c], tChild[c] };
+				uint32_t i = hitCount++;
+				for (; i > 0 && hits[i - 1].t < e.t; i--) hits[i] = hits[i - 1];
+				hits[i] = e;
+			}
+			for (uint32_t i = 0; i < hitCount; i++) stack[stackSize++] = hits[i];
+		}
+	}
+	return found;
+}
+
+template<bool kAnyHit>
+uint32_t CpuBvh::traverse4(const RayPacket& packet, HitPacket& hits) const
+{
+	uint32_t active = packet.activeMask & 0xF;
+	if (active == 0) return 0;
+
+	__m128 o[3], d[3], inv[3];
+	for (uint32_t a = 0; a < 3; a++)
+	{
+		float invDir[4];
+		for (uint32_t lane = 0; lane < 4; lane++) invDir[lane] = safeReciprocal(packet.direction[a][lane]);
+		o[a] = _mm_loadu_ps(packet.origin[a]);
+		d[a] = _mm_loadu_ps(packet.direction[a]);
+		inv[a] = _mm_loadu_ps(invDir);
+	}
+	const __m128 tMin = _mm_loadu_ps(packet.tMin);
+	float tMax[4];
+	for (uint32_t lane = 0; lane < 4; lane++) tMax[lane] = packet.tMax[lane];
+
+	// Children are ordered by their entry distance along the first active ray
+	uint32_t leader = 0;
+	while (!(active & (1u << leader))) leader++;
+
+	uint32_t hitMask = 0;
+	uint32_t stack[kStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = mRoot;
+
+	while (stackSize > 0)
+	{
+		uint32_t ref = stack[--stackSize];
+
+		if (ref & kLeafFlag)
+		{
+			const Tri4& leaf = mLeaves[ref & ~kLeafFlag];
+			for (uint32_t k = 0; k < 4 && leaf.triangle[k] != kInvalidIndex; k++)
+			{
+				__m128 v0[3], e1[3], e2[3];
+				for (uint32_t a = 0; a < 3; a++)
+				{
+					v0[a] = _mm_set1_ps(leaf.v0[a][k]);
+					e1[a] = _mm_set1_ps(leaf.e1[a][k]);
+					e2[a] = _mm_set1_ps(leaf.e2[a][k]);
+				}
+				__m128 t, u, v;
+				uint32_t mask = uint32_t(_mm_movemask_ps(intersectTriangles(o, d, v0, e1, e2, tMin, _mm_loadu_ps(tMax), t, u, v))) & active;
+				if (mask == 0) continue;
+
+				float tLane[4], uLane[4], vLane[4];
+				_mm_storeu_ps(tLane, t);
+				_mm_storeu_ps(uLane, u);
+				_mm_storeu_ps(vLane, v);
+				for (uint32_t lane = 0; lane < 4; lane++)
+				{
+					if (!(mask & (1u << lane))) continue;
+
+					vec2 bary(uLane[lane], vLane[lane]);
+					if ((leaf.alphaMask & (1u << k)) && mAlphaTest(leaf.triangle[k], bary)) continue;
+
+					hits.t[lane] = tLane[lane];
+					hits.triangle[lane] = leaf.triangle[k];
+					hits.barycentrics[0][lane] = bary.x;
+					hits.barycentrics[1][lane] = bary.y;
+					hitMask |= (1u << lane);
+					if (kAnyHit) active &= ~(1u << lane);
+					else tMax[lane] = tLane[lane];
+				}
+				if (kAnyHit && active == 0) return hitMask;
+			}
+		}
+		else
+		{
+			// Test each child against the whole packet
+			const Node4& node = mNodes[ref];
+			const __m128 tFarMax = _mm_loadu_ps(tMax);
+			uint32_t childRefs[4];
+			float childT[4];
+			uint32_t hitCount = 0;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				if (node.child[c] == kInvalidIndex) continue;
+
+				__m128 tEnter = tMin, tExit = tFarMax;
+				for (uint32_t a = 0; a < 3; a++)
+				{
+					__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds[2 * a][c]), o[a]), inv[a]);
+					__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds[2 * a + 1][c]), o[a]), inv[a]);
+					tEnter = _mm_max_ps(tEnter, _mm_min_ps(t0, t1));
+					tExit = _mm_min_ps(tExit, _mm_max_ps(t0, t1));
+				}
+				uint32_t mask = uint32_t(_mm_movemask_ps(_mm_cmple_ps(tEnter, tExit))) & active;
+				if (mask == 0) continue;
+
+				float tLane[4];
+				_mm_storeu_ps(tLane, tEnter);
+				float key = (mask & (1u << leader)) ? tLane[leader] : FLT_MAX;
+				uint32_t i = hitCount++;
+				for (; i > 0 && childT[i - 1] < key; i--) { childT[i] = childT[i - 1]; childRefs[i] = childRefs[i - 1]; }
+				childT[i] = key;
+				childRefs[i] = node.child[c];
+			}
+			for (uint32_t i = 0; i < hitCount; i++) stack[stackSize++] = childRefs[i];
+		}
+	}
+	return hitMask;
+}
+
+bool CpuBvh::intersect(const Ray& ray, Hit& hit) const
+{
+	return traverse<false>(ray, hit);
+}
+
+bool CpuBvh::occluded(const Ray& ray) const
+{
+	Hit hit;
+	return traverse<true>(ray, hit);
+}
+
+uint32_t CpuBvh::intersect4(const RayPacket& packet, HitPacket& hits) const
+{
+	return traverse4<false>(packet, hits);
+}
+
+uint32_t CpuBvh::occluded4(const RayPacket& packet) const
+{
+	HitPacket hits;
+	return traverse4<true>(packet, hits);
+}
@@ -0,0 +1,151 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#pragma once
+
+#include "Falcor.h"
+#include <functional>
+#include <vector>
+
+/** A 4-wide bounding volume hierarchy over a triangle soup, traversed with SSE.
+
+    The tree is built with a binned surface area heuristic (SAH) into a binary BVH, then collapsed so every
+    interior node holds the bounds of up to four children in SoA form (one SSE register per min/max axis).
+    Leaves hold up to four triangles, also in SoA form, so a single ray tests four boxes or four triangles
+    per instruction.  For coherent rays (e.g., primary rays of a 2x2 pixel quad), the packet queries trace four
+    rays at once, testing each box / triangle against the whole packet.
+
+    Both closest-hit and any-hit queries support an alpha test callback, which is only invoked for triangles
+    flagged as alpha tested at build time (i.e., geometry that would not be marked D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE).
+
+Usage:
+     CpuBvh::SharedPtr pBvh = CpuBvh::create(positions, indices, alphaTested, [&](uint32_t tri, const vec2& bary) { return alphaTestFails(tri, bary); });
+
+     CpuBvh::Hit hit;
+     if (pBvh->intersect(ray, hit)) { ... }            // hit.triangle indexes the input <indices>
+
+     CpuBvh::RayPacket packet;                         // Up to four rays; unused lanes are disabled via packet.activeMask
+     CpuBvh::HitPacket hits;
+     uint32_t hitMask = pBvh->intersect4(packet, hits);
+*/
+
+using namespace Falcor;
+
+class CpuBvh : public std::enable_shared_from_this<CpuBvh>
+{
+public:
+	using SharedPtr = std::shared_ptr<CpuBvh>;
+	using SharedConstPtr = std::shared_ptr<const CpuBvh>;
+	virtual ~CpuBvh() = default;
+
+	static const uint32_t kInvalidIndex = 0xFFFFFFFFu;
+
+	// Mirrors the HLSL RayDesc structure
+	struct Ray
+	{
+		vec3  origin;
+		float tMin;
+		vec3  direction;
+		float tMax;
+	};
+
+	// Mirrors the data available in a DXR hit shader (PrimitiveIndex(), RayTCurrent(), and barycentrics)
+	struct Hit
+	{
+		float    t = 0.0f;
+		uint32_t triangle = kInvalidIndex;
+		vec2     barycentrics = vec2(0.0f);
+	};
+
+	// Four rays in SoA form.  Rays whose bit is clear in activeMask are ignored.
+	struct RayPacket
+	{
+		float    origin[3][4];
+		float    direction[3][4];
+		float    tMin[4];
+		float    tMax[4];
+		uint32_t activeMask = 0xF;
+
+		void setRay(uint32_t lane, const Ray& ray);
+	};
+
+	// Per-lane results of a packet query.  Only valid in lanes whose bit is set in the returned hit mask.
+	struct HitPacket
+	{
+		float    t[4];
+		uint32_t triangle[4];
+		float    barycentrics[2][4];
+
+		Hit getHit(uint32_t lane) const { Hit h; h.t = t[lane]; h.triangle = triangle[lane]; h.barycentrics = vec2(barycentrics[0][lane], barycentrics[1][lane]); return h; }
+	};
+
+	// Called for hits on alpha tested triangles.  Return true to ignore the hit (like IgnoreHit() in an any-hit shader).
+	using AlphaTestFunc = std::function<bool(uint32_t triangle, const vec2& barycentrics)>;
+
+	// Build a BVH over the given triangles.  <alphaTested> may be empty (no triangle is alpha tested) or hold one entry per triangle.
+	static SharedPtr create(const std::vector<vec3>& positions, const std::vector<uvec3>& indices,
+	                        const std::vector<uint8_t>& alphaTested = std::vector<uint8_t>(), AlphaTestFunc alphaTest = nullptr);
+
+	// Closest-hit query.  Returns true and fills in <hit> if the ray hits accepted geometry in [tMin, tMax].
+	bool intersect(const Ray& ray, Hit& hit) const;
+
+	// Any-hit query.  Returns true if any accepted geometry lies along the ray in [tMin, tMax].
+	bool occluded(const Ray& ray) const;
+
+	// Packet versions of the above.  Return a bit mask of the lanes that hit / are occluded.
+	uint32_t intersect4(const RayPacket& packet, HitPacket& hits) const;
+	uint32_t occluded4(const RayPacket& packet) const;
+
+	// Accessors
+	uint32_t getNodeCount() const   { return uint32_t(mNodes.size()); }
+	uint32_t getLeafCount() const   { return uint32_t(mLeaves.size()); }
+	float    getBuildTime() const   { return mBuildTime; }
+
+protected:
+	CpuBvh() = default;
+
+	// An interior node:  SoA bounds of up to four children.  Unused slots hold inverted (empty) bounds.
+	struct Node4
+	{
+		float    bounds[6][4];   ///< minX, maxX, minY, maxY, minZ, maxZ for each child
+		uint32_t child[4];       ///< Index into mNodes, or (kLeafFlag | index into mLeaves), or kInvalidIndex
+	};
+
+	// A leaf:  up to four triangles, stored as (v0, e1 = v1 - v0, e2 = v2 - v0) in SoA form
+	struct Tri4
+	{
+		float    v0[3][4];
+		float    e1[3][4];
+		float    e2[3][4];
+		uint32_t triangle[4];    ///< Index of the input triangle (kInvalidIndex for unused lanes)
+		uint32_t alphaMask;      ///< Bit i is set if lane i needs an alpha test
+	};
+
+	static const uint32_t kLeafFlag = 0x80000000u;
+
+	void build(const std::vector<vec3>& positions, const std::vector<uvec3>& indices, const std::vector<uint8_t>& alphaTested);
+
+	template<bool kAnyHit> bool traverse(const Ray& ray, Hit& hit) const;
+	template<bool kAnyHit> uint32_t traverse4(const RayPacket& packet, HitPacket& hits) const;
+
+	std::vector<Node4>    mNodes;
+	std::vector<Tri4>     mLeaves;
+	uint32_t              mRoot = kInvalidIndex;   ///< Node index, or leaf-flagged index for tiny scenes
+	AlphaTestFunc         mAlphaTest;
+	float                 mBuildTime = 0.f;        ///< Milliseconds
+};
@@ -0,0 +1,494 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#include "CpuScene.h"
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+
+namespace {
+	// Snapshot file header.  Bump the version whenever the layout of the data below (or MaterialData / LightData) changes.
+	const char kSnapshotMagic[8] = { 'C', 'P', 'U', 'S', 'C', 'E', 'N', 'E' };
+	const uint32_t kSnapshotVersion = 1;
+
+	template<typename T>
+	void writeValue(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	void writeVector(std::ofstream& file, const std::vector<T>& data)
+	{
+		writeValue(file, uint64_t(data.size()));
+		if (!data.empty()) file.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(T));
+	}
+
+	template<typename T>
+	bool readValue(std::ifstream& file, T& value)
+	{
+		return bool(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	}
+
+	template<typename T>
+	bool readVector(std::ifstream& file, std::vector<T>& data)
+	{
+		uint64_t count = 0;
+		if (!readValue(file, count) || count > (uint64_t(1) << 32)) return false;
+		data.resize(size_t(count));
+		return data.empty() || bool(file.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(T)));
+	}
+
+	// Same conversion as the hardware sRGB -> linear decode
+	float srgbToLinear(float c)
+	{
+		return (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	// Reads one float vertex element from a mapped vertex buffer into a vec4 (missing channels are left untouched)
+	void readElement(const uint8_t* pData, uint32_t stride, uint32_t offset, ResourceFormat format, uint32_t idx, vec4& out)
+	{
+		const float* pSrc = reinterpret_cast<const float*>(pData + size_t(idx) * stride + offset);
+		uint32_t channels = getFormatChannelCount(format);
+		for (uint32_t c = 0; c < std::min(channels, 4u); c++) out[c] = pSrc[c];
+	}
+};
+
+CpuScene::SharedPtr CpuScene::create(const RtScene::SharedPtr& pScene, RenderContext* pRenderContext)
+{
+	if (!pScene || !pRenderContext) return nullptr;
+
+	SharedPtr pCpuScene = SharedPtr(new CpuScene(pScene));
+
+	CpuTimer timer;
+	CpuTimer::TimePoint start = timer.getCurrentTimePoint();
+
+	pCpuScene->loadGeometry(pRenderContext);
+	if (pCpuScene->mIndices.empty())
+	{
+		logWarning("CpuScene::create() - scene contains no triangles");
+		return nullptr;
+	}
+	pCpuScene->buildBvh();
+	pCpuScene->refreshLights();
+	pCpuScene->loadCamera();
+
+	CpuTimer::TimePoint end = timer.getCurrentTimePoint();
+	logInfo("CpuScene: " + std::to_string(pCpuScene->mIndices.size()) + " triangles, " +
+		std::to_string(pCpuScene->mpBvh->getNodeCount()) + " BVH nodes (built in " + std::to_string(pCpuScene->mpBvh->getBuildTime()) + " ms), " +
+		std::to_string(pCpuScene->mMaterials.size()) + " materials (" +
+		std::to_string(timer.calcDuration(start, end)) + " ms)");
+	return pCpuScene;
+}
+
+void CpuScene::refreshLights()
+{
+	if (!mpScene) return;
+	mLights.clear();
+	mLightPowers.clear();
+	for (const auto& pLight : mpScene->getLights())
+	{
+		mLights.push_back(pLight->getData());
+		mLightPowers.push_back(pLight->getPower());
+	}
+}
+
+void CpuScene::loadCamera()
+{
+	const Camera::SharedPtr& pCamera = mpScene->getActiveCamera();
+	if (pCamera)
+	{
+		mCamera.position = pCamera->getPosition();
+		mCamera.target = pCamera->getTarget();
+		mCamera.up = pCamera->getUpVector();
+		mCamera.focalLength = pCamera->getFocalLength();
+		mCamera.frameHeight = pCamera->getFrameHeight();
+		mCamera.nearZ = pCamera->getNearPlane();
+		mCamera.farZ = pCamera->getFarPlane();
+	}
+
+	// Same choice of path as CpuReSTIRPass::getCameraPath()
+	mCamera.path.clear();
+	if (mpScene->getPathCount() > 0 && mpScene->getPath(0)->getKeyFrameCount() > 1)
+	{
+		const ObjectPath::SharedPtr& pPath = mpScene->getPath(0);
+		for (uint32_t i = 0; i < pPath->getKeyFrameCount(); i++)
+		{
+			const ObjectPath::Frame& frame = pPath->getKeyFrame(i);
+			mCamera.path.push_back({ frame.time, frame.position, frame.target, frame.up });
+		}
+	}
+}
+
+CpuScene::SharedPtr CpuScene::load(const std::string& filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		logWarning("CpuScene::load() - can't open " + filename);
+		return nullptr;
+	}
+
+	char magic[sizeof(kSnapshotMagic)];
+	uint32_t version = 0, materialSize = 0, lightSize = 0;
+	if (!file.read(magic, sizeof(magic)) || memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0 ||
+		!readValue(file, version) || !readValue(file, materialSize) || !readValue(file, lightSize) ||
+		version != kSnapshotVersion || materialSize != sizeof(MaterialData) || lightSize != sizeof(LightData))
+	{
+		logWarning("CpuScene::load() - " + filename + " is not a CPU scene snapshot of this version");
+		return nullptr;
+	}
+
+	CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+
+	SharedPtr pCpuScene = SharedPtr(new CpuScene(nullptr));
+	CpuScene& scene = *pCpuScene;
+	bool ok = readVector(file, scene.mPositions) && readVector(file, scene.mNormals) && readVector(file, scene.mTexCrds) &&
+		readVector(file, scene.mIndices) && readVector(file, scene.mTriMaterial) && readVector(file, scene.mMaterials);
+
+	uint32_t textureCount = 0;
+	ok = ok && readValue(file, textureCount);
+	scene.mTextures.resize(ok ? textureCount : 0);
+	for (TextureData& tex : scene.mTextures)
+	{
+		ok = ok && readValue(file, tex.width) && readValue(file, tex.height) && readVector(file, tex.texels) &&
+			tex.texels.size() == size_t(tex.width) * tex.height;
+	}
+
+	ok = ok && readVector(file, scene.mLights) && readVector(file, scene.mLightPowers);
+	CameraSetup& camera = scene.mCamera;
+	ok = ok && readValue(file, camera.position) && readValue(file, camera.target) && readValue(file, camera.up) &&
+		readValue(file, camera.focalLength) && readValue(file, camera.frameHeight) && readValue(file, camera.nearZ) &&
+		readValue(file, camera.farZ) && readVector(file, camera.path);
+
+	// Reject files whose references don't line up before we trace through them
+	ok = ok && !scene.mIndices.empty() && scene.mNormals.size() == scene.mPositions.size() && scene.mTexCrds.size() == scene.mPositions.size() &&
+		scene.mTriMaterial.size() == scene.mIndices.size() && scene.mLightPowers.size() == scene.mLights.size();
+	for (size_t i = 0; ok && i < scene.mIndices.size(); i++)
+	{
+		ok = glm::all(glm::lessThan(scene.mIndices[i], uvec3(uint32_t(scene.mPositions.size())))) && scene.mTriMaterial[i] < scene.mMaterials.size();
+	}
+	for (size_t i = 0; ok && i < scene.mMaterials.size(); i++)
+	{
+		const MaterialData& mat = scene.mMaterials[i];
+		for (uint32_t tex : { mat.baseColorTexture, mat.specularTexture, mat.emissiveTexture })
+		{
+			ok = ok && (tex == kInvalidIndex || tex < scene.mTextures.size());
+		}
+	}
+	if (!ok)
+	{
+		logWarning("CpuScene::load() - " + filename + " is truncated or corrupt");
+		return nullptr;
+	}
+
+	scene.buildBvh();
+	logInfo("CpuScene: loaded " + filename + ", " + std::to_string(scene.mIndices.size()) + " triangles, " +
+		std::to_string(scene.mpBvh->getNodeCount()) + " BVH nodes, " + std::to_string(scene.mLights.size()) + " lights (" +
+		std::to_string(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint())) + " ms)");
+	return pCpuScene;
+}
+
+bool CpuScene::save(const std::string& filename) const
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		logWarning("CpuScene::save() - can't create " + filename);
+		return false;
+	}
+
+	file.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+	writeValue(file, kSnapshotVersion);
+	writeValue(file, uint32_t(sizeof(MaterialData)));
+	writeValue(file, uint32_t(sizeof(LightData)));
+
+	writeVector(file, mPositions);
+	writeVector(file, mNormals);
+	writeVector(file, mTexCrds);
+	writeVector(file, mIndices);
+	writeVector(file, mTriMaterial);
+	writeVector(file, mMaterials);
+
+	writeValue(file, uint32_t(mTextures.size()));
+	for (const TextureData& tex : mTextures)
+	{
+		writeValue(file, tex.width);
+		writeValue(file, tex.height);
+		writeVector(file, tex.texels);
+	}
+
+	writeVector(file, mLights);
+	writeVector(file, mLightPowers);
+	writeValue(file, mCamera.position);
+	writeValue(file, mCamera.target);
+	writeValue(file, mCamera.up);
+	writeValue(file, mCamera.focalLength);
+	writeValue(file, mCamera.frameHeight);
+	writeValue(file, mCamera.nearZ);
+	writeValue(file, mCamera.farZ);
+	writeVector(file, mCamera.path);
+
+	if (!file)
+	{
+		logWarning("CpuScene::save() - failed writing " + filename);
+		return false;
+	}
+	return true;
+}
+
+void CpuScene::loadGeometry(RenderContext* pRenderContext)
+{
+	for (uint32_t modelId = 0; modelId < mpScene->getModelCount(); modelId++)
+	{
+		for (uint32_t modelInstId = 0; modelInstId < mpScene->getModelInstanceCount(modelId); modelInstId++)
+		{
+			const auto& pModelInstance = mpScene->getModelInstance(modelId, modelInstId);
+			const Model* pModel = pModelInstance->getObject().get();
+			mat4 modelXform = pModelInstance->getTransformMatrix();
+
+			for (uint32_t meshId = 0; meshId < pModel->getMeshCount(); meshId++)
+			{
+				for (uint32_t meshInstId = 0; meshInstId < pModel->getMeshInstanceCount(meshId); meshInstId++)
+				{
+					const auto& pMeshInstance = pModel->getMeshInstance(meshId, meshInstId);
+					const Mesh::SharedPtr& pMesh = pMeshInstance->getObject();
+					const Vao::SharedPtr& pVao = pMesh->getVao();
+					if (pVao->getPrimitiveTopology() != Vao::Topology::TriangleList || !pVao->getIndexBuffer()) continue;
+
+					mat4 xform = modelXform * pMeshInstance->getTransformMatrix();
+					mat3 normalXform = glm::transpose(glm::inverse(mat3(xform)));
+					uint32_t materialId = loadMaterial(pRenderContext, pMesh->getMaterial());
+					uint32_t baseVertex = uint32_t(mPositions.size());
+
+					// Read back the vertex attributes we need (positions, normals, texcoords).  Each may live in a different VB.
+					const uint32_t kLocations[] = { VERTEX_POSITION_LOC, VERTEX_NORMAL_LOC, VERTEX_TEXCOORD_LOC };
+					std::vector<vec4> attribs[3];
+					for (uint32_t a = 0; a < 3; a++)
+					{
+						attribs[a].assign(pMesh->getVertexCount(), vec4(0.0f));
+						Vao::ElementDesc desc = pVao->getElementIndexByLocation(kLocations[a]);
+						if (desc.vbIndex == Vao::ElementDesc::kInvalidIndex) continue;
+
+						const auto& pLayout = pVao->getVertexLayout()->getBufferLayout(desc.vbIndex);
+						const Buffer::SharedPtr& pVB = pVao->getVertexBuffer(desc.vbIndex);
+						ResourceFormat format = pLayout->getElementFormat(desc.elementIndex);
+						if (getFormatType(format) != FormatType::Float || getFormatBytesPerBlock(format) != 4 * getFormatChannelCount(format))
+						{
+							logWarning("CpuScene - unsupported vertex format " + to_string(format) + ", ignoring attribute");
+							continue;
+						}
+
+						const uint8_t* pData = reinterpret_cast<const uint8_t*>(pVB->map(Buffer::MapType::Read));
+						for (uint32_t v = 0; v < pMesh->getVertexCount(); v++)
+						{
+							readElement(pData, pLayout->getStride(), pLayout->getElementOffset(desc.elementIndex), format, v, attribs[a][v]);
+						}
+						pVB->unmap();
+					}
+
+					for (uint32_t v = 0; v < pMesh->getVertexCount(); v++)
+					{
+						mPositions.push_back(vec3(xform * vec4(vec3(attribs[0][v]), 1.0f)));
+						vec3 N = normalXform * vec3(attribs[1][v]);
+						mNormals.push_back(glm::length(N) > 0.0f ? glm::normalize(N) : vec3(0.0f));
+						mTexCrds.push_back(vec2(attribs[2][v]));
+					}
+
+					// Read back the index buffer (16- or 32-bit)
+					const Buffer::SharedPtr& pIB = pVao->getIndexBuffer();
+					bool is16Bit = (pVao->getIndexBufferFormat() == ResourceFormat::R16Uint);
+					const void* pIndices = pIB->map(Buffer::MapType::Read);
+					for (uint32_t i = 0; i + 2 < pMesh->getIndexCount(); i += 3)
+					{
+						uvec3 tri;
+						for (uint32_t k = 0; k < 3; k++)
+						{
+							tri[k] = baseVertex + (is16Bit ? uint32_t(reinterpret_cast<const uint16_t*>(pIndices)[i + k])
+							                               : reinterpret_cast<const uint32_t*>(pIndices)[i + k]);
+						}
+						mIndices.push_back(tri);
+						mTriMaterial.push_back(materialId);
+					}
+					pIB->unmap();
+				}
+			}
+		}
+	}
+}
+
+uint32_t CpuScene::loadMaterial(RenderContext* pRenderContext, const Material::SharedPtr& pMaterial)
+{
+	auto it = mMaterialMap.find(pMaterial.get());
+	if (it != mMaterialMap.end()) return it->second;
+
+	MaterialData mat;
+	mat.baseColor = pMaterial->getBaseColor();
+	mat.specular = pMaterial->getSpecularParams();
+	mat.emissive = pMaterial->getEmissiveColor();
+	mat.shadingModel = pMaterial->getShadingModel();
+	mat.alphaThreshold = pMaterial->getAlphaThreshold();
+	mat.alphaTested = (pMaterial->getAlphaMode() != AlphaModeOpaque);
+	mat.doubleSided = pMaterial->getDoubleSided();
+	mat.baseColorTexture = loadTexture(pRenderContext, pMaterial->getBaseColorTexture());
+	mat.specularTexture = loadTexture(pRenderContext, pMaterial->getSpecularTexture());
+	mat.emissiveTexture = loadTexture(pRenderContext, pMaterial->getEmissiveTexture());
+
+	uint32_t id = uint32_t(mMaterials.size());
+	mMaterials.push_back(mat);
+	mMaterialMap[pMaterial.get()] = id;
+	return id;
+}
+
+uint32_t CpuScene::loadTexture(RenderContext* pRenderContext, const Texture::SharedPtr& pTexture)
+{
+	if (!pTexture) return kInvalidIndex;
+
+	auto it = mTextureMap.find(pTexture.get());
+	if (it != mTextureMap.end()) return it->second;
+
+	ResourceFormat format = pTexture->getFormat();
+	uint32_t channels = getFormatChannelCount(format);
+	uint32_t bytesPerTexel = getFormatBytesPerBlock(format);
+	FormatType type = getFormatType(format);
+	bool isUnorm8 = (type == FormatType::Unorm || type == FormatType::UnormSrgb) && bytesPerTexel == channels;
+	bool isFloat32 = (type == FormatType::Float) && bytesPerTexel == 4 * channels;
+	if (isCompressedFormat(format) || (!isUnorm8 && !isFloat32))
+	{
+		logWarning("CpuScene - texture format " + to_string(format) + " is not supported on the CPU, using the material constant instead");
+		mTextureMap[pTexture.get()] = kInvalidIndex;
+		return kInvalidIndex;
+	}
+
+	TextureData tex;
+	tex.width = pTexture->getWidth();
+	tex.height = pTexture->getHeight();
+	tex.texels.resize(size_t(tex.width) * tex.height, vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+	bool isBgr = (format == ResourceFormat::BGRA8Unorm || format == ResourceFormat::BGRA8UnormSrgb ||
+	              format == ResourceFormat::BGRX8Unorm || format == ResourceFormat::BGRX8UnormSrgb);
+	bool isSrgb = isSrgbFormat(format);
+	std::vector<uint8> data = pRenderContext->readTextureSubresource(pTexture.get(), 0);
+	for (size_t i = 0; i < tex.texels.size(); i++)
+	{
+		vec4& texel = tex.texels[i];
+		for (uint32_t c = 0; c < std::min(channels, 4u); c++)
+		{
+			texel[c] = isUnorm8 ? float(data[i * bytesPerTexel + c]) / 255.0f
+			                    : reinterpret_cast<const float*>(data.data() + i * bytesPerTexel)[c];
+		}
+		if (isBgr) std::swap(texel.r, texel.b);
+		if (format == ResourceFormat::BGRX8Unorm || format == ResourceFormat::BGRX8UnormSrgb) texel.a = 1.0f;
+		if (isSrgb) texel = vec4(srgbToLinear(texel.r), srgbToLinear(texel.g), srgbToLinear(texel.b), texel.a);
+	}
+
+	uint32_t id = uint32_t(mTextures.size());
+	mTextures.push_back(std::move(tex));
+	mTextureMap[pTexture.get()] = id;
+	return id;
+}
+
+vec4 CpuScene::TextureData::sample(const vec2& uv) const
+{
+	// Texel centers are at half-integer coordinates, as on the GPU
+	vec2 st = uv * vec2(float(width), float(height)) - 0.5f;
+	vec2 base = glm::floor(st);
+	vec2 f = st - base;
+
+	auto fetch = [&](int x, int y)
+	{
+		x = ((x % int(width)) + int(width)) % int(width);
+		y = ((y % int(height)) + int(height)) % int(height);
+		return texels[size_t(y) * width + x];
+	};
+
+	int x0 = int(base.x), y0 = int(base.y);
+	vec4 top = glm::mix(fetch(x0, y0), fetch(x0 + 1, y0), f.x);
+	vec4 bottom = glm::mix(fetch(x0, y0 + 1), fetch(x0 + 1, y0 + 1), f.x);
+	return glm::mix(top, bottom, f.y);
+}
+
+void CpuScene::buildBvh()
+{
+	// Only triangles with a non-opaque material need to call back into the alpha test
+	std::vector<uint8_t> alphaTested(mIndices.size());
+	for (size_t i = 0; i < mIndices.size(); i++) alphaTested[i] = mMaterials[mTriMaterial[i]].alphaTested ? 1 : 0;
+
+	mpBvh = CpuBvh::create(mPositions, mIndices, alphaTested,
+		[this](uint32_t triangle, const vec2& barycentrics) { return alphaTestFails(triangle, barycentrics); });
+}
+
+bool CpuScene::intersect(const Ray& ray, Hit& hit) const
+{
+	return mpBvh->intersect(ray, hit);
+}
+
+bool CpuScene::occluded(const Ray& ray) const
+{
+	return mpBvh->occluded(ray);
+}
+
+bool CpuScene::alphaTestFails(uint32_t triangle, const vec2& barycentrics) const
+{
+	const MaterialData& mat = mMaterials[mTriMaterial[triangle]];
+	if (!mat.alphaTested) return false;
+
+	float alpha = mat.baseColor.a;
+	if (mat.baseColorTexture != kInvalidIndex)
+	{
+		const uvec3& idx = mIndices[triangle];
+		vec2 texC = mTexCrds[idx.x] * (1.0f - barycentrics.x - barycentrics.y) + mTexCrds[idx.y] * barycentrics.x + mTexCrds[idx.z] * barycentrics.y;
+		alpha = mTextures[mat.baseColorTexture].sample(texC).a;
+	}
+	return alpha < mat.alphaThreshold;
+}
+
+CpuScene::ShadingData CpuScene::getShadingData(const Hit& hit) const
+{
+	const uvec3& idx = mIndices[hit.triangle];
+	const MaterialData& mat = mMaterials[mTriMaterial[hit.triangle]];
+	vec3 w = vec3(1.0f - hit.barycentrics.x - hit.barycentrics.y, hit.barycentrics.x, hit.barycentrics.y);
+
+	ShadingData sd;
+	sd.posW = mPositions[idx.x] * w.x + mPositions[idx.y] * w.y + mPositions[idx.z] * w.z;
+	vec3 N = mNormals[idx.x] * w.x + mNormals[idx.y] * w.y + mNormals[idx.z] * w.z;
+	sd.N = (glm::length(N) > 0.0f) ? glm::normalize(N) : glm::normalize(glm::cross(mPositions[idx.y] - mPositions[idx.x], mPositions[idx.z] - mPositions[idx.x]));
+	vec2 texC = mTexCrds[idx.x] * w.x + mTexCrds[idx.y] * w.y + mTexCrds[idx.z] * w.z;
+
+	vec4 baseColor = (mat.baseColorTexture != kInvalidIndex) ? mTextures[mat.baseColorTexture].sample(texC) : mat.baseColor;
+	vec4 spec = (mat.specularTexture != kInvalidIndex) ? mTextures[mat.specularTexture].sample(texC) : mat.specular;
+	sd.emissive = (mat.emissiveTexture != kInvalidIndex) ? vec3(mTextures[mat.emissiveTexture].sample(texC)) : mat.emissive;
+	sd.opacity = baseColor.a;
+	sd.doubleSided = mat.doubleSided;
+
+	// Same conversions as Falcor's prepareShadingData()
+	if (mat.shadingModel == ShadingModelMetalRough)
+	{
+		sd.diffuse = glm::mix(vec3(baseColor), vec3(0.0f), spec.b);
+		sd.specular = glm::mix(vec3(0.04f), vec3(baseColor), spec.b);
+		sd.linearRoughness = spec.g;
+	}
+	else
+	{
+		sd.diffuse = vec3(baseColor);
+		sd.specular = vec3(spec);
+		sd.linearRoughness = 1.0f - spec.a;
+	}
+	sd.linearRoughness = std::max(0.08f, sd.linearRoughness);
+	return sd;
+}
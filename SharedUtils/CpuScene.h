@@ -0,0 +1,213 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#pragma once
+
+#include "Falcor.h"
+#include "CpuBvh.h"
+#include <vector>
+#include <map>
+
+/** A CPU-side snapshot of an RtScene, so that we can trace rays and shade hits without DirectX Raytracing.
+
+    On creation, this reads back the vertex / index buffers and base color textures of every mesh instance
+    in the scene (via Falcor's staging buffers), flattens them into world space, and builds a CpuBvh over the
+    resulting triangles.  Lights are copied out as LightData, exactly as they appear in gLights on the GPU.
+
+Usage:
+     CpuScene::SharedPtr pCpuScene = CpuScene::create(pRtScene, pRenderContext);
+
+     CpuScene::Ray ray = { origin, minT, direction, maxT };
+     CpuScene::Hit hit;
+     if (pCpuScene->intersect(ray, hit))                    // Closest hit (like TraceRay w/ RAY_FLAG_NONE)
+          CpuScene::ShadingData sd = pCpuScene->getShadingData(hit);
+     bool visible = !pCpuScene->occluded(ray);              // Any hit (like our shadowRayVisibility())
+
+     CpuScene::RayPacket packet;                            // Four coherent rays at once (e.g., a 2x2 pixel quad)
+     CpuScene::HitPacket hits;
+     uint32_t hitMask = pCpuScene->intersect4(packet, hits);
+
+Both queries honor the same alpha test as alphaTest.hlsli:  geometry whose material is not AlphaModeOpaque
+is rejected wherever its base color alpha falls below the material's alpha threshold.
+
+Skinned meshes are captured in their bind pose.  If lights move, call refreshLights() to re-copy them.
+
+A snapshot can be written to disk with save() and read back with load(), which needs neither a GPU nor the original
+scene.  That is how headless batch rendering (see BatchRenderer) runs on machines without DirectX Raytracing:
+
+     pCpuScene->save("arcade.cpuscene");                    // Once, on a machine that can load the .fscene
+     CpuScene::SharedPtr pSnapshot = CpuScene::load("arcade.cpuscene");
+     const CpuScene::CameraSetup& camera = pSnapshot->getCamera();   // The scene's active camera and camera path
+*/
+
+using namespace Falcor;
+
+class CpuScene : public std::enable_shared_from_this<CpuScene>
+{
+public:
+	using SharedPtr = std::shared_ptr<CpuScene>;
+	using SharedConstPtr = std::shared_ptr<const CpuScene>;
+	virtual ~CpuScene() = default;
+
+	static const uint32_t kInvalidIndex = 0xFFFFFFFFu;
+
+	using Ray = CpuBvh::Ray;
+	using Hit = CpuBvh::Hit;
+	using RayPacket = CpuBvh::RayPacket;
+	using HitPacket = CpuBvh::HitPacket;
+
+	// The subset of Falcor's ShadingData our G-buffer passes store
+	struct ShadingData
+	{
+		vec3  posW;
+		vec3  N;
+		vec3  diffuse;
+		float opacity;
+		vec3  specular;
+		float linearRoughness;
+		vec3  emissive;
+		bool  doubleSided;
+	};
+
+	// One key frame of a camera path, as in ObjectPath::Frame
+	struct CameraKey
+	{
+		float time = 0.f;
+		vec3  position;
+		vec3  target;
+		vec3  up;
+	};
+
+	// The scene's active camera and the path it follows (the scene's first path, if it has one with two or more key frames)
+	struct CameraSetup
+	{
+		vec3  position = vec3(0.f, 0.f, 1.f);
+		vec3  target = vec3(0.f);
+		vec3  up = vec3(0.f, 1.f, 0.f);
+		float focalLength = 21.f;
+		float frameHeight = 24.f;
+		float nearZ = 0.1f;
+		float farZ = 1000.f;
+		std::vector<CameraKey> path;          ///< Empty for a still camera
+	};
+
+	// A decoded, mip 0 copy of a texture
+	struct TextureData
+	{
+		uint32_t          width = 0;
+		uint32_t          height = 0;
+		std::vector<vec4> texels;
+
+		// Bilinear lookup with wrap addressing (matching the sampler bound by SceneLoaderWrapper)
+		vec4 sample(const vec2& uv) const;
+	};
+
+	struct MaterialData
+	{
+		vec4     baseColor;
+		vec4     specular;
+		vec3     emissive;
+		uint32_t shadingModel;
+		uint32_t baseColorTexture = kInvalidIndex;   ///< Index into getTextures() (or kInvalidIndex for a constant color)
+		uint32_t specularTexture = kInvalidIndex;
+		uint32_t emissiveTexture = kInvalidIndex;
+		float    alphaThreshold;
+		bool     alphaTested;                        ///< True if the geometry was not flagged D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE
+		bool     doubleSided;
+	};
+
+	// Create a CPU copy of the specified scene.  Returns nullptr if the scene is null or contains no triangles.
+	static SharedPtr create(const RtScene::SharedPtr& pScene, RenderContext* pRenderContext);
+
+	// Read a snapshot written by save().  Returns nullptr if the file cannot be read or is not a snapshot of this version.
+	//     The result has no RtScene (getScene() returns nullptr) and refreshLights() does nothing.
+	static SharedPtr load(const std::string& filename);
+
+	// Write our geometry, materials, textures, lights and camera setup to a binary file.  Returns false on failure.
+	bool save(const std::string& filename) const;
+
+	// Closest-hit query.  Returns true and fills in <hit> if the ray hits (non alpha-tested) geometry in [tMin, tMax].
+	bool intersect(const Ray& ray, Hit& hit) const;
+
+	// Any-hit query.  Returns true if any (non alpha-tested) geometry lies along the ray in [tMin, tMax].
+	bool occluded(const Ray& ray) const;
+
+	// Packet versions of the above, for four rays at once.  Return a bit mask of the lanes that hit / are occluded.
+	uint32_t intersect4(const RayPacket& packet, HitPacket& hits) const  { return mpBvh->intersect4(packet, hits); }
+	uint32_t occluded4(const RayPacket& packet) const                    { return mpBvh->occluded4(packet); }
+
+	// Interpolates vertex attributes and looks up material data at a hit
+	ShadingData getShadingData(const Hit& hit) const;
+
+	// Returns true if the hit lies on a transparent texel (i.e., the hit should be ignored)
+	bool alphaTestFails(uint32_t triangle, const vec2& barycentrics) const;
+
+	// Re-copy light data from the scene (e.g., after lights have been animated or edited).  No-op for a loaded snapshot.
+	void refreshLights();
+
+	// Accessors
+	const std::vector<LightData>& getLights() const { return mLights; }
+	const std::vector<float>& getLightPowers() const { return mLightPowers; }   ///< Light::getPower() of each light
+	uint32_t getLightCount() const                  { return uint32_t(mLights.size()); }
+	uint32_t getTriangleCount() const               { return uint32_t(mIndices.size()); }
+	const RtScene::SharedPtr& getScene() const      { return mpScene; }
+	const CameraSetup& getCamera() const            { return mCamera; }
+	const CpuBvh::SharedPtr& getBvh() const         { return mpBvh; }
+
+	// World-space geometry and its materials (e.g. for extracting the emissive triangles)
+	const std::vector<vec3>& getPositions() const   { return mPositions; }
+	const std::vector<vec2>& getTexCrds() const     { return mTexCrds; }   ///< Per position
+	const std::vector<uvec3>& getIndices() const    { return mIndices; }
+	const std::vector<uint32_t>& getTriangleMaterials() const { return mTriMaterial; }
+	const std::vector<MaterialData>& getMaterials() const     { return mMaterials; }
+	const std::vector<TextureData>& getTextures() const       { return mTextures; }
+
+protected:
+	CpuScene(const RtScene::SharedPtr& pScene) : mpScene(pScene) {}
+
+	void loadGeometry(RenderContext* pRenderContext);
+	uint32_t loadMaterial(RenderContext* pRenderContext, const Material::SharedPtr& pMaterial);
+	uint32_t loadTexture(RenderContext* pRenderContext, const Texture::SharedPtr& pTexture);
+	void loadCamera();
+	void buildBvh();
+
+	RtScene::SharedPtr           mpScene;
+
+	// World-space, flattened geometry.  Each triangle references three vertices.
+	std::vector<vec3>            mPositions;
+	std::vector<vec3>            mNormals;
+	std::vector<vec2>            mTexCrds;
+	std::vector<uvec3>           mIndices;
+	std::vector<uint32_t>        mTriMaterial;
+
+	// Material and texture data, de-duplicated by Falcor object
+	std::vector<MaterialData>    mMaterials;
+	std::vector<TextureData>     mTextures;
+	std::map<const Material*, uint32_t> mMaterialMap;
+	std::map<const Texture*, uint32_t>  mTextureMap;
+
+	// Acceleration structure
+	CpuBvh::SharedPtr            mpBvh;
+
+	// Light data, as it would appear in gLights[]
+	std::vector<LightData>       mLights;
+	std::vector<float>           mLightPowers;
+
+	// Camera setup, for rendering a snapshot without the scene
+	CameraSetup                  mCamera;
+};
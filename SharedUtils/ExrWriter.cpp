@@ -0,0 +1,1171 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#include "ExrWriter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <queue>
+
+namespace {
+	const uint32_t kExrMagic = 20000630;
+	const uint32_t kExrVersion = 2;
+	const uint32_t kExrLongNames = 0x400;      // Version flag:  attribute or channel names longer than 31 bytes
+	const uint32_t kZipLinesPerChunk = 16;
+
+	/*******************************************************************
+	                      Pixel conversion
+	*******************************************************************/
+
+	uint32_t getSourceBytes(ExrWriter::SourceType source)
+	{
+		switch (source)
+		{
+		case ExrWriter::SourceType::Float32:
+		case ExrWriter::SourceType::Uint32:  return 4;
+		case ExrWriter::SourceType::Float16: return 2;
+		default:                             return 1;
+		}
+	}
+
+	uint32_t getPixelBytes(ExrWriter::PixelType type)
+	{
+		return (type == ExrWriter::PixelType::Half) ? 2 : 4;
+	}
+
+	// Round to nearest even, as the GPU's f32tof16() does;  overflow goes to infinity
+	uint16_t floatToHalf(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, 4);
+		uint32_t sign = (bits >> 16) & 0x8000u;
+		uint32_t exponent = (bits >> 23) & 0xFFu;
+		uint32_t mantissa = bits & 0x7FFFFFu;
+		if (exponent == 0xFFu) return uint16_t(sign | 0x7C00u | (mantissa ? 0x200u : 0u));   // Infinity or (quiet) NaN
+
+		int32_t e = int32_t(exponent) - 127 + 15;
+		if (e >= 31) return uint16_t(sign | 0x7C00u);
+		if (e <= 0)
+		{
+			// Subnormal (or zero) half
+			if (e < -10) return uint16_t(sign);
+			mantissa |= 0x800000u;
+			uint32_t shift = uint32_t(14 - e);
+			uint32_t half = mantissa >> shift;
+			uint32_t rest = mantissa & ((1u << shift) - 1u);
+			uint32_t midpoint = 1u << (shift - 1u);
+			if (rest > midpoint || (rest == midpoint && (half & 1u))) half++;
+			return uint16_t(sign | half);
+		}
+
+		uint32_t half = (uint32_t(e) << 10) | (mantissa >> 13);
+		uint32_t rest = mantissa & 0x1FFFu;
+		if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) half++;   // May carry into the exponent, up to infinity
+		return uint16_t(sign | half);
+	}
+
+	float halfToFloat(uint16_t half)
+	{
+		uint32_t sign = uint32_t(half & 0x8000u) << 16;
+		uint32_t exponent = (half >> 10) & 0x1Fu;
+		uint32_t mantissa = half & 0x3FFu;
+		uint32_t bits;
+		if (exponent == 0)
+		{
+			if (mantissa == 0) bits = sign;
+			else
+			{
+				exponent = 127 - 15 + 1;
+				while (!(mantissa & 0x400u)) { mantissa <<= 1; exponent--; }
+				bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+			}
+		}
+		else if (exponent == 31) bits = sign | 0x7F800000u | (mantissa << 13);
+		else bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+
+		float value;
+		std::memcpy(&value, &bits, 4);
+		return value;
+	}
+
+	const float* getSrgbTable()
+	{
+		static const std::vector<float> table = []()
+		{
+			std::vector<float> t(256);
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				float c = float(i) / 255.f;
+				t[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			return t;
+		}();
+		return table.data();
+	}
+
+	float readFloat(const uint8_t* pSrc, ExrWriter::SourceType source)
+	{
+		switch (source)
+		{
+		case ExrWriter::SourceType::Float32: { float f; std::memcpy(&f, pSrc, 4); return f; }
+		case ExrWriter::SourceType::Float16: { uint16_t h; std::memcpy(&h, pSrc, 2); return halfToFloat(h); }
+		case ExrWriter::SourceType::Uint32:  { uint32_t u; std::memcpy(&u, pSrc, 4); return float(u); }
+		case ExrWriter::SourceType::Unorm8:  return float(*pSrc) * (1.f / 255.f);
+		default:                             return getSrgbTable()[*pSrc];
+		}
+	}
+
+	uint32_t readUint(const uint8_t* pSrc, ExrWriter::SourceType source)
+	{
+		if (source == ExrWriter::SourceType::Uint32)
+		{
+			uint32_t u;
+			std::memcpy(&u, pSrc, 4);
+			return u;
+		}
+		float f = readFloat(pSrc, source);
+		return (f > 0.f) ? uint32_t(std::min(f + 0.5f, 4294967040.f)) : 0u;   // NaN goes to 0, too
+	}
+
+	// One channel of row y of <layer>, converted to <type>, into pOut
+	void convertRow(const ExrWriter::Layer& layer, uint32_t component, ExrWriter::PixelType type, uint32_t width, uint32_t y, uint8_t* pOut)
+	{
+		uint32_t valueBytes = getSourceBytes(layer.source);
+		size_t texelBytes = size_t(valueBytes) * layer.sourceChannels;
+		const uint8_t* pSrc = layer.data.data() + size_t(y) * width * texelBytes + size_t(component) * valueBytes;
+		for (uint32_t x = 0; x < width; x++, pSrc += texelBytes)
+		{
+			switch (type)
+			{
+			case ExrWriter::PixelType::Half:
+			{
+				uint16_t h;
+				if (layer.source == ExrWriter::SourceType::Float16) std::memcpy(&h, pSrc, 2);
+				else h = floatToHalf(readFloat(pSrc, layer.source));
+				std::memcpy(pOut + size_t(x) * 2, &h, 2);
+				break;
+			}
+			case ExrWriter::PixelType::Float:
+			{
+				float f = readFloat(pSrc, layer.source);
+				std::memcpy(pOut + size_t(x) * 4, &f, 4);
+				break;
+			}
+			default:
+			{
+				uint32_t u = readUint(pSrc, layer.source);
+				std::memcpy(pOut + size_t(x) * 4, &u, 4);
+				break;
+			}
+			}
+		}
+	}
+
+	/*******************************************************************
+	                      OpenEXR compression
+	*******************************************************************/
+
+	// The byte reordering and delta predictor OpenEXR applies before RLE and ZIP:  the even bytes of <raw> and then the
+	//     odd ones (low and high bytes of halfs, mostly), each stored as the difference from the previous one plus 128
+	void predict(const std::vector<uint8_t>& raw, std::vector<uint8_t>& out)
+	{
+		size_t size = raw.size();
+		out.resize(size);
+		size_t half = (size + 1) / 2;
+		for (size_t i = 0; i < size; i++) out[(i & 1) ? half + i / 2 : i / 2] = raw[i];
+
+		int32_t previous = size ? out[0] : 0;
+		for (size_t i = 1; i < size; i++)
+		{
+			int32_t current = out[i];
+			out[i] = uint8_t(current - previous + (128 + 256));
+			previous = current;
+		}
+	}
+
+	// OpenEXR's run-length encoding:  a run of n + 1 equal bytes is (n, byte), and n literal bytes are (-n, bytes...)
+	void rleCompress(const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+	{
+		const int32_t kMinRun = 3, kMaxRun = 127;
+		out.clear();
+		out.reserve(in.size() + in.size() / 64 + 2);
+		const uint8_t* pEnd = in.data() + in.size();
+		const uint8_t* pRunStart = in.data();
+		const uint8_t* pRunEnd = in.data() + 1;
+		while (pRunStart < pEnd)
+		{
+			while (pRunEnd < pEnd && *pRunStart == *pRunEnd && pRunEnd - pRunStart - 1 < kMaxRun) ++pRunEnd;
+			if (pRunEnd - pRunStart >= kMinRun)
+			{
+				out.push_back(uint8_t(pRunEnd - pRunStart - 1));
+				out.push_back(*pRunStart);
+				pRunStart = pRunEnd;
+			}
+			else
+			{
+				while (pRunEnd < pEnd && ((pRunEnd + 1 >= pEnd || *pRunEnd != *(pRunEnd + 1)) || (pRunEnd + 2 >= pEnd || *(pRunEnd + 1) != *(pRunEnd + 2))) &&
+					pRunEnd - pRunStart < kMaxRun)
+				{
+					++pRunEnd;
+				}
+				out.push_back(uint8_t(int8_t(pRunStart - pRunEnd)));
+				while (pRunStart < pRunEnd) out.push_back(*pRunStart++);
+			}
+			++pRunEnd;
+		}
+	}
+
+	/*******************************************************************
+	    Deflate (RFC 1951) in a zlib stream (RFC 1950), as ZIP stores it
+	*******************************************************************/
+
+	const uint32_t kWindowSize = 32768;
+	const uint32_t kMinMatch = 3;
+	const uint32_t kMaxMatch = 258;
+	const uint32_t kHashBits = 15;
+	const uint32_t kMaxChain = 48;          // Candidates tried per position
+	const uint32_t kGoodMatch = 32;         // Don't look for a longer match at the next position after one this long
+	const uint32_t kBlockSymbols = 1 << 15; // Per Huffman block
+	const uint32_t kMaxStored = 65535;      // Bytes per stored block
+
+	const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	const uint8_t kCodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	// Length (3 to 258) to length code (0 to 28), and distance - 1 to distance code:  directly below 256, by 128s above
+	struct DeflateTables
+	{
+		uint8_t lengthCode[kMaxMatch + 1];
+		uint8_t distanceLow[256];
+		uint8_t distanceHigh[256];
+
+		DeflateTables()
+		{
+			for (uint32_t c = 0; c < 29; c++)
+			{
+				for (uint32_t l = kLengthBase[c]; l < kLengthBase[c] + (1u << kLengthExtra[c]) && l <= kMaxMatch; l++) lengthCode[l] = uint8_t(c);
+			}
+			lengthCode[kMaxMatch] = 28;
+			for (uint32_t c = 0; c < 30; c++)
+			{
+				for (uint32_t d = kDistanceBase[c] - 1u; d < kDistanceBase[c] - 1u + (1u << kDistanceExtra[c]); d++)
+				{
+					if (d < 256) distanceLow[d] = uint8_t(c);
+					else distanceHigh[d >> 7] = uint8_t(c);
+				}
+			}
+		}
+
+		uint32_t getDistanceCode(uint32_t distance) const
+		{
+			uint32_t d = distance - 1;
+			return (d < 256) ? distanceLow[d] : distanceHigh[d >> 7];
+		}
+	};
+
+	const DeflateTables& getDeflateTables()
+	{
+		static const DeflateTables tables;
+		return tables;
+	}
+
+	// Bits go out least significant first;  Huffman codes are stored pre-reversed to match
+	class BitWriter
+	{
+	public:
+		BitWriter(std::vector<uint8_t>& out) : mOut(out) {}
+
+		void put(uint32_t bits, uint32_t count)
+		{
+			mBuffer |= uint64_t(bits) << mCount;
+			mCount += count;
+			while (mCount >= 8)
+			{
+				mOut.push_back(uint8_t(mBuffer));
+				mBuffer >>= 8;
+				mCount -= 8;
+			}
+		}
+
+		void alignToByte()
+		{
+			if (mCount > 0) put(0, 8 - mCount);
+		}
+
+		void putBytes(const uint8_t* pData, size_t count)
+		{
+			mOut.insert(mOut.end(), pData, pData + count);
+		}
+
+		uint32_t getPendingBits() const { return mCount; }
+
+	private:
+		std::vector<uint8_t>& mOut;
+		uint64_t              mBuffer = 0;
+		uint32_t              mCount = 0;
+	};
+
+	// A literal (distance 0, length the byte) or a match
+	struct Symbol
+	{
+		uint16_t length;
+		uint16_t distance;
+	};
+
+	// Huffman code lengths for <freqs>, at most maxBits long.  Codes past maxBits are shortened by moving pairs of
+	//     leaves up the tree (as in JPEG's Annex K.3), which keeps the code complete;  the most frequent symbols then get
+	//     the shortest codes.
+	void buildCodeLengths(const uint32_t* freqs, uint32_t count, uint32_t maxBits, uint8_t* lengths)
+	{
+		std::fill(lengths, lengths + count, uint8_t(0));
+		std::vector<uint32_t> used;
+		for (uint32_t i = 0; i < count; i++) if (freqs[i] > 0) used.push_back(i);
+		if (used.empty()) return;
+		if (used.size() == 1) { lengths[used[0]] = 1; return; }
+
+		// Huffman's algorithm:  leaves 0 .. n-1, then the merged nodes
+		struct Node { uint64_t weight; uint32_t parent; };
+		std::vector<Node> nodes;
+		using Entry = std::pair<uint64_t, uint32_t>;
+		std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+		for (uint32_t sym : used)
+		{
+			heap.push({ freqs[sym], uint32_t(nodes.size()) });
+			nodes.push_back({ freqs[sym], 0 });
+		}
+		while (heap.size() > 1)
+		{
+			Entry a = heap.top(); heap.pop();
+			Entry b = heap.top(); heap.pop();
+			uint32_t parent = uint32_t(nodes.size());
+			nodes.push_back({ a.first + b.first, 0 });
+			nodes[a.second].parent = parent;
+			nodes[b.second].parent = parent;
+			heap.push({ a.first + b.first, parent });
+		}
+
+		// Leaf depths, counted per length (the root is the last node)
+		uint32_t root = uint32_t(nodes.size()) - 1;
+		std::vector<uint32_t> depth(nodes.size(), 0);
+		for (uint32_t n = root; n-- > 0;) depth[n] = depth[nodes[n].parent] + 1;
+		uint32_t maxDepth = 0;
+		for (uint32_t i = 0; i < used.size(); i++) maxDepth = std::max(maxDepth, depth[i]);
+		std::vector<uint32_t> lengthCount(std::max(maxDepth, maxBits) + 1, 0);
+		for (uint32_t i = 0; i < used.size(); i++) lengthCount[depth[i]]++;
+
+		if (maxDepth <= maxBits)
+		{
+			for (uint32_t i = 0; i < used.size(); i++) lengths[used[i]] = uint8_t(depth[i]);
+			return;
+		}
+		for (uint32_t i = maxDepth; i > maxBits; i--)
+		{
+			while (lengthCount[i] > 0)
+			{
+				uint32_t j = i - 2;
+				while (lengthCount[j] == 0) j--;
+				lengthCount[i] -= 2;
+				lengthCount[i - 1]++;
+				lengthCount[j + 1] += 2;
+				lengthCount[j]--;
+			}
+		}
+		std::stable_sort(used.begin(), used.end(), [&](uint32_t a, uint32_t b) { return freqs[a] > freqs[b]; });
+		uint32_t next = 0;
+		for (uint32_t bits = 1; bits <= maxBits; bits++)
+		{
+			for (uint32_t k = 0; k < lengthCount[bits]; k++) lengths[used[next++]] = uint8_t(bits);
+		}
+	}
+
+	// Canonical codes for <lengths>, bit-reversed for BitWriter
+	void buildCodes(const uint8_t* lengths, uint32_t count, uint16_t* codes)
+	{
+		uint32_t lengthCount[16] = {};
+		for (uint32_t i = 0; i < count; i++) lengthCount[lengths[i]]++;
+		lengthCount[0] = 0;
+		uint32_t nextCode[16] = {};
+		uint32_t code = 0;
+		for (uint32_t bits = 1; bits < 16; bits++)
+		{
+			code = (code + lengthCount[bits - 1]) << 1;
+			nextCode[bits] = code;
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t length = lengths[i];
+			if (length == 0) { codes[i] = 0; continue; }
+			uint32_t c = nextCode[length]++, reversed = 0;
+			for (uint32_t b = 0; b < length; b++) reversed |= ((c >> b) & 1u) << (length - 1 - b);
+			codes[i] = uint16_t(reversed);
+		}
+	}
+
+	// One block:  dynamic Huffman codes for <symbols>, or stored if that's smaller.  <raw> is the input they cover.
+	void writeBlock(BitWriter& bits, const std::vector<Symbol>& symbols, const uint8_t* pRaw, size_t rawSize, bool final)
+	{
+		const DeflateTables& tables = getDeflateTables();
+		uint32_t litFreq[286] = {}, distFreq[30] = {};
+		uint64_t extraBits = 0;
+		for (const Symbol& s : symbols)
+		{
+			if (s.distance == 0) { litFreq[s.length]++; continue; }
+			uint32_t lengthCode = tables.lengthCode[s.length], distanceCode = tables.getDistanceCode(s.distance);
+			litFreq[257 + lengthCode]++;
+			distFreq[distanceCode]++;
+			extraBits += kLengthExtra[lengthCode] + kDistanceExtra[distanceCode];
+		}
+		litFreq[256] = 1;
+
+		uint8_t litLengths[286], distLengths[30];
+		buildCodeLengths(litFreq, 286, 15, litLengths);
+		buildCodeLengths(distFreq, 30, 15, distLengths);
+		uint32_t litCount = 286, distCount = 30;
+		while (litCount > 257 && litLengths[litCount - 1] == 0) litCount--;
+		while (distCount > 1 && distLengths[distCount - 1] == 0) distCount--;
+
+		// Run-length code the code lengths (16:  repeat the previous 3-6 times, 17:  3-10 zeros, 18:  11-138 zeros)
+		std::vector<uint8_t> all(litLengths, litLengths + litCount);
+		all.insert(all.end(), distLengths, distLengths + distCount);
+		std::vector<std::pair<uint8_t, uint8_t>> runs;   // (code, extra bits value)
+		for (size_t i = 0; i < all.size();)
+		{
+			uint8_t length = all[i];
+			size_t run = 1;
+			while (i + run < all.size() && all[i + run] == length) run++;
+			i += run;
+			if (length == 0)
+			{
+				while (run >= 11) { size_t r = std::min<size_t>(run, 138); runs.push_back({ 18, uint8_t(r - 11) }); run -= r; }
+				if (run >= 3) { runs.push_back({ 17, uint8_t(run - 3) }); run = 0; }
+			}
+			else
+			{
+				runs.push_back({ length, 0 });
+				run--;
+				while (run >= 3) { size_t r = std::min<size_t>(run, 6); runs.push_back({ 16, uint8_t(r - 3) }); run -= r; }
+			}
+			while (run-- > 0) runs.push_back({ length, 0 });
+		}
+		uint32_t clFreq[19] = {};
+		for (const auto& r : runs) clFreq[r.first]++;
+		uint8_t clLengths[19];
+		buildCodeLengths(clFreq, 19, 7, clLengths);
+		uint32_t clCount = 19;
+		while (clCount > 4 && clLengths[kCodeLengthOrder[clCount - 1]] == 0) clCount--;
+
+		// Pick the smaller encoding
+		const uint8_t kRunExtra[19] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7 };
+		uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3ull * clCount + extraBits;
+		for (const auto& r : runs) dynamicBits += clLengths[r.first] + kRunExtra[r.first];
+		for (uint32_t i = 0; i < 286; i++) dynamicBits += uint64_t(litFreq[i]) * litLengths[i];
+		for (uint32_t i = 0; i < 30; i++) dynamicBits += uint64_t(distFreq[i]) * distLengths[i];
+		uint64_t storedBlocks = std::max<uint64_t>(1, (rawSize + kMaxStored - 1) / kMaxStored);
+		uint64_t storedBits = (8 - (bits.getPendingBits() + 3) % 8) % 8 + storedBlocks * (3 + 32) + (storedBlocks - 1) * 7 + 8ull * rawSize;
+
+		if (storedBits <= dynamicBits)
+		{
+			for (uint64_t b = 0; b < storedBlocks; b++)
+			{
+				size_t start = size_t(b) * kMaxStored;
+				uint32_t length = uint32_t(std::min<size_t>(kMaxStored, rawSize - start));
+				bits.put((final && b + 1 == storedBlocks) ? 1u : 0u, 1);
+				bits.put(0, 2);
+				bits.alignToByte();
+				bits.put(length, 16);
+				bits.put(~length & 0xFFFFu, 16);
+				bits.putBytes(pRaw + start, length);
+			}
+			return;
+		}
+
+		uint16_t litCodes[286], distCodes[30], clCodes[19];
+		buildCodes(litLengths, 286, litCodes);
+		buildCodes(distLengths, 30, distCodes);
+		buildCodes(clLengths, 19, clCodes);
+
+		bits.put(final ? 1u : 0u, 1);
+		bits.put(2, 2);
+		bits.put(litCount - 257, 5);
+		bits.put(distCount - 1, 5);
+		bits.put(clCount - 4, 4);
+		for (uint32_t i = 0; i < clCount; i++) bits.put(clLengths[kCodeLengthOrder[i]], 3);
+		for (const auto& r : runs)
+		{
+			bits.put(clCodes[r.first], clLengths[r.first]);
+			if (kRunExtra[r.first]) bits.put(r.second, kRunExtra[r.first]);
+		}
+		for (const Symbol& s : symbols)
+		{
+			if (s.distance == 0) { bits.put(litCodes[s.length], litLengths[s.length]); continue; }
+			uint32_t lengthCode = tables.lengthCode[s.length], distanceCode = tables.getDistanceCode(s.distance);
+			bits.put(litCodes[257 + lengthCode], litLengths[257 + lengthCode]);
+			bits.put(s.length - kLengthBase[lengthCode], kLengthExtra[lengthCode]);
+			bits.put(distCodes[distanceCode], distLengths[distanceCode]);
+			bits.put(s.distance - kDistanceBase[distanceCode], kDistanceExtra[distanceCode]);
+		}
+		bits.put(litCodes[256], litLengths[256]);
+	}
+
+	uint32_t adler32(const uint8_t* pData, size_t size)
+	{
+		uint32_t a = 1, b = 0;
+		while (size > 0)
+		{
+			size_t n = std::min<size_t>(size, 5552);   // Largest run before b can overflow
+			size -= n;
+			while (n-- > 0) { a += *pData++; b += a; }
+			a %= 65521;
+			b %= 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	// LZ77 over hash chains, with one step of lazy matching (a match is only taken if the next position doesn't start a
+	//     longer one), into Huffman blocks of kBlockSymbols symbols
+	void zlibCompress(const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+	{
+		out.clear();
+		out.reserve(in.size() / 2 + 64);
+		out.push_back(0x78);   // Deflate, 32 KB window
+		out.push_back(0x9C);   // Default level, no dictionary;  the pair is a multiple of 31
+
+		const uint8_t* pData = in.data();
+		size_t size = in.size();
+		BitWriter bits(out);
+		std::vector<int32_t> head(1u << kHashBits, -1);
+		std::vector<int32_t> prev(size);
+		std::vector<Symbol> symbols;
+		symbols.reserve(kBlockSymbols);
+		size_t blockStart = 0, emitted = 0;
+
+		auto hash = [&](size_t i) { return ((uint32_t(pData[i]) << 16 | uint32_t(pData[i + 1]) << 8 | pData[i + 2]) * 2654435761u) >> (32 - kHashBits); };
+		auto insert = [&](size_t i)
+		{
+			if (i + kMinMatch > size) return;
+			uint32_t h = hash(i);
+			prev[i] = head[h];
+			head[h] = int32_t(i);
+		};
+		auto longestMatch = [&](size_t i, uint32_t& distance) -> uint32_t
+		{
+			if (i + kMinMatch > size) return 0;
+			uint32_t maxLength = uint32_t(std::min<size_t>(kMaxMatch, size - i)), best = 0;
+			int32_t candidate = head[hash(i)];
+			for (uint32_t chain = 0; candidate >= 0 && chain < kMaxChain; chain++, candidate = prev[candidate])
+			{
+				if (i - size_t(candidate) > kWindowSize) break;
+				const uint8_t* a = pData + candidate;
+				const uint8_t* b = pData + i;
+				if (a[best] != b[best]) continue;
+				uint32_t length = 0;
+				while (length < maxLength && a[length] == b[length]) length++;
+				if (length > best)
+				{
+					best = length;
+					distance = uint32_t(i - size_t(candidate));
+					if (length == maxLength) break;
+				}
+			}
+			return (best >= kMinMatch) ? best : 0;
+		};
+		auto emit = [&](const Symbol& s)
+		{
+			symbols.push_back(s);
+			emitted += s.distance ? s.length : 1;
+			if (symbols.size() >= kBlockSymbols)
+			{
+				writeBlock(bits, symbols, pData + blockStart, emitted - blockStart, false);
+				symbols.clear();
+				blockStart = emitted;
+			}
+		};
+
+		bool pending = false;   // pData[i - 1] is undecided:  a literal, or the start of the match found there
+		uint32_t pendingLength = 0, pendingDistance = 0;
+		size_t i = 0;
+		while (i < size)
+		{
+			uint32_t distance = 0;
+			uint32_t length = (pending && pendingLength >= kGoodMatch) ? 0 : longestMatch(i, distance);
+			insert(i);
+			if (pending)
+			{
+				if (pendingLength >= kMinMatch && pendingLength >= length)
+				{
+					emit({ uint16_t(pendingLength), uint16_t(pendingDistance) });
+					size_t end = i - 1 + pendingLength;
+					for (size_t k = i + 1; k < end; k++) insert(k);
+					i = end;
+					pending = false;
+					continue;
+				}
+				emit({ pData[i - 1], 0 });
+			}
+			pending = true;
+			pendingLength = length;
+			pendingDistance = distance;
+			i++;
+		}
+		if (pending) emit({ pData[size - 1], 0 });
+		writeBlock(bits, symbols, pData + blockStart, emitted - blockStart, true);
+		bits.alignToByte();
+
+		uint32_t checksum = adler32(pData, size);
+		for (int32_t shift = 24; shift >= 0; shift -= 8) out.push_back(uint8_t(checksum >> shift));
+	}
+
+	/*******************************************************************
+	                         File layout
+	*******************************************************************/
+
+	struct Channel
+	{
+		std::string           name;
+		uint32_t              layer = 0;
+		uint32_t              component = 0;
+		ExrWriter::PixelType  type = ExrWriter::PixelType::Half;
+	};
+
+	void put32(std::vector<uint8_t>& out, uint32_t value)
+	{
+		for (uint32_t b = 0; b < 4; b++) out.push_back(uint8_t(value >> (8 * b)));
+	}
+
+	void putAttribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value)
+	{
+		out.insert(out.end(), name, name + strlen(name) + 1);
+		out.insert(out.end(), type, type + strlen(type) + 1);
+		put32(out, uint32_t(value.size()));
+		out.insert(out.end(), value.begin(), value.end());
+	}
+
+	bool validateFrame(const ExrWriter::Frame& frame, std::string& message)
+	{
+		if (frame.width == 0 || frame.height == 0 || frame.layers.empty())
+		{
+			message = "has no pixels or no layers";
+			return false;
+		}
+		for (const ExrWriter::Layer& layer : frame.layers)
+		{
+			if (layer.sourceChannels < 1 || layer.sourceChannels > 4 || layer.channels < 1 || layer.channels > layer.sourceChannels)
+			{
+				message = "layer '" + layer.name + "' has " + std::to_string(layer.channels) + " of " + std::to_string(layer.sourceChannels) + " channels";
+				return false;
+			}
+			size_t expected = size_t(frame.width) * frame.height * layer.sourceChannels * getSourceBytes(layer.source);
+			if (layer.data.size() != expected)
+			{
+				message = "layer '" + layer.name + "' has " + std::to_string(layer.data.size()) + " bytes, expected " + std::to_string(expected);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	const char* kCompressionNames[] = { "none", "rle", "zips", "zip" };
+};
+
+ExrWriter::SharedPtr ExrWriter::create(Compression compression, uint32_t maxQueued, QueuePolicy policy, uint32_t threadCount)
+{
+	if (maxQueued == 0) return nullptr;
+	return SharedPtr(new ExrWriter(compression, maxQueued, policy, threadCount));
+}
+
+ExrWriter::ExrWriter(Compression compression, uint32_t maxQueued, QueuePolicy policy, uint32_t threadCount) :
+	mMaxQueued(maxQueued), mPolicy(policy), mCompression(compression)
+{
+	mpScheduler = TaskScheduler::create((threadCount == 0) ? TaskScheduler::kDefaultWorkerCount : threadCount - 1);
+	mEncoderThread = std::thread(&ExrWriter::encoderLoop, this);
+	mDiskThread = std::thread(&ExrWriter::diskLoop, this);
+}
+
+ExrWriter::~ExrWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWorkAvailable.notify_all();
+	mEncoderThread.join();
+	mDiskThread.join();
+}
+
+const char* ExrWriter::getCompressionName(Compression compression)
+{
+	return kCompressionNames[uint32_t(compression)];
+}
+
+bool ExrWriter::parseCompression(const std::string& name, Compression& compression)
+{
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		if (name == kCompressionNames[i])
+		{
+			compression = Compression(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+void ExrWriter::setCompression(Compression compression)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mCompression = compression;
+}
+
+bool ExrWriter::write(Frame&& frame)
+{
+	std::string message;
+	if (!validateFrame(frame, message))
+	{
+		logWarning("ExrWriter::write() - " + frame.filename + " " + message);
+		return false;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		if (mQueue.size() >= mMaxQueued)
+		{
+			if (mPolicy == QueuePolicy::Drop)
+			{
+				mStats.dropped++;
+				return false;
+			}
+			mSpaceAvailable.wait(lock, [this] { return mQueue.size() < mMaxQueued; });
+		}
+		mQueue.push_back({ std::move(frame), mCompression });
+		mStats.queued++;
+		mInFlight++;
+	}
+	mWorkAvailable.notify_one();
+	return true;
+}
+
+uint32_t ExrWriter::getQueuedCount() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return uint32_t(mQueue.size());
+}
+
+void ExrWriter::flush()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mSpaceAvailable.wait(lock, [this] { return mInFlight == 0; });
+}
+
+ExrWriter::Stats ExrWriter::getStats() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	Stats stats = mStats;
+	stats.waiting = mInFlight;
+	return stats;
+}
+
+bool ExrWriter::encode(const Frame& frame, Compression compression, TaskScheduler* pScheduler, std::vector<uint8_t>& file, uint64_t* pRawBytes)
+{
+	std::string message;
+	if (!validateFrame(frame, message))
+	{
+		logWarning("ExrWriter::encode() - " + frame.filename + " " + message);
+		return false;
+	}
+
+	// Channels, sorted by name as the format requires
+	std::vector<Channel> channels;
+	for (uint32_t l = 0; l < frame.layers.size(); l++)
+	{
+		const Layer& layer = frame.layers[l];
+		for (uint32_t c = 0; c < layer.channels; c++)
+		{
+			Channel channel;
+			channel.name = (layer.name.empty() ? "" : layer.name + ".") + std::string(1, "RGBA"[c]);
+			channel.layer = l;
+			channel.component = c;
+			channel.type = layer.type;
+			channels.push_back(channel);
+		}
+	}
+	std::sort(channels.begin(), channels.end(), [](const Channel& a, const Channel& b) { return a.name < b.name; });
+	for (size_t i = 1; i < channels.size(); i++)
+	{
+		if (channels[i].name == channels[i - 1].name)
+		{
+			logWarning("ExrWriter::encode() - " + frame.filename + " has two channels named " + channels[i].name);
+			return false;
+		}
+	}
+
+	size_t bytesPerLine = 0;
+	bool longNames = false;
+	for (const Channel& channel : channels)
+	{
+		bytesPerLine += size_t(getPixelBytes(channel.type)) * frame.width;
+		longNames |= (channel.name.size() > 31);
+	}
+	uint32_t linesPerChunk = (compression == Compression::ZIP) ? kZipLinesPerChunk : 1;
+	uint32_t chunkCount = (frame.height + linesPerChunk - 1) / linesPerChunk;
+	if (pRawBytes) *pRawBytes = bytesPerLine * frame.height;
+
+	// Scanline blocks, each prefixed with its first line and its size.  Data that doesn't compress is stored raw,
+	//     which readers recognize by its size.
+	std::vector<std::vector<uint8_t>> chunks(chunkCount);
+	auto encodeChunks = [&](uint32_t begin, uint32_t end)
+	{
+		std::vector<uint8_t> raw, predicted, compressed;
+		for (uint32_t chunk = begin; chunk < end; chunk++)
+		{
+			uint32_t y0 = chunk * linesPerChunk, y1 = std::min(frame.height, y0 + linesPerChunk);
+			raw.resize(bytesPerLine * (y1 - y0));
+			uint8_t* pOut = raw.data();
+			for (uint32_t y = y0; y < y1; y++)
+			{
+				for (const Channel& channel : channels)
+				{
+					convertRow(frame.layers[channel.layer], channel.component, channel.type, frame.width, y, pOut);
+					pOut += size_t(getPixelBytes(channel.type)) * frame.width;
+				}
+			}
+
+			const std::vector<uint8_t>* pData = &raw;
+			if (compression != Compression::None)
+			{
+				predict(raw, predicted);
+				if (compression == Compression::RLE) rleCompress(predicted, compressed);
+				else zlibCompress(predicted, compressed);
+				if (compressed.size() < raw.size()) pData = &compressed;
+			}
+
+			std::vector<uint8_t>& out = chunks[chunk];
+			out.reserve(8 + pData->size());
+			put32(out, y0);
+			put32(out, uint32_t(pData->size()));
+			out.insert(out.end(), pData->begin(), pData->end());
+		}
+	};
+	if (pScheduler) pScheduler->parallelFor(0, chunkCount, encodeChunks);
+	else encodeChunks(0, chunkCount);
+
+	// Header
+	file.clear();
+	put32(file, kExrMagic);
+	put32(file, kExrVersion | (longNames ? kExrLongNames : 0u));
+
+	std::vector<uint8_t> value;
+	for (const Channel& channel : channels)
+	{
+		value.insert(value.end(), channel.name.begin(), channel.name.end());
+		value.push_back(0);
+		put32(value, uint32_t(channel.type));
+		value.insert(value.end(), { 0, 0, 0, 0 });   // pLinear, reserved
+		put32(value, 1);                             // x and y sampling
+		put32(value, 1);
+	}
+	value.push_back(0);
+	putAttribute(file, "channels", "chlist", value);
+	putAttribute(file, "compression", "compression", { uint8_t(compression) });
+	value.clear();
+	for (uint32_t v : { 0u, 0u, frame.width - 1, frame.height - 1 }) put32(value, v);
+	putAttribute(file, "dataWindow", "box2i", value);
+	putAttribute(file, "displayWindow", "box2i", value);
+	putAttribute(file, "lineOrder", "lineOrder", { 0 });   // Increasing y
+	float one = 1.f;
+	value.assign(reinterpret_cast<const uint8_t*>(&one), reinterpret_cast<const uint8_t*>(&one) + 4);
+	putAttribute(file, "pixelAspectRatio", "float", value);
+	putAttribute(file, "screenWindowWidth", "float", value);
+	putAttribute(file, "screenWindowCenter", "v2f", std::vector<uint8_t>(8, 0));
+	file.push_back(0);
+
+	// Offset table, then the blocks
+	size_t totalSize = file.size() + 8 * size_t(chunkCount);
+	for (const auto& chunk : chunks) totalSize += chunk.size();
+	file.reserve(totalSize);
+	uint64_t offset = file.size() + 8 * uint64_t(chunkCount);
+	for (const auto& chunk : chunks)
+	{
+		for (uint32_t b = 0; b < 8; b++) file.push_back(uint8_t(offset >> (8 * b)));
+		offset += chunk.size();
+	}
+	for (auto& chunk : chunks)
+	{
+		file.insert(file.end(), chunk.begin(), chunk.end());
+		std::vector<uint8_t>().swap(chunk);
+	}
+	return true;
+}
+
+void ExrWriter::encoderLoop()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWorkAvailable.wait(lock, [this] { return mStop || !mQueue.empty(); });
+			if (mQueue.empty())
+			{
+				// Stopping, and everything has been encoded
+				mEncoderDone = true;
+				mEncodedAvailable.notify_all();
+				return;
+			}
+			job = std::move(mQueue.front());
+			mQueue.pop_front();
+		}
+		mSpaceAvailable.notify_all();
+
+		CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+		EncodedFile encoded;
+		encoded.filename = job.frame.filename;
+		bool success = encode(job.frame, job.compression, mpScheduler.get(), encoded.bytes, &encoded.rawBytes);
+		float duration = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+		job.frame.layers.clear();
+
+		{
+			// Hand it to the disk thread, once it has taken the last one
+			std::unique_lock<std::mutex> lock(mMutex);
+			mStats.encodeMs += duration;
+			if (!success)
+			{
+				mStats.failed++;
+				mInFlight--;
+				lock.unlock();
+				mSpaceAvailable.notify_all();
+				continue;
+			}
+			mSpaceAvailable.wait(lock, [this] { return mEncoded.empty(); });
+			mEncoded.push_back(std::move(encoded));
+		}
+		mEncodedAvailable.notify_one();
+	}
+}
+
+void ExrWriter::diskLoop()
+{
+	while (true)
+	{
+		EncodedFile encoded;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mEncodedAvailable.wait(lock, [this] { return mEncoderDone || !mEncoded.empty(); });
+			if (mEncoded.empty()) return;   // The encoder is done, and everything has been written
+			encoded = std::move(mEncoded.front());
+			mEncoded.pop_front();
+		}
+		mSpaceAvailable.notify_all();
+
+		CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+		std::ofstream stream(encoded.filename, std::ios::binary | std::ios::trunc);
+		if (stream) stream.write(reinterpret_cast<const char*>(encoded.bytes.data()), std::streamsize(encoded.bytes.size()));
+		bool success = stream.good();
+		stream.close();
+		float duration = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+		if (!success) logWarning("ExrWriter - could not write " + encoded.filename);
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStats.diskMs += duration;
+			if (success)
+			{
+				mStats.written++;
+				mStats.rawBytes += encoded.rawBytes;
+				mStats.fileBytes += encoded.bytes.size();
+			}
+			else mStats.failed++;
+			mInFlight--;
+		}
+		mSpaceAvailable.notify_all();
+	}
+}
+
+ExrWriter::Benchmark ExrWriter::benchmark(uint32_t width, uint32_t height, uint32_t frames)
+{
+	Benchmark result;
+	if (width == 0 || height == 0 || frames == 0) return result;
+	result.size = uvec2(width, height);
+	result.frames = frames;
+
+	// What the AOV pass reads back:  RGBA32Float channels of a G-buffer and its shading, for a ground plane with a
+	//     checker texture and three spheres under a point light, with Monte Carlo-like noise in the noisy inputs
+	struct LayerDesc { const char* name; uint32_t channels; PixelType type; };
+	const LayerDesc kLayers[] = {
+		{ "", 3, PixelType::Half }, { "WorldPosition", 3, PixelType::Float }, { "WorldNormal", 3, PixelType::Half }, { "MaterialDiffuse", 3, PixelType::Half },
+		{ "ShadedOutput", 3, PixelType::Half }, { "SpatialReservoirs", 3, PixelType::Half }, { "MotionVectors", 2, PixelType::Half } };
+	const uint32_t layerCount = uint32_t(sizeof(kLayers) / sizeof(kLayers[0]));
+	Frame frame;
+	frame.width = width;
+	frame.height = height;
+	for (const LayerDesc& desc : kLayers)
+	{
+		Layer layer;
+		layer.name = desc.name;
+		layer.channels = desc.channels;
+		layer.type = desc.type;
+		layer.data.resize(size_t(width) * height * sizeof(vec4));
+		frame.layers.push_back(std::move(layer));
+		result.channels += desc.channels;
+	}
+	result.layers = layerCount;
+
+	const vec4 kSpheres[] = { vec4(-1.2f, 0.6f, 0.f, 0.6f), vec4(0.3f, 0.9f, -1.f, 0.9f), vec4(1.5f, 0.4f, 0.8f, 0.4f) };
+	const vec3 kSphereColors[] = { vec3(0.8f, 0.2f, 0.2f), vec3(0.2f, 0.7f, 0.3f), vec3(0.9f, 0.9f, 0.9f) };
+	const vec3 kLight(2.f, 4.f, 3.f), kEye(0.f, 1.5f, 5.f);
+	TaskScheduler::getGlobal()->parallelFor(0, height, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t y = begin; y < end; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				vec2 ndc = vec2((float(x) + 0.5f) / float(width), (float(y) + 0.5f) / float(height)) * 2.f - 1.f;
+				vec3 dir = glm::normalize(vec3(ndc.x * 0.577f * float(width) / float(height), -ndc.y * 0.577f - 0.2f, -1.f));
+
+				float t = (dir.y < 0.f) ? -kEye.y / dir.y : 1e30f;
+				vec3 normal(0.f, 1.f, 0.f);
+				vec3 diffuse(0.f);
+				for (uint32_t s = 0; s < 3; s++)
+				{
+					vec3 oc = kEye - vec3(kSpheres[s]);
+					float b = glm::dot(oc, dir), c = glm::dot(oc, oc) - kSpheres[s].w * kSpheres[s].w;
+					float disc = b * b - c;
+					if (disc > 0.f && -b - std::sqrt(disc) > 0.f && -b - std::sqrt(disc) < t)
+					{
+						t = -b - std::sqrt(disc);
+						normal = glm::normalize(kEye + dir * t - vec3(kSpheres[s]));
+						diffuse = kSphereColors[s];
+					}
+				}
+
+				vec4 texels[layerCount] = {};
+				if (t < 1e29f)
+				{
+					vec3 pos = kEye + dir * t;
+					if (diffuse == vec3(0.f)) diffuse = ((int(std::floor(pos.x)) + int(std::floor(pos.z))) & 1) ? vec3(0.75f) : vec3(0.25f, 0.25f, 0.3f);
+					vec3 toLight = kLight - pos;
+					float lit = 30.f * std::max(glm::dot(normal, glm::normalize(toLight)), 0.f) / glm::dot(toLight, toLight);
+					vec3 color = diffuse * (lit + 0.05f);
+					uint32_t seed = (y * 9781u + x * 6271u) * 2654435761u;
+					float noise = float((seed ^ (seed >> 15)) & 0xFFFFu) / 65535.f;
+					texels[0] = vec4(color, 1.f);
+					texels[1] = vec4(pos, 1.f);
+					texels[2] = vec4(normal, 0.f);
+					texels[3] = vec4(diffuse, 1.f);
+					texels[4] = vec4(color * (0.4f + 1.2f * noise), 1.f);
+					texels[5] = vec4(color * (0.8f + 0.4f * noise), 1.f);
+					texels[6] = vec4(0.002f * ndc.x, 0.0005f, 0.f, 0.f);
+				}
+				else texels[0] = vec4(vec3(0.4f, 0.6f, 1.f) * (0.5f + 0.5f * -ndc.y), 1.f);
+
+				for (uint32_t l = 0; l < layerCount; l++)
+				{
+					std::memcpy(frame.layers[l].data.data() + (size_t(y) * width + x) * sizeof(vec4), &texels[l], sizeof(vec4));
+				}
+			}
+		}
+	});
+
+	std::string directory = getExecutableDirectory() + "/ExrBenchmark";
+	if (!isDirectoryExists(directory)) createDirectory(directory);
+
+	// Sustained throughput per compression, waiting for room rather than dropping frames
+	float copyMs = 0.f;
+	for (Compression compression : { Compression::None, Compression::RLE, Compression::ZIPS, Compression::ZIP })
+	{
+		SharedPtr pWriter = create(compression, 1, QueuePolicy::Block);
+		result.threadCount = pWriter->getThreadCount();
+		std::vector<std::string> files;
+		CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+		for (uint32_t f = 0; f < frames; f++)
+		{
+			CpuTimer::TimePoint copyStart = CpuTimer::getCurrentTimePoint();
+			Frame copy = frame;   // The readback copy the AOV pass makes per frame
+			copyMs += float(CpuTimer::calcDuration(copyStart, CpuTimer::getCurrentTimePoint()));
+			copy.filename = directory + "/" + getCompressionName(compression) + "_" + std::to_string(f) + ".exr";
+			files.push_back(copy.filename);
+			pWriter->write(std::move(copy));
+		}
+		pWriter->flush();
+		float elapsedMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+
+		Stats stats = pWriter->getStats();
+		Benchmark::Run run;
+		run.compression = compression;
+		run.framesPerSecond = float(stats.written) * 1000.f / std::max(elapsedMs, 1e-3f);
+		run.ratio = (stats.fileBytes > 0) ? float(double(stats.rawBytes) / double(stats.fileBytes)) : 0.f;
+		run.encodeMs = stats.encodeMs / float(frames);
+		run.diskMs = stats.diskMs / float(frames);
+		run.fileBytes = stats.fileBytes / std::max(stats.written, 1u);
+		result.rawBytes = stats.rawBytes / std::max(stats.written, 1u);
+		result.runs.push_back(run);
+		for (const std::string& file : files) std::remove(file.c_str());
+	}
+	result.copyMs = copyMs / float(4 * frames);
+
+	// Everything at once with QueuePolicy::Drop:  the caller never waits, and frames the writer can't keep up with are dropped
+	{
+		SharedPtr pWriter = create(Compression::ZIP, 1, QueuePolicy::Drop);
+		std::vector<std::string> files;
+		for (uint32_t f = 0; f < frames; f++)
+		{
+			Frame copy = frame;
+			copy.filename = directory + "/drop_" + std::to_string(f) + ".exr";
+			files.push_back(copy.filename);
+			CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+			pWriter->write(std::move(copy));
+			result.maxSubmitMs = std::max(result.maxSubmitMs, float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint())));
+		}
+		pWriter->flush();
+		result.droppedFrames = pWriter->getStats().dropped;
+		for (const std::string& file : files) std::remove(file.c_str());
+	}
+
+	// The synchronous path:  one FreeImage EXR (RGB floats) per layer
+	{
+		CpuTimer::TimePoint start = CpuTimer::getCurrentTimePoint();
+		for (uint32_t l = 0; l < layerCount; l++)
+		{
+			std::string file = directory + "/freeimage_" + std::to_string(l) + ".exr";
+			Bitmap::saveImage(file, width, height, Bitmap::FileFormat::ExrFile, Bitmap::ExportFlags::None, ResourceFormat::RGBA32Float, true, frame.layers[l].data.data());
+			std::remove(file.c_str());
+		}
+		result.freeImageMs = float(CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()));
+	}
+	return result;
+}
+
+void ExrWriter::logBenchmark(const Benchmark& bench)
+{
+	auto mb = [](uint64_t bytes) { return std::to_string(double(bytes) / (1024.0 * 1024.0)) + " MB"; };
+	std::string message = "ExrWriter: " + std::to_string(bench.frames) + " frames of " + std::to_string(bench.size.x) + "x" + std::to_string(bench.size.y) + ", " +
+		std::to_string(bench.layers) + " layers (" + std::to_string(bench.channels) + " channels, " + mb(bench.rawBytes) + " raw), " +
+		std::to_string(bench.threadCount) + " encoder threads, " + std::to_string(bench.copyMs) + " ms per frame to copy its layers";
+	for (const Benchmark::Run& run : bench.runs)
+	{
+		message += "\n    " + std::string(getCompressionName(run.compression)) + ":  " + std::to_string(run.framesPerSecond) + " frames/s, ratio " +
+			std::to_string(run.ratio) + " (" + mb(run.fileBytes) + " per frame), encode " + std::to_string(run.encodeMs) + " ms, disk " + std::to_string(run.diskMs) + " ms";
+	}
+	message += "\n    FreeImage, one EXR per layer:  " + std::to_string(bench.freeImageMs) + " ms per frame (" + std::to_string(1000.f / std::max(bench.freeImageMs, 1e-3f)) + " frames/s)";
+	message += "\n    Dropping instead of waiting:  " + std::to_string(bench.droppedFrames) + " of " + std::to_string(bench.frames) + " frames dropped, longest write() " +
+		std::to_string(bench.maxSubmitMs) + " ms";
+	logInfo(message);
+}
@@ -0,0 +1,207 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#pragma once
+
+#include "Falcor.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/** Writes frames of several layers (e.g., a ResourceManager channel each) as one multi-channel OpenEXR file per frame,
+    on background threads, so that rendering never waits on compression or the disk.
+
+    Each layer's channels are named <layer>.R, <layer>.G, ... (just R, G, ... for a layer named ""), the layer naming
+    compositing tools expect, and each layer is stored as half, float or uint independently of how it was rendered.
+    Files are single-part scanline images, compressed with NONE, RLE, ZIPS or ZIP (zlib-compatible deflate, written
+    here, as the framework has no OpenEXR or zlib to link against).
+
+    Two threads form a pipeline:  the encoder converts and compresses a frame's scanline blocks in parallel on its own
+    TaskScheduler, and the disk thread writes the previous frame meanwhile.  At most <maxQueued> frames wait to be
+    encoded.  With QueuePolicy::Drop, write() drops a frame rather than wait for room, so the caller never blocks;
+    QueuePolicy::Block waits instead (e.g., for offline sequences, where every frame matters).
+
+Usage:
+     ExrWriter::SharedPtr pWriter = ExrWriter::create(ExrWriter::Compression::ZIP);
+     ExrWriter::Frame frame;
+     frame.filename = "frames/frame_00000.exr";
+     frame.width = width;
+     frame.height = height;
+     frame.layers.push_back(beautyLayer);     // Layer "", channels R, G, B
+     frame.layers.push_back(positionLayer);   // Layer "WorldPosition", as floats
+     pWriter->write(std::move(frame));        // Returns as soon as it's queued (or dropped)
+     pWriter->flush();                        // Wait for everything queued so far
+
+The destructor writes everything still queued before returning.
+*/
+
+using namespace Falcor;
+
+class ExrWriter : public std::enable_shared_from_this<ExrWriter>
+{
+public:
+	using SharedPtr = std::shared_ptr<ExrWriter>;
+	using SharedConstPtr = std::shared_ptr<const ExrWriter>;
+	virtual ~ExrWriter();
+
+	// OpenEXR's compression ids.  RLE and ZIPS compress each scanline on its own, ZIP blocks of 16.
+	enum class Compression : uint8_t { None = 0, RLE = 1, ZIPS = 2, ZIP = 3 };
+
+	// OpenEXR's pixel type ids
+	enum class PixelType : uint32_t { Uint = 0, Half = 1, Float = 2 };
+
+	// How a layer's texels are laid out in memory
+	enum class SourceType { Float32, Float16, Uint32, Unorm8, UnormSrgb8 };
+
+	enum class QueuePolicy { Drop, Block };
+
+	// One layer of a frame:  width * height texels, top row first, of <sourceChannels> interleaved values each.  The
+	//     first <channels> of them are written, as R, G, B and A.
+	struct Layer
+	{
+		std::string          name;
+		uint32_t             channels = 4;
+		PixelType            type = PixelType::Half;
+		SourceType           source = SourceType::Float32;
+		uint32_t             sourceChannels = 4;
+		std::vector<uint8_t> data;
+	};
+
+	struct Frame
+	{
+		std::string          filename;
+		uint32_t             width = 0;
+		uint32_t             height = 0;
+		std::vector<Layer>   layers;
+	};
+
+	// Totals since create()
+	struct Stats
+	{
+		uint32_t queued = 0;           ///< Frames accepted by write()
+		uint32_t dropped = 0;          ///< Frames write() turned away (queue full, with QueuePolicy::Drop)
+		uint32_t written = 0;          ///< Frames on disk
+		uint32_t failed = 0;           ///< Frames that couldn't be written (e.g., a bad path)
+		uint32_t waiting = 0;          ///< Frames queued but not yet on disk
+		uint64_t rawBytes = 0;         ///< Pixel data of the written frames at their pixel types, before compression
+		uint64_t fileBytes = 0;        ///< Size of the written files
+		float    encodeMs = 0.f;       ///< Time the encoder spent converting and compressing them
+		float    diskMs = 0.f;         ///< Time the disk thread spent writing them
+	};
+
+	// Result of benchmark()
+	struct Benchmark
+	{
+		struct Run
+		{
+			Compression compression = Compression::None;
+			float    framesPerSecond = 0.f;   ///< Sustained, from the first write() to the end of flush()
+			float    ratio = 0.f;             ///< Raw pixel bytes over file bytes
+			float    encodeMs = 0.f;          ///< Per frame
+			float    diskMs = 0.f;            ///< Per frame
+			uint64_t fileBytes = 0;           ///< Per frame
+		};
+
+		uvec2            size = uvec2(0);
+		uint32_t         frames = 0;
+		uint32_t         layers = 0;
+		uint32_t         channels = 0;
+		uint32_t         threadCount = 0;      ///< Encoder threads
+		uint64_t         rawBytes = 0;         ///< Per frame, at the written pixel types
+		float            copyMs = 0.f;         ///< Per frame, copying its layers into a Frame (part of each run's frames/s)
+		std::vector<Run> runs;                 ///< One per compression, with QueuePolicy::Block
+		float            freeImageMs = 0.f;    ///< One frame with Bitmap::saveImage(), an RGBA float EXR per layer, for comparison
+		uint32_t         droppedFrames = 0;    ///< Submitting every frame at once with QueuePolicy::Drop (ZIP) ...
+		float            maxSubmitMs = 0.f;    ///< ... and the longest write() call then
+	};
+
+	// Start the encoder and disk threads.  threadCount is the number of threads compressing (0 for one per core, less
+	//     one for the render thread).  Returns nullptr if maxQueued is 0.
+	static SharedPtr create(Compression compression = Compression::ZIP, uint32_t maxQueued = 3, QueuePolicy policy = QueuePolicy::Drop, uint32_t threadCount = 0);
+
+	// Queue a frame for writing.  Returns false (and drops the frame) if it's malformed, or if the queue is full under
+	//     QueuePolicy::Drop;  blocks while the queue is full under QueuePolicy::Block.
+	bool write(Frame&& frame);
+
+	// Frames waiting to be encoded.  write() drops (QueuePolicy::Drop) or blocks when this reaches getMaxQueued(), so a
+	//     caller can skip preparing frames that wouldn't fit.
+	uint32_t getQueuedCount() const;
+
+	// Block until every frame queued so far is on disk
+	void flush();
+
+	// Convert and compress <frame> into the bytes of an EXR file, running the scanline blocks in parallel on
+	//     pScheduler (serially if it's null), as the encoder thread does.  Returns the raw pixel size in rawBytes.
+	static bool encode(const Frame& frame, Compression compression, TaskScheduler* pScheduler, std::vector<uint8_t>& file, uint64_t* pRawBytes = nullptr);
+
+	// Compression names ("none", "rle", "zips", "zip") for GUIs and command lines
+	static const char* getCompressionName(Compression compression);
+	static bool parseCompression(const std::string& name, Compression& compression);
+
+	// Write <frames> synthetic frames of G-buffer-like layers at width x height with each compression, and compare
+	//     against saving each layer with Bitmap::saveImage().  Writes to <exe dir>/ExrBenchmark, and cleans up after.
+	static Benchmark benchmark(uint32_t width = 3840, uint32_t height = 2160, uint32_t frames = 8);
+	static void logBenchmark(const Benchmark& bench);
+
+	// Accessors
+	Stats getStats() const;
+	Compression getCompression() const                  { return mCompression; }
+	void setCompression(Compression compression);       ///< Applies to frames queued from now on
+	QueuePolicy getQueuePolicy() const                  { return mPolicy; }
+	uint32_t getMaxQueued() const                       { return mMaxQueued; }
+	uint32_t getThreadCount() const                     { return mpScheduler->getWorkerCount() + 1; }
+
+protected:
+	ExrWriter(Compression compression, uint32_t maxQueued, QueuePolicy policy, uint32_t threadCount);
+
+	struct Job
+	{
+		Frame        frame;
+		Compression  compression = Compression::ZIP;
+	};
+
+	struct EncodedFile
+	{
+		std::string          filename;
+		std::vector<uint8_t> bytes;
+		uint64_t             rawBytes = 0;
+	};
+
+	void encoderLoop();
+	void diskLoop();
+
+	const uint32_t               mMaxQueued;
+	const QueuePolicy            mPolicy;
+	Compression                  mCompression;
+	TaskScheduler::SharedPtr     mpScheduler;
+
+	std::deque<Job>              mQueue;              ///< Waiting to be encoded
+	std::deque<EncodedFile>      mEncoded;            ///< Encoded, waiting to be written (at most one)
+	uint32_t                     mInFlight = 0;       ///< Queued, and not yet written (or failed)
+	bool                         mStop = false;
+	Stats                        mStats;
+
+	mutable std::mutex           mMutex;
+	std::condition_variable      mWorkAvailable;      ///< Signaled when a frame is queued, or we're stopping
+	std::condition_variable      mEncodedAvailable;   ///< Signaled when a frame is encoded, or the encoder is done
+	std::condition_variable      mSpaceAvailable;     ///< Signaled when a frame moves along, or is on disk
+	bool                         mEncoderDone = false;
+	std::thread                  mEncoderThread;
+	std::thread                  mDiskThread;
+};
@@ -0,0 +1,122 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#include "ProfileTraceWriter.h"
+
+ProfileTraceWriter::SharedPtr ProfileTraceWriter::create(const std::string& traceFilename, const std::string& csvFilename)
+{
+	SharedPtr pWriter = SharedPtr(new ProfileTraceWriter());
+	if (!traceFilename.empty())
+	{
+		pWriter->mpTraceFile = fopen(traceFilename.c_str(), "w");
+		if (pWriter->mpTraceFile)
+		{
+			pWriter->mTraceFilename = traceFilename;
+			fprintf(pWriter->mpTraceFile, "{\"traceEvents\":[\n"
+				"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n"
+				"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}");
+		}
+		else logWarning("ProfileTraceWriter::create() - can't create " + traceFilename);
+	}
+	if (!csvFilename.empty())
+	{
+		pWriter->mpCsvFile = fopen(csvFilename.c_str(), "w");
+		if (pWriter->mpCsvFile)
+		{
+			pWriter->mCsvFilename = csvFilename;
+			fprintf(pWriter->mpCsvFile, "frame,event,level,cpuStartMs,cpuMs,gpuMs\n");
+		}
+		else logWarning("ProfileTraceWriter::create() - can't create " + csvFilename);
+	}
+	if (!pWriter->mpTraceFile && !pWriter->mpCsvFile) return nullptr;
+
+	pWriter->mNextFrame = Profiler::getFrameIndex();
+	return pWriter;
+}
+
+const std::string& ProfileTraceWriter::getEscapedName(const Profiler::EventData* pEvent, bool forCsv)
+{
+	auto it = mNames.find(pEvent);
+	if (it == mNames.end())
+	{
+		// JSON:  backslash-escape quotes and backslashes.  CSV:  quote the field and double its quotes.
+		std::string json, csv = "\"";
+		for (char c : pEvent->name)
+		{
+			if (c == '"' || c == '\\') json += '\\';
+			json += c;
+			if (c == '"') csv += '"';
+			csv += c;
+		}
+		csv += '"';
+		it = mNames.emplace(pEvent, std::make_pair(json, csv)).first;
+	}
+	return forCsv ? it->second.second : it->second.first;
+}
+
+void ProfileTraceWriter::recordFrames()
+{
+	if (!mpTraceFile && !mpCsvFile) return;
+
+	// Frames are complete up to getFrameIndex() - 2.  Skip ahead past any that have left the profiler's history.
+	uint64_t frameIndex = Profiler::getFrameIndex();
+	if (frameIndex > Profiler::kHistorySize + 1) mNextFrame = std::max(mNextFrame, frameIndex - Profiler::kHistorySize - 1);
+
+	for (; Profiler::getFrameEvents(mNextFrame, mEvents); mNextFrame++)
+	{
+		for (const Profiler::EventData* pEvent : mEvents)
+		{
+			const Profiler::Sample& sample = *pEvent->findSample(mNextFrame);
+			if (mpTraceFile)
+			{
+				// Chrome traces are in microseconds
+				const std::string& name = getEscapedName(pEvent, false);
+				fprintf(mpTraceFile, ",\n{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":0,\"args\":{\"frame\":%llu}}",
+					name.c_str(), sample.cpuStart * 1000.0, sample.cpuMs * 1000.0, (unsigned long long)mNextFrame);
+				fprintf(mpTraceFile, ",\n{\"name\":\"%s\",\"cat\":\"gpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":1,\"args\":{\"frame\":%llu}}",
+					name.c_str(), sample.cpuStart * 1000.0, sample.gpuMs * 1000.0, (unsigned long long)mNextFrame);
+			}
+			if (mpCsvFile)
+			{
+				fprintf(mpCsvFile, "%llu,%s,%u,%.4f,%.4f,%.4f\n", (unsigned long long)mNextFrame, getEscapedName(pEvent, true).c_str(),
+					pEvent->level, sample.cpuStart, sample.cpuMs, sample.gpuMs);
+			}
+		}
+
+		if (++mFrameCount % kFlushInterval == 0)
+		{
+			if (mpTraceFile) fflush(mpTraceFile);
+			if (mpCsvFile) fflush(mpCsvFile);
+		}
+	}
+}
+
+void ProfileTraceWriter::close()
+{
+	if (mpTraceFile)
+	{
+		fprintf(mpTraceFile, "\n]}\n");
+		fclose(mpTraceFile);
+		mpTraceFile = nullptr;
+	}
+	if (mpCsvFile)
+	{
+		fclose(mpCsvFile);
+		mpCsvFile = nullptr;
+	}
+}
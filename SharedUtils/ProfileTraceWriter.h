@@ -0,0 +1,89 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#pragma once
+
+#include "Falcor.h"
+#include <cstdio>
+#include <map>
+
+/** Streams Falcor's per-event profiler samples (see Profiler::getFrameEvents()) to disk as they complete, so long runs can
+    be compared across builds without keeping their whole history in memory.
+
+    Two formats are written, either of which may be skipped:
+      - Chrome trace JSON (open in chrome://tracing or Perfetto):  one complete ("X") event per profiler event and frame,
+        CPU times on thread "CPU" and GPU times on thread "GPU".  The profiler has no GPU timestamps, so GPU events are
+        placed at the CPU start of the same event; only their durations are measured.  The file stays loadable if the
+        run ends without close(), as the trace format allows a missing closing bracket.
+      - CSV with one "frame,event,level,cpuStartMs,cpuMs,gpuMs" row per profiler event and frame.
+
+    Frames are written once their GPU times are known, one frame after they end.  Frames that fall out of the profiler's
+    history (Profiler::kHistorySize) before recordFrames() is called again are lost.
+
+Usage:
+     ProfileTraceWriter::SharedPtr pTrace = ProfileTraceWriter::create("trace.json", "trace.csv");
+     Falcor::gProfileEnabled = true;                        // Events are only recorded while profiling is on
+     ...
+     pTrace->recordFrames();                                // Once per frame, e.g. at the start of onFrameRender()
+     ...
+     pTrace->close();                                       // Or let the destructor do it
+*/
+
+using namespace Falcor;
+
+class ProfileTraceWriter : public std::enable_shared_from_this<ProfileTraceWriter>
+{
+public:
+	using SharedPtr = std::shared_ptr<ProfileTraceWriter>;
+	using SharedConstPtr = std::shared_ptr<const ProfileTraceWriter>;
+	virtual ~ProfileTraceWriter() { close(); }
+
+	// Open the output files (an empty filename skips that format).  Returns nullptr if no file could be opened.
+	//     Only frames that complete after this call are written.
+	static SharedPtr create(const std::string& traceFilename, const std::string& csvFilename);
+
+	// Write every frame that completed since the last call
+	void recordFrames();
+
+	// Finish and close the files.  Further recordFrames() calls do nothing.
+	void close();
+
+	// Accessors
+	uint64_t getFrameCount() const                  { return mFrameCount; }   ///< Frames written so far
+	const std::string& getTraceFilename() const     { return mTraceFilename; }
+	const std::string& getCsvFilename() const       { return mCsvFilename; }
+
+protected:
+	ProfileTraceWriter() = default;
+
+	// An event name, escaped once for each format
+	const std::string& getEscapedName(const Profiler::EventData* pEvent, bool forCsv);
+
+	std::string                  mTraceFilename;
+	std::string                  mCsvFilename;
+	FILE*                        mpTraceFile = nullptr;
+	FILE*                        mpCsvFile = nullptr;
+
+	uint64_t                     mNextFrame = 0;       ///< Next profiler frame to write
+	uint64_t                     mFrameCount = 0;
+	std::vector<const Profiler::EventData*> mEvents;   ///< Scratch, reused every frame
+	std::map<const Profiler::EventData*, std::pair<std::string, std::string>> mNames;   ///< JSON and CSV escaped event names
+
+	// How often (in frames) we flush the files, so an interrupted run loses little
+	static const uint32_t        kFlushInterval = 60;
+};
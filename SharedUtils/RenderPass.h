@@ -67,8 +67,13 @@ public:
 	virtual bool usesCompute()        { return false; }      // Will your pass use a compute pass?
 	virtual bool appliesPostprocess() { return false; }      // Does your pass apply a postprocess?
 	virtual bool usesEnvironmentMap() { return false; }      // Does your pass use an environment map?
+	virtual bool usesReSTIRGI()       { return false; }      // Does your pass resample indirect lighting (ReSTIR GI)?
 	virtual bool hasAnimation()       { return true;  }      // Controls if "freeze animation" GUI is shown (should generally leave as true)
 
+	// Override to list the channels your pass reads and writes each frame (see ResourceManager::ChannelUsage), so the
+	//     resource manager can alias the transient ones.  Passes that don't (returning false) turn aliasing off for the pipeline.
+	virtual bool describeChannelUsage(ResourceManager::ChannelUsage &usage) { return false; }
+
 
     //
     // Public interface. These functions call corresponding virtual protected interface functions.
@@ -146,7 +151,7 @@ public:
 
     /** Returns the name of the render pass.
     */
-    std::string getName() const { return mName; }
+    const std::string& getName() const { return mName; }
 
     /** Sets the name of the GUI window/group.
     */
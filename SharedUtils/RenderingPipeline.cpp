@@ -21,12 +21,21 @@
 #include "Externals/dear_imgui/imgui.h"
 #include "SceneLoaderWrapper.h"
 #include <algorithm>
+#include <map>
 
 namespace {
 	const char     *kNullPassDescriptor = "< None >";   ///< Name used in dropdown lists when no pass is selected.
 	const uint32_t  kNullPassId = 0xFFFFFFFFu;          ///< Id used to represent the null pass (using -1).
-};
+	const std::string kNullPassProfileName = "";        ///< Profiler event name of an empty pass slot
 
+	void logAliasingStats(const ResourceManager::AliasingStats& stats)
+	{
+		auto mb = [](uint64_t bytes) { return std::to_string(bytes / (1024 * 1024)) + " MB"; };
+		logInfo("Channel aliasing:  " + std::to_string(stats.transientChannels) + " of " + std::to_string(stats.channels) + " channels transient, " +
+			std::to_string(stats.allocations) + " textures, " + mb(stats.aliasedBytes) + " (" + mb(stats.naiveBytes) + " without aliasing, " +
+			mb(stats.peakLiveBytes) + " peak live)");
+	}
+};
 
 RenderingPipeline::RenderingPipeline() 
 	: Renderer()
@@ -73,16 +82,6 @@ void RenderingPipeline::onLoad(SampleCallbacks* pSample, const RenderContext::Sh
 			createDefaultDropdownGuiForPass(i, mPassSelectors[i]);
     }
 
-	// Create identifiers for profiling.
-    mProfileGPUTimes.resize(mActivePasses.size() * 2);
-    mProfileLastGPUTimes.resize(mActivePasses.size() * 2);
-	for (uint32_t i = 0; i < mActivePasses.size()*2; i++)
-	{
-		char buf[256];
-		sprintf_s(buf, "Pass_%d", i);
-		mProfileNames.push_back( HashedString(std::string(buf)) );
-	}
-
 	// Create a camera controller
 	mpCameraControl = CameraController::SharedPtr(new FirstPersonCameraController);
 	mpCameraControl->attachCamera(nullptr);
@@ -138,6 +137,7 @@ void RenderingPipeline::updatePipelineRequirementFlags(void)
 	mPipeAppliesPostprocess = false;
 	mPipeUsesCompute = false;
 	mPipeUsesEnvMap = false;
+	mPipeUsesReSTIRGI = false;
 	mPipeNeedsDefaultScene = mpResourceManager ? mpResourceManager->userSetDefaultScene() : false;
 	mPipeHasAnimation = false;
 
@@ -151,6 +151,7 @@ void RenderingPipeline::updatePipelineRequirementFlags(void)
 			mPipeAppliesPostprocess = mPipeAppliesPostprocess || mActivePasses[passNum]->appliesPostprocess();
 			mPipeUsesCompute = mPipeUsesCompute || mActivePasses[passNum]->usesCompute();
 			mPipeUsesEnvMap = mPipeUsesEnvMap || mActivePasses[passNum]->usesEnvironmentMap();
+			mPipeUsesReSTIRGI = mPipeUsesReSTIRGI || mActivePasses[passNum]->usesReSTIRGI();
 			mPipeNeedsDefaultScene = mPipeNeedsDefaultScene || mActivePasses[passNum]->loadDefaultScene();
 			mPipeHasAnimation = mPipeHasAnimation || mActivePasses[passNum]->hasAnimation();
 		}
@@ -159,6 +160,85 @@ void RenderingPipeline::updatePipelineRequirementFlags(void)
 	mPipeRequiresScene = mPipeRequiresScene || mPipeNeedsDefaultScene;
 }
 
+bool RenderingPipeline::getChannelUsage(std::vector<ResourceManager::ChannelUsage>& passUsage) const
+{
+	// Every active pass has to describe its usage, or we can't tell which channels are safe to share
+	passUsage.clear();
+	for (uint32_t passNum = 0; passNum < mActivePasses.size(); passNum++)
+	{
+		if (!mActivePasses[passNum]) continue;
+
+		ResourceManager::ChannelUsage usage;
+		if (!mActivePasses[passNum]->describeChannelUsage(usage))
+		{
+			logInfo("Not aliasing channels:  '" + mActivePasses[passNum]->getName() + "' doesn't describe its channel usage");
+			passUsage.clear();
+			return false;
+		}
+		passUsage.push_back(usage);
+	}
+	return true;
+}
+
+void RenderingPipeline::updateChannelAliasing(void)
+{
+	std::vector<ResourceManager::ChannelUsage> passUsage;
+	if (mAliasTransientChannels) getChannelUsage(passUsage);
+	mpResourceManager->planTransientAliasing(passUsage);
+	logAliasingStats(mpResourceManager->getAliasingStats());
+}
+
+ResourceManager::AliasingStats RenderingPipeline::simulateChannelAliasing(uint32_t width, uint32_t height) const
+{
+	std::vector<ResourceManager::ChannelUsage> passUsage;
+	getChannelUsage(passUsage);
+
+	// Every channel some pass names, in order of first mention.  Only channels of the same format and flags can share a
+	//     texture, so each gets those passes requested it with:  from the resource manager once passes have requested their
+	//     textures, and before that (e.g., for -aliasingReport) as their channel usage declares them.
+	std::vector<ResourceManager::AliasingChannel> channels;
+	auto addChannels = [&](const std::vector<std::string>& names)
+	{
+		for (const std::string& name : names)
+		{
+			auto sameName = [&](const ResourceManager::AliasingChannel& channel) { return channel.name == name; };
+			if (std::find_if(channels.begin(), channels.end(), sameName) != channels.end()) continue;
+
+			ResourceManager::AliasingChannel channel;
+			if (mpResourceManager && mpResourceManager->getTextureIndex(name) >= 0)
+			{
+				// Not fullscreen, so never aliased
+				if (!mpResourceManager->describeAliasingChannel(name, width, height, channel)) continue;
+			}
+			else
+			{
+				channel.name = name;
+				for (const ResourceManager::ChannelUsage& usage : passUsage)
+				{
+					auto format = usage.formats.find(name);
+					if (format != usage.formats.end()) channel.format = format->second;
+					auto flags = usage.flags.find(name);
+					if (flags != usage.flags.end()) channel.flags = flags->second;
+				}
+				channel.bytes = uint64_t(getFormatBytesPerBlock(channel.format)) * width * height;
+				channel.aliasable = (name != ResourceManager::kOutputChannel);
+			}
+			channels.push_back(channel);
+		}
+	};
+	for (const ResourceManager::ChannelUsage& usage : passUsage)
+	{
+		addChannels(usage.reads);
+		addChannels(usage.writes);
+		addChannels(usage.persistent);
+	}
+
+	ResourceManager::AliasingStats stats;
+	ResourceManager::planAliasing(channels, passUsage, stats);
+	logAliasingStats(stats);
+	return stats;
+}
+
 void RenderingPipeline::createDropdownGuiForPass(uint32_t passOrder, Gui::DropdownList& outputList)
 {
 	// Ensure our list is empty
@@ -386,10 +466,32 @@ void RenderingPipeline::onGuiRender(SampleCallbacks* pSample, Gui* pGui)
 		mpResourceManager->setSpatial(mDoSpatialReuse);
 	}
 
+	if (mPipeUsesTemporal || mPipeUsesSpatial)
+	{
+		pGui->addCheckBox("Unbiased Reuse", mDoUnbiased);
+		mpResourceManager->setUnbiased(mDoUnbiased);
+		if (mDoUnbiased)
+		{
+			pGui->addCheckBox("Trace Visibility For Z", mDoUnbiasedVisibility);
+		}
+		mpResourceManager->setUnbiasedVisibility(mDoUnbiased && mDoUnbiasedVisibility);
+	}
+
+	if (mPipeUsesReSTIRGI && mpResourceManager)
+	{
+		pGui->addCheckBox("ReSTIR GI", mDoReSTIRGI);
+		mpResourceManager->setReSTIRGI(mDoReSTIRGI);
+	}
+
 	if (mPipeUsesDenoising)
 	{
 		pGui->addCheckBox("Denoising", mDoDenoising);
 		mpResourceManager->setDenoising(mDoDenoising);
+		if (mDoDenoising)
+		{
+			pGui->addCheckBox("Compute Shader Denoiser", mDoComputeDenoising);
+		}
+		mpResourceManager->setComputeDenoising(mDoComputeDenoising);
 	}
 
 	pGui->addText("");
@@ -422,6 +524,43 @@ void RenderingPipeline::onGuiRender(SampleCallbacks* pSample, Gui* pGui)
     pGui->addText("");
     pGui->addSeparator();
     pGui->addText(Falcor::gProfileEnabled ? "Press (P):  Hide profiling window" : "Press (P):  Show profiling window");
+	if (Falcor::gProfileEnabled)
+	{
+		updateProfilingData();
+		pGui->addText(("Pass GPU time (ms) over " + std::to_string(Profiler::kHistorySize) + " frames:").c_str());
+		for (uint32_t passNum = 0; passNum < mActivePasses.size(); passNum++)
+		{
+			const Profiler::Stats& gpu = mPassStats[passNum].gpu;
+			if (!mActivePasses[passNum] || gpu.count == 0) continue;
+			char buf[256];
+			snprintf(buf, sizeof(buf), "  %s: avg %.3f, p95 %.3f, max %.3f", mProfileNames[passNum].str.c_str(), gpu.avg, gpu.p95, gpu.max);
+			pGui->addText(buf);
+		}
+	}
+
+	if (mpResourceManager)
+	{
+		if (pGui->addCheckBox("Alias transient channels", mAliasTransientChannels))
+		{
+			updateChannelAliasing();
+		}
+		const ResourceManager::AliasingStats& stats = mpResourceManager->getAliasingStats();
+		char buf[256];
+		snprintf(buf, sizeof(buf), "  Channel memory: %.1f MB (%.1f MB unaliased, %.1f MB peak live)", stats.aliasedBytes / 1048576.0,
+			stats.naiveBytes / 1048576.0, stats.peakLiveBytes / 1048576.0);
+		pGui->addText(buf);
+	}
+
+	bool recordTrace = (mpProfileTrace != nullptr);
+	if (pGui->addCheckBox("Record profiling trace", recordTrace))
+	{
+		if (recordTrace) startProfileTrace("profile");
+		else stopProfileTrace();
+	}
+	if (mpProfileTrace)
+	{
+		pGui->addText(("  " + std::to_string(mpProfileTrace->getFrameCount()) + " frames to " + mpProfileTrace->getTraceFilename()).c_str());
+	}
     pGui->addSeparator();
 }
 
@@ -653,6 +792,9 @@ void RenderingPipeline::onFrameRender(SampleCallbacks* pSample, const RenderCont
 	// Is this the first time we've run onFrameRender()?  If som take care of things that happen on first execution.
 	if (mFirstFrame) onFirstRun(pSample);
 
+	// Stream the profiler events of any frames that have completed since last frame
+	if (mpProfileTrace) mpProfileTrace->recordFrames();
+
 	// Bind our default state to the graphics pipe
 	pRenderContext->pushGraphicsState(mpDefaultGfxState);
 
@@ -674,6 +816,9 @@ void RenderingPipeline::onFrameRender(SampleCallbacks* pSample, const RenderCont
 	bool updatedPipeline = false;
 	if (anyRequestedPipelineChanges())
 	{
+		// Passes may have moved, changing which channels can share textures.  Do this first, as it may reallocate them.
+		updateChannelAliasing();
+
 		// If there's a change, let all the passes know
 		for (uint32_t passNum = 0; passNum < mActivePasses.size(); passNum++)
 		{
@@ -703,6 +848,7 @@ void RenderingPipeline::onFrameRender(SampleCallbacks* pSample, const RenderCont
 	}
 
     // Execute all of the passes in the current pipeline
+    if (Falcor::gProfileEnabled) updateProfileNames();
     for (uint32_t passNum = 0; passNum < mActivePasses.size(); passNum++)
     {
         if (mActivePasses[passNum])
@@ -711,7 +857,7 @@ void RenderingPipeline::onFrameRender(SampleCallbacks* pSample, const RenderCont
             {
                 // Insert a per-pass profiling event.  
                 assert(passNum < mProfileNames.size());
-                Falcor::ProfilerEvent _profileEvent(mActivePasses[passNum]->getName().c_str());
+                Falcor::ProfilerEvent _profileEvent(mProfileNames[passNum]);
                 mActivePasses[passNum]->onExecute(pRenderContext.get());
             }
             else
@@ -777,6 +923,8 @@ void RenderingPipeline::onResizeSwapChain(SampleCallbacks* pSample, uint32_t wid
 
 void RenderingPipeline::onShutdown(SampleCallbacks* pSample)
 {
+	stopProfileTrace();
+
 	// On program shutdown, call the shutdown callback on all the render passes.
     // We do not have to worry about double-deletion etc. It is currently enforced that a pass is only bound to one pipeline.
 	for (uint32_t i = 0; i < mAvailPasses.size(); i++)
@@ -883,45 +1031,58 @@ void RenderingPipeline::addPipeInstructions(const std::string &str)
 	mPipeDescription.push_back(str);
 }
 
-void RenderingPipeline::extractProfilingData(void)
+void RenderingPipeline::updateProfileNames(void)
 {
-	// This is a pretty ugly method.  It basically undoes Falcor's standard
-	//    profiler output, which is a strigified concatenation of all the data
-	//    we care about.  The 'right' way to deal with this is to update 
-	//    Falcor to provide a more granular way of accessing profile data that
-	//    isn't stringified.  For now, I'll just extract the data from 
-	//    the string.  So, yeah, this is ugly.  And if Falcor changes the profiler,
-	//    this will need updating.
-
-	// Get our Falcor profiler string
-	std::string profileMsg = Profiler::getEventsString();
-    mTmpStr = profileMsg;
-
-	// Grab all of the lines with profiling data
-	int findPass = 0;
-	int count = 1;
+	// Only rebuild (and rehash) the names when the active passes change, rather than every frame
+	bool changed = (mProfiledPasses.size() != mActivePasses.size());
+	for (uint32_t passNum = 0; !changed && passNum < mActivePasses.size(); passNum++)
+	{
+		changed = (mProfiledPasses[passNum] != mActivePasses[passNum].get());
+	}
+	if (!changed) return;
 
-	size_t endOfLine = profileMsg.find('\n');
-	while (endOfLine != std::string::npos && findPass < mActivePasses.size())
+	// Passes used more than once (e.g., each spatial reuse or denoising iteration) get numbered, so each has its own event
+	mProfiledPasses.clear();
+	mProfileNames.clear();
+	std::map<std::string, uint32_t> nameCount;
+	for (uint32_t passNum = 0; passNum < mActivePasses.size(); passNum++)
 	{
-		// Each RenderPass is profiled with the name "Pass_%d" where %d various from 0 to (#passes-1)
-		char buf[128], passName[128];
-		float cpuTime, gpuTime;
-		sprintf_s(buf, "Pass_%d", findPass);
+		mProfiledPasses.push_back(mActivePasses[passNum].get());
+		std::string name = mActivePasses[passNum] ? mActivePasses[passNum]->getName() : kNullPassProfileName;
+		uint32_t count = ++nameCount[name];
+		mProfileNames.push_back(HashedString(count > 1 ? name + " (" + std::to_string(count) + ")" : name));
+	}
+}
 
-		// See if this line contains the time for the next pass (each line contains: <profileEventName> <cpuTime> <gpuTime>)
-		sscanf( profileMsg.substr(0, endOfLine).c_str(), "%s %f %f ", passName, &cpuTime, &gpuTime );
-		if (!strcmp(buf, passName))
-		{
-			mProfileGPUTimes[findPass++] = gpuTime;	
-		}
+void RenderingPipeline::updateProfilingData(void)
+{
+	updateProfileNames();
+	mPassStats.assign(mActivePasses.size(), Profiler::EventStats());
+	for (uint32_t passNum = 0; passNum < mActivePasses.size(); passNum++)
+	{
+		if (mActivePasses[passNum]) Profiler::getEventStats(mProfileNames[passNum], mPassStats[passNum]);
+	}
+}
 
-		// Move onto the next line of the string.
-		profileMsg = profileMsg.substr(endOfLine+1);
-		endOfLine = profileMsg.find('\n');
+void RenderingPipeline::startProfileTrace(const std::string& baseFilename)
+{
+	stopProfileTrace();
+	mpProfileTrace = ProfileTraceWriter::create(baseFilename + ".json", baseFilename + ".csv");
+	if (mpProfileTrace)
+	{
+		Falcor::gProfileEnabled = true;
+		logInfo("RenderingPipeline: recording profiling trace to " + baseFilename + ".json / .csv");
 	}
 }
 
+void RenderingPipeline::stopProfileTrace()
+{
+	if (!mpProfileTrace) return;
+	mpProfileTrace->close();
+	logInfo("RenderingPipeline: wrote " + std::to_string(mpProfileTrace->getFrameCount()) + " frames to " + mpProfileTrace->getTraceFilename());
+	mpProfileTrace = nullptr;
+}
+
 
 void RenderingPipeline::run(RenderingPipeline *pipe, SampleConfig &config)
 {
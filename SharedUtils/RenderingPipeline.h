@@ -20,6 +20,7 @@
 #include "Falcor.h"
 #include "RenderPass.h"
 #include "ResourceManager.h"
+#include "ProfileTraceWriter.h"
 
 class RenderingPipeline : public Renderer, inherit_shared_from_this<Renderer, RenderingPipeline>
 {
@@ -64,6 +65,19 @@ public:
 	virtual void onGuiRender(SampleCallbacks* pSample, Gui* pGui) override;
 	virtual void onDroppedFile(SampleCallbacks* pSample, const std::string& filename) override {}
 
+	/** Stream every profiler event (including one per pass) to <baseFilename>.json as a Chrome trace and <baseFilename>.csv
+	    while running, e.g. to track per-pass cost across builds.  Turns profiling on.  May be called before run().
+	*/
+	void startProfileTrace(const std::string& baseFilename);
+	void stopProfileTrace();
+
+	/** Plan channel aliasing for the current passes without a GPU (see ResourceManager::planAliasing()), log what it saves
+	    and return that.  May be called before run().  Channels are width x height, in the format and with the flags passes
+	    requested them with, or before the passes are initialized, as their ChannelUsage declares them (RGBA32Float and
+	    kDefaultFlags unless it says otherwise).
+	*/
+	ResourceManager::AliasingStats simulateChannelAliasing(uint32_t width, uint32_t height) const;
+
 	float getFilterSize() const { return (float)mFilterSize; }
 	void  setFilterSize(uint32_t newFilterSize) { mFilterSize = newFilterSize; }
 
@@ -71,6 +85,10 @@ public:
 	bool mDoTemporalReuse = true;
 	bool mDoSpatialReuse = true;
 	bool mDoDenoising = true;
+	bool mDoComputeDenoising = true;      ///< Denoise with the groupshared-memory compute shader rather than the ray generation one
+	bool mDoUnbiased = false;             ///< Unbiased (1/Z) instead of biased reservoir reuse
+	bool mDoUnbiasedVisibility = false;   ///< ... also counting only neighbors with an unoccluded path to the sample
+	bool mDoReSTIRGI = true;              ///< Resample indirect lighting (otherwise the GI passes trace one bounce per pixel, as FullGlobalIlluminationPass does)
     
 protected:
 	/** When a new scene is loaded, this gets called to let any passes in this pipeline know there's a new scene.
@@ -119,8 +137,17 @@ private:
 	// Update the mPipeRequires* member variables
 	void updatePipelineRequirementFlags(void);
 
-	// Extract profiling data
-	void extractProfilingData(void);
+	// Gather the active passes' channel usage, in execution order.  Returns false (and an empty list) if any pass doesn't describe it.
+	bool getChannelUsage(std::vector<ResourceManager::ChannelUsage>& passUsage) const;
+
+	// Let the resource manager alias transient channels according to the active passes' channel usage
+	void updateChannelAliasing(void);
+
+	// Keep mProfileNames in step with the active passes
+	void updateProfileNames(void);
+
+	// Query the profiler's per-pass statistics into mPassStats
+	void updateProfilingData(void);
 
 	enum UIOptions { CanRemove = 0x1u, CanAddAfter = 0x2u };
 
@@ -146,9 +173,10 @@ private:
 	CameraController::SharedPtr mpCameraControl;
 	GraphicsState::SharedPtr mpDefaultGfxState;
 	std::vector< std::string > mPipeDescription;            ///< Can store a description of the pipeline for display in the UI
-	std::vector< HashedString > mProfileNames;
-	std::vector< double > mProfileGPUTimes;
-    std::vector< double > mProfileLastGPUTimes;
+	std::vector< HashedString > mProfileNames;              ///< Profiler event name of each active pass
+	std::vector< const ::RenderPass* > mProfiledPasses;     ///< The active passes mProfileNames was built for
+	std::vector< Profiler::EventStats > mPassStats;         ///< Timings of each active pass over the profiler's history
+	ProfileTraceWriter::SharedPtr mpProfileTrace;           ///< Non-null while streaming a profiling trace to disk
 
 	// Are we storing an environment map?
 	Gui::DropdownList mEnvMapSelector;
@@ -165,6 +193,7 @@ private:
 	bool mPipeAppliesPostprocess = false;
 	bool mPipeUsesCompute        = false;
 	bool mPipeUsesEnvMap         = false;
+	bool mPipeUsesReSTIRGI       = false;
 	bool mPipeNeedsDefaultScene  = false;
 	bool mPipeHasAnimation       = true;
 	bool mPipeUsesWeightedRIS    = true;
@@ -172,6 +201,9 @@ private:
 	bool mPipeUsesSpatial        = true;
 	bool mPipeUsesDenoising		 = true;
 
+	// Share textures between channels whose lifetimes don't overlap (see ResourceManager::planTransientAliasing())
+	bool mAliasTransientChannels = true;
+
 	// Denoising variables
 	uint32_t mFilterSize		 = 80;
 
@@ -188,6 +220,4 @@ private:
 	Gui::DropdownList mFilterSizeDropdown = { { 0, "10x10" }, { 1, "20x20" }, { 2, "40x40" },{ 3, "80x80" }, { 4, "160x160" }, { 5, "320x320" } };
 	uint32_t          mFilterSizeArray[6] = { 10, 20, 40, 80, 160, 320 };
 	uint32_t          mFilterSizeSelection = 3;
-
-    std::string mTmpStr = "";
 };
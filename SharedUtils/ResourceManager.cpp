@@ -43,19 +43,185 @@ void ResourceManager::resize(uint32_t width, uint32_t height)
 	if (!mIsInitialized)
 		initializeResources();
 
-	// Resize our resources that dynamically resize.
+	// Resize our resources that dynamically resize, keeping aliased channels aliased
+	allocateFullscreenTextures(mTextureAlias, false);
+
+	// The plan doesn't depend on the size, but what it saves does
+	planTransientAliasing(mAliasingUsage);
+}
+
+void ResourceManager::allocateFullscreenTextures(const std::vector<int32_t> &previousAlias, bool onlyChanged)
+{
+	std::map<int32_t, Texture::SharedPtr> sharedTextures;
 	for (int32_t i = 0; i < int32_t(mTextures.size()); i++)
 	{
-		// Only resize textures that are defined to be screensize
+		// Only textures that are defined to be screensize are ever aliased
 		if (mTextureSizes[i] != ivec2(-1, -1)) continue;
 
-		// Recreate our texture with the new size
-		mTextures[i] = Texture::create2D(mWidth, mHeight, mTextureFormat[i], 1u, 1u, nullptr, mTextureFlags[i]);
+		if (mTextureAlias[i] < 0)
+		{
+			bool hadOwnTexture = mTextures[i] && i < int32_t(previousAlias.size()) && previousAlias[i] < 0;
+			if (!onlyChanged || !hadOwnTexture)
+				mTextures[i] = Texture::create2D(mWidth, mHeight, mTextureFormat[i], 1u, 1u, nullptr, mTextureFlags[i]);
+			continue;
+		}
+
+		// The first channel of each allocation creates the texture the others share
+		Texture::SharedPtr &sharedTex = sharedTextures[mTextureAlias[i]];
+		if (!sharedTex)
+			sharedTex = Texture::create2D(mWidth, mHeight, mTextureFormat[i], 1u, 1u, nullptr, mTextureFlags[i]);
+		mTextures[i] = sharedTex;
 	}
 
 	mUpdatedFlag = true;
 }
 
+std::vector<uint32_t> ResourceManager::planAliasing(const std::vector<AliasingChannel> &channels, const std::vector<ChannelUsage> &passUsage, AliasingStats &stats)
+{
+	size_t count = channels.size();
+	std::map<std::string, size_t> channelIndex;
+	for (size_t i = 0; i < count; i++)
+		channelIndex[channels[i].name] = i;
+
+	// Find the first and last pass using each channel.  A channel read before any pass wrote it this frame holds last
+	//     frame's contents, so it (like one listed as persistent) must keep its own allocation.
+	std::vector<int32_t> firstUse(count, -1), lastUse(count, -1);
+	std::vector<bool> pinned(count, false);
+	for (int32_t pass = 0; pass < int32_t(passUsage.size()); pass++)
+	{
+		auto touch = [&](const std::string &name, bool pinIfFirstUse, bool pin)
+		{
+			auto found = channelIndex.find(name);
+			if (found == channelIndex.end()) return;
+			size_t i = found->second;
+			if (firstUse[i] < 0)
+			{
+				firstUse[i] = pass;
+				if (pinIfFirstUse) pinned[i] = true;
+			}
+			lastUse[i] = pass;
+			if (pin) pinned[i] = true;
+		};
+		for (const std::string &name : passUsage[pass].reads)      touch(name, true, false);
+		for (const std::string &name : passUsage[pass].writes)     touch(name, false, false);
+		for (const std::string &name : passUsage[pass].persistent) touch(name, false, true);
+	}
+
+	// Channels no pass uses keep their allocation, as they would without aliasing
+	std::vector<size_t> transient;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (channels[i].aliasable && !pinned[i] && firstUse[i] >= 0)
+			transient.push_back(i);
+	}
+	std::stable_sort(transient.begin(), transient.end(), [&](size_t a, size_t b) { return firstUse[a] < firstUse[b]; });
+
+	// Each allocation is described by its first channel, and free after the last use of its latest one
+	struct Allocation { size_t channel; int32_t freeAfter; };
+	std::vector<Allocation> allocations;
+	std::vector<uint32_t> allocation(count, 0);
+	for (size_t i : transient)
+	{
+		uint32_t match = uint32_t(allocations.size());
+		for (uint32_t a = 0; a < uint32_t(allocations.size()); a++)
+		{
+			const AliasingChannel &occupant = channels[allocations[a].channel];
+			if (allocations[a].freeAfter < firstUse[i] && occupant.format == channels[i].format &&
+				occupant.flags == channels[i].flags && occupant.bytes == channels[i].bytes)
+			{
+				match = a;
+				break;
+			}
+		}
+		if (match == uint32_t(allocations.size()))
+			allocations.push_back({ i, lastUse[i] });
+		else
+			allocations[match].freeAfter = lastUse[i];
+		allocation[i] = match;
+	}
+	std::vector<bool> isTransient(count, false);
+	for (size_t i : transient)
+		isTransient[i] = true;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (isTransient[i]) continue;
+		allocation[i] = uint32_t(allocations.size());
+		allocations.push_back({ i, std::numeric_limits<int32_t>::max() });
+	}
+
+	// Tally what that saves
+	stats = AliasingStats();
+	stats.channels = uint32_t(count);
+	stats.transientChannels = uint32_t(transient.size());
+	stats.allocations = uint32_t(allocations.size());
+	uint64_t pinnedBytes = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		stats.naiveBytes += channels[i].bytes;
+		if (!isTransient[i]) pinnedBytes += channels[i].bytes;
+	}
+	for (const Allocation &a : allocations)
+		stats.aliasedBytes += channels[a.channel].bytes;
+	stats.peakLiveBytes = pinnedBytes;
+	for (int32_t pass = 0; pass < int32_t(passUsage.size()); pass++)
+	{
+		uint64_t liveBytes = pinnedBytes;
+		for (size_t i : transient)
+		{
+			if (firstUse[i] <= pass && pass <= lastUse[i]) liveBytes += channels[i].bytes;
+		}
+		stats.peakLiveBytes = std::max(stats.peakLiveBytes, liveBytes);
+	}
+	return allocation;
+}
+
+bool ResourceManager::describeAliasingChannel(const std::string &channelName, uint32_t width, uint32_t height, AliasingChannel &channel) const
+{
+	int32_t i = getTextureIndex(channelName);
+	if (i < 0 || mTextureSizes[i] != ivec2(-1, -1)) return false;
+
+	channel.name = channelName;
+	channel.format = mTextureFormat[i];
+	channel.flags = mTextureFlags[i];
+	channel.bytes = uint64_t(getFormatBytesPerBlock(mTextureFormat[i])) * width * height;
+	channel.aliasable = !mTextureSwapped[i] && channelName != kOutputChannel;
+	return true;
+}
+
+void ResourceManager::planTransientAliasing(const std::vector<ChannelUsage> &passUsage)
+{
+	mAliasingUsage = passUsage;
+
+	// Describe our fullscreen channels to the planner.  The output channel is still read (blitted) after the last pass.
+	std::vector<int32_t> channelIndices;
+	std::vector<AliasingChannel> channels;
+	for (int32_t i = 0; i < int32_t(mTextures.size()); i++)
+	{
+		AliasingChannel channel;
+		if (!describeAliasingChannel(mTextureNames[i], mWidth, mHeight, channel)) continue;
+		channelIndices.push_back(i);
+		channels.push_back(channel);
+	}
+	std::vector<uint32_t> allocation = planAliasing(channels, passUsage, mAliasingStats);
+
+	// Only allocations backing more than one channel need sharing
+	std::vector<uint32_t> channelsPerAllocation(channels.size(), 0);
+	for (uint32_t a : allocation)
+		channelsPerAllocation[a]++;
+
+	std::vector<int32_t> previousAlias = mTextureAlias;
+	std::fill(mTextureAlias.begin(), mTextureAlias.end(), -1);
+	for (size_t k = 0; k < channels.size(); k++)
+	{
+		if (channelsPerAllocation[allocation[k]] > 1)
+			mTextureAlias[channelIndices[k]] = int32_t(allocation[k]);
+	}
+
+	// Reallocate if the plan changed (and we have textures to reallocate)
+	if (mTextureAlias != previousAlias && mIsInitialized && mWidth > 0 && mHeight > 0)
+		allocateFullscreenTextures(previousAlias, true);
+}
+
 void ResourceManager::initializeResources()
 {
 	// Create all textures that have not been allocated otherwise.
@@ -65,10 +231,12 @@ void ResourceManager::initializeResources()
 		uint32_t texWidth = mTextureSizes[i].x <= 0 ? mWidth : mTextureSizes[i].x;
 		uint32_t texHeight = mTextureSizes[i].y <= 0 ? mHeight : mTextureSizes[i].y;
 
-		// Create the resource (unless it already exists, because a pass created it and passed it in to be managed)
-		if (!mTextures[i])
+		// Create the resource (unless it already exists, because a pass created it and passed it in to be managed).
+		//     Aliased fullscreen channels get their shared textures below.
+		if (!mTextures[i] && mTextureAlias[i] < 0)
 			mTextures[i] = Texture::create2D(texWidth, texHeight, mTextureFormat[i], 1u, 1u, nullptr, mTextureFlags[i]);
 	}
+	allocateFullscreenTextures(mTextureAlias, true);
 
 	mIsInitialized = true;
 	mUpdatedFlag = true;
@@ -132,14 +300,17 @@ int32_t ResourceManager::manageTextureResource(const std::string &channelName, T
 		mTextureNames.push_back(channelName);
 		mTextureFlags.push_back(kDefaultFlags);
 		mTextureFormat.push_back(sharedTex->getFormat());
+		mTextureAlias.push_back(-1);
+		mTextureSwapped.push_back(false);
 	}
 
 	// Override requested resolution and format based on the incoming texture
 	mTextureFormat[existingIndex] = sharedTex->getFormat();
 	mTextureSizes[existingIndex] = ivec2(sharedTex->getWidth(), sharedTex->getHeight());
 
-	// Store our texture pointer
+	// Store our texture pointer (never aliased, as it isn't ours)
 	mTextures[existingIndex] = sharedTex;
+	mTextureAlias[existingIndex] = -1;
 
 	// Since we passed in an existing texture, it has the usage flags it was created with. 
 	mTextureFlags[existingIndex] = kDefaultFlags;
@@ -175,6 +346,38 @@ Texture::SharedPtr ResourceManager::getTexture(const std::string &channelName)
 	return getTexture(getTextureIndex(channelName));
 }
 
+bool ResourceManager::swapTextures(int32_t channelA, int32_t channelB)
+{
+	if (channelA < 0 || channelA >= mTextures.size() || channelB < 0 || channelB >= mTextures.size())
+		return false;
+
+	// Each channel keeps its requested size, format and flags, so only identical resources can trade places
+	if (mTextureFormat[channelA] != mTextureFormat[channelB] || mTextureSizes[channelA] != mTextureSizes[channelB] || 
+		mTextureFlags[channelA] != mTextureFlags[channelB])
+		return false;
+
+	// Swapped channels carry their contents into the next frame, so they can't share a texture with anything
+	if (!mTextureSwapped[channelA] || !mTextureSwapped[channelB])
+	{
+		mTextureSwapped[channelA] = true;
+		mTextureSwapped[channelB] = true;
+		if (mTextureAlias[channelA] >= 0 || mTextureAlias[channelB] >= 0)
+		{
+			logWarning("ResourceManager::swapTextures() - '" + mTextureNames[channelA] + "' and '" + mTextureNames[channelB] +
+				"' were aliased.  The passes using them should list them as persistent in describeChannelUsage().");
+			planTransientAliasing(mAliasingUsage);
+		}
+	}
+
+	std::swap(mTextures[channelA], mTextures[channelB]);
+	return true;
+}
+
+bool ResourceManager::swapTextures(const std::string &channelA, const std::string &channelB)
+{
+	return swapTextures(getTextureIndex(channelA), getTextureIndex(channelB));
+}
+
 Texture::SharedPtr ResourceManager::getClearedTexture(const std::string &channelName, vec4 &clearColor)
 {
 	Texture::SharedPtr channel = getTexture(channelName);
@@ -233,6 +436,8 @@ int32_t ResourceManager::requestTextureResource(const std::string &channelName,
 	mTextureNames.push_back(channelName);
 	mTextureFlags.push_back(usageFlags);
 	mTextureFormat.push_back(channelFormat);
+	mTextureAlias.push_back(-1);
+	mTextureSwapped.push_back(false);
 
 	// While we haven't changed existing resources, it's probably good to notify users that resources available have changed
 	mUpdatedFlag = true;
@@ -335,6 +540,10 @@ void ResourceManager::updateTextureSize(int32_t channelIdx, int32_t newWidth, in
 	// Update the channel
 	mTextures[channelIdx] = Texture::create2D(newSize.x, newSize.y, mTextureFormat[channelIdx], 1u, Texture::kMaxPossible, nullptr, mTextureFlags[channelIdx]);
 	mTextureSizes[channelIdx] = newSize;
+	mTextureAlias[channelIdx] = -1;
+
+	// Only fullscreen channels are aliased, so this may change the plan
+	planTransientAliasing(mAliasingUsage);
 	mUpdatedFlag = true;
 }
 
@@ -59,6 +59,70 @@ public:
 	void updateTextureSize(const std::string &channelName, int32_t newWidth = -1, int32_t newHeight = -1);
 	void updateTextureSize(int32_t channelIdx, int32_t newWidth = -1, int32_t newHeight = -1);
 
+	// Swap the textures behind two channels, e.g., to ping-pong this frame's and last frame's G-buffer without a copy.
+	//    -> Both channels must have the same format, size, and usage flags.  Returns false (and swaps nothing) if they do not.
+	//    -> Texture pointers previously returned for either channel (or FBOs built from them) now refer to the other one.
+	bool swapTextures(const std::string &channelA, const std::string &channelB);
+	bool swapTextures(int32_t channelA, int32_t channelB);
+
+	// Lifetime-based aliasing of transient channels.  A fullscreen channel whose contents are only needed from the pass that
+	//     first writes it each frame until the last pass that reads it can share its texture with other such channels whose
+	//     lifetimes don't overlap (and that have the same format and flags).
+	//    -> Passes describe the channels they touch with RenderPass::describeChannelUsage(); the pipeline hands those to
+	//       planTransientAliasing(), in execution order, whenever the set of active passes changes.
+	//    -> Channels read before they are written in a frame, listed as persistent, swapped by swapTextures(), or not
+	//       fullscreen (including kOutputChannel and managed textures) always keep their own texture.
+	//    -> Texture pointers for aliased channels change when the plan does (haveResourcesChanged() is then true).
+	struct ChannelUsage
+	{
+		std::vector<std::string> reads;       ///< Channels whose contents from earlier passes (or frames) the pass reads
+		std::vector<std::string> writes;      ///< Channels the pass overwrites in full (before reading them itself, if it does)
+		std::vector<std::string> persistent;  ///< Channels whose contents must survive until next frame (e.g., histories)
+
+		// Channels above that the pass requests in a format other than RGBA32Float, or with other than kDefaultFlags.  Only
+		//     RenderingPipeline::simulateChannelAliasing() reads these, since it may run before any pass has requested its
+		//     textures;  planTransientAliasing() uses the requests themselves.
+		std::map<std::string, ResourceFormat>      formats;
+		std::map<std::string, Resource::BindFlags> flags;
+	};
+
+	// Memory taken by fullscreen channels, with and without aliasing
+	struct AliasingStats
+	{
+		uint32_t channels = 0;            ///< Fullscreen channels
+		uint32_t transientChannels = 0;   ///< ... of which may be aliased
+		uint32_t allocations = 0;         ///< Textures backing them
+		uint64_t naiveBytes = 0;          ///< One texture per channel
+		uint64_t aliasedBytes = 0;        ///< Sum of the allocations, which all live for the whole frame
+		uint64_t peakLiveBytes = 0;       ///< Most bytes live during any one pass:  the least any aliasing could use
+	};
+
+	// A channel as the planner sees it
+	struct AliasingChannel
+	{
+		std::string         name;
+		ResourceFormat      format = ResourceFormat::RGBA32Float;
+		Resource::BindFlags flags = kDefaultFlags;
+		uint64_t            bytes = 0;
+		bool                aliasable = true;  ///< False to give it its own allocation regardless of its lifetime
+	};
+
+	// The allocator behind planTransientAliasing(), without any GPU state, so it can be run on a CPU-side description of a
+	//     pipeline (e.g., to check how much a pass order saves).
+	//    -> Returns, per channel, the allocation backing it.  Channels sharing an allocation are aliased.
+	//    -> Greedy first fit over channels sorted by first use; a channel may reuse an allocation whose previous occupant
+	//       was last used by an earlier pass (not the same one, which may still read it while writing the new channel).
+	static std::vector<uint32_t> planAliasing(const std::vector<AliasingChannel> &channels, const std::vector<ChannelUsage> &passUsage, AliasingStats &stats);
+
+	// Describe <channelName> to the planner as planTransientAliasing() does, at <width> x <height>:  with the format and flags
+	//     passes requested it with.  Returns false if no pass requested it, or it isn't fullscreen (so is never aliased).
+	bool describeAliasingChannel(const std::string &channelName, uint32_t width, uint32_t height, AliasingChannel &channel) const;
+
+	// Alias fullscreen channels according to passUsage (one entry per active pass, in execution order) and reallocate
+	//     those whose allocation changed.  An empty list gives every channel its own texture again.
+	void planTransientAliasing(const std::vector<ChannelUsage> &passUsage);
+	const AliasingStats& getAliasingStats() const { return mAliasingStats; }
+
 	// Get a pointer to the texture with the specified channel name or channel index.  Returns a nullptr if channel does not exist
 	Texture::SharedPtr getTexture(const std::string &channelName);
 	Texture::SharedPtr getTexture(int32_t channelIdx);
@@ -154,6 +218,18 @@ public:
 	bool  getDenoising() const		 { return mEnableDenoising; }
 	void  setDenoising(bool val)	 { mEnableDenoising = val; }
 
+	bool  getComputeDenoising() const   { return mEnableComputeDenoising; }
+	void  setComputeDenoising(bool val) { mEnableComputeDenoising = val; }
+
+	bool  getUnbiased() const        { return mEnableUnbiased; }
+	void  setUnbiased(bool val)      { mEnableUnbiased = val; }
+
+	bool  getUnbiasedVisibility() const   { return mEnableUnbiasedVisibility; }
+	void  setUnbiasedVisibility(bool val) { mEnableUnbiasedVisibility = val; }
+
+	bool  getReSTIRGI() const        { return mEnableReSTIRGI; }
+	void  setReSTIRGI(bool val)      { mEnableReSTIRGI = val; }
+
 protected:
 	ResourceManager(uint32_t width, uint32_t height, SampleCallbacks *callbacks) : mWidth(width), mHeight(height), mpAppCallbacks(callbacks) {}
 
@@ -167,6 +243,10 @@ protected:
 	bool     mEnableTemporal = true;
 	bool     mEnableSpatial = true;
 	bool     mEnableDenoising = true;
+	bool     mEnableComputeDenoising = true;
+	bool     mEnableUnbiased = false;
+	bool     mEnableUnbiasedVisibility = false;
+	bool     mEnableReSTIRGI = true;
 	float    mMinT = 1.0e-4f;
 
 	// If using the resource manager to manage an environment map, its filename is here.
@@ -185,9 +265,19 @@ protected:
 	std::vector<glm::ivec2>           mTextureSizes;     ///< Stored separately from internal texture data so we can distinguish between fixed & fullscreen textures
 	std::vector<Resource::BindFlags>  mTextureFlags;     ///< Expected usage flags
 	std::vector<ResourceFormat>       mTextureFormat;    ///< Expected texture format
+	std::vector<int32_t>              mTextureAlias;     ///< Fullscreen channels with the same (non-negative) value share a texture
+	std::vector<bool>                 mTextureSwapped;   ///< Passed to swapTextures(), so its contents outlive the frame
+
+	// The pass usage the current aliasing plan was made for, and what it saves
+	std::vector<ChannelUsage>         mAliasingUsage;
+	AliasingStats                     mAliasingStats;
 
 private:
 	// These are not meant to be exposed outside the class and may not have suitable error checking non-private use.
 	bool hasBindFlag(int32_t index, Resource::BindFlags flag);
 
+	// (Re)create fullscreen textures, sharing them between aliased channels.  If onlyChanged, keeps the textures of
+	//     channels that had and still have their own.
+	void allocateFullscreenTextures(const std::vector<int32_t> &previousAlias, bool onlyChanged);
+
 };
@@ -17,6 +17,7 @@
 **********************************************************************************************************************/
 
 #include "SimpleVars.h"
+#include <atomic>
 
 using namespace Falcor;
 
@@ -25,14 +26,16 @@ SimpleVars::SharedPtr SimpleVars::SimpleVars::create(Falcor::Program::SharedPtr
 	return SharedPtr(new SimpleVars( GraphicsVars::create(pProg->getActiveVersion()->getReflector()).get() ));
 }
 
-SimpleVars::SharedPtr SimpleVars::SimpleVars::create(Falcor::GraphicsVars *pVars)
+SimpleVars::SharedPtr SimpleVars::SimpleVars::create(Falcor::ProgramVars *pVars)
 {
 	return SharedPtr(new SimpleVars( pVars ));
 }
 
-SimpleVars::SimpleVars(Falcor::GraphicsVars *pVars)
+SimpleVars::SimpleVars(Falcor::ProgramVars *pVars)
 {
+	static std::atomic<uint64_t> sNextId(1);
 	mpVars = pVars;
+	mId = sNextId++;
 }
 
 #if 0
@@ -87,6 +90,74 @@ bool SimpleVars::setRawBuffer(const std::string& name, Falcor::Buffer::SharedPtr
 	return mpVars->setRawBuffer(name, pBuffer);
 }
 
+StructuredBuffer::SharedPtr SimpleVars::createStructuredBuffer(const std::string& name, size_t elementCount)
+{
+	// Ensure a variable with this name exists and is actually a structured buffer!
+	if (!isVarValid(name, ReflectionResourceType::Type::StructuredBuffer)) return nullptr;
+
+	// Create from the shader's own reflection data, so the element layout matches
+	const ReflectionResourceType* pType = mpVars->getReflection()->getResource(name)->getType()->unwrapArray()->asResourceType();
+	return StructuredBuffer::create(name, pType->inherit_shared_from_this::shared_from_this(), elementCount);
+}
+
+SimpleVars::ConstantsHandle SimpleVars::resolveConstants(const std::string& cBuf, const std::string& name, size_t size)
+{
+	ConstantsHandle handle;
+	ConstantBuffer::SharedPtr cb = mpVars ? mpVars->getConstantBuffer(cBuf) : nullptr;
+	if (!cb) return handle;
+
+	// Ensure the variable exists and is exactly as large as the C++ side thinks, so a layout change in only one of
+	//    them fails here rather than scrambling the buffer
+	ReflectionVar::SharedConstPtr pVar = cb->getBufferReflector()->findMember(name);
+	if (!pVar || pVar->getType()->getSize() != size)
+	{
+		logWarning("SimpleVars::resolveConstants():  " + cBuf + "." + name + " is missing or isn't " + std::to_string(size) + " bytes");
+		return handle;
+	}
+
+	handle.pCB = cb;
+	handle.offset = pVar->getOffset();
+	handle.size = size;
+	return handle;
+}
+
+SimpleVars::ResourceHandle SimpleVars::resolveResource(const std::string& name)
+{
+	ResourceHandle handle;
+	ReflectionVar::SharedConstPtr pVar = mpVars ? mpVars->getReflection()->getResource(name) : nullptr;
+	const ReflectionResourceType* pType = pVar ? pVar->getType()->unwrapArray()->asResourceType() : nullptr;
+	if (!pType) return handle;
+
+	// Only textures and buffers are bound through views
+	switch (pType->getType())
+	{
+	case ReflectionResourceType::Type::Texture:
+	case ReflectionResourceType::Type::StructuredBuffer:
+	case ReflectionResourceType::Type::RawBuffer:
+	case ReflectionResourceType::Type::TypedBuffer:
+		break;
+	default:
+		return handle;
+	}
+
+	handle.location = mpVars->getReflection()->getDefaultParameterBlock()->getResourceBinding(name);
+	handle.isUav = (pType->getShaderAccess() == ReflectionResourceType::ShaderAccess::ReadWrite);
+	return handle;
+}
+
+bool SimpleVars::setResource(const ResourceHandle& handle, const Falcor::Resource::SharedPtr& pResource)
+{
+	if (!handle.isValid()) return false;
+
+	// The same view-level calls setTexture() and friends end in, minus the lookups
+	const ParameterBlock::SharedPtr& pBlock = mpVars->getDefaultBlock();
+	if (handle.isUav)
+	{
+		return pBlock->setUav(handle.location, 0, pResource ? pResource->getUAV() : nullptr);
+	}
+	return pBlock->setSrv(handle.location, 0, pResource ? pResource->getSRV() : nullptr);
+}
+
 bool SimpleVars::isVarValid(const std::string &varName, ReflectionResourceType::Type varType)
 {
 	ReflectionVar::SharedConstPtr mRes = mpVars->getReflection()->getResource(varName);
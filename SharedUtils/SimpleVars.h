@@ -116,7 +116,7 @@ public:
 
 	// public constructors
 	static SharedPtr create( Falcor::Program::SharedPtr pProg );       // Create from a Falcor program
-	static SharedPtr create( Falcor::GraphicsVars *pVars );  
+	static SharedPtr create( Falcor::ProgramVars *pVars );       // Graphics or compute vars  
 	virtual ~SimpleVars() = default;
 
 	// Set a variable
@@ -140,17 +140,66 @@ public:
 	bool setStructuredBuffer(const std::string& name, Falcor::StructuredBuffer::SharedPtr& pBuffer);
 	bool setRawBuffer(const std::string& name, Falcor::Buffer::SharedPtr& pBuffer);
 
+	// Create a structured buffer with <elementCount> elements, laid out like the StructuredBuffer named [name] in
+	//    this program.  Any program declaring the same buffer type can share it.  Returns nullptr if there is no such buffer.
+	Falcor::StructuredBuffer::SharedPtr createStructuredBuffer(const std::string& name, size_t elementCount);
+
+	// Pre-resolved bindings, for variables a pass sets every frame.  Setting by name (hlslVars["myShaderCB"]["myVar"])
+	//    builds string temporaries and searches the reflection data on every assignment;  a handle does that search
+	//    once, so setting through it is a memcpy at a known offset (constants) or a view write at a known descriptor
+	//    location (textures and buffers).  Handles belong to the SimpleVars that resolved them.  RayLaunch and the other
+	//    wrappers create new vars when their program or scene changes, so keep the getId() you resolved against and
+	//    resolve again when it differs.
+	struct ConstantsHandle
+	{
+		Falcor::ConstantBuffer::SharedPtr pCB;
+		size_t offset = Falcor::VariablesBuffer::kInvalidOffset;
+		size_t size = 0;
+		bool isValid() const { return pCB && offset != Falcor::VariablesBuffer::kInvalidOffset; }
+	};
+
+	struct ResourceHandle
+	{
+		Falcor::ParameterBlockReflection::BindLocation location;
+		bool isUav = false;      ///< RWTexture2D, RWStructuredBuffer, ...
+		bool isValid() const { return location.setIndex != Falcor::ParameterBlockReflection::BindLocation::kInvalidLocation; }
+	};
+
+	// Resolve the variable [name] in constant buffer [cBuf], usually a struct shared with HLSL through a header (see
+	//    SpatialReuseParams.h).  The handle is invalid if there's no such variable, or if its size isn't <size> bytes.
+	ConstantsHandle resolveConstants(const std::string& cBuf, const std::string& name, size_t size);
+
+	// Resolve the texture or buffer [name] (not an element of an array).  Invalid if there's no such resource.
+	ResourceHandle resolveResource(const std::string& name);
+
+	// Copy <data> over the variable behind <handle> with one memcpy.  The buffer is uploaded as usual at the next dispatch.
+	template<typename T>
+	void setConstants(const ConstantsHandle& handle, const T& data)
+	{
+		if (handle.isValid() && handle.size == sizeof(T))
+		{
+			handle.pCB->setBlob(&data, handle.offset, sizeof(T));
+		}
+	}
+
+	// Bind a texture or buffer through a handle (nullptr binds an empty view).  Returns false if the handle is invalid.
+	bool setResource(const ResourceHandle& handle, const Falcor::Resource::SharedPtr& pResource);
+
+	// Unique for each SimpleVars created, so handles can be checked against the vars they were resolved for
+	uint64_t getId() const { return mId; }
+
 	// Get the current underlying Falcor variable class
-	Falcor::GraphicsVars *getVars()
+	Falcor::ProgramVars *getVars()
 	{	
 		return mpVars;
 	}
 
 protected:
-	SimpleVars(Falcor::GraphicsVars *pVars);
+	SimpleVars(Falcor::ProgramVars *pVars);
 
 private:
-	Falcor::GraphicsVars*   mpVars = nullptr;
+	Falcor::ProgramVars*    mpVars = nullptr;
+	uint64_t                mId = 0;
 
 	// Internal utility function that does additional error checking beyond Falcor's built-in checks
 	//    -> returns true if shader variable [varName] exists and has type [varType]
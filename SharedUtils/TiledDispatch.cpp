@@ -0,0 +1,42 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#include "TiledDispatch.h"
+
+TiledDispatch::SharedPtr TiledDispatch::create(uint32_t threadCount, uvec2 tileSize)
+{
+	TaskScheduler::SharedPtr pScheduler = (threadCount == 0) ? TaskScheduler::getGlobal() : TaskScheduler::create(threadCount - 1);
+	return SharedPtr(new TiledDispatch(pScheduler, glm::max(tileSize, uvec2(1, 1))));
+}
+
+void TiledDispatch::execute(const uvec2& launchDim, const TileKernel& kernel)
+{
+	if (launchDim.x == 0 || launchDim.y == 0) return;
+
+	uint32_t tilesX = (launchDim.x + mTileSize.x - 1) / mTileSize.x;
+	uint32_t tilesY = (launchDim.y + mTileSize.y - 1) / mTileSize.y;
+	mpScheduler->parallelFor(0, tilesX * tilesY, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t tileIdx = begin; tileIdx < end; tileIdx++)
+		{
+			uvec2 tileStart = uvec2(tileIdx % tilesX, tileIdx / tilesX) * mTileSize;
+			uvec2 tileEnd = glm::min(tileStart + mTileSize, launchDim);
+			kernel(tileStart, tileEnd);
+		}
+	}, 1);
+}
@@ -0,0 +1,73 @@
+/**********************************************************************************************************************
+# Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+# following conditions are met:
+#  * Redistributions of code must retain the copyright notice, this list of conditions and the following disclaimer.
+#  * Neither the name of NVIDIA CORPORATION nor the names of its contributors may be used to endorse or promote products
+#    derived from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT
+# SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+# OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**********************************************************************************************************************/
+
+#pragma once
+
+#include "Falcor.h"
+#include <functional>
+
+/** Launches a 2D grid of CPU work, much like a compute dispatch or a DispatchRays() call, on a work-stealing
+TaskScheduler.  The launch dimensions are broken into screen-space tiles, and the tiles are handed to the scheduler's
+parallelFor() one index at a time.  Its lazy splitting gives each thread a contiguous block of tiles (contiguous
+tiles share cache lines in our output buffers), and threads that run dry steal the rest of someone else's block.
+This keeps every core busy even when some tiles (e.g., ones full of geometry) are much more costly than others.
+
+Usage:
+     TiledDispatch::SharedPtr mpDispatch = TiledDispatch::create();    // Shares TaskScheduler::getGlobal()
+
+     // Blocks until every pixel in the launch has been processed.  The kernel gets the tile's [start, end) pixel range.
+     mpDispatch->execute(uvec2(width, height), [&](const uvec2& tileStart, const uvec2& tileEnd)
+     {
+          for (uint32_t y = tileStart.y; y < tileEnd.y; y++)
+               for (uint32_t x = tileStart.x; x < tileEnd.x; x++)
+                    shadePixel(uvec2(x, y));
+     });
+
+The calling thread works on tiles too, so a dispatch never sleeps waiting on an idle core.
+*/
+
+using namespace Falcor;
+
+class TiledDispatch : public std::enable_shared_from_this<TiledDispatch>
+{
+public:
+	using SharedPtr = std::shared_ptr<TiledDispatch>;
+	using SharedConstPtr = std::shared_ptr<const TiledDispatch>;
+	virtual ~TiledDispatch() = default;
+
+	// The per-tile work.  Called with the [tileStart, tileEnd) pixel range of a single tile
+	using TileKernel = std::function<void(const uvec2& tileStart, const uvec2& tileEnd)>;
+
+	// Create a dispatcher.  A threadCount of 0 runs on the shared TaskScheduler::getGlobal(); otherwise the dispatcher
+	//     gets a scheduler of its own with threadCount - 1 workers, plus the thread calling execute().
+	static SharedPtr create(uint32_t threadCount = 0, uvec2 tileSize = uvec2(16, 16));
+
+	// Run the kernel over every tile of a launchDim.x by launchDim.y grid.  Blocks until complete.
+	void execute(const uvec2& launchDim, const TileKernel& kernel);
+
+	// Accessors
+	uint32_t getThreadCount() const                         { return mpScheduler->getWorkerCount() + 1; }
+	uvec2 getTileSize() const                               { return mTileSize; }
+	const TaskScheduler::SharedPtr& getScheduler() const    { return mpScheduler; }
+
+protected:
+	TiledDispatch(const TaskScheduler::SharedPtr& pScheduler, uvec2 tileSize) : mpScheduler(pScheduler), mTileSize(tileSize) {}
+
+	TaskScheduler::SharedPtr  mpScheduler;
+	uvec2                     mTileSize;
+};